@@ -25,15 +25,19 @@
 #include <flux/stream.h>
 #include <flux/sequence.h>
 #include <flux/merge.h>
+#include <flux/threaded_reader.h>
 
 #include <warp/util.h>
 #include <warp/syncqueue.h>
+#include <warp/WorkerPool.h>
 
 #include <boost/thread.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
 
 #include <vector>
+#include <deque>
 #include <algorithm>
 #include <utility>
 #include <functional>
@@ -68,15 +72,54 @@ namespace flux
         /// merge.
         bool asyncOutput;
 
+        /// When spilling sorted runs to a RunStore, merge at most \c
+        /// maxMergeFanIn runs at once.  Larger run sets are merged in
+        /// several passes, writing intermediate runs to the store.
+        size_t maxMergeFanIn;
+
+        /// When spilling, read ahead up to \c readAheadSize bytes
+        /// from each run on a background thread during merges.  Zero
+        /// reads runs synchronously.
+        size_t readAheadSize;
+
         AsyncSortParams() :
             nSortWorkers(2),
             dispatchThreshold(64 << 20),
             maxBuffers(0),
-            asyncOutput(true)
+            asyncOutput(true),
+            maxMergeFanIn(64),
+            readAheadSize(1 << 20)
         {
         }
     };
 
+    //------------------------------------------------------------------------
+    // RunStore
+    //------------------------------------------------------------------------
+    /// External storage for sorted runs spilled by an AsyncSort.
+    /// Runs are created and removed concurrently from several worker
+    /// threads, so implementations must be thread-safe.
+    template <class T>
+    class RunStore
+    {
+    public:
+        typedef boost::shared_ptr< Stream<T> > stream_handle_t;
+        typedef boost::shared_ptr< RunStore<T> > handle_t;
+
+        virtual ~RunStore() {}
+
+        /// Start a new run and return an output stream for it.  The
+        /// run is complete once the stream has been flushed and
+        /// released.
+        virtual stream_handle_t createRun(size_t & runId) = 0;
+
+        /// Open a completed run for reading.
+        virtual stream_handle_t openRun(size_t runId) = 0;
+
+        /// Discard a run after its readers have been released.
+        virtual void removeRun(size_t runId) = 0;
+    };
+
     //------------------------------------------------------------------------
     // AsyncSort
     //------------------------------------------------------------------------
@@ -100,6 +143,9 @@ namespace flux
         typedef std::pair<buf_handle_t, int> sort_job_t;
         typedef std::pair<int, size_t> merge_job_t;
 
+        typedef RunStore<T> run_store_t;
+        typedef typename run_store_t::handle_t run_store_handle_t;
+
         typedef boost::thread thread_t;
         typedef boost::shared_ptr<thread_t> thread_handle_t;
 
@@ -110,6 +156,7 @@ namespace flux
         warp::SyncQueue<sort_job_t>   sortQueue;
         warp::SyncQueue<buf_handle_t> mergeBufferQueue[2];
         warp::SyncQueue<merge_job_t>  mergeJobQueue;
+        warp::SyncQueue<size_t>       mergeRunQueue[2];
 
         // Controlled by main thread
         int mergeIndex;
@@ -126,6 +173,10 @@ namespace flux
         std::vector<thread_handle_t> sortThreads;
         thread_handle_t mergeThread;
 
+        // Spill storage and merge read-ahead (set before first put)
+        run_store_handle_t runStore;
+        boost::scoped_ptr<warp::WorkerPool> readAheadPool;
+
         // Comparison functor (merge thread only)
         Lt lt;
 
@@ -203,12 +254,34 @@ namespace flux
             this->output = output;
         }
 
+        /// Spill sorted buffers to the given store instead of holding
+        /// them in memory until the merge.  Memory use is then
+        /// bounded by \c maxBuffers input buffers, which must be
+        /// positive.  This must be called before the first put().
+        void setRunStore(run_store_handle_t const & store)
+        {
+            using namespace ex;
+
+            if(store && !params.maxBuffers)
+                raise<ValueError>("spilling sort needs positive maxBuffers");
+
+            runStore = store;
+            if(runStore && params.readAheadSize && !readAheadPool)
+            {
+                readAheadPool.reset(
+                    new warp::WorkerPool(params.nSortWorkers,
+                                         "AsyncSort read-ahead", false));
+            }
+        }
+
         virtual void put(T const & x)
         {
-            // Get an accumulation buffer if we don't already have one
+            // Get an accumulation buffer if we don't already have
+            // one.  When spilling, buffers always come back from the
+            // sort workers, so wait for one.
             if(!putBuf)
             {
-                if(!freeQueue.pop(putBuf, isMerging))
+                if(!freeQueue.pop(putBuf, isMerging || runStore))
                     putBuf.reset(new buf_t());
                 putBufSize = 0;
             }
@@ -264,6 +337,12 @@ namespace flux
             if(!job.second)
                 return true;
 
+            if(runStore)
+            {
+                mergeSpilledRuns(job);
+                return true;
+            }
+
             // Set merging flag
             isMerging = true;
 
@@ -298,6 +377,84 @@ namespace flux
             return true;
         }
 
+        /// Merge the given runs from the store into the output stream
+        /// and remove them.
+        void mergeRuns(std::vector<size_t> const & runs,
+                       Stream<T> & out)
+        {
+            base_handle_t merge = makeMerge<T>(lt);
+            for(std::vector<size_t>::const_iterator ri = runs.begin();
+                ri != runs.end(); ++ri)
+            {
+                base_handle_t input = runStore->openRun(*ri);
+                if(readAheadPool)
+                {
+                    typename ThreadedReader<T,Sz>::handle_t reader =
+                        makeThreadedReader<T>(
+                            *readAheadPool, params.readAheadSize,
+                            std::max(params.readAheadSize / 4, size_t(1)),
+                            sz);
+                    reader->pipeFrom(input);
+                    reader->start();
+                    input = reader;
+                }
+                merge->pipeFrom(input);
+            }
+
+            // Copy merge stream to output (includes flush)
+            copyStream(*merge, out);
+
+            // Close the inputs before removing them
+            merge.reset();
+            for(std::vector<size_t>::const_iterator ri = runs.begin();
+                ri != runs.end(); ++ri)
+            {
+                runStore->removeRun(*ri);
+            }
+        }
+
+        void mergeSpilledRuns(merge_job_t const & job)
+        {
+            using namespace ex;
+
+            std::deque<size_t> runs;
+            for(size_t i = 0; i < job.second; ++i)
+            {
+                size_t runId;
+                if(!mergeRunQueue[job.first].pop(runId))
+                    raise<RuntimeError>("missing run for merge");
+                runs.push_back(runId);
+            }
+
+            // Merge the oldest runs into a new one until the rest can
+            // be merged at once
+            size_t fanIn = std::max(params.maxMergeFanIn, size_t(2));
+            while(runs.size() > fanIn)
+            {
+                std::vector<size_t> group(runs.begin(),
+                                          runs.begin() + fanIn);
+                runs.erase(runs.begin(), runs.begin() + fanIn);
+
+                size_t runId;
+                base_handle_t out = runStore->createRun(runId);
+                mergeRuns(group, *out);
+                out.reset();
+                runs.push_back(runId);
+            }
+
+            std::vector<size_t> group(runs.begin(), runs.end());
+            if(output)
+                mergeRuns(group, *output);
+            else
+            {
+                for(std::vector<size_t>::const_iterator ri = group.begin();
+                    ri != group.end(); ++ri)
+                {
+                    runStore->removeRun(*ri);
+                }
+            }
+        }
+
         void mergeWorkerLoop()
         {
             using namespace ex;
@@ -337,6 +494,22 @@ namespace flux
                     // Sort buffer
                     std::sort(job.first->begin(), job.first->end(), rlt);
 
+                    if(runStore)
+                    {
+                        // Write the run out (popping from the back
+                        // gives ascending order) and recycle the
+                        // buffer
+                        size_t runId;
+                        base_handle_t out = runStore->createRun(runId);
+                        copyStream(*job.first, *out);
+                        out.reset();
+
+                        job.first->clear();
+                        freeQueue.push(job.first);
+                        mergeRunQueue[job.second].push(runId);
+                        continue;
+                    }
+
                     // Put result in output queue
                     mergeBufferQueue[job.second].push(job.first);
                 }
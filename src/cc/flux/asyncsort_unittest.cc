@@ -0,0 +1,129 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <flux/asyncsort.h>
+#include <flux/sequence.h>
+#include <unittest/main.h>
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <stdlib.h>
+
+using namespace flux;
+using namespace std;
+
+namespace {
+
+    /// Keep spilled runs in memory
+    class MemoryRunStore : public RunStore<int>
+    {
+        typedef Sequence< deque<int> > run_t;
+        typedef boost::mutex::scoped_lock lock_t;
+
+        boost::mutex mutex;
+        map<size_t, run_t::handle_t> runs;
+        size_t nextRunId;
+
+    public:
+        MemoryRunStore() : nextRunId(0) {}
+
+        stream_handle_t createRun(size_t & runId)
+        {
+            lock_t lock(mutex);
+            runId = nextRunId++;
+            run_t::handle_t run(new run_t);
+            runs[runId] = run;
+            return run;
+        }
+
+        stream_handle_t openRun(size_t runId)
+        {
+            lock_t lock(mutex);
+            run_t const & run = *runs[runId];
+            run_t::handle_t copy(new run_t(run.begin(), run.end()));
+            return copy;
+        }
+
+        void removeRun(size_t runId)
+        {
+            lock_t lock(mutex);
+            runs.erase(runId);
+        }
+
+        size_t getRunCount() const { return nextRunId; }
+        size_t getLiveRunCount() const { return runs.size(); }
+    };
+
+    void testSpill(bool asyncOutput, size_t readAheadSize)
+    {
+        // Small buffers and fan-in, to force several merge passes
+        AsyncSortParams params;
+        params.dispatchThreshold = 100 * sizeof(int);
+        params.maxBuffers = 3;
+        params.maxMergeFanIn = 4;
+        params.readAheadSize = readAheadSize;
+        params.asyncOutput = asyncOutput;
+
+        boost::shared_ptr<MemoryRunStore> store(new MemoryRunStore);
+        Sequence< vector<int> >::handle_t out(new Sequence< vector<int> >);
+
+        vector<int> expected;
+        {
+            AsyncSort<int>::handle_t sorter = makeAsyncSort<int>(params);
+            sorter->setRunStore(store);
+            sorter->pipeTo(out);
+
+            srand(42);
+            for(size_t i = 0; i < 5000; ++i)
+            {
+                int x = rand() % 1000;
+                sorter->put(x);
+                expected.push_back(x);
+            }
+        }
+        sort(expected.begin(), expected.end());
+
+        BOOST_CHECK_EQUAL(out->size(), expected.size());
+        BOOST_CHECK(equal(expected.begin(), expected.end(), out->begin()));
+
+        // 50 initial runs, merged 4 at a time until 4 are left
+        BOOST_CHECK(store->getRunCount() > 50u);
+        BOOST_CHECK_EQUAL(store->getLiveRunCount(), 0u);
+    }
+}
+
+BOOST_AUTO_UNIT_TEST(spill_sync_test)
+{
+    testSpill(false, 0);
+}
+
+BOOST_AUTO_UNIT_TEST(spill_async_read_ahead_test)
+{
+    testSpill(true, 64 * sizeof(int));
+}
+
+BOOST_AUTO_UNIT_TEST(spill_needs_buffers_test)
+{
+    AsyncSort<int>::handle_t sorter = makeAsyncSort<int>();
+    boost::shared_ptr<MemoryRunStore> store(new MemoryRunStore);
+    BOOST_CHECK_THROW(sorter->setRunStore(store), ex::ValueError);
+}
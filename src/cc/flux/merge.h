@@ -165,6 +165,54 @@ public:
         inputChanged = true;
     }
 
+    /// Replace the set of merge inputs with the streams in the range
+    /// [first, last), given in merge order.  Streams that were
+    /// already inputs to the merge keep their current position and
+    /// any buffered value, so the merge continues where it left off
+    /// without rereading them.  Old inputs not in the new set are
+    /// released.  New inputs are read on the next call to get().
+    template <class It>
+    void replaceInputs(It first, It last)
+    {
+        using namespace ex;
+
+        list_t newInputs;
+        size_t nInputs = 0;
+        for(; first != last; ++first, ++nInputs)
+        {
+            base_handle_t const & stream = *first;
+            if(!stream)
+                raise<ValueError>("null input");
+
+            typename list_t::iterator it = inputs.begin();
+            while(it != inputs.end() && it->stream != stream)
+                ++it;
+
+            if(it != inputs.end())
+            {
+                // Keep the existing input, but give it a new rank
+                newInputs.splice(newInputs.end(), inputs, it);
+                newInputs.back().index = nInputs;
+            }
+            else
+            {
+                newInputs.push_back(Input(stream, nInputs));
+            }
+        }
+
+        // Rebuild the heap from the inputs that still have values.
+        // Ranks may have changed, so the old heap order is no good.
+        minHeap.clear();
+        inputs.swap(newInputs);
+        for(typename list_t::iterator it = inputs.begin();
+            it != inputs.end(); ++it)
+        {
+            if(it->hasValue)
+                minHeap.push(&*it);
+        }
+        inputChanged = true;
+    }
+
     bool get(T & x)
     {
         if(inputChanged)
@@ -83,3 +83,41 @@ BOOST_AUTO_UNIT_TEST(merge_unique_int)
     }
     BOOST_CHECK(!m->get(x));
 }
+
+BOOST_AUTO_UNIT_TEST(merge_replace_inputs)
+{
+    int const A[] = { 1, 3, 5, 7, 9, 11 };
+    int const B[] = { 2, 4, 6, 8, 10, 12 };
+    int const C[] = { 6, 8, 10 };
+
+    // After replacing B with C at 4: A continues from 5, C is read
+    // from the start, and the rest of B is dropped
+    int const M[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+    typedef Stream<int>::handle_t handle_t;
+    handle_t a(new Sequence< deque<int> >(deque<int>(A, A+sizeof(A)/sizeof(*A))));
+    handle_t b(new Sequence< deque<int> >(deque<int>(B, B+sizeof(B)/sizeof(*B))));
+    handle_t c(new Sequence< deque<int> >(deque<int>(C, C+sizeof(C)/sizeof(*C))));
+
+    Merge<int>::handle_t m = makeMergeUnique<int>();
+    m->pipeFrom(a);
+    m->pipeFrom(b);
+
+    int x;
+    size_t i = 0;
+    for(; i < 4; ++i)
+    {
+        BOOST_CHECK(m->get(x));
+        BOOST_CHECK_EQUAL(x, M[i]);
+    }
+
+    handle_t inputs[] = { c, a };
+    m->replaceInputs(inputs, inputs + 2);
+
+    for(; i < sizeof(M)/sizeof(*M); ++i)
+    {
+        BOOST_CHECK(m->get(x));
+        BOOST_CHECK_EQUAL(x, M[i]);
+    }
+    BOOST_CHECK(!m->get(x));
+}
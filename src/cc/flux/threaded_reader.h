@@ -190,19 +190,26 @@ namespace flux {
                 task->cancel();
         }
 
-        bool get(T & x)
+        /// Start reading ahead from the input now instead of waiting
+        /// for the first call to get().  This lets several readers
+        /// fill their buffers in parallel.
+        void start()
         {
-            if(!task)
+            if(!task && input)
             {
-                if(!input)
-                    return false;
-
                 task.reset(
                     new ReadTask(
                         pool, input, readAhead, readUpTo, sizeOfT
                         )
                     );
             }
+        }
+
+        bool get(T & x)
+        {
+            start();
+            if(!task)
+                return false;
 
             return task->get(x);
         }
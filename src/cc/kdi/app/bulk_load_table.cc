@@ -0,0 +1,360 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-12
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <kdi/app/bulk_load_table.h>
+#include <kdi/net/net_table.h>
+#include <kdi/meta/meta_util.h>
+#include <kdi/local/disk_table.h>
+#include <kdi/local/disk_table_writer.h>
+#include <kdi/cell_merge.h>
+#include <kdi/scan_predicate.h>
+#include <flux/asyncsort.h>
+#include <warp/file.h>
+#include <warp/fs.h>
+#include <warp/uri.h>
+#include <warp/log.h>
+#include <ex/exception.h>
+#include <functional>
+#include <unistd.h>
+
+using namespace kdi;
+using namespace kdi::app;
+using namespace warp;
+using namespace ex;
+using namespace std;
+
+namespace {
+
+    size_t const BLOCK_SIZE = 64 << 10;
+
+    struct SizeOfCell
+    {
+        size_t operator()(Cell const & x) const
+        {
+            return sizeof(Cell) + x.getRow().size() + x.getColumn().size()
+                + x.getValue().size();
+        }
+    };
+
+    std::string getAbsolutePath(std::string const & dir)
+    {
+        if(fs::isRooted(dir))
+            return dir;
+
+        char buf[4096];
+        if(!getcwd(buf, sizeof(buf)))
+            raise<IOError>("couldn't get working directory: %s",
+                           getStdError());
+        return fs::resolve(std::string(buf) + "/", dir);
+    }
+
+}
+
+//----------------------------------------------------------------------------
+// BulkLoadTable::RunWriter
+//----------------------------------------------------------------------------
+/// Writes each sorted batch from the Sorter to its own spill file.
+class BulkLoadTable::RunWriter
+    : public CellStream
+{
+    BulkLoadTable * table;
+    kdi::local::DiskTableWriterV1 writer;
+    std::string fn;
+    bool isOpen;
+
+public:
+    explicit RunWriter(BulkLoadTable * table) :
+        table(table), writer(BLOCK_SIZE), isOpen(false) {}
+
+    void put(Cell const & x)
+    {
+        if(!isOpen)
+        {
+            fn = table->getUniqueFile("run");
+            writer.open(fn);
+            isOpen = true;
+        }
+        writer.put(x);
+    }
+
+    void flush()
+    {
+        if(!isOpen)
+            return;
+
+        writer.close();
+        isOpen = false;
+        table->addRun(fn);
+    }
+};
+
+//----------------------------------------------------------------------------
+// BulkLoadTable::Sorter
+//----------------------------------------------------------------------------
+class BulkLoadTable::Sorter
+    : public flux::AsyncSort<Cell, std::less<Cell>, SizeOfCell>
+{
+    typedef flux::AsyncSort<Cell, std::less<Cell>, SizeOfCell> super;
+
+    static flux::AsyncSortParams getParams(size_t sortMemory)
+    {
+        // Sort in a few chunks so the workers have something to do,
+        // and merge synchronously so each flush() leaves a complete
+        // run on disk
+        flux::AsyncSortParams params;
+        params.dispatchThreshold = std::max(sortMemory / 4, size_t(1) << 20);
+        params.asyncOutput = false;
+        return params;
+    }
+
+public:
+    Sorter(BulkLoadTable * table, size_t sortMemory) :
+        super(getParams(sortMemory))
+    {
+        CellStreamPtr output(new RunWriter(table));
+        pipeTo(output);
+    }
+};
+
+//----------------------------------------------------------------------------
+// BulkLoadTable
+//----------------------------------------------------------------------------
+BulkLoadTable::BulkLoadTable(std::string const & tableUri,
+                             std::string const & workDir,
+                             size_t sortMemory) :
+    tableUri(tableUri),
+    workDir(getAbsolutePath(workDir)),
+    sortMemory(sortMemory),
+    sortBytes(0),
+    nCells(0),
+    nFragments(0)
+{
+    if(uriTopScheme(tableUri) != "kdi")
+        raise<ValueError>("bulk load needs a kdi:// table: %s", tableUri);
+    if(!sortMemory)
+        raise<ValueError>("need positive sort memory");
+
+    fs::makedirs(this->workDir);
+}
+
+BulkLoadTable::~BulkLoadTable()
+{
+    // Drop anything that wasn't synced
+    sorter.reset();
+
+    lock_t lock(runMutex);
+    for(vector<string>::const_iterator i = runs.begin();
+        i != runs.end(); ++i)
+    {
+        fs::remove(*i);
+    }
+}
+
+void BulkLoadTable::set(strref_t row, strref_t column, int64_t timestamp,
+                        strref_t value)
+{
+    put(makeCell(row, column, timestamp, value));
+}
+
+void BulkLoadTable::erase(strref_t row, strref_t column, int64_t timestamp)
+{
+    put(makeCellErasure(row, column, timestamp));
+}
+
+CellStreamPtr BulkLoadTable::scan(ScanPredicate const & pred) const
+{
+    EX_UNIMPLEMENTED_FUNCTION;
+}
+
+void BulkLoadTable::put(Cell const & x)
+{
+    if(!sorter)
+        sorter.reset(new Sorter(this, sortMemory));
+
+    sorter->put(x);
+    ++nCells;
+
+    // Spill a sorted run when we've buffered enough
+    sortBytes += SizeOfCell()(x);
+    if(sortBytes >= sortMemory)
+    {
+        sorter->flush();
+        sortBytes = 0;
+    }
+}
+
+void BulkLoadTable::addRun(std::string const & fn)
+{
+    log("BulkLoadTable: wrote sorted run %s", fn);
+
+    lock_t lock(runMutex);
+    runs.push_back(fn);
+}
+
+std::string BulkLoadTable::getUniqueFile(char const * prefix) const
+{
+    return File::openUnique(
+        fs::resolve(workDir, string(prefix) + "-$UNIQUE")).second;
+}
+
+void BulkLoadTable::sync()
+{
+    // Spill the last run and shut down the sort workers
+    if(sorter)
+    {
+        sorter->flush();
+        sorter.reset();
+        sortBytes = 0;
+    }
+
+    vector<string> loadRuns;
+    {
+        lock_t lock(runMutex);
+        loadRuns.swap(runs);
+    }
+
+    if(loadRuns.empty())
+        return;
+
+    log("BulkLoadTable: merging %d run(s) of %d cell(s)",
+        loadRuns.size(), nCells);
+
+    // Merge the runs.  Later runs are added first so they override
+    // earlier runs.  Erasures are kept so they can hide older cells
+    // already in the table.
+    vector<TablePtr> runTables;
+    CellStreamPtr merge = CellMerge::make(false);
+    for(vector<string>::const_reverse_iterator i = loadRuns.rbegin();
+        i != loadRuns.rend(); ++i)
+    {
+        runTables.push_back(kdi::local::DiskTable::loadTable(*i));
+        merge->pipeFrom(runTables.back()->scan());
+    }
+
+    writePartitions(merge);
+    merge.reset();
+    runTables.clear();
+
+    for(vector<string>::const_iterator i = loadRuns.begin();
+        i != loadRuns.end(); ++i)
+    {
+        fs::remove(*i);
+    }
+
+    nCells = 0;
+}
+
+std::vector<BulkLoadTable::Partition> BulkLoadTable::loadPartitions() const
+{
+    string name = fs::path(tableUri);
+    if(!name.empty() && name[0] == '/')
+        name = name.substr(1);
+
+    TablePtr metaTable = Table::open(fs::replacePath(tableUri, "META"));
+    CellStreamPtr metaScan = kdi::meta::metaScan(metaTable, name);
+
+    // Each META row is a tablet.  Tablets without a location cell are
+    // assumed to be on the server named in the table URI.
+    vector<Partition> parts;
+    string metaRow;
+    Cell x;
+    while(metaScan->get(x))
+    {
+        if(parts.empty() || x.getRow() != metaRow)
+        {
+            metaRow = str(x.getRow());
+            parts.push_back(Partition());
+            parts.back().lastRow = kdi::meta::getTabletRowBound(metaRow);
+            parts.back().location = tableUri;
+        }
+
+        if(x.getColumn() == "location")
+            parts.back().location = str(x.getValue());
+    }
+
+    if(parts.empty())
+        raise<RuntimeError>("table has no tablets in META: %s", tableUri);
+
+    return parts;
+}
+
+void BulkLoadTable::writePartitions(CellStreamPtr const & cells)
+{
+    vector<Partition> parts = loadPartitions();
+    vector<Partition>::const_iterator part = parts.begin();
+    IntervalPointOrder<warp::less> lt;
+
+    kdi::local::DiskTableWriterV1 writer(BLOCK_SIZE);
+    string fn;
+    string firstRow;
+    string lastRow;
+    bool isOpen = false;
+
+    Cell x;
+    while(cells->get(x))
+    {
+        // Skip ahead to the tablet containing the cell, finishing the
+        // output for the current tablet if we leave it
+        if(lt(part->lastRow, x.getRow()))
+        {
+            if(isOpen)
+            {
+                writer.close();
+                isOpen = false;
+                loadFragment(*part, fn, firstRow, lastRow);
+            }
+
+            do {
+                if(++part == parts.end())
+                    raise<RuntimeError>("row is past the last tablet "
+                                        "in META: %s", x.getRow());
+            } while(lt(part->lastRow, x.getRow()));
+        }
+
+        if(!isOpen)
+        {
+            fn = getUniqueFile("frag");
+            writer.open(fn);
+            isOpen = true;
+            firstRow = str(x.getRow());
+        }
+
+        if(x.getRow() != lastRow)
+            lastRow = str(x.getRow());
+        writer.put(x);
+    }
+
+    if(isOpen)
+    {
+        writer.close();
+        loadFragment(*part, fn, firstRow, lastRow);
+    }
+}
+
+void BulkLoadTable::loadFragment(Partition const & part,
+                                 std::string const & fn,
+                                 strref_t firstRow, strref_t lastRow)
+{
+    log("BulkLoadTable: loading %s into %s", fn, part.location);
+
+    kdi::net::NetTable table(uriPopScheme(part.location));
+    table.loadFragment(uriPushScheme(fn, "disk"), firstRow, lastRow);
+    ++nFragments;
+}
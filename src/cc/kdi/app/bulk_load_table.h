@@ -0,0 +1,120 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-12
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#ifndef KDI_APP_BULK_LOAD_TABLE_H
+#define KDI_APP_BULK_LOAD_TABLE_H
+
+#include <kdi/table.h>
+#include <warp/interval.h>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <string>
+#include <vector>
+
+namespace kdi {
+namespace app {
+
+    class BulkLoadTable;
+
+} // namespace app
+} // namespace kdi
+
+//----------------------------------------------------------------------------
+// BulkLoadTable
+//----------------------------------------------------------------------------
+/// Write-only table that loads cells into a kdi:// table without
+/// going through the server's commit log.  Cells are sorted in
+/// memory and spilled to disk in sorted runs.  On sync(), the runs
+/// are merged, partitioned by the tablet boundaries in META, and
+/// written out as one DiskTable per tablet.  Each DiskTable is then
+/// handed to the server hosting its tablet, which attaches it to the
+/// tablet's fragment chain.
+///
+/// The work directory must be visible to the servers under the same
+/// path.  If the same cell key is set more than once in a load, the
+/// latest spilled run wins, but within a single run the winner is
+/// arbitrary.
+class kdi::app::BulkLoadTable
+    : public kdi::Table,
+      private boost::noncopyable
+{
+    typedef boost::mutex::scoped_lock lock_t;
+
+    class RunWriter;
+    class Sorter;
+
+    struct Partition
+    {
+        warp::IntervalPoint<std::string> lastRow;
+        std::string location;
+    };
+
+    std::string tableUri;
+    std::string workDir;
+    size_t sortMemory;
+
+    boost::scoped_ptr<Sorter> sorter;
+    size_t sortBytes;
+
+    boost::mutex runMutex;
+    std::vector<std::string> runs;
+
+    size_t nCells;
+    size_t nFragments;
+
+    void put(Cell const & x);
+    void addRun(std::string const & fn);
+    std::string getUniqueFile(char const * prefix) const;
+
+    std::vector<Partition> loadPartitions() const;
+    void writePartitions(CellStreamPtr const & cells);
+    void loadFragment(Partition const & part, std::string const & fn,
+                      strref_t firstRow, strref_t lastRow);
+
+public:
+    /// Bulk load into the given kdi://host:port/table URI, using
+    /// workDir for sorted runs and output fragments.  Up to about
+    /// sortMemory bytes of cells are buffered before a run is spilled
+    /// to disk.
+    BulkLoadTable(std::string const & tableUri,
+                  std::string const & workDir,
+                  size_t sortMemory);
+    ~BulkLoadTable();
+
+    // Table API
+    virtual void set(strref_t row, strref_t column, int64_t timestamp,
+                     strref_t value);
+    virtual void erase(strref_t row, strref_t column, int64_t timestamp);
+    virtual CellStreamPtr scan(ScanPredicate const & pred) const;
+
+    /// Finish the load: merge and partition everything added so far
+    /// and attach it to the table.  More cells may be added after
+    /// sync() returns to start another load.
+    virtual void sync();
+
+    /// Get the number of cells added since the last sync().
+    size_t getCellCount() const { return nCells; }
+
+    /// Get the number of fragments loaded into the table so far.
+    size_t getFragmentCount() const { return nFragments; }
+};
+
+#endif // KDI_APP_BULK_LOAD_TABLE_H
@@ -0,0 +1,182 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <kdi/app/bulk_load_table.h>
+#include <kdi/table.h>
+#include <kdi/scan_predicate.h>
+#include <warp/options.h>
+#include <warp/strutil.h>
+#include <warp/fs.h>
+#include <ex/exception.h>
+#include <iostream>
+#include <string>
+#include <boost/format.hpp>
+
+using namespace kdi;
+using namespace warp;
+using namespace ex;
+using namespace std;
+using boost::format;
+
+//----------------------------------------------------------------------------
+// bulk_load_test
+//----------------------------------------------------------------------------
+// End-to-end test of the bulk load path.  Start a server on an empty
+// root first, e.g.:
+//
+//    kdiNetServer --root /tmp/bulk/data --nodaemon &
+//    bulk_load_test kdi://localhost:10000/bulk /tmp/bulk/data/work
+//
+// The work directory must be under the server root.  The test loads
+// rows in scrambled order with a small sort buffer so the load spills
+// several runs, loads a second set of values over some of the rows,
+// and then reads the table back through the server.
+
+namespace
+{
+    string getRow(size_t i)
+    {
+        return (format("row-%08d") % i).str();
+    }
+
+    string getColumn(size_t j)
+    {
+        return (format("col:%03d") % j).str();
+    }
+
+    string getValue(size_t i, size_t j, int pass)
+    {
+        return (format("v%d-%d-%d") % pass % i % j).str();
+    }
+
+    /// Map 0..n-1 onto itself in a scrambled order
+    size_t scramble(size_t i, size_t n)
+    {
+        // 7919 is prime, so this is a permutation unless n is a
+        // multiple of it
+        return (i * 7919 + 13) % n;
+    }
+
+    /// Second-pass rows get new values
+    bool isUpdated(size_t i)
+    {
+        return i % 10 == 3;
+    }
+}
+
+int main(int ac, char ** av)
+{
+    OptionParser op("%prog [options] <kdi://host:port/table> <work dir>");
+    {
+        using namespace boost::program_options;
+        op.addOption("rows,n", value<size_t>()->default_value(20000),
+                     "Number of rows to load");
+        op.addOption("columns,c", value<size_t>()->default_value(3),
+                     "Number of columns in each row");
+        op.addOption("sortMemory", value<string>()->default_value("256k"),
+                     "Sort memory for the bulk loader");
+        op.addOption("verbose,v", "Be verbose");
+    }
+
+    OptionMap opt;
+    ArgumentList args;
+    op.parseOrBail(ac, av, opt, args);
+
+    if(args.size() != 2)
+        op.error("need table URI and work directory");
+
+    bool verbose = hasopt(opt, "verbose");
+    string const & tableUri = args[0];
+    string const & workDir = args[1];
+
+    size_t nRows, nCols;
+    string mem;
+    opt.get("rows", nRows);
+    opt.get("columns", nCols);
+    opt.get("sortMemory", mem);
+    if(!nRows || nRows % 7919 == 0)
+        op.error("row count must be positive and not a multiple of 7919");
+
+    fs::makedirs(workDir);
+
+    // Load every cell, then overwrite some of them in a second load.
+    // The second load's fragments are newer, so its values win.
+    for(int pass = 1; pass <= 2; ++pass)
+    {
+        kdi::app::BulkLoadTable table(tableUri, workDir, parseSize(mem));
+        for(size_t k = 0; k < nRows; ++k)
+        {
+            size_t i = scramble(k, nRows);
+            if(pass == 2 && !isUpdated(i))
+                continue;
+            for(size_t j = 0; j < nCols; ++j)
+                table.set(getRow(i), getColumn(j), 1, getValue(i, j, pass));
+        }
+
+        size_t nCells = table.getCellCount();
+        table.sync();
+        if(verbose)
+            cerr << format("pass %d: loaded %d cells in %d fragments\n")
+                % pass % nCells % table.getFragmentCount();
+    }
+
+    // Read it all back in order
+    size_t nErrors = 0;
+    size_t nCells = 0;
+    CellStreamPtr scan = Table::open(tableUri)->scan(ScanPredicate());
+    Cell x;
+    while(scan->get(x))
+    {
+        size_t i = nCells / nCols;
+        size_t j = nCells % nCols;
+        ++nCells;
+
+        if(i >= nRows)
+        {
+            if(nErrors++ < 10)
+                cerr << "unexpected cell: " << x << endl;
+            continue;
+        }
+
+        Cell expected = makeCell(getRow(i), getColumn(j), 1,
+                                 getValue(i, j, isUpdated(i) ? 2 : 1));
+        if(!(x == expected) || x.getValue() != expected.getValue())
+        {
+            if(nErrors++ < 10)
+                cerr << "expected " << expected << ", got " << x << endl;
+        }
+    }
+
+    if(nCells != nRows * nCols)
+    {
+        cerr << format("expected %d cells, got %d\n")
+            % (nRows * nCols) % nCells;
+        ++nErrors;
+    }
+
+    if(nErrors)
+    {
+        cerr << "FAILED: " << nErrors << " errors" << endl;
+        return 1;
+    }
+
+    cerr << format("OK: %d cells\n") % nCells;
+    return 0;
+}
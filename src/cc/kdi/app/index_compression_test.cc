@@ -152,6 +152,9 @@ int main(int ac, char ** av)
         IndexStats s;
         using kdi::local::disk::BlockIndexV0;
         using kdi::local::disk::BlockIndexV1;
+        using kdi::local::disk::BlockIndexV2;
+        using kdi::local::disk::BlockIndexV3;
+        using kdi::local::disk::BlockIndexV4;
         if(BlockIndexV0 const * idx = r.tryAs<BlockIndexV0>())
         {
             s.set(*idx);
@@ -162,6 +165,21 @@ int main(int ac, char ** av)
             s.set(*idx);
             cout << "V1 ";
         }
+        else if(BlockIndexV2 const * idx = r.tryAs<BlockIndexV2>())
+        {
+            s.set(*idx);
+            cout << "V2 ";
+        }
+        else if(BlockIndexV3 const * idx = r.tryAs<BlockIndexV3>())
+        {
+            s.set(*idx);
+            cout << "V3 ";
+        }
+        else if(BlockIndexV4 const * idx = r.tryAs<BlockIndexV4>())
+        {
+            s.set(*idx);
+            cout << "V4 ";
+        }
         else
         {
             cout << "V? ";
@@ -0,0 +1,824 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+// Benchmark driver with YCSB-style workloads.  Runs one or more
+// workloads against a table and writes the throughput and latency
+// percentiles of each as JSON, so results can be compared from run
+// to run.
+//
+// The table can be any table URI (e.g. mem:, local:/path, or
+// kdi://host:port/table for a kdiNetServer on loopback).  The special
+// URI tablet:/path runs the tablet server stack in this process,
+// without the network front end, with its data under /path.
+//
+// Workloads:
+//
+//   load        -- insert all records
+//   read        -- 95% read, 5% update
+//   scan        -- 95% short scan, 5% insert
+//   mixed       -- 50% read, 50% update
+//   latest      -- 95% read of recent inserts, 5% insert
+//   compaction  -- 80% update, 20% read, syncing often so the table
+//                  keeps serializing and compacting under the load
+//
+// Every workload but load expects the records to be there already,
+// either from an earlier load in the same run or a previous run with
+// the same --records.
+
+#include <kdi/table.h>
+#include <kdi/scan_predicate.h>
+#include <kdi/synchronized_table.h>
+#include <kdi/tablet/SuperTablet.h>
+#include <kdi/tablet/Tablet.h>
+#include <kdi/tablet/TabletConfig.h>
+#include <kdi/tablet/SharedLogger.h>
+#include <kdi/tablet/SharedCompactor.h>
+#include <kdi/tablet/WorkQueue.h>
+#include <kdi/tablet/FileTracker.h>
+#include <kdi/tablet/MetaConfigManager.h>
+#include <kdi/tablet/AdmissionController.h>
+#include <kdi/tablet/CachedFragmentLoader.h>
+#include <kdi/tablet/CachedLogLoader.h>
+#include <kdi/tablet/DiskFragmentLoader.h>
+#include <kdi/tablet/DiskFragmentWriter.h>
+#include <kdi/tablet/SwitchedFragmentLoader.h>
+#include <warp/WorkStealingPool.h>
+#include <warp/StatTracker.h>
+#include <warp/Histogram.h>
+#include <warp/options.h>
+#include <warp/strutil.h>
+#include <warp/hsieh_hash.h>
+#include <warp/tuple_encode.h>
+#include <warp/timestamp.h>
+#include <warp/timer.h>
+#include <warp/filestream.h>
+#include <warp/uri.h>
+#include <warp/log.h>
+#include <ex/exception.h>
+
+#include <boost/format.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/random/mersenne_twister.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <iostream>
+
+using namespace kdi;
+using namespace warp;
+using namespace ex;
+using namespace std;
+using boost::format;
+
+namespace {
+
+    enum OpType { OP_INSERT, OP_READ, OP_UPDATE, OP_SCAN, N_OP_TYPES };
+
+    char const * const OP_NAMES[N_OP_TYPES] = {
+        "insert", "read", "update", "scan"
+    };
+
+    enum Distribution { DIST_UNIFORM, DIST_ZIPFIAN, DIST_LATEST };
+
+    /// Operation mix of a workload, in percent.
+    struct Workload
+    {
+        char const * name;
+        int mix[N_OP_TYPES];
+        Distribution dist;
+        size_t syncEvery;
+    };
+
+    // Distributions given here are the defaults.  --distribution
+    // overrides all but latest.
+    Workload const WORKLOADS[] = {
+        // name          insert read update scan  dist           sync
+        { "load",       { 100,    0,    0,    0 }, DIST_UNIFORM,  0 },
+        { "read",       {   0,   95,    5,    0 }, DIST_ZIPFIAN,  0 },
+        { "scan",       {   5,    0,    0,   95 }, DIST_ZIPFIAN,  0 },
+        { "mixed",      {   0,   50,   50,    0 }, DIST_ZIPFIAN,  0 },
+        { "latest",     {   5,   95,    0,    0 }, DIST_LATEST,   0 },
+        { "compaction", {   0,   20,   80,    0 }, DIST_ZIPFIAN, 1000 },
+    };
+
+    size_t const N_WORKLOADS = sizeof(WORKLOADS) / sizeof(*WORKLOADS);
+
+    Workload const & findWorkload(strref_t name)
+    {
+        for(size_t i = 0; i < N_WORKLOADS; ++i)
+        {
+            if(name == WORKLOADS[i].name)
+                return WORKLOADS[i];
+        }
+        raise<ValueError>("unknown workload: %s", name);
+        return WORKLOADS[0];    // not reached
+    }
+
+    //------------------------------------------------------------------------
+    // Rng
+    //------------------------------------------------------------------------
+    class Rng
+    {
+        boost::mt19937 gen;
+
+    public:
+        explicit Rng(uint32_t seed) : gen(seed) {}
+
+        /// Uniform in [0, 1)
+        double uniform()
+        {
+            return gen() * (1.0 / 4294967296.0);
+        }
+
+        /// Uniform in [0, n)
+        uint64_t below(uint64_t n)
+        {
+            uint64_t x = (uint64_t(gen()) << 32) | gen();
+            return x % n;
+        }
+    };
+
+    //------------------------------------------------------------------------
+    // Zipfian
+    //------------------------------------------------------------------------
+    /// Zipfian ranks over [0, n) with rank 0 the most popular, using
+    /// the method from Gray et al., "Quickly Generating Billion-Record
+    /// Synthetic Databases" (as in YCSB).
+    class Zipfian
+    {
+        uint64_t n;
+        double theta;
+        double alpha;
+        double zetan;
+        double eta;
+
+        static double zeta(uint64_t n, double theta)
+        {
+            double sum = 0;
+            for(uint64_t i = 1; i <= n; ++i)
+                sum += 1.0 / std::pow(double(i), theta);
+            return sum;
+        }
+
+    public:
+        explicit Zipfian(uint64_t n, double theta = 0.99) :
+            n(n), theta(theta)
+        {
+            alpha = 1.0 / (1.0 - theta);
+            zetan = zeta(n, theta);
+            eta = (1.0 - std::pow(2.0 / n, 1.0 - theta)) /
+                (1.0 - zeta(2, theta) / zetan);
+        }
+
+        uint64_t next(Rng & rng) const
+        {
+            double u = rng.uniform();
+            double uz = u * zetan;
+            if(uz < 1.0)
+                return 0;
+            if(uz < 1.0 + std::pow(0.5, theta))
+                return 1;
+            uint64_t r = uint64_t(n * std::pow(eta * u - eta + 1.0, alpha));
+            return r < n ? r : n - 1;
+        }
+    };
+
+    //------------------------------------------------------------------------
+    // KeySpace
+    //------------------------------------------------------------------------
+    /// Record keys and the count of records inserted so far.  Keys
+    /// start with a hash of the record number so inserts are spread
+    /// over the table instead of all going to the end.
+    class KeySpace
+    {
+        uint64_t nRecords;
+        Zipfian zipf;
+
+        boost::mutex mutex;
+        uint64_t nInserted;
+
+    public:
+        KeySpace(uint64_t nRecords, uint64_t nInserted) :
+            nRecords(nRecords), zipf(nRecords), nInserted(nInserted) {}
+
+        static string getKey(uint64_t id)
+        {
+            uint32_t h = hsieh_hash(&id, sizeof(id));
+            return (format("user%08x%012d") % h % id).str();
+        }
+
+        /// Get an exclusive upper bound for a scan of \c nRows
+        /// records starting at record \c id.  Keys are in hash order,
+        /// so the bound covers the part of the hash space expected to
+        /// hold four times that many records.  Returns an empty string
+        /// if the bound is past the end of the key space.
+        string getScanLimit(uint64_t id, size_t nRows)
+        {
+            uint64_t n = std::max(getInsertedCount(), uint64_t(1));
+            uint32_t h = hsieh_hash(&id, sizeof(id));
+            uint64_t end = h + (uint64_t(nRows) << 34) / n + 1;
+            if(end > 0xffffffffu)
+                return string();
+            return (format("user%08x") % end).str();
+        }
+
+        uint64_t getInsertedCount()
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            return nInserted;
+        }
+
+        /// Claim the next record number to insert
+        uint64_t nextInsert()
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            return nInserted++;
+        }
+
+        /// Choose an existing record
+        uint64_t choose(Distribution dist, Rng & rng)
+        {
+            uint64_t n = getInsertedCount();
+            if(!n)
+                raise<RuntimeError>("no records in table; run load first");
+
+            switch(dist)
+            {
+                case DIST_UNIFORM:
+                    return rng.below(n);
+
+                case DIST_LATEST:
+                    return n - 1 - zipf.next(rng) % n;
+
+                case DIST_ZIPFIAN:
+                default:
+                {
+                    // Scatter the popular ranks over the key space
+                    uint64_t r = zipf.next(rng);
+                    return hsieh_hash(&r, sizeof(r)) % n;
+                }
+            }
+        }
+
+        uint64_t getRecordCount() const { return nRecords; }
+    };
+
+    //------------------------------------------------------------------------
+    // BenchConfig
+    //------------------------------------------------------------------------
+    struct BenchConfig
+    {
+        uint64_t nRecords;
+        uint64_t nOps;
+        size_t nThreads;
+        size_t nFields;
+        size_t valueSize;
+        size_t maxScanRows;
+        bool distOverride;
+        Distribution dist;
+        uint32_t seed;
+    };
+
+    //------------------------------------------------------------------------
+    // Worker
+    //------------------------------------------------------------------------
+    class Worker
+    {
+        Table & table;
+        BenchConfig const & cfg;
+        Workload const & workload;
+        KeySpace & keys;
+        uint64_t nOps;
+        Rng rng;
+        string value;
+        vector<string> fields;
+
+        Distribution getDistribution() const
+        {
+            if(cfg.distOverride && workload.dist != DIST_LATEST)
+                return cfg.dist;
+            return workload.dist;
+        }
+
+        void insert(uint64_t id)
+        {
+            string row = KeySpace::getKey(id);
+            int64_t ts = Timestamp::now();
+            for(size_t i = 0; i < fields.size(); ++i)
+                table.set(row, fields[i], ts, value);
+        }
+
+        void read(uint64_t id)
+        {
+            string row = KeySpace::getKey(id);
+            vector<RowColumn> keys;
+            for(size_t i = 0; i < fields.size(); ++i)
+                keys.push_back(make_pair(row, fields[i]));
+
+            vector<Cell> cells;
+            table.multiGet(keys, 1, cells);
+        }
+
+        void update(uint64_t id)
+        {
+            table.set(KeySpace::getKey(id),
+                      fields[rng.below(fields.size())],
+                      Timestamp::now(), value);
+        }
+
+        void scan(uint64_t id)
+        {
+            size_t nRows = 1 + rng.below(cfg.maxScanRows);
+
+            // Bound the scan so the table doesn't read ahead past the
+            // rows we want
+            Interval<string> rows;
+            rows.setLowerBound(KeySpace::getKey(id), BT_INCLUSIVE);
+            string limit = keys.getScanLimit(id, nRows);
+            if(limit.empty())
+                rows.unsetUpperBound();
+            else
+                rows.setUpperBound(limit, BT_EXCLUSIVE);
+
+            ScanPredicate pred;
+            pred.setRowPredicate(IntervalSet<string>().add(rows));
+
+            CellStreamPtr cells = table.scan(pred);
+            string lastRow;
+            size_t rowsSeen = 0;
+            Cell x;
+            while(cells->get(x))
+            {
+                if(!rowsSeen || x.getRow() != lastRow)
+                {
+                    if(rowsSeen == nRows)
+                        break;
+                    ++rowsSeen;
+                    lastRow = x.getRow().toString();
+                }
+            }
+        }
+
+        OpType chooseOp()
+        {
+            int p = int(rng.below(100));
+            for(int op = 0; op < N_OP_TYPES; ++op)
+            {
+                p -= workload.mix[op];
+                if(p < 0)
+                    return OpType(op);
+            }
+            return OP_READ;
+        }
+
+    public:
+        Histogram latency[N_OP_TYPES];
+
+        Worker(Table & table, BenchConfig const & cfg,
+               Workload const & workload, KeySpace & keys,
+               uint64_t nOps, uint32_t seed) :
+            table(table), cfg(cfg), workload(workload), keys(keys),
+            nOps(nOps), rng(seed), value(cfg.valueSize, 'x')
+        {
+            for(size_t i = 0; i < cfg.nFields; ++i)
+                fields.push_back((format("f:%d") % i).str());
+        }
+
+        void run()
+        {
+            Distribution dist = getDistribution();
+            for(uint64_t i = 0; i < nOps; ++i)
+            {
+                OpType op = chooseOp();
+
+                WallTimer timer;
+                switch(op)
+                {
+                    case OP_INSERT:
+                        insert(keys.nextInsert());
+                        break;
+                    case OP_READ:
+                        read(keys.choose(dist, rng));
+                        break;
+                    case OP_UPDATE:
+                        update(keys.choose(dist, rng));
+                        break;
+                    case OP_SCAN:
+                        scan(keys.choose(dist, rng));
+                        break;
+                    default:
+                        break;
+                }
+                latency[op].add(timer.getElapsedNs() / 1000);
+
+                if(workload.syncEvery && (i + 1) % workload.syncEvery == 0)
+                    table.sync();
+            }
+        }
+    };
+
+    void runWorker(Worker * w)
+    {
+        try {
+            w->run();
+        }
+        catch(std::exception const & ex) {
+            cerr << "benchmark thread failed: " << ex.what() << endl;
+            _exit(1);
+        }
+    }
+
+    //------------------------------------------------------------------------
+    // RunResult
+    //------------------------------------------------------------------------
+    struct RunResult
+    {
+        string workload;
+        uint64_t nOps;
+        double elapsed;
+        Histogram latency[N_OP_TYPES];
+    };
+
+    RunResult runWorkload(Table & table, BenchConfig const & cfg,
+                          Workload const & workload, KeySpace & keys,
+                          uint32_t seed)
+    {
+        uint64_t nOps = cfg.nOps;
+        if(!workload.mix[OP_READ] && !workload.mix[OP_UPDATE] &&
+           !workload.mix[OP_SCAN])
+        {
+            // Load inserts the records that aren't there yet
+            uint64_t have = keys.getInsertedCount();
+            nOps = keys.getRecordCount() > have ?
+                keys.getRecordCount() - have : 0;
+        }
+
+        log("Running %s: %d ops on %d thread(s)",
+            workload.name, nOps, cfg.nThreads);
+
+        boost::ptr_vector<Worker> workers;
+        for(size_t i = 0; i < cfg.nThreads; ++i)
+        {
+            uint64_t n = nOps / cfg.nThreads +
+                (i < nOps % cfg.nThreads ? 1 : 0);
+            workers.push_back(
+                new Worker(table, cfg, workload, keys, n,
+                           seed * 1000003u + i));
+        }
+
+        WallTimer timer;
+        {
+            boost::thread_group group;
+            for(size_t i = 0; i < workers.size(); ++i)
+                group.create_thread(boost::bind(&runWorker, &workers[i]));
+            group.join_all();
+        }
+        table.sync();
+
+        RunResult r;
+        r.workload = workload.name;
+        r.nOps = nOps;
+        r.elapsed = timer.getElapsedNs() * 1e-9;
+        for(size_t i = 0; i < workers.size(); ++i)
+        {
+            for(int op = 0; op < N_OP_TYPES; ++op)
+                r.latency[op].merge(workers[i].latency[op]);
+        }
+
+        log("Finished %s: %.1f ops/s", workload.name,
+            r.elapsed > 0 ? r.nOps / r.elapsed : 0.0);
+        return r;
+    }
+
+    //------------------------------------------------------------------------
+    // JSON output
+    //------------------------------------------------------------------------
+    string jsonString(strref_t s)
+    {
+        string r("\"");
+        for(char const * p = s.begin(); p != s.end(); ++p)
+        {
+            unsigned char c = *p;
+            if(c == '"' || c == '\\')
+                (r += '\\') += c;
+            else if(c < 0x20)
+                r += (format("\\u%04x") % int(c)).str();
+            else
+                r += c;
+        }
+        return r += '"';
+    }
+
+    void writeLatency(ostream & out, Histogram const & h)
+    {
+        out << format("{\"count\": %d, \"mean\": %.1f, \"p50\": %d, "
+                      "\"p90\": %d, \"p99\": %d, \"p999\": %d, "
+                      "\"max\": %d}")
+            % h.getCount() % h.getMean() % h.getPercentile(50)
+            % h.getPercentile(90) % h.getPercentile(99)
+            % h.getPercentile(99.9) % h.getMax();
+    }
+
+    void writeJson(ostream & out, string const & tableUri,
+                   BenchConfig const & cfg,
+                   vector<RunResult> const & runs)
+    {
+        static char const * const DIST_NAMES[] = {
+            "uniform", "zipfian", "latest"
+        };
+
+        out << "{" << endl
+            << "  \"table\": " << jsonString(tableUri) << "," << endl
+            << "  \"records\": " << cfg.nRecords << "," << endl
+            << "  \"operations\": " << cfg.nOps << "," << endl
+            << "  \"threads\": " << cfg.nThreads << "," << endl
+            << "  \"fields\": " << cfg.nFields << "," << endl
+            << "  \"valueSize\": " << cfg.valueSize << "," << endl
+            << "  \"distribution\": "
+            << (cfg.distOverride ? jsonString(DIST_NAMES[cfg.dist])
+                : string("null")) << "," << endl
+            << "  \"runs\": [";
+
+        for(size_t i = 0; i < runs.size(); ++i)
+        {
+            RunResult const & r = runs[i];
+            out << (i ? "," : "") << endl
+                << "    {" << endl
+                << "      \"workload\": " << jsonString(r.workload)
+                << "," << endl
+                << "      \"operations\": " << r.nOps << "," << endl
+                << format("      \"elapsedSec\": %.3f,") % r.elapsed
+                << endl
+                << format("      \"opsPerSec\": %.1f,")
+                   % (r.elapsed > 0 ? r.nOps / r.elapsed : 0.0)
+                << endl
+                << "      \"latencyUs\": {";
+
+            bool first = true;
+            for(int op = 0; op < N_OP_TYPES; ++op)
+            {
+                if(!r.latency[op].getCount())
+                    continue;
+                out << (first ? "" : ",") << endl
+                    << "        " << jsonString(OP_NAMES[op]) << ": ";
+                writeLatency(out, r.latency[op]);
+                first = false;
+            }
+            out << endl << "      }" << endl << "    }";
+        }
+        out << endl << "  ]" << endl << "}" << endl;
+    }
+}
+
+//----------------------------------------------------------------------------
+// LocalTabletServer
+//----------------------------------------------------------------------------
+namespace {
+
+    using namespace kdi::tablet;
+
+    /// The tablet server stack kdiNetServer puts together, without
+    /// the network front end, serving tables in this process.
+    class LocalTabletServer
+    {
+        NullStatTracker stats;
+
+        boost::scoped_ptr<WorkStealingPool> pool;
+        boost::scoped_ptr<AdmissionController> admission;
+        MetaConfigManagerPtr configMgr;
+        FileTrackerPtr tracker;
+
+        boost::scoped_ptr<DiskFragmentLoader>   diskLoader;
+        boost::scoped_ptr<CachedFragmentLoader> cachedDiskLoader;
+        boost::scoped_ptr<DiskFragmentWriter>   logWriter;
+        boost::scoped_ptr<CachedLogLoader>      cachedLogLoader;
+        SwitchedFragmentLoader                  loader;
+
+        boost::scoped_ptr<DiskFragmentWriter> loggerWriter;
+        boost::scoped_ptr<DiskFragmentWriter> compactorWriter;
+
+        SharedLoggerPtr logger;
+        SharedCompactorPtr compactor;
+        WorkQueuePtr workQueue;
+        TablePtr metaTable;
+
+    public:
+        explicit LocalTabletServer(string const & root) :
+            pool(new WorkStealingPool(4, "Bench server pool", false)),
+            admission(new AdmissionController(&stats)),
+            configMgr(new MetaConfigManager(root)),
+            tracker(new FileTracker)
+        {
+            diskLoader.reset(new DiskFragmentLoader(&stats));
+            cachedDiskLoader.reset(
+                new CachedFragmentLoader(diskLoader.get()));
+            logWriter.reset(new DiskFragmentWriter(configMgr));
+            cachedLogLoader.reset(
+                new CachedLogLoader(cachedDiskLoader.get(),
+                                    logWriter.get()));
+            loader.setLoader("disk", cachedDiskLoader.get());
+            loader.setLoader("sharedlog", cachedLogLoader.get());
+
+            loggerWriter.reset(new DiskFragmentWriter(configMgr));
+            compactorWriter.reset(new DiskFragmentWriter(configMgr));
+
+            logger.reset(
+                new SharedLogger(configMgr, &loader, loggerWriter.get(),
+                                 tracker, &stats, admission.get()));
+            compactor.reset(
+                new SharedCompactor(&loader, compactorWriter.get(),
+                                    &stats, pool.get(),
+                                    admission.get()));
+            workQueue.reset(
+                new WorkQueue(*pool, WorkStealingPool::FOREGROUND, 1));
+
+            ConfigManagerPtr fixedMgr = configMgr->getFixedAdapter();
+            std::list<TabletConfig> cfgs =
+                fixedMgr->loadTabletConfigs("META");
+            if(cfgs.size() != 1)
+                raise<RuntimeError>("loaded %d configs for META table",
+                                    cfgs.size());
+
+            metaTable = Tablet::make("META", fixedMgr, &loader, logger,
+                                     compactor, tracker, workQueue,
+                                     cfgs.front());
+            configMgr->setMetaTable(metaTable);
+        }
+
+        ~LocalTabletServer()
+        {
+            metaTable.reset();
+
+            compactor->shutdown();
+            workQueue->shutdown();
+            logger->shutdown();
+            pool->shutdown();
+        }
+
+        TablePtr openTable(string const & name)
+        {
+            try {
+                return TablePtr(
+                    new SuperTablet(name, configMgr, &loader, logger,
+                                    compactor, tracker, workQueue));
+            }
+            catch(TableDoesNotExistError const &) {
+                metaTable->set(encodeTuple(make_tuple(name, "\x02", "")),
+                               "config", 0, "");
+                metaTable->sync();
+
+                return TablePtr(
+                    new SuperTablet(name, configMgr, &loader, logger,
+                                    compactor, tracker, workQueue));
+            }
+        }
+    };
+}
+
+//----------------------------------------------------------------------------
+// main
+//----------------------------------------------------------------------------
+int main(int ac, char ** av)
+{
+    OptionParser op("%prog [options] <table-URI>");
+    {
+        using namespace boost::program_options;
+        op.addOption("workloads,w",
+                     value<string>()->default_value(
+                         "load,read,scan,mixed,latest,compaction"),
+                     "Comma-separated workloads to run in order");
+        op.addOption("records,r", value<string>()->default_value("100k"),
+                     "Number of records to load");
+        op.addOption("ops,n", value<string>()->default_value("100k"),
+                     "Number of operations in each workload after load");
+        op.addOption("threads,t", value<size_t>()->default_value(4),
+                     "Number of client threads");
+        op.addOption("fields", value<size_t>()->default_value(10),
+                     "Number of columns in each record");
+        op.addOption("valuesize", value<string>()->default_value("100"),
+                     "Size of each column value");
+        op.addOption("scanrows", value<size_t>()->default_value(100),
+                     "Maximum rows in a scan");
+        op.addOption("distribution,d", value<string>(),
+                     "Override record choice: uniform or zipfian");
+        op.addOption("seed", value<uint32_t>()->default_value(1),
+                     "Random seed");
+        op.addOption("output,o", value<string>(),
+                     "Write JSON results to file instead of stdout");
+    }
+
+    OptionMap opt;
+    ArgumentList args;
+    op.parseOrBail(ac, av, opt, args);
+
+    if(args.size() != 1)
+        op.error("need one table URI");
+
+    BenchConfig cfg;
+    string arg;
+    opt.get("records", arg);
+    cfg.nRecords = parseSize(arg);
+    opt.get("ops", arg);
+    cfg.nOps = parseSize(arg);
+    opt.get("threads", cfg.nThreads);
+    opt.get("fields", cfg.nFields);
+    opt.get("valuesize", arg);
+    cfg.valueSize = parseSize(arg);
+    opt.get("scanrows", cfg.maxScanRows);
+    opt.get("seed", cfg.seed);
+
+    if(!cfg.nRecords || !cfg.nThreads || !cfg.nFields || !cfg.maxScanRows)
+        op.error("records, threads, fields, and scanrows must be positive");
+
+    cfg.distOverride = opt.get("distribution", arg);
+    cfg.dist = DIST_ZIPFIAN;
+    if(cfg.distOverride)
+    {
+        if(arg == "uniform")
+            cfg.dist = DIST_UNIFORM;
+        else if(arg != "zipfian")
+            op.error("distribution must be uniform or zipfian");
+    }
+
+    vector<Workload const *> workloads;
+    opt.get("workloads", arg);
+    try {
+        char const * p = arg.c_str();
+        char const * end = p + arg.size();
+        while(p != end)
+        {
+            char const * next = std::find(p, end, ',');
+            workloads.push_back(&findWorkload(StringRange(p, next)));
+            p = (next == end ? end : next + 1);
+        }
+    }
+    catch(ValueError const & err) {
+        op.error(err.what());
+    }
+
+    // Open the table
+    string const & tableUri = args[0];
+    boost::scoped_ptr<LocalTabletServer> server;
+    TablePtr table;
+    if(uriTopScheme(tableUri) == "tablet")
+    {
+        server.reset(new LocalTabletServer(uriPopScheme(tableUri)));
+        table = server->openTable("bench");
+    }
+    else
+    {
+        // The workers share the table.  Tablets are thread-safe, but
+        // most other tables are not.
+        table = SynchronizedTable::make(Table::open(tableUri));
+    }
+
+    // Without a load, assume the records are already there
+    bool loading = false;
+    for(size_t i = 0; i < workloads.size(); ++i)
+        loading = loading || (!workloads[i]->mix[OP_READ] &&
+                              !workloads[i]->mix[OP_UPDATE] &&
+                              !workloads[i]->mix[OP_SCAN]);
+    KeySpace keys(cfg.nRecords, loading ? 0 : cfg.nRecords);
+
+    vector<RunResult> runs;
+    for(size_t i = 0; i < workloads.size(); ++i)
+        runs.push_back(runWorkload(*table, cfg, *workloads[i], keys,
+                                   cfg.seed + i));
+
+    table.reset();
+    server.reset();
+
+    string outFn;
+    if(opt.get("output", outFn))
+    {
+        FileStream out(File::output(outFn));
+        writeJson(out, tableUri, cfg, runs);
+        out.close();
+    }
+    else
+        writeJson(cout, tableUri, cfg, runs);
+
+    return 0;
+}
@@ -21,7 +21,10 @@
 #include <kdi/app/scan_visitor.h>
 #include <kdi/table.h>
 #include <kdi/scan_predicate.h>
+#include <kdi/range_erasure.h>
+#include <kdi/timestamp.h>
 #include <warp/options.h>
+#include <warp/strutil.h>
 #include <ex/exception.h>
 #include <iostream>
 #include <boost/format.hpp>
@@ -59,6 +62,49 @@ private:
 };
 
 
+/// Erase the rows selected by the predicate with one range erasure
+/// per row interval, instead of erasing each cell.
+void eraseRows(ArgumentList const & args, ScanPredicate const & pred,
+               int64_t maxTimestamp, bool dryrun, bool verbose)
+{
+    IntervalSet<string> rows;
+    if(pred.getRowPredicate())
+        rows = *pred.getRowPredicate();
+    else
+        rows.add(makeUnboundedInterval<string>());
+
+    for(ArgumentList::const_iterator ti = args.begin();
+        ti != args.end(); ++ti)
+    {
+        TablePtr table;
+        if(!dryrun)
+            table = Table::open(*ti);
+
+        for(IntervalSet<string>::const_iterator i = rows.begin();
+            i != rows.end();)
+        {
+            IntervalPoint<string> const & lo = *i;  ++i;
+            IntervalPoint<string> const & hi = *i;  ++i;
+
+            string firstRow, endRow;
+            if(!getRowRange(Interval<string>(lo, hi), firstRow, endRow))
+                continue;
+
+            if(dryrun || verbose)
+                cout << *ti << ": erase rows [" << reprString(firstRow)
+                     << ", " << (endRow.empty() ? string("END")
+                                 : reprString(endRow))
+                     << ") at or before @" << maxTimestamp << endl;
+            if(!dryrun)
+                table->eraseRowRange(firstRow, endRow, maxTimestamp);
+        }
+
+        if(table)
+            table->sync();
+    }
+}
+
+
 //----------------------------------------------------------------------------
 // main
 //----------------------------------------------------------------------------
@@ -68,6 +114,10 @@ int main(int ac, char ** av)
     {
         using namespace boost::program_options;
         op.addOption("predicate,p", value<string>(), "Predicate expression for scan");
+        op.addOption("rows,r", "Erase whole row ranges from the predicate "
+                     "with range erasures instead of scanning");
+        op.addOption("before,b", value<string>(), "With --rows, only erase "
+                     "cells at or before this time (default now)");
         op.addOption("dryrun,n", "Print cells that would be erased");
         op.addOption("verbose,v", "Be verbose");
     }
@@ -95,6 +145,30 @@ int main(int ac, char ** av)
         }
     }
 
+    if(hasopt(opt, "rows"))
+    {
+        if(pred.getColumnPredicate() || pred.getTimePredicate() ||
+           pred.getMaxHistory())
+        {
+            op.error("--rows only works with row predicates");
+        }
+
+        Timestamp maxTime = Timestamp::now();
+        string arg;
+        if(opt.get("before", arg))
+        {
+            try {
+                maxTime = Timestamp::fromString(arg);
+            }
+            catch(ValueError const & ex) {
+                op.error(ex.what());
+            }
+        }
+
+        eraseRows(args, pred, maxTime, dryrun, verbose);
+        return 0;
+    }
+
     if(dryrun && verbose)
         doScan<CompositeVisitor<VerboseVisitor, CellWriter> >(args, pred);
     else if(dryrun)
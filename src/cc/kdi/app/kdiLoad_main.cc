@@ -19,14 +19,26 @@
 //----------------------------------------------------------------------------
 
 #include <kdi/table.h>
+#include <kdi/app/bulk_load_table.h>
 #include <warp/xml/xml_parser.h>
 #include <warp/options.h>
 #include <warp/vstring.h>
+#include <warp/strutil.h>
+#include <warp/syncqueue.h>
+#include <warp/timer.h>
 #include <ex/exception.h>
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
 #include <string>
 #include <vector>
+#include <map>
+#include <utility>
+#include <algorithm>
 #include <ctype.h>
+#include <unistd.h>
 
 #include <boost/spirit.hpp>
 #include <warp/parsing/timestamp.h>
@@ -43,9 +55,9 @@ using namespace std;
 //----------------------------------------------------------------------------
 namespace
 {
-    bool isWhitespace(Buffer const & b)
+    bool isWhitespace(char const * begin, char const * end)
     {
-        for(char const * p = b.position(); p != b.limit(); ++p)
+        for(char const * p = begin; p != end; ++p)
         {
             if(!isspace(*p))
                 return false;
@@ -53,42 +65,213 @@ namespace
         return true;
     }
 
-    class CounterTable : public kdi::Table
+    size_t getCpuCount()
     {
-        TablePtr table;
-        size_t nSet;
-        
-    public:
-        CounterTable(TablePtr const & table) :
-            table(table), nSet(0)
-        {
-        }
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        return n > 0 ? n : 1;
+    }
+}
 
-        void set(strref_t r, strref_t c, int64_t t, strref_t v)
-        {
-            table->set(r,c,t,v);
-            ++nSet;
-        }
+//----------------------------------------------------------------------------
+// Chunk
+//----------------------------------------------------------------------------
+/// A unit of parser work.  For formats that can be split, this is a
+/// run of complete records read from an input file.  Otherwise it
+/// names a whole input file for the parser to read itself.  Chunks
+/// are numbered in the order they are read.
+struct Chunk
+{
+    string source;
+    off_t offset;
+    string data;
+    size_t seq;
 
-        void erase(strref_t r, strref_t c, int64_t t)
-        {
-            EX_UNIMPLEMENTED_FUNCTION;
-        }
+    Chunk(string const & source, off_t offset) :
+        source(source), offset(offset), seq(0) {}
+};
+
+typedef boost::shared_ptr<Chunk> ChunkPtr;
 
-        void sync()
+//----------------------------------------------------------------------------
+// CellBatch
+//----------------------------------------------------------------------------
+/// A batch of parsed cells on their way to the writers.  The strings
+/// are packed into one buffer to keep allocation down.  Each chunk's
+/// cells go out in numbered batches, and the last batch of the chunk
+/// is marked so ordered writers know when to move on to the next
+/// chunk.
+class CellBatch
+{
+    struct Entry
+    {
+        size_t row;
+        size_t column;
+        size_t value;
+        size_t end;
+        int64_t timestamp;
+    };
+
+    string data;
+    vector<Entry> cells;
+    size_t chunk;
+    size_t index;
+    bool last;
+
+public:
+    CellBatch(size_t chunk, size_t index) :
+        chunk(chunk), index(index), last(false) {}
+
+    void add(strref_t row, strref_t column, int64_t timestamp,
+             strref_t value)
+    {
+        Entry e;
+        e.row = data.size();
+        data.append(row.begin(), row.end());
+        e.column = data.size();
+        data.append(column.begin(), column.end());
+        e.value = data.size();
+        data.append(value.begin(), value.end());
+        e.end = data.size();
+        e.timestamp = timestamp;
+        cells.push_back(e);
+    }
+
+    void apply(Table & table) const
+    {
+        char const * p = data.c_str();
+        for(vector<Entry>::const_iterator i = cells.begin();
+            i != cells.end(); ++i)
         {
-            table->sync();
+            table.set(StringRange(p + i->row, p + i->column),
+                      StringRange(p + i->column, p + i->value),
+                      i->timestamp,
+                      StringRange(p + i->value, p + i->end));
         }
+    }
+
+    size_t size() const { return cells.size(); }
+    size_t getDataSize() const { return data.size(); }
+
+    size_t getChunk() const { return chunk; }
+    size_t getIndex() const { return index; }
+    bool isLast() const { return last; }
+    void setLast() { last = true; }
+};
+
+typedef boost::shared_ptr<CellBatch> CellBatchPtr;
+
+//----------------------------------------------------------------------------
+// LoadStats
+//----------------------------------------------------------------------------
+/// Progress counters shared by all the stages of the load.
+class LoadStats
+{
+    typedef boost::mutex::scoped_lock lock_t;
+
+    mutable boost::mutex mutex;
+    WallTimer timer;
+    int64_t bytesRead;
+    int64_t bytesParsed;
+    int64_t cellsParsed;
+    int64_t cellsWritten;
+    size_t filesDone;
+
+public:
+    LoadStats() :
+        bytesRead(0), bytesParsed(0), cellsParsed(0), cellsWritten(0),
+        filesDone(0) {}
+
+    void addRead(size_t n)    { lock_t l(mutex); bytesRead += n; }
+    void addParsed(size_t n)  { lock_t l(mutex); bytesParsed += n; }
+    void addCells(size_t n)   { lock_t l(mutex); cellsParsed += n; }
+    void addWritten(size_t n) { lock_t l(mutex); cellsWritten += n; }
+    void addFile()            { lock_t l(mutex); ++filesDone; }
+
+    int64_t getCellsWritten() const { lock_t l(mutex); return cellsWritten; }
+
+    void report(char const * what) const
+    {
+        lock_t l(mutex);
+        double t = std::max(timer.getElapsed(), 1e-3);
+        cerr << what << ": "
+             << filesDone << " file(s), "
+             << sizeString(bytesParsed) << "B parsed ("
+             << sizeString(int64_t(bytesParsed / t)) << "B/s), "
+             << cellsParsed << " cell(s) parsed, "
+             << cellsWritten << " written ("
+             << int64_t(cellsWritten / t) << " cells/s)"
+             << endl;
+    }
+};
+
+//----------------------------------------------------------------------------
+// BatchTable
+//----------------------------------------------------------------------------
+/// Write-only table that gathers cells into batches and hands them to
+/// the writer queue.  Each parser thread has its own.
+class BatchTable : public kdi::Table
+{
+    SyncQueue<CellBatchPtr> & output;
+    LoadStats & stats;
+    size_t const maxCells;
+    CellBatchPtr batch;
+
+    enum { MAX_BATCH_DATA = 1 << 20 };
+
+    void send()
+    {
+        stats.addCells(batch->size());
+        if(!output.push(batch))
+            raise<RuntimeError>("load cancelled");
+        batch.reset(new CellBatch(batch->getChunk(), batch->getIndex() + 1));
+    }
+
+public:
+    BatchTable(SyncQueue<CellBatchPtr> & output, LoadStats & stats,
+               size_t maxCells) :
+        output(output), stats(stats), maxCells(maxCells),
+        batch(new CellBatch(0, 0)) {}
 
-        CellStreamPtr scan(ScanPredicate const & pred) const
+    /// Start collecting the cells of the given chunk
+    void startChunk(size_t seq)
+    {
+        batch.reset(new CellBatch(seq, 0));
+    }
+
+    /// Send the last batch of the current chunk, even if it is empty
+    void finishChunk()
+    {
+        batch->setLast();
+        send();
+    }
+
+    void set(strref_t r, strref_t c, int64_t t, strref_t v)
+    {
+        batch->add(r, c, t, v);
+        if(batch->size() >= maxCells ||
+           batch->getDataSize() >= MAX_BATCH_DATA)
         {
-            EX_UNIMPLEMENTED_FUNCTION;
+            sync();
         }
+    }
 
-        size_t getSetCount() const { return nSet; }
-    };
+    void erase(strref_t r, strref_t c, int64_t t)
+    {
+        EX_UNIMPLEMENTED_FUNCTION;
+    }
 
-}
+    /// Send the current batch to the writers
+    void sync()
+    {
+        if(batch->size())
+            send();
+    }
+
+    CellStreamPtr scan(ScanPredicate const & pred) const
+    {
+        EX_UNIMPLEMENTED_FUNCTION;
+    }
+};
 
 //----------------------------------------------------------------------------
 // LoaderBase
@@ -97,9 +280,14 @@ class LoaderBase
 {
 public:
     virtual ~LoaderBase() {}
-    virtual void load(FilePtr const & fp) = 0;
+
+    /// Parse a chunk of input and set its cells in the loader's
+    /// table.  Returns the number of input bytes parsed.
+    virtual size_t load(Chunk const & chunk) = 0;
 };
 
+typedef boost::shared_ptr<LoaderBase> LoaderPtr;
+
 
 //----------------------------------------------------------------------------
 // TupleLoader
@@ -115,7 +303,7 @@ public:
         EX_CHECK_NULL(table);
     }
 
-    void load(FilePtr const & fp)
+    size_t load(Chunk const & chunk)
     {
         string row;
         string col;
@@ -125,37 +313,67 @@ public:
         using namespace boost::spirit;
         using namespace warp::parsing;
 
-        Buffer buf(32 << 20);
-        while(buf.read(fp))
-        {
-            buf.flip();
-
-            parse_info<char *> info = parse(
-                buf.position(), buf.limit(),
-                *(
-                    ch_p('(') >> quoted_str_p[assign_a(row)] >>
-                    ch_p(',') >> quoted_str_p[assign_a(col)] >>
-                    ch_p(',') >> timestamp_p[assign_a(time)] >>
-                    ch_p(',') >> quoted_str_p[assign_a(val)] >>
-                    ch_p(')')
-                 )[SetCell(table,row,col,time,val)],
-                space_p);
-            
-            buf.position(info.stop);
-            buf.compact();
-            buf.reserve(1);
-        }
+        char const * begin = chunk.data.c_str();
+        char const * end = begin + chunk.data.size();
+
+        parse_info<char const *> info = parse(
+            begin, end,
+            *(
+                ch_p('(') >> quoted_str_p[assign_a(row)] >>
+                ch_p(',') >> quoted_str_p[assign_a(col)] >>
+                ch_p(',') >> timestamp_p[assign_a(time)] >>
+                ch_p(',') >> quoted_str_p[assign_a(val)] >>
+                ch_p(')')
+             )[SetCell(table,row,col,time,val)],
+            space_p);
 
-        buf.flip();
-        if(buf.remaining() && !isWhitespace(buf))
+        if(!isWhitespace(info.stop, end))
         {
-            raise<IOError>("parse failed at: %s#%d %s", fp->getName(),
-                           fp->tell() - buf.remaining(),
-                           reprString(buf.position(),
-                                      std::min(buf.remaining(),
+            raise<IOError>("parse failed at: %s#%d %s", chunk.source,
+                           chunk.offset + (info.stop - begin),
+                           reprString(info.stop,
+                                      std::min(size_t(end - info.stop),
                                                size_t(100))));
         }
+
+        return chunk.data.size();
     }
+
+    /// Find the end of the last complete tuple in a buffer.  Scanning
+    /// starts at \c pos with the quote state left from the last call,
+    /// and must resume from the returned \c pos next time.  Returns
+    /// the offset just past the last tuple, or 0 if there isn't one.
+    class Splitter
+    {
+        char quote;
+        bool escaped;
+
+    public:
+        Splitter() : quote(0), escaped(false) {}
+
+        size_t scan(string const & buf, size_t & pos)
+        {
+            size_t cut = 0;
+            for(; pos < buf.size(); ++pos)
+            {
+                char c = buf[pos];
+                if(quote)
+                {
+                    if(escaped)
+                        escaped = false;
+                    else if(c == '\\')
+                        escaped = true;
+                    else if(c == quote)
+                        quote = 0;
+                }
+                else if(c == '"' || c == '\'')
+                    quote = c;
+                else if(c == ')')
+                    cut = pos + 1;
+            }
+            return cut;
+        }
+    };
     
 private:
     struct SetCell
@@ -246,9 +464,11 @@ public:
             collector->insert(collector->end(), data.begin(), data.end());
     }
 
-    void load(FilePtr const & fp)
+    size_t load(Chunk const & chunk)
     {
+        FilePtr fp = File::input(chunk.source);
         parse(fp);
+        return fp->tell();
     }
 };
 
@@ -325,12 +545,393 @@ public:
             value += data;
     }
 
-    void load(FilePtr const & fp)
+    size_t load(Chunk const & chunk)
     {
+        FilePtr fp = File::input(chunk.source);
         parse(fp);
+        return fp->tell();
+    }
+};
+
+
+//----------------------------------------------------------------------------
+// LoadPipeline
+//----------------------------------------------------------------------------
+/// Parallel load: reader threads split input files into chunks at
+/// record boundaries, parser threads turn chunks into cell batches,
+/// and writer threads apply the batches to the output tables.  Input
+/// formats that can't be split are parsed a whole file at a time, so
+/// they only run in parallel across files.
+///
+/// In ordered mode, cells reach the table in input order, so the last
+/// of several cells with the same key wins, as it would in a serial
+/// load.  There is one reader and one writer, and the writer holds
+/// batches that a fast parser finished early until the batches before
+/// them are written.  Parsing still runs in parallel, but a parser
+/// won't start a chunk more than a fixed window of chunks ahead of
+/// the oldest one not yet written, which bounds the batches the
+/// writer has to hold.  Unordered mode
+/// allows several readers and writers, but then duplicate keys in the
+/// input resolve in no particular order.
+class LoadPipeline
+{
+public:
+    typedef boost::function<LoaderPtr (TablePtr const &)> loader_factory_t;
+
+private:
+    typedef boost::mutex::scoped_lock lock_t;
+
+    loader_factory_t makeLoader;
+    bool splitInput;
+    vector<TablePtr> outputs;
+    size_t nReaders;
+    size_t nParsers;
+    size_t chunkSize;
+    size_t batchCells;
+    bool ordered;
+    bool verbose;
+    int progressInterval;
+
+    SyncQueue<ChunkPtr> chunks;
+    SyncQueue<CellBatchPtr> batches;
+    LoadStats stats;
+
+    boost::mutex mutex;
+    vector<string> inputs;
+    size_t nextInput;
+    size_t nextChunk;
+    size_t nextWritten;
+    size_t window;
+    boost::condition windowChanged;
+    string error;
+    bool failed;
+    bool done;
+    boost::condition doneChanged;
+
+    bool getNextInput(string & fn)
+    {
+        lock_t l(mutex);
+        if(failed || nextInput == inputs.size())
+            return false;
+        fn = inputs[nextInput++];
+        return true;
+    }
+
+    void fail(string const & msg)
+    {
+        {
+            lock_t l(mutex);
+            if(failed)
+                return;
+            failed = true;
+            error = msg;
+            windowChanged.notify_all();
+        }
+        chunks.cancelWaits();
+        batches.cancelWaits();
     }
+
+    bool isFailed()
+    {
+        lock_t l(mutex);
+        return failed;
+    }
+
+    void guard(boost::function<void ()> const & func)
+    {
+        try {
+            func();
+        }
+        catch(Exception const & ex) {
+            fail(ex.what());
+        }
+        catch(std::exception const & ex) {
+            fail(ex.what());
+        }
+        catch(...) {
+            fail("unknown exception");
+        }
+    }
+
+    /// Wait until the chunk with the given sequence number is within
+    /// the ordered-mode window.  Returns false if the load failed.
+    bool waitForWindow(size_t seq)
+    {
+        lock_t l(mutex);
+        while(!failed && seq >= nextWritten + window)
+            windowChanged.wait(l);
+        return !failed;
+    }
+
+    void chunkWritten(size_t seq)
+    {
+        lock_t l(mutex);
+        nextWritten = seq + 1;
+        windowChanged.notify_all();
+    }
+
+    bool pushChunk(ChunkPtr const & chunk)
+    {
+        {
+            lock_t l(mutex);
+            chunk->seq = nextChunk++;
+        }
+        stats.addRead(chunk->data.size());
+        return chunks.push(chunk);
+    }
+
+    void readLoop()
+    {
+        size_t const READ_SIZE = std::min(chunkSize, size_t(1) << 20);
+
+        string fn;
+        while(getNextInput(fn))
+        {
+            if(verbose)
+                cerr << "Loading from file: " << fn << endl;
+
+            // Let the parser read the file if we can't split it
+            if(!splitInput)
+            {
+                if(!pushChunk(ChunkPtr(new Chunk(fn, 0))))
+                    return;
+                continue;
+            }
+
+            FilePtr fp = File::input(fn);
+            TupleLoader::Splitter splitter;
+            string pending;
+            size_t scanPos = 0;
+            size_t cut = 0;
+            off_t offset = 0;
+            for(;;)
+            {
+                size_t sz = pending.size();
+                pending.resize(sz + READ_SIZE);
+                size_t nRead = fp->read(&pending[sz], READ_SIZE);
+                pending.resize(sz + nRead);
+
+                if(!nRead)
+                {
+                    // Send the tail, which the parser will reject if
+                    // it isn't whitespace
+                    if(!pending.empty())
+                    {
+                        ChunkPtr chunk(new Chunk(fn, offset));
+                        chunk->data.swap(pending);
+                        if(!pushChunk(chunk))
+                            return;
+                    }
+                    break;
+                }
+
+                if(size_t c = splitter.scan(pending, scanPos))
+                    cut = c;
+
+                // Send complete records once we have enough
+                if(cut && pending.size() >= chunkSize)
+                {
+                    ChunkPtr chunk(new Chunk(fn, offset));
+                    chunk->data.assign(pending, 0, cut);
+                    pending.erase(0, cut);
+                    scanPos -= cut;
+                    offset += cut;
+                    cut = 0;
+                    if(!pushChunk(chunk))
+                        return;
+                }
+            }
+            stats.addFile();
+        }
+    }
+
+    void parseLoop()
+    {
+        boost::shared_ptr<BatchTable> table(
+            new BatchTable(batches, stats, batchCells));
+        LoaderPtr loader = makeLoader(table);
+
+        ChunkPtr chunk;
+        while(chunks.pop(chunk) && !isFailed())
+        {
+            if(ordered && !waitForWindow(chunk->seq))
+                break;
+            table->startChunk(chunk->seq);
+            stats.addParsed(loader->load(*chunk));
+            table->finishChunk();
+            if(!splitInput)
+                stats.addFile();
+            chunk.reset();
+        }
+    }
+
+    void writeBatch(Table & table, CellBatch const & batch)
+    {
+        batch.apply(table);
+        stats.addWritten(batch.size());
+    }
+
+    void writeLoop(TablePtr const & table)
+    {
+        // Batches that arrive before their turn in ordered mode, by
+        // (chunk, index)
+        typedef std::map<std::pair<size_t, size_t>, CellBatchPtr> batch_map;
+        batch_map early;
+        std::pair<size_t, size_t> next(0, 0);
+
+        CellBatchPtr batch;
+        while(batches.pop(batch) && !isFailed())
+        {
+            if(!ordered)
+            {
+                writeBatch(*table, *batch);
+                batch.reset();
+                continue;
+            }
+
+            early[std::make_pair(batch->getChunk(), batch->getIndex())] =
+                batch;
+            batch.reset();
+
+            batch_map::iterator i;
+            while((i = early.find(next)) != early.end())
+            {
+                writeBatch(*table, *i->second);
+                if(i->second->isLast())
+                {
+                    chunkWritten(next.first);
+                    next = std::make_pair(next.first + 1, size_t(0));
+                }
+                else
+                    ++next.second;
+                early.erase(i);
+            }
+        }
+
+        if(!isFailed())
+            table->sync();
+    }
+
+    void progressLoop()
+    {
+        lock_t l(mutex);
+        while(!done)
+        {
+            boost::xtime xt;
+            boost::xtime_get(&xt, boost::TIME_UTC);
+            xt.sec += progressInterval;
+            if(!doneChanged.timed_wait(l, xt))
+            {
+                l.unlock();
+                stats.report("Progress");
+                l.lock();
+            }
+        }
+    }
+
+    template <class F>
+    void startThreads(boost::thread_group & group, size_t n, F const & f)
+    {
+        for(size_t i = 0; i < n; ++i)
+            group.create_thread(
+                boost::bind(&LoadPipeline::guard, this,
+                            boost::function<void ()>(f)));
+    }
+
+public:
+    /// Load into the given output tables, one writer thread per
+    /// table.  An ordered load takes exactly one output table and
+    /// uses one reader.  If progressInterval is positive, progress is
+    /// reported every that many seconds in verbose mode.
+    LoadPipeline(loader_factory_t const & makeLoader, bool splitInput,
+                 vector<TablePtr> const & outputs, size_t nReaders,
+                 size_t nParsers, size_t chunkSize, size_t batchCells,
+                 bool ordered, bool verbose, int progressInterval) :
+        makeLoader(makeLoader),
+        splitInput(splitInput),
+        outputs(outputs),
+        nReaders(ordered ? 1 : std::max(nReaders, size_t(1))),
+        nParsers(std::max(nParsers, size_t(1))),
+        chunkSize(std::max(chunkSize, size_t(1))),
+        batchCells(std::max(batchCells, size_t(1))),
+        ordered(ordered),
+        verbose(verbose),
+        progressInterval(progressInterval),
+        chunks(2 * this->nParsers),
+        batches(4 * outputs.size()),
+        nextInput(0),
+        nextChunk(0),
+        nextWritten(0),
+        window(2 * this->nParsers),
+        failed(false),
+        done(false)
+    {
+        if(outputs.empty())
+            raise<ValueError>("need at least one output table");
+        if(ordered && outputs.size() != 1)
+            raise<ValueError>("ordered load needs exactly one output table");
+    }
+
+    /// Load all the input files.  Throws if any stage fails.
+    void run(vector<string> const & files)
+    {
+        inputs = files;
+
+        boost::scoped_ptr<boost::thread> progress;
+        if(verbose && progressInterval > 0)
+            progress.reset(
+                new boost::thread(
+                    boost::bind(&LoadPipeline::progressLoop, this)));
+
+        boost::thread_group readers;
+        boost::thread_group parsers;
+        boost::thread_group writers;
+
+        for(vector<TablePtr>::const_iterator i = outputs.begin();
+            i != outputs.end(); ++i)
+        {
+            startThreads(writers, 1,
+                         boost::bind(&LoadPipeline::writeLoop, this, *i));
+        }
+        startThreads(parsers, nParsers,
+                     boost::bind(&LoadPipeline::parseLoop, this));
+        startThreads(readers, std::min(nReaders, inputs.size()),
+                     boost::bind(&LoadPipeline::readLoop, this));
+
+        // Shut down each stage once the one before it is done
+        readers.join_all();
+        chunks.cancelWaits();
+        parsers.join_all();
+        batches.cancelWaits();
+        writers.join_all();
+
+        {
+            lock_t l(mutex);
+            done = true;
+            doneChanged.notify_all();
+        }
+        if(progress)
+            progress->join();
+
+        if(failed)
+            raise<RuntimeError>("load failed: %s", error);
+
+        if(verbose)
+            stats.report("Done");
+    }
+
+    int64_t getCellCount() const { return stats.getCellsWritten(); }
 };
 
+namespace
+{
+    template <class T>
+    LoaderPtr makeLoader(TablePtr const & table)
+    {
+        return LoaderPtr(new T(table));
+    }
+}
+
 
 //----------------------------------------------------------------------------
 // main
@@ -344,6 +945,35 @@ int main(int ac, char ** av)
         op.addOption("tuple", "Use tuple parser (default)");
         op.addOption("xml,x", "Use XML parser");
         op.addOption("aol", "Use AOL Snowchains parser");
+        op.addOption("bulk,b", value<string>(),
+                     "Bulk load: sort input into DiskTables in the given "
+                     "directory and attach them to the table's tablets "
+                     "directly.  The directory must be under the table "
+                     "servers' root directory.");
+        op.addOption("sortMemory", value<string>()->default_value("256M"),
+                     "Memory to use for sorting in bulk load mode");
+        op.addOption("readers,r", value<size_t>()->default_value(2),
+                     "Number of input files to read at once.  Only "
+                     "used with --unordered.");
+        op.addOption("parsers,p", value<size_t>()->default_value(
+                         getCpuCount()),
+                     "Number of parser threads");
+        op.addOption("writers,w", value<size_t>()->default_value(1),
+                     "Number of writer threads, each with its own table "
+                     "connection.  More than one needs --unordered.  Bulk "
+                     "loads always use one.");
+        op.addOption("unordered",
+                     "Let cells reach the table out of input order, so "
+                     "several readers and writers can run at once.  If "
+                     "the input sets the same cell more than once, any "
+                     "of the values may win.  By default the last one "
+                     "does.");
+        op.addOption("chunkSize", value<string>()->default_value("4M"),
+                     "Size of input chunks handed to parsers");
+        op.addOption("batchSize", value<size_t>()->default_value(1024),
+                     "Number of cells handed to writers at once");
+        op.addOption("progress", value<int>()->default_value(10),
+                     "Seconds between progress reports in verbose mode");
         op.addOption("verbose,v", "Be verbose");
     }
     
@@ -356,50 +986,68 @@ int main(int ac, char ** av)
     string arg;
     if(!opt.get("table", arg))
         op.error("need --table");
-    
-    TablePtr table = Table::open(arg);
-    if(verbose)
-        cerr << "Loading to table: " << arg << endl;
 
-    boost::shared_ptr<CounterTable> counter;
-    if(verbose)
+    size_t nReaders, nParsers, nWriters, batchSize;
+    int progress;
+    string chunkSize;
+    opt.get("readers", nReaders);
+    opt.get("parsers", nParsers);
+    opt.get("writers", nWriters);
+    opt.get("batchSize", batchSize);
+    opt.get("progress", progress);
+    opt.get("chunkSize", chunkSize);
+
+    bool ordered = !hasopt(opt, "unordered");
+    if(ordered && nWriters > 1)
+        op.error("--writers greater than 1 needs --unordered");
+    
+    vector<TablePtr> tables;
+    string bulkDir;
+    if(opt.get("bulk", bulkDir))
     {
-        counter.reset(new CounterTable(table));
-        table = counter;
+        string mem;
+        opt.get("sortMemory", mem);
+        tables.push_back(
+            TablePtr(new kdi::app::BulkLoadTable(arg, bulkDir,
+                                                 parseSize(mem))));
+        if(verbose)
+            cerr << "Bulk loading to table: " << arg << endl;
+    }
+    else
+    {
+        for(size_t i = 0; i < std::max(nWriters, size_t(1)); ++i)
+            tables.push_back(Table::open(arg));
+        if(verbose)
+            cerr << "Loading to table: " << arg << endl;
     }
 
-    boost::scoped_ptr<LoaderBase> loader;
+    LoadPipeline::loader_factory_t loaderFactory;
+    bool splitInput = false;
     if(hasopt(opt, "xml"))
     {
         if(hasopt(opt, "aol") || hasopt(opt, "tuple"))
             op.error("--xml, --aol, and --tuple are mutually exclusive");
-        loader.reset(new XmlLoader(table));
+        loaderFactory = &makeLoader<XmlLoader>;
     }
     else if(hasopt(opt, "aol"))
     {
         if(hasopt(opt, "tuple"))
             op.error("--xml, --aol, and --tuple are mutually exclusive");
-        loader.reset(new AolLoader(table));
+        loaderFactory = &makeLoader<AolLoader>;
     }
     else
-        loader.reset(new TupleLoader(table));
-
-    for(ArgumentList::const_iterator ai = args.begin();
-        ai != args.end(); ++ai)
     {
-        FilePtr fp = File::input(*ai);
-        if(verbose)
-            cerr << "Loading from file: " << fp->getName() << endl;
-
-        loader->load(fp);
+        loaderFactory = &makeLoader<TupleLoader>;
+        splitInput = true;
     }
-    
-    if(verbose)
-        cerr << "Syncing data" << endl;
-    table->sync();
+
+    LoadPipeline pipeline(loaderFactory, splitInput, tables, nReaders,
+                          nParsers, parseSize(chunkSize), batchSize,
+                          ordered, verbose, progress);
+    pipeline.run(args);
 
     if(verbose)
-        cerr << "Loaded " << counter->getSetCount() << " cell(s)" << endl;
+        cerr << "Loaded " << pipeline.getCellCount() << " cell(s)" << endl;
 
     return 0;
 }
@@ -20,14 +20,14 @@
 
 #include <kdi/table.h>
 #include <kdi/scan_predicate.h>
+#include <kdi/scan_aggregate.h>
 #include <kdi/RowInterval.h>
 #include <warp/options.h>
-#include <warp/bloom_filter.h>
+#include <warp/strutil.h>
 #include <boost/format.hpp>
 #include <iostream>
 #include <vector>
 #include <string>
-#include <tr1/unordered_map>
 
 using namespace kdi;
 using namespace warp;
@@ -51,87 +51,55 @@ enum {
 //----------------------------------------------------------------------------
 class StatCollector
 {
-    typedef std::tr1::unordered_map<std::string, size_t> smap_t;
-
     size_t nTotal;
     size_t nScanned;
 
-    std::vector<size_t> next;
     std::vector<size_t> total;
     std::vector<size_t> dTotal;
 
-    smap_t familyMap;
-    BloomFilter columnFilter;
-    std::string lastRow;
-    std::string family;
-
-    static void assign(strref_t src, std::string & dst)
-    {
-        dst.assign(src.begin(), src.end());
-    }
+    // Merged aggregate of every interval sampled so far
+    ScanAggregate agg;
 
 public:
-    StatCollector(size_t nTotal) :
+    StatCollector(size_t nTotal, std::string const & spec) :
         nTotal(nTotal),
         nScanned(0),
-        next(NUM_STATS, 0),
         total(NUM_STATS, 0),
         dTotal(NUM_STATS, 0),
-        columnFilter(64 << 20, 3)
+        agg(spec)
     {
     }
 
-    void sample(Cell const & x)
+    /// Add the aggregate of one interval
+    void sample(ScanAggregate const & x)
     {
-        ++next[N_CELLS];
+        std::vector<size_t> next(NUM_STATS, 0);
 
-        strref_t r  = x.getRow();
-        strref_t c  = x.getColumn();
-        strref_t cf = x.getColumnFamily();
-        strref_t v  = x.getValue();
+        // Distinct columns aren't additive, so count the ones that
+        // are new with this interval
+        size_t nCols = agg.getColumnCount();
+        agg.merge(x);
 
-        next[ROW_SZ] += r.size();
-        next[COL_SZ] += c.size();
-        next[VAL_SZ] += v.size();
-        
-        if(r != lastRow)
-        {
-            ++next[N_ROWS];
-            assign(r, lastRow);
-        }
+        next[N_ROWS] = x.getRowCount();
+        next[N_COLS] = agg.getColumnCount() - nCols;
+        next[N_CELLS] = x.getCellCount();
+        next[ROW_SZ] = x.getRowBytes();
+        next[COL_SZ] = x.getColumnBytes();
+        next[VAL_SZ] = x.getValueBytes();
 
-        assign(cf, family);
-        ++familyMap[family];
-        
-        if(!columnFilter.contains(c))
-        {
-            ++next[N_COLS];
-            columnFilter.insert(c);
-        }
-    }
-
-    void endInterval()
-    {
         for(size_t i = 0; i < NUM_STATS; ++i)
         {
-            //cout << format("i:%d d:%d t:%d n:%d") % i % dTotal[i] % total[i] % next[i]
-            //     << endl;
-
             size_t a = std::min(size_t(10), nScanned);
 
             dTotal[i] = (dTotal[i]*a + next[i]) / (a+1);
             total[i] += next[i];
-            next[i] = 0;
-
-            //cout << format("S:%d d:%d t:%d n:%d") % nScanned % dTotal[i] % total[i] % next[i]
-            //     << endl;
         }
         ++nScanned;
     }
     
     size_t getCurrent(size_t i) const
     {
-        return total[i] + next[i];
+        return total[i];
     }
 
     size_t getEstimate(size_t i) const
@@ -141,6 +109,8 @@ public:
             r += dTotal[i] * (nTotal - nScanned);
         return r;
     }
+
+    ScanAggregate const & getAggregate() const { return agg; }
 };
 
 
@@ -196,12 +166,23 @@ int main(int ac, char ** av)
     OptionParser op("%prog [options] <table> ...");
     {
         using namespace boost::program_options;
+        op.addOption("cells,n", value<size_t>()->default_value(0),
+                     "Show a uniform sample of N cells");
     }
 
     OptionMap opt;
     ArgumentList args;
     op.parseOrBail(ac, av, opt, args);
 
+    // Statistics are gathered by the table servers where possible,
+    // so only the summaries come back
+    size_t nSampleCells = 0;
+    opt.get("cells", nSampleCells);
+
+    string spec = "families,columns";
+    if(nSampleCells)
+        spec += (format(",reservoir=%d") % nSampleCells).str();
+
     for(ArgumentList::const_iterator ai = args.begin();
         ai != args.end(); ++ai)
     {
@@ -219,22 +200,20 @@ int main(int ac, char ** av)
         size_t nIntervals = intervals.size();
         cout << format("  got %d intervals") % nIntervals << endl;
 
-        StatCollector collector(intervals.size());
+        StatCollector collector(intervals.size(), spec);
         while(!intervals.empty())
         {
             size_t idx = rand() % intervals.size();
             RowInterval & ri = intervals[idx];
 
             cout << "Sampling: " << ri << endl;
-            CellStreamPtr scan = table->scan(ri.toRowPredicate());
+            ScanAggregate agg(spec);
+            table->aggregate(ScanPredicate(ri.toRowPredicate()), agg);
 
             ri = intervals.back();
             intervals.pop_back();
 
-            Cell x;
-            while(scan->get(x))
-                collector.sample(x);
-            collector.endInterval();
+            collector.sample(agg);
 
             cout << format("Completed.  %d/%d remaining")
                 % intervals.size() % nIntervals
@@ -242,6 +221,26 @@ int main(int ac, char ** av)
                  << StatReporter(collector)
                  << endl;
         }
+
+        ScanAggregate const & agg = collector.getAggregate();
+        ScanAggregate::family_map const & fams = agg.getFamilies();
+        for(ScanAggregate::family_map::const_iterator i = fams.begin();
+            i != fams.end(); ++i)
+        {
+            cout << format("family %s: %s cells, %s bytes")
+                % i->first
+                % sizeString(i->second.nCells)
+                % sizeString(i->second.nBytes)
+                 << endl;
+        }
+
+        vector<Cell> cells;
+        agg.getSamples(cells);
+        for(vector<Cell>::const_iterator i = cells.begin();
+            i != cells.end(); ++i)
+        {
+            cout << "sample: " << *i << endl;
+        }
     }
 
     return 0;
@@ -20,8 +20,11 @@
 
 #include <kdi/app/scan_visitor.h>
 #include <kdi/scan_predicate.h>
+#include <kdi/scan_aggregate.h>
 #include <warp/options.h>
+#include <warp/timer.h>
 #include <ex/exception.h>
+#include <boost/format.hpp>
 #include <iostream>
 
 using namespace kdi::app;
@@ -29,6 +32,45 @@ using namespace kdi;
 using namespace warp;
 using namespace ex;
 using namespace std;
+using boost::format;
+
+//----------------------------------------------------------------------------
+// doCount
+//----------------------------------------------------------------------------
+namespace {
+
+    /// Count the matching cells without bringing them back.  Tables
+    /// that support it count on the server.
+    void doCount(vector<string> const & tables, ScanPredicate const & pred,
+                 bool verbose)
+    {
+        WallTimer timer;
+        ScanAggregate agg;
+
+        for(vector<string>::const_iterator i = tables.begin();
+            i != tables.end(); ++i)
+        {
+            if(verbose)
+                cerr << "scanning: " << *i << endl;
+
+            Table::open(*i)->aggregate(pred, agg);
+        }
+
+        if(verbose)
+        {
+            uint64_t nBytes = ( agg.getRowBytes() + agg.getColumnBytes() +
+                                agg.getValueBytes() );
+            cerr << format("%d cells total in %d rows (%sB, %.2f sec)")
+                % agg.getCellCount()
+                % agg.getRowCount()
+                % sizeString(nBytes, 1024)
+                % timer.getElapsed()
+                 << endl;
+        }
+
+        cout << agg.getCellCount() << endl;
+    }
+}
 
 //----------------------------------------------------------------------------
 // main
@@ -40,7 +82,8 @@ int main(int ac, char ** av)
         using namespace boost::program_options;
         op.addOption("predicate,p", value<string>(), "Predicate expression for scan");
         op.addOption("xml,x", "Dump as XML");
-        op.addOption("count,c", "Only output a count of matching cells");
+        op.addOption("count,c", "Only output a count of matching cells "
+                     "(counted on the server when possible)");
         op.addOption("verbose,v", "Be verbose");
         op.addOption("numeric,n", "Always print timestamps in numeric form");
     }
@@ -73,11 +116,11 @@ int main(int ac, char ** av)
         }
     }
 
-    if(verbose)
+    if(count)
+        doCount(args, pred, verbose);
+    else if(verbose)
     {
-        if(count)
-            doScan<CompositeVisitor<VerboseVisitor,CellCounter> >(args, pred);
-        else if(dumpXml)
+        if(dumpXml)
             doScan<CompositeVisitor<VerboseVisitor,XmlWriter> >(args, pred);
         else if(numericTime)
             doScan<CompositeVisitor<VerboseVisitor,FastCellWriter> >(args, pred);
@@ -86,9 +129,7 @@ int main(int ac, char ** av)
     }
     else
     {
-        if(count)
-            doScan<CellCounter>(args, pred);
-        else if(dumpXml)
+        if(dumpXml)
             doScan<XmlWriter>(args, pred);
         else if(numericTime)
             doScan<FastCellWriter>(args, pred);
@@ -0,0 +1,192 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+// Microbenchmark comparing the generic flux::Merge over Cells against
+// the specialized CellMerge.  Inputs are built in memory so only the
+// merge itself is timed.
+
+#include <kdi/cell_merge.h>
+#include <flux/merge.h>
+#include <warp/options.h>
+#include <warp/timer.h>
+#include <warp/strutil.h>
+#include <boost/format.hpp>
+#include <boost/shared_ptr.hpp>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+
+using namespace kdi;
+using namespace warp;
+using namespace std;
+using boost::format;
+
+namespace {
+
+    typedef std::vector<Cell> cell_vec;
+    typedef boost::shared_ptr<cell_vec const> cell_vec_cptr;
+
+    /// Stream over a shared vector of Cells
+    class VecStream : public CellStream
+    {
+        cell_vec_cptr cells;
+        cell_vec::const_iterator it;
+
+    public:
+        explicit VecStream(cell_vec_cptr const & cells) :
+            cells(cells), it(cells->begin()) {}
+
+        bool get(Cell & x)
+        {
+            if(it == cells->end())
+                return false;
+            x = *it;
+            ++it;
+            return true;
+        }
+    };
+
+    /// Split a sorted key space across nInputs inputs.  Keys are dealt
+    /// out in runs of runLength consecutive keys.  A run length of 1
+    /// deals each key to a random input.  Every dupPct percent of
+    /// keys are also copied to a second input.
+    std::vector<cell_vec_cptr> makeInputs(size_t nInputs, size_t nCells,
+                                          size_t runLength, size_t dupPct)
+    {
+        std::vector<cell_vec> inputs(nInputs);
+
+        size_t input = 0;
+        for(size_t i = 0; i < nCells; ++i)
+        {
+            if(runLength <= 1)
+                input = rand() % nInputs;
+            else if(i % runLength == 0)
+                input = (input + 1 + rand() % nInputs) % nInputs;
+
+            // A few columns per row, as in a typical table
+            string row = (format("row-%012d") % (i / 4)).str();
+            string col = (format("fam:col-%d") % (i % 4)).str();
+            Cell x = makeCell(row, col, 0, "value");
+
+            inputs[input].push_back(x);
+            if(nInputs > 1 && size_t(rand() % 100) < dupPct)
+                inputs[(input + 1) % nInputs].push_back(x);
+        }
+
+        std::vector<cell_vec_cptr> r;
+        for(size_t i = 0; i < nInputs; ++i)
+        {
+            sort(inputs[i].begin(), inputs[i].end());
+            r.push_back(cell_vec_cptr(new cell_vec(inputs[i])));
+        }
+        return r;
+    }
+
+    CellStreamPtr makeFluxMerge()
+    {
+        CellStreamPtr p = flux::makeMergeUnique<Cell>();
+        return p;
+    }
+
+    CellStreamPtr makeCellMerge()
+    {
+        CellStreamPtr p = CellMerge::make(false);
+        return p;
+    }
+
+    void timeMerge(char const * name, CellStreamPtr (*makeMerge)(),
+                   std::vector<cell_vec_cptr> const & inputs, size_t nReps)
+    {
+        size_t nOut = 0;
+        CpuTimer timer;
+        for(size_t rep = 0; rep < nReps; ++rep)
+        {
+            CellStreamPtr merge = makeMerge();
+            for(size_t i = 0; i < inputs.size(); ++i)
+                merge->pipeFrom(CellStreamPtr(new VecStream(inputs[i])));
+
+            Cell x;
+            while(merge->get(x))
+                ++nOut;
+        }
+        double t = timer.getElapsed();
+
+        cout << format("%-12s %10d cells %8.3fs %8.2f Mcells/s")
+            % name % nOut % t % (nOut / t * 1e-6)
+             << endl;
+    }
+}
+
+int main(int ac, char ** av)
+{
+    OptionParser op("%prog [options]");
+    {
+        using namespace boost::program_options;
+        op.addOption("inputs,k", value<string>()->default_value("8"),
+                     "Number of merge inputs");
+        op.addOption("cells,n", value<string>()->default_value("1M"),
+                     "Number of distinct cells across all inputs");
+        op.addOption("run,r", value<string>()->default_value("1"),
+                     "Length of runs of consecutive keys in one input");
+        op.addOption("dup,d", value<string>()->default_value("0"),
+                     "Percent of keys duplicated in a second input");
+        op.addOption("reps,N", value<string>()->default_value("3"),
+                     "Number of merge passes to time");
+        op.addOption("seed,s", value<unsigned int>(),
+                     "Random seed");
+    }
+
+    OptionMap opt;
+    ArgumentList args;
+    op.parseOrBail(ac, av, opt, args);
+
+    string arg;
+    opt.get("inputs", arg);
+    size_t nInputs = parseSize(arg);
+    opt.get("cells", arg);
+    size_t nCells = parseSize(arg);
+    opt.get("run", arg);
+    size_t runLength = parseSize(arg);
+    opt.get("dup", arg);
+    size_t dupPct = parseSize(arg);
+    opt.get("reps", arg);
+    size_t nReps = parseSize(arg);
+
+    unsigned int seed;
+    if(opt.get("seed", seed))
+        srand(seed);
+
+    if(!nInputs || !nReps)
+        op.error("need at least one input and one pass");
+
+    cout << format("Merging %d cells from %d inputs, run length %d, "
+                   "%d%% duplicates, %d passes")
+        % nCells % nInputs % runLength % dupPct % nReps
+         << endl;
+
+    std::vector<cell_vec_cptr> inputs =
+        makeInputs(nInputs, nCells, runLength, dupPct);
+
+    timeMerge("flux::Merge", &makeFluxMerge, inputs, nReps);
+    timeMerge("CellMerge", &makeCellMerge, inputs, nReps);
+
+    return 0;
+}
@@ -35,6 +35,15 @@ namespace kdi {
 
     using sdstore::makeCell;
     using sdstore::makeCellErasure;
+    using sdstore::makeRowRangeErasure;
+    using sdstore::makeFamilyErasure;
+    using sdstore::makeMergeOperand;
+
+    using sdstore::ErasureKind;
+    using sdstore::NOT_ERASURE;
+    using sdstore::ERASE_CELL;
+    using sdstore::ERASE_ROWS;
+    using sdstore::ERASE_FAMILY;
 
 } // namespace kdi
 
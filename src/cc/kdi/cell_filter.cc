@@ -19,88 +19,59 @@
 //----------------------------------------------------------------------------
 
 #include <kdi/cell_filter.h>
+#include <kdi/compiled_predicate.h>
 
-#include <flux/filter.h>
 #include <ex/exception.h>
 #include <kdi/scan_predicate.h>
 #include <algorithm>
+#include <string>
 
 using namespace kdi;
+using namespace warp;
 using namespace ex;
 
 //----------------------------------------------------------------------------
-// ContainmentFilter
+// PredicateFilter
 //----------------------------------------------------------------------------
 namespace
 {
-    /// Functor that returns true iff a derived key is contained
-    /// in a container.  The functor holds a (hopefully smart) pointer
-    /// to the container.
-    /// @param CPtr Container pointer type.  The expression
-    /// ptr->contains(x) must be well defined, where ptr is of type
-    /// CPtr, and x is the type returned by the key functor.
-    /// @param K Key functor.  Must map the predicate argument to the
-    /// value to check for in the Container.
-    template <class CPtr, class K>
-    class ContainmentPredicate
+    /// Filter that checks the row, column, and time constraints of a
+    /// predicate in a single pass over each cell.
+    class PredicateFilter : public CellStream
     {
-        CPtr ptr;
-        K getKey;
+        CompiledPredicate pred;
+        CellStreamPtr input;
 
     public:
-        explicit ContainmentPredicate(CPtr const & ptr,
-                                      K const & getKey=K()) :
-            ptr(ptr), getKey(getKey)
+        explicit PredicateFilter(CompiledPredicate const & pred) :
+            pred(pred)
         {
-            using namespace ex;
-            if(!ptr)
-                raise<ValueError>("null container pointer");
         }
 
-        template <class T>
-        bool operator()(T const & x) const
+        void pipeFrom(CellStreamPtr const & input)
         {
-            return ptr->contains(getKey(x));
+            this->input = input;
         }
-    };
 
-    /// Helper function to make a flux::Filter stream using a
-    /// ContainmentPredicate.
-    template <class T, class CPtr, class K>
-    typename flux::Stream<T>::handle_t makeContainmentFilter(
-        CPtr const & ptr, K const & getKey)
-    {
-        return flux::makeFilter<T>(
-            ContainmentPredicate<CPtr,K>(ptr, getKey)
-            );
-    }
-
-    /// Functor to get the row name from a Cell.
-    struct GetCellRow
-    {
-        std::string operator()(Cell const & x) const
+        bool get(Cell & x)
         {
-            return warp::str(x.getRow());
-        }
-    };
+            if(!input)
+                return false;
 
-    /// Functor to get the column name from a Cell.
-    struct GetCellColumn
-    {
-        std::string operator()(Cell const & x) const
-        {
-            return warp::str(x.getColumn());
+            while(input->get(x))
+            {
+                if(pred.contains(x))
+                    return true;
+            }
+            return false;
         }
     };
 
-    /// Functor to get the timestamp value from a Cell.
-    struct GetCellTimestamp
+    CellStreamPtr makePredicateFilter(CompiledPredicate const & pred)
     {
-        int64_t operator()(Cell const & x) const
-        {
-            return x.getTimestamp();
-        }
-    };
+        CellStreamPtr p(new PredicateFilter(pred));
+        return p;
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -169,6 +140,59 @@ namespace
     };
 }
 
+//----------------------------------------------------------------------------
+// ProjectionFilter
+//----------------------------------------------------------------------------
+namespace
+{
+    class ProjectionFilter : public CellStream
+    {
+        CellStreamPtr input;
+        ScanPredicate::Projection proj;
+        std::string lastRow;
+        bool haveRow;
+
+    public:
+        explicit ProjectionFilter(ScanPredicate::Projection proj) :
+            proj(proj), haveRow(false)
+        {
+        }
+
+        void pipeFrom(CellStreamPtr const & input)
+        {
+            this->input = input;
+            haveRow = false;
+        }
+
+        bool get(Cell & x)
+        {
+            if(!input)
+                return false;
+
+            while(input->get(x))
+            {
+                // Erasures and merge operands pass through untouched
+                if(x.isErasure() || x.isMergeOperand())
+                    return true;
+
+                if(proj == ScanPredicate::PROJECT_ROWS)
+                {
+                    // Only the first cell in each row
+                    if(haveRow && x.getRow() == lastRow)
+                        continue;
+                    lastRow.assign(x.getRow().begin(), x.getRow().end());
+                    haveRow = true;
+                }
+
+                x = makeProjectedCell(x.getRow(), x.getColumn(),
+                                      x.getTimestamp(), x.getValue(), proj);
+                return true;
+            }
+            return false;
+        }
+    };
+}
+
 //----------------------------------------------------------------------------
 // ErasureFilter
 //----------------------------------------------------------------------------
@@ -211,37 +235,30 @@ CellStreamPtr kdi::applyPredicateFilter(ScanPredicate const & pred,
     EX_CHECK_NULL(input);
     CellStreamPtr stream = input;
 
-    // Install row filter if predicate specifies a row constraint
-    if(pred.getRowPredicate())
+    // Install a single filter for the row, column, and timestamp
+    // constraints
+    CompiledPredicate compiled(pred);
+    if(compiled.isConstrained())
     {
-        CellStreamPtr filter = makeRowFilter(pred.getRowPredicate());
+        CellStreamPtr filter = makePredicateFilter(compiled);
         filter->pipeFrom(stream);
         std::swap(filter,stream);
     }
 
-    // Install column filter if predicate specifies a column
-    // constraint
-    if(pred.getColumnPredicate())
-    {
-        CellStreamPtr filter = makeColumnFilter(pred.getColumnPredicate());
-        filter->pipeFrom(stream);
-        std::swap(filter,stream);
-    }
-    
-    // Install timestamp filter if predicate specifies a timestamp
+    // Install history filter if predicate specifies a history
     // constraint
-    if(pred.getTimePredicate())
+    if(pred.getMaxHistory())
     {
-        CellStreamPtr filter = makeTimestampFilter(pred.getTimePredicate());
+        CellStreamPtr filter = makeHistoryFilter(pred.getMaxHistory());
         filter->pipeFrom(stream);
         std::swap(filter,stream);
     }
 
-    // Install history filter if predicate specifies a history
-    // constraint
-    if(pred.getMaxHistory())
+    // Install projection filter last, after everything that might
+    // look at the cells
+    if(pred.getProjection() != ScanPredicate::PROJECT_CELLS)
     {
-        CellStreamPtr filter = makeHistoryFilter(pred.getMaxHistory());
+        CellStreamPtr filter = makeProjectionFilter(pred.getProjection());
         filter->pipeFrom(stream);
         std::swap(filter,stream);
     }
@@ -252,19 +269,28 @@ CellStreamPtr kdi::applyPredicateFilter(ScanPredicate const & pred,
 CellStreamPtr kdi::makeRowFilter(
     ScanPredicate::StringSetCPtr const & keepSet)
 {
-    return makeContainmentFilter<Cell>(keepSet, GetCellRow());
+    EX_CHECK_NULL(keepSet);
+    return makePredicateFilter(
+        CompiledPredicate(keepSet, ScanPredicate::StringSetCPtr(),
+                          ScanPredicate::TimestampSetCPtr()));
 }
 
 CellStreamPtr kdi::makeColumnFilter(
     ScanPredicate::StringSetCPtr const & keepSet)
 {
-    return makeContainmentFilter<Cell>(keepSet, GetCellColumn());
+    EX_CHECK_NULL(keepSet);
+    return makePredicateFilter(
+        CompiledPredicate(ScanPredicate::StringSetCPtr(), keepSet,
+                          ScanPredicate::TimestampSetCPtr()));
 }
 
 CellStreamPtr kdi::makeTimestampFilter(
     ScanPredicate::TimestampSetCPtr const & keepSet)
 {
-    return makeContainmentFilter<Cell>(keepSet, GetCellTimestamp());
+    EX_CHECK_NULL(keepSet);
+    return makePredicateFilter(
+        CompiledPredicate(ScanPredicate::StringSetCPtr(),
+                          ScanPredicate::StringSetCPtr(), keepSet));
 }
 
 CellStreamPtr kdi::makeHistoryFilter(int maxHistory)
@@ -273,6 +299,40 @@ CellStreamPtr kdi::makeHistoryFilter(int maxHistory)
     return p;
 }
 
+Cell kdi::makeProjectedCell(strref_t row, strref_t column,
+                            int64_t timestamp, strref_t value,
+                            ScanPredicate::Projection proj)
+{
+    switch(proj)
+    {
+        case ScanPredicate::PROJECT_CELLS:
+            return makeCell(row, column, timestamp, value);
+
+        case ScanPredicate::PROJECT_LENGTHS:
+        {
+            // Format the length by hand; this runs for every cell
+            char buf[24];
+            char * end = buf + sizeof(buf);
+            char * p = end;
+            size_t n = value.size();
+            do {
+                *--p = '0' + n % 10;
+                n /= 10;
+            } while(n);
+            return makeCell(row, column, timestamp, StringRange(p, end));
+        }
+
+        default:
+            return makeCell(row, column, timestamp, StringRange());
+    }
+}
+
+CellStreamPtr kdi::makeProjectionFilter(ScanPredicate::Projection proj)
+{
+    CellStreamPtr p(new ProjectionFilter(proj));
+    return p;
+}
+
 CellStreamPtr kdi::makeErasureFilter()
 {
     CellStreamPtr p(new ErasureFilter);
@@ -27,8 +27,8 @@
 namespace kdi {
 
     /// Wrap a CellStream input with filters appropriate to implement
-    /// the given ScanPredicate.  If the scan is unconstrained, the
-    /// input stream is returned as-is.
+    /// the given ScanPredicate.  The projection is applied last.  If
+    /// the scan is unconstrained, the input stream is returned as-is.
     CellStreamPtr applyPredicateFilter(ScanPredicate const & pred,
                                        CellStreamPtr const & input);
 
@@ -52,6 +52,17 @@ namespace kdi {
     /// specified by ScanPredicate.
     CellStreamPtr makeHistoryFilter(int maxHistory);
 
+    /// Make a CellStream filter that implements the given projection,
+    /// as specified by ScanPredicate.  Erasures and merge operands
+    /// pass through unchanged.
+    CellStreamPtr makeProjectionFilter(ScanPredicate::Projection proj);
+
+    /// Make a plain Cell with the given key and a value chosen by the
+    /// projection.  Only the size of \c value is used unless the
+    /// projection returns whole cells.
+    Cell makeProjectedCell(strref_t row, strref_t column, int64_t timestamp,
+                           strref_t value, ScanPredicate::Projection proj);
+
     /// Make a CellStream filter that strips out Cell erasures.
     CellStreamPtr makeErasureFilter();
 
@@ -534,3 +534,60 @@ BOOST_AUTO_UNIT_TEST(history_filter_test)
                         ));
     }
 }
+
+BOOST_AUTO_UNIT_TEST(projection_filter_test)
+{
+    test_out_t out;
+
+    // Set up a table with known contents
+    TablePtr tbl = makeTestTable(2, 2, 2);
+
+    // Keys only
+    BOOST_CHECK((out << *tbl->scan("project = keys")).is_equal(
+                    "(row-1,col-1,2,)"
+                    "(row-1,col-1,1,)"
+                    "(row-1,col-2,2,)"
+                    "(row-1,col-2,1,)"
+                    "(row-2,col-1,2,)"
+                    "(row-2,col-1,1,)"
+                    "(row-2,col-2,2,)"
+                    "(row-2,col-2,1,)"
+                    ));
+
+    // First matching key of each row
+    BOOST_CHECK((out << *tbl->scan("project = rows")).is_equal(
+                    "(row-1,col-1,2,)"
+                    "(row-2,col-1,2,)"
+                    ));
+    BOOST_CHECK((out << *tbl->scan("column = 'col-2' and time = @1 and "
+                                   "project = rows")).is_equal(
+                    "(row-1,col-2,1,)"
+                    "(row-2,col-2,1,)"
+                    ));
+
+    // Value lengths, after history
+    BOOST_CHECK((out << *tbl->scan("history = 1 and "
+                                   "project = lengths")).is_equal(
+                    "(row-1,col-1,2,9)"
+                    "(row-1,col-2,2,9)"
+                    "(row-2,col-1,2,9)"
+                    "(row-2,col-2,2,9)"
+                    ));
+
+    // Erasures pass through with the filter on its own
+    {
+        CellStreamPtr s = makeProjectionFilter(ScanPredicate::PROJECT_ROWS);
+        TablePtr raw = MemoryTable::create(false);
+        raw->erase("row-1", "col-1", 3);
+        raw->set("row-1", "col-1", 2, "x");
+        raw->set("row-1", "col-2", 2, "y");
+        s->pipeFrom(raw->scan());
+
+        Cell x;
+        BOOST_REQUIRE(s->get(x));
+        BOOST_CHECK(x.isErasure());
+        BOOST_REQUIRE(s->get(x));
+        BOOST_CHECK_EQUAL(x, makeCell("row-1", "col-1", 2, ""));
+        BOOST_CHECK(!s->get(x));
+    }
+}
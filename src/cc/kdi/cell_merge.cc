@@ -0,0 +1,324 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <kdi/cell_merge.h>
+#include <kdi/merge_operator.h>
+#include <ex/exception.h>
+#include <algorithm>
+
+using namespace kdi;
+using namespace warp;
+using namespace ex;
+
+namespace {
+
+    /// Three-way compare of two strings.  Cells from the same source
+    /// often share row and column storage, so check for the same
+    /// bytes before comparing them.
+    inline int compareRange(StringRange const & a, StringRange const & b)
+    {
+        if(a.begin() == b.begin() && a.size() == b.size())
+            return 0;
+        return string_compare(a, b);
+    }
+
+}
+
+//----------------------------------------------------------------------------
+// CellMerge::Input
+//----------------------------------------------------------------------------
+bool CellMerge::Input::readNext()
+{
+    hasValue = stream->get(value);
+    if(hasValue)
+    {
+        // The Cell holds a reference to its data, so the ranges are
+        // good until the next read
+        row = value.getRow();
+        column = value.getColumn();
+        timestamp = value.getTimestamp();
+    }
+    else
+    {
+        value.release();
+        row = StringRange();
+        column = StringRange();
+        timestamp = 0;
+    }
+    return hasValue;
+}
+
+//----------------------------------------------------------------------------
+// CellMerge
+//----------------------------------------------------------------------------
+CellMerge::CellMerge(bool filterErasures) :
+    runnerUp(NO_INPUT),
+    filterErasures(filterErasures),
+    inputChanged(false)
+{
+}
+
+bool CellMerge::inputLess(size_t a, size_t b) const
+{
+    Input const & x = inputs[a];
+    Input const & y = inputs[b];
+
+    if(!x.hasValue)
+        return false;
+    if(!y.hasValue)
+        return true;
+
+    // Order by row, column, and timestamp descending, then by input
+    // rank so the earliest input wins ties
+    if(int cmp = compareRange(x.row, y.row))
+        return cmp < 0;
+    if(int cmp = compareRange(x.column, y.column))
+        return cmp < 0;
+    if(x.timestamp != y.timestamp)
+        return y.timestamp < x.timestamp;
+    return a < b;
+}
+
+void CellMerge::rebuild()
+{
+    runnerUp = NO_INPUT;
+
+    size_t const k = inputs.size();
+    if(!k)
+    {
+        tree.clear();
+        return;
+    }
+
+    // Play the tournament bottom up, keeping the loser of each match
+    // in the tree and passing the winner to the next level
+    tree.assign(k, NO_INPUT);
+    index_vec winners(2 * k);
+    for(size_t i = 0; i < k; ++i)
+        winners[k + i] = i;
+    for(size_t n = k - 1; n > 0; --n)
+    {
+        size_t a = winners[2 * n];
+        size_t b = winners[2 * n + 1];
+        if(inputLess(a, b))
+        {
+            winners[n] = a;
+            tree[n] = b;
+        }
+        else
+        {
+            winners[n] = b;
+            tree[n] = a;
+        }
+    }
+    tree[0] = (k > 1 ? winners[1] : 0);
+}
+
+void CellMerge::replay(size_t idx)
+{
+    size_t const k = inputs.size();
+    size_t winner = idx;
+    for(size_t n = (idx + k) >> 1; n > 0; n >>= 1)
+    {
+        if(inputLess(tree[n], winner))
+            std::swap(tree[n], winner);
+    }
+    tree[0] = winner;
+}
+
+size_t CellMerge::findRunnerUp() const
+{
+    // The runner-up only lost to the winner, so it's one of the
+    // losers on the winner's path to the root
+    size_t const k = inputs.size();
+    size_t best = NO_INPUT;
+    for(size_t n = (tree[0] + k) >> 1; n > 0; n >>= 1)
+    {
+        if(best == NO_INPUT || inputLess(tree[n], best))
+            best = tree[n];
+    }
+    return best;
+}
+
+void CellMerge::advance()
+{
+    size_t const winner = tree[0];
+    inputs[winner].readNext();
+
+    if(inputs.size() == 1)
+        return;
+
+    // If the winner still beats the runner-up, it beats every input
+    // it played on the way to the root, so the tree is unchanged
+    if(runnerUp != NO_INPUT && inputLess(winner, runnerUp))
+        return;
+
+    replay(winner);
+
+    // Same input won again.  Find the runner-up so the rest of the
+    // run can take the fast path.
+    if(tree[0] == winner)
+        runnerUp = findRunnerUp();
+    else
+        runnerUp = NO_INPUT;
+}
+
+void CellMerge::setInputs(std::vector<CellStreamPtr> const & streams)
+{
+    input_vec newInputs;
+    newInputs.reserve(streams.size());
+    for(std::vector<CellStreamPtr>::const_iterator i = streams.begin();
+        i != streams.end(); ++i)
+    {
+        if(!*i)
+            raise<ValueError>("null input");
+
+        input_vec::const_iterator it = inputs.begin();
+        while(it != inputs.end() && it->stream != *i)
+            ++it;
+
+        // Keep the position and buffered value of existing inputs
+        if(it != inputs.end())
+            newInputs.push_back(*it);
+        else
+            newInputs.push_back(Input(*i));
+    }
+
+    // Ranks may have changed, so the tree is rebuilt on the next get()
+    inputs.swap(newInputs);
+    tree.clear();
+    runnerUp = NO_INPUT;
+    inputChanged = true;
+}
+
+void CellMerge::pipeFrom(CellStreamPtr const & input)
+{
+    if(!input)
+        raise<ValueError>("null input");
+
+    inputs.push_back(Input(input));
+    inputChanged = true;
+}
+
+bool CellMerge::nextUnique(Cell & x)
+{
+    if(tree.empty() || !inputs[tree[0]].hasValue)
+        return false;
+
+    // Grab the winning Cell and its key.  The key ranges stay valid
+    // while we hold a reference to the Cell.
+    Input const & top = inputs[tree[0]];
+    x = top.value;
+    StringRange row = top.row;
+    StringRange column = top.column;
+    int64_t timestamp = top.timestamp;
+    advance();
+
+    // Drop the same key from later inputs
+    for(;;)
+    {
+        Input const & next = inputs[tree[0]];
+        if(!next.hasValue ||
+           next.timestamp != timestamp ||
+           compareRange(next.column, column) ||
+           compareRange(next.row, row))
+        {
+            break;
+        }
+        advance();
+    }
+    return true;
+}
+
+void CellMerge::foldOperands(Cell & x)
+{
+    // Gather the operands of the run and the first Cell beneath
+    // them.  Erasures beneath the run have already hidden their own
+    // key, so they are skipped.
+    operands.clear();
+    operands.push_back(x);
+    StringRange row = x.getRow();
+    StringRange column = x.getColumn();
+    Cell base;
+    Cell y;
+    for(;;)
+    {
+        Input const & next = inputs[tree[0]];
+        if(!next.hasValue ||
+           compareRange(next.column, column) ||
+           compareRange(next.row, row))
+        {
+            break;
+        }
+
+        nextUnique(y);
+        if(y.isErasure())
+            continue;
+        if(!y.isMergeOperand())
+        {
+            base = y;
+            break;
+        }
+        operands.push_back(y);
+    }
+
+    x = foldMergeOperands(operands, base);
+    operands.clear();
+}
+
+bool CellMerge::get(Cell & x)
+{
+    if(inputChanged)
+    {
+        // Input set has changed, fetch it into the tree
+        fetch();
+        inputChanged = false;
+    }
+
+    while(nextUnique(x))
+    {
+        if(!filterErasures)
+            return true;
+
+        // With erasures filtered, the merge sees the whole history
+        // of each column, so merge operands can be folded
+        if(x.isErasure())
+            continue;
+        if(x.isMergeOperand())
+            foldOperands(x);
+        return true;
+    }
+    return false;
+}
+
+bool CellMerge::fetch()
+{
+    // Read inputs that don't have a buffered value
+    for(input_vec::iterator it = inputs.begin(); it != inputs.end(); ++it)
+    {
+        if(!it->hasValue)
+            it->readNext();
+    }
+
+    rebuild();
+
+    // Return true if there's something left to merge
+    return !tree.empty() && inputs[tree[0]].hasValue;
+}
@@ -21,14 +21,17 @@
 #ifndef KDI_CELL_MERGE_H
 #define KDI_CELL_MERGE_H
 
-#include <flux/merge.h>
 #include <kdi/cell.h>
+#include <warp/string_range.h>
+#include <vector>
+#include <stdint.h>
 
 namespace kdi {
 
     /// Cell stream operator to do an unique ordered merge of multiple
     /// input Cell streams.  Erasure Cells can be filtered out of the
-    /// resulting stream if desired.
+    /// resulting stream if desired, in which case merge operands are
+    /// folded as well.
     class CellMerge;
 
 } // namespace kdi
@@ -36,38 +39,117 @@ namespace kdi {
 //----------------------------------------------------------------------------
 // CellMerge
 //----------------------------------------------------------------------------
-class kdi::CellMerge : public flux::Merge<kdi::Cell>
+/// Unique merge of Cell streams, ordered by (row, column, timestamp
+/// descending).  When the same key appears in more than one input,
+/// the Cell from the earliest input is returned and the others are
+/// dropped.
+///
+/// This is a loser tree specialized for Cells rather than a generic
+/// flux::Merge.  The row, column, and timestamp of each input's
+/// current Cell are read once when the Cell is fetched, so ordering
+/// decisions don't go through the CellInterpreter.  Each get() costs
+/// log2(k) key comparisons for k inputs instead of the 2*log2(k) of
+/// a binary heap.  When the same input keeps winning, as it does
+/// when one fragment holds a long run of the output, the next Cell
+/// is compared against the runner-up alone and the tree is left
+/// untouched.
+///
+/// When erasures are filtered, the merge is assumed to see the full
+/// history of each column, and runs of merge operands are folded
+/// with the Cell beneath them into a single Cell (see
+/// foldMergeOperands()).  Otherwise operands pass through unchanged.
+class kdi::CellMerge
+    : public kdi::CellStream
 {
-    typedef flux::Merge<kdi::Cell> super;
+    /// State for each input stream
+    struct Input
+    {
+        CellStreamPtr stream;
+        Cell value;
+        warp::StringRange row;
+        warp::StringRange column;
+        int64_t timestamp;
+        bool hasValue;
+
+        explicit Input(CellStreamPtr const & stream) :
+            stream(stream), timestamp(0), hasValue(false) {}
+
+        /// Read the next Cell out of the input stream and cache its
+        /// key.  Return true iff there is such a Cell.
+        bool readNext();
+    };
+
+    typedef std::vector<Input> input_vec;
+    typedef std::vector<size_t> index_vec;
+
+    input_vec inputs;
+
+    /// Loser tree over the inputs.  tree[0] is the index of the
+    /// winning input, and tree[1..k-1] hold the loser of the match
+    /// played at each internal node.  Input i is the leaf at
+    /// position k+i.
+    index_vec tree;
+
+    /// Input that would win if the current winner were removed, or
+    /// NO_INPUT if it isn't known.
+    size_t runnerUp;
+
     bool filterErasures;
+    bool inputChanged;
+
+    /// Scratch space for folding merge operands
+    std::vector<Cell> operands;
+
+    enum { NO_INPUT = size_t(-1) };
+
+    /// Return true if input a should be merged before input b.
+    /// Exhausted inputs come after everything else.
+    bool inputLess(size_t a, size_t b) const;
+
+    /// Build the tree from scratch over all inputs.
+    void rebuild();
+
+    /// Play the matches from the given input's leaf up to the root
+    /// after its value has changed.
+    void replay(size_t idx);
+
+    /// Find the best input that isn't the current winner.
+    size_t findRunnerUp() const;
+
+    /// Advance the winning input and restore the tree.
+    void advance();
+
+    /// Get the next Cell in merge order, dropping duplicate keys from
+    /// later inputs.  Erasures are returned.
+    bool nextUnique(Cell & x);
+
+    /// Fold the run of merge operands starting with x.
+    void foldOperands(Cell & x);
+
+    /// Replace the input set with the given streams.
+    void setInputs(std::vector<CellStreamPtr> const & streams);
 
 public:
-    explicit CellMerge(bool filterErasures) :
-        super(true, super::value_cmp_t()),
-        filterErasures(filterErasures)
-    {
-    }
+    explicit CellMerge(bool filterErasures);
 
-    bool get(Cell & x)
+    void pipeFrom(CellStreamPtr const & input);
+
+    /// Replace the set of merge inputs with the streams in the range
+    /// [first, last), given in merge order.  Streams that were
+    /// already inputs to the merge keep their current position and
+    /// any buffered value, so the merge continues where it left off
+    /// without rereading them.  Old inputs not in the new set are
+    /// released.  New inputs are read on the next call to get().
+    template <class It>
+    void replaceInputs(It first, It last)
     {
-        if(filterErasures)
-        {
-            // Only return non-erasure cells
-            while(super::get(x))
-            {
-                if(!x.isErasure())
-                    return true;
-            }
-            // No more cells
-            return false;
-        }
-        else
-        {
-            // Return all merged cells
-            return super::get(x);
-        }
+        std::vector<CellStreamPtr> streams(first, last);
+        setInputs(streams);
     }
 
+    bool get(Cell & x);
+    bool fetch();
+
     /// Return a smart pointer to a new CellMerge stream
     static boost::shared_ptr<CellMerge> make(bool filterErasures)
     {
@@ -0,0 +1,257 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <kdi/cell_merge.h>
+#include <flux/merge.h>
+#include <flux/sequence.h>
+#include <unittest/main.h>
+#include <boost/format.hpp>
+#include <algorithm>
+#include <deque>
+#include <vector>
+#include <stdlib.h>
+
+using namespace kdi;
+using namespace std;
+using boost::format;
+
+namespace
+{
+    typedef deque<Cell> cell_seq_t;
+    typedef flux::Sequence<cell_seq_t> cell_seq_stream_t;
+
+    struct CellEq
+    {
+        bool operator()(Cell const & a, Cell const & b) const
+        {
+            return a == b;
+        }
+    };
+
+    /// Make a sorted, unique random input stream.  Keys are drawn
+    /// from a small space so inputs overlap and collide.
+    CellStreamPtr makeRandomInput(size_t idx, size_t nCells)
+    {
+        cell_seq_t cells;
+        for(size_t i = 0; i < nCells; ++i)
+        {
+            string row = (format("row-%d") % (rand() % 50)).str();
+            string col = (format("col-%d") % (rand() % 5)).str();
+            int64_t ts = rand() % 3;
+            if(rand() % 10 == 0)
+                cells.push_back(makeCellErasure(row, col, ts));
+            else
+                cells.push_back(
+                    makeCell(row, col, ts,
+                             (format("val-%d-%d") % idx % i).str()));
+        }
+        sort(cells.begin(), cells.end());
+        cells.erase(unique(cells.begin(), cells.end(), CellEq()),
+                    cells.end());
+
+        CellStreamPtr p(new cell_seq_stream_t(cells));
+        return p;
+    }
+
+    CellStreamPtr makeInput(char const * const * rows)
+    {
+        cell_seq_t cells;
+        for(; *rows; ++rows)
+            cells.push_back(makeCell(*rows, "col", 0, *rows));
+        CellStreamPtr p(new cell_seq_stream_t(cells));
+        return p;
+    }
+
+    /// Check that two Cells have the same key, value, and erasure
+    /// status.
+    bool sameCell(Cell const & a, Cell const & b)
+    {
+        if(!(a == b) || a.isErasure() != b.isErasure())
+            return false;
+        return a.isErasure() || a.getValue() == b.getValue();
+    }
+}
+
+BOOST_AUTO_UNIT_TEST(cell_merge_matches_flux_merge)
+{
+    srand(42);
+
+    for(size_t nInputs = 0; nInputs <= 9; ++nInputs)
+    {
+        for(int filter = 0; filter < 2; ++filter)
+        {
+            // Build the same inputs twice
+            vector<CellStreamPtr> inputsA;
+            vector<CellStreamPtr> inputsB;
+            unsigned seed = rand();
+            srand(seed);
+            for(size_t i = 0; i < nInputs; ++i)
+                inputsA.push_back(makeRandomInput(i, 20 + rand() % 200));
+            srand(seed);
+            for(size_t i = 0; i < nInputs; ++i)
+                inputsB.push_back(makeRandomInput(i, 20 + rand() % 200));
+
+            CellStreamPtr merge = CellMerge::make(filter);
+            flux::Merge<Cell>::handle_t expected =
+                flux::makeMergeUnique<Cell>();
+            for(size_t i = 0; i < nInputs; ++i)
+            {
+                merge->pipeFrom(inputsA[i]);
+                expected->pipeFrom(inputsB[i]);
+            }
+
+            Cell x, y;
+            size_t n = 0;
+            for(;;)
+            {
+                bool gotY = expected->get(y);
+                while(gotY && filter && y.isErasure())
+                    gotY = expected->get(y);
+                bool gotX = merge->get(x);
+
+                BOOST_REQUIRE_EQUAL(gotX, gotY);
+                if(!gotX)
+                    break;
+                BOOST_CHECK(sameCell(x, y));
+                ++n;
+            }
+
+            if(nInputs)
+                BOOST_CHECK(n > 0);
+        }
+    }
+}
+
+BOOST_AUTO_UNIT_TEST(cell_merge_earliest_wins)
+{
+    // Same key in every input: the first input's Cell comes out
+    CellStreamPtr merge = CellMerge::make(false);
+    for(int i = 0; i < 5; ++i)
+    {
+        cell_seq_t cells;
+        cells.push_back(makeCell("row", "col", 7, (format("%d") % i).str()));
+        CellStreamPtr p(new cell_seq_stream_t(cells));
+        merge->pipeFrom(p);
+    }
+
+    Cell x;
+    BOOST_CHECK(merge->get(x));
+    BOOST_CHECK_EQUAL(x.getValue(), "0");
+    BOOST_CHECK(!merge->get(x));
+}
+
+BOOST_AUTO_UNIT_TEST(cell_merge_filter_erasures)
+{
+    // An erasure in an earlier input hides the older input's Cell
+    cell_seq_t newer;
+    newer.push_back(makeCellErasure("a", "col", 1));
+    newer.push_back(makeCell("c", "col", 1, "c"));
+
+    cell_seq_t older;
+    older.push_back(makeCell("a", "col", 1, "a"));
+    older.push_back(makeCell("b", "col", 1, "b"));
+
+    CellStreamPtr merge = CellMerge::make(true);
+    merge->pipeFrom(CellStreamPtr(new cell_seq_stream_t(newer)));
+    merge->pipeFrom(CellStreamPtr(new cell_seq_stream_t(older)));
+
+    Cell x;
+    BOOST_CHECK(merge->get(x));
+    BOOST_CHECK_EQUAL(x.getRow(), "b");
+    BOOST_CHECK(merge->get(x));
+    BOOST_CHECK_EQUAL(x.getRow(), "c");
+    BOOST_CHECK(!merge->get(x));
+}
+
+BOOST_AUTO_UNIT_TEST(cell_merge_replace_inputs)
+{
+    char const * A[] = { "01", "03", "05", "07", "09", "11", 0 };
+    char const * B[] = { "02", "04", "06", "08", "10", "12", 0 };
+    char const * C[] = { "06", "08", "10", 0 };
+
+    // After replacing B with C at 04: A continues from 05, C is read
+    // from the start, and the rest of B is dropped
+    char const * M[] = { "01", "02", "03", "04", "05", "06", "07", "08",
+                         "09", "10", "11", 0 };
+
+    CellStreamPtr a = makeInput(A);
+    CellStreamPtr b = makeInput(B);
+    CellStreamPtr c = makeInput(C);
+
+    boost::shared_ptr<CellMerge> merge = CellMerge::make(true);
+    merge->pipeFrom(a);
+    merge->pipeFrom(b);
+
+    Cell x;
+    size_t i = 0;
+    for(; i < 4; ++i)
+    {
+        BOOST_CHECK(merge->get(x));
+        BOOST_CHECK_EQUAL(x.getRow(), M[i]);
+    }
+
+    CellStreamPtr inputs[] = { c, a };
+    merge->replaceInputs(inputs, inputs + 2);
+
+    for(; M[i]; ++i)
+    {
+        BOOST_CHECK(merge->get(x));
+        BOOST_CHECK_EQUAL(x.getRow(), M[i]);
+    }
+    BOOST_CHECK(!merge->get(x));
+}
+
+BOOST_AUTO_UNIT_TEST(cell_merge_long_runs)
+{
+    // Inputs that take turns winning long runs, to exercise the
+    // runner-up fast path
+    size_t const N_INPUTS = 6;
+    size_t const RUN = 100;
+    size_t const N_RUNS = 10;
+
+    vector<cell_seq_t> seqs(N_INPUTS);
+    for(size_t r = 0; r < N_RUNS; ++r)
+    {
+        for(size_t i = 0; i < N_INPUTS; ++i)
+        {
+            for(size_t j = 0; j < RUN; ++j)
+            {
+                string row = (format("row-%03d-%d-%03d") % r % i % j).str();
+                seqs[i].push_back(makeCell(row, "col", 0, row));
+            }
+        }
+    }
+
+    CellStreamPtr merge = CellMerge::make(true);
+    for(size_t i = 0; i < N_INPUTS; ++i)
+        merge->pipeFrom(CellStreamPtr(new cell_seq_stream_t(seqs[i])));
+
+    Cell x;
+    string last;
+    size_t n = 0;
+    while(merge->get(x))
+    {
+        string row = str(x.getRow());
+        BOOST_CHECK(last < row);
+        last = row;
+        ++n;
+    }
+    BOOST_CHECK_EQUAL(n, N_INPUTS * RUN * N_RUNS);
+}
@@ -0,0 +1,191 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <kdi/compiled_predicate.h>
+#include <warp/string_algorithm.h>
+#include <algorithm>
+#include <limits>
+
+using namespace kdi;
+using namespace warp;
+using namespace std;
+
+namespace {
+
+    /// Time sets up to this size are checked with a linear scan.
+    /// The loop has no branches, so the compiler can vectorize it.
+    size_t const SMALL_TIME_SET = 16;
+
+    /// True if a lower bound is passed at the boundary value, or an
+    /// upper bound is exited there.
+    inline bool passedAtValue(PointType t)
+    {
+        return t == PT_INCLUSIVE_LOWER_BOUND || t == PT_EXCLUSIVE_UPPER_BOUND;
+    }
+}
+
+//----------------------------------------------------------------------------
+// CompiledPredicate::StringSet
+//----------------------------------------------------------------------------
+CompiledPredicate::StringSet::StringSet(IntervalSet<string> const & set) :
+    offsets(1, 0),
+    nInitial(0)
+{
+    for(IntervalSet<string>::const_iterator i = set.begin();
+        i != set.end(); ++i)
+    {
+        switch(i->getType())
+        {
+            case PT_INFINITE_LOWER_BOUND:
+                // Always passed
+                ++nInitial;
+                break;
+
+            case PT_INFINITE_UPPER_BOUND:
+                // Never passed
+                break;
+
+            default:
+                data += i->getValue();
+                offsets.push_back(data.size());
+                passAt.push_back(passedAtValue(i->getType()));
+                break;
+        }
+    }
+}
+
+bool CompiledPredicate::StringSet::contains(strref_t x) const
+{
+    char const * d = data.c_str();
+    size_t const * off = &offsets[0];
+    unsigned char const * pass = passAt.empty() ? 0 : &passAt[0];
+
+    // Count boundaries passed by x.  The boundaries are sorted, so
+    // the ones passed are a prefix of the array.
+    size_t base = 0;
+    size_t n = passAt.size();
+    while(n)
+    {
+        size_t half = n >> 1;
+        size_t mid = base + half;
+        int cmp = string_compare(x.begin(), x.end(),
+                                 d + off[mid], d + off[mid+1]);
+        bool passed = cmp > 0 || (cmp == 0 && pass[mid]);
+        base = passed ? mid + 1 : base;
+        n = passed ? n - half - 1 : half;
+    }
+
+    // Inside the set after an odd number of boundaries
+    return (nInitial + base) & 1;
+}
+
+
+//----------------------------------------------------------------------------
+// CompiledPredicate::TimeSet
+//----------------------------------------------------------------------------
+CompiledPredicate::TimeSet::TimeSet(IntervalSet<int64_t> const & set) :
+    nInitial(0)
+{
+    int64_t const MAX_TIME = numeric_limits<int64_t>::max();
+
+    for(IntervalSet<int64_t>::const_iterator i = set.begin();
+        i != set.end(); ++i)
+    {
+        int64_t v = i->getValue();
+        switch(i->getType())
+        {
+            case PT_INFINITE_LOWER_BOUND:
+                ++nInitial;
+                break;
+
+            case PT_INFINITE_UPPER_BOUND:
+                break;
+
+            case PT_INCLUSIVE_LOWER_BOUND:
+            case PT_EXCLUSIVE_UPPER_BOUND:
+                bounds.push_back(v);
+                break;
+
+            default:
+                // Passed after the value.  Nothing comes after the
+                // maximum time.
+                if(v != MAX_TIME)
+                    bounds.push_back(v + 1);
+                break;
+        }
+    }
+}
+
+bool CompiledPredicate::TimeSet::contains(int64_t x) const
+{
+    size_t passed;
+    if(bounds.size() <= SMALL_TIME_SET)
+    {
+        passed = 0;
+        for(size_t i = 0; i < bounds.size(); ++i)
+            passed += (bounds[i] <= x);
+    }
+    else
+    {
+        passed = upper_bound(bounds.begin(), bounds.end(), x) -
+            bounds.begin();
+    }
+    return (nInitial + passed) & 1;
+}
+
+
+//----------------------------------------------------------------------------
+// CompiledPredicate
+//----------------------------------------------------------------------------
+CompiledPredicate::CompiledPredicate() :
+    hasRows(false),
+    hasColumns(false),
+    hasTimes(false)
+{
+}
+
+CompiledPredicate::CompiledPredicate(ScanPredicate const & pred) :
+    hasRows(pred.getRowPredicate()),
+    hasColumns(pred.getColumnPredicate()),
+    hasTimes(pred.getTimePredicate())
+{
+    if(hasRows)
+        rows = StringSet(*pred.getRowPredicate());
+    if(hasColumns)
+        columns = StringSet(*pred.getColumnPredicate());
+    if(hasTimes)
+        times = TimeSet(*pred.getTimePredicate());
+}
+
+CompiledPredicate::CompiledPredicate(
+    ScanPredicate::StringSetCPtr const & rows,
+    ScanPredicate::StringSetCPtr const & columns,
+    ScanPredicate::TimestampSetCPtr const & times) :
+    hasRows(rows),
+    hasColumns(columns),
+    hasTimes(times)
+{
+    if(hasRows)
+        this->rows = StringSet(*rows);
+    if(hasColumns)
+        this->columns = StringSet(*columns);
+    if(hasTimes)
+        this->times = TimeSet(*times);
+}
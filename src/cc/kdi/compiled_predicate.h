@@ -0,0 +1,122 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#ifndef KDI_COMPILED_PREDICATE_H
+#define KDI_COMPILED_PREDICATE_H
+
+#include <kdi/scan_predicate.h>
+#include <kdi/cell.h>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace kdi {
+
+    class CompiledPredicate;
+
+} // namespace kdi
+
+//----------------------------------------------------------------------------
+// CompiledPredicate
+//----------------------------------------------------------------------------
+/// The row, column, and time constraints of a ScanPredicate in a form
+/// suited to checking every cell in a scan.  Each interval set is
+/// flattened into a sorted array of boundaries.  A value is in the
+/// set iff it has passed an odd number of boundaries, which can be
+/// counted with a binary search (or a linear scan for small time
+/// sets) without allocating or following pointers.  The history
+/// constraint is not part of the compiled predicate.
+class kdi::CompiledPredicate
+{
+    /// Flattened set of strings.
+    class StringSet
+    {
+        std::string data;                   // Boundary values
+        std::vector<size_t> offsets;        // N+1 offsets into data
+        std::vector<unsigned char> passAt;  // Boundary passed on equality
+        size_t nInitial;                    // Boundaries always passed
+
+    public:
+        StringSet() : offsets(1, 0), nInitial(0) {}
+        explicit StringSet(warp::IntervalSet<std::string> const & set);
+        bool contains(warp::strref_t x) const;
+    };
+
+    /// Flattened set of timestamps.  Bounds are adjusted so every
+    /// boundary is passed when x >= bound.
+    class TimeSet
+    {
+        std::vector<int64_t> bounds;
+        size_t nInitial;
+
+    public:
+        TimeSet() : nInitial(0) {}
+        explicit TimeSet(warp::IntervalSet<int64_t> const & set);
+        bool contains(int64_t x) const;
+    };
+
+    StringSet rows;
+    StringSet columns;
+    TimeSet times;
+    bool hasRows;
+    bool hasColumns;
+    bool hasTimes;
+
+public:
+    /// Create an unconstrained predicate.
+    CompiledPredicate();
+
+    /// Compile the row, column, and time constraints of a predicate.
+    explicit CompiledPredicate(ScanPredicate const & pred);
+
+    /// Compile the given constraints.  Null sets are unconstrained.
+    CompiledPredicate(ScanPredicate::StringSetCPtr const & rows,
+                      ScanPredicate::StringSetCPtr const & columns,
+                      ScanPredicate::TimestampSetCPtr const & times);
+
+    /// True if the predicate may exclude some cells.
+    bool isConstrained() const { return hasRows || hasColumns || hasTimes; }
+
+    bool containsRow(warp::strref_t row) const
+    {
+        return !hasRows || rows.contains(row);
+    }
+
+    bool containsColumn(warp::strref_t column) const
+    {
+        return !hasColumns || columns.contains(column);
+    }
+
+    bool containsTime(int64_t t) const
+    {
+        return !hasTimes || times.contains(t);
+    }
+
+    /// True if the cell satisfies all of the constraints.  The
+    /// cheapest check is done first.
+    bool contains(Cell const & x) const
+    {
+        return ( containsTime(x.getTimestamp()) &&
+                 containsColumn(x.getColumn()) &&
+                 containsRow(x.getRow()) );
+    }
+};
+
+#endif // KDI_COMPILED_PREDICATE_H
@@ -0,0 +1,172 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <kdi/compiled_predicate.h>
+#include <kdi/scan_predicate.h>
+#include <unittest/main.h>
+#include <limits>
+#include <string>
+#include <stdlib.h>
+
+using namespace kdi;
+using namespace warp;
+using namespace std;
+
+namespace {
+
+    /// Check the compiled predicate against the interval sets it was
+    /// built from.
+    void checkRows(ScanPredicate const & pred, CompiledPredicate const & cp,
+                   string const & row)
+    {
+        BOOST_CHECK_EQUAL(cp.containsRow(row),
+                          pred.getRowPredicate()->contains(row));
+    }
+
+    void checkTime(ScanPredicate const & pred, CompiledPredicate const & cp,
+                   int64_t t)
+    {
+        BOOST_CHECK_EQUAL(cp.containsTime(t),
+                          pred.getTimePredicate()->contains(t));
+    }
+
+    string randomString()
+    {
+        string s;
+        size_t len = rand() % 4;
+        for(size_t i = 0; i < len; ++i)
+            s += char('a' + rand() % 4);
+        return s;
+    }
+
+    Interval<string> randomStringInterval()
+    {
+        string a = randomString();
+        string b = randomString();
+        if(b < a)
+            swap(a, b);
+
+        Interval<string> x;
+        switch(rand() % 3)
+        {
+            case 0: x.setLowerBound(a, BT_INCLUSIVE); break;
+            case 1: x.setLowerBound(a, BT_EXCLUSIVE); break;
+            case 2: x.unsetLowerBound(); break;
+        }
+        switch(rand() % 3)
+        {
+            case 0: x.setUpperBound(b, BT_INCLUSIVE); break;
+            case 1: x.setUpperBound(b, BT_EXCLUSIVE); break;
+            case 2: x.unsetUpperBound(); break;
+        }
+        return x;
+    }
+
+    Interval<int64_t> randomTimeInterval()
+    {
+        int64_t a = rand() % 64;
+        int64_t b = rand() % 64;
+        if(b < a)
+            swap(a, b);
+
+        Interval<int64_t> x;
+        x.setLowerBound(a, (rand() & 1) ? BT_INCLUSIVE : BT_EXCLUSIVE);
+        x.setUpperBound(b, (rand() & 1) ? BT_INCLUSIVE : BT_EXCLUSIVE);
+        return x;
+    }
+}
+
+BOOST_AUTO_UNIT_TEST(unconstrained_test)
+{
+    CompiledPredicate cp((ScanPredicate()));
+    BOOST_CHECK(!cp.isConstrained());
+    BOOST_CHECK(cp.contains(makeCell("row", "col", 42, "val")));
+
+    CompiledPredicate cp2((ScanPredicate("history = 1")));
+    BOOST_CHECK(!cp2.isConstrained());
+}
+
+BOOST_AUTO_UNIT_TEST(parsed_test)
+{
+    ScanPredicate pred(
+        "row < 'b' or 'd' <= row <= 'f' or row ~= 'x' and "
+        "column ~= 'fam:' and time > @10");
+    CompiledPredicate cp(pred);
+    BOOST_CHECK(cp.isConstrained());
+
+    char const * rows[] = { "", "a", "azzz", "b", "c", "d", "e", "f",
+                            "f\x01", "g", "x", "xyz", "y" };
+    for(size_t i = 0; i < sizeof(rows) / sizeof(*rows); ++i)
+        checkRows(pred, cp, rows[i]);
+
+    BOOST_CHECK(cp.contains(makeCell("a", "fam:q", 11, "v")));
+    BOOST_CHECK(cp.contains(makeCell("f", "fam:", 11, "v")));
+    BOOST_CHECK(!cp.contains(makeCell("c", "fam:q", 11, "v")));
+    BOOST_CHECK(!cp.contains(makeCell("a", "fan:q", 11, "v")));
+    BOOST_CHECK(!cp.contains(makeCell("a", "fam:q", 10, "v")));
+}
+
+BOOST_AUTO_UNIT_TEST(time_limits_test)
+{
+    int64_t const MAX_TIME = numeric_limits<int64_t>::max();
+    int64_t const MIN_TIME = numeric_limits<int64_t>::min();
+
+    IntervalSet<int64_t> set;
+    set.add(Interval<int64_t>().setLowerBound(MIN_TIME, BT_INCLUSIVE)
+            .setUpperBound(0, BT_INCLUSIVE));
+    set.add(Interval<int64_t>().setLowerBound(MAX_TIME - 1, BT_EXCLUSIVE)
+            .setUpperBound(MAX_TIME, BT_INCLUSIVE));
+
+    ScanPredicate pred;
+    pred.setTimePredicate(set);
+    CompiledPredicate cp(pred);
+
+    int64_t times[] = { MIN_TIME, MIN_TIME + 1, -1, 0, 1,
+                        MAX_TIME - 2, MAX_TIME - 1, MAX_TIME };
+    for(size_t i = 0; i < sizeof(times) / sizeof(*times); ++i)
+        checkTime(pred, cp, times[i]);
+}
+
+BOOST_AUTO_UNIT_TEST(random_sets_test)
+{
+    srand(1234);
+    for(int iter = 0; iter < 200; ++iter)
+    {
+        // Big enough to use both the linear and binary search paths
+        IntervalSet<string> rows;
+        IntervalSet<int64_t> times;
+        size_t nIntervals = rand() % 20;
+        for(size_t i = 0; i < nIntervals; ++i)
+        {
+            rows.add(randomStringInterval());
+            times.add(randomTimeInterval());
+        }
+
+        ScanPredicate pred;
+        pred.setRowPredicate(rows);
+        pred.setTimePredicate(times);
+        CompiledPredicate cp(pred);
+
+        for(int i = 0; i < 50; ++i)
+            checkRows(pred, cp, randomString());
+        for(int64_t t = -1; t < 66; ++t)
+            checkTime(pred, cp, t);
+    }
+}
@@ -21,25 +21,170 @@
 #include <kdi/hash/HashedTable.h>
 #include <kdi/cell_merge.h>
 #include <kdi/scan_predicate.h>
+#include <flux/threaded_reader.h>
+#include <warp/WorkerPool.h>
+#include <warp/interval.h>
 #include <warp/hsieh_hash.h>
+#include <warp/strutil.h>
+#include <warp/log.h>
 #include <ex/exception.h>
 #include <boost/algorithm/string.hpp>
+#include <algorithm>
 
 using namespace kdi;
 using namespace kdi::hash;
+using warp::IntervalSet;
+using warp::Interval;
+
+namespace {
+
+    struct SizeOfCell
+    {
+        size_t operator()(Cell const & x) const
+        {
+            return sizeof(Cell) + x.getRow().size() + x.getColumn().size()
+                + x.getValue().size();
+        }
+    };
+
+    typedef flux::ThreadedReader<Cell, SizeOfCell> reader_t;
+    typedef boost::shared_ptr<reader_t> reader_ptr;
+
+    size_t const READ_UP_TO = 128 << 10;
+
+    /// Get the configured read-ahead size for backend scans.
+    size_t loadReadAhead()
+    {
+        if(char * s = getenv("KDI_HASH_READ_AHEAD"))
+            return warp::parseSize(s);
+        return 1 << 20;
+    }
+
+    /// Get the read-ahead size for backend scans, or 0 if read-ahead
+    /// is disabled.
+    size_t getReadAhead()
+    {
+        static size_t const readAhead = loadReadAhead();
+        return readAhead;
+    }
+
+    /// Get the thread pool shared by all HashedTable scans.  Scans
+    /// can outlive the table that made them, so the pool lives for
+    /// the life of the process.
+    warp::WorkerPool & getScanPool()
+    {
+        static warp::WorkerPool * pool = 0;
+        static boost::mutex mutex;
+
+        boost::mutex::scoped_lock lock(mutex);
+        if(!pool)
+        {
+            size_t nThreads = 8;
+            if(char * s = getenv("KDI_HASH_SCAN_THREADS"))
+                nThreads = warp::parseSize(s);
+            if(!nThreads)
+                nThreads = 1;
+
+            warp::log("HashedTable scan pool: %d thread(s)", nThreads);
+            pool = new warp::WorkerPool(nThreads, "HashedTable scan", false);
+        }
+        return *pool;
+    }
+
+    /// Get the point value if the interval contains exactly one row.
+    bool getPoint(Interval<std::string> const & x, std::string & row)
+    {
+        if(x.getLowerBound().getType() != warp::PT_INCLUSIVE_LOWER_BOUND ||
+           x.getUpperBound().getType() != warp::PT_INCLUSIVE_UPPER_BOUND ||
+           x.getLowerBound().getValue() != x.getUpperBound().getValue())
+        {
+            return false;
+        }
+
+        row = x.getLowerBound().getValue();
+        return true;
+    }
+}
 
 //----------------------------------------------------------------------------
 // HashedTable
 //----------------------------------------------------------------------------
+size_t HashedTable::getTableIndex(strref_t row) const
+{
+    uint32_t h = warp::hsieh_hash(row.begin(), row.end());
+    return h % tables.size();
+}
 
 TablePtr const & HashedTable::pick(strref_t row)
 {
-    uint32_t h = warp::hsieh_hash(row.begin(), row.end());
-    TableInfo & i = tables[h % tables.size()];
+    TableInfo & i = tables[getTableIndex(row)];
     i.isDirty = true;
     return i.table;
 }
 
+bool HashedTable::routeRows(ScanPredicate const & pred,
+                            scan_vec & scans) const
+{
+    ScanPredicate::StringSetCPtr rows = pred.getRowPredicate();
+    if(!rows)
+        return false;
+
+    // Sort the rows into per-table sets.  The row predicate is
+    // already in order, so each add() appends to its set.
+    std::vector<IntervalSet<std::string> > tableRows(tables.size());
+    std::string row;
+    for(IntervalSet<std::string>::const_iterator lo = rows->begin();
+        lo != rows->end(); lo += 2)
+    {
+        Interval<std::string> x(*lo, *(lo+1));
+        if(!getPoint(x, row))
+            return false;
+
+        tableRows[getTableIndex(row)].add(x);
+    }
+
+    scans.clear();
+    for(size_t i = 0; i < tableRows.size(); ++i)
+    {
+        if(tableRows[i].isEmpty())
+            continue;
+
+        scans.push_back(std::make_pair(i, pred));
+        scans.back().second.setRowPredicate(tableRows[i]);
+    }
+    return true;
+}
+
+CellStreamPtr HashedTable::mergeScans(scan_vec const & scans) const
+{
+    // Nothing to merge for a single table
+    if(scans.size() == 1)
+        return tables[scans[0].first].table->scan(scans[0].second);
+
+    size_t readAhead = getReadAhead();
+
+    CellStreamPtr merge = CellMerge::make(false);
+    for(scan_vec::const_iterator i = scans.begin(); i != scans.end(); ++i)
+    {
+        CellStreamPtr scan = tables[i->first].table->scan(i->second);
+        if(!readAhead)
+        {
+            merge->pipeFrom(scan);
+            continue;
+        }
+
+        // Start filling a buffer for each backend right away.  The
+        // merge will read them in turn, and we don't want to wait
+        // for each backend's first block one after another.
+        reader_ptr reader(
+            new reader_t(getScanPool(), readAhead, READ_UP_TO));
+        reader->pipeFrom(scan);
+        reader->start();
+        merge->pipeFrom(reader);
+    }
+    return merge;
+}
+
 HashedTable::HashedTable(std::vector<TablePtr> const & tables)
 {
     using namespace ex;
@@ -67,18 +212,73 @@ void HashedTable::erase(strref_t row, strref_t column, int64_t timestamp)
 
 void HashedTable::insert(Cell const & x)
 {
-    pick(x.getRow())->insert(x);
+    if(x.getErasureKind() == ERASE_ROWS)
+        Table::insert(x);
+    else
+        pick(x.getRow())->insert(x);
 }
 
-CellStreamPtr HashedTable::scan(ScanPredicate const & pred) const
+void HashedTable::eraseRowRange(strref_t firstRow, strref_t endRow,
+                                int64_t maxTimestamp)
 {
-    CellStreamPtr merge = CellMerge::make(false);
-    for(std::vector<TableInfo>::const_iterator i = tables.begin();
+    for(std::vector<TableInfo>::iterator i = tables.begin();
         i != tables.end(); ++i)
     {
-        merge->pipeFrom(i->table->scan(pred));
+        i->isDirty = true;
+        i->table->eraseRowRange(firstRow, endRow, maxTimestamp);
     }
-    return merge;
+}
+
+void HashedTable::eraseColumnFamily(strref_t row, strref_t family,
+                                    int64_t maxTimestamp)
+{
+    pick(row)->eraseColumnFamily(row, family, maxTimestamp);
+}
+
+void HashedTable::merge(strref_t row, strref_t column, int64_t timestamp,
+                        strref_t op, strref_t operand)
+{
+    pick(row)->merge(row, column, timestamp, op, operand);
+}
+
+CellStreamPtr HashedTable::scan(ScanPredicate const & pred) const
+{
+    scan_vec scans;
+    if(!routeRows(pred, scans))
+    {
+        // Rows are spread over all tables by hash, so any range of
+        // rows could be anywhere
+        for(size_t i = 0; i < tables.size(); ++i)
+            scans.push_back(std::make_pair(i, pred));
+    }
+    else if(scans.empty())
+    {
+        return CellMerge::make(false);
+    }
+
+    return mergeScans(scans);
+}
+
+CellStreamPtr HashedTable::getRows(std::vector<std::string> const & rows,
+                                   ScanPredicate const & pred) const
+{
+    // Build a row predicate with a point for each row, in order
+    std::vector<std::string> sorted(rows);
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+    if(sorted.empty())
+        return CellMerge::make(false);
+
+    IntervalSet<std::string> rowSet;
+    for(std::vector<std::string>::const_iterator i = sorted.begin();
+        i != sorted.end(); ++i)
+    {
+        rowSet.add(Interval<std::string>().setPoint(*i));
+    }
+
+    ScanPredicate p(pred);
+    p.setRowPredicate(rowSet);
+    return scan(p);
 }
 
 void HashedTable::sync()
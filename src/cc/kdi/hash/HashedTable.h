@@ -22,9 +22,11 @@
 #define KDI_HASH_HASHEDTABLE_H
 
 #include <kdi/table.h>
+#include <kdi/scan_predicate.h>
 #include <boost/noncopyable.hpp>
 #include <vector>
 #include <string>
+#include <utility>
 
 namespace kdi {
 namespace hash {
@@ -50,12 +52,27 @@ class kdi::hash::HashedTable
             table(table), isDirty(false) {}
     };
 
+    typedef std::vector<std::pair<size_t, ScanPredicate> > scan_vec;
+
     std::vector<TableInfo> tables;
 
+    /// Get the index of the table that owns the given row.
+    inline size_t getTableIndex(strref_t row) const;
+
     /// Pick a table for mutation based on the row key.  The
     /// associated TableInfo will have its dirty flag set.
     inline TablePtr const & pick(strref_t row);
 
+    /// If the predicate selects only individual rows, split it into
+    /// one predicate per table that owns some of the rows and return
+    /// true.  Otherwise return false.
+    bool routeRows(ScanPredicate const & pred, scan_vec & scans) const;
+
+    /// Open the given scans on their tables and merge the results.
+    /// When there is more than one scan, the scans read ahead in
+    /// parallel on a shared thread pool.
+    CellStreamPtr mergeScans(scan_vec const & scans) const;
+
 public:
     /// Construct a HashedTable from vector of open Tables.  Requests
     /// will be distributed between the tables based on a hash of the
@@ -66,7 +83,27 @@ public:
                      strref_t value);
     virtual void erase(strref_t row, strref_t column, int64_t timestamp);
     virtual void insert(Cell const & x);
+
+    /// A row range may hold rows owned by any table, so the erasure
+    /// is sent to all of them.
+    virtual void eraseRowRange(strref_t firstRow, strref_t endRow,
+                               int64_t maxTimestamp);
+    virtual void eraseColumnFamily(strref_t row, strref_t family,
+                                   int64_t maxTimestamp);
+    virtual void merge(strref_t row, strref_t column, int64_t timestamp,
+                       strref_t op, strref_t operand);
+
+    /// Scan the table.  If the predicate selects only individual
+    /// rows, only the tables owning those rows are scanned.
     virtual CellStreamPtr scan(ScanPredicate const & pred) const;
+
+    /// Get the cells of many rows at once.  The rows are grouped by
+    /// owning table so each table gets at most one scan, no matter
+    /// how many rows are requested.  Column and time restrictions
+    /// are taken from \c pred; its row predicate is ignored.
+    CellStreamPtr getRows(std::vector<std::string> const & rows,
+                          ScanPredicate const & pred) const;
+
     virtual void sync();
     virtual RowIntervalStreamPtr scanIntervals() const;
 };
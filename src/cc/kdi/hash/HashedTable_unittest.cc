@@ -0,0 +1,176 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <kdi/hash/HashedTable.h>
+#include <kdi/memory_table.h>
+#include <kdi/scan_predicate.h>
+#include <kdi/table_unittest.h>
+#include <unittest/main.h>
+#include <boost/format.hpp>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace kdi;
+using namespace kdi::hash;
+using namespace kdi::unittest;
+using namespace std;
+using boost::format;
+
+namespace
+{
+    struct HashFixture
+    {
+        vector<TablePtr> parts;
+        TablePtr table;
+
+        explicit HashFixture(size_t n)
+        {
+            for(size_t i = 0; i < n; ++i)
+                parts.push_back(MemoryTable::create(true));
+            table.reset(new HashedTable(parts));
+        }
+
+        /// Get the index of the one partition holding the row, or
+        /// parts.size() if the row isn't in exactly one of them.
+        size_t findRow(string const & row) const
+        {
+            ScanPredicate pred((format("row = '%s'") % row).str());
+            size_t found = parts.size();
+            for(size_t i = 0; i < parts.size(); ++i)
+            {
+                if(!countCells(parts[i]->scan(pred)))
+                    continue;
+                if(found != parts.size())
+                    return parts.size();
+                found = i;
+            }
+            return found;
+        }
+    };
+
+    string rowName(size_t i)
+    {
+        return (format("row-%03d") % i).str();
+    }
+
+    /// Print a scan, values and all
+    string dump(CellStreamPtr const & scan)
+    {
+        ostringstream out;
+        Cell x;
+        while(scan->get(x))
+            out << x << endl;
+        return out.str();
+    }
+}
+
+BOOST_AUTO_UNIT_TEST(interface_test)
+{
+    HashFixture fix(3);
+    testTableInterface(fix.table);
+}
+
+BOOST_AUTO_UNIT_TEST(routing_test)
+{
+    HashFixture fix(4);
+
+    // Every write for a row goes to the same partition
+    for(size_t i = 0; i < 100; ++i)
+    {
+        fix.table->set(rowName(i), "a:x", 1, "v");
+        fix.table->insert(makeCell(rowName(i), "a:y", 2, "v"));
+        fix.table->merge(rowName(i), "b:n", 3, "add", "1");
+    }
+    fix.table->erase(rowName(7), "a:x", 1);
+    fix.table->eraseColumnFamily(rowName(8), "a", 10);
+    fix.table->sync();
+
+    vector<size_t> perPart(fix.parts.size());
+    for(size_t i = 0; i < 100; ++i)
+    {
+        size_t part = fix.findRow(rowName(i));
+        BOOST_REQUIRE(part < fix.parts.size());
+        ++perPart[part];
+
+        // A second table over the same partitions agrees
+        HashedTable other(fix.parts);
+        other.set(rowName(i), "c:z", 4, "again");
+        BOOST_CHECK_EQUAL(fix.findRow(rowName(i)), part);
+    }
+
+    // The rows are spread over all the partitions
+    for(size_t i = 0; i < perPart.size(); ++i)
+        BOOST_CHECK(perPart[i] > 0);
+
+    // Cell erasures stay with their row
+    test_out_t out;
+    BOOST_CHECK((out << *fix.table->scan(
+                     ScanPredicate("row = 'row-007' and column = 'a:x'")))
+                .is_empty());
+    BOOST_CHECK((out << *fix.table->scan(
+                     ScanPredicate("row = 'row-008' and column ~= 'a:'")))
+                .is_empty());
+}
+
+BOOST_AUTO_UNIT_TEST(scan_merge_test)
+{
+    HashFixture fix(4);
+    MemoryTablePtr plain = MemoryTable::create(true);
+    for(size_t i = 0; i < 200; ++i)
+    {
+        for(size_t j = 0; j < 3; ++j)
+        {
+            string col = (format("c:%d") % j).str();
+            fix.table->set(rowName(i), col, j + 1, "v");
+            plain->set(rowName(i), col, j + 1, "v");
+        }
+    }
+    fix.table->sync();
+
+    // Full and range scans merge the partitions back into order
+    char const * preds[] = {
+        "",
+        "'row-050' <= row < 'row-120'",
+        "row = 'row-003' or row = 'row-077' or row = 'row-150'",
+        "row = 'row-999'",
+        "column = 'c:1' and time >= @2",
+    };
+    for(size_t i = 0; i < sizeof(preds) / sizeof(*preds); ++i)
+    {
+        ScanPredicate pred(preds[i]);
+        BOOST_CHECK_EQUAL(dump(fix.table->scan(pred)),
+                          dump(plain->scan(pred)));
+    }
+    BOOST_CHECK_EQUAL(countCells(fix.table->scan(ScanPredicate())), 600u);
+
+    // Batched row gets ignore duplicates and order
+    vector<string> rows;
+    rows.push_back(rowName(150));
+    rows.push_back(rowName(3));
+    rows.push_back(rowName(150));
+    rows.push_back(rowName(77));
+    HashedTable const & hashed =
+        static_cast<HashedTable const &>(*fix.table);
+    BOOST_CHECK_EQUAL(dump(hashed.getRows(rows, ScanPredicate())),
+                      dump(plain->scan(ScanPredicate(preds[2]))));
+    BOOST_CHECK_EQUAL(
+        countCells(hashed.getRows(vector<string>(), ScanPredicate())), 0u);
+}
@@ -0,0 +1,214 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <kdi/local/cache_manifest.h>
+#include <warp/filestream.h>
+#include <warp/fs.h>
+#include <warp/log.h>
+#include <ex/exception.h>
+#include <algorithm>
+#include <iostream>
+
+using namespace kdi::local;
+using namespace warp;
+using namespace ex;
+using namespace std;
+
+namespace {
+
+    typedef IndexCache::count_vec::value_type count_t;
+
+    struct HotterThan
+    {
+        bool operator()(count_t const & a, count_t const & b) const
+        {
+            return a.second > b.second;
+        }
+    };
+}
+
+//----------------------------------------------------------------------------
+// CacheManifest
+//----------------------------------------------------------------------------
+void CacheManifest::save(IndexCache & cache, std::string const & uri)
+{
+    // Access counts come back most recently used first, so a stable
+    // sort breaks ties by recency
+    IndexCache::count_vec counts;
+    cache.getAccessCounts(counts);
+    std::stable_sort(counts.begin(), counts.end(), HotterThan());
+
+    string tmpUri = fs::changeExtension(uri, ".tmp");
+    FileStream out(File::output(tmpUri));
+    for(IndexCache::count_vec::const_iterator i = counts.begin();
+        i != counts.end(); ++i)
+    {
+        out << i->second << '\t' << i->first << '\n';
+    }
+    out.close();
+
+    fs::rename(tmpUri, uri, true);
+}
+
+bool CacheManifest::load(std::string const & uri,
+                         IndexCache::count_vec & out)
+{
+    if(!fs::exists(uri))
+        return false;
+
+    FileStream in(File::input(uri));
+    size_t count;
+    string fn;
+    while(in >> count)
+    {
+        if(in.get() != '\t' || !std::getline(in, fn) || fn.empty())
+            raise<ValueError>("bad cache manifest: %s", uri);
+        out.push_back(make_pair(fn, count));
+    }
+    if(!in.eof())
+        raise<ValueError>("bad cache manifest: %s", uri);
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// CacheWarmer
+//----------------------------------------------------------------------------
+CacheWarmer::CacheWarmer(IndexCache * cache,
+                         IndexCache::count_vec const & hotSet,
+                         warp::WorkStealingPool & pool,
+                         size_t maxBytes, int64_t maxNs) :
+    cache(cache),
+    hotSet(hotSet),
+    maxBytes(maxBytes),
+    maxNs(maxNs),
+    nextIdx(0),
+    nRunning(0),
+    cancelled(false),
+    nRestored(0),
+    nFailed(0),
+    restoredBytes(0),
+    elapsedNs(0)
+{
+    EX_CHECK_NULL(cache);
+
+    size_t nTasks = std::min(pool.getWorkerCount(), hotSet.size());
+    for(size_t i = 0; i < nTasks; ++i)
+        tasks.push_back(new Task(this));
+
+    // Lock so no task can finish before they're all submitted
+    lock_t lock(mutex);
+    nRunning = tasks.size();
+    for(boost::ptr_vector<Task>::iterator i = tasks.begin();
+        i != tasks.end(); ++i)
+    {
+        pool.submit(&*i, WorkStealingPool::BACKGROUND);
+    }
+}
+
+CacheWarmer::~CacheWarmer()
+{
+    cancel();
+    wait();
+}
+
+bool CacheWarmer::takeNext(size_t & idx)
+{
+    lock_t lock(mutex);
+    if(cancelled || nextIdx == hotSet.size() ||
+       restoredBytes >= maxBytes || timer.getElapsedNs() >= maxNs)
+    {
+        return false;
+    }
+
+    idx = nextIdx++;
+    return true;
+}
+
+void CacheWarmer::warm()
+{
+    size_t idx;
+    while(takeNext(idx))
+    {
+        string const & fn = hotSet[idx].first;
+
+        size_t sz = 0;
+        bool failed = false;
+        try {
+            sz = cache->prefetch(fn);
+        }
+        catch(std::exception const & err) {
+            log("Cache warmer: skipping %s: %s", fn, err.what());
+            failed = true;
+        }
+
+        lock_t lock(mutex);
+        if(failed)
+            ++nFailed;
+        else if(sz)
+        {
+            ++nRestored;
+            restoredBytes += sz;
+        }
+    }
+
+    lock_t lock(mutex);
+    if(!--nRunning)
+    {
+        elapsedNs = timer.getElapsedNs();
+        doneCond.notify_all();
+    }
+}
+
+void CacheWarmer::wait()
+{
+    lock_t lock(mutex);
+    while(nRunning)
+        doneCond.wait(lock);
+}
+
+void CacheWarmer::cancel()
+{
+    lock_t lock(mutex);
+    cancelled = true;
+}
+
+size_t CacheWarmer::getRestoredCount()
+{
+    lock_t lock(mutex);
+    return nRestored;
+}
+
+size_t CacheWarmer::getFailedCount()
+{
+    lock_t lock(mutex);
+    return nFailed;
+}
+
+size_t CacheWarmer::getRestoredBytes()
+{
+    lock_t lock(mutex);
+    return restoredBytes;
+}
+
+int64_t CacheWarmer::getElapsedNs()
+{
+    lock_t lock(mutex);
+    return elapsedNs;
+}
@@ -0,0 +1,146 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#ifndef KDI_LOCAL_CACHE_MANIFEST_H
+#define KDI_LOCAL_CACHE_MANIFEST_H
+
+#include <kdi/local/index_cache.h>
+#include <warp/WorkStealingPool.h>
+#include <warp/Runnable.h>
+#include <warp/timer.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <string>
+
+namespace kdi {
+namespace local {
+
+    class CacheManifest;
+    class CacheWarmer;
+
+} // namespace local
+} // namespace kdi
+
+//----------------------------------------------------------------------------
+// CacheManifest
+//----------------------------------------------------------------------------
+/// A list of the index files in an IndexCache with their access
+/// counts, hottest first.  A server saves the manifest now and then
+/// and uses it to warm the cache after a restart.  The manifest is a
+/// text file with one "count<TAB>file" line per index.
+class kdi::local::CacheManifest
+{
+public:
+    /// Write the contents of the cache to a manifest file, in order
+    /// of decreasing access count.  Ties are broken by recency.  The
+    /// manifest is written to a temporary file and renamed into
+    /// place.
+    static void save(IndexCache & cache, std::string const & uri);
+
+    /// Read a manifest written by save() into \c out.  Returns false
+    /// if the manifest doesn't exist.
+    static bool load(std::string const & uri, IndexCache::count_vec & out);
+};
+
+//----------------------------------------------------------------------------
+// CacheWarmer
+//----------------------------------------------------------------------------
+/// Prefetch the indexes from a manifest into an IndexCache in the
+/// background.  Indexes are loaded in manifest order by up to one
+/// task per pool worker.  Each one goes in behind those loaded
+/// before it, so if the cache fills up the coldest are dropped.  Warming stops when the manifest is done,
+/// when the byte or time budget runs out, or when it is cancelled.
+/// Indexes that fail to load (e.g. the fragment has since been
+/// deleted) are skipped.
+class kdi::local::CacheWarmer
+    : private boost::noncopyable
+{
+    class Task : public warp::Runnable
+    {
+        CacheWarmer * warmer;
+    public:
+        explicit Task(CacheWarmer * warmer) : warmer(warmer) {}
+        void run() { warmer->warm(); }
+    };
+
+    typedef boost::mutex::scoped_lock lock_t;
+
+    IndexCache * cache;
+    IndexCache::count_vec hotSet;
+    size_t maxBytes;
+    int64_t maxNs;
+
+    boost::ptr_vector<Task> tasks;
+    warp::WallTimer timer;
+
+    boost::mutex mutex;
+    boost::condition doneCond;
+    size_t nextIdx;
+    size_t nRunning;
+    bool cancelled;
+
+    size_t nRestored;
+    size_t nFailed;
+    size_t restoredBytes;
+    int64_t elapsedNs;
+
+    void warm();
+    bool takeNext(size_t & idx);
+
+public:
+    /// Start warming the cache with the files in \c hotSet.  Loading
+    /// stops once \c maxBytes of indexes have been loaded or
+    /// \c maxNs nanoseconds have passed.  The pool must outlive the
+    /// warmer.
+    CacheWarmer(IndexCache * cache,
+                IndexCache::count_vec const & hotSet,
+                warp::WorkStealingPool & pool,
+                size_t maxBytes, int64_t maxNs);
+
+    /// Cancel any remaining work and wait for the tasks to finish.
+    ~CacheWarmer();
+
+    /// Wait for warming to finish.
+    void wait();
+
+    /// Stop loading new indexes.  Loads already in progress finish.
+    void cancel();
+
+    /// Number of files in the hot set.
+    size_t getHotSetCount() const { return hotSet.size(); }
+
+    /// Number of indexes loaded into the cache so far.  Indexes that
+    /// were already cached don't count.
+    size_t getRestoredCount();
+
+    /// Number of indexes that couldn't be loaded.
+    size_t getFailedCount();
+
+    /// Total size of the indexes loaded so far.
+    size_t getRestoredBytes();
+
+    /// Time from the start of warming until the last task finished.
+    /// Only meaningful after wait().
+    int64_t getElapsedNs();
+};
+
+#endif // KDI_LOCAL_CACHE_MANIFEST_H
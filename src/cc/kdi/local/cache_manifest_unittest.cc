@@ -0,0 +1,175 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <kdi/local/cache_manifest.h>
+#include <kdi/local/disk_table_writer.h>
+#include <unittest/main.h>
+#include <warp/WorkStealingPool.h>
+#include <warp/file.h>
+#include <ex/exception.h>
+#include <boost/format.hpp>
+#include <string>
+
+using namespace kdi;
+using namespace kdi::local;
+using namespace warp;
+using namespace ex;
+using namespace std;
+using boost::format;
+
+namespace {
+
+    string makeTable(size_t i)
+    {
+        string fn = (format("memfs:warm/%d") % i).str();
+
+        CurDiskTableWriter out(128);
+        out.open(fn);
+        for(size_t r = 0; r < 50; ++r)
+            out.put(makeCell((format("row-%05d") % r).str(), "x", 0, "v"));
+        out.close();
+
+        return fn;
+    }
+
+    void touch(IndexCache & cache, string const & fn, size_t n)
+    {
+        for(size_t i = 0; i < n; ++i)
+            cache.release(cache.get(fn));
+    }
+}
+
+BOOST_AUTO_UNIT_TEST(manifest_test)
+{
+    string t0 = makeTable(0);
+    string t1 = makeTable(1);
+    string t2 = makeTable(2);
+
+    IndexCache cache(size_t(1) << 20);
+    touch(cache, t0, 1);
+    touch(cache, t1, 3);
+    touch(cache, t2, 1);
+
+    // Hottest first, ties broken by recency
+    CacheManifest::save(cache, "memfs:warm/manifest");
+
+    IndexCache::count_vec hot;
+    BOOST_CHECK(CacheManifest::load("memfs:warm/manifest", hot));
+    BOOST_REQUIRE_EQUAL(hot.size(), 3u);
+    BOOST_CHECK_EQUAL(hot[0].first, t1);
+    BOOST_CHECK_EQUAL(hot[0].second, 3u);
+    BOOST_CHECK_EQUAL(hot[1].first, t2);
+    BOOST_CHECK_EQUAL(hot[2].first, t0);
+
+    // Missing manifests are not an error
+    IndexCache::count_vec none;
+    BOOST_CHECK(!CacheManifest::load("memfs:warm/nothing", none));
+    BOOST_CHECK(none.empty());
+
+    // Bad ones are
+    FilePtr fp = File::output("memfs:warm/bad");
+    fp->write("junk\n", 5);
+    fp->close();
+    BOOST_CHECK_THROW(CacheManifest::load("memfs:warm/bad", none),
+                      ValueError);
+}
+
+BOOST_AUTO_UNIT_TEST(warm_test)
+{
+    IndexCache::count_vec hot;
+    for(size_t i = 0; i < 10; ++i)
+        hot.push_back(make_pair(makeTable(i), 10 - i));
+    hot.push_back(make_pair(string("memfs:warm/missing"), 0));
+
+    WorkStealingPool pool(3, "Warm test", false);
+
+    // Warm everything
+    {
+        IndexCache cache(size_t(1) << 20);
+        touch(cache, hot[0].first, 1);
+
+        CacheWarmer warmer(&cache, hot, pool, size_t(1) << 20,
+                           int64_t(60) * 1000000000);
+        warmer.wait();
+
+        // The first one was already cached
+        BOOST_CHECK_EQUAL(warmer.getHotSetCount(), 11u);
+        BOOST_CHECK_EQUAL(warmer.getRestoredCount(), 9u);
+        BOOST_CHECK_EQUAL(warmer.getFailedCount(), 1u);
+        BOOST_CHECK(warmer.getRestoredBytes() > 0u);
+
+        // Warmed indexes have no accesses yet
+        IndexCache::count_vec counts;
+        cache.getAccessCounts(counts);
+        BOOST_CHECK_EQUAL(counts.size(), 10u);
+        for(size_t i = 0; i < counts.size(); ++i)
+        {
+            BOOST_CHECK_EQUAL(counts[i].second,
+                              counts[i].first == hot[0].first ? 1u : 0u);
+        }
+    }
+
+    // A byte budget stops warming early
+    {
+        IndexCache cache(size_t(1) << 20);
+        CacheWarmer warmer(&cache, hot, pool, 1,
+                           int64_t(60) * 1000000000);
+        warmer.wait();
+
+        // Each task can start one load before the budget is used up
+        BOOST_CHECK(warmer.getRestoredCount() >= 1u);
+        BOOST_CHECK(warmer.getRestoredCount() <= 3u);
+    }
+
+    // So does a time budget
+    {
+        IndexCache cache(size_t(1) << 20);
+        CacheWarmer warmer(&cache, hot, pool, size_t(1) << 20, 0);
+        warmer.wait();
+        BOOST_CHECK_EQUAL(warmer.getRestoredCount(), 0u);
+    }
+
+    // A full cache keeps the hottest indexes
+    {
+        size_t sz;
+        {
+            IndexCache cache(size_t(1) << 20);
+            sz = cache.prefetch(hot[0].first);
+        }
+        BOOST_REQUIRE(sz);
+
+        WorkStealingPool onePool(1, "Warm test", false);
+        IndexCache cache(3 * sz + sz / 2);
+        CacheWarmer warmer(&cache, hot, onePool, size_t(1) << 20,
+                           int64_t(60) * 1000000000);
+        warmer.wait();
+        onePool.shutdown();
+
+        BOOST_CHECK_EQUAL(warmer.getRestoredCount(), 3u);
+        IndexCache::count_vec counts;
+        cache.getAccessCounts(counts);
+        BOOST_REQUIRE_EQUAL(counts.size(), 3u);
+        BOOST_CHECK_EQUAL(counts[0].first, hot[0].first);
+        BOOST_CHECK_EQUAL(counts[1].first, hot[1].first);
+        BOOST_CHECK_EQUAL(counts[2].first, hot[2].first);
+    }
+
+    pool.shutdown();
+}
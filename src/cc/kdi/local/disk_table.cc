@@ -20,11 +20,13 @@
 
 #include <kdi/local/disk_table.h>
 #include <kdi/local/table_types.h>
+#include <kdi/marshal/cell_data.h>
 #include <kdi/scan_predicate.h>
 #include <kdi/cell_filter.h>
 #include <oort/fileio.h>
 #include <warp/file.h>
 #include <warp/adler.h>
+#include <warp/crc32c.h>
 #include <warp/bloom_filter.h>
 #include <warp/log.h>
 #include <ex/exception.h>
@@ -66,7 +68,39 @@ namespace
         {
             return lt(*a.lastRow, b);
         }
+
+        bool operator()(strref_t a, CellData const & b) const
+        {
+            return a < StringRange(*b.key.row);
+        }
+
+        bool operator()(strref_t a, IndexEntryV1 const & b) const
+        {
+            return a < StringRange(*b.lastRow);
+        }
     };
+
+    /// Get a V1, V2, or V3 block index.  Later versions only add
+    /// fields to the end of the V1 index.
+    BlockIndexV1 const * getIndex(CacheRecord const & indexRec)
+    {
+        if(indexRec.getVersion() >= BlockIndexV2::VERSION)
+            return indexRec.cast<BlockIndexV2>();
+        return indexRec.as<BlockIndexV1>();
+    }
+
+    /// Get the function that computes block checksums for an index
+    template <class R>
+    checksum_fn_t getChecksumFn(R const & indexRec)
+    {
+        if(indexRec.getVersion() >= BlockIndexV2::VERSION &&
+           indexRec.template cast<BlockIndexV2>()->checksumType ==
+           BlockIndexV2::CHECKSUM_CRC32C)
+        {
+            return &crc32c;
+        }
+        return &adler;
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -90,13 +124,26 @@ namespace
 
         // Index data
         CacheRecord indexRec;
+        BlockIndexV1 const * index;
         IndexEntryV1 const * indexIt;
+        checksum_fn_t checksum;
 
         // Current CellBlock
         Record blockRec;
         CellData const * cellIt;
         CellData const * cellEnd;
 
+        // Projection for plain cells.  With skipRows, only the first
+        // cell of each row is returned.  If the rest of a row spans
+        // whole blocks, skipIndexIt is the next block worth reading.
+        // The rest of the row may still spill into the next block
+        // read, so remember the last row returned.
+        ScanPredicate::Projection projection;
+        bool skipRows;
+        IndexEntryV1 const * skipIndexIt;
+        string skippedRow;
+        bool haveSkippedRow;
+
         /// Read the next CellBlock record from the input stream.  If
         /// there is a block, set the cell iterators to the full range
         /// of the block.  Otherwise, release the record and set the
@@ -109,14 +156,14 @@ namespace
 
             // Advance to the index entry for the next block
             if(nextIndexIt) {
-                if(nextIndexIt >= indexRec.cast<BlockIndexV1>()->blocks.end()) return false;
+                if(nextIndexIt >= index->blocks.end()) return false;
                 input->seek(nextIndexIt->blockOffset);
                 indexIt = nextIndexIt;
                 nextIndexIt = 0;
             } else if(indexIt) {
                 ++indexIt;
             } else {
-                indexIt = indexRec.cast<BlockIndexV1>()->blocks.begin();
+                indexIt = index->blocks.begin();
             }
 
             if(times) {
@@ -140,11 +187,12 @@ namespace
             }
 
             // Read the next record and make sure it is a CellBlock
-            if(input->get(blockRec) && blockRec.tryAs<CellBlock>())
+            if(input->get(blockRec) && (blockRec.tryAs<CellBlock>() ||
+                                        blockRec.tryAs<CellBlockV1>()))
             {
                 // Verify the checksum
-                uint32_t checksum = adler((uint8_t*)blockRec.getData(), blockRec.getLength());
-                if(indexIt->blockChecksum != checksum) {
+                uint32_t sum = checksum((uint8_t*)blockRec.getData(), blockRec.getLength());
+                if(indexIt->blockChecksum != sum) {
                     log("BAD CHECKSUM: skipping block");
                     goto nextBlock;
                 }
@@ -213,7 +261,6 @@ namespace
             // Else use the index to find the position of the next
             // row segment.  If the index points us off the end,
             // we're done.
-            BlockIndexV1 const * index = indexRec.cast<BlockIndexV1>();
             IndexEntryV1 const * ent;
 
             ent = std::lower_bound(
@@ -251,7 +298,9 @@ namespace
             {
                 // Load the next block.  If there is no next block,
                 // then we're at the end of the stream.
-                if(!readNextBlock())
+                IndexEntryV1 const * next = skipIndexIt;
+                skipIndexIt = 0;
+                if(!readNextBlock(next))
                     return false;
             }
             else
@@ -275,6 +324,27 @@ namespace
             return true;
         }
 
+        /// Move past the rest of the given row.  Cells in the current
+        /// block are skipped with a search, and blocks holding
+        /// nothing but the row are skipped using the index.
+        void skipRow(strref_t row)
+        {
+            skippedRow.assign(row.begin(), row.end());
+            haveSkippedRow = true;
+
+            cellIt = std::upper_bound(cellIt, cellEnd, row, RowLt());
+            if(cellIt != cellEnd ||
+               cellEnd != blockRec.cast<CellBlock>()->cells.end())
+            {
+                return;
+            }
+
+            IndexEntryV1 const * ent = std::upper_bound(
+                indexIt + 1, index->blocks.end(), row, RowLt());
+            if(ent != indexIt + 1)
+                skipIndexIt = ent;
+        }
+
     public:
         /// Create a full-scan DiskScanner
         explicit DiskScanner(FilePtr const & fp,
@@ -284,9 +354,15 @@ namespace
             upperBound(string(), PT_INFINITE_UPPER_BOUND),
             colFamilyMask(0),
             indexRec(cache, fn),
+            index(getIndex(indexRec)),
             indexIt(0),
+            checksum(getChecksumFn(indexRec)),
             cellIt(0),
-            cellEnd(0)
+            cellEnd(0),
+            projection(ScanPredicate::PROJECT_CELLS),
+            skipRows(false),
+            skipIndexIt(0),
+            haveSkippedRow(false)
         {
         }
 
@@ -304,15 +380,20 @@ namespace
             colFamilyMask(0),
             times(times),
             indexRec(cache, fn),
+            index(getIndex(indexRec)),
             indexIt(0),
+            checksum(getChecksumFn(indexRec)),
             cellIt(0),
-            cellEnd(0)
+            cellEnd(0),
+            projection(ScanPredicate::PROJECT_CELLS),
+            skipRows(false),
+            skipIndexIt(0),
+            haveSkippedRow(false)
         {
             if(rows)
                 nextRowIt = rows->begin();
 
             if(columnFamilies) {
-                BlockIndexV1 const * index = indexRec.as<BlockIndexV1>();
 
                 // Figure out the column family bitmask now
                 vector<string>::const_iterator cfi;
@@ -330,6 +411,17 @@ namespace
             }
         }
 
+        /// Project plain cells as they are read.  Values are never
+        /// copied for a projection other than PROJECT_CELLS.  A row
+        /// projection skips the rest of each row after its first
+        /// cell, so it must only be used when nothing else would
+        /// filter the cells of a row.
+        void setProjection(ScanPredicate::Projection proj)
+        {
+            projection = proj;
+            skipRows = (proj == ScanPredicate::PROJECT_ROWS);
+        }
+
         bool get(Cell & x)
         {
             for(;;)
@@ -338,21 +430,32 @@ namespace
                 // return the next one
                 if(cellIt != cellEnd)
                 {
-                    if(cellIt->value)
+                    // Drop what's left of a skipped row at the start
+                    // of a new block
+                    if(haveSkippedRow &&
+                       StringRange(*cellIt->key.row) == skippedRow)
                     {
-                        // Normal Cell
-                        x = makeCell(
-                            *cellIt->key.row, *cellIt->key.column,
-                            cellIt->key.timestamp, *cellIt->value);
+                        cellIt = std::upper_bound(
+                            cellIt, cellEnd, skippedRow, RowLt());
+                        continue;
                     }
-                    else
+
+                    CellData const & d = *cellIt;
+                    ++cellIt;
+
+                    // Erasures and merge operands are never projected
+                    if(projection == ScanPredicate::PROJECT_CELLS ||
+                       d.kind != CellData::KIND_CELL || !d.value)
                     {
-                        // Null value means erasure Cell
-                        x = makeCellErasure(
-                            *cellIt->key.row, *cellIt->key.column,
-                            cellIt->key.timestamp);
+                        x = marshal::unmarshalCell(d);
+                        return true;
                     }
-                    ++cellIt;
+
+                    x = makeProjectedCell(*d.key.row, *d.key.column,
+                                          d.key.timestamp, *d.value,
+                                          projection);
+                    if(skipRows)
+                        skipRow(x.getRow());
                     return true;
                 }
 
@@ -388,7 +491,7 @@ namespace
             end(0),
             base(0)
         {
-            BlockIndexV1 const * index = indexRec.as<BlockIndexV1>();
+            BlockIndexV1 const * index = getIndex(indexRec);
 
             RowLt lt;
 
@@ -455,13 +558,22 @@ size_t DiskTable::readVersion(std::string const & fn)
     return r.getVersion();
 }
 
+bool DiskTable::getRowSpan(warp::Interval<std::string> & span) const
+{
+    span.setInfinite();
+    return true;
+}
+
 DiskTablePtr DiskTable::loadTable(std::string const & fn)
 {
     size_t version = readVersion(fn);
     switch(version)
     {
         case 0: return DiskTablePtr(new DiskTableV0(fn));
-        case 1: return DiskTablePtr(new DiskTableV1(fn));
+        case 1:
+        case 2:
+        case 3:
+        case 4: return DiskTablePtr(new DiskTableV1(fn));
     }
 
     raise<RuntimeError>("Unknown TableInfo version %d: %s", version, fn);
@@ -495,14 +607,79 @@ off_t DiskTable::loadIndex(std::string const & fn, oort::Record & r)
 // DiskTableV1
 //----------------------------------------------------------------------------
 DiskTableV1::DiskTableV1(string const & fn) :
-    cache(IndexCache::getGlobal()), fn(fn), indexSize(0), dataSize(0)
+    cache(IndexCache::getGlobal()), fn(fn), indexSize(0), dataSize(0),
+    hasCells(false)
 {
     oort::Record r;
     dataSize = loadIndex(fn, r);
     indexSize = r.getLength();
 
     // Make sure we have the right type
-    r.as<BlockIndexV1>();
+    if(!r.tryAs<BlockIndexV1>())
+    {
+        BlockIndexV2 const * index;
+        if(r.getVersion() >= BlockIndexV3::VERSION)
+        {
+            BlockIndexV3 const * v3 =
+                (r.getVersion() == BlockIndexV3::VERSION
+                 ? r.as<BlockIndexV3>()
+                 : r.as<BlockIndexV4>());
+
+            // Load the range erasures.  Tables don't have many, so
+            // keep them around instead of going back to the index.
+            index = v3;
+            for(CellData const * i = v3->rangeErasures.begin();
+                i != v3->rangeErasures.end(); ++i)
+            {
+                rangeErasures.push_back(marshal::unmarshalCell(*i));
+            }
+        }
+        else
+        {
+            index = r.as<BlockIndexV2>();
+        }
+
+        if(index->checksumType > BlockIndexV2::CHECKSUM_CRC32C)
+            raise<RuntimeError>("unknown block checksum type %d: %s",
+                                index->checksumType, fn);
+    }
+
+    loadRowSpan(r);
+}
+
+void DiskTableV1::loadRowSpan(oort::Record const & indexRec)
+{
+    BlockIndexV1 const * index =
+        (indexRec.getVersion() >= BlockIndexV2::VERSION
+         ? indexRec.cast<BlockIndexV2>()
+         : indexRec.cast<BlockIndexV1>());
+
+    rowSpan.setEmpty();
+    hasCells = !index->blocks.empty();
+    if(!hasCells)
+        return;
+
+    // The index has the last row of every block.  Since V4, it also
+    // has the first row of the table.  Older tables leave the span
+    // open below rather than reading the first block to find it.
+    rowSpan.setUpperBound(str(*index->blocks.end()[-1].lastRow),
+                          BT_INCLUSIVE);
+    if(indexRec.getVersion() >= BlockIndexV4::VERSION)
+        rowSpan.setLowerBound(str(*indexRec.cast<BlockIndexV4>()->firstRow),
+                              BT_INCLUSIVE);
+    else
+        rowSpan.unsetLowerBound();
+}
+
+bool DiskTableV1::getRowSpan(warp::Interval<std::string> & span) const
+{
+    span = rowSpan;
+    return hasCells;
+}
+
+void DiskTableV1::getRangeErasures(std::vector<Cell> & out) const
+{
+    out.insert(out.end(), rangeErasures.begin(), rangeErasures.end());
 }
 
 DiskTableV1::~DiskTableV1()
@@ -515,7 +692,7 @@ CellStreamPtr DiskTableV1::scan(ScanPredicate const & pred) const
     FilePtr fp = File::input(fn);
 
     // Make a disk scanner appropriate for our row predicate
-    CellStreamPtr diskScanner;
+    boost::shared_ptr<DiskScanner> scanner;
     if(ScanPredicate::StringSetCPtr const & rows = pred.getRowPredicate())
     {
         //ScanPredicate::StringSetCPtr const & columns = pred.getColumnPredicate();
@@ -535,18 +712,33 @@ CellStreamPtr DiskTableV1::scan(ScanPredicate const & pred) const
         }
 
         // Make a scanner that handles the row predicate
-        diskScanner.reset(new DiskScanner(fp, rows, famsCopy, times, cache, fn));
+        scanner.reset(new DiskScanner(fp, rows, famsCopy, times, cache, fn));
     }
     else
     {
         // Scan everything
-        diskScanner.reset(new DiskScanner(fp, cache, fn));
+        scanner.reset(new DiskScanner(fp, cache, fn));
+    }
+
+    // The scanner can drop values before the rest of the predicate
+    // is applied, since the filters only look at keys.  It can only
+    // skip rows if nothing else will filter cells out of a row.
+    ScanPredicate rest(pred);
+    rest.clearRowPredicate();
+    if(pred.getProjection() == ScanPredicate::PROJECT_ROWS &&
+       (pred.getColumnPredicate() || pred.getTimePredicate() ||
+        pred.getMaxHistory()))
+    {
+        scanner->setProjection(ScanPredicate::PROJECT_KEYS);
+    }
+    else
+    {
+        scanner->setProjection(pred.getProjection());
+        rest.setProjection(ScanPredicate::PROJECT_CELLS);
     }
 
     // Filter the rest
-    return applyPredicateFilter(
-        ScanPredicate(pred).clearRowPredicate(),
-        diskScanner);
+    return applyPredicateFilter(rest, scanner);
 }
 
 flux::Stream< std::pair<std::string, size_t> >::handle_t
@@ -28,6 +28,7 @@
 #include <oort/fileio.h>
 #include <warp/interval.h>
 #include <string>
+#include <vector>
 
 namespace kdi {
 namespace local {
@@ -72,6 +73,17 @@ public:
     virtual size_t getIndexSize() const = 0;
     virtual size_t getDataSize() const = 0;
 
+    /// Append the row range and column family erasures stored in the
+    /// table to the given vector.  Scans of the table do not apply
+    /// them.  They are meant to be applied to a merge of this table
+    /// and older ones.
+    virtual void getRangeErasures(std::vector<Cell> & out) const {}
+
+    /// Get the span of rows holding cells in the table, so scans
+    /// that can't overlap it can skip the table.  Returns false if
+    /// the table holds no cells.  The default span is unbounded.
+    virtual bool getRowSpan(warp::Interval<std::string> & span) const;
+
     /// Read the table version number from the given file name.  The
     /// file should name a valid table file.
     static size_t readVersion(std::string const & fn);
@@ -115,6 +127,9 @@ public:
 // Enhanced index format supporting:
 //   - Checksum verification
 //   - Column and timestamp filtering
+// Also reads V2 tables, which may use CRC-32C block checksums, V3
+// tables, which may hold range erasures, and V4 tables, which record
+// their first row
 //----------------------------------------------------------------------------
 class kdi::local::DiskTableV1
     : public kdi::local::DiskTable
@@ -123,6 +138,11 @@ class kdi::local::DiskTableV1
     std::string fn;
     size_t indexSize;
     size_t dataSize;
+    std::vector<Cell> rangeErasures;
+    warp::Interval<std::string> rowSpan;
+    bool hasCells;
+
+    void loadRowSpan(oort::Record const & indexRec);
 
 public:
     explicit DiskTableV1(std::string const & fn);
@@ -136,6 +156,9 @@ public:
 
     virtual size_t getIndexSize() const { return indexSize; }
     virtual size_t getDataSize() const { return dataSize; }
+
+    virtual void getRangeErasures(std::vector<Cell> & out) const;
+    virtual bool getRowSpan(warp::Interval<std::string> & span) const;
 };
 
 #endif // KDI_LOCAL_DISK_TABLE_H
@@ -24,7 +24,12 @@
 
 #include <kdi/local/disk_table.h>
 #include <kdi/local/disk_table_writer.h>
+#include <kdi/local/table_types.h>
+#include <oort/recordstream.h>
 #include <warp/fs.h>
+#include <warp/file.h>
+#include <warp/EnvironmentVariable.h>
+#include <ex/exception.h>
 #include <string>
 #include <boost/format.hpp>
 
@@ -402,6 +407,298 @@ BOOST_AUTO_UNIT_TEST(loader_test)
     ));
 }
 
+BOOST_AUTO_UNIT_TEST(crc32c_test)
+{
+    // CRC-32C block checksums read back the same
+    DiskTableWriterV2 out2(128);
+    out2.open("memfs:v2");
+    for(int i = 0; i < 100; ++i)
+        out2.put(makeCell(str(format("row-%03d") % i), "fam:col", i,
+                          "value"));
+    out2.close();
+
+    BOOST_CHECK_EQUAL(DiskTable::readVersion("memfs:v2"), 4u);
+
+    DiskTablePtr dp = DiskTable::loadTable("memfs:v2");
+    BOOST_CHECK_EQUAL(countCells(dp->scan()), 100u);
+    BOOST_CHECK_EQUAL(countCells(dp->scan("row = 'row-042'")), 1u);
+    BOOST_CHECK_EQUAL(
+        countCells(dp->scan("'row-010' <= row < 'row-020' and "
+                            "column ~= 'fam:'")),
+        10u
+    );
+}
+
+BOOST_AUTO_UNIT_TEST(checksum_env_test)
+{
+    {
+        EnvironmentVariable env("KDI_DISK_CHECKSUM");
+        BOOST_CHECK(!DiskTableWriterV1::getDefaultUseCrc32c());
+    }
+    {
+        EnvironmentVariable env("KDI_DISK_CHECKSUM", "adler32");
+        BOOST_CHECK(!DiskTableWriterV1::getDefaultUseCrc32c());
+    }
+    {
+        EnvironmentVariable env("KDI_DISK_CHECKSUM", "crc32c");
+        BOOST_CHECK(DiskTableWriterV1::getDefaultUseCrc32c());
+    }
+    {
+        EnvironmentVariable env("KDI_DISK_CHECKSUM", "md5");
+        BOOST_CHECK_THROW(DiskTableWriterV1::getDefaultUseCrc32c(),
+                          ex::ValueError);
+    }
+}
+
+BOOST_AUTO_UNIT_TEST(merge_block_version_test)
+{
+    // Only blocks holding merge operands are written as CellBlockV1
+    DiskTableWriterV1 out(64);
+    out.open("memfs:kinds");
+    out.put(makeCell("row-1", "fam:col", 1, "value"));
+    out.put(makeMergeOperand("row-2", "fam:col", 1, "add:1"));
+    out.put(makeCell("row-3", "fam:col", 1, "value"));
+    out.close();
+
+    vector<uint32_t> versions;
+    oort::RecordStreamHandle input = oort::inputStream("memfs:kinds");
+    oort::Record r;
+    while(input->get(r))
+    {
+        if(r.getType() == disk::CellBlock::TYPECODE)
+            versions.push_back(r.getVersion());
+    }
+    BOOST_REQUIRE_EQUAL(versions.size(), 3u);
+    BOOST_CHECK_EQUAL(versions[0], uint32_t(disk::CellBlock::VERSION));
+    BOOST_CHECK_EQUAL(versions[1], uint32_t(disk::CellBlockV1::VERSION));
+    BOOST_CHECK_EQUAL(versions[2], uint32_t(disk::CellBlock::VERSION));
+
+    // Both versions read back
+    DiskTablePtr dp = DiskTable::loadTable("memfs:kinds");
+    CellStreamPtr scan = dp->scan();
+    Cell x;
+    BOOST_REQUIRE(scan->get(x));
+    BOOST_CHECK(!x.isMergeOperand());
+    BOOST_REQUIRE(scan->get(x));
+    BOOST_CHECK(x.isMergeOperand());
+    BOOST_CHECK_EQUAL(x.getValue(), "add:1");
+    BOOST_REQUIRE(scan->get(x));
+    BOOST_CHECK_EQUAL(x.getRow(), "row-3");
+    BOOST_CHECK(!scan->get(x));
+}
+
+BOOST_AUTO_UNIT_TEST(range_erasure_test)
+{
+    // Range erasures are written to the index and aren't returned
+    // by scans
+    DiskTableWriterV1 out(128);
+    out.open("memfs:v3");
+    out.put(makeCell("row1", "fam:a", 42, "one"));
+    out.put(makeFamilyErasure("row1", "fam", 50));
+    out.put(makeCell("row2", "fam:a", 42, "two"));
+    out.put(makeRowRangeErasure("row3", "", 60));
+    out.close();
+
+    BOOST_CHECK_EQUAL(DiskTable::readVersion("memfs:v3"), 4u);
+
+    DiskTablePtr dp = DiskTable::loadTable("memfs:v3");
+    test_out_t s;
+    BOOST_CHECK((s << *dp).is_equal(
+        "(row1,fam:a,42,one)"
+        "(row2,fam:a,42,two)"
+    ));
+
+    vector<Cell> erasures;
+    dp->getRangeErasures(erasures);
+    BOOST_REQUIRE_EQUAL(erasures.size(), 2u);
+    BOOST_CHECK_EQUAL(erasures[0].getErasureKind(), ERASE_FAMILY);
+    BOOST_CHECK_EQUAL(erasures[0].getRow(), "row1");
+    BOOST_CHECK_EQUAL(erasures[0].getColumn(), "fam");
+    BOOST_CHECK_EQUAL(erasures[0].getTimestamp(), 50);
+    BOOST_CHECK_EQUAL(erasures[1].getErasureKind(), ERASE_ROWS);
+    BOOST_CHECK_EQUAL(erasures[1].getRow(), "row3");
+    BOOST_CHECK_EQUAL(erasures[1].getValue(), "");
+    BOOST_CHECK_EQUAL(erasures[1].getTimestamp(), 60);
+
+    // A table with only range erasures is fine too
+    out.open("memfs:v3empty");
+    out.put(makeRowRangeErasure("a", "b", 1));
+    out.close();
+    dp = DiskTable::loadTable("memfs:v3empty");
+    BOOST_CHECK_EQUAL(countCells(dp->scan()), 0u);
+    erasures.clear();
+    dp->getRangeErasures(erasures);
+    BOOST_CHECK_EQUAL(erasures.size(), 1u);
+
+    // The writer starts over for the next table
+    out.open("memfs:v3again");
+    out.put(makeCell("row1", "col1", 42, "one1"));
+    out.close();
+    dp = DiskTable::loadTable("memfs:v3again");
+    erasures.clear();
+    dp->getRangeErasures(erasures);
+    BOOST_CHECK_EQUAL(erasures.size(), 0u);
+
+    // CRC tables can hold range erasures as well
+    DiskTableWriterV2 out2(128);
+    out2.open("memfs:v3crc");
+    out2.put(makeCell("row1", "col1", 42, "one1"));
+    out2.put(makeRowRangeErasure("row0", "row1", 40));
+    out2.close();
+    BOOST_CHECK_EQUAL(DiskTable::readVersion("memfs:v3crc"), 4u);
+    dp = DiskTable::loadTable("memfs:v3crc");
+    BOOST_CHECK_EQUAL(countCells(dp->scan()), 1u);
+}
+
+BOOST_AUTO_UNIT_TEST(projection_test)
+{
+    // Rows with many cells span several blocks
+    TablePtr tbl(new CheaterDiskTable(64));
+    fillTestTable(tbl, 20, 30, 1, "%03d");
+    BOOST_CHECK_EQUAL(countCells(tbl->scan()), 600u);
+
+    // Keys only
+    Cell x;
+    CellStreamPtr s = tbl->scan("project = keys");
+    size_t n = 0;
+    while(s->get(x))
+    {
+        BOOST_CHECK_EQUAL(x.getValue().size(), 0u);
+        ++n;
+    }
+    BOOST_CHECK_EQUAL(n, 600u);
+
+    // One key per row, with and without row predicates
+    test_out_t out;
+    BOOST_CHECK_EQUAL(countCells(tbl->scan("project = rows")), 20u);
+    BOOST_CHECK((out << *tbl->scan("'row-004' < row <= 'row-006' or "
+                                   "row = 'row-019' and "
+                                   "project = rows")).is_equal(
+                    "(row-005,col-001,1,)"
+                    "(row-006,col-001,1,)"
+                    "(row-019,col-001,1,)"
+                    ));
+
+    // Column predicates have to see the whole row
+    BOOST_CHECK((out << *tbl->scan("row < 'row-003' and "
+                                   "column = 'col-030' and "
+                                   "project = rows")).is_equal(
+                    "(row-001,col-030,1,)"
+                    "(row-002,col-030,1,)"
+                    ));
+
+    // Value lengths
+    BOOST_CHECK((out << *tbl->scan("row = 'row-003' and "
+                                   "column <= 'col-002' and "
+                                   "project = lengths")).is_equal(
+                    "(row-003,col-001,1,15)"
+                    "(row-003,col-002,1,15)"
+                    ));
+}
+
+BOOST_AUTO_UNIT_TEST(row_projection_straddle_test)
+{
+    // Small rows in blocks of various sizes, so rows start and end
+    // in the middle of blocks and often straddle two of them
+    for(size_t blockSize = 100; blockSize <= 300; blockSize += 25)
+    {
+        TablePtr tbl(new CheaterDiskTable(blockSize));
+        fillTestTable(tbl, 20, 3, 1, "%03d");
+
+        // Each row comes back once
+        CellStreamPtr s = tbl->scan("project = rows");
+        Cell x;
+        size_t n = 0;
+        string last;
+        while(s->get(x))
+        {
+            BOOST_CHECK(n == 0 || last < x.getRow());
+            last = x.getRow().toString();
+            ++n;
+        }
+        BOOST_CHECK_EQUAL(n, 20u);
+
+        // Same with row ranges
+        BOOST_CHECK_EQUAL(
+            countCells(tbl->scan("'row-003' <= row < 'row-012' and "
+                                 "project = rows")), 9u);
+    }
+}
+
+BOOST_AUTO_UNIT_TEST(row_span_test)
+{
+    // The span covers the first and last rows, across many blocks
+    DiskTableWriterV1 out(64);
+    out.open("memfs:span");
+    for(int i = 10; i < 90; ++i)
+        out.put(makeCell(str(format("row-%03d") % i), "fam:col", i,
+                         "value"));
+    out.close();
+
+    Interval<string> span;
+    DiskTablePtr dp = DiskTable::loadTable("memfs:span");
+    BOOST_CHECK(dp->getRowSpan(span));
+    BOOST_CHECK(span.contains(string("row-010")));
+    BOOST_CHECK(span.contains(string("row-089")));
+    BOOST_CHECK(!span.contains(string("row-009")));
+    BOOST_CHECK(!span.contains(string("row-0890")));
+
+    // Tables with no cells have no span, even with range erasures
+    DiskTableWriterV1 out2(64);
+    out2.open("memfs:nospan");
+    out2.put(makeRowRangeErasure("row-000", "row-100", 42));
+    out2.close();
+
+    dp = DiskTable::loadTable("memfs:nospan");
+    BOOST_CHECK(!dp->getRowSpan(span));
+}
+
+namespace {
+
+    string readFile(string const & fn)
+    {
+        string data;
+        FilePtr in = File::input(fn);
+        char buf[4096];
+        while(size_t n = in->read(buf, 1, sizeof(buf)))
+            data.append(buf, n);
+        in->close();
+        return data;
+    }
+
+    void writeFile(string const & fn, string const & data)
+    {
+        FilePtr out = File::output(fn);
+        out->write(data.data(), 1, data.size());
+        out->close();
+    }
+}
+
+BOOST_AUTO_UNIT_TEST(row_span_no_read_test)
+{
+    // The span comes from the index, so loading the table doesn't
+    // read the first block
+    DiskTableWriterV1 out(64);
+    out.open("memfs:badblock");
+    for(int i = 10; i < 90; ++i)
+        out.put(makeCell(str(format("row-%03d") % i), "fam:col", i,
+                         "value"));
+    out.close();
+
+    // Clobber the record header of the first block
+    string data = readFile("memfs:badblock");
+    data.replace(0, 8, "XXXXXXXX");
+    writeFile("memfs:badblock", data);
+
+    Interval<string> span;
+    DiskTablePtr dp = DiskTable::loadTable("memfs:badblock");
+    BOOST_CHECK(dp->getRowSpan(span));
+    BOOST_CHECK(span.contains(string("row-010")));
+    BOOST_CHECK(span.contains(string("row-089")));
+    BOOST_CHECK(!span.contains(string("row-009")));
+    BOOST_CHECK(!span.contains(string("row-0890")));
+}
+
 BOOST_AUTO_UNIT_TEST(filtering_test)
 {
     // Try to make verify that filtering blocks doesn't skip data it shouldn't
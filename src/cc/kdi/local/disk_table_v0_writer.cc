@@ -170,7 +170,7 @@ void DiskTableWriterV0::ImplV0::addCell(Cell const & x)
     {
         block.arr->appendOffset(0);        // value
     }
-    block.arr->append<uint32_t>(0);        // __pad
+    block.arr->append<uint32_t>(0);        // kind
     ++block.nItems;
 }
 
@@ -230,6 +230,11 @@ void DiskTableWriterV0::ImplV0::close()
 
 void DiskTableWriterV0::ImplV0::put(Cell const & x)
 {
+    if(x.isRangeErasure())
+        raise<NotImplementedError>("V0 tables can't hold range erasures");
+    if(x.isMergeOperand())
+        raise<NotImplementedError>("V0 tables can't hold merge operands");
+
     // If this is the first Cell in the block, write index record
     if(!block.nItems)
         addIndexEntry(x);
@@ -31,7 +31,9 @@
 #include <oort/fileio.h>
 #include <warp/string_pool_builder.h>
 #include <warp/adler.h>
+#include <warp/crc32c.h>
 #include <warp/bloom_filter.h>
+#include <warp/EnvironmentVariable.h>
 #include <boost/static_assert.hpp>
 
 #include <set>
@@ -58,13 +60,23 @@ namespace
         uint32_t nItems;
         bool addFams;
         uint32_t nFams;
+        bool addChecksumType;
+        uint32_t checksumType;
+        BuilderBlock * erasures;
+        uint32_t nErasures;
+        bool addErasures;
+        size_t firstRow;
+        bool addFirstRow;
 
         PooledBuilder() :
             builder(),
             pool(&builder),
             arr(builder.subblock(8)),
             nItems(0),
-            addFams(false)
+            addFams(false),
+            addChecksumType(false),
+            addErasures(false),
+            addFirstRow(false)
         {
         }
 
@@ -74,7 +86,9 @@ namespace
             pool.reset(&builder);
             arr = builder.subblock(8);
             fams = builder.subblock(8);
+            erasures = builder.subblock(8);
             nItems = 0;
+            nErasures = 0;
         }
 
         void build(Record & r, Allocator * alloc) {
@@ -87,6 +101,19 @@ namespace
                 builder.append(nFams);
             }
 
+            if(addChecksumType) {
+                builder.append(checksumType);
+            }
+
+            if(addErasures) {
+                builder.appendOffset(erasures);
+                builder.append(nErasures);
+            }
+
+            if(addFirstRow) {
+                builder.appendOffset(pool.getStringBlock(), firstRow);
+            }
+
             // Construct record
             builder.build(r, alloc);
         }
@@ -121,6 +148,7 @@ class DiskTableWriterV1::ImplV1 : public DiskTableWriter::Impl
     FileOutput::handle_t output;
     RecordBufferAllocator alloc;
     size_t blockSize;
+    bool useCrc32c;
 
     PooledBuilder block;
     PooledBuilder index;
@@ -128,19 +156,29 @@ class DiskTableWriterV1::ImplV1 : public DiskTableWriter::Impl
     int64_t lowestTime;
     int64_t highestTime;
 
+    // Does the current cell block hold merge operands?
+    bool blockHasMerge;
+
     // Maps string offsets in the index header to col family bitmasks
     map<size_t, uint32_t> colFamilyMasks;
     vector<size_t> allColFamilies;
     uint32_t nextColMask; // Mask to assign to the next column family
     uint32_t curColMask;  // Computed mask for the current cell block
 
+    // Row range and column family erasures, written in the index
+    vector<Cell> rangeErasures;
+
+    // First row in the table, written in the index
+    string firstRow;
+    bool haveFirstRow;
+
     void addIndexEntry(Record const & cellBlock);
     void addCell(Cell const & x);
     void writeCellBlock();
     void writeBlockIndex();
 
 public:
-    explicit ImplV1(size_t blockSize);
+    ImplV1(size_t blockSize, bool useCrc32c);
 
     virtual void open(string const & fn);
     virtual void close();
@@ -166,8 +204,10 @@ void DiskTableWriterV1::ImplV1::addIndexEntry(Record const & cbRec)
     BuilderBlock * b = index.pool.getStringBlock();
     size_t         r = index.pool.getStringOffset(lastRow);
 
-    // Calculate Adler-32 checksum for the cell block, written in index 
-    uint32_t cbChecksum = adler((uint8_t*)cbRec.getData(), cbRec.getLength());
+    // Calculate checksum for the cell block, written in index
+    uint32_t cbChecksum = useCrc32c
+        ? crc32c((uint8_t*)cbRec.getData(), cbRec.getLength())
+        : adler((uint8_t*)cbRec.getData(), cbRec.getLength());
 
     // Append IndexEntry to array
     index.arr->append(cbChecksum);   // checkSum
@@ -186,7 +226,14 @@ void DiskTableWriterV1::ImplV1::addIndexEntry(Record const & cbRec)
 
 void DiskTableWriterV1::ImplV1::addCell(Cell const & x)
 {
-    BOOST_STATIC_ASSERT(disk::CellBlock::VERSION == 0);
+    BOOST_STATIC_ASSERT(disk::CellBlockV1::VERSION == 1);
+
+    // Cells arrive in order, so the first one has the first row
+    if(!haveFirstRow)
+    {
+        firstRow.assign(x.getRow().begin(), x.getRow().end());
+        haveFirstRow = true;
+    }
 
     // Get string offsets for cell data (null value for erasures)
     BuilderBlock * b = block.pool.getStringBlock();
@@ -207,9 +254,15 @@ void DiskTableWriterV1::ImplV1::addCell(Cell const & x)
     {
         block.arr->appendOffset(0);        // value
     }
-    block.arr->append<uint32_t>(0);        // __pad
+    block.arr->append<uint32_t>(           // kind
+        x.isMergeOperand() ? disk::CellData::KIND_MERGE
+        : disk::CellData::KIND_CELL);
     ++block.nItems;
 
+    // Merge operands need a reader that knows about cell kinds
+    if(x.isMergeOperand())
+        blockHasMerge = true;
+
     // Remember range of timestamps added
     if(block.nItems == 1) {
         lowestTime = t;
@@ -237,6 +290,10 @@ void DiskTableWriterV1::ImplV1::addCell(Cell const & x)
 
 void DiskTableWriterV1::ImplV1::writeCellBlock()
 {
+    block.builder.setVersion(blockHasMerge ? disk::CellBlockV1::VERSION
+                             : disk::CellBlock::VERSION);
+    blockHasMerge = false;
+
     Record r;
     block.build(r, &alloc);
 
@@ -261,15 +318,47 @@ void DiskTableWriterV1::ImplV1::writeBlockIndex()
 
     index.addFams = true;
     index.nFams = nFams;
+
+    for(vector<Cell>::const_iterator i = rangeErasures.begin();
+        i != rangeErasures.end(); ++i)
+    {
+        // Row erasures keep their end row in the column field
+        strref_t col = (i->getErasureKind() == ERASE_ROWS
+                        ? i->getValue() : i->getColumn());
+        uint32_t kind = (i->getErasureKind() == ERASE_ROWS
+                         ? disk::CellData::KIND_ERASE_ROWS
+                         : disk::CellData::KIND_ERASE_FAMILY);
+
+        index.erasures->appendOffset(
+            b, index.pool.getStringOffset(i->getRow()));
+        index.erasures->appendOffset(
+            b, index.pool.getStringOffset(col));
+        index.erasures->append(i->getTimestamp());
+        index.erasures->appendOffset(0);
+        index.erasures->append(kind);
+        ++index.nErasures;
+    }
+
+    index.firstRow = index.pool.getStringOffset(firstRow);
+
     index.write(output, &alloc);
 }
 
-DiskTableWriterV1::ImplV1::ImplV1(size_t blockSize) :
+DiskTableWriterV1::ImplV1::ImplV1(size_t blockSize, bool useCrc32c) :
     alloc(),
-    blockSize(blockSize)
+    blockSize(blockSize),
+    useCrc32c(useCrc32c)
 {
+    BOOST_STATIC_ASSERT(disk::BlockIndexV4::VERSION == 4);
+
     block.builder.setHeader<disk::CellBlock>();
-    index.builder.setHeader<disk::BlockIndexV1>();
+    index.builder.setHeader<disk::BlockIndexV4>();
+    index.addChecksumType = true;
+    index.checksumType = useCrc32c
+        ? disk::BlockIndexV2::CHECKSUM_CRC32C
+        : disk::BlockIndexV2::CHECKSUM_ADLER32;
+    index.addErasures = true;
+    index.addFirstRow = true;
 }
 
 void DiskTableWriterV1::ImplV1::open(string const & fn)
@@ -282,10 +371,15 @@ void DiskTableWriterV1::ImplV1::open(string const & fn)
 
     lowestTime = 0;
     highestTime = 0;
+    blockHasMerge = false;
 
     colFamilyMasks.clear();
     nextColMask = 1;
     curColMask = 0;
+
+    rangeErasures.clear();
+    firstRow.clear();
+    haveFirstRow = false;
 }
 
 void DiskTableWriterV1::ImplV1::close()
@@ -303,7 +397,9 @@ void DiskTableWriterV1::ImplV1::close()
 
     // Write TableInfo record
     Record r;
-    alloc.construct<disk::TableInfo>(r, indexOffset);
+    HeaderSpec::Fields f;
+    f.setFromType<disk::TableInfo>();
+    serialize<uint64_t>(alloc.alloc(r,f), indexOffset);
     output->put(r);
 
     // Shut down
@@ -315,6 +411,13 @@ void DiskTableWriterV1::ImplV1::close()
 
 void DiskTableWriterV1::ImplV1::put(Cell const & x)
 {
+    // Range erasures go in the index
+    if(x.isRangeErasure())
+    {
+        rangeErasures.push_back(x);
+        return;
+    }
+
     // Add cell to the current block
     addCell(x);
 
@@ -330,7 +433,34 @@ size_t DiskTableWriterV1::ImplV1::size() const
 }
 
 DiskTableWriterV1::DiskTableWriterV1(size_t blockSize) :
-    DiskTableWriter(new ImplV1(blockSize))
+    DiskTableWriter(new ImplV1(blockSize, false))
+{
+}
+
+DiskTableWriterV1::DiskTableWriterV1(size_t blockSize, bool useCrc32c) :
+    DiskTableWriter(new ImplV1(blockSize, useCrc32c))
+{
+}
+
+bool DiskTableWriterV1::getDefaultUseCrc32c()
+{
+    string name;
+    if(!EnvironmentVariable::get("KDI_DISK_CHECKSUM", name) ||
+       name == "adler32")
+    {
+        return false;
+    }
+    if(name == "crc32c")
+        return true;
+
+    raise<ValueError>("unknown KDI_DISK_CHECKSUM: %s", name);
+}
+
+//----------------------------------------------------------------------------
+// DiskTableWriterV2
+//----------------------------------------------------------------------------
+DiskTableWriterV2::DiskTableWriterV2(size_t blockSize) :
+    DiskTableWriterV1(blockSize, true)
 {
 }
 
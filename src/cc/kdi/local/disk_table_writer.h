@@ -32,6 +32,7 @@ namespace local {
     class DiskTableWriter;
     class DiskTableWriterV0;
     class DiskTableWriterV1;
+    class DiskTableWriterV2;
     
     typedef DiskTableWriterV1 CurDiskTableWriter;
 
@@ -84,6 +85,9 @@ public:
     explicit DiskTableWriterV0(size_t blockSize);
 };
 
+/// Writes the V1 format, with a V4 index recording the checksum
+/// type, range erasures, and first row of the table.  Only readers
+/// that know about BlockIndexV4 can load the result.
 class kdi::local::DiskTableWriterV1
     : public kdi::local::DiskTableWriter
 {
@@ -91,6 +95,25 @@ class kdi::local::DiskTableWriterV1
 
 public:
     explicit DiskTableWriterV1(size_t blockSize);
+
+    /// Write CRC-32C block checksums if useCrc32c is true, or
+    /// Adler-32 otherwise
+    DiskTableWriterV1(size_t blockSize, bool useCrc32c);
+
+    /// Get the checksum choice for tables written by the server:
+    /// true if the KDI_DISK_CHECKSUM environment variable is
+    /// "crc32c", false if it is unset or "adler32".  Raises
+    /// ValueError for anything else.
+    static bool getDefaultUseCrc32c();
+};
+
+/// Writes the V1 format with CRC-32C block checksums instead of
+/// Adler-32.
+class kdi::local::DiskTableWriterV2
+    : public kdi::local::DiskTableWriterV1
+{
+public:
+    explicit DiskTableWriterV2(size_t blockSize);
 };
 
 #endif // KDI_LOCAL_DISK_TABLE_WRITER_H
@@ -42,15 +42,20 @@ IndexCache::IndexCache(size_t maxSize) :
 {
 }
 
-oort::Record * IndexCache::get(std::string const & fn)
+void IndexCache::updateStats(cache_t const & c) const
 {
-    locked_t p(cache);
-    oort::Record * r = p->get(fn);
     if(tracker)
     {
-        tracker->set("IndexCache.size", p->size());
-        tracker->set("IndexCache.count", p->count());
+        tracker->set("IndexCache.size", c.size());
+        tracker->set("IndexCache.count", c.count());
     }
+}
+
+oort::Record * IndexCache::get(std::string const & fn)
+{
+    locked_t p(cache);
+    oort::Record * r = p->get(fn);
+    updateStats(*p);
     return r;
 }
 
@@ -58,22 +63,49 @@ void IndexCache::release(oort::Record * r)
 {
     locked_t p(cache);
     p->release(r);
-    if(tracker)
-    {
-        tracker->set("IndexCache.size", p->size());
-        tracker->set("IndexCache.count", p->count());
-    }
+    updateStats(*p);
 }
 
 void IndexCache::remove(std::string const & fn)
 {
     locked_t p(cache);
     p->remove(fn);
-    if(tracker)
+    updateStats(*p);
+}
+
+size_t IndexCache::prefetch(std::string const & fn)
+{
     {
-        tracker->set("IndexCache.size", p->size());
-        tracker->set("IndexCache.count", p->count());
+        locked_t p(cache);
+        if(p->contains(fn))
+            return 0;
     }
+
+    oort::Record r;
+    Load()(r, fn);
+    size_t sz = oort::record_size()(r);
+
+    locked_t p(cache);
+    bool added = p->insert(fn, r);
+
+    // Record reference counts aren't atomic, so drop our reference
+    // while holding the lock
+    r = oort::Record();
+
+    updateStats(*p);
+    return added ? sz : 0;
+}
+
+void IndexCache::getAccessCounts(count_vec & out)
+{
+    locked_t p(cache);
+    p->getAccessCounts(out);
+}
+
+size_t IndexCache::getMaxSize()
+{
+    locked_t p(cache);
+    return p->getMaxSize();
 }
 
 
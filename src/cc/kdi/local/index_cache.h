@@ -26,6 +26,8 @@
 #include <warp/StatTracker.h>
 #include <oort/record.h>
 #include <string>
+#include <vector>
+#include <utility>
 #include <boost/noncopyable.hpp>
 
 namespace kdi {
@@ -55,6 +57,11 @@ class kdi::local::IndexCache
     scache_t cache;
     warp::StatTracker * tracker;
 
+    void updateStats(cache_t const & c) const;
+
+public:
+    typedef std::vector<std::pair<std::string, size_t> > count_vec;
+
 public:
     explicit IndexCache(size_t maxSize);
 
@@ -62,6 +69,22 @@ public:
     void release(oort::Record * r);
     void remove(std::string const & fn);
 
+    /// Load an index into the cache without pinning it.  The index
+    /// is read without holding the cache lock, so prefetches can run
+    /// in parallel with each other and with lookups.  It goes in as
+    /// the least recently used index, so a prefetch never evicts an
+    /// index that was looked up or prefetched before it.  Returns
+    /// the size of the loaded index, or 0 if it was already cached
+    /// or there was no room for it.
+    size_t prefetch(std::string const & fn);
+
+    /// Get the cached index files and the number of lookups of each
+    /// since it was loaded, most recently used first.
+    void getAccessCounts(count_vec & out);
+
+    /// Get the size limit of the cache.
+    size_t getMaxSize();
+
     static void setTracker(warp::StatTracker * tracker);
     static IndexCache * getGlobal();
 };
@@ -94,6 +117,7 @@ public:
     T const * as() const { return record->as<T>(); }
 
     size_t getLength() const { return record->getLength(); }
+    uint32_t getVersion() const { return record->getVersion(); }
 };
 
 #endif // KDI_LOCAL_INDEX_CACHE_H
@@ -19,19 +19,21 @@
 //----------------------------------------------------------------------------
 
 #include <kdi/local/local_table.h>
+#include <kdi/local/local_table_manager.h>
 #include <kdi/local/disk_table.h>
 #include <kdi/local/disk_table_writer.h>
 #include <kdi/logged_memory_table.h>
 #include <kdi/cell_merge.h>
 #include <kdi/cell_filter.h>
+#include <kdi/retention_policy.h>
 #include <kdi/scan_predicate.h>
 #include <kdi/synchronized_table.h>
 #include <warp/file.h>
-#include <warp/syncqueue.h>
 #include <warp/fs.h>
 #include <warp/config.h>
 #include <warp/uri.h>
 #include <warp/log.h>
+#include <warp/timestamp.h>
 #include <ex/exception.h>
 
 #include <boost/format.hpp>
@@ -56,6 +58,8 @@ using boost::format;
 namespace {
     size_t const MAX_TABLE_MEMORY = 128 << 20; // 128 mb
     size_t const MAX_WAY_MERGE = 16;
+    size_t const MAX_QUEUED_SERIALIZATIONS = 2;
+    size_t const MEMORY_REPORT_GRANULARITY = 1 << 20; // 1 mb
 }
 
 //----------------------------------------------------------------------------
@@ -63,21 +67,6 @@ namespace {
 //----------------------------------------------------------------------------
 /*
 
-  - LocalTables start taking up too much memory -- they each have
-    independent notions of max resident memory size.  There needs to
-    be some kind of shared memory management.
-
-  - Each LocalTable makes its own worker threads, each with its own 10
-    MB stack, so just opening a table takes 20 MB.  The threads ought
-    to be shared.
-
-  - We'd like some basic system-managed Table GC policies it could be
-    implemented in the Table implementation, which has performance
-    advantages, or it could be an external daemon that periodically
-    sweeps and erases old data from tables using the normal interface.
-    that has the advantage that it's general (for shared-access
-    tables).
-
   - A way to clean up garbage files in LocalTable directory seems to
     imply a need for a way to map a Table to a set of files.  no,
     instead scan directory for numbered files.  anything found that
@@ -153,7 +142,8 @@ namespace {
 // LocalTable::Impl
 //----------------------------------------------------------------------------
 class LocalTable::Impl
-    : public boost::enable_shared_from_this<Impl>
+    : public boost::enable_shared_from_this<Impl>,
+      public LocalTableManager::Client
 {
     struct TableInfo
     {
@@ -187,12 +177,21 @@ class LocalTable::Impl
     // index of next output file
     size_t nextIndex;           // synchronize
 
+    // garbage collection limits applied by compactions and scans
+    RetentionPolicy retention;  // synchronize
+
     // ordered set of all readable tables (including current writable table)
     table_list_t readableTables; // synchronize
 
     // current writable table
-    MemoryTablePtr memTable;
-    TablePtr writableTable;
+    MemoryTablePtr memTable;    // synchronize on writeMutex
+    TablePtr writableTable;     // synchronize on writeMutex
+
+    // memory usage last reported to the manager
+    size_t reportedMemory;      // synchronize on writeMutex
+
+    // has the table been shut down?
+    bool closed;                // synchronize on writeMutex
 
     // mutex on synchronized members.  this is only used to coordinate
     // between the main thread and the worker threads that do
@@ -200,13 +199,17 @@ class LocalTable::Impl
     // is not thread-safe.
     mutable mutex_t mutex;
 
-    // worker command queue
-    SyncQueue< boost::function<void ()> > serializationQueue;
-    SyncQueue< boost::function<void ()> > compactionQueue;
+    // mutex on the writable table.  the main thread holds it while
+    // writing, and the manager may flush the table from another
+    // writer's thread when the process is over its memory budget.
+    // when both are needed, lock writeMutex before mutex.
+    mutable mutex_t writeMutex;
+
+    // shared memory budget and worker pools
+    LocalTableManager & manager;
 
-    // worker thread
-    boost::scoped_ptr<boost::thread> serializationThread;
-    boost::scoped_ptr<boost::thread> compactionThread;
+    // write CRC-32C block checksums instead of Adler-32?
+    bool const useCrc32c;
 
     // has the table been initialized?
     bool initialized;
@@ -215,6 +218,10 @@ class LocalTable::Impl
     bool compactionScheduled;   // synchronize
     bool fullCompactionRequested; // synchronize
 
+    // is a full compaction waiting for a memtable to be serialized?
+    bool fullCompactionWaiting; // synchronize
+    table_list_t::iterator fullCompactionAfter; // synchronize
+
     // Event to indicate a compaction has finished
     boost::condition compactionFinished;
 
@@ -230,6 +237,7 @@ class LocalTable::Impl
         //   - names for opening all the readable tables
         //   - next file index
         //   - number of tables properly serialized
+        //   - retention policy
 
         Config cfg;
         cfg.set("nextIndex", str(format("%d") % nextIndex));
@@ -245,6 +253,7 @@ class LocalTable::Impl
                 ++nDisk;
         }
         cfg.set("numDiskTables", str(format("%d") % nDisk));
+        retention.save(cfg, "retention");
 
         // Write to temp file, rename to output
         string cfgFn = fs::resolve(tableDir, "state");
@@ -255,7 +264,7 @@ class LocalTable::Impl
         // cerr << "Wrote config:" << endl << cfg << endl;
     }
 
-    void serializeTable(table_list_t::iterator it)
+    void serializeTable(table_list_t::iterator it, size_t memSize)
     {
         // Lock and get index for output file
         lock_t l(mutex);
@@ -266,7 +275,7 @@ class LocalTable::Impl
         // Open output
         string name = str(format("%d") % idx);
         string fn = fs::resolve(tableDir, name);
-        CurDiskTableWriter writer(64 << 10);
+        CurDiskTableWriter writer(64 << 10, useCrc32c);
         writer.open(fn);
 
         // cerr << format("serialize: %s --> %s") % it->name % name << endl;
@@ -280,17 +289,28 @@ class LocalTable::Impl
         writer.close();
 
         // Open table for reading
-        TablePtr tbl(new DiskTableV0(fn));
+        TablePtr tbl = DiskTable::loadTable(fn);
         
         // Lock and swap table in
         TableInfo tmp(tbl, name, fs::filesize(fn), true);
         l.lock();
         swap(*it, tmp);
         writeConfig();
+
+        // Start a full compaction that was waiting for this table
+        if(fullCompactionWaiting && it == fullCompactionAfter)
+        {
+            fullCompactionWaiting = false;
+            if(compactionScheduled)
+                fullCompactionRequested = true;
+            else
+                scheduleFullCompaction(false);
+        }
         l.unlock();
 
         // Remove files associated with old table
         fs::remove(fs::resolve(tableDir, tmp.name));
+        manager.releaseMemory(this, memSize);
 
         // Done
         // cerr << format("serialize done: %s --> %s") % tmp.name % it->name << endl;
@@ -318,13 +338,27 @@ class LocalTable::Impl
         // Lock and get index for output file
         lock_t l(mutex);
         size_t idx = nextIndex++;
+        RetentionPolicy policy = retention;
         writeConfig();
+
+        // Version limits need the whole history of each cell.  A
+        // newer table may erase versions kept here and expose older
+        // ones, so only a major compaction covering every table but
+        // the writable one applies them.  Partial compactions only
+        // apply the age limits.
+        table_list_t::iterator next = last;
+        bool isComplete = (filterErasures &&
+                           first == readableTables.begin() &&
+                           ++next == readableTables.end());
         l.unlock();
 
+        if(!isComplete)
+            policy = policy.withoutVersionLimits();
+
         // Open output
         string name = str(format("%d") % idx);
         string fn = fs::resolve(tableDir, name);
-        CurDiskTableWriter writer(64 << 10);
+        CurDiskTableWriter writer(64 << 10, useCrc32c);
         writer.open(fn);
 
         ostringstream info;
@@ -348,6 +382,15 @@ class LocalTable::Impl
             filterErasures ? "major " : "",
             info.str());
 
+        // Drop cells past the retention limits
+        if(!policy.isUnlimited())
+        {
+            CellStreamPtr filter = makeRetentionFilter(
+                policy, Timestamp::now());
+            filter->pipeFrom(merge);
+            merge = filter;
+        }
+
         // Write table
         Cell x;
         while(merge->get(x))
@@ -355,7 +398,7 @@ class LocalTable::Impl
         writer.close();
 
         // Open table for reading
-        TablePtr tbl(new DiskTableV0(fn));
+        TablePtr tbl = DiskTable::loadTable(fn);
         
         // Lock and replace tables with compacted result. Remove
         // [first, last-1), replace last, and write config.
@@ -386,7 +429,7 @@ class LocalTable::Impl
         if(fullCompactionRequested)
         {
             fullCompactionRequested = false;
-            scheduleFullCompaction();
+            scheduleFullCompaction(true);
         }
         else if(readableTables.size() > 8)
         {
@@ -396,7 +439,7 @@ class LocalTable::Impl
 
     void createWritableTable()
     {
-        // Assumes that mutex is locked
+        // Assumes that writeMutex and mutex are locked
 
         // Get name for next writable table
         size_t idx = nextIndex++;
@@ -422,24 +465,37 @@ class LocalTable::Impl
 
     void startNewWritableTable()
     {
+        // Assumes that writeMutex is locked
+
         assert(writableTable);
 
         // Sync and release old writable table
         writableTable->sync();
+        size_t memSize = memTable->getMemoryUsage();
         writableTable.reset();
         memTable.reset();
 
+        // Block if we have too many serializations outstanding.  This
+        // must happen before taking the mutex, which the
+        // serializations need.
+        manager.waitForQueue(this, LocalTableManager::SERIALIZE,
+                             MAX_QUEUED_SERIALIZATIONS);
+        manager.retireMemory(this, memSize);
+        reportedMemory = 0;
+
         // Grab mutex for access to readableTables and call to
         // createWritableTable()
         lock_t l(mutex);
 
         // Schedule it for serialization (it is the last readableTable)
         log("scheduling memtable for serialization");
-        serializationQueue.push(
+        manager.schedule(
+            this, LocalTableManager::SERIALIZE,
             boost::bind(
                 &Impl::serializeTable,
                 shared_from_this(),
-                --readableTables.end()
+                --readableTables.end(),
+                memSize
                 )
             );
 
@@ -447,46 +503,13 @@ class LocalTable::Impl
         createWritableTable();
     }
 
-    void workerLoop(SyncQueue< boost::function<void ()> > & workerQueue)
-    {
-        // cerr << "worker thread starting" << endl;
-
-        for(;;)
-        {
-            // Get next command
-            boost::function<void ()> cmd;
-            if(!workerQueue.pop(cmd))
-            {
-                // Got nothing -- queue must have been cancelled
-                break;
-            }
-
-            // Run command
-            try {
-                cmd();
-            }
-            catch(Exception const & ex) {
-                cerr << "workerThread: " << ex << endl;
-                exit(1);
-            }
-            catch(std::exception const & ex) {
-                cerr << "workerThread error: " << ex.what() << endl;
-                exit(1);
-            }
-            catch(...) {
-                cerr << "workerThread error" << endl;
-                exit(1);
-            }
-        }
-
-        // cerr << "worker thread exiting" << endl;
-    }
-
     void loadFromConfig(Config const & cfg)
     {
         // cerr << "Loaded config:" << endl << cfg << endl;
 
         nextIndex = cfg.getAs<size_t>("nextIndex");
+        if(Config const * n = cfg.findChild("retention"))
+            retention.load(*n);
         size_t nDisk = cfg.getAs<size_t>("numDiskTables");
         Config const & tables = cfg.getChild("table");
         for(size_t i = 0; i < tables.numChildren(); ++i)
@@ -500,7 +523,7 @@ class LocalTable::Impl
 
             TablePtr tbl;
             if(isDiskTable)
-                tbl.reset(new DiskTableV0(fn));
+                tbl = DiskTable::loadTable(fn);
             else
                 tbl = LoggedMemoryTable::create(fn, false);
 
@@ -514,11 +537,15 @@ class LocalTable::Impl
             if(!isDiskTable)
             {
                 log("scheduling old memtable for serialization");
-                serializationQueue.push(
+                manager.waitForQueue(this, LocalTableManager::SERIALIZE,
+                                     MAX_QUEUED_SERIALIZATIONS);
+                manager.schedule(
+                    this, LocalTableManager::SERIALIZE,
                     boost::bind(
                         &Impl::serializeTable,
                         shared_from_this(),
-                        --readableTables.end()
+                        --readableTables.end(),
+                        size_t(0)
                         )
                     );
             }
@@ -538,7 +565,7 @@ class LocalTable::Impl
         return sz * logf(n + 1);
     }
 
-    void scheduleFullCompaction()
+    void scheduleFullCompaction(bool waitForSerialization)
     {
         // Table mutex is assumed to be locked
 
@@ -563,12 +590,28 @@ class LocalTable::Impl
             ++end;
         }
 
+        // Only a compaction of every table but the writable one can
+        // apply version limits.  If there are memtables waiting to be
+        // serialized, start after the newest of them is done.
+        if(waitForSerialization && end != readableTables.end())
+        {
+            table_list_t::iterator newest = --readableTables.end();
+            if(end != newest)
+            {
+                log("full compaction waiting for serialization");
+                fullCompactionWaiting = true;
+                fullCompactionAfter = --newest;
+                return;
+            }
+        }
+
         if(nTables > 1)
         {
             log("scheduling full compaction of %d tables", nTables);
 
             // Got a compaction range, schedule it
-            compactionQueue.push(
+            manager.schedule(
+                this, LocalTableManager::COMPACT,
                 boost::bind(
                     &Impl::compactTables,
                     shared_from_this(),
@@ -663,7 +706,8 @@ class LocalTable::Impl
         log("scheduling compaction of %d tables",
             std::distance(bestRange.first, bestRange.second));
 
-        compactionQueue.push(
+        manager.schedule(
+            this, LocalTableManager::COMPACT,
             boost::bind(
                 &Impl::compactTables,
                 shared_from_this(),
@@ -679,10 +723,14 @@ public:
         tableDir(tableDir),
         lockFile(fs::resolve(tableDir, "lock")),
         nextIndex(0),
-        serializationQueue(2),  // block if we have more than 2 serializations outstanding
+        reportedMemory(0),
+        closed(false),
+        manager(LocalTableManager::getGlobal()),
+        useCrc32c(CurDiskTableWriter::getDefaultUseCrc32c()),
         initialized(false),
         compactionScheduled(false),
-        fullCompactionRequested(false)
+        fullCompactionRequested(false),
+        fullCompactionWaiting(false)
     {
     }
 
@@ -691,26 +739,21 @@ public:
         if(initialized)
             return;
 
-        // Start worker threads
-        serializationThread.reset(
-            new boost::thread(
-                boost::bind(
-                    &Impl::workerLoop,
-                    shared_from_this(),
-                    boost::ref(serializationQueue)
-                    )
-                )
-            );
-        compactionThread.reset(
-            new boost::thread(
-                boost::bind(
-                    &Impl::workerLoop,
-                    shared_from_this(),
-                    boost::ref(compactionQueue)
-                    )
-                )
-            );
+        // Background work goes to the shared worker pools
+        manager.addTable(shared_from_this(), tableDir);
+        try {
+            load();
+        }
+        catch(...) {
+            manager.removeTable(this);
+            throw;
+        }
 
+        initialized = true;
+    }
+
+    void load()
+    {
         // Read config, load readableTables
         //   If the set of readable tables includes MemTable loads,
         //   schedule serializations for those tables.  This can be
@@ -728,48 +771,59 @@ public:
         
         // Create writable table
         {
+            lock_t wl(writeMutex);
             lock_t l(mutex);
             createWritableTable();
         }
-
-        initialized = true;
     }
 
     void shutdown()
     {
-        // Cancel worker queue waits
-        serializationQueue.cancelWaits();
-        compactionQueue.cancelWaits();
+        // Stop taking flush requests from the manager
+        {
+            lock_t wl(writeMutex);
+            closed = true;
+        }
 
-        // Join worker threads
-        if(serializationThread)
+        // Wait for pending background work to finish
+        manager.removeTable(this);
+    }
+
+    void afterWrite(lock_t & wl)
+    {
+        // Assumes that writeMutex is locked
+
+        // If table is too big, schedule serialization
+        size_t memSize = memTable->getMemoryUsage();
+        if(memSize >= MAX_TABLE_MEMORY)
         {
-            serializationThread->join();
-            serializationThread.reset();
+            startNewWritableTable();
+            return;
         }
-        if(compactionThread)
+
+        // Tell the manager when we've grown noticeably.  It may
+        // decide to flush us or some other table, so let go of the
+        // table first.
+        if(memSize >= reportedMemory + MEMORY_REPORT_GRANULARITY)
         {
-            compactionThread->join();
-            compactionThread.reset();
+            reportedMemory = memSize;
+            wl.unlock();
+            manager.updateMemory(this, memSize);
         }
     }
 
     void set(strref_t row, strref_t column, int64_t timestamp, strref_t value)
     {
+        lock_t wl(writeMutex);
         writableTable->set(row, column, timestamp, value);
-
-        // If table is too big, schedule serialization
-        if(memTable->getMemoryUsage() >= MAX_TABLE_MEMORY)
-            startNewWritableTable();
+        afterWrite(wl);
     }
 
     void erase(strref_t row, strref_t column, int64_t timestamp)
     {
+        lock_t wl(writeMutex);
         writableTable->erase(row, column, timestamp);
-
-        // If table is too big, schedule serialization
-        if(memTable->getMemoryUsage() >= MAX_TABLE_MEMORY)
-            startNewWritableTable();
+        afterWrite(wl);
     }
     
     CellStreamPtr scan(ScanPredicate const & pred)
@@ -783,6 +837,10 @@ public:
         ScanPredicate subPred(pred);
         subPred.setMaxHistory(0);
 
+        // Sub-scans only drop values.  A row projection has to wait
+        // until erasures have been merged.
+        subPred.setProjection(pred.getInputProjection());
+
         // Lock to access readableTables
         lock_t l(mutex);
 
@@ -807,27 +865,53 @@ public:
             merge->pipeFrom(ti->table->scan(subPred));
         }
 
+        // Hide cells past the retention limits that haven't been
+        // compacted away yet
+        if(!retention.isUnlimited())
+        {
+            CellStreamPtr filter = makeRetentionFilter(
+                retention, Timestamp::now());
+            filter->pipeFrom(merge);
+            merge = filter;
+        }
+
         // Add history filter later if we have one
         if(maxHistory)
         {
             CellStreamPtr filter = makeHistoryFilter(maxHistory);
             filter->pipeFrom(merge);
-            return filter;
+            merge = filter;
         }
-        else
+
+        // Finish the projection.  Folding merge operands can put a
+        // value back on a keys-only Cell, so always blank those.
+        if(pred.getProjection() != subPred.getProjection() ||
+           pred.getProjection() == ScanPredicate::PROJECT_KEYS)
         {
-            return merge;
+            CellStreamPtr filter = makeProjectionFilter(
+                pred.getProjection());
+            filter->pipeFrom(merge);
+            merge = filter;
         }
+        return merge;
     }
 
     void sync()
     {
         // Sync writable table
+        lock_t wl(writeMutex);
         writableTable->sync();
     }
 
     void flushMemory()
     {
+        lock_t wl(writeMutex);
+        if(closed)
+            return;
+
+        // Push buffered writes through to the memtable before
+        // checking if there's anything to flush
+        writableTable->sync();
         if(memTable->getCellCount() > 0)
             startNewWritableTable();
     }
@@ -845,14 +929,28 @@ public:
         else
         {
             // Schedule a full compaction
-            scheduleFullCompaction();
+            scheduleFullCompaction(true);
         }
     }
 
     size_t getMemoryUsage()
     {
+        lock_t wl(writeMutex);
         return memTable->getMemoryUsage();
     }
+
+    void setRetentionPolicy(RetentionPolicy const & policy)
+    {
+        lock_t l(mutex);
+        retention = policy;
+        writeConfig();
+    }
+
+    RetentionPolicy getRetentionPolicy() const
+    {
+        lock_t l(mutex);
+        return retention;
+    }
 };
 
 //----------------------------------------------------------------------------
@@ -907,6 +1005,16 @@ size_t LocalTable::getMemoryUsage() const
     return impl->getMemoryUsage();
 }
 
+void LocalTable::setRetentionPolicy(RetentionPolicy const & policy)
+{
+    impl->setRetentionPolicy(policy);
+}
+
+RetentionPolicy LocalTable::getRetentionPolicy() const
+{
+    return impl->getRetentionPolicy();
+}
+
 
 //----------------------------------------------------------------------------
 // Registration
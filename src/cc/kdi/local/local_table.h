@@ -22,6 +22,7 @@
 #define KDI_LOCAL_LOCAL_TABLE_H
 
 #include <kdi/table.h>
+#include <kdi/retention_policy.h>
 #include <boost/noncopyable.hpp>
 #include <boost/shared_ptr.hpp>
 
@@ -73,6 +74,14 @@ public:
 
     /// Get an estimate of the current memory footprint of this table.
     size_t getMemoryUsage() const;
+
+    /// Set the garbage collection limits for the table.  The policy
+    /// is saved with the table state.  Cells past the limits are
+    /// hidden from new scans and dropped by later compactions.
+    void setRetentionPolicy(RetentionPolicy const & policy);
+
+    /// Get the garbage collection limits for the table.
+    RetentionPolicy getRetentionPolicy() const;
 };
 
 #endif // KDI_LOCAL_LOCAL_TABLE_H
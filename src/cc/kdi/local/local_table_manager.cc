@@ -0,0 +1,398 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <kdi/local/local_table_manager.h>
+#include <warp/EnvironmentVariable.h>
+#include <warp/call_or_die.h>
+#include <warp/log.h>
+#include <ex/exception.h>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <assert.h>
+
+using namespace kdi::local;
+using namespace warp;
+using namespace ex;
+using namespace std;
+
+//----------------------------------------------------------------------------
+// LocalTableManager::Table
+//----------------------------------------------------------------------------
+LocalTableManager::Table::Table(ClientPtr const & client,
+                                std::string const & name) :
+    client(client),
+    name(name),
+    activeMemory(0),
+    flushingMemory(0),
+    activeSince(0),
+    flushPending(false),
+    nForcedFlushes(0)
+{
+    for(int k = 0; k < N_TASK_KINDS; ++k)
+    {
+        running[k] = false;
+        nTasksRun[k] = 0;
+    }
+}
+
+bool LocalTableManager::Table::isIdle() const
+{
+    for(int k = 0; k < N_TASK_KINDS; ++k)
+    {
+        if(running[k] || !tasks[k].empty())
+            return false;
+    }
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// LocalTableManager
+//----------------------------------------------------------------------------
+LocalTableManager::LocalTableManager(size_t memoryBudget,
+                                     size_t nSerializeThreads,
+                                     size_t nCompactThreads) :
+    memoryBudget(memoryBudget),
+    shuttingDown(false),
+    activeMemory(0),
+    flushingMemory(0),
+    peakMemory(0),
+    nextAge(0),
+    nForcedFlushes(0),
+    nWriterStalls(0),
+    nTasksQueued(0),
+    nTasksRunning(0),
+    nTasksRun(0),
+    tracker(0)
+{
+    if(!memoryBudget)
+        raise<ValueError>("need positive memory budget");
+
+    for(int k = 0; k < N_TASK_KINDS; ++k)
+        dispatchers[k].init(this, TaskKind(k));
+
+    pools[SERIALIZE].reset(
+        new WorkStealingPool(std::max(nSerializeThreads, size_t(1)),
+                             "LocalTable serialize", false));
+    pools[COMPACT].reset(
+        new WorkStealingPool(std::max(nCompactThreads, size_t(1)),
+                             "LocalTable compact", false));
+}
+
+LocalTableManager::~LocalTableManager()
+{
+    // Only stop once everything queued has run
+    lock_t l(mutex);
+    shuttingDown = true;
+    memoryReleased.notify_all();
+    while(nTasksQueued || nTasksRunning)
+        taskDone.wait(l);
+    l.unlock();
+
+    for(int k = 0; k < N_TASK_KINDS; ++k)
+        pools[k]->shutdown();
+}
+
+LocalTableManager::Table & LocalTableManager::getTable(Client const * client)
+{
+    table_map::iterator it = tables.find(client);
+    if(it == tables.end())
+        raise<RuntimeError>("LocalTableManager: unknown table");
+    return it->second;
+}
+
+void LocalTableManager::makeReady(Table & t, TaskKind kind)
+{
+    // A table is in the ready list iff it has queued tasks of the
+    // kind and none running
+    if(!t.running[kind] && t.tasks[kind].size() == 1)
+    {
+        ready[kind].push_back(&t);
+        pools[kind]->submit(&dispatchers[kind]);
+    }
+}
+
+void LocalTableManager::updateTracker()
+{
+    if(!tracker)
+        return;
+
+    tracker->set("LocalTable.activeMemory", activeMemory);
+    tracker->set("LocalTable.flushingMemory", flushingMemory);
+    tracker->set("LocalTable.peakMemory", peakMemory);
+    tracker->set("LocalTable.forcedFlushes", nForcedFlushes);
+    tracker->set("LocalTable.writerStalls", nWriterStalls);
+    tracker->set("LocalTable.tasksQueued", nTasksQueued);
+    tracker->set("LocalTable.tasksRunning", nTasksRunning);
+    tracker->set("LocalTable.tasksRun", nTasksRun);
+}
+
+LocalTableManager::table_map::iterator LocalTableManager::chooseVictim()
+{
+    table_map::iterator best = tables.end();
+    for(table_map::iterator it = tables.begin(); it != tables.end(); ++it)
+    {
+        Table const & t = it->second;
+        if(t.flushPending || !t.activeMemory)
+            continue;
+
+        if(best == tables.end() ||
+           t.activeMemory > best->second.activeMemory ||
+           (t.activeMemory == best->second.activeMemory &&
+            t.activeSince < best->second.activeSince))
+        {
+            best = it;
+        }
+    }
+    return best;
+}
+
+void LocalTableManager::runNext(TaskKind kind)
+{
+    // Take the next task from the table at the head of the line.
+    // There's one dispatch per ready table, so the line can't be
+    // empty.
+    lock_t l(mutex);
+    assert(!ready[kind].empty());
+    Table * t = ready[kind].front();
+    ready[kind].pop_front();
+
+    task_t task;
+    task.swap(t->tasks[kind].front());
+    t->tasks[kind].pop_front();
+    t->running[kind] = true;
+    --nTasksQueued;
+    ++nTasksRunning;
+    taskDone.notify_all();
+    l.unlock();
+
+    callOrDie(task, "LocalTableManager task", false)();
+
+    // Go to the back of the line if there's more to do.  The table
+    // can't be removed while a task is running.
+    l.lock();
+    t->running[kind] = false;
+    ++t->nTasksRun[kind];
+    if(!t->tasks[kind].empty())
+    {
+        ready[kind].push_back(t);
+        pools[kind]->submit(&dispatchers[kind]);
+    }
+    --nTasksRunning;
+    ++nTasksRun;
+    taskDone.notify_all();
+    updateTracker();
+}
+
+void LocalTableManager::addTable(ClientPtr const & client,
+                                 std::string const & name)
+{
+    lock_t l(mutex);
+    if(!tables.insert(make_pair(client.get(), Table(client, name))).second)
+        raise<RuntimeError>("LocalTableManager: table already added: %s",
+                            name);
+    updateTracker();
+}
+
+void LocalTableManager::removeTable(Client const * client)
+{
+    lock_t l(mutex);
+    table_map::iterator it = tables.find(client);
+    if(it == tables.end())
+        return;
+
+    while(!it->second.isIdle())
+        taskDone.wait(l);
+
+    activeMemory -= it->second.activeMemory;
+    flushingMemory -= it->second.flushingMemory;
+    tables.erase(it);
+    memoryReleased.notify_all();
+    updateTracker();
+}
+
+void LocalTableManager::schedule(Client const * client, TaskKind kind,
+                                 task_t const & task)
+{
+    lock_t l(mutex);
+    Table & t = getTable(client);
+    t.tasks[kind].push_back(task);
+    ++nTasksQueued;
+    makeReady(t, kind);
+    updateTracker();
+}
+
+void LocalTableManager::waitForQueue(Client const * client, TaskKind kind,
+                                     size_t maxQueued)
+{
+    lock_t l(mutex);
+    while(getTable(client).tasks[kind].size() >= maxQueued)
+        taskDone.wait(l);
+}
+
+void LocalTableManager::drain(Client const * client)
+{
+    lock_t l(mutex);
+    while(!getTable(client).isIdle())
+        taskDone.wait(l);
+}
+
+void LocalTableManager::updateMemory(Client const * client, size_t activeBytes)
+{
+    lock_t l(mutex);
+    Table & t = getTable(client);
+
+    if(!t.activeMemory && activeBytes)
+        t.activeSince = nextAge++;
+    activeMemory = activeMemory - t.activeMemory + activeBytes;
+    t.activeMemory = activeBytes;
+    peakMemory = std::max(peakMemory, activeMemory + flushingMemory);
+
+    // If the serialization backlog alone is over budget, flushing
+    // more won't help.  Wait for the pool to catch up.
+    if(flushingMemory > memoryBudget && !shuttingDown)
+    {
+        ++nWriterStalls;
+        log("LocalTable: writer stalled, %d bytes waiting to serialize",
+            flushingMemory);
+        while(flushingMemory > memoryBudget && !shuttingDown)
+            memoryReleased.wait(l);
+    }
+
+    if(activeMemory + flushingMemory > memoryBudget)
+    {
+        // Pick the largest memtable to flush.  The flush happens
+        // outside our lock since it calls back into the manager.
+        table_map::iterator victim = chooseVictim();
+        if(victim != tables.end())
+        {
+            Client const * key = victim->first;
+            Table & v = victim->second;
+            v.flushPending = true;
+            ++v.nForcedFlushes;
+            ++nForcedFlushes;
+            ClientPtr p = v.client.lock();
+            log("LocalTable: over memory budget (%d > %d), flushing %s",
+                activeMemory + flushingMemory, memoryBudget, v.name);
+            l.unlock();
+
+            if(p)
+                p->flushMemory();
+            p.reset();
+
+            l.lock();
+            table_map::iterator it = tables.find(key);
+            if(it != tables.end())
+                it->second.flushPending = false;
+        }
+    }
+
+    updateTracker();
+}
+
+void LocalTableManager::retireMemory(Client const * client, size_t bytes)
+{
+    lock_t l(mutex);
+    Table & t = getTable(client);
+
+    activeMemory -= t.activeMemory;
+    t.activeMemory = 0;
+    t.flushingMemory += bytes;
+    flushingMemory += bytes;
+    peakMemory = std::max(peakMemory, activeMemory + flushingMemory);
+    updateTracker();
+}
+
+void LocalTableManager::releaseMemory(Client const * client, size_t bytes)
+{
+    lock_t l(mutex);
+    Table & t = getTable(client);
+
+    bytes = std::min(bytes, t.flushingMemory);
+    t.flushingMemory -= bytes;
+    flushingMemory -= bytes;
+    memoryReleased.notify_all();
+    updateTracker();
+}
+
+void LocalTableManager::getStats(Stats & stats,
+                                 std::vector<TableStats> * tableStats) const
+{
+    lock_t l(mutex);
+
+    stats.memoryBudget = memoryBudget;
+    stats.activeMemory = activeMemory;
+    stats.flushingMemory = flushingMemory;
+    stats.peakMemory = peakMemory;
+    stats.nTables = tables.size();
+    stats.nForcedFlushes = nForcedFlushes;
+    stats.nWriterStalls = nWriterStalls;
+    stats.nTasksQueued = nTasksQueued;
+    stats.nTasksRunning = nTasksRunning;
+    stats.nTasksRun = nTasksRun;
+
+    if(!tableStats)
+        return;
+
+    tableStats->clear();
+    for(table_map::const_iterator it = tables.begin();
+        it != tables.end(); ++it)
+    {
+        Table const & t = it->second;
+        TableStats ts;
+        ts.name = t.name;
+        ts.activeMemory = t.activeMemory;
+        ts.flushingMemory = t.flushingMemory;
+        ts.nTasksQueued = t.tasks[SERIALIZE].size() + t.tasks[COMPACT].size();
+        ts.nSerializations = t.nTasksRun[SERIALIZE];
+        ts.nCompactions = t.nTasksRun[COMPACT];
+        ts.nForcedFlushes = t.nForcedFlushes;
+        tableStats->push_back(ts);
+    }
+}
+
+void LocalTableManager::setTracker(warp::StatTracker * tracker)
+{
+    lock_t l(mutex);
+    this->tracker = tracker;
+    updateTracker();
+}
+
+namespace {
+
+    LocalTableManager * makeGlobal()
+    {
+        typedef EnvironmentVariable env;
+        size_t memory = env::getSize("KDI_LOCAL_MEMORY", size_t(512) << 20);
+        size_t nSerialize = env::getSize("KDI_LOCAL_SERIALIZE_THREADS", 2);
+        size_t nCompact = env::getSize("KDI_LOCAL_COMPACT_THREADS", 2);
+
+        log("LocalTableManager: %d byte budget, %d serialize thread(s), "
+            "%d compact thread(s)", memory, nSerialize, nCompact);
+        return new LocalTableManager(memory, nSerialize, nCompact);
+    }
+}
+
+LocalTableManager & LocalTableManager::getGlobal()
+{
+    // Intentionally leaked: tables held in other statics may still
+    // schedule work or release memory during exit.
+    static LocalTableManager * p = makeGlobal();
+    return *p;
+}
@@ -0,0 +1,247 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#ifndef KDI_LOCAL_LOCAL_TABLE_MANAGER_H
+#define KDI_LOCAL_LOCAL_TABLE_MANAGER_H
+
+#include <warp/StatTracker.h>
+#include <warp/WorkStealingPool.h>
+#include <warp/Runnable.h>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include <deque>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace kdi {
+namespace local {
+
+    class LocalTableManager;
+
+} // namespace local
+} // namespace kdi
+
+//----------------------------------------------------------------------------
+// LocalTableManager
+//----------------------------------------------------------------------------
+/// Shared resources for all the LocalTables in a process.  The
+/// manager owns a single memory budget for the memtables of every
+/// registered table, and a pair of worker pools for background
+/// serializations and compactions.
+///
+/// When the memtables in the process grow past the budget, the
+/// manager asks the table with the largest active memtable (the
+/// oldest on ties) to flush it.  If the memtables waiting to be
+/// serialized alone exceed the budget, writers block until the
+/// serialization pool catches up.
+///
+/// Tasks are scheduled per table.  Each pool hands out work to tables
+/// in round-robin order, so one busy table can't starve the others,
+/// and runs at most one task of each kind per table at a time, so
+/// tasks for a single table run in the order they were scheduled.
+class kdi::local::LocalTableManager
+    : private boost::noncopyable
+{
+public:
+    /// Interface a table implements to take part in memory management.
+    class Client
+    {
+    public:
+        /// Start serializing the active memtable.  This is called
+        /// from an arbitrary writer thread with no manager locks held.
+        virtual void flushMemory() = 0;
+
+    protected:
+        ~Client() {}
+    };
+
+    typedef boost::shared_ptr<Client> ClientPtr;
+    typedef boost::function<void ()> task_t;
+
+    enum TaskKind {
+        SERIALIZE,
+        COMPACT,
+        N_TASK_KINDS
+    };
+
+    /// Process-wide counters.
+    struct Stats
+    {
+        size_t memoryBudget;
+        size_t activeMemory;    ///< Memory in writable memtables
+        size_t flushingMemory;  ///< Memory waiting to be serialized
+        size_t peakMemory;
+        size_t nTables;
+        size_t nForcedFlushes;  ///< Flushes triggered by the budget
+        size_t nWriterStalls;   ///< Writers blocked on serialization
+        size_t nTasksQueued;
+        size_t nTasksRunning;
+        size_t nTasksRun;
+    };
+
+    /// Per-table counters.
+    struct TableStats
+    {
+        std::string name;
+        size_t activeMemory;
+        size_t flushingMemory;
+        size_t nTasksQueued;
+        size_t nSerializations;
+        size_t nCompactions;
+        size_t nForcedFlushes;
+    };
+
+private:
+    typedef boost::mutex mutex_t;
+    typedef mutex_t::scoped_lock lock_t;
+
+    struct Table
+    {
+        boost::weak_ptr<Client> client;
+        std::string name;
+        size_t activeMemory;
+        size_t flushingMemory;
+        int64_t activeSince;
+        bool flushPending;
+        std::deque<task_t> tasks[N_TASK_KINDS];
+        bool running[N_TASK_KINDS];
+        size_t nTasksRun[N_TASK_KINDS];
+        size_t nForcedFlushes;
+
+        Table(ClientPtr const & client, std::string const & name);
+        bool isIdle() const;
+    };
+
+    typedef std::map<Client const *, Table> table_map;
+    typedef std::list<Table *> table_list;
+
+    /// Pool task that runs the next ready task of one kind.  A
+    /// dispatcher is submitted once for each table added to the
+    /// ready list.
+    class Dispatcher : public warp::Runnable
+    {
+        LocalTableManager * manager;
+        TaskKind kind;
+
+    public:
+        Dispatcher() : manager(0), kind(SERIALIZE) {}
+        void init(LocalTableManager * m, TaskKind k) { manager = m; kind = k; }
+        void run() { manager->runNext(kind); }
+    };
+
+    size_t const memoryBudget;
+
+    mutable mutex_t mutex;
+    boost::condition taskDone;
+    boost::condition memoryReleased;
+
+    table_map tables;
+    table_list ready[N_TASK_KINDS];
+    Dispatcher dispatchers[N_TASK_KINDS];
+    boost::scoped_ptr<warp::WorkStealingPool> pools[N_TASK_KINDS];
+    bool shuttingDown;
+
+    size_t activeMemory;
+    size_t flushingMemory;
+    size_t peakMemory;
+    int64_t nextAge;
+    size_t nForcedFlushes;
+    size_t nWriterStalls;
+    size_t nTasksQueued;
+    size_t nTasksRunning;
+    size_t nTasksRun;
+
+    warp::StatTracker * tracker;
+
+    Table & getTable(Client const * client);
+    void makeReady(Table & t, TaskKind kind);
+    void updateTracker();
+    table_map::iterator chooseVictim();
+    void runNext(TaskKind kind);
+
+public:
+    /// Create a manager with the given memtable budget in bytes and
+    /// number of threads for each pool.
+    LocalTableManager(size_t memoryBudget, size_t nSerializeThreads,
+                      size_t nCompactThreads);
+
+    /// Wait for queued tasks and stop the worker pools.  All tables
+    /// should have been removed.
+    ~LocalTableManager();
+
+    /// Register a table.  The manager only keeps a weak reference to
+    /// the client.
+    void addTable(ClientPtr const & client, std::string const & name);
+
+    /// Wait for a table's background tasks to finish and unregister
+    /// it.
+    void removeTable(Client const * client);
+
+    /// Queue a background task for a table.  Never blocks.
+    void schedule(Client const * client, TaskKind kind, task_t const & task);
+
+    /// Block until fewer than maxQueued tasks of the given kind are
+    /// waiting to start for the table.
+    void waitForQueue(Client const * client, TaskKind kind, size_t maxQueued);
+
+    /// Block until all of a table's queued and running tasks are done.
+    void drain(Client const * client);
+
+    /// Report the size of a table's active memtable.  If the process
+    /// is over budget, this may flush some table's memtable (possibly
+    /// the caller's) and may block waiting for serializations, so it
+    /// must be called without holding any table locks.
+    void updateMemory(Client const * client, size_t activeBytes);
+
+    /// Move a table's active memtable to the flushing state after it
+    /// has been scheduled for serialization.
+    void retireMemory(Client const * client, size_t bytes);
+
+    /// Note that a flushing memtable has been serialized.
+    void releaseMemory(Client const * client, size_t bytes);
+
+    /// Get the process-wide counters and optionally the counters for
+    /// each registered table.
+    void getStats(Stats & stats, std::vector<TableStats> * tableStats=0) const;
+
+    /// Report LocalTable.* stats to the given tracker, or stop
+    /// reporting if the tracker is null.
+    void setTracker(warp::StatTracker * tracker);
+
+    size_t getMemoryBudget() const { return memoryBudget; }
+
+    /// Get the manager shared by all LocalTables.  It is configured
+    /// on first use from the environment: KDI_LOCAL_MEMORY is the
+    /// memory budget (default 512M), and KDI_LOCAL_SERIALIZE_THREADS
+    /// and KDI_LOCAL_COMPACT_THREADS size the pools (default 2 each).
+    /// The global manager is never destroyed, so tables that outlive
+    /// static destruction can still use it.
+    static LocalTableManager & getGlobal();
+};
+
+#endif // KDI_LOCAL_LOCAL_TABLE_MANAGER_H
@@ -0,0 +1,208 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <kdi/local/local_table_manager.h>
+#include <kdi/local/local_table.h>
+#include <kdi/scan_predicate.h>
+#include <unittest/main.h>
+#include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
+#include <vector>
+#include <string>
+
+using namespace kdi;
+using namespace kdi::local;
+using namespace std;
+
+namespace {
+
+    size_t const MB = 1 << 20;
+
+    class FakeClient
+        : public LocalTableManager::Client
+    {
+        LocalTableManager & manager;
+        size_t memory;
+
+    public:
+        size_t nFlushes;
+
+        FakeClient(LocalTableManager & manager) :
+            manager(manager), memory(0), nFlushes(0) {}
+
+        void write(size_t sz)
+        {
+            memory += sz;
+            manager.updateMemory(this, memory);
+        }
+
+        void flushMemory()
+        {
+            ++nFlushes;
+            manager.retireMemory(this, memory);
+            memory = 0;
+        }
+    };
+
+    typedef boost::shared_ptr<FakeClient> FakeClientPtr;
+
+    struct TaskLog
+    {
+        boost::mutex mutex;
+        vector<string> order;
+
+        void record(string const & name)
+        {
+            boost::mutex::scoped_lock l(mutex);
+            order.push_back(name);
+        }
+    };
+
+    void gateTask(boost::mutex * gate)
+    {
+        boost::mutex::scoped_lock l(*gate);
+    }
+}
+
+BOOST_AUTO_UNIT_TEST(fair_schedule_test)
+{
+    LocalTableManager mgr(64 * MB, 1, 1);
+    FakeClientPtr a(new FakeClient(mgr));
+    FakeClientPtr b(new FakeClient(mgr));
+    mgr.addTable(a, "a");
+    mgr.addTable(b, "b");
+
+    // Hold the single serialization worker while the queues fill up
+    TaskLog log;
+    boost::mutex gate;
+    boost::mutex::scoped_lock gl(gate);
+    mgr.schedule(a.get(), LocalTableManager::SERIALIZE,
+                 boost::bind(gateTask, &gate));
+
+    char const * aNames[] = { "a1", "a2", "a3", "a4" };
+    char const * bNames[] = { "b1", "b2" };
+    for(size_t i = 0; i < 4; ++i)
+        mgr.schedule(a.get(), LocalTableManager::SERIALIZE,
+                     boost::bind(&TaskLog::record, &log, string(aNames[i])));
+    for(size_t i = 0; i < 2; ++i)
+        mgr.schedule(b.get(), LocalTableManager::SERIALIZE,
+                     boost::bind(&TaskLog::record, &log, string(bNames[i])));
+
+    gl.unlock();
+    mgr.drain(a.get());
+    mgr.drain(b.get());
+
+    // Tables take turns, and each table's tasks run in order
+    BOOST_REQUIRE_EQUAL(log.order.size(), 6u);
+    BOOST_CHECK_EQUAL(log.order[0], "b1");
+    BOOST_CHECK_EQUAL(log.order[1], "a1");
+    BOOST_CHECK_EQUAL(log.order[2], "b2");
+    BOOST_CHECK_EQUAL(log.order[3], "a2");
+    BOOST_CHECK_EQUAL(log.order[4], "a3");
+    BOOST_CHECK_EQUAL(log.order[5], "a4");
+
+    LocalTableManager::Stats stats;
+    vector<LocalTableManager::TableStats> tableStats;
+    mgr.getStats(stats, &tableStats);
+    BOOST_CHECK_EQUAL(stats.nTasksRun, 7u);
+    BOOST_CHECK_EQUAL(stats.nTasksQueued, 0u);
+    BOOST_REQUIRE_EQUAL(tableStats.size(), 2u);
+
+    mgr.removeTable(a.get());
+    mgr.removeTable(b.get());
+}
+
+BOOST_AUTO_UNIT_TEST(memory_budget_test)
+{
+    LocalTableManager mgr(10 * MB, 1, 1);
+    FakeClientPtr a(new FakeClient(mgr));
+    FakeClientPtr b(new FakeClient(mgr));
+    mgr.addTable(a, "a");
+    mgr.addTable(b, "b");
+
+    // Under budget
+    a->write(6 * MB);
+    b->write(3 * MB);
+    BOOST_CHECK_EQUAL(a->nFlushes, 0u);
+    BOOST_CHECK_EQUAL(b->nFlushes, 0u);
+
+    // Over budget: the larger table gets flushed, even though the
+    // other one did the write
+    b->write(2 * MB);
+    BOOST_CHECK_EQUAL(a->nFlushes, 1u);
+    BOOST_CHECK_EQUAL(b->nFlushes, 0u);
+
+    LocalTableManager::Stats stats;
+    mgr.getStats(stats);
+    BOOST_CHECK_EQUAL(stats.activeMemory, 5 * MB);
+    BOOST_CHECK_EQUAL(stats.flushingMemory, 6 * MB);
+    BOOST_CHECK_EQUAL(stats.peakMemory, 11 * MB);
+    BOOST_CHECK_EQUAL(stats.nForcedFlushes, 1u);
+
+    // Still over budget while the flush is pending, so the next
+    // largest table goes
+    b->write(1 * MB);
+    BOOST_CHECK_EQUAL(b->nFlushes, 1u);
+
+    // Serialization done
+    mgr.releaseMemory(a.get(), 6 * MB);
+    mgr.releaseMemory(b.get(), 6 * MB);
+    mgr.getStats(stats);
+    BOOST_CHECK_EQUAL(stats.activeMemory, 0u);
+    BOOST_CHECK_EQUAL(stats.flushingMemory, 0u);
+
+    mgr.removeTable(a.get());
+    mgr.removeTable(b.get());
+    mgr.getStats(stats);
+    BOOST_CHECK_EQUAL(stats.nTables, 0u);
+}
+
+BOOST_AUTO_UNIT_TEST(shared_pool_test)
+{
+    LocalTableManager & mgr = LocalTableManager::getGlobal();
+    LocalTableManager::Stats stats;
+
+    {
+        LocalTable t1("memfs:/manager/t1");
+        LocalTable t2("memfs:/manager/t2");
+
+        mgr.getStats(stats);
+        BOOST_CHECK_EQUAL(stats.nTables, 2u);
+
+        t1.set("row", "col", 1, "one");
+        t2.set("row", "col", 2, "two");
+        t1.flushMemory();
+        t2.flushMemory();
+    }
+
+    // Closing the tables waits for their serializations
+    mgr.getStats(stats);
+    BOOST_CHECK_EQUAL(stats.nTables, 0u);
+    BOOST_CHECK_EQUAL(stats.flushingMemory, 0u);
+    BOOST_CHECK(stats.nTasksRun >= 2u);
+
+    // Serialized data is readable after reopening
+    LocalTable t1("memfs:/manager/t1");
+    CellStreamPtr scan = t1.scan(ScanPredicate());
+    Cell x;
+    BOOST_REQUIRE(scan->get(x));
+    BOOST_CHECK_EQUAL(x.getValue(), "one");
+    BOOST_CHECK(!scan->get(x));
+}
@@ -40,3 +40,101 @@ BOOST_AUTO_UNIT_TEST(table_interface)
     // Test basic interface
     testTableInterface(table);
 }
+
+BOOST_AUTO_UNIT_TEST(retention_test)
+{
+    string tableDir = "memfs:/retention";
+
+    RetentionPolicy policy;
+    policy.setDefaultLimits(RetentionPolicy::Limits(2, 0));
+
+    // Scans hide versions past the limit
+    {
+        LocalTable t(tableDir);
+        t.setRetentionPolicy(policy);
+        for(int64_t ts = 1; ts <= 5; ++ts)
+            t.set("row", "col", ts, "val");
+        t.sync();
+        BOOST_CHECK_EQUAL(countCells(t.scan(ScanPredicate())), 2u);
+    }
+
+    // The policy is saved with the table
+    {
+        LocalTable t(tableDir);
+        BOOST_CHECK(t.getRetentionPolicy() == policy);
+        BOOST_CHECK_EQUAL(countCells(t.scan(ScanPredicate())), 2u);
+
+        // Nothing has been compacted, so everything comes back
+        t.setRetentionPolicy(RetentionPolicy());
+        BOOST_CHECK_EQUAL(countCells(t.scan(ScanPredicate())), 5u);
+    }
+}
+
+BOOST_AUTO_UNIT_TEST(retention_partial_compaction_test)
+{
+    string tableDir = "memfs:/retention_partial";
+
+    RetentionPolicy policy;
+    policy.setDefaultLimits(RetentionPolicy::Limits(1, 0));
+
+    // Write two versions into separate disk tables
+    {
+        LocalTable t(tableDir);
+        t.set("row", "col", 5, "new");
+        t.flushMemory();
+        t.set("row", "col", 3, "old");
+        t.flushMemory();
+    }
+
+    // Erase the newest version in a newer table, then compact.  If the
+    // compaction doesn't reach the erasure it must not apply the
+    // version limit, and if it does, the erasure goes first.  Either
+    // way the older version survives.
+    {
+        LocalTable t(tableDir);
+        t.setRetentionPolicy(policy);
+        t.erase("row", "col", 5);
+        t.flushMemory();
+        t.compactTable();
+    }
+
+    // The older version is still there
+    {
+        LocalTable t(tableDir);
+        CellStreamPtr scan = t.scan(ScanPredicate());
+        Cell x;
+        BOOST_REQUIRE(scan->get(x));
+        BOOST_CHECK_EQUAL(x.getTimestamp(), 3);
+        BOOST_CHECK(!scan->get(x));
+    }
+}
+
+BOOST_AUTO_UNIT_TEST(retention_full_compaction_test)
+{
+    string tableDir = "memfs:/retention_full";
+
+    RetentionPolicy policy;
+    policy.setDefaultLimits(RetentionPolicy::Limits(1, 0));
+
+    {
+        LocalTable t(tableDir);
+        t.set("row", "col", 5, "new");
+        t.flushMemory();
+        t.set("row", "col", 3, "old");
+        t.flushMemory();
+    }
+
+    // Nothing newer than the disk tables, so a full compaction drops
+    // the extra version
+    {
+        LocalTable t(tableDir);
+        t.setRetentionPolicy(policy);
+        t.compactTable();
+    }
+
+    {
+        LocalTable t(tableDir);
+        t.setRetentionPolicy(RetentionPolicy());
+        BOOST_CHECK_EQUAL(countCells(t.scan(ScanPredicate())), 1u);
+    }
+}
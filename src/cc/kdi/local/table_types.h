@@ -48,6 +48,7 @@ namespace disk {
     using kdi::marshal::CellKey;
     using kdi::marshal::CellData;
     using kdi::marshal::CellBlock;
+    using kdi::marshal::CellBlockV1;
 
     /// Mapping from a beginning CellKey to a CellBlock offset.
     struct IndexEntryV0 {
@@ -58,7 +59,7 @@ namespace disk {
     // Richer index format
     struct IndexEntryV1
     {
-        uint32_t blockChecksum; // Adler-32
+        uint32_t blockChecksum; // Adler-32, or see BlockIndexV2
         warp::StringOffset lastRow;
         uint64_t blockOffset;
         int64_t lowestTime;
@@ -91,6 +92,41 @@ namespace disk {
         warp::ArrayOffset<warp::StringOffset> colFamilies;
     };
 
+    // Same as BlockIndexV1, but says which checksum the index entries
+    // hold
+    struct BlockIndexV2 : public BlockIndexV1
+    {
+        enum { VERSION = 2 };
+
+        enum {
+            CHECKSUM_ADLER32 = 0,
+            CHECKSUM_CRC32C = 1,
+        };
+
+        uint32_t checksumType;
+    };
+
+    // Same as BlockIndexV2, plus the row range and column family
+    // erasures in the table.  They are kept out of the CellBlocks
+    // because they cover many cells and must be seen by any scan
+    // that overlaps them.  The CellData kind field says what each
+    // erasure covers.
+    struct BlockIndexV3 : public BlockIndexV2
+    {
+        enum { VERSION = 3 };
+        warp::ArrayOffset<CellData> rangeErasures;
+    };
+
+    // Same as BlockIndexV3, plus the first row in the table.  With
+    // the last row of the last block, that gives the span of rows in
+    // the table without reading any blocks.  The first row is empty
+    // if the table has no blocks.
+    struct BlockIndexV4 : public BlockIndexV3
+    {
+        enum { VERSION = 4 };
+        warp::StringOffset firstRow;
+    };
+
     // Trailer for a disk table file.
     struct TableInfo
     {
@@ -100,7 +136,7 @@ namespace disk {
 
         enum {
             TYPECODE = WARP_PACK4('T','N','f','o'),
-            VERSION = 1,        // latest version
+            VERSION = 4,        // latest version
             FLAGS = 0,
             ALIGNMENT = 8,
         };
@@ -0,0 +1,197 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <kdi/locality_groups.h>
+#include <warp/config.h>
+#include <warp/uri.h>
+#include <ex/exception.h>
+#include <boost/format.hpp>
+#include <algorithm>
+
+using namespace kdi;
+using namespace warp;
+using namespace ex;
+using namespace std;
+using boost::format;
+
+namespace
+{
+    /// Split a comma-separated list, skipping empty items
+    template <class Out>
+    void splitList(strref_t s, Out out)
+    {
+        char const * p = s.begin();
+        while(p != s.end())
+        {
+            char const * next = std::find(p, s.end(), ',');
+            if(p != next)
+                *out++ = string(p, next);
+            p = (next == s.end() ? next : next + 1);
+        }
+    }
+
+    template <class It>
+    string joinList(It begin, It end)
+    {
+        string r;
+        for(It i = begin; i != end; ++i)
+        {
+            if(i != begin)
+                r += ',';
+            r += *i;
+        }
+        return r;
+    }
+}
+
+
+//----------------------------------------------------------------------------
+// FamilySet
+//----------------------------------------------------------------------------
+bool FamilySet::containsAny(std::vector<warp::StringRange> const & fams) const
+{
+    for(vector<StringRange>::const_iterator i = fams.begin();
+        i != fams.end(); ++i)
+    {
+        if(contains(*i))
+            return true;
+    }
+    return false;
+}
+
+std::string FamilySet::labelUri(std::string const & uri) const
+{
+    if(isUniversal())
+        return uri;
+
+    return uriSetParameter(
+        unlabelUri(uri),
+        complement ? "exceptFamilies" : "families",
+        uriEncode(joinList(families.begin(), families.end())));
+}
+
+FamilySet FamilySet::fromUri(strref_t uri)
+{
+    set<string> fams;
+    splitList(uriDecode(uriGetParameter(uri, "families")),
+              inserter(fams, fams.end()));
+    if(!fams.empty())
+        return FamilySet(fams, false);
+
+    splitList(uriDecode(uriGetParameter(uri, "exceptFamilies")),
+              inserter(fams, fams.end()));
+    return FamilySet(fams, true);
+}
+
+std::string FamilySet::unlabelUri(strref_t uri)
+{
+    return uriEraseParameter(
+        uriEraseParameter(uri, "families"),
+        "exceptFamilies");
+}
+
+
+//----------------------------------------------------------------------------
+// LocalityGroups
+//----------------------------------------------------------------------------
+LocalityGroups::LocalityGroups() :
+    names(1),
+    groupFamilies(1)
+{
+}
+
+void LocalityGroups::addGroup(std::string const & name,
+                              std::vector<std::string> const & families)
+{
+    if(name.empty())
+        raise<ValueError>("locality group needs a name");
+    if(std::find(names.begin(), names.end(), name) != names.end())
+        raise<ValueError>("duplicate locality group: %s", name);
+    if(families.empty())
+        raise<ValueError>("locality group has no families: %s", name);
+
+    for(vector<string>::const_iterator i = families.begin();
+        i != families.end(); ++i)
+    {
+        if(i->empty() || i->find(',') != string::npos)
+            raise<ValueError>("invalid family in locality group %s: '%s'",
+                              name, *i);
+        if(familyGroups.find(*i) != familyGroups.end())
+            raise<ValueError>("family in more than one locality group: %s",
+                              *i);
+    }
+
+    size_t group = names.size();
+    names.push_back(name);
+    groupFamilies.push_back(families);
+    for(vector<string>::const_iterator i = families.begin();
+        i != families.end(); ++i)
+    {
+        familyGroups[*i] = group;
+        groupFamilies[0].push_back(*i);
+    }
+    std::sort(groupFamilies[0].begin(), groupFamilies[0].end());
+}
+
+size_t LocalityGroups::getCellGroup(Cell const & x) const
+{
+    switch(x.getErasureKind())
+    {
+        case ERASE_ROWS:
+            return 0;
+
+        case ERASE_FAMILY:
+            // The erased family is in the column field
+            return getGroup(x.getColumn());
+
+        default:
+            return getGroup(x.getColumnFamily());
+    }
+}
+
+FamilySet LocalityGroups::getFamilySet(size_t group) const
+{
+    // The default group holds everything the named groups don't
+    vector<string> const & fams = groupFamilies[group];
+    return FamilySet(set<string>(fams.begin(), fams.end()), group == 0);
+}
+
+void LocalityGroups::load(Config const & cfg)
+{
+    *this = LocalityGroups();
+    for(size_t i = 0; i < cfg.numChildren(); ++i)
+    {
+        Config const & g = cfg.getChild(i);
+        vector<string> families;
+        splitList(g.get("families"), back_inserter(families));
+        addGroup(g.get("name"), families);
+    }
+}
+
+void LocalityGroups::save(Config & cfg, string const & key) const
+{
+    for(size_t i = 1; i < names.size(); ++i)
+    {
+        string base = str(format("%s.i%d") % key % (i - 1));
+        cfg.set(base + ".name", names[i]);
+        cfg.set(base + ".families",
+                joinList(groupFamilies[i].begin(), groupFamilies[i].end()));
+    }
+}
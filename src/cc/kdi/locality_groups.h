@@ -0,0 +1,177 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#ifndef KDI_LOCALITY_GROUPS_H
+#define KDI_LOCALITY_GROUPS_H
+
+#include <kdi/cell.h>
+#include <kdi/strref.h>
+#include <warp/string_range.h>
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+
+namespace warp { class Config; }
+
+namespace kdi {
+
+    class FamilySet;
+    class LocalityGroups;
+
+} // namespace kdi
+
+//----------------------------------------------------------------------------
+// FamilySet
+//----------------------------------------------------------------------------
+/// A set of column families, given either as the families in the set
+/// or as the families left out of it.  Fragments written for a
+/// locality group are labeled with the families they may hold, so
+/// scans can skip them without knowing the table's current groups.
+///
+/// Columns without a family (no ':') are in the family "".
+class kdi::FamilySet
+{
+    std::set<std::string> families;
+    bool complement;
+
+public:
+    /// Create a set holding every family.
+    FamilySet() : complement(true) {}
+
+    /// Create a set holding the given families, or if \c complement
+    /// is true, every family except the given ones.
+    FamilySet(std::set<std::string> const & families, bool complement) :
+        families(families), complement(complement) {}
+
+    /// True if the family is in the set.
+    bool contains(strref_t family) const
+    {
+        return (families.find(family.toString()) == families.end()) ==
+            complement;
+    }
+
+    /// True if any of the given families is in the set.
+    bool containsAny(std::vector<warp::StringRange> const & fams) const;
+
+    /// True if the set holds every family.
+    bool isUniversal() const { return complement && families.empty(); }
+
+    /// Label a URI with the set.  Nothing is added for the universal
+    /// set.
+    std::string labelUri(std::string const & uri) const;
+
+    /// Get the set a URI is labeled with.  An unlabeled URI gets the
+    /// universal set.
+    static FamilySet fromUri(strref_t uri);
+
+    /// Strip a family set label from a URI.
+    static std::string unlabelUri(strref_t uri);
+
+    bool operator==(FamilySet const & o) const
+    {
+        return complement == o.complement && families == o.families;
+    }
+};
+
+
+//----------------------------------------------------------------------------
+// LocalityGroups
+//----------------------------------------------------------------------------
+/// Assignment of the column families of a table to locality groups.
+/// Each group is stored in its own fragments, so a scan over the
+/// families of one group only reads that group's data.  Families
+/// that aren't in a named group are in the default group.  A table
+/// with no named groups keeps all of its families together.
+///
+/// In a Config, groups look like:
+///    i0.name = links
+///    i0.families = anchor,link
+///    i1.name = content
+///    i1.families = body
+///
+/// Groups are numbered for fast lookup: the default group is always
+/// group 0, and named groups follow in the order they were added.
+class kdi::LocalityGroups
+{
+    typedef std::map<std::string, size_t> family_map;
+
+    std::vector<std::string> names;
+    std::vector<std::vector<std::string> > groupFamilies;
+    family_map familyGroups;
+
+public:
+    LocalityGroups();
+
+    /// Add a named group holding the given families.  Raises
+    /// ValueError if the name is empty or already used, or if a
+    /// family is empty, contains a comma, or is already in a group.
+    void addGroup(std::string const & name,
+                  std::vector<std::string> const & families);
+
+    /// True if there are no named groups.
+    bool isEmpty() const { return names.size() == 1; }
+
+    /// Get the number of groups, including the default group.
+    size_t getGroupCount() const { return names.size(); }
+
+    /// Get the name of a group.  The default group's name is empty.
+    std::string const & getGroupName(size_t group) const
+    {
+        return names[group];
+    }
+
+    /// Get the group holding a column family.
+    size_t getGroup(strref_t family) const
+    {
+        if(isEmpty())
+            return 0;
+        family_map::const_iterator i = familyGroups.find(family.toString());
+        return i != familyGroups.end() ? i->second : 0;
+    }
+
+    /// Get the group a cell should be written to.  Row range
+    /// erasures go to the default group.  Since range erasures still
+    /// apply from fragments that a scan skips, one copy is enough.
+    size_t getCellGroup(Cell const & x) const;
+
+    /// Get the families a group may hold.
+    FamilySet getFamilySet(size_t group) const;
+
+    /// Load groups from a Config node.  Raises ValueError if the
+    /// groups are invalid.
+    void load(warp::Config const & cfg);
+
+    /// Save the groups as children of the given Config key.  Nothing
+    /// is written if there are no named groups.
+    void save(warp::Config & cfg, std::string const & key) const;
+
+    bool operator==(LocalityGroups const & o) const
+    {
+        return names == o.names && groupFamilies == o.groupFamilies;
+    }
+    bool operator!=(LocalityGroups const & o) const
+    {
+        return !(*this == o);
+    }
+};
+
+
+#endif // KDI_LOCALITY_GROUPS_H
@@ -0,0 +1,152 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <kdi/locality_groups.h>
+#include <warp/config.h>
+#include <unittest/main.h>
+#include <ex/exception.h>
+#include <string>
+#include <vector>
+
+using namespace kdi;
+using namespace warp;
+using namespace ex;
+using namespace std;
+
+namespace
+{
+    vector<string> makeList(char const * a, char const * b = 0)
+    {
+        vector<string> r;
+        r.push_back(a);
+        if(b)
+            r.push_back(b);
+        return r;
+    }
+}
+
+BOOST_AUTO_UNIT_TEST(group_test)
+{
+    LocalityGroups groups;
+    BOOST_CHECK(groups.isEmpty());
+    BOOST_CHECK_EQUAL(groups.getGroupCount(), 1u);
+    BOOST_CHECK_EQUAL(groups.getGroup("anchor"), 0u);
+    BOOST_CHECK(groups.getFamilySet(0).isUniversal());
+
+    groups.addGroup("links", makeList("anchor", "link"));
+    groups.addGroup("content", makeList("body"));
+    BOOST_CHECK(!groups.isEmpty());
+    BOOST_CHECK_EQUAL(groups.getGroupCount(), 3u);
+    BOOST_CHECK_EQUAL(groups.getGroupName(0), "");
+    BOOST_CHECK_EQUAL(groups.getGroupName(2), "content");
+
+    BOOST_CHECK_EQUAL(groups.getGroup("anchor"), 1u);
+    BOOST_CHECK_EQUAL(groups.getGroup("link"), 1u);
+    BOOST_CHECK_EQUAL(groups.getGroup("body"), 2u);
+    BOOST_CHECK_EQUAL(groups.getGroup("title"), 0u);
+    BOOST_CHECK_EQUAL(groups.getGroup(""), 0u);
+
+    // The default group holds everything else
+    FamilySet dflt = groups.getFamilySet(0);
+    BOOST_CHECK(dflt.contains("title"));
+    BOOST_CHECK(dflt.contains(""));
+    BOOST_CHECK(!dflt.contains("anchor"));
+    BOOST_CHECK(!dflt.contains("body"));
+
+    FamilySet links = groups.getFamilySet(1);
+    BOOST_CHECK(links.contains("anchor"));
+    BOOST_CHECK(!links.contains("body"));
+    BOOST_CHECK(!links.contains("title"));
+
+    vector<StringRange> fams;
+    fams.push_back("title");
+    fams.push_back("link");
+    BOOST_CHECK(links.containsAny(fams));
+    BOOST_CHECK(dflt.containsAny(fams));
+    BOOST_CHECK(!groups.getFamilySet(2).containsAny(fams));
+
+    // Bad groups
+    BOOST_CHECK_THROW(groups.addGroup("", makeList("x")), ValueError);
+    BOOST_CHECK_THROW(groups.addGroup("links", makeList("x")), ValueError);
+    BOOST_CHECK_THROW(groups.addGroup("x", makeList("body")), ValueError);
+    BOOST_CHECK_THROW(groups.addGroup("x", makeList("a,b")), ValueError);
+    BOOST_CHECK_THROW(groups.addGroup("x", vector<string>()), ValueError);
+}
+
+BOOST_AUTO_UNIT_TEST(cell_group_test)
+{
+    LocalityGroups groups;
+    groups.addGroup("links", makeList("link"));
+
+    BOOST_CHECK_EQUAL(groups.getCellGroup(makeCell("r", "link:a", 0, "")), 1u);
+    BOOST_CHECK_EQUAL(groups.getCellGroup(makeCell("r", "body:a", 0, "")), 0u);
+    BOOST_CHECK_EQUAL(groups.getCellGroup(makeCell("r", "link", 0, "")), 0u);
+    BOOST_CHECK_EQUAL(
+        groups.getCellGroup(makeCellErasure("r", "link:a", 0)), 1u);
+    BOOST_CHECK_EQUAL(
+        groups.getCellGroup(makeFamilyErasure("r", "link", 0)), 1u);
+    BOOST_CHECK_EQUAL(
+        groups.getCellGroup(makeRowRangeErasure("a", "b", 0)), 0u);
+}
+
+BOOST_AUTO_UNIT_TEST(uri_test)
+{
+    LocalityGroups groups;
+    groups.addGroup("links", makeList("link", "anchor"));
+
+    string uri = "disk:data/table/frag?x=1";
+    for(size_t i = 0; i < groups.getGroupCount(); ++i)
+    {
+        FamilySet fams = groups.getFamilySet(i);
+        string labeled = fams.labelUri(uri);
+        BOOST_CHECK(labeled != uri);
+        BOOST_CHECK(FamilySet::fromUri(labeled) == fams);
+        BOOST_CHECK_EQUAL(FamilySet::unlabelUri(labeled), uri);
+
+        // Relabeling replaces the old label
+        FamilySet other = groups.getFamilySet(1 - i);
+        BOOST_CHECK(FamilySet::fromUri(other.labelUri(labeled)) == other);
+    }
+
+    BOOST_CHECK_EQUAL(FamilySet().labelUri(uri), uri);
+    BOOST_CHECK(FamilySet::fromUri(uri).isUniversal());
+}
+
+BOOST_AUTO_UNIT_TEST(config_test)
+{
+    LocalityGroups groups;
+    groups.addGroup("links", makeList("anchor", "link"));
+    groups.addGroup("content", makeList("body"));
+
+    Config cfg;
+    groups.save(cfg, "groups");
+    BOOST_CHECK_EQUAL(cfg.get("groups.i0.name"), "links");
+    BOOST_CHECK_EQUAL(cfg.get("groups.i0.families"), "anchor,link");
+    BOOST_CHECK_EQUAL(cfg.get("groups.i1.name"), "content");
+
+    LocalityGroups loaded;
+    loaded.load(cfg.getChild("groups"));
+    BOOST_CHECK(loaded == groups);
+    BOOST_CHECK_EQUAL(loaded.getGroup("body"), 2u);
+
+    Config empty;
+    LocalityGroups().save(empty, "groups");
+    BOOST_CHECK(!empty.findChild("groups"));
+}
@@ -185,6 +185,18 @@ void LoggedMemoryTable::erase(strref_t row, strref_t column,
     log->erase(row, column, timestamp);
 }
 
+void LoggedMemoryTable::eraseRowRange(strref_t firstRow, strref_t endRow,
+                                      int64_t maxTimestamp)
+{
+    Table::eraseRowRange(firstRow, endRow, maxTimestamp);
+}
+
+void LoggedMemoryTable::eraseColumnFamily(strref_t row, strref_t family,
+                                          int64_t maxTimestamp)
+{
+    Table::eraseColumnFamily(row, family, maxTimestamp);
+}
+
 void LoggedMemoryTable::sync()
 {
     // Sync MemoryTable first so it also has a chance to report
@@ -67,6 +67,13 @@ public:
 
     virtual void erase(strref_t row, strref_t column, int64_t timestamp);
 
+    /// The log only records cells and cell erasures, so range
+    /// erasures are applied by erasing each covered cell.
+    virtual void eraseRowRange(strref_t firstRow, strref_t endRow,
+                               int64_t maxTimestamp);
+    virtual void eraseColumnFamily(strref_t row, strref_t family,
+                                   int64_t maxTimestamp);
+
     virtual void sync();
 };
 
@@ -36,16 +36,30 @@ namespace marshal {
     };
 
     /// Contents of a table Cell.  A null value indicates an erasure
-    /// for the given key.  This structure contains explicit alignment
-    /// padding.
+    /// for the given key.  The kind field was originally alignment
+    /// padding and is zero for plain cells and erasures.  Range
+    /// erasures have a null value and a non-zero kind:
+    ///   KIND_ERASE_ROWS   -- erase rows [key.row, key.column), where
+    ///                        an empty key.column means no end
+    ///   KIND_ERASE_FAMILY -- erase family key.column in key.row
+    /// Both only erase cells with timestamps up to key.timestamp.
+    /// Merge operands have a value and KIND_MERGE.
     struct CellData
     {
+        enum {
+            KIND_CELL = 0,
+            KIND_ERASE_ROWS = 1,
+            KIND_ERASE_FAMILY = 2,
+            KIND_MERGE = 3,
+        };
+
         CellKey key;
         warp::StringOffset value;     // null means erasure
-        uint32_t __pad;
+        uint32_t kind;
     };
 
-    /// Ordered collection of Cells.
+    /// Ordered collection of Cells.  Version 0 blocks only hold
+    /// KIND_CELL cells.
     struct CellBlock
     {
         enum {
@@ -58,6 +72,15 @@ namespace marshal {
         warp::ArrayOffset<CellData> cells;
     };
 
+    /// CellBlock that may hold cells of any kind.  The layout is the
+    /// same.  Blocks with range erasures or merge operands are written
+    /// with this version so older readers reject them instead of
+    /// reading them as plain cells.
+    struct CellBlockV1 : public CellBlock
+    {
+        enum { VERSION = 1 };
+    };
+
 } // namespace marshal
 } // namespace kdi
 
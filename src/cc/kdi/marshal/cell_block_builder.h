@@ -46,11 +46,48 @@ class kdi::marshal::CellBlockBuilder
     warp::StringPoolBuilder pool;
     size_t basePos;
     uint32_t nCells;
+    bool hasKinds;
+
+    // Without interning, only repeats of the previous row or column
+    // are shared, and values are never shared
+    bool interning;
+    size_t lastRow;
+    size_t lastColumn;
+    size_t emptyValue;
+
+    size_t getKeyOffset(size_t & last, strref_t s)
+    {
+        if(last == size_t(-1) || pool.getString(last) != s)
+            last = pool.appendString(s);
+        return last;
+    }
+
+    size_t getRowOffset(strref_t row)
+    {
+        if(interning)
+            return pool.getStringOffset(row);
+        return getKeyOffset(lastRow, row);
+    }
+
+    size_t getColumnOffset(strref_t column)
+    {
+        if(interning)
+            return pool.getStringOffset(column);
+        return getKeyOffset(lastColumn, column);
+    }
+
+    size_t getValueOffset(strref_t value)
+    {
+        if(interning)
+            return pool.getStringOffset(value);
+        return pool.appendString(value);
+    }
 
     void append(size_t rowOffset,
                 size_t columnOffset,
                 int64_t timestamp,
-                size_t valueOffset)
+                size_t valueOffset,
+                uint32_t kind = CellData::KIND_CELL)
     {
         warp::BuilderBlock * b = pool.getStringBlock();
 
@@ -62,7 +99,10 @@ class kdi::marshal::CellBlockBuilder
             arr->appendOffset(b, valueOffset);   // value
         else
             arr->appendOffset(0);                // value
-        arr->append<uint32_t>(0);                // __pad
+        arr->append(kind);                       // kind
+
+        if(kind != CellData::KIND_CELL)
+            hasKinds = true;
 
         // Update cells.length in main block
         ++nCells;
@@ -70,9 +110,17 @@ class kdi::marshal::CellBlockBuilder
     }
 
 public:
-    /// Create a CellBlockBuilder over the given BuilderBlock.
-    explicit CellBlockBuilder(warp::BuilderBlock * builder) :
-        pool(builder)
+    /// Create a CellBlockBuilder over the given BuilderBlock.  By
+    /// default, all strings in the block are interned, so each
+    /// distinct string is stored once.  Without interning, no strings
+    /// are hashed: a row or column is only shared with the cell
+    /// before it, and every value is stored.  This is faster for
+    /// sorted cells with unique values, at the cost of a larger
+    /// block when values repeat.
+    explicit CellBlockBuilder(warp::BuilderBlock * builder,
+                              bool interning = true) :
+        pool(builder),
+        interning(interning)
     {
         reset(builder);
     }
@@ -80,7 +128,7 @@ public:
     /// Reset the builder with a new BuilderBlock.
     void reset(warp::BuilderBlock * builder)
     {
-        BOOST_STATIC_ASSERT(CellBlock::VERSION == 0);
+        BOOST_STATIC_ASSERT(CellBlockV1::VERSION == 1);
 
         EX_CHECK_NULL(builder);
 
@@ -89,14 +137,30 @@ public:
         arr = base->subblock(8);
         pool.reset(builder);
         nCells = 0;
+        hasKinds = false;
+        lastRow = size_t(-1);
+        lastColumn = size_t(-1);
+        emptyValue = size_t(-1);
 
         *base << *arr           // cells.offset
               << nCells;        // cells.length
     }
 
-    /// Reset the builder and reuse the same BuilderBlock.
+    /// Reset the builder and reuse the same BuilderBlock.  The
+    /// BuilderBlock keeps its memory, so a builder reset after each
+    /// block doesn't reallocate once it reaches its working size.
     void reset() { reset(getBuilder()); }
 
+    /// Turn string interning on or off for the following cells.
+    void setInterning(bool interning)
+    {
+        this->interning = interning;
+        lastRow = size_t(-1);
+        lastColumn = size_t(-1);
+    }
+
+    bool isInterning() const { return interning; }
+
     /// Get the backing BuilderBlock.
     warp::BuilderBlock * getBuilder() const { return base; }
 
@@ -104,29 +168,103 @@ public:
     void appendCell(strref_t row, strref_t column, int64_t timestamp,
                     strref_t value)
     {
-        append(pool.getStringOffset(row),
-               pool.getStringOffset(column),
+        append(getRowOffset(row),
+               getColumnOffset(column),
                timestamp,
-               pool.getStringOffset(value));
+               getValueOffset(value));
+    }
+
+    /// Append a Cell with an empty value to the current CellBlock.
+    /// This is used for scans that project out values.
+    void appendKey(strref_t row, strref_t column, int64_t timestamp)
+    {
+        if(emptyValue == size_t(-1))
+            emptyValue = pool.appendString(warp::StringRange());
+        append(getRowOffset(row),
+               getColumnOffset(column),
+               timestamp,
+               emptyValue);
     }
 
     /// Append an erasure Cell to the current CellBlock.
     void appendErasure(strref_t row, strref_t column, int64_t timestamp)
     {
-        append(pool.getStringOffset(row),
-               pool.getStringOffset(column),
+        append(getRowOffset(row),
+               getColumnOffset(column),
                timestamp,
                size_t(-1));
     }
 
-    /// Append a erasure Cell to the current CellBlock.
+    /// Append an erasure for rows [firstRow, endRow) to the current
+    /// CellBlock.  An empty endRow means the range has no end.
+    void appendRowRangeErasure(strref_t firstRow, strref_t endRow,
+                               int64_t maxTimestamp)
+    {
+        append(getRowOffset(firstRow),
+               getColumnOffset(endRow),
+               maxTimestamp,
+               size_t(-1),
+               CellData::KIND_ERASE_ROWS);
+    }
+
+    /// Append an erasure for a column family in a row to the current
+    /// CellBlock.
+    void appendFamilyErasure(strref_t row, strref_t family,
+                             int64_t maxTimestamp)
+    {
+        append(getRowOffset(row),
+               getColumnOffset(family),
+               maxTimestamp,
+               size_t(-1),
+               CellData::KIND_ERASE_FAMILY);
+    }
+
+    /// Append a merge operand to the current CellBlock.  The value
+    /// holds the encoded operator and operand.
+    void appendMergeOperand(strref_t row, strref_t column,
+                            int64_t timestamp, strref_t value)
+    {
+        append(getRowOffset(row),
+               getColumnOffset(column),
+               timestamp,
+               getValueOffset(value),
+               CellData::KIND_MERGE);
+    }
+
+    /// Append a Cell, erasure, range erasure, or merge operand to the
+    /// current CellBlock.
     void append(Cell const & x)
     {
-        append(pool.getStringOffset(x.getRow()),
-               pool.getStringOffset(x.getColumn()),
-               x.getTimestamp(),
-               x.isErasure() ? size_t(-1)
-               : pool.getStringOffset(x.getValue()));
+        switch(x.getErasureKind())
+        {
+            case ERASE_ROWS:
+                appendRowRangeErasure(x.getRow(), x.getValue(),
+                                      x.getTimestamp());
+                break;
+
+            case ERASE_FAMILY:
+                appendFamilyErasure(x.getRow(), x.getColumn(),
+                                    x.getTimestamp());
+                break;
+
+            default:
+                append(getRowOffset(x.getRow()),
+                       getColumnOffset(x.getColumn()),
+                       x.getTimestamp(),
+                       x.isErasure() ? size_t(-1)
+                       : getValueOffset(x.getValue()),
+                       x.isMergeOperand() ? uint32_t(CellData::KIND_MERGE)
+                       : uint32_t(CellData::KIND_CELL));
+                break;
+        }
+    }
+
+    /// Get the CellBlock version needed for the cells appended so
+    /// far: CellBlockV1 if any cell has a kind other than KIND_CELL.
+    uint32_t getVersion() const
+    {
+        return hasKinds ? uint32_t(CellBlockV1::VERSION)
+            : uint32_t(CellBlock::VERSION);
     }
 
     /// Get approximate data size of current CellBlock.
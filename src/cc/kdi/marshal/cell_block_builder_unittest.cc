@@ -20,12 +20,21 @@
 
 #include <unittest/main.h>
 #include <kdi/marshal/cell_block_builder.h>
+#include <kdi/marshal/cell_data.h>
+#include <warp/timer.h>
+#include <boost/format.hpp>
+#include <iostream>
+#include <string>
 #include <vector>
 
 using namespace warp;
 using namespace kdi;
 using namespace kdi::marshal;
 using std::vector;
+using std::string;
+using std::cout;
+using std::endl;
+using boost::format;
 
 BOOST_AUTO_UNIT_TEST(basic)
 {
@@ -92,3 +101,154 @@ BOOST_AUTO_UNIT_TEST(basic)
     ++c;
     BOOST_CHECK_EQUAL(c, block->cells.end());
 }
+
+BOOST_AUTO_UNIT_TEST(range_erasures)
+{
+    Builder builder;
+    CellBlockBuilder cellBuilder(&builder);
+
+    cellBuilder.appendCell("a", "x", 1, "v");
+    cellBuilder.appendErasure("a", "y", 1);
+    BOOST_CHECK_EQUAL(cellBuilder.getVersion(), uint32_t(CellBlock::VERSION));
+    cellBuilder.appendRowRangeErasure("b", "d", 100);
+    BOOST_CHECK_EQUAL(cellBuilder.getVersion(), uint32_t(CellBlockV1::VERSION));
+    cellBuilder.append(makeFamilyErasure("c", "fam", 200));
+    cellBuilder.append(makeRowRangeErasure("e", "", 300));
+    cellBuilder.append(makeMergeOperand("f", "n", 400, "op"));
+
+    builder.finalize();
+    vector<char> buffer(builder.getFinalSize());
+    builder.exportTo(&buffer[0]);
+
+    CellBlock const * block = reinterpret_cast<CellBlock const *>(&buffer[0]);
+    BOOST_REQUIRE_EQUAL(block->cells.size(), 6u);
+
+    CellData const * c = block->cells.begin();
+    BOOST_CHECK_EQUAL(c->kind, uint32_t(CellData::KIND_CELL));
+    BOOST_CHECK_EQUAL(unmarshalCell(*c), makeCell("a", "x", 1, "v"));
+
+    ++c;
+    BOOST_CHECK_EQUAL(c->kind, uint32_t(CellData::KIND_CELL));
+    BOOST_CHECK(c->value.isNull());
+
+    ++c;
+    BOOST_CHECK_EQUAL(c->kind, uint32_t(CellData::KIND_ERASE_ROWS));
+    BOOST_CHECK(c->value.isNull());
+    Cell x = unmarshalCell(*c);
+    BOOST_CHECK_EQUAL(x.getErasureKind(), ERASE_ROWS);
+    BOOST_CHECK_EQUAL(x.getRow(), "b");
+    BOOST_CHECK_EQUAL(x.getValue(), "d");
+    BOOST_CHECK_EQUAL(x.getTimestamp(), 100);
+
+    ++c;
+    BOOST_CHECK_EQUAL(c->kind, uint32_t(CellData::KIND_ERASE_FAMILY));
+    x = unmarshalCell(*c);
+    BOOST_CHECK_EQUAL(x.getErasureKind(), ERASE_FAMILY);
+    BOOST_CHECK_EQUAL(x.getRow(), "c");
+    BOOST_CHECK_EQUAL(x.getColumn(), "fam");
+    BOOST_CHECK_EQUAL(x.getTimestamp(), 200);
+
+    ++c;
+    x = unmarshalCell(*c);
+    BOOST_CHECK_EQUAL(x.getErasureKind(), ERASE_ROWS);
+    BOOST_CHECK_EQUAL(x.getRow(), "e");
+    BOOST_CHECK_EQUAL(x.getValue(), "");
+
+    ++c;
+    BOOST_CHECK_EQUAL(c->kind, uint32_t(CellData::KIND_MERGE));
+    x = unmarshalCell(*c);
+    BOOST_CHECK(x.isMergeOperand());
+    BOOST_CHECK_EQUAL(x.getValue(), "op");
+    BOOST_CHECK_EQUAL(x.getTimestamp(), 400);
+}
+
+BOOST_AUTO_UNIT_TEST(no_interning)
+{
+    Builder builder;
+    CellBlockBuilder cellBuilder(&builder, false);
+    BOOST_CHECK(!cellBuilder.isInterning());
+
+    cellBuilder.appendCell("r1", "c1", 3, "v");
+    cellBuilder.appendCell("r1", "c1", 2, "v");
+    cellBuilder.appendCell("r1", "c2", 1, "v");
+    cellBuilder.appendKey("r2", "c1", 1);
+    cellBuilder.appendKey("r2", "c1", 0);
+    cellBuilder.appendErasure("r3", "c1", 0);
+
+    builder.finalize();
+    vector<char> buffer(builder.getFinalSize());
+    builder.exportTo(&buffer[0]);
+
+    CellBlock const * block = reinterpret_cast<CellBlock const *>(&buffer[0]);
+    BOOST_REQUIRE_EQUAL(block->cells.size(), 6u);
+    CellData const * c = block->cells.begin();
+
+    BOOST_CHECK_EQUAL(unmarshalCell(c[0]), makeCell("r1", "c1", 3, "v"));
+    BOOST_CHECK_EQUAL(unmarshalCell(c[1]), makeCell("r1", "c1", 2, "v"));
+    BOOST_CHECK_EQUAL(unmarshalCell(c[2]), makeCell("r1", "c2", 1, "v"));
+    BOOST_CHECK_EQUAL(unmarshalCell(c[3]), makeCell("r2", "c1", 1, ""));
+    BOOST_CHECK_EQUAL(unmarshalCell(c[4]), makeCell("r2", "c1", 0, ""));
+    BOOST_CHECK_EQUAL(unmarshalCell(c[5]),
+                      makeCellErasure("r3", "c1", 0));
+
+    // Consecutive rows and columns are shared
+    BOOST_CHECK_EQUAL(c[0].key.row.get(), c[2].key.row.get());
+    BOOST_CHECK_EQUAL(c[0].key.column.get(), c[1].key.column.get());
+    BOOST_CHECK_EQUAL(c[3].key.column.get(), c[4].key.column.get());
+
+    // Others aren't, even if they're equal
+    BOOST_CHECK(c[0].key.column.get() != c[3].key.column.get());
+    BOOST_CHECK(c[0].value.get() != c[1].value.get());
+
+    // Key-only cells share one empty value
+    BOOST_CHECK_EQUAL(c[3].value.get(), c[4].value.get());
+}
+
+BOOST_AUTO_UNIT_TEST(builder_benchmark)
+{
+    // Sorted cells with unique values, as a scan or a write batch
+    // usually has
+    size_t const N_BLOCKS = 50;
+    size_t const N_CELLS = 2000;
+    vector<Cell> cells;
+    size_t cellBytes = 0;
+    for(size_t i = 0; i < N_CELLS; ++i)
+    {
+        cells.push_back(
+            makeCell((format("row-%06d") % (i / 8)).str(),
+                     (format("fam:col-%d") % (i % 8)).str(),
+                     i, (format("value-%08d-%s") % i % string(40, 'x'))
+                     .str()));
+        cellBytes += cells.back().getRow().size() +
+            cells.back().getColumn().size() +
+            cells.back().getValue().size() + 8;
+    }
+
+    for(int interning = 1; interning >= 0; --interning)
+    {
+        Builder builder;
+        CellBlockBuilder cellBuilder(&builder, interning);
+        size_t blockBytes = 0;
+
+        WallTimer t;
+        for(size_t b = 0; b < N_BLOCKS; ++b)
+        {
+            builder.reset();
+            cellBuilder.reset();
+            for(vector<Cell>::const_iterator i = cells.begin();
+                i != cells.end(); ++i)
+            {
+                cellBuilder.append(*i);
+            }
+            builder.finalize();
+            blockBytes = builder.getFinalSize();
+        }
+        double dt = t.getElapsed();
+
+        size_t nBytes = N_BLOCKS * cellBytes;
+        cout << (interning ? "interning:   " : "no interning: ")
+             << N_BLOCKS << " blocks of " << N_CELLS << " cells, "
+             << blockBytes << " bytes per block, " << dt << " s ("
+             << nBytes / dt / 1e6 << " MB/s)" << endl;
+    }
+}
@@ -0,0 +1,61 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#ifndef KDI_MARSHAL_CELL_DATA_H
+#define KDI_MARSHAL_CELL_DATA_H
+
+#include <kdi/marshal/cell_block.h>
+#include <kdi/cell.h>
+
+namespace kdi {
+namespace marshal {
+
+    /// Make a Cell from a marshalled CellData.  Cells, erasures,
+    /// range erasures, and merge operands are all handled.
+    inline Cell unmarshalCell(CellData const & x)
+    {
+        switch(x.kind)
+        {
+            case CellData::KIND_ERASE_ROWS:
+                return makeRowRangeErasure(*x.key.row, *x.key.column,
+                                           x.key.timestamp);
+
+            case CellData::KIND_ERASE_FAMILY:
+                return makeFamilyErasure(*x.key.row, *x.key.column,
+                                         x.key.timestamp);
+
+            case CellData::KIND_MERGE:
+                return makeMergeOperand(*x.key.row, *x.key.column,
+                                        x.key.timestamp, *x.value);
+
+            default:
+                if(x.value)
+                    return makeCell(*x.key.row, *x.key.column,
+                                    x.key.timestamp, *x.value);
+                else
+                    return makeCellErasure(*x.key.row, *x.key.column,
+                                           x.key.timestamp);
+        }
+    }
+
+} // namespace marshal
+} // namespace kdi
+
+#endif // KDI_MARSHAL_CELL_DATA_H
@@ -20,8 +20,12 @@
 
 #include <kdi/memory_table.h>
 #include <kdi/cell_filter.h>
+#include <kdi/scan_predicate.h>
+#include <kdi/range_erasure.h>
+#include <kdi/merge_operator.h>
 #include <ex/exception.h>
 #include <vector>
+#include <limits>
 
 using namespace kdi;
 using namespace warp;
@@ -49,19 +53,22 @@ class MemoryTable::Scanner : public CellStream
 {
     boost::shared_ptr<MemoryTable const> table;
     MemoryTable::set_t::const_iterator tableIt;
+    MemoryTable::set_t::const_iterator tableEnd;
 
 public:
     Scanner(boost::shared_ptr<MemoryTable const> const & table,
-            MemoryTable::set_t::const_iterator const & tableIt) :
+            MemoryTable::set_t::const_iterator const & tableIt,
+            MemoryTable::set_t::const_iterator const & tableEnd) :
         table(table),
-        tableIt(tableIt)
+        tableIt(tableIt),
+        tableEnd(tableEnd)
     {
         EX_CHECK_NULL(table);
     }
 
     bool get(Cell & x)
     {
-        if(tableIt == table->cells.end())
+        if(tableIt == tableEnd)
             return false;
 
         x = tableIt->cell;
@@ -75,6 +82,34 @@ public:
 //----------------------------------------------------------------------------
 void MemoryTable::insert(Cell const & cell)
 {
+    if(cell.isRangeErasure())
+    {
+        if(!filterErasures)
+            raise<ValueError>("MemoryTable without erasure filtering "
+                              "can't hold range erasures");
+
+        // The erasure only hides what is already in the table, so
+        // turn each covered Cell into a cell erasure.  Cells set
+        // later aren't affected, whatever their timestamps.
+        int64_t const maxTime = std::numeric_limits<int64_t>::max();
+        StringRange end = cell.getValue();
+        for(set_t::iterator i = cells.lower_bound(
+                Item(makeCellErasure(cell.getRow(), "", maxTime)));
+            i != cells.end(); ++i)
+        {
+            Cell & x = i->cell;
+            if(!end.empty() && end <= x.getRow())
+                break;
+            if(x.isErasure() || !rangeErasureCovers(cell, x))
+                continue;
+
+            memUsage -= x.getValue().size();
+            x = makeCellErasure(x.getRow(), x.getColumn(),
+                                x.getTimestamp());
+        }
+        return;
+    }
+
     // Try to insert the cell -- if it is already in the 
     pair<set_t::iterator, bool> r = cells.insert(Item(cell));
 
@@ -132,13 +167,37 @@ void MemoryTable::erase(strref_t row, strref_t column, int64_t timestamp)
     insert(makeCellErasure(row, column, timestamp));
 }
 
+void MemoryTable::eraseRowRange(strref_t firstRow, strref_t endRow,
+                                int64_t maxTimestamp)
+{
+    insert(makeRowRangeErasure(firstRow, endRow, maxTimestamp));
+}
+
+void MemoryTable::eraseColumnFamily(strref_t row, strref_t family,
+                                    int64_t maxTimestamp)
+{
+    insert(makeFamilyErasure(row, family, maxTimestamp));
+}
+
+void MemoryTable::merge(strref_t row, strref_t column, int64_t timestamp,
+                        strref_t op, strref_t operand)
+{
+    insert(makeMergeCell(row, column, timestamp, op, operand));
+}
+
 CellStreamPtr MemoryTable::scan(ScanPredicate const & pred) const
 {
     CellStreamPtr s;
     if(filterErasures)
     {
         s = makeErasureFilter();
-        s->pipeFrom(scanWithErasures());
+        s->pipeFrom(scanRows(pred.getRowPredicate()));
+
+        // Fold merge operands before the predicate can hide the
+        // Cells beneath them
+        CellStreamPtr fold = makeMergeFoldFilter();
+        fold->pipeFrom(s);
+        s = fold;
     }
     else if(pred.getMaxHistory())
     {
@@ -146,11 +205,43 @@ CellStreamPtr MemoryTable::scan(ScanPredicate const & pred) const
     }
     else
     {
-        s = scanWithErasures();
+        s = scanRows(pred.getRowPredicate());
     }
     return applyPredicateFilter(pred, s);
 }
 
+size_t MemoryTable::get(strref_t row, strref_t column, size_t maxVersions,
+                        vector<Cell> & out) const
+{
+    // Timestamps sort in descending order, so the maximum timestamp
+    // is the first possible key for the (row, column) pair
+    Item first(makeCellErasure(row, column,
+                               std::numeric_limits<int64_t>::max()));
+
+    vector<Cell> versions;
+    size_t n = 0;
+    for(set_t::const_iterator i = cells.lower_bound(first);
+        i != cells.end() && (!maxVersions || n < maxVersions); ++i)
+    {
+        Cell const & x = i->cell;
+        if(x.getRow() != row || x.getColumn() != column)
+            break;
+        if(filterErasures && x.isErasure())
+            continue;
+
+        // Runs of merge operands fold into the Cell beneath them, so
+        // they don't count as versions of their own
+        versions.push_back(x);
+        if(!filterErasures || !x.isMergeOperand())
+            ++n;
+    }
+
+    if(filterErasures)
+        foldMergeVersions(versions);
+    out.insert(out.end(), versions.begin(), versions.end());
+    return versions.size();
+}
+
 size_t MemoryTable::getMemoryUsage() const
 {
     return memUsage;
@@ -167,12 +258,50 @@ CellStreamPtr MemoryTable::scanWithErasures() const
     CellStreamPtr s(
         new Scanner(
             shared_from_this(),
-            cells.begin()
+            cells.begin(),
+            cells.end()
             )
         );
     return s;
 }
 
+CellStreamPtr
+MemoryTable::scanRows(ScanPredicate::StringSetCPtr const & rows) const
+{
+    if(!rows)
+        return scanWithErasures();
+
+    // Scan the whole rows from the first to the last in the set and
+    // leave the finer filtering to the predicate.  The first
+    // possible key of a row is the erasure with the maximum
+    // timestamp and an empty column.
+    int64_t const maxTime = std::numeric_limits<int64_t>::max();
+    set_t::const_iterator first = cells.end();
+    set_t::const_iterator last = cells.end();
+    if(!rows->isEmpty())
+    {
+        IntervalPoint<string> const & lo = *rows->begin();
+        if(lo.isInfinite())
+            first = cells.begin();
+        else
+            first = cells.lower_bound(
+                Item(makeCellErasure(lo.getValue(), "", maxTime)));
+
+        IntervalPoint<string> const & hi = *--rows->end();
+        if(!hi.isInfinite())
+        {
+            // Everything in the row sorts before the next row
+            string next(hi.getValue());
+            next += '\0';
+            last = cells.lower_bound(
+                Item(makeCellErasure(next, "", maxTime)));
+        }
+    }
+
+    CellStreamPtr s(new Scanner(shared_from_this(), first, last));
+    return s;
+}
+
 
 //----------------------------------------------------------------------------
 // Registration
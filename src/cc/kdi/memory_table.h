@@ -23,7 +23,9 @@
 
 #include <kdi/table.h>
 #include <kdi/cell.h>
+#include <kdi/scan_predicate.h>
 #include <set>
+#include <vector>
 #include <boost/shared_ptr.hpp>
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/noncopyable.hpp>
@@ -81,6 +83,10 @@ class kdi::MemoryTable
     /// Scan implementation for MemoryTable.
     class Scanner;
 
+    /// Scan the Cells with erasures in the rows spanned by the row
+    /// predicate.  A null predicate scans everything.
+    CellStreamPtr scanRows(ScanPredicate::StringSetCPtr const & rows) const;
+
 protected:
     // Constructor is protected -- use create()
     MemoryTable(bool filterErasures);
@@ -96,9 +102,29 @@ public:
 
     virtual void erase(strref_t row, strref_t column, int64_t timestamp);
 
+    /// Range erasures are only supported by tables that filter
+    /// erasures.  A table that returns erasures to be merged with
+    /// other tables has no way to return range erasures from a scan.
+    virtual void eraseRowRange(strref_t firstRow, strref_t endRow,
+                               int64_t maxTimestamp);
+    virtual void eraseColumnFamily(strref_t row, strref_t family,
+                                   int64_t maxTimestamp);
+
+    /// Merge operands are stored as they are.  Tables that filter
+    /// erasures fold them on scans and lookups.
+    virtual void merge(strref_t row, strref_t column, int64_t timestamp,
+                       strref_t op, strref_t operand);
+
     using Table::scan;
     virtual CellStreamPtr scan(ScanPredicate const & pred) const;
 
+    /// Point lookup by seeking directly to the cell key.  If the
+    /// table doesn't filter erasures, they and merge operands are
+    /// returned like any other cell and count towards maxVersions.
+    using Table::get;
+    virtual size_t get(strref_t row, strref_t column, size_t maxVersions,
+                       std::vector<Cell> & out) const;
+
     virtual void sync() { /* nothing to do */ }
 
     /// Get the approximate memory used by Cells stored in this table.
@@ -20,6 +20,7 @@
 
 #include <kdi/memory_table.h>
 #include <kdi/table_unittest.h>
+#include <ex/exception.h>
 #include <unittest/main.h>
 
 using namespace kdi;
@@ -63,6 +64,17 @@ BOOST_AUTO_TEST_CASE(basic_table)
                     "(a,b:c,42,ERASED)"
                     "(b,b:c,45,ERASED)"
                     ));
+
+    // Point lookups include erasures when they aren't filtered
+    std::vector<Cell> cells;
+    BOOST_CHECK_EQUAL(t->get("a", "b:c", 0, cells), 2u);
+    BOOST_CHECK_EQUAL(t->get("b", "b:c", 0, cells), 1u);
+    BOOST_CHECK_EQUAL(t->get("a", "b:d", 0, cells), 0u);
+    BOOST_CHECK((out << cells).is_equal(
+                    "(a,b:c,45,e)"
+                    "(a,b:c,42,ERASED)"
+                    "(b,b:c,45,ERASED)"
+                    ));
 }
 
 BOOST_AUTO_TEST_CASE(basic_api)
@@ -70,3 +82,114 @@ BOOST_AUTO_TEST_CASE(basic_api)
     TablePtr p = Table::open("mem:");
     testTableInterface(p);
 }
+
+BOOST_AUTO_TEST_CASE(range_erasures)
+{
+    test_out_t out;
+
+    MemoryTablePtr t = MemoryTable::create(true);
+    t->set("a", "x:1", 10, "a1");
+    t->set("b", "x:1", 10, "b1");
+    t->set("b", "y:1", 10, "b2");
+    t->set("c", "x:1", 10, "c1");
+    t->set("c", "x:1", 30, "c2");
+    t->set("d", "x:1", 10, "d1");
+
+    // Erase rows [b, d) up to time 20.  The newer version in c
+    // survives.
+    t->eraseRowRange("b", "d", 20);
+    BOOST_CHECK((out << *t).is_equal(
+                    "(a,x:1,10,a1)"
+                    "(c,x:1,30,c2)"
+                    "(d,x:1,10,d1)"
+                    ));
+
+    // The erasure only hides cells set before it, so cells set later
+    // show up even with old timestamps
+    t->set("b", "x:1", 10, "b3");
+    t->set("b", "x:1", 25, "b4");
+    BOOST_CHECK((out << *t).is_equal(
+                    "(a,x:1,10,a1)"
+                    "(b,x:1,25,b4)"
+                    "(b,x:1,10,b3)"
+                    "(c,x:1,30,c2)"
+                    "(d,x:1,10,d1)"
+                    ));
+
+    // Column family erasure only hits its family in one row
+    t->set("d", "y:1", 10, "d2");
+    t->eraseColumnFamily("d", "x", 100);
+    BOOST_CHECK((out << *t).is_equal(
+                    "(a,x:1,10,a1)"
+                    "(b,x:1,25,b4)"
+                    "(b,x:1,10,b3)"
+                    "(c,x:1,30,c2)"
+                    "(d,y:1,10,d2)"
+                    ));
+
+    // Point lookups skip covered versions
+    std::vector<Cell> cells;
+    BOOST_CHECK_EQUAL(t->get("c", "x:1", 0, cells), 1u);
+    BOOST_CHECK_EQUAL(t->get("d", "x:1", 0, cells), 0u);
+    BOOST_CHECK((out << cells).is_equal("(c,x:1,30,c2)"));
+
+    // An empty end row erases to the end of the table
+    t->eraseRow("a", 100);
+    t->eraseRowRange("c", "", 100);
+    BOOST_CHECK((out << *t).is_equal("(b,x:1,25,b4)(b,x:1,10,b3)"));
+
+    // Range erasures go through insert() as well
+    TablePtr(t)->insert(makeRowRangeErasure("", "", 1000));
+    BOOST_CHECK((out << *t).is_empty());
+
+    // Tables that keep erasures can't hold range erasures
+    MemoryTablePtr raw = MemoryTable::create(false);
+    BOOST_CHECK_THROW(raw->eraseRowRange("a", "b", 1), ex::ValueError);
+}
+
+BOOST_AUTO_TEST_CASE(range_erasure_fallback)
+{
+    test_out_t out;
+
+    // The Table default erases each covered cell
+    TablePtr t = Table::open("mem:");
+    t->set("a", "x:1", 10, "a1");
+    t->set("b", "x:1", 10, "b1");
+    t->set("b", "y:1", 30, "b2");
+    t->set("c", "x:1", 10, "c1");
+    t->Table::eraseRowRange("a", "c", 20);
+    t->Table::eraseColumnFamily("c", "x", 20);
+    BOOST_CHECK((out << *t).is_equal("(b,y:1,30,b2)"));
+}
+
+BOOST_AUTO_TEST_CASE(row_range_scan)
+{
+    test_out_t out;
+
+    MemoryTablePtr t = MemoryTable::create(true);
+    t->set("a", "x", 1, "a");
+    t->set("b", "x", 1, "b");
+    t->set("b", "y", 1, "b2");
+    t->set("b\x01", "x", 1, "b1");
+    t->set("c", "x", 1, "c");
+    t->set("d", "x", 1, "d");
+    t->erase("c", "x", 1);
+
+    // Scans only walk the rows spanned by the predicate, but still
+    // respect the bounds inside them
+    BOOST_CHECK((out << *t->scan("row = 'b'")).is_equal(
+                    "(b,x,1,b)"
+                    "(b,y,1,b2)"
+                    ));
+    BOOST_CHECK((out << *t->scan("'a' < row < 'c'")).is_equal(
+                    "(b,x,1,b)"
+                    "(b,y,1,b2)"
+                    "(b\x01,x,1,b1)"
+                    ));
+    BOOST_CHECK((out << *t->scan("row = 'a' or row >= 'c'")).is_equal(
+                    "(a,x,1,a)"
+                    "(d,x,1,d)"
+                    ));
+    BOOST_CHECK((out << *t->scan("row < 'b'")).is_equal("(a,x,1,a)"));
+    BOOST_CHECK((out << *t->scan("row > 'z'")).is_empty());
+}
@@ -0,0 +1,360 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <kdi/merge_operator.h>
+#include <warp/tuple_encode.h>
+#include <warp/strutil.h>
+#include <ex/exception.h>
+#include <boost/format.hpp>
+#include <algorithm>
+#include <assert.h>
+
+using namespace kdi;
+using namespace warp;
+using namespace ex;
+using namespace std;
+using boost::format;
+
+//----------------------------------------------------------------------------
+// Built-in operators
+//----------------------------------------------------------------------------
+namespace
+{
+    /// Base for operators over int64 decimal values
+    class Int64Operator : public MergeOperator
+    {
+        virtual int64_t combine(int64_t value, int64_t operand) const = 0;
+
+    public:
+        void validate(strref_t arg, strref_t operand) const
+        {
+            int64_t x;
+            if(arg.size())
+                raise<ValueError>("int64 merge operators take no "
+                                  "argument: %s", arg);
+            if(!parseInt(x, operand))
+                raise<ValueError>("invalid int64 operand: %s", operand);
+        }
+
+        void apply(string & value, bool hasValue,
+                   strref_t arg, strref_t operand) const
+        {
+            int64_t x;
+            if(!parseInt(x, operand))
+                return;
+
+            if(hasValue)
+            {
+                int64_t v;
+                if(!parseInt(v, value))
+                    v = 0;
+                x = combine(v, x);
+            }
+            value = (format("%d") % x).str();
+        }
+    };
+
+    class AddOperator : public Int64Operator
+    {
+        int64_t combine(int64_t value, int64_t operand) const
+        {
+            // Wrap around on overflow like a two's complement add,
+            // without relying on undefined signed overflow
+            return int64_t(uint64_t(value) + uint64_t(operand));
+        }
+    };
+
+    class MaxOperator : public Int64Operator
+    {
+        int64_t combine(int64_t value, int64_t operand) const
+        {
+            return std::max(value, operand);
+        }
+    };
+
+    class MinOperator : public Int64Operator
+    {
+        int64_t combine(int64_t value, int64_t operand) const
+        {
+            return std::min(value, operand);
+        }
+    };
+
+    /// Append to a list with a bounded length
+    class AppendOperator : public MergeOperator
+    {
+        static bool parseLength(size_t & n, strref_t arg)
+        {
+            return parseInt(n, arg) && n > 0;
+        }
+
+    public:
+        void validate(strref_t arg, strref_t operand) const
+        {
+            size_t n;
+            if(!parseLength(n, arg))
+                raise<ValueError>("append needs a positive length: %s",
+                                  arg);
+        }
+
+        void apply(string & value, bool hasValue,
+                   strref_t arg, strref_t operand) const
+        {
+            size_t n;
+            if(!parseLength(n, arg))
+                return;
+
+            // A value that isn't a list starts a new one
+            vector<string> items;
+            if(hasValue)
+            {
+                try {
+                    decodeStringSequence(value, back_inserter(items));
+                }
+                catch(ValueError const &) {
+                    items.clear();
+                }
+            }
+
+            items.push_back(str(operand));
+            if(items.size() > n)
+                items.erase(items.begin(), items.end() - n);
+            value = encodeStringSequence(items);
+        }
+    };
+
+    /// Fold merge operands into the Cells beneath them
+    class MergeFoldFilter : public CellStream
+    {
+        CellStreamPtr input;
+        Cell next;
+        bool hasNext;
+        vector<Cell> operands;
+
+    public:
+        MergeFoldFilter() : hasNext(false) {}
+
+        void pipeFrom(CellStreamPtr const & input)
+        {
+            this->input = input;
+            next.release();
+            hasNext = false;
+        }
+
+        bool get(Cell & x)
+        {
+            if(!input)
+                return false;
+
+            if(hasNext)
+            {
+                x = next;
+                hasNext = false;
+            }
+            else if(!input->get(x))
+                return false;
+
+            if(!x.isMergeOperand())
+                return true;
+
+            // Gather the rest of the run and the Cell beneath it.
+            // Anything past the end of the column is kept for the
+            // next call.
+            operands.clear();
+            operands.push_back(x);
+            Cell base;
+            while((hasNext = input->get(next)) &&
+                  next.getRow() == x.getRow() &&
+                  next.getColumn() == x.getColumn())
+            {
+                hasNext = false;
+                if(!next.isMergeOperand())
+                {
+                    base = next;
+                    break;
+                }
+                operands.push_back(next);
+            }
+
+            x = foldMergeOperands(operands, base);
+            return true;
+        }
+    };
+}
+
+//----------------------------------------------------------------------------
+// MergeOperatorRegistry
+//----------------------------------------------------------------------------
+MergeOperatorRegistry::MergeOperatorRegistry()
+{
+    static AddOperator addOp;
+    static MaxOperator maxOp;
+    static MinOperator minOp;
+    static AppendOperator appendOp;
+
+    reg["add"] = &addOp;
+    reg["max"] = &maxOp;
+    reg["min"] = &minOp;
+    reg["append"] = &appendOp;
+}
+
+MergeOperatorRegistry & MergeOperatorRegistry::get()
+{
+    static MergeOperatorRegistry r;
+    return r;
+}
+
+void MergeOperatorRegistry::registerOperator(string const & name,
+                                             MergeOperator const * op)
+{
+    EX_CHECK_NULL(op);
+
+    if(reg.find(name) != reg.end())
+        raise<RuntimeError>(
+            "merge operator has already been registered: %s", name);
+
+    reg[name] = op;
+}
+
+MergeOperator const *
+MergeOperatorRegistry::find(strref_t spec, StringRange & arg) const
+{
+    char const * sep = std::find(spec.begin(), spec.end(), ':');
+    map_t::const_iterator it = reg.find(string(spec.begin(), sep));
+    if(it == reg.end())
+        return 0;
+
+    if(sep != spec.end())
+        arg = StringRange(sep + 1, spec.end());
+    else
+        arg = StringRange();
+    return it->second;
+}
+
+//----------------------------------------------------------------------------
+// Merge operand functions
+//----------------------------------------------------------------------------
+string kdi::encodeMergeOperand(strref_t spec, strref_t operand)
+{
+    string value;
+    value.reserve(spec.size() + 1 + operand.size());
+    value.append(spec.begin(), spec.end());
+    value += '\0';
+    value.append(operand.begin(), operand.end());
+    return value;
+}
+
+bool kdi::decodeMergeOperand(strref_t value, StringRange & spec,
+                             StringRange & operand)
+{
+    char const * sep = std::find(value.begin(), value.end(), '\0');
+    if(sep == value.end())
+        return false;
+
+    spec = StringRange(value.begin(), sep);
+    operand = StringRange(sep + 1, value.end());
+    return true;
+}
+
+Cell kdi::makeMergeCell(strref_t row, strref_t column, int64_t timestamp,
+                        strref_t spec, strref_t operand)
+{
+    StringRange arg;
+    MergeOperator const * op = MergeOperatorRegistry::get().find(spec, arg);
+    if(!op)
+        raise<ValueError>("unknown merge operator: %s", spec);
+    op->validate(arg, operand);
+
+    return makeMergeOperand(row, column, timestamp,
+                            encodeMergeOperand(spec, operand));
+}
+
+Cell kdi::foldMergeOperands(vector<Cell> const & operands,
+                            Cell const & base)
+{
+    assert(!operands.empty());
+
+    MergeOperatorRegistry const & reg = MergeOperatorRegistry::get();
+
+    string value;
+    bool hasValue = false;
+    if(base)
+    {
+        StringRange v = base.getValue();
+        value.assign(v.begin(), v.end());
+        hasValue = true;
+    }
+
+    // Operands are newest first, so apply them in reverse
+    for(vector<Cell>::const_reverse_iterator i = operands.rbegin();
+        i != operands.rend(); ++i)
+    {
+        StringRange spec, operand, arg;
+        if(!decodeMergeOperand(i->getValue(), spec, operand))
+            continue;
+
+        MergeOperator const * op = reg.find(spec, arg);
+        if(!op)
+            continue;
+
+        op->apply(value, hasValue, arg, operand);
+        hasValue = true;
+    }
+
+    Cell const & newest = operands.front();
+    return makeCell(newest.getRow(), newest.getColumn(),
+                    newest.getTimestamp(), value);
+}
+
+void kdi::foldMergeVersions(vector<Cell> & versions)
+{
+    // Most columns have no operands, so leave them alone
+    vector<Cell> const & in = versions;
+    vector<Cell>::const_iterator i = in.begin();
+    while(i != in.end() && !i->isMergeOperand())
+        ++i;
+    if(i == in.end())
+        return;
+
+    vector<Cell> out(in.begin(), i);
+    vector<Cell> run;
+    for(; i != in.end(); ++i)
+    {
+        if(i->isMergeOperand())
+            run.push_back(*i);
+        else if(run.empty())
+            out.push_back(*i);
+        else
+        {
+            out.push_back(foldMergeOperands(run, *i));
+            run.clear();
+        }
+    }
+    if(!run.empty())
+        out.push_back(foldMergeOperands(run, Cell()));
+
+    versions.swap(out);
+}
+
+CellStreamPtr kdi::makeMergeFoldFilter()
+{
+    CellStreamPtr p(new MergeFoldFilter);
+    return p;
+}
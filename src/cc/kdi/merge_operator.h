@@ -0,0 +1,130 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#ifndef KDI_MERGE_OPERATOR_H
+#define KDI_MERGE_OPERATOR_H
+
+#include <kdi/cell.h>
+#include <kdi/strref.h>
+#include <warp/string_range.h>
+#include <boost/noncopyable.hpp>
+#include <string>
+#include <vector>
+#include <map>
+
+namespace kdi {
+
+    class MergeOperator;
+    class MergeOperatorRegistry;
+
+    /// Encode an operator spec and operand as the value of a merge
+    /// operand Cell.  The spec is an operator name, optionally
+    /// followed by ':' and an argument (e.g. "append:10").
+    std::string encodeMergeOperand(strref_t spec, strref_t operand);
+
+    /// Split the value of a merge operand Cell into its operator spec
+    /// and operand.  Returns false if the value is malformed.
+    bool decodeMergeOperand(strref_t value, warp::StringRange & spec,
+                            warp::StringRange & operand);
+
+    /// Make a merge operand Cell for the given operator spec.  Raises
+    /// ValueError if the operator is unknown or the operand isn't
+    /// valid for it.
+    Cell makeMergeCell(strref_t row, strref_t column, int64_t timestamp,
+                       strref_t spec, strref_t operand);
+
+    /// Combine a run of merge operands for a single (row, column),
+    /// given newest first, with the base Cell beneath them.  The base
+    /// may be null if the run reaches the end of the column history.
+    /// Operands are applied oldest first.  Returns a regular Cell at
+    /// the timestamp of the newest operand.  Operands with unknown
+    /// operators are skipped.
+    Cell foldMergeOperands(std::vector<Cell> const & operands,
+                           Cell const & base);
+
+    /// Fold the merge operands in the versions of a single (row,
+    /// column), given newest first without erasures.  Each run of
+    /// operands is replaced with its fold over the Cell beneath it.
+    void foldMergeVersions(std::vector<Cell> & versions);
+
+    /// Make a CellStream filter that folds merge operands into the
+    /// Cells beneath them.  The input must be in cell order with
+    /// erasures already removed.
+    CellStreamPtr makeMergeFoldFilter();
+
+} // namespace kdi
+
+//----------------------------------------------------------------------------
+// MergeOperator
+//----------------------------------------------------------------------------
+/// Combines merge operands with older values of a cell.  Operators
+/// are stateless and shared.
+class kdi::MergeOperator
+{
+public:
+    virtual ~MergeOperator() {}
+
+    /// Check that an argument and operand are valid for the operator.
+    /// Raises ValueError if not.
+    virtual void validate(strref_t arg, strref_t operand) const = 0;
+
+    /// Apply an operand to a value.  If hasValue is false, there is
+    /// no older value and the value string is empty.
+    virtual void apply(std::string & value, bool hasValue,
+                       strref_t arg, strref_t operand) const = 0;
+};
+
+//----------------------------------------------------------------------------
+// MergeOperatorRegistry
+//----------------------------------------------------------------------------
+/// Maps operator names to MergeOperators.  The built-in operators
+/// are:
+///   add       -- add int64 decimal operands to an int64 value
+///   max       -- keep the largest int64 value
+///   min       -- keep the smallest int64 value
+///   append:N  -- append the operand to a list of at most N items,
+///                dropping the oldest.  The list is encoded with
+///                warp::encodeStringSequence.
+/// Values that aren't valid for the int64 operators are treated as
+/// zero.
+class kdi::MergeOperatorRegistry
+    : private boost::noncopyable
+{
+    typedef std::map<std::string, MergeOperator const *> map_t;
+
+    map_t reg;
+
+    MergeOperatorRegistry();
+
+public:
+    static MergeOperatorRegistry & get();
+
+    /// Register an operator under the given name.  The operator must
+    /// outlive the registry.  Operators should be registered at
+    /// startup, before any table uses them.
+    void registerOperator(std::string const & name,
+                          MergeOperator const * op);
+
+    /// Find the operator for an operator spec and split out its
+    /// argument.  Returns null if the operator is unknown.
+    MergeOperator const * find(strref_t spec, warp::StringRange & arg) const;
+};
+
+#endif // KDI_MERGE_OPERATOR_H
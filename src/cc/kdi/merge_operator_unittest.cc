@@ -0,0 +1,260 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <kdi/merge_operator.h>
+#include <kdi/memory_table.h>
+#include <kdi/cell_merge.h>
+#include <kdi/local/local_table.h>
+#include <kdi/scan_predicate.h>
+#include <kdi/table_unittest.h>
+#include <warp/tuple_encode.h>
+#include <unittest/main.h>
+#include <ex/exception.h>
+#include <string>
+#include <vector>
+
+using namespace kdi;
+using namespace kdi::unittest;
+using namespace warp;
+using namespace ex;
+using namespace std;
+
+namespace
+{
+    /// Fold operands given newest first over an optional base value
+    string fold(char const * const * specs, char const * const * operands,
+                size_t n, char const * base = 0)
+    {
+        vector<Cell> ops;
+        for(size_t i = 0; i < n; ++i)
+            ops.push_back(makeMergeCell("r", "c", 10 - i, specs[i],
+                                        operands[i]));
+
+        Cell b;
+        if(base)
+            b = makeCell("r", "c", 1, base);
+
+        Cell x = foldMergeOperands(ops, b);
+        BOOST_CHECK(!x.isMergeOperand());
+        BOOST_CHECK_EQUAL(x.getTimestamp(), 10);
+        return str(x.getValue());
+    }
+}
+
+BOOST_AUTO_UNIT_TEST(operator_test)
+{
+    char const * adds[] = { "add", "add", "add" };
+    char const * nums[] = { "5", "-2", "40" };
+    BOOST_CHECK_EQUAL(fold(adds, nums, 3), "43");
+    BOOST_CHECK_EQUAL(fold(adds, nums, 3, "100"), "143");
+
+    // Bad base values count as zero
+    BOOST_CHECK_EQUAL(fold(adds, nums, 3, "junk"), "43");
+
+    // Sums wrap around instead of overflowing
+    char const * bigNums[] = { "1", "9223372036854775807" };
+    BOOST_CHECK_EQUAL(fold(adds, bigNums, 2), "-9223372036854775808");
+
+    char const * maxes[] = { "max", "max", "max" };
+    BOOST_CHECK_EQUAL(fold(maxes, nums, 3), "40");
+    BOOST_CHECK_EQUAL(fold(maxes, nums, 3, "100"), "100");
+
+    char const * mins[] = { "min", "min", "min" };
+    BOOST_CHECK_EQUAL(fold(mins, nums, 3), "-2");
+
+    // Operators can be mixed, and are applied oldest first
+    char const * mixed[] = { "add", "max" };
+    char const * mixedNums[] = { "1", "7" };
+    BOOST_CHECK_EQUAL(fold(mixed, mixedNums, 2, "3"), "8");
+
+    // Lists keep the newest items
+    char const * appends[] = { "append:2", "append:2", "append:2" };
+    char const * words[] = { "c", "b", "a" };
+    vector<string> items = decodeStringSequence(fold(appends, words, 3));
+    BOOST_REQUIRE_EQUAL(items.size(), 2u);
+    BOOST_CHECK_EQUAL(items[0], "b");
+    BOOST_CHECK_EQUAL(items[1], "c");
+}
+
+BOOST_AUTO_UNIT_TEST(validate_test)
+{
+    BOOST_CHECK_THROW(makeMergeCell("r", "c", 1, "bogus", "1"), ValueError);
+    BOOST_CHECK_THROW(makeMergeCell("r", "c", 1, "add", "one"), ValueError);
+    BOOST_CHECK_THROW(makeMergeCell("r", "c", 1, "add:3", "1"), ValueError);
+    BOOST_CHECK_THROW(makeMergeCell("r", "c", 1, "append", "x"), ValueError);
+    BOOST_CHECK_THROW(makeMergeCell("r", "c", 1, "append:0", "x"),
+                      ValueError);
+
+    Cell x = makeMergeCell("r", "c", 1, "append:5", "x");
+    BOOST_CHECK(x.isMergeOperand());
+    BOOST_CHECK(!x.isErasure());
+
+    StringRange spec, operand;
+    BOOST_CHECK(decodeMergeOperand(x.getValue(), spec, operand));
+    BOOST_CHECK_EQUAL(spec, "append:5");
+    BOOST_CHECK_EQUAL(operand, "x");
+}
+
+BOOST_AUTO_UNIT_TEST(memory_table_test)
+{
+    test_out_t out;
+
+    TablePtr t = MemoryTable::create(true);
+    t->set("a", "n", 1, "10");
+    t->merge("a", "n", 2, "add", "5");
+    t->merge("a", "n", 3, "add", "3");
+    t->set("b", "n", 1, "7");
+    t->set("b", "n", 2, "8");
+    t->merge("b", "n", 3, "max", "2");
+    t->merge("c", "n", 1, "add", "1");
+
+    // Each run folds with the cell beneath it, leaving the older
+    // history alone
+    BOOST_CHECK((out << *t).is_equal(
+                    "(a,n,3,18)"
+                    "(b,n,3,8)"
+                    "(b,n,1,7)"
+                    "(c,n,1,1)"
+                    ));
+
+    vector<Cell> v;
+    BOOST_CHECK_EQUAL(t->get("a", "n", 0, v), 1u);
+    BOOST_CHECK_EQUAL(t->get("b", "n", 1, v), 1u);
+    BOOST_CHECK_EQUAL(t->get("c", "n", 0, v), 1u);
+    BOOST_CHECK((out << v).is_equal("(a,n,3,18)(b,n,3,8)(c,n,1,1)"));
+
+    // Erasures hide the base
+    t->erase("a", "n", 1);
+    BOOST_CHECK((out << *t->scan("row = 'a'")).is_equal("(a,n,3,8)"));
+
+    // Tables that keep erasures keep the operands too
+    TablePtr raw = MemoryTable::create(false);
+    raw->set("a", "n", 1, "10");
+    raw->merge("a", "n", 2, "add", "5");
+    CellStreamPtr s = raw->scan();
+    Cell x;
+    BOOST_REQUIRE(s->get(x));
+    BOOST_CHECK(x.isMergeOperand());
+    BOOST_CHECK_EQUAL(countCells(raw->scan()), 2u);
+}
+
+BOOST_AUTO_UNIT_TEST(memory_table_same_timestamp_test)
+{
+    test_out_t out;
+
+    // A second operand at the same timestamp replaces the first
+    // instead of adding to it
+    TablePtr t = MemoryTable::create(true);
+    t->set("a", "n", 1, "10");
+    t->merge("a", "n", 2, "add", "5");
+    t->merge("a", "n", 2, "add", "3");
+
+    BOOST_CHECK((out << *t).is_equal("(a,n,2,13)"));
+}
+
+BOOST_AUTO_UNIT_TEST(cell_merge_test)
+{
+    test_out_t out;
+
+    TablePtr older = MemoryTable::create(false);
+    older->set("a", "n", 1, "1");
+    older->merge("a", "n", 2, "add", "2");
+    older->erase("b", "n", 1);
+
+    TablePtr newer = MemoryTable::create(false);
+    newer->merge("a", "n", 4, "add", "4");
+    newer->merge("a", "n", 3, "add", "3");
+    newer->set("b", "n", 1, "5");
+    newer->merge("b", "n", 2, "add", "1");
+
+    // Folded when erasures are filtered
+    CellStreamPtr merge = CellMerge::make(true);
+    merge->pipeFrom(newer->scan());
+    merge->pipeFrom(older->scan());
+    BOOST_CHECK((out << *merge).is_equal(
+                    "(a,n,4,10)"
+                    "(b,n,2,6)"
+                    ));
+
+    // Passed through otherwise
+    merge = CellMerge::make(false);
+    merge->pipeFrom(newer->scan());
+    merge->pipeFrom(older->scan());
+    BOOST_CHECK_EQUAL(countCells(merge), 6u);
+}
+
+BOOST_AUTO_UNIT_TEST(default_merge_test)
+{
+    test_out_t out;
+
+    // LocalTable reads the old value and writes the new one
+    kdi::local::LocalTable t("memfs:/merge_operator/default");
+    t.set("a", "n", 1, "10");
+    t.merge("a", "n", 2, "add", "5");
+    t.merge("a", "n", 3, "min", "12");
+    t.merge("b", "n", 1, "add", "1");
+    t.sync();
+
+    BOOST_CHECK((out << t).is_equal(
+                    "(a,n,3,12)"
+                    "(a,n,2,15)"
+                    "(a,n,1,10)"
+                    "(b,n,1,1)"
+                    ));
+
+    // Inserted operands take the same path
+    t.insert(makeMergeCell("b", "n", 2, "add", "2"));
+    t.sync();
+    BOOST_CHECK((out << *t.scan(ScanPredicate("row = 'b'"))).is_equal(
+                    "(b,n,2,3)"
+                    "(b,n,1,1)"
+                    ));
+}
+
+BOOST_AUTO_UNIT_TEST(default_merge_newer_base_test)
+{
+    test_out_t out;
+
+    // An operand older than the newest version folds over the
+    // version beneath it, the same as a table that folds lazily
+    TablePtr lazy = MemoryTable::create(true);
+    kdi::local::LocalTable t("memfs:/merge_operator/newer_base");
+    for(int i = 0; i < 2; ++i)
+    {
+        Table & x = i ? static_cast<Table &>(t) : *lazy;
+        x.set("a", "n", 1, "10");
+        x.set("a", "n", 5, "100");
+        x.merge("a", "n", 3, "add", "5");
+        x.merge("b", "n", 3, "add", "1");
+        x.set("b", "n", 3, "7");
+        x.merge("b", "n", 3, "add", "2");
+        x.sync();
+    }
+
+    // Same value as of the operand's timestamp
+    ScanPredicate pred("time <= @3 and history = 1");
+    char const * expected = "(a,n,3,15)(b,n,3,2)";
+    BOOST_CHECK((out << *lazy->scan(pred)).is_equal(expected));
+    BOOST_CHECK((out << *t.scan(pred)).is_equal(expected));
+
+    // The newer version is untouched
+    ScanPredicate newest("row = 'a' and history = 1");
+    BOOST_CHECK((out << *t.scan(newest)).is_equal("(a,n,5,100)"));
+}
@@ -38,6 +38,28 @@ namespace {
         {
             stats->getStats(map);
         }
+
+        void getHistograms(HistogramMap & map, Ice::Current const & cur)
+        {
+            StatReportable::HistogramMap hists;
+            stats->getHistograms(hists);
+
+            map.clear();
+            for(StatReportable::HistogramMap::const_iterator i = hists.begin();
+                i != hists.end(); ++i)
+            {
+                warp::Histogram const & h = i->second;
+                HistogramSummary & s = map[i->first];
+                s.count = h.getCount();
+                s.sum = h.getSum();
+                s.min = h.getMin();
+                s.max = h.getMax();
+                s.p50 = h.getPercentile(50);
+                s.p90 = h.getPercentile(90);
+                s.p99 = h.getPercentile(99);
+                s.p999 = h.getPercentile(99.9);
+            }
+        }
     };
 }
 
@@ -21,6 +21,7 @@
 #ifndef KDI_NET_STATREPORTERI_H
 #define KDI_NET_STATREPORTERI_H
 
+#include <warp/Histogram.h>
 #include <Ice/Ice.h>
 #include <string>
 #include <map>
@@ -33,8 +34,10 @@ namespace net {
     {
     public:
         typedef std::map<std::string, int64_t> StatMap;
+        typedef std::map<std::string, warp::Histogram> HistogramMap;
 
         virtual void getStats(StatMap & stats) const = 0;
+        virtual void getHistograms(HistogramMap & hists) const = 0;
 
     protected:
         ~StatReportable() {}
@@ -32,10 +32,12 @@ using warp::log;
 //----------------------------------------------------------------------------
 TableLocator::TableLocator(table_maker_t const & makeTable,
                            ScannerLocator * scannerLocator,
-                           warp::StatTracker * tracker) :
+                           warp::StatTracker * tracker,
+                           kdi::tablet::AdmissionController * admission) :
     makeTable(makeTable),
     scannerLocator(scannerLocator),
-    tracker(tracker)
+    tracker(tracker),
+    admission(admission)
 {
 }
 
@@ -87,7 +89,8 @@ Ice::ObjectPtr TableLocator::locate(Ice::Current const & cur,
 
             // Create the Ice object wrapper for the table
             using kdi::net::details::TableI;
-            obj = new TableI(tbl, name, scannerLocator, tracker);
+            obj = new TableI(tbl, name, scannerLocator, tracker,
+                             admission);
             log("TableLocator: created table %s", name);
         }
         catch(std::exception const & ex) {
@@ -42,6 +42,7 @@ namespace net {
 } // namespace kdi
 
 namespace warp { class StatTracker; }
+namespace kdi { namespace tablet { class AdmissionController; } }
 
 //----------------------------------------------------------------------------
 // TableLocator
@@ -73,11 +74,13 @@ class kdi::net::TableLocator
     boost::condition objectCreated;
 
     warp::StatTracker * const tracker;
+    kdi::tablet::AdmissionController * const admission;
 
 public:
     TableLocator(table_maker_t const & makeTable,
                  ScannerLocator * scannerLocator,
-                 warp::StatTracker * tracker);
+                 warp::StatTracker * tracker,
+                 kdi::tablet::AdmissionController * admission=0);
     ~TableLocator();
 
     virtual Ice::ObjectPtr locate(Ice::Current const & cur,
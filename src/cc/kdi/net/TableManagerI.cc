@@ -21,18 +21,27 @@
 #include <kdi/net/TableManagerI.h>
 #include <kdi/net/ScannerLocator.h>
 #include <kdi/cell_filter.h>
+#include <kdi/predicate_cache.h>
 #include <kdi/marshal/cell_block.h>
 #include <kdi/marshal/cell_block_builder.h>
+#include <kdi/marshal/cell_data.h>
+#include <kdi/tablet/AdmissionController.h>
+#include <kdi/tablet/SuperTablet.h>
 #include <warp/StatTracker.h>
+#include <warp/OpTrace.h>
 #include <warp/builder.h>
 #include <warp/log.h>
 #include <warp/fs.h>
+#include <warp/strutil.h>
+#include <warp/interval.h>
+#include <warp/timer.h>
 #include <ex/exception.h>
 
 #include <boost/algorithm/string.hpp>
 #include <assert.h>
 
 #include <Ice/ObjectAdapter.h>
+#include <Ice/Connection.h>
 
 using namespace kdi::net::details;
 using namespace std;
@@ -52,9 +61,41 @@ namespace
 
     enum {
         BLOCK_THRESHOLD = 100 << 10,      // 100 KB
-        SCAN_THRESHOLD  =   2 << 20       //   2 MB
+        SCAN_THRESHOLD  =   2 << 20,      //   2 MB
+
+        // Aggregates only return a summary, so each call can cover
+        // more of the scan.  A call also stops when its samples get
+        // big or it has run for a while, so it stays well inside the
+        // client's timeout.
+        AGGREGATE_FETCHES = 8,            //  16 MB
+        AGGREGATE_SAMPLE_BYTES = 1 << 20, //   1 MB
+        AGGREGATE_MAX_MS = 2000,
+        AGGREGATE_CHECK_CELLS = 1024
     };
 
+    /// Get the name of the host on the other end of the request
+    /// connection, for per-client stats.
+    string getClientName(Ice::Current const & cur)
+    {
+        if(!cur.con)
+            return "local";
+
+        // Connection description looks like:
+        //   local address = 10.0.0.1:34177
+        //   remote address = 10.0.0.2:51234
+        string desc = cur.con->toString();
+        string const key = "remote address = ";
+        string::size_type begin = desc.find(key);
+        if(begin == string::npos)
+            return "unknown";
+        begin += key.size();
+
+        string::size_type end = desc.find_first_of(":\n", begin);
+        if(end == string::npos)
+            end = desc.size();
+        return desc.substr(begin, end - begin);
+    }
+
     size_t getScannerId()
     {
         static boost::mutex mutex;
@@ -74,7 +115,9 @@ ScannerI::ScannerI(kdi::TablePtr const & table,
                    kdi::net::ScannerLocator * locator,
                    warp::StatTracker * tracker) :
     limit(new LimitedScanner(SCAN_THRESHOLD)),
-    cellBuilder(&builder),
+    cellBuilder(&builder, false),
+    keysOnly(false),
+    haveNextCell(false),
     locator(locator),
     tracker(tracker)
 {
@@ -114,6 +157,13 @@ ScannerI::ScannerI(kdi::TablePtr const & table,
     if(pred.getMaxHistory())
         filterPred.setMaxHistory(pred.getMaxHistory());
 
+    // Let the table drop values.  Rows are projected after the
+    // filters here, since they could hide the first cell of a row.
+    basePred.setProjection(pred.getInputProjection());
+    if(pred.getProjection() != basePred.getProjection())
+        filterPred.setProjection(pred.getProjection());
+    keysOnly = (basePred.getProjection() == ScanPredicate::PROJECT_KEYS);
+
     limit->pipeFrom(table->scan(basePred));
     scan = applyPredicateFilter(filterPred, limit);
 
@@ -131,7 +181,9 @@ ScannerI::~ScannerI()
 void ScannerI::getBulk(Ice::ByteSeq & cells, bool & lastBlock,
                        Ice::Current const & cur)
 {
+    OpTrace trace(tracker, "Scanner.getBulk");
     boost::mutex::scoped_lock lock(mutex);
+    trace.stage("lock");
 
     builder.reset();
     cellBuilder.reset();
@@ -141,7 +193,12 @@ void ScannerI::getBulk(Ice::ByteSeq & cells, bool & lastBlock,
         Cell x;
         while(scan->get(x))
         {
-            cellBuilder.append(x);
+            // Projected cells have no value to look up
+            if(keysOnly && !x.isErasure() && !x.isMergeOperand())
+                cellBuilder.appendKey(x.getRow(), x.getColumn(),
+                                      x.getTimestamp());
+            else
+                cellBuilder.append(x);
 
             // Is output full?
             if(cellBuilder.getDataSize() >= BLOCK_THRESHOLD)
@@ -150,15 +207,97 @@ void ScannerI::getBulk(Ice::ByteSeq & cells, bool & lastBlock,
     }
 
     lastBlock = limit->endOfStream();
+    trace.stage("scan");
 
     builder.finalize();
     cells.resize(builder.getFinalSize());
     builder.exportTo(&cells[0]);
+    trace.stage("encode");
 
     tracker->add("Scanner.nGets", 1);
     tracker->add("Scanner.getSz", cells.size());
 }
 
+void ScannerI::getAggregate(std::string const & spec,
+                            Ice::ByteSeq & result, bool & lastBlock,
+                            Ice::Current const & cur)
+{
+    OpTrace trace(tracker, "Scanner.getAggregate");
+    boost::mutex::scoped_lock lock(mutex);
+    trace.stage("lock");
+
+    // Keep the aggregate between calls so rows and every-Nth samples
+    // continue across the parts.  Only the results are reset.
+    if(!agg)
+        agg.reset(new ScanAggregate(spec));
+    else if(spec != agg->getSpec())
+        raise<ValueError>("getAggregate: spec changed from '%s' to '%s'",
+                          agg->getSpec(), spec);
+    else
+        agg->reset();
+
+    if(haveNextCell)
+    {
+        agg->add(nextCell);
+        haveNextCell = false;
+    }
+
+    // Once the part is full, finish the current row and stop, so a
+    // client that loses the connection can resume the scan after the
+    // last row it got.  A row too big to finish within twice the
+    // limits is cut off where it is and the part is marked partial.
+    WallTimer timer;
+    bool full = false;
+    bool overfull = false;
+    for(size_t i = 0; !haveNextCell && limit->fetch(); ++i)
+    {
+        if(i >= AGGREGATE_FETCHES)
+            full = true;
+        if(i >= 2 * AGGREGATE_FETCHES)
+            overfull = true;
+
+        Cell x;
+        while(scan->get(x))
+        {
+            bool newRow = (!agg->hasLastRow() ||
+                           x.getRow() != agg->getLastRow());
+            if(overfull || (full && newRow))
+            {
+                nextCell = x;
+                haveNextCell = true;
+                agg->setLastRowPartial(!newRow);
+                break;
+            }
+
+            agg->add(x);
+            if(agg->getSampleBytes() >= AGGREGATE_SAMPLE_BYTES)
+            {
+                full = true;
+                if(agg->getSampleBytes() >= 2 * AGGREGATE_SAMPLE_BYTES)
+                    overfull = true;
+            }
+            if(agg->getCellCount() % AGGREGATE_CHECK_CELLS == 0)
+            {
+                int64_t ms = timer.getElapsedNs() / 1000000;
+                if(ms >= AGGREGATE_MAX_MS)
+                    full = true;
+                if(ms >= 2 * AGGREGATE_MAX_MS)
+                    overfull = true;
+            }
+        }
+    }
+
+    lastBlock = !haveNextCell && limit->endOfStream();
+    trace.stage("scan");
+
+    assign(result, agg->encode());
+    trace.stage("encode");
+
+    tracker->add("Scanner.nAggregates", 1);
+    tracker->add("Scanner.aggregateCells", agg->getCellCount());
+    tracker->add("Scanner.getSz", result.size());
+}
+
 void ScannerI::close(Ice::Current const & cur)
 {
     boost::mutex::scoped_lock lock(mutex);
@@ -178,11 +317,13 @@ void ScannerI::close(Ice::Current const & cur)
 TableI::TableI(kdi::TablePtr const & table,
                std::string const & tablePath,
                kdi::net::ScannerLocator * locator,
-               warp::StatTracker * tracker) :
+               warp::StatTracker * tracker,
+               kdi::tablet::AdmissionController * admission) :
     table(table),
     tablePath(tablePath),
     locator(locator),
-    tracker(tracker)
+    tracker(tracker),
+    admission(admission)
 {
     //log("TableI %p: created", this);
     assert(table);
@@ -216,6 +357,22 @@ void TableI::applyMutations(Ice::ByteSeq const & cells,
 
     assert(!cells.empty());
 
+    OpTrace trace(tracker, "Table.applyMutations", tablePath.c_str());
+
+    // Hold back writers if the server is falling behind on
+    // serialization or compaction
+    if(admission)
+    {
+        try {
+            admission->admit(getClientName(cur));
+        }
+        catch(kdi::tablet::AdmissionRejectedError const & err) {
+            tracker->add("Table.nApplyRejected", 1);
+            throw ServerBusyError(err.what());
+        }
+        trace.stage("admit");
+    }
+
     CellBlock const * b = reinterpret_cast<CellBlock const *>(&cells[0]);
 
     size_t nSet = 0;
@@ -223,7 +380,17 @@ void TableI::applyMutations(Ice::ByteSeq const & cells,
     
     for(CellData const * ci = b->cells.begin(); ci != b->cells.end(); ++ci)
     {
-        if(ci->value)
+        if(ci->kind == CellData::KIND_MERGE)
+        {
+            ++nSet;
+            table->insert(kdi::marshal::unmarshalCell(*ci));
+        }
+        else if(ci->kind != CellData::KIND_CELL)
+        {
+            ++nErase;
+            table->insert(kdi::marshal::unmarshalCell(*ci));
+        }
+        else if(ci->value)
         {
             ++nSet;
             table->set(*ci->key.row, *ci->key.column,
@@ -237,6 +404,8 @@ void TableI::applyMutations(Ice::ByteSeq const & cells,
         }
     }
 
+    trace.stage("apply");
+
     tracker->add("Table.nApply", 1);
     tracker->add("Table.applySz", cells.size());
     tracker->add("Table.nSet", nSet);
@@ -245,6 +414,7 @@ void TableI::applyMutations(Ice::ByteSeq const & cells,
 
 void TableI::sync(Ice::Current const & cur)
 {
+    OpTrace trace(tracker, "Table.sync", tablePath.c_str());
     table->sync();
     tracker->add("Table.nSync", 1);
 }
@@ -252,8 +422,12 @@ void TableI::sync(Ice::Current const & cur)
 ScannerPrx TableI::scan(std::string const & predicate,
                         Ice::Current const & cur)
 {
-    // Parse predicate
-    ScanPredicate pred(predicate);
+    // Parse predicate, or reuse an earlier parse of the same
+    // expression
+    kdi::PredicateCache & predCache = kdi::PredicateCache::getGlobal();
+    ScanPredicate pred = predCache.get(predicate);
+    tracker->set("Table.predicateCacheHits", predCache.getHitCount());
+    tracker->set("Table.predicateCacheMisses", predCache.getMissCount());
 
     // Get unique scanner ID
     size_t scannerId = getScannerId();
@@ -274,6 +448,77 @@ ScannerPrx TableI::scan(std::string const & predicate,
     return ScannerPrx::uncheckedCast(cur.adapter->createProxy(id));
 }
 
+void TableI::getCells(Ice::StringSeq const & rows,
+                      Ice::StringSeq const & columns,
+                      Ice::Int maxVersions,
+                      Ice::ByteSeq & cells,
+                      Ice::Current const & cur)
+{
+    OpTrace trace(tracker, "Table.get", tablePath.c_str());
+
+    if(rows.size() != columns.size())
+        raise<ValueError>("getCells: %d rows but %d columns",
+                          rows.size(), columns.size());
+    if(maxVersions < 0)
+        raise<ValueError>("getCells: negative maxVersions: %d", maxVersions);
+
+    vector<kdi::RowColumn> keys;
+    keys.reserve(rows.size());
+    for(size_t i = 0; i < rows.size(); ++i)
+        keys.push_back(kdi::RowColumn(rows[i], columns[i]));
+
+    vector<Cell> result;
+    table->multiGet(keys, maxVersions, result);
+    trace.stage("lookup");
+
+    Builder builder;
+    kdi::marshal::CellBlockBuilder cellBuilder(&builder);
+    for(vector<Cell>::const_iterator i = result.begin();
+        i != result.end(); ++i)
+    {
+        cellBuilder.append(*i);
+    }
+    builder.finalize();
+    cells.resize(builder.getFinalSize());
+    builder.exportTo(&cells[0]);
+    trace.stage("encode");
+
+    tracker->add("Table.nGet", 1);
+    tracker->add("Table.nGetKeys", keys.size());
+    tracker->add("Table.nGetCells", result.size());
+}
+
+void TableI::loadFragment(std::string const & uri,
+                          std::string const & firstRow,
+                          std::string const & lastRow,
+                          Ice::Current const & cur)
+{
+    OpTrace trace(tracker, "Table.loadFragment", tablePath.c_str());
+
+    log("Load fragment on %s: %s rows=[%s, %s]", tablePath, uri,
+        reprString(wrap(firstRow)), reprString(wrap(lastRow)));
+
+    using kdi::tablet::SuperTablet;
+    boost::shared_ptr<SuperTablet> superTablet =
+        boost::dynamic_pointer_cast<SuperTablet>(table);
+    if(!superTablet)
+        throw BulkLoadError("table does not support fragment loading");
+
+    try {
+        Interval<string> rows;
+        rows.setLowerBound(firstRow, BT_INCLUSIVE);
+        rows.setUpperBound(lastRow, BT_INCLUSIVE);
+        superTablet->loadFragment(uri, rows);
+    }
+    catch(std::exception const & ex) {
+        log("Load fragment failed on %s: %s", tablePath, ex.what());
+        tracker->add("Table.nLoadFragmentFailed", 1);
+        throw BulkLoadError(ex.what());
+    }
+
+    tracker->add("Table.nLoadFragment", 1);
+}
+
 
 //----------------------------------------------------------------------------
 // TableManagerI
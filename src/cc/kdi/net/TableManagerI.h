@@ -27,7 +27,9 @@
 #include <kdi/table.h>
 #include <kdi/scan_predicate.h>
 #include <kdi/LimitedScanner.h>
+#include <kdi/scan_aggregate.h>
 #include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/thread/mutex.hpp>
 #include <Ice/Identity.h>
 
@@ -55,6 +57,7 @@ namespace details {
 } // namespace kdi
 
 namespace warp { class StatTracker; }
+namespace kdi { namespace tablet { class AdmissionController; } }
 
 
 //----------------------------------------------------------------------------
@@ -66,9 +69,22 @@ class kdi::net::details::ScannerI
     boost::shared_ptr<kdi::LimitedScanner> limit;
     kdi::CellStreamPtr scan;
 
+    // Scan output is sorted with mostly unique values, so the cell
+    // builder doesn't intern strings
     warp::Builder builder;
     kdi::marshal::CellBlockBuilder cellBuilder;
 
+    // True if the scan returns cells without values
+    bool keysOnly;
+
+    // Aggregate for getAggregate(), created on the first call
+    boost::scoped_ptr<kdi::ScanAggregate> agg;
+
+    // First cell of the row after the last aggregate part.  Parts
+    // end on row boundaries, so the cell is held for the next call.
+    kdi::Cell nextCell;
+    bool haveNextCell;
+
     ScannerLocator * const locator;
     warp::StatTracker * const tracker;
 
@@ -84,6 +100,10 @@ public:
     virtual void getBulk(Ice::ByteSeq & cells, bool & lastBlock,
                          Ice::Current const & cur);
 
+    virtual void getAggregate(std::string const & spec,
+                              Ice::ByteSeq & result, bool & lastBlock,
+                              Ice::Current const & cur);
+
     virtual void close(Ice::Current const & cur);
 };
 
@@ -100,12 +120,16 @@ class kdi::net::details::TableI
 
     ScannerLocator * const locator;
     warp::StatTracker * const tracker;
+    kdi::tablet::AdmissionController * const admission;
 
 public:
+    /// Create a table servant.  If \c admission is non-null, each
+    /// applyMutations() call must be admitted by it first.
     TableI(kdi::TablePtr const & table,
            std::string const & tablePath,
            ScannerLocator * locator,
-           warp::StatTracker * tracker);
+           warp::StatTracker * tracker,
+           kdi::tablet::AdmissionController * admission=0);
     ~TableI();
 
     virtual void applyMutations(Ice::ByteSeq const & cells,
@@ -115,6 +139,17 @@ public:
 
     virtual ScannerPrx scan(std::string const & predicate,
                             Ice::Current const & cur);
+
+    virtual void getCells(Ice::StringSeq const & rows,
+                          Ice::StringSeq const & columns,
+                          Ice::Int maxVersions,
+                          Ice::ByteSeq & cells,
+                          Ice::Current const & cur);
+
+    virtual void loadFragment(std::string const & uri,
+                              std::string const & firstRow,
+                              std::string const & lastRow,
+                              Ice::Current const & cur);
 };
 
 
@@ -26,6 +26,7 @@
 #include <warp/fs.h>
 #include <warp/filestream.h>
 #include <warp/log.h>
+#include <warp/strutil.h>
 #include <ex/exception.h>
 #include <Ice/Ice.h>
 #include <boost/bind.hpp>
@@ -35,6 +36,7 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <algorithm>
 #include <cstdlib>
 #include <new>
 
@@ -48,9 +50,13 @@
 #include <kdi/tablet/FileTracker.h>
 #include <kdi/tablet/MetaConfigManager.h>
 #include <kdi/tablet/TabletGc.h>
+#include <kdi/tablet/AdmissionController.h>
+#include <warp/WorkStealingPool.h>
 #include <warp/tuple_encode.h>
 
 #include <kdi/local/index_cache.h>
+#include <kdi/local/cache_manifest.h>
+#include <kdi/scan_cache.h>
 
 // For getHostName
 #include <unistd.h>
@@ -63,6 +69,8 @@ using namespace std;
 using namespace ex;
 
 #include <warp/StatTracker.h>
+#include <warp/HistogramSet.h>
+#include <warp/OpTrace.h>
 #include <tr1/unordered_map>
 #include <boost/thread/mutex.hpp>
 
@@ -77,6 +85,8 @@ namespace {
         map_t stats;
         mutable boost::mutex mutex;
 
+        warp::HistogramSet histograms;
+
     public:
         void set(strref_t name, int64_t value)
         {
@@ -90,12 +100,31 @@ namespace {
             stats[name.toString()] += delta;
         }
 
+        void addSample(strref_t name, int64_t value)
+        {
+            histograms.record(name, value);
+        }
+
         void report()
         {
-            boost::mutex::scoped_lock lock(mutex);
-            for(map_t::const_iterator i = stats.begin();
-                i != stats.end(); ++i)
-                log("Stat: %s %d", i->first, i->second);
+            {
+                boost::mutex::scoped_lock lock(mutex);
+                for(map_t::const_iterator i = stats.begin();
+                    i != stats.end(); ++i)
+                    log("Stat: %s %d", i->first, i->second);
+            }
+
+            HistogramMap hists;
+            histograms.getHistograms(hists);
+            for(HistogramMap::const_iterator i = hists.begin();
+                i != hists.end(); ++i)
+            {
+                Histogram const & h = i->second;
+                log("Stat: %s count %d p50 %d p90 %d p99 %d p999 %d max %d",
+                    i->first, h.getCount(), h.getPercentile(50),
+                    h.getPercentile(90), h.getPercentile(99),
+                    h.getPercentile(99.9), h.getMax());
+            }
         }
 
         void getStats(StatReportable::StatMap & out) const
@@ -104,6 +133,11 @@ namespace {
             boost::mutex::scoped_lock lock(mutex);
             out.insert(stats.begin(), stats.end());
         }
+
+        void getHistograms(StatReportable::HistogramMap & out) const
+        {
+            histograms.getHistograms(out);
+        }
     };
 
     inline bool isAlnum(char c)
@@ -179,11 +213,70 @@ namespace {
         return xt;
     }
 
+    /// Make the worker pool shared by everything in the server that
+    /// needs background threads.
+    warp::WorkStealingPool * makeServerPool()
+    {
+        size_t nThreads = 4;
+        if(char * s = getenv("KDI_SERVER_THREADS"))
+            nThreads = parseSize(s);
+
+        log("Server pool: %d thread(s)", nThreads);
+        return new warp::WorkStealingPool(nThreads, "Server pool thread",
+                                          true);
+    }
+
+    /// Start warming the index cache from a saved manifest, or
+    /// return null if there isn't one.  Warming is bounded by
+    /// KDI_WARM_SECONDS (default 30) and KDI_WARM_BYTES (default the
+    /// cache size).
+    kdi::local::CacheWarmer *
+    startCacheWarmer(std::string const & manifest,
+                     warp::WorkStealingPool & pool)
+    {
+        using kdi::local::IndexCache;
+        using kdi::local::CacheManifest;
+        using kdi::local::CacheWarmer;
+
+        if(manifest.empty())
+            return 0;
+
+        IndexCache * cache = IndexCache::getGlobal();
+
+        int64_t seconds = 30;
+        if(char * s = getenv("KDI_WARM_SECONDS"))
+            seconds = parseSize(s);
+        size_t maxBytes = cache->getMaxSize();
+        if(char * s = getenv("KDI_WARM_BYTES"))
+            maxBytes = std::min(parseSize(s), maxBytes);
+
+        IndexCache::count_vec hotSet;
+        try {
+            if(!CacheManifest::load(manifest, hotSet))
+            {
+                log("Cache warm-up: no manifest at %s", manifest);
+                return 0;
+            }
+        }
+        catch(std::exception const & err) {
+            log("Cache warm-up: can't load manifest: %s", err.what());
+            return 0;
+        }
+
+        log("Cache warm-up: loading %d index(es), budget %s in %d sec",
+            hotSet.size(), sizeString(maxBytes), seconds);
+        return new CacheWarmer(cache, hotSet, pool, maxBytes,
+                               seconds * 1000000000);
+    }
+
 
     class SuperTabletServer
     {
         MyTracker * myTracker;
 
+        boost::scoped_ptr<warp::WorkStealingPool> pool;
+        boost::scoped_ptr<tablet::AdmissionController> admission;
+
         tablet::MetaConfigManagerPtr metaConfigMgr;
         tablet::FileTrackerPtr tracker;
 
@@ -199,6 +292,9 @@ namespace {
 
         boost::scoped_ptr<tablet::TabletGc> gc;
 
+        std::string cacheManifest;
+        boost::scoped_ptr<kdi::local::CacheWarmer> cacheWarmer;
+
         boost::scoped_ptr<boost::thread> maintThread;
         boost::mutex maintMutex;
         boost::condition maintCond;
@@ -229,15 +325,36 @@ namespace {
                     // Run stat report
                     myTracker->report();
 
+                if(iter % 5 == 0)
+                    // Save the hot index set
+                    saveCacheManifest();
+
                 lock.lock();
             }
         }
 
+        void saveCacheManifest()
+        {
+            if(cacheManifest.empty())
+                return;
+
+            try {
+                kdi::local::CacheManifest::save(
+                    *kdi::local::IndexCache::getGlobal(), cacheManifest);
+            }
+            catch(std::exception const & err) {
+                log("Can't save cache manifest: %s", err.what());
+            }
+        }
+
     public:
         SuperTabletServer(std::string const & root,
+                          std::string const & cacheManifest,
                           ScannerLocator * locator,
                           MyTracker * myTracker) :
             myTracker(myTracker),
+            pool(makeServerPool()),
+            admission(new tablet::AdmissionController(myTracker)),
             metaConfigMgr(new tablet::MetaConfigManager(root)),
             tracker(new tablet::FileTracker),
             loader(new LoaderAssembly(myTracker, metaConfigMgr)),
@@ -248,14 +365,21 @@ namespace {
                     metaConfigMgr,
                     loader->getLoader(),
                     loggerWriter.get(),
-                    tracker)),
+                    tracker,
+                    myTracker,
+                    admission.get())),
             compactor(
                 new tablet::SharedCompactor(
                     loader->getLoader(),
                     compactorWriter.get(),
-                    myTracker)),
-            workQueue(new tablet::WorkQueue(1)),
+                    myTracker,
+                    pool.get(),
+                    admission.get())),
+            workQueue(
+                new tablet::WorkQueue(
+                    *pool, WorkStealingPool::FOREGROUND, 1)),
             locator(locator),
+            cacheManifest(cacheManifest),
             maintExit(false)
         {
             log("SuperTabletServer %p: created", this);
@@ -295,15 +419,44 @@ namespace {
                         "Maintenance thread", true)));
 
             kdi::local::IndexCache::setTracker(myTracker);
+            kdi::ScanCache::getGlobal().setTracker(myTracker);
+
+            // Start loading the hot index set from the last run
+            cacheWarmer.reset(startCacheWarmer(cacheManifest, *pool));
         }
 
         ~SuperTabletServer()
         {
             kdi::local::IndexCache::setTracker(0);
+            kdi::ScanCache::getGlobal().setTracker(0);
 
             log("SuperTabletServer %p: destroyed", this);
         }
 
+        /// Wait for the cache warm-up started by the constructor to
+        /// finish or run out of budget, and report how much of the
+        /// hot set was restored.
+        void waitForCacheWarmer()
+        {
+            if(!cacheWarmer)
+                return;
+
+            cacheWarmer->wait();
+            log("Cache warm-up: restored %d of %d index(es) (%s) "
+                "in %d ms, %d failed",
+                cacheWarmer->getRestoredCount(),
+                cacheWarmer->getHotSetCount(),
+                sizeString(cacheWarmer->getRestoredBytes()),
+                cacheWarmer->getElapsedNs() / 1000000,
+                cacheWarmer->getFailedCount());
+            cacheWarmer.reset();
+        }
+
+        tablet::AdmissionController * getAdmissionController() const
+        {
+            return admission.get();
+        }
+
         TablePtr makeTable(std::string const & name) const
         {
             if(metaTable && name == "META")
@@ -354,11 +507,17 @@ namespace {
                 maintCond.notify_all();
             }
 
+            if(cacheWarmer)
+                cacheWarmer->cancel();
+
             compactor->shutdown();
             workQueue->shutdown();
             logger->shutdown();
+            pool->shutdown();
 
             maintThread->join();
+
+            saveCacheManifest();
         }
     };
 
@@ -380,6 +539,9 @@ namespace {
                              "Root directory for tablet data");
                 op.addOption("pidfile,p", value<string>(),
                              "Write PID to file");
+                op.addOption("cachemanifest", value<string>(),
+                             "Save the hot index set to file and reload "
+                             "it on startup");
                 op.addOption("nodaemon", "Don't fork and run as daemon");
             }
 
@@ -393,6 +555,10 @@ namespace {
             if(!opt.get("root", tableRoot))
                 op.error("need --root");
 
+            // Get index cache manifest file, if any
+            string cacheManifest;
+            opt.get("cachemanifest", cacheManifest);
+
             // Write PID file
             string pidFile;
             if(opt.get("pidfile", pidFile))
@@ -402,6 +568,14 @@ namespace {
                 pid.close();
             }
 
+            // Log slow requests with a per-stage breakdown
+            if(char * env = getenv("KDI_TRACE_SLOW_MS"))
+                OpTrace::setSlowThreshold(int64_t(parseSize(env)) * 1000);
+
+            // Cache small scan results if a size is given
+            if(char * env = getenv("KDI_SCAN_CACHE"))
+                kdi::ScanCache::getGlobal().setMaxSize(parseSize(env));
+
             // Make scanner locator
             size_t maxScanners = 200;
             if(char * env = getenv("KDI_MAX_SCANNERS"))
@@ -414,7 +588,7 @@ namespace {
             //   -- the Tablet GC.  It doesn't really belong here.
             boost::shared_ptr<SuperTabletServer> server(
                 new SuperTabletServer(
-                    tableRoot, scannerLocator, myTracker));
+                    tableRoot, cacheManifest, scannerLocator, myTracker));
 
             // Create adapter
             Ice::CommunicatorPtr ic = communicator();
@@ -426,7 +600,8 @@ namespace {
                 boost::bind(
                     &SuperTabletServer::makeTable,
                     server, _1),
-                scannerLocator, myTracker);
+                scannerLocator, myTracker,
+                server->getAdmissionController());
 
             // Install locators
             adapter->addServantLocator(scannerLocator, "scan");
@@ -442,6 +617,9 @@ namespace {
                 makeStatReporter(myTracker),
                 ic->stringToIdentity("StatReporter"));
 
+            // Finish warming the index cache before taking requests
+            server->waitForCacheWarmer();
+
             // Run server
             adapter->activate();
             ic->waitForShutdown();
@@ -28,6 +28,8 @@
 
 using kdi::net::details::StatReporterPrx;
 using kdi::net::details::StatMap;
+using kdi::net::details::HistogramMap;
+using kdi::net::details::HistogramSummary;
 using namespace warp;
 using namespace std;
 
@@ -97,6 +99,31 @@ int main(int ac, char ** av)
         {
             cout << i->first << ' ' << i->second << endl;
         }
+
+        // Older servers don't have histograms
+        HistogramMap hists;
+        try {
+            reporter->getHistograms(hists);
+        }
+        catch(Ice::OperationNotExistException const &) {
+            continue;
+        }
+
+        for(HistogramMap::const_iterator i = hists.begin();
+            i != hists.end(); ++i)
+        {
+            HistogramSummary const & h = i->second;
+            cout << i->first
+                 << " count " << h.count
+                 << " mean " << (h.count ? h.sum / h.count : 0)
+                 << " min " << h.min
+                 << " p50 " << h.p50
+                 << " p90 " << h.p90
+                 << " p99 " << h.p99
+                 << " p999 " << h.p999
+                 << " max " << h.max
+                 << endl;
+        }
     }
 
     return 0;
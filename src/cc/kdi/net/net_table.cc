@@ -25,6 +25,8 @@
 #include <kdi/marshal/cell_block.h>
 #include <kdi/marshal/cell_block_builder.h>
 #include <kdi/meta/meta_util.h>
+#include <kdi/merge_operator.h>
+#include <kdi/scan_aggregate.h>
 #include <warp/builder.h>
 #include <warp/uri.h>
 #include <warp/log.h>
@@ -44,6 +46,8 @@
 #include <sstream>
 #include <queue>
 #include <time.h>
+#include <unistd.h>
+#include <algorithm>
 
 using namespace kdi;
 using namespace kdi::net;
@@ -92,9 +96,17 @@ namespace
     int const RETRY_WAIT_SECONDS = 60;
     int const MAX_CONNECTION_ATTEMPTS = 15;   // 15 minutes
 
+    // Backoff range when the server is throttling writes
+    int const MIN_BUSY_WAIT_MS = 100;
+    int const MAX_BUSY_WAIT_MS = 5000;
+
     size_t const MAX_SCAN_FAILURES = 15;
     size_t const N_SCAN_BUFFERS = 3;
 
+    // Keep multi-get requests and replies well under the message
+    // size limit
+    size_t const MAX_GET_KEYS = 1024;
+
     boost::xtime make_xtime(time_t t)
     {
         boost::xtime xt;
@@ -172,8 +184,13 @@ public:
         pending(false),
         scannerOpen(false)
     {
+        bool keysOnly = (pred.getInputProjection() ==
+                         ScanPredicate::PROJECT_KEYS);
         for(size_t i = 0; i < N_SCAN_BUFFERS; ++i)
+        {
+            buffers[i].setKeysOnly(keysOnly);
             emptyQ.push(&buffers[i]);
+        }
     }
 
     ~Scanner()
@@ -234,9 +251,14 @@ private:
         Ice::ByteSeq buffer;
         kdi::marshal::CellData const * next;
         kdi::marshal::CellData const * end;
+        bool keysOnly;
 
     public:
-        Buffer() : next(0), end(0) {}
+        Buffer() : next(0), end(0), keysOnly(false) {}
+
+        /// Don't read values from the block.  The server sends empty
+        /// values for scans that project them out.
+        void setKeysOnly(bool keysOnly) { this->keysOnly = keysOnly; }
 
         void set(Ice::ByteSeq const & other, ptrdiff_t firstIdx)
         {
@@ -254,8 +276,12 @@ private:
 
         void get(Cell & x)
         {
-            x = makeCell(*next->key.row, *next->key.column,
-                         next->key.timestamp, *next->value);
+            if(keysOnly)
+                x = makeCell(*next->key.row, *next->key.column,
+                             next->key.timestamp, StringRange());
+            else
+                x = makeCell(*next->key.row, *next->key.column,
+                             next->key.timestamp, *next->value);
             ++next;
         }
 
@@ -436,10 +462,13 @@ private:
             // Set the last key if we can.
             setLastKey_locked();
 
-            // Trim the scan predicate if we have a last cell
+            // Trim the scan predicate if we have a last cell.  A row
+            // projection is done with the last row.
             ScanPredicate p;
             if(lastKey)
-                p = pred.clipRows(makeLowerBound(lastKey->row));
+                p = pred.clipRows(makeLowerBound(
+                    lastKey->row,
+                    pred.getProjection() != ScanPredicate::PROJECT_ROWS));
             else
                 p = pred;
 
@@ -711,6 +740,8 @@ class NetTable::Impl
     std::string uri;
     details::TablePrx table;
 
+    // Buffered writes are built without interning: hashing every
+    // value costs more than the rare repeat saves
     warp::Builder builder;
     kdi::marshal::CellBlockBuilder cellBuilder;
     Ice::ByteSeq buffer;
@@ -738,6 +769,7 @@ class NetTable::Impl
             builder.exportTo(&buffer[0]);
             reset();
 
+            int busyWaitMs = MIN_BUSY_WAIT_MS;
             for(int attempt = 0;;)
             {
                 try {
@@ -746,6 +778,17 @@ class NetTable::Impl
                         table->sync();
                     break;
                 }
+                catch(details::ServerBusyError const & ex) {
+                    // The server is over its write limits and didn't
+                    // apply anything.  Back off and try again.  This
+                    // isn't a connection failure, so it doesn't count
+                    // against our attempts.
+                    log("server busy on %s, retrying in %d ms",
+                        uri, busyWaitMs);
+                    usleep(busyWaitMs * 1000);
+                    busyWaitMs = std::min(busyWaitMs * 2, MAX_BUSY_WAIT_MS);
+                    continue;
+                }
                 catch(Ice::SocketException const & ex) {
                     log("connection error on %s: %s", uri, ex);
                 }
@@ -800,7 +843,7 @@ class NetTable::Impl
 public:
     explicit Impl(string const & uri) :
         uri(uri),
-        cellBuilder(&builder)
+        cellBuilder(&builder, false)
     {
         for(int attempt = 0;;)
         {
@@ -847,6 +890,28 @@ public:
         maybeFlush();
     }
 
+    void eraseRowRange(strref_t firstRow, strref_t endRow,
+                       int64_t maxTimestamp)
+    {
+        cellBuilder.appendRowRangeErasure(firstRow, endRow, maxTimestamp);
+        maybeFlush();
+    }
+
+    void eraseColumnFamily(strref_t row, strref_t family,
+                           int64_t maxTimestamp)
+    {
+        cellBuilder.appendFamilyErasure(row, family, maxTimestamp);
+        maybeFlush();
+    }
+
+    void merge(strref_t row, strref_t column, int64_t timestamp,
+               strref_t op, strref_t operand)
+    {
+        cellBuilder.append(
+            makeMergeCell(row, column, timestamp, op, operand));
+        maybeFlush();
+    }
+
     CellStreamPtr scan(ScanPredicate const & pred) const
     {
         //log("NetTable::scan(%s)", pred);
@@ -859,6 +924,128 @@ public:
         flush();
     }
 
+    void multiGet(vector<RowColumn> const & keys, size_t maxVersions,
+                  vector<Cell> & out)
+    {
+        // Send our buffered mutations first so we can read them back
+        flush();
+
+        Ice::StringSeq rows;
+        Ice::StringSeq columns;
+        Ice::ByteSeq buffer;
+        for(size_t begin = 0; begin < keys.size(); begin += MAX_GET_KEYS)
+        {
+            size_t end = std::min(keys.size(), begin + MAX_GET_KEYS);
+            rows.clear();
+            columns.clear();
+            for(size_t i = begin; i < end; ++i)
+            {
+                rows.push_back(keys[i].first);
+                columns.push_back(keys[i].second);
+            }
+
+            for(int attempt = 0;;)
+            {
+                try {
+                    table->getCells(rows, columns, maxVersions, buffer);
+                    break;
+                }
+                catch(Ice::SocketException const & ex) {
+                    log("connection error on %s: %s", uri, ex);
+                }
+                catch(Ice::TimeoutException const & ex) {
+                    log("timeout error on %s: %s", uri, ex);
+                }
+
+                if(++attempt >= MAX_CONNECTION_ATTEMPTS)
+                    raise<RuntimeError>("lost connection to %s", uri);
+
+                int sleepTime = RETRY_WAIT_SECONDS;
+                log("will retry in %d seconds (attempt %d of %d)",
+                    sleepTime, attempt, MAX_CONNECTION_ATTEMPTS);
+
+                sleep(sleepTime);
+            }
+
+            using kdi::marshal::CellBlock;
+            using kdi::marshal::CellData;
+            CellBlock const * block =
+                reinterpret_cast<CellBlock const *>(&buffer[0]);
+            for(CellData const * ci = block->cells.begin();
+                ci != block->cells.end(); ++ci)
+            {
+                out.push_back(
+                    makeCell(*ci->key.row, *ci->key.column,
+                             ci->key.timestamp, *ci->value));
+            }
+        }
+    }
+
+    void aggregate(ScanPredicate const & pred, ScanAggregate & agg)
+    {
+        // Send our buffered mutations first so they're counted
+        flush();
+
+        // Only merge into the caller's aggregate once the whole scan
+        // has been summarized.  Parts the server returns end on a row
+        // boundary unless a row is too big for one part, so a retry
+        // resumes after the last complete row we got instead of
+        // starting over.  Parts that end inside a row are held back
+        // until the row is done, and dropped if the connection is
+        // lost first.  Every-Nth sampling restarts its count at the
+        // resumed row.
+        ScanAggregate done(agg.getSpec());
+        Ice::ByteSeq result;
+        for(int attempt = 0;;)
+        {
+            ostringstream oss;
+            if(done.hasLastRow())
+            {
+                Interval<string> rest;
+                rest.setInfinite().setLowerBound(
+                    done.getLastRow(), BT_EXCLUSIVE);
+                oss << pred.clipRows(rest);
+            }
+            else
+                oss << pred;
+
+            try {
+                details::ScannerPrx scanner = table->scan(oss.str());
+                ScanAggregate pending(agg.getSpec());
+                for(bool lastBlock = false; !lastBlock; )
+                {
+                    scanner->getAggregate(agg.getSpec(), result, lastBlock);
+                    pending.mergeEncoded(
+                        StringRange(&result[0], result.size()));
+                    if(!pending.isLastRowPartial())
+                    {
+                        done.merge(pending);
+                        pending = ScanAggregate(agg.getSpec());
+                    }
+                }
+                scanner->close();
+
+                agg.merge(done);
+                break;
+            }
+            catch(Ice::SocketException const & ex) {
+                log("connection error on %s: %s", uri, ex);
+            }
+            catch(Ice::TimeoutException const & ex) {
+                log("timeout error on %s: %s", uri, ex);
+            }
+
+            if(++attempt >= MAX_CONNECTION_ATTEMPTS)
+                raise<RuntimeError>("lost connection to %s", uri);
+
+            int sleepTime = RETRY_WAIT_SECONDS;
+            log("will retry in %d seconds (attempt %d of %d)",
+                sleepTime, attempt, MAX_CONNECTION_ATTEMPTS);
+
+            sleep(sleepTime);
+        }
+    }
+
     RowIntervalStreamPtr scanIntervals() const
     {
         TablePtr metaTable(
@@ -876,6 +1063,21 @@ public:
         return p;
     }
 
+    void loadFragment(std::string const & uri, strref_t firstRow,
+                      strref_t lastRow)
+    {
+        // Make sure anything we've buffered gets there first
+        flush();
+
+        try {
+            table->loadFragment(uri, str(firstRow), str(lastRow));
+        }
+        catch(details::BulkLoadError const & ex) {
+            raise<RuntimeError>("couldn't load %s into %s: %s",
+                                uri, this->uri, ex.reason);
+        }
+    }
+
 };
 
 
@@ -902,6 +1104,24 @@ void NetTable::erase(strref_t row, strref_t column, int64_t timestamp)
     impl->erase(row, column, timestamp);
 }
 
+void NetTable::eraseRowRange(strref_t firstRow, strref_t endRow,
+                             int64_t maxTimestamp)
+{
+    impl->eraseRowRange(firstRow, endRow, maxTimestamp);
+}
+
+void NetTable::eraseColumnFamily(strref_t row, strref_t family,
+                                 int64_t maxTimestamp)
+{
+    impl->eraseColumnFamily(row, family, maxTimestamp);
+}
+
+void NetTable::merge(strref_t row, strref_t column, int64_t timestamp,
+                     strref_t op, strref_t operand)
+{
+    impl->merge(row, column, timestamp, op, operand);
+}
+
 CellStreamPtr NetTable::scan(ScanPredicate const & pred) const
 {
     return impl->scan(pred);
@@ -912,11 +1132,39 @@ void NetTable::sync()
     impl->sync();
 }
 
+size_t NetTable::get(strref_t row, strref_t column, size_t maxVersions,
+                     std::vector<Cell> & out) const
+{
+    size_t sz = out.size();
+    vector<RowColumn> keys(1, RowColumn(str(row), str(column)));
+    impl->multiGet(keys, maxVersions, out);
+    return out.size() - sz;
+}
+
+void NetTable::multiGet(std::vector<RowColumn> const & keys,
+                        size_t maxVersions,
+                        std::vector<Cell> & out) const
+{
+    impl->multiGet(keys, maxVersions, out);
+}
+
+void NetTable::aggregate(ScanPredicate const & pred,
+                         ScanAggregate & agg) const
+{
+    impl->aggregate(pred, agg);
+}
+
 RowIntervalStreamPtr NetTable::scanIntervals() const
 {
     return impl->scanIntervals();
 }
 
+void NetTable::loadFragment(std::string const & uri, strref_t firstRow,
+                            strref_t lastRow)
+{
+    impl->loadFragment(uri, firstRow, lastRow);
+}
+
 
 //----------------------------------------------------------------------------
 // Registration
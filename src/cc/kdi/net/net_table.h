@@ -57,6 +57,40 @@ public:
     virtual CellStreamPtr scan(ScanPredicate const & pred) const;
     virtual void sync();
     virtual RowIntervalStreamPtr scanIntervals() const;
+
+    /// Range erasures are buffered with other mutations and applied
+    /// by the server.
+    virtual void eraseRowRange(strref_t firstRow, strref_t endRow,
+                               int64_t maxTimestamp);
+    virtual void eraseColumnFamily(strref_t row, strref_t family,
+                                   int64_t maxTimestamp);
+
+    /// Merge operands are checked here and folded by the server.
+    virtual void merge(strref_t row, strref_t column, int64_t timestamp,
+                       strref_t op, strref_t operand);
+
+    /// Point lookups are sent to the server in batches.  Mutations
+    /// buffered by this table are flushed first, so they can be read
+    /// back.
+    using Table::get;
+    virtual size_t get(strref_t row, strref_t column, size_t maxVersions,
+                       std::vector<Cell> & out) const;
+    virtual void multiGet(std::vector<RowColumn> const & keys,
+                          size_t maxVersions,
+                          std::vector<Cell> & out) const;
+
+    /// Aggregates are computed by the server, which returns the
+    /// summary for each part of the scan to be merged here.
+    /// Mutations buffered by this table are flushed first.
+    virtual void aggregate(ScanPredicate const & pred,
+                           ScanAggregate & agg) const;
+
+    /// Ask the server to attach a DiskTable file to the tablets
+    /// overlapping the inclusive row range [firstRow, lastRow].  The
+    /// file URI must name a file under the server root, holding only
+    /// rows in the range.  The server takes ownership of the file.
+    void loadFragment(std::string const & uri, strref_t firstRow,
+                      strref_t lastRow);
 };
 
 
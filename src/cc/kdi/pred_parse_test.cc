@@ -19,21 +19,102 @@
 //----------------------------------------------------------------------------
 
 #include <kdi/scan_predicate.h>
+#include <kdi/compiled_predicate.h>
+#include <kdi/predicate_cache.h>
 #include <warp/options.h>
+#include <warp/timer.h>
 #include <ex/exception.h>
+#include <boost/format.hpp>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <vector>
 
 using namespace kdi;
 using namespace warp;
 using namespace std;
 using namespace ex;
+using boost::format;
+
+namespace {
+
+    void report(char const * what, WallTimer const & timer, size_t n)
+    {
+        cout << format("%-12s %10.1f ns/op\n")
+            % what % (timer.getElapsedNs() / double(n));
+    }
+
+    /// Time predicate parsing, cache lookups, and per-cell predicate
+    /// evaluation with the interval sets and the compiled predicate.
+    void benchmark(string const & predStr, size_t n)
+    {
+        WallTimer timer;
+        for(size_t i = 0; i < n; ++i)
+            ScanPredicate pred(predStr);
+        report("parse", timer, n);
+
+        PredicateCache cache(16);
+        cache.get(predStr);
+        timer.reset();
+        for(size_t i = 0; i < n; ++i)
+            cache.get(predStr);
+        report("cached", timer, n);
+
+        // Synthetic cells spread over a few column families
+        vector<Cell> cells;
+        for(size_t i = 0; i < 1000; ++i)
+        {
+            cells.push_back(
+                makeCell((format("row-%06d") % (i * 37 % 1000)).str(),
+                         (format("fam%d:qual") % (i % 4)).str(),
+                         i, "value"));
+        }
+
+        ScanPredicate pred(predStr);
+        size_t nMatch = 0;
+        timer.reset();
+        for(size_t i = 0; i < n; ++i)
+        {
+            Cell const & x = cells[i % cells.size()];
+            if(pred.getTimePredicate() &&
+               !pred.getTimePredicate()->contains(x.getTimestamp()))
+                continue;
+            if(pred.getColumnPredicate() &&
+               !pred.getColumnPredicate()->contains(str(x.getColumn())))
+                continue;
+            if(pred.getRowPredicate() &&
+               !pred.getRowPredicate()->contains(str(x.getRow())))
+                continue;
+            ++nMatch;
+        }
+        report("interval", timer, n);
+
+        CompiledPredicate compiled(pred);
+        size_t nCompiledMatch = 0;
+        timer.reset();
+        for(size_t i = 0; i < n; ++i)
+        {
+            if(compiled.contains(cells[i % cells.size()]))
+                ++nCompiledMatch;
+        }
+        report("compiled", timer, n);
+
+        if(nMatch != nCompiledMatch)
+            raise<RuntimeError>("compiled predicate matched %d cells, "
+                                "expected %d", nCompiledMatch, nMatch);
+    }
+}
 
 int main(int ac, char ** av)
 {
-    OptionParser op("%prog <predicate statement>");
-    
+    OptionParser op("%prog [options] <predicate statement>");
+    {
+        using namespace boost::program_options;
+        op.addOption("bench,b", value<size_t>(),
+                     "Time parsing and evaluating the predicate with "
+                     "the given number of iterations");
+    }
+
     OptionMap opt;
     ArgumentList args;
     op.parseOrBail(ac, av, opt, args);
@@ -59,5 +140,9 @@ int main(int ac, char ** av)
         return 1;
     }
 
+    size_t nIter;
+    if(opt.get("bench", nIter) && nIter)
+        benchmark(predStr, nIter);
+
     return 0;
 }
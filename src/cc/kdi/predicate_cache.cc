@@ -0,0 +1,100 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <kdi/predicate_cache.h>
+
+using namespace kdi;
+using namespace warp;
+using namespace std;
+
+namespace {
+
+    size_t const GLOBAL_CACHE_SIZE = 256;
+
+}
+
+//----------------------------------------------------------------------------
+// PredicateCache
+//----------------------------------------------------------------------------
+PredicateCache::PredicateCache(size_t maxEntries) :
+    cache(maxEntries),
+    nHits(0),
+    nMisses(0)
+{
+}
+
+PredicateCache::~PredicateCache()
+{
+    cache.removeAll();
+}
+
+ScanPredicate PredicateCache::get(strref_t expr)
+{
+    string key(expr.begin(), expr.end());
+
+    lock_t lock(mutex);
+    Entry * e = cache.get(key);
+    if(e->parsed)
+    {
+        ++nHits;
+        ScanPredicate pred = e->pred;
+        cache.release(e);
+        return pred;
+    }
+    ++nMisses;
+
+    // Parse without holding the lock.  The entry stays pinned in the
+    // cache until we release it.
+    lock.unlock();
+    ScanPredicate pred;
+    try {
+        pred = ScanPredicate(expr);
+    }
+    catch(...) {
+        // Don't keep entries for bad expressions
+        lock.lock();
+        cache.release(e, true);
+        throw;
+    }
+
+    lock.lock();
+    e->pred = pred;
+    e->parsed = true;
+    cache.release(e);
+    return pred;
+}
+
+size_t PredicateCache::getHitCount() const
+{
+    lock_t lock(mutex);
+    return nHits;
+}
+
+size_t PredicateCache::getMissCount() const
+{
+    lock_t lock(mutex);
+    return nMisses;
+}
+
+PredicateCache & PredicateCache::getGlobal()
+{
+    static PredicateCache cache(GLOBAL_CACHE_SIZE);
+    return cache;
+}
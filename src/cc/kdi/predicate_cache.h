@@ -0,0 +1,81 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#ifndef KDI_PREDICATE_CACHE_H
+#define KDI_PREDICATE_CACHE_H
+
+#include <kdi/scan_predicate.h>
+#include <warp/lru_cache.h>
+#include <warp/string_range.h>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <string>
+
+namespace kdi {
+
+    class PredicateCache;
+
+} // namespace kdi
+
+//----------------------------------------------------------------------------
+// PredicateCache
+//----------------------------------------------------------------------------
+/// LRU cache of parsed ScanPredicates keyed by expression string.
+/// Clients tend to issue the same few predicate expressions over and
+/// over, and parsing them is much more expensive than copying the
+/// result.  The cache is thread-safe.
+class kdi::PredicateCache
+    : private boost::noncopyable
+{
+    struct Entry
+    {
+        ScanPredicate pred;
+        bool parsed;
+
+        Entry() : parsed(false) {}
+    };
+
+    typedef warp::LruCache<std::string, Entry> cache_t;
+    typedef boost::mutex mutex_t;
+    typedef mutex_t::scoped_lock lock_t;
+
+    cache_t cache;
+    size_t nHits;
+    size_t nMisses;
+    mutable mutex_t mutex;
+
+public:
+    /// Create a cache holding up to maxEntries predicates.
+    explicit PredicateCache(size_t maxEntries);
+    ~PredicateCache();
+
+    /// Get the parsed predicate for an expression, parsing it if it
+    /// isn't in the cache.
+    /// @throws ValueError if the expression cannot be parsed
+    ScanPredicate get(warp::strref_t expr);
+
+    size_t getHitCount() const;
+    size_t getMissCount() const;
+
+    /// Get the cache shared by the process.
+    static PredicateCache & getGlobal();
+};
+
+#endif // KDI_PREDICATE_CACHE_H
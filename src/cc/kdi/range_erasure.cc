@@ -0,0 +1,191 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <kdi/range_erasure.h>
+#include <ex/exception.h>
+#include <algorithm>
+
+using namespace kdi;
+using namespace warp;
+using namespace ex;
+using namespace std;
+
+namespace
+{
+    /// Order range erasures by their first row.
+    struct FirstRowLt
+    {
+        bool operator()(Cell const & a, Cell const & b) const
+        {
+            return a.getRow() < b.getRow();
+        }
+    };
+
+    /// Return true if the end of the range erasure comes at or
+    /// before the given row.
+    inline bool endsBefore(Cell const & erasure, strref_t row)
+    {
+        StringRange end = erasure.getValue();
+        return !end.empty() && end <= row;
+    }
+}
+
+//----------------------------------------------------------------------------
+// RangeErasureFilter
+//----------------------------------------------------------------------------
+RangeErasureFilter::RangeErasureFilter(vector<Cell> const & erasures)
+{
+    setErasures(erasures);
+}
+
+void RangeErasureFilter::setErasures(vector<Cell> const & erasures)
+{
+    // Erasures are activated again from the start on the next cell,
+    // so the filter doesn't need to know where the scan is
+    pending = erasures;
+    std::sort(pending.begin(), pending.end(), FirstRowLt());
+    nextPending = pending.begin();
+    active.clear();
+}
+
+bool RangeErasureFilter::isCovered(Cell const & x)
+{
+    StringRange row = x.getRow();
+
+    // Activate erasures starting at or before this row
+    for(; nextPending != pending.end() &&
+            nextPending->getRow() <= row; ++nextPending)
+    {
+        active.push_back(*nextPending);
+    }
+
+    bool covered = false;
+    for(size_t i = 0; i < active.size(); )
+    {
+        if(endsBefore(active[i], row))
+        {
+            // The scan has passed this erasure
+            active[i] = active.back();
+            active.pop_back();
+            continue;
+        }
+        if(!covered && rangeErasureCovers(active[i], x))
+            covered = true;
+        ++i;
+    }
+    return covered;
+}
+
+void RangeErasureFilter::pipeFrom(CellStreamPtr const & input)
+{
+    this->input = input;
+}
+
+bool RangeErasureFilter::get(Cell & x)
+{
+    if(!input)
+        return false;
+
+    while(input->get(x))
+    {
+        if(!isCovered(x))
+            return true;
+    }
+    return false;
+}
+
+
+//----------------------------------------------------------------------------
+// Functions
+//----------------------------------------------------------------------------
+Interval<string> kdi::getRangeErasureRows(Cell const & erasure)
+{
+    Interval<string> rows;
+    rows.setLowerBound(erasure.getRow().toString(), BT_INCLUSIVE);
+
+    StringRange end = erasure.getValue();
+    if(end.empty())
+        rows.unsetUpperBound();
+    else
+        rows.setUpperBound(end.toString(), BT_EXCLUSIVE);
+    return rows;
+}
+
+bool kdi::rangeErasureCovers(Cell const & erasure, Cell const & x)
+{
+    if(erasure.getTimestamp() < x.getTimestamp())
+        return false;
+
+    StringRange row = x.getRow();
+    if(row < erasure.getRow() || endsBefore(erasure, row))
+        return false;
+
+    return erasure.getErasureKind() == ERASE_ROWS ||
+        x.getColumnFamily() == erasure.getColumn();
+}
+
+Cell kdi::clipRangeErasure(Cell const & erasure,
+                           Interval<string> const & rows)
+{
+    Interval<string> clipped = getRangeErasureRows(erasure);
+    if(!clipped.overlaps(rows))
+        return Cell();
+    if(rows.contains(clipped))
+        return erasure;
+
+    // Only row range erasures can span more than one row
+    string firstRow, endRow;
+    getRowRange(clipped.clip(rows), firstRow, endRow);
+    return makeRowRangeErasure(firstRow, endRow, erasure.getTimestamp());
+}
+
+bool kdi::getRowRange(Interval<string> const & rows,
+                      string & firstRow, string & endRow)
+{
+    IntervalPoint<string> const & lo = rows.getLowerBound();
+    IntervalPoint<string> const & hi = rows.getUpperBound();
+
+    firstRow.clear();
+    if(lo.isFinite())
+    {
+        firstRow = lo.getValue();
+        if(lo.isExclusive())
+            firstRow += '\0';
+    }
+
+    endRow.clear();
+    if(hi.isFinite())
+    {
+        endRow = hi.getValue();
+        if(hi.isInclusive())
+            endRow += '\0';
+
+        // An empty end row would mean no upper bound
+        if(endRow <= firstRow)
+            return false;
+    }
+    return true;
+}
+
+CellStreamPtr kdi::makeRangeErasureFilter(vector<Cell> const & erasures)
+{
+    CellStreamPtr p(new RangeErasureFilter(erasures));
+    return p;
+}
@@ -0,0 +1,88 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#ifndef KDI_RANGE_ERASURE_H
+#define KDI_RANGE_ERASURE_H
+
+#include <kdi/cell.h>
+#include <warp/interval.h>
+#include <boost/shared_ptr.hpp>
+#include <string>
+#include <vector>
+
+namespace kdi {
+
+    class RangeErasureFilter;
+
+    typedef boost::shared_ptr<RangeErasureFilter> RangeErasureFilterPtr;
+
+    /// Get the rows covered by a range erasure.
+    warp::Interval<std::string> getRangeErasureRows(Cell const & erasure);
+
+    /// Return true if the range erasure hides the given Cell.
+    bool rangeErasureCovers(Cell const & erasure, Cell const & x);
+
+    /// Clip a range erasure to the given rows.  Returns a null Cell
+    /// if the erasure doesn't overlap the rows.
+    Cell clipRangeErasure(Cell const & erasure,
+                          warp::Interval<std::string> const & rows);
+
+    /// Convert a row interval to the [firstRow, endRow) form used by
+    /// range erasures, where an empty endRow has no upper bound.
+    /// Returns false if the interval contains no rows.
+    bool getRowRange(warp::Interval<std::string> const & rows,
+                     std::string & firstRow, std::string & endRow);
+
+    /// Make a CellStream filter that drops the cells hidden by any of
+    /// the given range erasures.  The input must be in cell order.
+    CellStreamPtr makeRangeErasureFilter(std::vector<Cell> const & erasures);
+
+} // namespace kdi
+
+//----------------------------------------------------------------------------
+// RangeErasureFilter
+//----------------------------------------------------------------------------
+/// Filter that drops cells hidden by a set of range erasures.  The
+/// erasures are sorted by first row and become active as the scan
+/// reaches them.  Active erasures are retired once the scan passes
+/// their end row, so the per-cell cost is proportional to the number
+/// of erasures overlapping the current row.
+class kdi::RangeErasureFilter
+    : public kdi::CellStream
+{
+    CellStreamPtr input;
+    std::vector<Cell> pending;
+    std::vector<Cell>::const_iterator nextPending;
+    std::vector<Cell> active;
+
+    bool isCovered(Cell const & x);
+
+public:
+    explicit RangeErasureFilter(std::vector<Cell> const & erasures);
+
+    /// Replace the erasure set.  This may be done in the middle of a
+    /// scan.  The new erasures apply starting with the next cell.
+    void setErasures(std::vector<Cell> const & erasures);
+
+    void pipeFrom(CellStreamPtr const & input);
+    bool get(Cell & x);
+};
+
+#endif // KDI_RANGE_ERASURE_H
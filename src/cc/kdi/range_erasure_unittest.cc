@@ -0,0 +1,183 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <kdi/range_erasure.h>
+#include <kdi/memory_table.h>
+#include <kdi/table_unittest.h>
+#include <warp/interval.h>
+#include <unittest/main.h>
+#include <string>
+#include <vector>
+
+using namespace kdi;
+using namespace kdi::unittest;
+using namespace warp;
+using namespace std;
+
+namespace
+{
+    /// Make an unfiltered table holding a few cells in two rows
+    TablePtr makeSmallTable()
+    {
+        TablePtr t = MemoryTable::create(false);
+        t->set("a", "f:1", 1, "a-f1-1");
+        t->set("a", "f:1", 3, "a-f1-3");
+        t->set("a", "g:1", 1, "a-g1-1");
+        t->set("b", "f:1", 2, "b-f1-2");
+        t->set("c", "f:1", 1, "c-f1-1");
+        return t;
+    }
+
+    Interval<string> makeRows(string const & lo, string const & hi)
+    {
+        return Interval<string>().setLowerBound(lo, BT_INCLUSIVE)
+            .setUpperBound(hi, BT_EXCLUSIVE);
+    }
+}
+
+BOOST_AUTO_UNIT_TEST(covers_test)
+{
+    Cell rows = makeRowRangeErasure("b", "d", 5);
+    Cell open = makeRowRangeErasure("b", "", 5);
+    Cell fam = makeFamilyErasure("b", "f", 5);
+
+    // Row bounds: first row inclusive, end row exclusive
+    BOOST_CHECK(!rangeErasureCovers(rows, makeCell("a", "f:1", 1, "")));
+    BOOST_CHECK(rangeErasureCovers(rows, makeCell("b", "f:1", 1, "")));
+    BOOST_CHECK(rangeErasureCovers(rows, makeCell("c", "x", 1, "")));
+    BOOST_CHECK(!rangeErasureCovers(rows, makeCell("d", "f:1", 1, "")));
+    BOOST_CHECK(rangeErasureCovers(open, makeCell("zzz", "f:1", 1, "")));
+
+    // Timestamps: only cells at or before the erasure
+    BOOST_CHECK(rangeErasureCovers(rows, makeCell("b", "f:1", 5, "")));
+    BOOST_CHECK(!rangeErasureCovers(rows, makeCell("b", "f:1", 6, "")));
+
+    // Families: only the named family of the one row
+    BOOST_CHECK(rangeErasureCovers(fam, makeCell("b", "f:1", 1, "")));
+    BOOST_CHECK(!rangeErasureCovers(fam, makeCell("b", "g:1", 1, "")));
+    BOOST_CHECK(!rangeErasureCovers(fam, makeCell("b", "ff:1", 1, "")));
+    BOOST_CHECK(!rangeErasureCovers(fam, makeCell("ba", "f:1", 1, "")));
+    BOOST_CHECK(!rangeErasureCovers(fam, makeCell("b", "f:1", 6, "")));
+}
+
+BOOST_AUTO_UNIT_TEST(clip_test)
+{
+    Cell e = makeRowRangeErasure("b", "", 5);
+
+    // Fully contained: unchanged
+    Cell x = clipRangeErasure(e, Interval<string>().setInfinite());
+    BOOST_CHECK(x == e);
+
+    // Partial overlap
+    x = clipRangeErasure(e, makeRows("a", "c"));
+    BOOST_CHECK_EQUAL(x.getErasureKind(), ERASE_ROWS);
+    BOOST_CHECK_EQUAL(x.getRow(), "b");
+    BOOST_CHECK_EQUAL(x.getValue(), "c");
+    BOOST_CHECK_EQUAL(x.getTimestamp(), 5);
+
+    x = clipRangeErasure(e, makeRows("c", "d"));
+    BOOST_CHECK_EQUAL(x.getRow(), "c");
+    BOOST_CHECK_EQUAL(x.getValue(), "d");
+
+    // No overlap
+    x = clipRangeErasure(makeRowRangeErasure("b", "c", 5),
+                         makeRows("c", "d"));
+    BOOST_CHECK(!x);
+}
+
+BOOST_AUTO_UNIT_TEST(row_range_test)
+{
+    string first, end;
+
+    BOOST_CHECK(getRowRange(Interval<string>().setInfinite(), first, end));
+    BOOST_CHECK_EQUAL(first, "");
+    BOOST_CHECK_EQUAL(end, "");
+
+    BOOST_CHECK(getRowRange(makeRows("a", "c"), first, end));
+    BOOST_CHECK_EQUAL(first, "a");
+    BOOST_CHECK_EQUAL(end, "c");
+
+    // Exclusive lower and inclusive upper bounds move to the next row
+    BOOST_CHECK(getRowRange(
+                    Interval<string>().setLowerBound("a", BT_EXCLUSIVE)
+                    .setUpperBound("c", BT_INCLUSIVE),
+                    first, end));
+    BOOST_CHECK_EQUAL(first, string("a\0", 2));
+    BOOST_CHECK_EQUAL(end, string("c\0", 2));
+
+    // Point
+    BOOST_CHECK(getRowRange(Interval<string>().setPoint("b"), first, end));
+    BOOST_CHECK_EQUAL(first, "b");
+    BOOST_CHECK_EQUAL(end, string("b\0", 2));
+
+    // Empty
+    BOOST_CHECK(!getRowRange(makeRows("c", "a"), first, end));
+}
+
+BOOST_AUTO_UNIT_TEST(filter_test)
+{
+    test_out_t out;
+    TablePtr t = makeSmallTable();
+
+    // No erasures
+    {
+        CellStreamPtr s = makeRangeErasureFilter(vector<Cell>());
+        s->pipeFrom(t->scan());
+        BOOST_CHECK_EQUAL(countCells(s), 5u);
+    }
+
+    // Overlapping erasures of both kinds
+    {
+        vector<Cell> e;
+        e.push_back(makeRowRangeErasure("b", "c", 9));
+        e.push_back(makeFamilyErasure("a", "f", 2));
+        CellStreamPtr s = makeRangeErasureFilter(e);
+        s->pipeFrom(t->scan());
+        BOOST_CHECK((out << *s).is_equal(
+                        "(a,f:1,3,a-f1-3)"
+                        "(a,g:1,1,a-g1-1)"
+                        "(c,f:1,1,c-f1-1)"
+                        ));
+    }
+}
+
+BOOST_AUTO_UNIT_TEST(set_erasures_test)
+{
+    test_out_t out;
+    TablePtr t = makeSmallTable();
+
+    vector<Cell> e;
+    e.push_back(makeRowRangeErasure("", "", 1));
+    RangeErasureFilterPtr f(new RangeErasureFilter(e));
+    f->pipeFrom(t->scan());
+
+    Cell x;
+    BOOST_REQUIRE(f->get(x));
+    BOOST_CHECK_EQUAL(x.getValue(), "a-f1-3");
+
+    // Replace the erasures mid-scan.  The new set applies from the
+    // next cell, including erasures starting before the current row.
+    e.clear();
+    e.push_back(makeRowRangeErasure("a", "c", 2));
+    f->setErasures(e);
+    BOOST_CHECK((out << *f).is_equal(
+                    "(c,f:1,1,c-f1-1)"
+                    ));
+}
@@ -0,0 +1,223 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <kdi/retention_policy.h>
+#include <warp/config.h>
+#include <boost/format.hpp>
+#include <limits>
+
+using namespace kdi;
+using namespace warp;
+using namespace std;
+using boost::format;
+
+//----------------------------------------------------------------------------
+// RetentionFilter
+//----------------------------------------------------------------------------
+namespace
+{
+    class RetentionFilter : public CellStream
+    {
+        CellStreamPtr input;
+        RetentionPolicy policy;
+        int64_t now;
+
+        // State for the current (row, column) history sequence
+        Cell last;
+        RetentionPolicy::Limits const * limits;
+        int64_t minTimestamp;
+        size_t nVersions;
+
+        void startSequence(Cell const & x)
+        {
+            if(policy.hasFamilyLimits())
+                limits = &policy.getLimits(x.getColumnFamily());
+            else
+                limits = &policy.getDefaultLimits();
+
+            minTimestamp = limits->getMinTimestamp(now);
+            nVersions = 0;
+        }
+
+    public:
+        RetentionFilter(RetentionPolicy const & policy, int64_t now) :
+            policy(policy), now(now), limits(0)
+        {
+        }
+
+        void pipeFrom(CellStreamPtr const & input)
+        {
+            this->input = input;
+            last.release();
+        }
+
+        bool get(Cell & x)
+        {
+            if(!input)
+                return false;
+
+            while(input->get(x))
+            {
+                // See if it starts a new history sequence
+                if(!last ||
+                   last.getRow() != x.getRow() ||
+                   last.getColumn() != x.getColumn())
+                {
+                    startSequence(x);
+                }
+                last = x;
+
+                // Erasures must still hide older cells elsewhere, and
+                // merge operands aren't versions until they're folded
+                if(x.isErasure() || x.isMergeOperand())
+                    return true;
+
+                // Versions come newest first, so once one is too old
+                // the rest of the sequence is too
+                if(x.getTimestamp() < minTimestamp)
+                    continue;
+
+                if(limits->maxVersions && ++nVersions > limits->maxVersions)
+                    continue;
+
+                return true;
+            }
+            return false;
+        }
+    };
+}
+
+//----------------------------------------------------------------------------
+// RetentionPolicy
+//----------------------------------------------------------------------------
+int64_t RetentionPolicy::Limits::getMinTimestamp(int64_t now) const
+{
+    if(!maxAge)
+        return std::numeric_limits<int64_t>::min();
+
+    // Cell timestamps are in microseconds
+    return now - maxAge * 1000000;
+}
+
+RetentionPolicy::Limits const &
+RetentionPolicy::getLimits(strref_t family) const
+{
+    family_map::const_iterator i = familyLimits.find(family.toString());
+    if(i != familyLimits.end())
+        return i->second;
+    return defaultLimits;
+}
+
+bool RetentionPolicy::isUnlimited() const
+{
+    if(!defaultLimits.isUnlimited())
+        return false;
+
+    for(family_map::const_iterator i = familyLimits.begin();
+        i != familyLimits.end(); ++i)
+    {
+        if(!i->second.isUnlimited())
+            return false;
+    }
+    return true;
+}
+
+RetentionPolicy RetentionPolicy::withoutVersionLimits() const
+{
+    RetentionPolicy r(*this);
+    r.defaultLimits.maxVersions = 0;
+    for(family_map::iterator i = r.familyLimits.begin();
+        i != r.familyLimits.end(); ++i)
+    {
+        i->second.maxVersions = 0;
+    }
+    return r;
+}
+
+void RetentionPolicy::load(Config const & cfg)
+{
+    defaultLimits = Limits(cfg.getAs<size_t>("maxVersions", 0),
+                           cfg.getAs<int64_t>("maxAge", 0));
+
+    familyLimits.clear();
+    if(Config const * n = cfg.findChild("families"))
+    {
+        for(size_t i = 0; i < n->numChildren(); ++i)
+        {
+            Config const & f = n->getChild(i);
+            setFamilyLimits(f.get("name"),
+                            Limits(f.getAs<size_t>("maxVersions", 0),
+                                   f.getAs<int64_t>("maxAge", 0)));
+        }
+    }
+}
+
+void RetentionPolicy::save(Config & cfg, string const & key) const
+{
+    if(defaultLimits.maxVersions)
+        cfg.set(key + ".maxVersions",
+                str(format("%d") % defaultLimits.maxVersions));
+    if(defaultLimits.maxAge)
+        cfg.set(key + ".maxAge", str(format("%d") % defaultLimits.maxAge));
+
+    size_t idx = 0;
+    for(family_map::const_iterator i = familyLimits.begin();
+        i != familyLimits.end(); ++i, ++idx)
+    {
+        string base = str(format("%s.families.i%d") % key % idx);
+        cfg.set(base + ".name", i->first);
+        cfg.set(base + ".maxVersions",
+                str(format("%d") % i->second.maxVersions));
+        cfg.set(base + ".maxAge", str(format("%d") % i->second.maxAge));
+    }
+}
+
+bool RetentionPolicy::operator==(RetentionPolicy const & o) const
+{
+    if(defaultLimits.maxVersions != o.defaultLimits.maxVersions ||
+       defaultLimits.maxAge != o.defaultLimits.maxAge ||
+       familyLimits.size() != o.familyLimits.size())
+    {
+        return false;
+    }
+
+    for(family_map::const_iterator i = familyLimits.begin(),
+            j = o.familyLimits.begin(); i != familyLimits.end(); ++i, ++j)
+    {
+        if(i->first != j->first ||
+           i->second.maxVersions != j->second.maxVersions ||
+           i->second.maxAge != j->second.maxAge)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+//----------------------------------------------------------------------------
+// Functions
+//----------------------------------------------------------------------------
+CellStreamPtr kdi::makeRetentionFilter(RetentionPolicy const & policy,
+                                       int64_t now)
+{
+    CellStreamPtr p(new RetentionFilter(policy, now));
+    return p;
+}
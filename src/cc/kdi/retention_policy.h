@@ -0,0 +1,134 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#ifndef KDI_RETENTION_POLICY_H
+#define KDI_RETENTION_POLICY_H
+
+#include <kdi/cell.h>
+#include <kdi/strref.h>
+#include <string>
+#include <map>
+#include <stdint.h>
+
+namespace warp { class Config; }
+
+namespace kdi {
+
+    class RetentionPolicy;
+
+    /// Make a CellStream filter that drops the cells the policy no
+    /// longer keeps as of time \c now (in microseconds, like Cell
+    /// timestamps).  Cell erasures and merge operands are passed
+    /// through and don't count as versions.  The input must be in
+    /// cell order.
+    CellStreamPtr makeRetentionFilter(RetentionPolicy const & policy,
+                                      int64_t now);
+
+} // namespace kdi
+
+//----------------------------------------------------------------------------
+// RetentionPolicy
+//----------------------------------------------------------------------------
+/// Garbage collection limits for a table.  A policy has default
+/// limits for all columns, and may override them for individual
+/// column families.  Cells past a limit are dropped when fragments
+/// are compacted, and are hidden from scans until then.
+///
+/// In a Config, a policy looks like:
+///    maxVersions = 3
+///    maxAge = 86400
+///    families.i0.name = anchor
+///    families.i0.maxVersions = 1
+///
+/// The maxAge limit is in seconds.  Zero (or a missing key) means no
+/// limit.
+class kdi::RetentionPolicy
+{
+public:
+    struct Limits
+    {
+        /// Keep at most this many of the newest versions of a cell
+        size_t maxVersions;
+
+        /// Keep versions at most this many seconds old
+        int64_t maxAge;
+
+        Limits() : maxVersions(0), maxAge(0) {}
+        Limits(size_t maxVersions, int64_t maxAge) :
+            maxVersions(maxVersions), maxAge(maxAge) {}
+
+        bool isUnlimited() const { return !maxVersions && !maxAge; }
+
+        /// Get the oldest timestamp kept as of time \c now.
+        int64_t getMinTimestamp(int64_t now) const;
+    };
+
+private:
+    typedef std::map<std::string, Limits> family_map;
+
+    Limits defaultLimits;
+    family_map familyLimits;
+
+public:
+    /// Set the limits for columns without a family override.
+    void setDefaultLimits(Limits const & limits)
+    {
+        defaultLimits = limits;
+    }
+
+    /// Override the default limits for a column family.
+    void setFamilyLimits(strref_t family, Limits const & limits)
+    {
+        familyLimits[family.toString()] = limits;
+    }
+
+    /// Get the limits that apply to a column family.
+    Limits const & getLimits(strref_t family) const;
+
+    Limits const & getDefaultLimits() const { return defaultLimits; }
+
+    /// True if the policy has any per-family limits.
+    bool hasFamilyLimits() const { return !familyLimits.empty(); }
+
+    /// True if the policy never drops anything.
+    bool isUnlimited() const;
+
+    /// Get a copy of the policy with only its age limits.  Version
+    /// limits depend on every version of a cell, so only compactions
+    /// that see all of a cell's history may apply them.  Age limits
+    /// are safe to apply to any subset of the history.
+    RetentionPolicy withoutVersionLimits() const;
+
+    /// Load a policy from a Config node.  Missing keys leave the
+    /// policy unlimited.
+    void load(warp::Config const & cfg);
+
+    /// Save the policy as children of the given Config key.  Nothing
+    /// is written for an unlimited policy.
+    void save(warp::Config & cfg, std::string const & key) const;
+
+    bool operator==(RetentionPolicy const & o) const;
+    bool operator!=(RetentionPolicy const & o) const
+    {
+        return !(*this == o);
+    }
+};
+
+#endif // KDI_RETENTION_POLICY_H
@@ -0,0 +1,175 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <kdi/retention_policy.h>
+#include <kdi/memory_table.h>
+#include <kdi/table_unittest.h>
+#include <warp/config.h>
+#include <unittest/main.h>
+#include <string>
+
+using namespace kdi;
+using namespace kdi::unittest;
+using namespace warp;
+using namespace std;
+
+namespace
+{
+    typedef RetentionPolicy::Limits Limits;
+
+    int64_t const SECOND = 1000000;
+
+    /// Filter a scan of the table as of 100 seconds
+    CellStreamPtr filterScan(TablePtr const & t,
+                             RetentionPolicy const & policy)
+    {
+        CellStreamPtr s = makeRetentionFilter(policy, 100 * SECOND);
+        s->pipeFrom(t->scan());
+        return s;
+    }
+}
+
+BOOST_AUTO_UNIT_TEST(max_versions_test)
+{
+    test_out_t out;
+
+    TablePtr t = MemoryTable::create(false);
+    t->set("a", "f:1", 1, "a1");
+    t->set("a", "f:1", 2, "a2");
+    t->set("a", "f:1", 3, "a3");
+    t->erase("a", "f:1", 4);
+    t->set("a", "f:2", 1, "b1");
+    t->set("b", "f:1", 1, "c1");
+    t->set("b", "f:1", 2, "c2");
+
+    RetentionPolicy policy;
+    BOOST_CHECK(policy.isUnlimited());
+    BOOST_CHECK_EQUAL(countCells(filterScan(t, policy)), 7u);
+
+    // Erasures pass through and don't count as versions
+    policy.setDefaultLimits(Limits(2, 0));
+    BOOST_CHECK(!policy.isUnlimited());
+    BOOST_CHECK((out << *filterScan(t, policy)).is_equal(
+                    "(a,f:1,4,ERASED)"
+                    "(a,f:1,3,a3)"
+                    "(a,f:1,2,a2)"
+                    "(a,f:2,1,b1)"
+                    "(b,f:1,2,c2)"
+                    "(b,f:1,1,c1)"
+                    ));
+}
+
+BOOST_AUTO_UNIT_TEST(max_age_test)
+{
+    test_out_t out;
+
+    TablePtr t = MemoryTable::create(false);
+    t->set("a", "f:1", 95 * SECOND, "new");
+    t->set("a", "f:1", 89 * SECOND, "old");
+    t->set("a", "g:1", 50 * SECOND, "ancient");
+    t->erase("a", "g:1", 10 * SECOND);
+
+    // Keep ten seconds of history
+    RetentionPolicy policy;
+    policy.setDefaultLimits(Limits(0, 10));
+    BOOST_CHECK((out << *filterScan(t, policy)).is_equal(
+                    "(a,f:1,95000000,new)"
+                    "(a,g:1,10000000,ERASED)"
+                    ));
+}
+
+BOOST_AUTO_UNIT_TEST(family_test)
+{
+    test_out_t out;
+
+    TablePtr t = MemoryTable::create(false);
+    t->set("a", "f:1", 1, "f1");
+    t->set("a", "f:1", 2, "f2");
+    t->set("a", "g:1", 1, "g1");
+    t->set("a", "g:1", 2, "g2");
+    t->set("a", "h", 1, "h1");
+    t->set("a", "h", 2, "h2");
+
+    // Only one version in family 'g', unlimited otherwise
+    RetentionPolicy policy;
+    policy.setFamilyLimits("g", Limits(1, 0));
+    BOOST_CHECK((out << *filterScan(t, policy)).is_equal(
+                    "(a,f:1,2,f2)"
+                    "(a,f:1,1,f1)"
+                    "(a,g:1,2,g2)"
+                    "(a,h,2,h2)"
+                    "(a,h,1,h1)"
+                    ));
+
+    // Override a default limit with no limit in family 'f'
+    policy.setDefaultLimits(Limits(1, 0));
+    policy.setFamilyLimits("f", Limits());
+    BOOST_CHECK((out << *filterScan(t, policy)).is_equal(
+                    "(a,f:1,2,f2)"
+                    "(a,f:1,1,f1)"
+                    "(a,g:1,2,g2)"
+                    "(a,h,2,h2)"
+                    ));
+}
+
+BOOST_AUTO_UNIT_TEST(config_test)
+{
+    RetentionPolicy policy;
+    policy.setDefaultLimits(Limits(3, 86400));
+    policy.setFamilyLimits("a", Limits(1, 0));
+    policy.setFamilyLimits("b", Limits(0, 60));
+
+    Config cfg;
+    policy.save(cfg, "retention");
+    BOOST_CHECK_EQUAL(cfg.get("retention.maxVersions"), "3");
+    BOOST_CHECK_EQUAL(cfg.get("retention.maxAge"), "86400");
+
+    RetentionPolicy loaded;
+    loaded.load(cfg.getChild("retention"));
+    BOOST_CHECK(loaded == policy);
+    BOOST_CHECK_EQUAL(loaded.getLimits("a").maxVersions, 1u);
+    BOOST_CHECK_EQUAL(loaded.getLimits("b").maxAge, 60);
+    BOOST_CHECK_EQUAL(loaded.getLimits("c").maxVersions, 3u);
+
+    // Unlimited policies save nothing
+    Config empty;
+    RetentionPolicy().save(empty, "retention");
+    BOOST_CHECK(!empty.findChild("retention"));
+}
+
+BOOST_AUTO_UNIT_TEST(without_version_limits_test)
+{
+    RetentionPolicy policy;
+    policy.setDefaultLimits(Limits(3, 86400));
+    policy.setFamilyLimits("a", Limits(1, 0));
+    policy.setFamilyLimits("b", Limits(2, 60));
+
+    RetentionPolicy age = policy.withoutVersionLimits();
+    BOOST_CHECK_EQUAL(age.getDefaultLimits().maxVersions, 0u);
+    BOOST_CHECK_EQUAL(age.getDefaultLimits().maxAge, 86400);
+    BOOST_CHECK(age.getLimits("a").isUnlimited());
+    BOOST_CHECK_EQUAL(age.getLimits("b").maxVersions, 0u);
+    BOOST_CHECK_EQUAL(age.getLimits("b").maxAge, 60);
+
+    // Version-only policies become unlimited
+    RetentionPolicy versions;
+    versions.setDefaultLimits(Limits(1, 0));
+    BOOST_CHECK(versions.withoutVersionLimits().isUnlimited());
+}
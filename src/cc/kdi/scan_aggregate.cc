@@ -0,0 +1,426 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <kdi/scan_aggregate.h>
+#include <warp/tuple_encode.h>
+#include <warp/hsieh_hash.h>
+#include <warp/strutil.h>
+#include <ex/exception.h>
+#include <boost/format.hpp>
+#include <algorithm>
+
+using namespace kdi;
+using namespace warp;
+using namespace ex;
+using namespace std;
+using boost::format;
+
+namespace {
+
+    enum {
+        F_SPEC,
+        F_CELLS,
+        F_ROWS,
+        F_ROW_BYTES,
+        F_COLUMN_BYTES,
+        F_VALUE_BYTES,
+        F_FAMILIES,
+        F_COLUMNS,
+        F_SAMPLES,
+        F_LAST_ROW,
+        N_FIELDS
+    };
+
+    /// Spread hash bits over the whole range.  The estimates depend
+    /// on the smallest hashes being uniform, and similar short strings
+    /// don't hash uniformly enough on their own.
+    uint32_t mix(uint32_t h)
+    {
+        h ^= h >> 16;
+        h *= 0x85ebca6b;
+        h ^= h >> 13;
+        h *= 0xc2b2ae35;
+        h ^= h >> 16;
+        return h;
+    }
+
+    uint32_t hashColumn(strref_t col)
+    {
+        return mix(hsieh_hash(col.begin(), col.end()));
+    }
+
+    size_t sampleSize(Cell const & x)
+    {
+        return ( x.getRow().size() + x.getColumn().size() +
+                 x.getValue().size() );
+    }
+
+    uint32_t hashKey(Cell const & x)
+    {
+        strref_t row = x.getRow();
+        strref_t col = x.getColumn();
+        uint64_t ts = x.getTimestamp();
+
+        // Hash the timestamp in a fixed byte order so encoded samples
+        // merge the same way on any host
+        unsigned char tsBytes[8];
+        for(int i = 7; i >= 0; --i, ts >>= 8)
+            tsBytes[i] = static_cast<unsigned char>(ts);
+
+        uint32_t h = hsieh_hash(row.begin(), row.end());
+        h = hsieh_hash(col.begin(), col.size(), h);
+        return mix(hsieh_hash(tsBytes, sizeof(tsBytes), h));
+    }
+
+    string toString(uint64_t x)
+    {
+        return (format("%d") % x).str();
+    }
+
+    size_t parseCount(strref_t opt, strref_t arg)
+    {
+        size_t n;
+        if(!parseInt(n, arg) || !n)
+            raise<ValueError>("%s needs a positive count: %s", opt, arg);
+        return n;
+    }
+}
+
+
+//----------------------------------------------------------------------------
+// ScanAggregate
+//----------------------------------------------------------------------------
+ScanAggregate::ScanAggregate(std::string const & spec) :
+    spec(spec),
+    wantFamilies(false),
+    wantColumns(false),
+    reservoirSize(0),
+    everyN(0),
+    nCells(0),
+    nRows(0),
+    rowBytes(0),
+    columnBytes(0),
+    valueBytes(0),
+    sampleBytes(0),
+    haveLastRow(false),
+    skipCount(0),
+    lastRowPartial(false)
+{
+    char const * p = spec.c_str();
+    char const * end = p + spec.size();
+    while(p != end)
+    {
+        char const * next = std::find(p, end, ',');
+        char const * eq = std::find(p, next, '=');
+        StringRange opt(p, eq);
+        StringRange arg(eq == next ? next : eq + 1, next);
+
+        if(opt == "families" && eq == next)
+            wantFamilies = true;
+        else if(opt == "columns" && eq == next)
+            wantColumns = true;
+        else if(opt == "reservoir")
+            reservoirSize = parseCount(opt, arg);
+        else if(opt == "every")
+            everyN = parseCount(opt, arg);
+        else if(opt)
+            raise<ValueError>("unknown aggregate option: %s",
+                              StringRange(p, next));
+
+        p = (next == end ? end : next + 1);
+    }
+
+    if(reservoirSize && everyN)
+        raise<ValueError>("aggregate can't have both a reservoir and "
+                          "every-Nth sampling: %s", spec);
+}
+
+void ScanAggregate::addSample(uint32_t hash, Cell const & x)
+{
+    // The reservoir is a max-heap on (hash, cell)
+    sample_t s(hash, x);
+    if(samples.size() < reservoirSize)
+    {
+        samples.push_back(s);
+        std::push_heap(samples.begin(), samples.end());
+        sampleBytes += sampleSize(x);
+    }
+    else if(s < samples.front())
+    {
+        std::pop_heap(samples.begin(), samples.end());
+        sampleBytes -= sampleSize(samples.back().second);
+        samples.back() = s;
+        std::push_heap(samples.begin(), samples.end());
+        sampleBytes += sampleSize(x);
+    }
+}
+
+void ScanAggregate::add(Cell const & x)
+{
+    strref_t row = x.getRow();
+    strref_t col = x.getColumn();
+    strref_t val = x.getValue();
+
+    ++nCells;
+    rowBytes += row.size();
+    columnBytes += col.size();
+    valueBytes += val.size();
+
+    if(!haveLastRow || row != lastRow)
+    {
+        ++nRows;
+        lastRow.assign(row.begin(), row.end());
+        haveLastRow = true;
+    }
+
+    if(wantFamilies)
+    {
+        strref_t fam = x.getColumnFamily();
+        FamilyCount & c = families[string(fam.begin(), fam.end())];
+        ++c.nCells;
+        c.nBytes += row.size() + col.size() + val.size();
+    }
+
+    if(wantColumns)
+    {
+        uint32_t h = hashColumn(col);
+        if(columnHashes.size() < MAX_COLUMN_HASHES)
+            columnHashes.insert(h);
+        else if(h < *columnHashes.rbegin() && columnHashes.insert(h).second)
+            columnHashes.erase(--columnHashes.end());
+    }
+
+    // Samples are copied so they don't pin the scan's buffers
+    if(reservoirSize)
+    {
+        uint32_t h = hashKey(x);
+        if(samples.size() < reservoirSize || h <= samples.front().first)
+            addSample(h, makeCell(row, col, x.getTimestamp(), val));
+    }
+    else if(everyN && ++skipCount >= everyN)
+    {
+        skipCount = 0;
+        samples.push_back(
+            sample_t(0, makeCell(row, col, x.getTimestamp(), val)));
+        sampleBytes += sampleSize(x);
+    }
+}
+
+void ScanAggregate::merge(ScanAggregate const & o)
+{
+    if(o.spec != spec)
+        raise<ValueError>("can't merge aggregates with different specs: "
+                          "'%s' and '%s'", spec, o.spec);
+
+    nCells += o.nCells;
+    nRows += o.nRows;
+    rowBytes += o.rowBytes;
+    columnBytes += o.columnBytes;
+    valueBytes += o.valueBytes;
+
+    for(family_map::const_iterator i = o.families.begin();
+        i != o.families.end(); ++i)
+    {
+        FamilyCount & c = families[i->first];
+        c.nCells += i->second.nCells;
+        c.nBytes += i->second.nBytes;
+    }
+
+    columnHashes.insert(o.columnHashes.begin(), o.columnHashes.end());
+    while(columnHashes.size() > MAX_COLUMN_HASHES)
+        columnHashes.erase(--columnHashes.end());
+
+    if(reservoirSize)
+    {
+        for(vector<sample_t>::const_iterator i = o.samples.begin();
+            i != o.samples.end(); ++i)
+        {
+            addSample(i->first, i->second);
+        }
+    }
+    else
+    {
+        samples.insert(samples.end(), o.samples.begin(), o.samples.end());
+        sampleBytes += o.sampleBytes;
+    }
+
+    if(o.haveLastRow && (!haveLastRow || !(o.lastRow < lastRow)))
+    {
+        lastRow = o.lastRow;
+        haveLastRow = true;
+        lastRowPartial = o.lastRowPartial;
+    }
+}
+
+void ScanAggregate::mergeEncoded(strref_t encoded)
+{
+    vector<string> fields;
+    decodeStringSequence(encoded, back_inserter(fields));
+    if(fields.size() != N_FIELDS)
+        raise<ValueError>("encoded aggregate has %d fields, expected %d",
+                          fields.size(), size_t(N_FIELDS));
+
+    ScanAggregate x(fields[F_SPEC]);
+    x.nCells = parseInt<uint64_t>(fields[F_CELLS]);
+    x.nRows = parseInt<uint64_t>(fields[F_ROWS]);
+    x.rowBytes = parseInt<uint64_t>(fields[F_ROW_BYTES]);
+    x.columnBytes = parseInt<uint64_t>(fields[F_COLUMN_BYTES]);
+    x.valueBytes = parseInt<uint64_t>(fields[F_VALUE_BYTES]);
+
+    vector<string> items;
+    decodeStringSequence(fields[F_FAMILIES], back_inserter(items));
+    if(items.size() % 3)
+        raise<ValueError>("bad family counts in encoded aggregate");
+    for(size_t i = 0; i < items.size(); i += 3)
+    {
+        FamilyCount & c = x.families[items[i]];
+        c.nCells = parseInt<uint64_t>(items[i+1]);
+        c.nBytes = parseInt<uint64_t>(items[i+2]);
+    }
+
+    items.clear();
+    decodeStringSequence(fields[F_COLUMNS], back_inserter(items));
+    for(size_t i = 0; i < items.size(); ++i)
+        x.columnHashes.insert(parseInt<uint32_t>(items[i]));
+
+    items.clear();
+    decodeStringSequence(fields[F_SAMPLES], back_inserter(items));
+    if(items.size() % 4)
+        raise<ValueError>("bad samples in encoded aggregate");
+    for(size_t i = 0; i < items.size(); i += 4)
+    {
+        Cell c = makeCell(items[i], items[i+1],
+                          parseInt<int64_t>(items[i+2]), items[i+3]);
+        x.samples.push_back(
+            sample_t(x.reservoirSize ? hashKey(c) : 0, c));
+    }
+    if(x.reservoirSize)
+        std::make_heap(x.samples.begin(), x.samples.end());
+    for(size_t i = 0; i < x.samples.size(); ++i)
+        x.sampleBytes += sampleSize(x.samples[i].second);
+
+    items.clear();
+    decodeStringSequence(fields[F_LAST_ROW], back_inserter(items));
+    if(items.size() > 2 || (items.size() == 2 && items[1] != "partial"))
+        raise<ValueError>("bad last row in encoded aggregate");
+    if(!items.empty())
+    {
+        x.lastRow = items[0];
+        x.haveLastRow = true;
+        x.lastRowPartial = (items.size() == 2);
+    }
+
+    merge(x);
+}
+
+void ScanAggregate::reset()
+{
+    nCells = 0;
+    nRows = 0;
+    rowBytes = 0;
+    columnBytes = 0;
+    valueBytes = 0;
+    families.clear();
+    columnHashes.clear();
+    samples.clear();
+    sampleBytes = 0;
+    lastRowPartial = false;
+}
+
+std::string ScanAggregate::encode() const
+{
+    vector<string> fields(N_FIELDS);
+    fields[F_SPEC] = spec;
+    fields[F_CELLS] = toString(nCells);
+    fields[F_ROWS] = toString(nRows);
+    fields[F_ROW_BYTES] = toString(rowBytes);
+    fields[F_COLUMN_BYTES] = toString(columnBytes);
+    fields[F_VALUE_BYTES] = toString(valueBytes);
+
+    vector<string> items;
+    for(family_map::const_iterator i = families.begin();
+        i != families.end(); ++i)
+    {
+        items.push_back(i->first);
+        items.push_back(toString(i->second.nCells));
+        items.push_back(toString(i->second.nBytes));
+    }
+    fields[F_FAMILIES] = encodeStringSequence(items);
+
+    items.clear();
+    for(set<uint32_t>::const_iterator i = columnHashes.begin();
+        i != columnHashes.end(); ++i)
+    {
+        items.push_back(toString(*i));
+    }
+    fields[F_COLUMNS] = encodeStringSequence(items);
+
+    // Put the reservoir in hash order so equal samples encode the
+    // same way
+    vector<sample_t> sorted(samples);
+    if(reservoirSize)
+        std::sort_heap(sorted.begin(), sorted.end());
+
+    items.clear();
+    for(vector<sample_t>::const_iterator i = sorted.begin();
+        i != sorted.end(); ++i)
+    {
+        Cell const & c = i->second;
+        items.push_back(str(c.getRow()));
+        items.push_back(str(c.getColumn()));
+        items.push_back((format("%d") % c.getTimestamp()).str());
+        items.push_back(str(c.getValue()));
+    }
+    fields[F_SAMPLES] = encodeStringSequence(items);
+
+    items.clear();
+    if(haveLastRow)
+    {
+        items.push_back(lastRow);
+        if(lastRowPartial)
+            items.push_back("partial");
+    }
+    fields[F_LAST_ROW] = encodeStringSequence(items);
+
+    return encodeStringSequence(fields);
+}
+
+uint64_t ScanAggregate::getColumnCount() const
+{
+    if(isColumnCountExact())
+        return columnHashes.size();
+
+    // With k of the smallest hashes, the kth one is about k/n of the
+    // way through the hash space
+    uint64_t kth = uint64_t(*columnHashes.rbegin()) + 1;
+    return (uint64_t(MAX_COLUMN_HASHES - 1) << 32) / kth;
+}
+
+void ScanAggregate::getSamples(std::vector<Cell> & out) const
+{
+    size_t first = out.size();
+    for(vector<sample_t>::const_iterator i = samples.begin();
+        i != samples.end(); ++i)
+    {
+        out.push_back(i->second);
+    }
+    if(reservoirSize)
+        std::sort(out.begin() + first, out.end());
+}
@@ -0,0 +1,174 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#ifndef KDI_SCAN_AGGREGATE_H
+#define KDI_SCAN_AGGREGATE_H
+
+#include <kdi/cell.h>
+#include <kdi/strref.h>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+namespace kdi {
+
+    class ScanAggregate;
+
+} // namespace kdi
+
+
+//----------------------------------------------------------------------------
+// ScanAggregate
+//----------------------------------------------------------------------------
+/// Summary statistics over a sequence of cells.  An aggregate can be
+/// computed next to the data (see Table::aggregate()), encoded, and
+/// merged with the aggregates of other parts of the scan, so only the
+/// summary has to travel.
+///
+/// Cell and row counts and row, column, and value byte totals are
+/// always kept.  The spec is a comma-separated list that turns on
+/// more:
+///
+///   families     -- cell count and bytes for each column family
+///   columns      -- estimated count of distinct columns
+///   reservoir=K  -- uniform sample of K cells
+///   every=N      -- every Nth cell
+///
+/// Rows are counted when the row changes, so merged parts should
+/// cover disjoint rows.  Distinct columns are estimated from the
+/// smallest column hashes (exact until there are more than
+/// MAX_COLUMN_HASHES of them).  The reservoir keeps the cells with
+/// the smallest key hashes, which gives the same uniform sample no
+/// matter how the scan was split up.
+class kdi::ScanAggregate
+{
+public:
+    enum { MAX_COLUMN_HASHES = 1024 };
+
+    struct FamilyCount
+    {
+        uint64_t nCells;
+        uint64_t nBytes;
+
+        FamilyCount() : nCells(0), nBytes(0) {}
+    };
+
+    typedef std::map<std::string, FamilyCount> family_map;
+
+private:
+    typedef std::pair<uint32_t, Cell> sample_t;
+
+    // Spec
+    std::string spec;
+    bool wantFamilies;
+    bool wantColumns;
+    size_t reservoirSize;
+    size_t everyN;
+
+    // Results
+    uint64_t nCells;
+    uint64_t nRows;
+    uint64_t rowBytes;
+    uint64_t columnBytes;
+    uint64_t valueBytes;
+    family_map families;
+    std::set<uint32_t> columnHashes;
+    std::vector<sample_t> samples;
+    uint64_t sampleBytes;
+
+    // Scan position, kept across reset()
+    std::string lastRow;
+    bool haveLastRow;
+    size_t skipCount;
+
+    // More cells of the last row may follow.  Cleared by reset().
+    bool lastRowPartial;
+
+    void addSample(uint32_t hash, Cell const & x);
+
+public:
+    /// Create an empty aggregate.  Raises ValueError if the spec
+    /// can't be parsed.
+    explicit ScanAggregate(std::string const & spec = std::string());
+
+    /// Add the next cell in scan order.
+    void add(Cell const & x);
+
+    /// Add the results of another aggregate with the same spec.  The
+    /// later of the two last rows is kept, so parts can be merged
+    /// in any order.  On a tie, the other aggregate's partial row
+    /// flag wins.  Raises ValueError if the specs differ.
+    void merge(ScanAggregate const & o);
+
+    /// Decode an aggregate from encode() and merge it.
+    void mergeEncoded(strref_t encoded);
+
+    /// Clear the results and the partial row flag, but remember the
+    /// last row and the every-Nth position so the next add()
+    /// continues the scan.
+    void reset();
+
+    /// Encode the spec, results, last row, and partial row flag as a
+    /// string.
+    std::string encode() const;
+
+    std::string const & getSpec() const { return spec; }
+
+    uint64_t getCellCount() const { return nCells; }
+    uint64_t getRowCount() const { return nRows; }
+    uint64_t getRowBytes() const { return rowBytes; }
+    uint64_t getColumnBytes() const { return columnBytes; }
+    uint64_t getValueBytes() const { return valueBytes; }
+
+    /// Get the total row, column, and value size of the samples.
+    uint64_t getSampleBytes() const { return sampleBytes; }
+
+    /// True if any cells have been added, here or in a merged
+    /// aggregate.  Then getLastRow() is the row of the last one.
+    bool hasLastRow() const { return haveLastRow; }
+    std::string const & getLastRow() const { return lastRow; }
+
+    /// Note whether the aggregate stopped inside its last row, so
+    /// the next part of the scan may hold more cells of that row.
+    void setLastRowPartial(bool partial) { lastRowPartial = partial; }
+    bool isLastRowPartial() const { return lastRowPartial; }
+
+    /// Get the estimated number of distinct columns.  Only valid if
+    /// "columns" is in the spec.
+    uint64_t getColumnCount() const;
+
+    /// True if getColumnCount() is an exact count.
+    bool isColumnCountExact() const
+    {
+        return columnHashes.size() < MAX_COLUMN_HASHES;
+    }
+
+    family_map const & getFamilies() const { return families; }
+
+    /// Append the sampled cells to \c out, in cell order for a
+    /// reservoir and in scan order for every-Nth.
+    void getSamples(std::vector<Cell> & out) const;
+};
+
+
+#endif // KDI_SCAN_AGGREGATE_H
@@ -0,0 +1,244 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <kdi/scan_aggregate.h>
+#include <kdi/memory_table.h>
+#include <kdi/scan_predicate.h>
+#include <unittest/main.h>
+#include <ex/exception.h>
+#include <boost/format.hpp>
+#include <string>
+#include <vector>
+
+using namespace kdi;
+using namespace ex;
+using namespace std;
+using boost::format;
+
+namespace
+{
+    /// Make n cells in n/4 rows with 2 columns in each of 2 families
+    vector<Cell> makeCells(size_t n)
+    {
+        vector<Cell> cells;
+        for(size_t i = 0; i < n; ++i)
+        {
+            cells.push_back(
+                makeCell((format("row-%05d") % (i / 4)).str(),
+                         (format("%s:q%d") % (i % 2 ? "a" : "bb")
+                          % (i / 2 % 2)).str(),
+                         42, "value"));
+        }
+        return cells;
+    }
+
+    string encodeRange(vector<Cell> const & cells, size_t begin,
+                       size_t end, string const & spec)
+    {
+        ScanAggregate agg(spec);
+        for(size_t i = begin; i < end; ++i)
+            agg.add(cells[i]);
+        return agg.encode();
+    }
+}
+
+BOOST_AUTO_UNIT_TEST(count_test)
+{
+    TablePtr t = MemoryTable::create(true);
+    vector<Cell> cells = makeCells(40);
+    for(size_t i = 0; i < cells.size(); ++i)
+        t->insert(cells[i]);
+
+    ScanAggregate agg("families,columns");
+    t->aggregate(ScanPredicate(), agg);
+
+    BOOST_CHECK_EQUAL(agg.getCellCount(), 40u);
+    BOOST_CHECK_EQUAL(agg.getRowCount(), 10u);
+    BOOST_CHECK_EQUAL(agg.getRowBytes(), 40u * 9);
+    BOOST_CHECK_EQUAL(agg.getValueBytes(), 40u * 5);
+    BOOST_CHECK_EQUAL(agg.getColumnCount(), 4u);
+    BOOST_CHECK(agg.isColumnCountExact());
+
+    ScanAggregate::family_map const & fams = agg.getFamilies();
+    BOOST_REQUIRE_EQUAL(fams.size(), 2u);
+    BOOST_CHECK_EQUAL(fams.find("a")->second.nCells, 20u);
+    BOOST_CHECK_EQUAL(fams.find("bb")->second.nCells, 20u);
+    BOOST_CHECK_EQUAL(fams.find("a")->second.nBytes, 20u * (9 + 4 + 5));
+
+    // Predicates apply
+    ScanAggregate some;
+    t->aggregate(ScanPredicate("row < 'row-00002'"), some);
+    BOOST_CHECK_EQUAL(some.getCellCount(), 8u);
+    BOOST_CHECK_EQUAL(some.getRowCount(), 2u);
+
+    // Each table's rows are counted on their own, even when one
+    // starts with the row another ended on
+    TablePtr t2 = MemoryTable::create(true);
+    t2->insert(makeCell("row-00009", "a:x", 42, "value"));
+    ScanAggregate both;
+    t->aggregate(ScanPredicate(), both);
+    t2->aggregate(ScanPredicate(), both);
+    BOOST_CHECK_EQUAL(both.getCellCount(), 41u);
+    BOOST_CHECK_EQUAL(both.getRowCount(), 11u);
+}
+
+BOOST_AUTO_UNIT_TEST(position_test)
+{
+    vector<Cell> cells = makeCells(40);
+
+    // The last row and sample size travel with the encoded parts
+    ScanAggregate parts("every=2");
+    BOOST_CHECK(!parts.hasLastRow());
+    parts.mergeEncoded(encodeRange(cells, 20, 40, "every=2"));
+    parts.mergeEncoded(encodeRange(cells, 0, 20, "every=2"));
+    BOOST_CHECK(parts.hasLastRow());
+    BOOST_CHECK_EQUAL(parts.getLastRow(), "row-00009");
+    BOOST_CHECK_EQUAL(parts.getSampleBytes(),
+                      20u * 9 + 20u * 4 + 20u * 5);
+
+    // Reservoir replacements keep the sample size current
+    ScanAggregate res("reservoir=3");
+    for(size_t i = 0; i < cells.size(); ++i)
+        res.add(cells[i]);
+    vector<Cell> samples;
+    res.getSamples(samples);
+    size_t sz = 0;
+    for(size_t i = 0; i < samples.size(); ++i)
+        sz += 9 + samples[i].getColumn().size() + 5;
+    BOOST_CHECK_EQUAL(samples.size(), 3u);
+    BOOST_CHECK_EQUAL(res.getSampleBytes(), sz);
+    res.reset();
+    BOOST_CHECK_EQUAL(res.getSampleBytes(), 0u);
+}
+
+BOOST_AUTO_UNIT_TEST(partial_row_test)
+{
+    vector<Cell> cells = makeCells(8);
+
+    // A part that stops inside a row says so, and the next part
+    // continues the row without counting it again
+    ScanAggregate agg;
+    for(size_t i = 0; i < 6; ++i)
+        agg.add(cells[i]);
+    agg.setLastRowPartial(true);
+    string first = agg.encode();
+
+    agg.reset();
+    BOOST_CHECK(!agg.isLastRowPartial());
+    for(size_t i = 6; i < 8; ++i)
+        agg.add(cells[i]);
+    string second = agg.encode();
+
+    ScanAggregate part;
+    part.mergeEncoded(first);
+    BOOST_CHECK(part.isLastRowPartial());
+    BOOST_CHECK_EQUAL(part.getLastRow(), "row-00001");
+
+    // The later part finishes the row
+    part.mergeEncoded(second);
+    BOOST_CHECK(!part.isLastRowPartial());
+    BOOST_CHECK_EQUAL(part.getCellCount(), 8u);
+    BOOST_CHECK_EQUAL(part.getRowCount(), 2u);
+}
+
+BOOST_AUTO_UNIT_TEST(merge_test)
+{
+    vector<Cell> cells = makeCells(1000);
+    string const spec = "families,columns,reservoir=10";
+
+    ScanAggregate whole(spec);
+    whole.mergeEncoded(encodeRange(cells, 0, cells.size(), spec));
+
+    // Split on row boundaries and merge the encoded parts
+    ScanAggregate parts(spec);
+    parts.mergeEncoded(encodeRange(cells, 600, 1000, spec));
+    parts.mergeEncoded(encodeRange(cells, 0, 200, spec));
+    parts.mergeEncoded(encodeRange(cells, 200, 600, spec));
+
+    BOOST_CHECK_EQUAL(parts.getCellCount(), 1000u);
+    BOOST_CHECK_EQUAL(parts.getRowCount(), 250u);
+    BOOST_CHECK_EQUAL(parts.getColumnCount(), 4u);
+    BOOST_CHECK_EQUAL(parts.encode(), whole.encode());
+
+    // The reservoir is the same sample however the scan was split
+    vector<Cell> a;
+    vector<Cell> b;
+    whole.getSamples(a);
+    parts.getSamples(b);
+    BOOST_CHECK_EQUAL(a.size(), 10u);
+    BOOST_CHECK(a == b);
+
+    // Specs have to match
+    ScanAggregate other("families");
+    BOOST_CHECK_THROW(other.merge(whole), ValueError);
+}
+
+BOOST_AUTO_UNIT_TEST(every_test)
+{
+    vector<Cell> cells = makeCells(20);
+
+    // Reset between parts keeps the position, as a server does
+    // between calls
+    ScanAggregate server("every=3");
+    ScanAggregate client("every=3");
+    for(size_t i = 0; i < cells.size(); ++i)
+    {
+        server.add(cells[i]);
+        if(i % 7 == 6)
+        {
+            client.mergeEncoded(server.encode());
+            server.reset();
+        }
+    }
+    client.mergeEncoded(server.encode());
+
+    // The row spanning a reset is only counted once
+    BOOST_CHECK_EQUAL(client.getRowCount(), 5u);
+    BOOST_CHECK_EQUAL(client.getCellCount(), 20u);
+
+    vector<Cell> samples;
+    client.getSamples(samples);
+    BOOST_REQUIRE_EQUAL(samples.size(), 6u);
+    for(size_t i = 0; i < samples.size(); ++i)
+        BOOST_CHECK(samples[i] == cells[i * 3 + 2]);
+}
+
+BOOST_AUTO_UNIT_TEST(column_estimate_test)
+{
+    ScanAggregate agg("columns");
+    for(size_t i = 0; i < 20000; ++i)
+        agg.add(makeCell("row", (format("fam:%d") % i).str(), 0, ""));
+
+    BOOST_CHECK(!agg.isColumnCountExact());
+    BOOST_CHECK(agg.getColumnCount() > 17000u);
+    BOOST_CHECK(agg.getColumnCount() < 23000u);
+}
+
+BOOST_AUTO_UNIT_TEST(spec_test)
+{
+    BOOST_CHECK_THROW(ScanAggregate("bogus"), ValueError);
+    BOOST_CHECK_THROW(ScanAggregate("reservoir=0"), ValueError);
+    BOOST_CHECK_THROW(ScanAggregate("every=x"), ValueError);
+    BOOST_CHECK_THROW(ScanAggregate("families=1"), ValueError);
+    BOOST_CHECK_THROW(ScanAggregate("reservoir=5,every=2"), ValueError);
+
+    ScanAggregate agg;
+    BOOST_CHECK_THROW(agg.mergeEncoded("junk"), ValueError);
+}
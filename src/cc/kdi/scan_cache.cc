@@ -0,0 +1,400 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <kdi/scan_cache.h>
+#include <warp/StatTracker.h>
+#include <sstream>
+
+using namespace kdi;
+using namespace warp;
+using namespace std;
+
+namespace {
+
+    // Estimate of storage overhead of a cell
+    size_t const CELL_OVERHEAD = 6 * sizeof(void *);
+
+    /// Get the memory size of a cell
+    size_t cellSize(Cell const & x)
+    {
+        return CELL_OVERHEAD + x.getRow().size() +
+            x.getColumn().size() + x.getValue().size();
+    }
+
+    /// Copy a cell into its own storage so a cached result doesn't
+    /// pin the fragment blocks it was read from.
+    Cell copyCell(Cell const & x)
+    {
+        if(x.isErasure())
+            return makeCellErasure(x.getRow(), x.getColumn(),
+                                   x.getTimestamp());
+        else if(x.isMergeOperand())
+            return makeMergeOperand(x.getRow(), x.getColumn(),
+                                    x.getTimestamp(), x.getValue());
+        else
+            return makeCell(x.getRow(), x.getColumn(),
+                            x.getTimestamp(), x.getValue());
+    }
+
+    string getPredicateKey(ScanPredicate const & pred)
+    {
+        ostringstream oss;
+        oss << pred;
+        return oss.str();
+    }
+
+    bool rowsContain(ScanPredicate::StringSetCPtr const & rows,
+                     string const & row)
+    {
+        return !rows || rows->contains(row);
+    }
+}
+
+//----------------------------------------------------------------------------
+// ScanCache::Key
+//----------------------------------------------------------------------------
+bool ScanCache::Key::operator<(Key const & o) const
+{
+    if(owner != o.owner)
+        return owner < o.owner;
+    if(generation != o.generation)
+        return generation < o.generation;
+    return predicate < o.predicate;
+}
+
+//----------------------------------------------------------------------------
+// ScanCache::CachedScan
+//----------------------------------------------------------------------------
+class ScanCache::CachedScan
+    : public CellStream
+{
+    cell_vec_cptr cells;
+    size_t next;
+
+public:
+    explicit CachedScan(cell_vec_cptr const & cells) :
+        cells(cells), next(0) {}
+
+    bool get(Cell & x)
+    {
+        if(next >= cells->size())
+            return false;
+        x = (*cells)[next++];
+        return true;
+    }
+};
+
+//----------------------------------------------------------------------------
+// ScanCache::Fill
+//----------------------------------------------------------------------------
+class ScanCache::Fill
+    : public CellStream
+{
+public:
+    ScanCache * const cache;
+    Key const key;
+    ScanPredicate::StringSetCPtr const rows;
+    size_t const maxSize;
+
+    CellStreamPtr input;
+    boost::shared_ptr<cell_vec> cells;
+    size_t size;
+
+    // Only changed by the reading thread
+    bool active;
+
+    // Set by other threads, under the cache mutex
+    bool stale;
+
+    Fill(ScanCache * cache, Key const & key,
+         ScanPredicate::StringSetCPtr const & rows, size_t maxSize,
+         CellStreamPtr const & input) :
+        cache(cache), key(key), rows(rows), maxSize(maxSize),
+        input(input), cells(new cell_vec), size(0),
+        active(true), stale(false)
+    {
+    }
+
+    ~Fill()
+    {
+        if(active)
+            cache->finishFill(this, false);
+    }
+
+    bool get(Cell & x)
+    {
+        if(!input->get(x))
+        {
+            if(active)
+                cache->finishFill(this, true);
+            return false;
+        }
+
+        if(active)
+        {
+            size += cellSize(x);
+            if(size <= maxSize)
+                cells->push_back(copyCell(x));
+            else
+            {
+                // Too big to cache
+                cells.reset();
+                cache->finishFill(this, false);
+            }
+        }
+        return true;
+    }
+};
+
+//----------------------------------------------------------------------------
+// ScanCache
+//----------------------------------------------------------------------------
+ScanCache::ScanCache(size_t maxSize) :
+    maxSize(maxSize),
+    size(0),
+    nHits(0),
+    nMisses(0),
+    nInvalidated(0),
+    tracker(0)
+{
+}
+
+ScanCache::~ScanCache()
+{
+}
+
+void ScanCache::addOwnerRef(void const * owner)
+{
+    ++owners[owner];
+}
+
+void ScanCache::releaseOwnerRef(void const * owner)
+{
+    owner_map::iterator it = owners.find(owner);
+    if(!--it->second)
+        owners.erase(it);
+}
+
+void ScanCache::removeEntry(entry_map::iterator it)
+{
+    lru_list::iterator li = it->second;
+    size -= li->size;
+    releaseOwnerRef(li->key.owner);
+    lru.erase(li);
+    entries.erase(it);
+}
+
+void ScanCache::evict(size_t targetSize)
+{
+    while(size > targetSize && !lru.empty())
+        removeEntry(entries.find(lru.back().key));
+}
+
+void ScanCache::updateTracker(lock_t const & lock)
+{
+    if(!tracker)
+        return;
+
+    size_t nLookups = nHits + nMisses;
+    tracker->set("ScanCache.size", size);
+    tracker->set("ScanCache.count", entries.size());
+    tracker->set("ScanCache.nHits", nHits);
+    tracker->set("ScanCache.nMisses", nMisses);
+    tracker->set("ScanCache.nInvalidated", nInvalidated);
+    tracker->set("ScanCache.hitRate",
+                 nLookups ? nHits * 100 / nLookups : 0);
+}
+
+void ScanCache::registerFill(Fill * fill)
+{
+    lock_t lock(mutex);
+    fills.insert(fill);
+    addOwnerRef(fill->key.owner);
+}
+
+void ScanCache::finishFill(Fill * fill, bool complete)
+{
+    lock_t lock(mutex);
+
+    fill->active = false;
+    fills.erase(fill);
+
+    size_t entrySize = fill->size + sizeof(Entry) +
+        fill->key.predicate.size();
+    if(complete && !fill->stale && maxSize &&
+       entrySize <= getMaxEntrySize())
+    {
+        entry_map::iterator it = entries.find(fill->key);
+        if(it != entries.end())
+            removeEntry(it);
+
+        lru.push_front(Entry(fill->key, fill->rows, fill->cells,
+                             entrySize));
+        entries[fill->key] = lru.begin();
+        size += entrySize;
+        addOwnerRef(fill->key.owner);
+        evict(maxSize);
+        updateTracker(lock);
+    }
+
+    releaseOwnerRef(fill->key.owner);
+}
+
+void ScanCache::setMaxSize(size_t maxSize)
+{
+    lock_t lock(mutex);
+    this->maxSize = maxSize;
+    evict(maxSize);
+    updateTracker(lock);
+}
+
+bool ScanCache::isEnabled() const
+{
+    lock_t lock(mutex);
+    return maxSize != 0;
+}
+
+CellStreamPtr ScanCache::get(void const * owner, size_t generation,
+                             ScanPredicate const & pred)
+{
+    Key key(owner, generation, getPredicateKey(pred));
+
+    lock_t lock(mutex);
+    if(!maxSize)
+        return CellStreamPtr();
+
+    entry_map::iterator it = entries.find(key);
+    if(it == entries.end())
+    {
+        ++nMisses;
+        updateTracker(lock);
+        return CellStreamPtr();
+    }
+    ++nHits;
+    updateTracker(lock);
+
+    // Move to the front of the LRU list
+    lru.splice(lru.begin(), lru, it->second);
+
+    CellStreamPtr scan(new CachedScan(it->second->cells));
+    return scan;
+}
+
+CellStreamPtr ScanCache::fill(void const * owner, size_t generation,
+                              ScanPredicate const & pred,
+                              CellStreamPtr const & scan)
+{
+    size_t maxEntrySize;
+    {
+        lock_t lock(mutex);
+        maxEntrySize = getMaxEntrySize();
+    }
+    if(!maxEntrySize)
+        return scan;
+
+    boost::shared_ptr<Fill> f(
+        new Fill(this, Key(owner, generation, getPredicateKey(pred)),
+                 pred.getRowPredicate(), maxEntrySize, scan));
+    registerFill(f.get());
+    return f;
+}
+
+void ScanCache::invalidateRow(void const * owner, strref_t row)
+{
+    lock_t lock(mutex);
+    if(owners.find(owner) == owners.end())
+        return;
+
+    string r(row.begin(), row.end());
+
+    size_t nDropped = 0;
+    entry_map::iterator it = entries.lower_bound(Key(owner, 0, string()));
+    while(it != entries.end() && it->first.owner == owner)
+    {
+        if(rowsContain(it->second->rows, r))
+        {
+            removeEntry(it++);
+            ++nDropped;
+        }
+        else
+            ++it;
+    }
+    if(nDropped)
+    {
+        nInvalidated += nDropped;
+        updateTracker(lock);
+    }
+
+    for(fill_set::const_iterator i = fills.begin(); i != fills.end(); ++i)
+    {
+        if((*i)->key.owner == owner && rowsContain((*i)->rows, r))
+            (*i)->stale = true;
+    }
+}
+
+void ScanCache::invalidateAll(void const * owner)
+{
+    lock_t lock(mutex);
+    if(owners.find(owner) == owners.end())
+        return;
+
+    size_t nDropped = 0;
+    entry_map::iterator it = entries.lower_bound(Key(owner, 0, string()));
+    while(it != entries.end() && it->first.owner == owner)
+    {
+        removeEntry(it++);
+        ++nDropped;
+    }
+    if(nDropped)
+    {
+        nInvalidated += nDropped;
+        updateTracker(lock);
+    }
+
+    for(fill_set::const_iterator i = fills.begin(); i != fills.end(); ++i)
+    {
+        if((*i)->key.owner == owner)
+            (*i)->stale = true;
+    }
+}
+
+void ScanCache::getStats(Stats & stats) const
+{
+    lock_t lock(mutex);
+    stats.maxSize = maxSize;
+    stats.size = size;
+    stats.nEntries = entries.size();
+    stats.nHits = nHits;
+    stats.nMisses = nMisses;
+    stats.nInvalidated = nInvalidated;
+}
+
+void ScanCache::setTracker(warp::StatTracker * tracker)
+{
+    lock_t lock(mutex);
+    this->tracker = tracker;
+    updateTracker(lock);
+}
+
+ScanCache & ScanCache::getGlobal()
+{
+    static ScanCache cache(0);
+    return cache;
+}
@@ -0,0 +1,184 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#ifndef KDI_SCAN_CACHE_H
+#define KDI_SCAN_CACHE_H
+
+#include <kdi/cell.h>
+#include <kdi/scan_predicate.h>
+#include <warp/string_range.h>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <set>
+
+namespace kdi {
+
+    class ScanCache;
+
+} // namespace kdi
+
+namespace warp { class StatTracker; }
+
+//----------------------------------------------------------------------------
+// ScanCache
+//----------------------------------------------------------------------------
+/// Byte-bounded LRU cache of small scan results.  Entries are keyed
+/// by an owner (e.g. a Tablet), the owner's fragment generation, and
+/// the scan predicate, so a change to the fragment set makes older
+/// entries unreachable.  Owners must also report mutations with
+/// invalidateRow() once they are visible to scans, and drop their
+/// entries with invalidateAll() when their contents change in any
+/// other way.
+///
+/// Results are filled in by wrapping a scan with fill().  If the
+/// owner reports a change overlapping the scan's rows before the
+/// scan finishes, the result is not cached.  The cache is disabled
+/// while its maximum size is zero, and it is thread-safe.
+///
+/// Entries hold raw fragment data and never expire on their own.
+/// Anything that depends on the time of the scan, such as retention
+/// age limits, must be applied to the stream returned by get() or
+/// fill() rather than cached with it.
+class kdi::ScanCache
+    : private boost::noncopyable
+{
+public:
+    struct Stats
+    {
+        size_t maxSize;
+        size_t size;
+        size_t nEntries;
+        size_t nHits;
+        size_t nMisses;
+        size_t nInvalidated;    ///< Entries dropped by invalidation
+    };
+
+private:
+    typedef boost::mutex mutex_t;
+    typedef mutex_t::scoped_lock lock_t;
+    typedef std::vector<Cell> cell_vec;
+    typedef boost::shared_ptr<cell_vec const> cell_vec_cptr;
+
+    struct Key
+    {
+        void const * owner;
+        size_t generation;
+        std::string predicate;
+
+        Key(void const * owner, size_t generation,
+            std::string const & predicate) :
+            owner(owner), generation(generation), predicate(predicate) {}
+
+        bool operator<(Key const & o) const;
+    };
+
+    struct Entry
+    {
+        Key key;
+        ScanPredicate::StringSetCPtr rows;
+        cell_vec_cptr cells;
+        size_t size;
+
+        Entry(Key const & key, ScanPredicate::StringSetCPtr const & rows,
+              cell_vec_cptr const & cells, size_t size) :
+            key(key), rows(rows), cells(cells), size(size) {}
+    };
+
+    class Fill;
+    class CachedScan;
+    friend class Fill;
+
+    typedef std::list<Entry> lru_list;
+    typedef std::map<Key, lru_list::iterator> entry_map;
+    typedef std::set<Fill *> fill_set;
+    typedef std::map<void const *, size_t> owner_map;
+
+    size_t maxSize;
+    size_t size;
+    size_t nHits;
+    size_t nMisses;
+    size_t nInvalidated;
+
+    lru_list lru;               // Most recently used first
+    entry_map entries;
+    fill_set fills;
+    owner_map owners;           // Entry and fill counts per owner
+
+    warp::StatTracker * tracker;
+    mutable mutex_t mutex;
+
+    size_t getMaxEntrySize() const { return maxSize / 8; }
+    void updateTracker(lock_t const & lock);
+
+    void addOwnerRef(void const * owner);
+    void releaseOwnerRef(void const * owner);
+    void removeEntry(entry_map::iterator it);
+    void evict(size_t targetSize);
+
+    void registerFill(Fill * fill);
+    void finishFill(Fill * fill, bool complete);
+
+public:
+    /// Create a cache holding up to maxSize bytes of cells.  Scans
+    /// producing more than 1/8th of that are never cached.
+    explicit ScanCache(size_t maxSize);
+    ~ScanCache();
+
+    /// Change the maximum size, evicting entries if necessary.  A
+    /// size of zero disables the cache.
+    void setMaxSize(size_t maxSize);
+
+    /// Return true if the cache has a non-zero size.
+    bool isEnabled() const;
+
+    /// Get a scan over a cached result, or null if there is none.
+    CellStreamPtr get(void const * owner, size_t generation,
+                      ScanPredicate const & pred);
+
+    /// Wrap a scan so its output is cached when it runs to the end.
+    /// The returned stream must be released before the cache is
+    /// destroyed.
+    CellStreamPtr fill(void const * owner, size_t generation,
+                       ScanPredicate const & pred,
+                       CellStreamPtr const & scan);
+
+    /// Drop the owner's results that could include the given row.
+    void invalidateRow(void const * owner, warp::strref_t row);
+
+    /// Drop all of the owner's results.
+    void invalidateAll(void const * owner);
+
+    void getStats(Stats & stats) const;
+
+    /// Report ScanCache.* stats (including the hit rate in percent)
+    /// to the given tracker, or stop reporting if the tracker is
+    /// null.
+    void setTracker(warp::StatTracker * tracker);
+
+    /// Get the cache shared by the process.  It starts out disabled.
+    static ScanCache & getGlobal();
+};
+
+#endif // KDI_SCAN_CACHE_H
@@ -0,0 +1,172 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <kdi/scan_cache.h>
+#include <kdi/memory_table.h>
+#include <kdi/table_unittest.h>
+#include <unittest/main.h>
+
+using namespace kdi;
+using namespace kdi::unittest;
+
+namespace {
+
+    MemoryTablePtr makeTable()
+    {
+        MemoryTablePtr t = MemoryTable::create(true);
+        t->set("stats:a", "c", 1, "x");
+        t->set("stats:b", "c", 2, "y");
+        t->set("user:a", "c", 3, "z");
+        return t;
+    }
+
+    void drain(CellStream & scan)
+    {
+        Cell x;
+        while(scan.get(x))
+            ;
+    }
+
+    /// Scan the table through the cache, the way a Tablet does.
+    CellStreamPtr cachedScan(ScanCache & cache, Table const & table,
+                             size_t generation, ScanPredicate const & pred)
+    {
+        CellStreamPtr scan = cache.get(&table, generation, pred);
+        if(!scan)
+            scan = cache.fill(&table, generation, pred, table.scan(pred));
+        return scan;
+    }
+}
+
+BOOST_AUTO_UNIT_TEST(hit_test)
+{
+    test_out_t out;
+    ScanCache cache(1 << 20);
+    MemoryTablePtr t = makeTable();
+    ScanPredicate pred("row ~= 'stats:'");
+
+    BOOST_CHECK(!cache.get(t.get(), 1, pred));
+    BOOST_CHECK((out << *cachedScan(cache, *t, 1, pred)).is_equal(
+                    "(stats:a,c,1,x)"
+                    "(stats:b,c,2,y)"));
+
+    // Served from the cache: changes the owner doesn't report are
+    // not seen
+    t->set("stats:c", "c", 4, "w");
+    CellStreamPtr hit = cache.get(t.get(), 1, pred);
+    BOOST_REQUIRE(hit);
+    BOOST_CHECK((out << *hit).is_equal(
+                    "(stats:a,c,1,x)"
+                    "(stats:b,c,2,y)"));
+
+    // A new fragment generation misses
+    BOOST_CHECK(!cache.get(t.get(), 2, pred));
+
+    ScanCache::Stats stats;
+    cache.getStats(stats);
+    BOOST_CHECK_EQUAL(stats.nEntries, 1u);
+    BOOST_CHECK_EQUAL(stats.nHits, 1u);
+    BOOST_CHECK_EQUAL(stats.nMisses, 3u);
+    BOOST_CHECK(stats.size > 0u);
+}
+
+BOOST_AUTO_UNIT_TEST(invalidate_test)
+{
+    ScanCache cache(1 << 20);
+    MemoryTablePtr t = makeTable();
+    ScanPredicate stats("row ~= 'stats:'");
+    ScanPredicate all;
+
+    drain(*cachedScan(cache, *t, 1, stats));
+    drain(*cachedScan(cache, *t, 1, all));
+    BOOST_CHECK(cache.get(t.get(), 1, stats));
+    BOOST_CHECK(cache.get(t.get(), 1, all));
+
+    // Mutation outside the stats rows only drops the full scan
+    cache.invalidateRow(t.get(), "user:b");
+    BOOST_CHECK(cache.get(t.get(), 1, stats));
+    BOOST_CHECK(!cache.get(t.get(), 1, all));
+
+    // Other owners are not affected
+    cache.invalidateAll(&cache);
+    BOOST_CHECK(cache.get(t.get(), 1, stats));
+
+    cache.invalidateRow(t.get(), "stats:q");
+    BOOST_CHECK(!cache.get(t.get(), 1, stats));
+
+    ScanCache::Stats s;
+    cache.getStats(s);
+    BOOST_CHECK_EQUAL(s.nEntries, 0u);
+    BOOST_CHECK_EQUAL(s.size, 0u);
+    BOOST_CHECK_EQUAL(s.nInvalidated, 2u);
+}
+
+BOOST_AUTO_UNIT_TEST(stale_fill_test)
+{
+    ScanCache cache(1 << 20);
+    MemoryTablePtr t = makeTable();
+    ScanPredicate pred("row ~= 'stats:'");
+
+    // A mutation reported while the scan is running keeps the result
+    // out of the cache
+    CellStreamPtr scan = cachedScan(cache, *t, 1, pred);
+    Cell x;
+    BOOST_CHECK(scan->get(x));
+    cache.invalidateRow(t.get(), "stats:z");
+    drain(*scan);
+    BOOST_CHECK(!cache.get(t.get(), 1, pred));
+
+    // So does closing the scan early
+    scan = cachedScan(cache, *t, 1, pred);
+    BOOST_CHECK(scan->get(x));
+    scan.reset();
+    BOOST_CHECK(!cache.get(t.get(), 1, pred));
+
+    // A complete scan is cached
+    drain(*cachedScan(cache, *t, 1, pred));
+    BOOST_CHECK(cache.get(t.get(), 1, pred));
+}
+
+BOOST_AUTO_UNIT_TEST(size_limit_test)
+{
+    MemoryTablePtr t = makeTable();
+    t->set("big", "c", 1, std::string(4096, 'x'));
+    ScanPredicate big("row = 'big'");
+    ScanPredicate stats("row ~= 'stats:'");
+
+    // Results over 1/8th of the cache are not kept
+    ScanCache cache(16 << 10);
+    drain(*cachedScan(cache, *t, 1, big));
+    BOOST_CHECK(!cache.get(t.get(), 1, big));
+    drain(*cachedScan(cache, *t, 1, stats));
+    BOOST_CHECK(cache.get(t.get(), 1, stats));
+
+    // Shrinking evicts, and a zero size disables the cache
+    cache.setMaxSize(0);
+    BOOST_CHECK(!cache.isEnabled());
+    BOOST_CHECK(!cache.get(t.get(), 1, stats));
+    CellStreamPtr scan = t->scan(stats);
+    BOOST_CHECK(cache.fill(t.get(), 1, stats, scan) == scan);
+
+    ScanCache::Stats s;
+    cache.getStats(s);
+    BOOST_CHECK_EQUAL(s.nEntries, 0u);
+    BOOST_CHECK_EQUAL(s.size, 0u);
+}
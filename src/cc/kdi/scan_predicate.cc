@@ -471,6 +471,10 @@ functor_parser<IntervalSetParser<int64_t, functor_parser<TimeIntervalParser> > >
 //----------------------------------------------------------------------------
 // ScanPredicateParser
 //----------------------------------------------------------------------------
+ScanPredicate::Projection const KEYS = ScanPredicate::PROJECT_KEYS;
+ScanPredicate::Projection const ROWS = ScanPredicate::PROJECT_ROWS;
+ScanPredicate::Projection const LENGTHS = ScanPredicate::PROJECT_LENGTHS;
+
 class ScanPredicateParser
 {
 public:
@@ -481,6 +485,7 @@ public:
     operator()(ScannerT const & scan, result_t & r) const
     {
         int maxHistory;
+        ScanPredicate::Projection projection;
         return
             (
                 (
@@ -489,7 +494,14 @@ public:
                       ( str_p("history") >>
                         ch_p('=') >>
                         int_p[assign_a(maxHistory)]
-                      )[SetHistory(r, maxHistory)]
+                      )[SetHistory(r, maxHistory)] |
+                      ( str_p("project") >>
+                        ch_p('=') >>
+                        ( str_p("keys")[assign_a(projection, KEYS)] |
+                          str_p("rows")[assign_a(projection, ROWS)] |
+                          str_p("lengths")[assign_a(projection, LENGTHS)]
+                        )
+                      )[SetProjection(r, projection)]
                     ) % str_p("and")
                 ) | eps_p
             )
@@ -553,10 +565,27 @@ public:
             r.setMaxHistory(k);
         }
     };
+
+    struct SetProjection
+    {
+        result_t & r;
+        ScanPredicate::Projection const & p;
+        SetProjection(result_t & r, ScanPredicate::Projection const & p) :
+            r(r), p(p) {}
+
+        void operator()(char const *, char const *) const
+        {
+            if(r.getProjection() != ScanPredicate::PROJECT_CELLS)
+                raise<ValueError>("cannot specify projection conjunctions");
+            r.setProjection(p);
+        }
+    };
 };
 
 functor_parser<ScanPredicateParser> const scan_predicate_p;
 
+char const * const PROJECTION_NAMES[] = { "cells", "keys", "rows", "lengths" };
+
 #if 0
 {
 #endif
@@ -567,7 +596,8 @@ functor_parser<ScanPredicateParser> const scan_predicate_p;
 // ScanPredicate
 //----------------------------------------------------------------------------
 ScanPredicate::ScanPredicate(strref_t expr) :
-    maxHistory(0)
+    maxHistory(0),
+    projection(PROJECT_CELLS)
 {
     try {
         if(!parse(expr.begin(), expr.end(),
@@ -801,6 +831,14 @@ ostream & kdi::operator<<(ostream & out, ScanPredicate const & pred)
         if(needAnd)
             out << " and ";
         out << "history = " << pred.getMaxHistory();
+        needAnd = true;
+    }
+
+    if(pred.getProjection() != ScanPredicate::PROJECT_CELLS)
+    {
+        if(needAnd)
+            out << " and ";
+        out << "project = " << PROJECTION_NAMES[pred.getProjection()];
     }
 
     return out;
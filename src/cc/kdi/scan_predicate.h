@@ -44,25 +44,35 @@ public:
     typedef boost::shared_ptr<warp::IntervalSet<int64_t> const> TimestampSetCPtr;
     typedef ScanPredicate my_t;
 
+    /// What to return for each cell that matches the predicate.
+    enum Projection {
+        PROJECT_CELLS,          ///< Whole cells (the default)
+        PROJECT_KEYS,           ///< Cells with empty values
+        PROJECT_ROWS,           ///< First key of each distinct row
+        PROJECT_LENGTHS         ///< Values replaced by their lengths
+    };
+
 private:
     StringSetCPtr     rows;
     StringSetCPtr     columns;
     TimestampSetCPtr  timestamps;
     int               maxHistory;
+    Projection        projection;
 
 public:
     /// Create a default ScanPredicate, which includes all cells in
     /// the scan.
-    ScanPredicate() : maxHistory(0) {}
+    ScanPredicate() : maxHistory(0), projection(PROJECT_CELLS) {}
 
     /// Create a ScanPredicate from an expression string.  The
     /// expression grammar is:
     ///
     ///   PREDICATE    := ( SUBPREDICATE ( 'and' SUBPREDICATE )* )?
-    ///   SUBPREDICATE := INTERVALSET | HISTORY
+    ///   SUBPREDICATE := INTERVALSET | HISTORY | PROJECTION
     ///   INTERVALSET  := INTERVAL ( 'or' INTERVAL )*
     ///   INTERVAL     := ( LITERAL REL-OP )? FIELD REL-OP LITERAL
     ///   HISTORY      := 'history' '=' INTEGER
+    ///   PROJECTION   := 'project' '=' ( 'keys' | 'rows' | 'lengths' )
     ///   LITERAL      := STRING-LITERAL | TIME-LITERAL
     ///   TIME-LITERAL := ISO8601-DATETIME | ( '@' INTEGER )
     ///   FIELD        := 'row' | 'column' | 'time'
@@ -87,6 +97,7 @@ public:
     ///   - different FIELDs cannot be mixed in the same INTERVALSET
     ///   - there can be only one INTERVALSET per FIELD
     ///   - there can be only one HISTORY
+    ///   - there can be only one PROJECTION
     ///   - STRING-LITERALS can only be used with 'row' and 'column'
     ///   - TIME-LITERALS can only be used with 'time'
     ///   - the '~=' operator only works with STRING-LITERALs
@@ -104,6 +115,7 @@ public:
     ///    row ~= 'com.foo' and time >= 1999-01-02T03:04:05.678901Z
     ///    "word:cat" < column <= "word:dog" or column >= "word:fish"
     ///    time = @0
+    ///    column ~= 'link:' and project = rows
     ///
     /// @throws ValueError if the expression cannot be parsed
     explicit ScanPredicate(warp::strref_t expr);
@@ -162,6 +174,21 @@ public:
         return *this;
     }
 
+    /// Set what the scan returns for each matching cell.  Keys-only
+    /// scans return cells with empty values.  Row scans return one
+    /// key-only cell for each distinct row: the first matching cell
+    /// in the row.  Length scans replace each value with its length
+    /// in bytes, as a decimal string.  Projections apply to the
+    /// final result of the scan, after all other filtering, so
+    /// tables should never need to copy or send values that aren't
+    /// returned.  Erasures and merge operands seen by raw fragment
+    /// scans keep their values.
+    my_t & setProjection(Projection p)
+    {
+        projection = p;
+        return *this;
+    }
+
     /// Clear the row constraint.
     my_t & clearRowPredicate()
     {
@@ -204,6 +231,19 @@ public:
     /// revisions.
     int getMaxHistory() const { return maxHistory; }
 
+    /// Get what the scan returns for each matching cell.
+    Projection getProjection() const { return projection; }
+
+    /// Get the projection to use when scanning the inputs of a merge
+    /// that produces the result of this predicate.  The inputs can
+    /// drop values if the result doesn't need them, but they must
+    /// return every cell for the merge to be correct.
+    Projection getInputProjection() const
+    {
+        return ( projection == PROJECT_KEYS || projection == PROJECT_ROWS
+                 ? PROJECT_KEYS : PROJECT_CELLS );
+    }
+
     /// Return a copy of this ScanPredicate with the row predicate
     /// clipped to the given span.
     ScanPredicate clipRows(warp::Interval<std::string> const & span) const;
@@ -19,6 +19,7 @@
 //----------------------------------------------------------------------------
 
 #include <kdi/scan_predicate.h>
+#include <kdi/predicate_cache.h>
 #include <warp/string_range.h>
 #include <ex/exception.h>
 #include <unittest/main.h>
@@ -66,6 +67,15 @@ BOOST_AUTO_UNIT_TEST(parse_test)
     BOOST_CHECK_EQUAL(p("\"word:cat\" < column <= \"word:dog\" or column >= \"word:fish\""),
                       "\"word:cat\" < column <= \"word:dog\" or column >= \"word:fish\"");
     BOOST_CHECK_EQUAL(p("time = @0"), "time = @0");
+    BOOST_CHECK_EQUAL(p("column ~= 'link:' and project = rows"),
+                      "column ~= \"link:\" and project = rows");
+
+    // Projections
+    BOOST_CHECK_EQUAL(p("project = keys"), "project = keys");
+    BOOST_CHECK_EQUAL(p("project = lengths and history = 2"),
+                      "history = 2 and project = lengths");
+    BOOST_CHECK_THROW(p("project = keys and project = rows"), ValueError);
+    BOOST_CHECK_THROW(p("project = values"), ValueError);
 
     // Check trailing slash
     BOOST_CHECK_EQUAL(p("row = 'foo\\\\'"), "row = \"foo\\\\\"");
@@ -140,3 +150,29 @@ BOOST_AUTO_UNIT_TEST(column_family_test)
     BOOST_CHECK(testColumnFamily("column = 'source:whitelist' or column > 'source:whitelist'", false, 0));
     BOOST_CHECK(testColumnFamily("column = 'source:whitelist' or column > 'zeta'", false, 0));
 }
+
+BOOST_AUTO_UNIT_TEST(predicate_cache_test)
+{
+    PredicateCache cache(2);
+
+    // First use parses, later uses hit
+    ostringstream oss;
+    oss << cache.get("row = 'a'");
+    BOOST_CHECK_EQUAL(oss.str(), "row = \"a\"");
+    cache.get("row = 'a'");
+    BOOST_CHECK_EQUAL(cache.getMissCount(), 1u);
+    BOOST_CHECK_EQUAL(cache.getHitCount(), 1u);
+
+    // Bad expressions throw every time
+    BOOST_CHECK_THROW(cache.get("row = "), ValueError);
+    BOOST_CHECK_THROW(cache.get("row = "), ValueError);
+    BOOST_CHECK_EQUAL(cache.getMissCount(), 3u);
+
+    // Least recently used entries get pushed out
+    cache.get("row = 'b'");
+    cache.get("row = 'c'");
+    cache.get("row = 'a'");
+    BOOST_CHECK_EQUAL(cache.getMissCount(), 6u);
+    cache.get("row = 'c'");
+    BOOST_CHECK_EQUAL(cache.getHitCount(), 2u);
+}
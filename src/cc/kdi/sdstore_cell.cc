@@ -56,6 +56,16 @@ bool CellInterpreter::isErasure(void const * data) const
     return false;
 }
 
+ErasureKind CellInterpreter::getErasureKind(void const * data) const
+{
+    return this->isErasure(data) ? ERASE_CELL : NOT_ERASURE;
+}
+
+bool CellInterpreter::isMergeOperand(void const * data) const
+{
+    return false;
+}
+
 bool CellInterpreter::isLess(void const * data1, void const * data2) const
 {
     if(int cmp = string_compare(getRow(data1), getRow(data2)))
@@ -89,10 +99,21 @@ std::ostream & sdstore::operator<<(std::ostream & o, Cell const & cell)
     else
         o << Timestamp::fromMicroseconds(ts);
     o << ",\"";
-    if(cell.isErasure())
-        o << "ERASED";
-    else
-        o << ReprEscape(cell.getValue());
+    switch(cell.getErasureKind())
+    {
+        case NOT_ERASURE:
+            if(cell.isMergeOperand())
+                o << "MERGE ";
+            o << ReprEscape(cell.getValue());
+            break;
+        case ERASE_CELL:
+            o << "ERASED";
+            break;
+        case ERASE_ROWS:
+        case ERASE_FAMILY:
+            o << "ERASED TO " << ReprEscape(cell.getValue());
+            break;
+    }
     return o << "\")";
 }
 
@@ -112,3 +133,35 @@ Cell sdstore::makeCellErasure(strref_t row, strref_t col, int64_t ts)
 {
     return DynamicCellErasure::make(row, col, ts);
 }
+
+//----------------------------------------------------------------------------
+// makeRowRangeErasure
+//----------------------------------------------------------------------------
+Cell sdstore::makeRowRangeErasure(strref_t firstRow, strref_t endRow,
+                                  int64_t maxTimestamp)
+{
+    return DynamicRangeErasure::make(
+        ERASE_ROWS, firstRow, StringRange(), endRow, maxTimestamp);
+}
+
+//----------------------------------------------------------------------------
+// makeFamilyErasure
+//----------------------------------------------------------------------------
+Cell sdstore::makeFamilyErasure(strref_t row, strref_t family,
+                                int64_t maxTimestamp)
+{
+    // The range ends at the row that immediately follows
+    string endRow(row.begin(), row.end());
+    endRow += '\0';
+    return DynamicRangeErasure::make(
+        ERASE_FAMILY, row, family, endRow, maxTimestamp);
+}
+
+//----------------------------------------------------------------------------
+// makeMergeOperand
+//----------------------------------------------------------------------------
+Cell sdstore::makeMergeOperand(strref_t row, strref_t col, int64_t ts,
+                               strref_t val)
+{
+    return DynamicCell::makeMergeOperand(row, col, ts, val);
+}
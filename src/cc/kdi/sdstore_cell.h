@@ -49,6 +49,36 @@ namespace sdstore
     /// Make a dynamically-allocated Cell erasure
     Cell makeCellErasure(warp::strref_t row, warp::strref_t column,
                          int64_t timestamp);
+
+    /// Make a dynamically-allocated erasure for all cells in the rows
+    /// [firstRow, endRow) with timestamps no later than maxTimestamp.
+    /// An empty endRow means the range has no upper bound.
+    Cell makeRowRangeErasure(warp::strref_t firstRow, warp::strref_t endRow,
+                             int64_t maxTimestamp);
+
+    /// Make a dynamically-allocated erasure for all cells in a column
+    /// family of a single row with timestamps no later than
+    /// maxTimestamp.
+    Cell makeFamilyErasure(warp::strref_t row, warp::strref_t family,
+                           int64_t maxTimestamp);
+
+    /// Make a dynamically-allocated merge operand Cell.  The value
+    /// holds the encoded operator and operand (see
+    /// kdi/merge_operator.h).
+    Cell makeMergeOperand(warp::strref_t row, warp::strref_t column,
+                          int64_t timestamp, warp::strref_t value);
+
+    /// Kinds of Cell erasure.  A range erasure hides every cell in
+    /// the rows [getRow(), getValue()) with a timestamp no later than
+    /// its own timestamp, either in all columns or only in the column
+    /// family named by getColumn().  An empty end row means the range
+    /// has no upper bound.
+    enum ErasureKind {
+        NOT_ERASURE,            ///< Regular Cell
+        ERASE_CELL,             ///< Erases the Cell with the same key
+        ERASE_ROWS,             ///< Range erasure over all columns
+        ERASE_FAMILY,           ///< Range erasure over a column family
+    };
 }
 
 //----------------------------------------------------------------------------
@@ -68,6 +98,8 @@ public:
     virtual warp::StringRange getColumnQualifier(void const * data) const;
 
     virtual bool isErasure(void const * data) const;
+    virtual ErasureKind getErasureKind(void const * data) const;
+    virtual bool isMergeOperand(void const * data) const;
 
     virtual bool isLess(void const * data1, void const * data2) const;
     
@@ -197,6 +229,28 @@ public:
         return interp->isErasure(data);
     }
 
+    /// Get the kind of erasure this Cell represents, if any.
+    ErasureKind getErasureKind() const
+    {
+        assert(!isNull());
+        return interp->getErasureKind(data);
+    }
+
+    /// Return true iff this Cell is a row range or column family
+    /// erasure.  Range erasures are also erasures.
+    bool isRangeErasure() const
+    {
+        return getErasureKind() >= ERASE_ROWS;
+    }
+
+    /// Return true iff this Cell is a merge operand to be combined
+    /// with older versions of the same (row, column).
+    bool isMergeOperand() const
+    {
+        assert(!isNull());
+        return interp->isMergeOperand(data);
+    }
+
     /// Release cell data.  Makes this cell null
     void release()
     {
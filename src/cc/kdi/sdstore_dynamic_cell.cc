@@ -150,6 +150,18 @@ public:
     }
 };
 
+//----------------------------------------------------------------------------
+// DynamicCell::MergeInterpreter
+//----------------------------------------------------------------------------
+class DynamicCell::MergeInterpreter : public DynamicCell::Interpreter
+{
+public:
+    bool isMergeOperand(void const * data) const
+    {
+        return true;
+    }
+};
+
 //----------------------------------------------------------------------------
 // DynamicCell
 //----------------------------------------------------------------------------
@@ -157,7 +169,20 @@ Cell DynamicCell::make(strref_t row, strref_t column, int64_t timestamp,
                        strref_t value)
 {
     static Interpreter interp;
+    return make(&interp, row, column, timestamp, value);
+}
+
+Cell DynamicCell::makeMergeOperand(strref_t row, strref_t column,
+                                   int64_t timestamp, strref_t value)
+{
+    static MergeInterpreter interp;
+    return make(&interp, row, column, timestamp, value);
+}
 
+Cell DynamicCell::make(CellInterpreter const * interp,
+                       strref_t row, strref_t column, int64_t timestamp,
+                       strref_t value)
+{
     size_t cellSz = BASE_SIZE + row.size() + column.size() + value.size();
     char * buf = new char[cellSz];
     DynamicCell * cell = reinterpret_cast<DynamicCell *>(buf);
@@ -176,7 +201,7 @@ Cell DynamicCell::make(strref_t row, strref_t column, int64_t timestamp,
     MProf::get().add(cell);
 #endif
 
-    return Cell(&interp, cell);
+    return Cell(interp, cell);
 }
 
 //----------------------------------------------------------------------------
@@ -263,3 +288,101 @@ Cell DynamicCellErasure::make(strref_t row, strref_t column,
 
     return Cell(&interp, cell);
 }
+
+//----------------------------------------------------------------------------
+// DynamicRangeErasure::Interpreter
+//----------------------------------------------------------------------------
+class DynamicRangeErasure::Interpreter : public CellInterpreter
+{
+    static DynamicRangeErasure const * cast(void const * data)
+    {
+        return static_cast<DynamicRangeErasure const *>(data);
+    }
+
+public:
+    // Interpreter interface
+    StringRange getRow(void const * data) const
+    {
+        DynamicRangeErasure const * c = cast(data);
+        return StringRange(c->row, c->col);
+    }
+
+    StringRange getColumn(void const * data) const
+    {
+        DynamicRangeErasure const * c = cast(data);
+        return StringRange(c->col, c->val);
+    }
+
+    StringRange getValue(void const * data) const
+    {
+        DynamicRangeErasure const * c = cast(data);
+        return StringRange(c->val, c->end);
+    }
+
+    int64_t getTimestamp(void const * data) const
+    {
+        return cast(data)->timestamp;
+    }
+
+    bool isErasure(void const * data) const
+    {
+        return true;
+    }
+
+    ErasureKind getErasureKind(void const * data) const
+    {
+        return cast(data)->kind;
+    }
+
+    void addRef(void const * data) const
+    {
+        cast(data)->refCount.increment();
+    }
+
+    void release(void const * data) const
+    {
+        DynamicRangeErasure const * cell = cast(data);
+        if(cell->refCount.decrementAndTest())
+        {
+#ifdef REPORT_CELL_STATISTICS
+            MProf::get().remove(cell);
+#endif
+            char const * buf = reinterpret_cast<char const *>(data);
+            delete[] buf;
+        }
+    }
+};
+
+//----------------------------------------------------------------------------
+// DynamicRangeErasure
+//----------------------------------------------------------------------------
+Cell DynamicRangeErasure::make(ErasureKind kind, strref_t firstRow,
+                               strref_t family, strref_t endRow,
+                               int64_t maxTimestamp)
+{
+    static Interpreter interp;
+
+    assert(kind == ERASE_ROWS || kind == ERASE_FAMILY);
+
+    size_t cellSz = BASE_SIZE + firstRow.size() + family.size() +
+        endRow.size();
+    char * buf = new char[cellSz];
+    DynamicRangeErasure * cell = reinterpret_cast<DynamicRangeErasure *>(buf);
+
+    cell->col = cell->row + firstRow.size();
+    cell->val = cell->col + family.size();
+    cell->end = cell->val + endRow.size();
+    cell->timestamp = maxTimestamp;
+    cell->kind = kind;
+    new (&cell->refCount) warp::AtomicCounter;
+
+    memcpy(cell->row, firstRow.begin(), firstRow.size());
+    memcpy(cell->col, family.begin(),   family.size());
+    memcpy(cell->val, endRow.begin(),   endRow.size());
+
+#ifdef REPORT_CELL_STATISTICS
+    MProf::get().add(cell);
+#endif
+
+    return Cell(&interp, cell);
+}
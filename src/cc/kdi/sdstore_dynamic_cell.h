@@ -33,6 +33,9 @@ namespace sdstore {
     /// A dynamically allocated Cell erasure.
     class DynamicCellErasure;
 
+    /// A dynamically allocated row range or column family erasure.
+    class DynamicRangeErasure;
+
 } // namespace sdstore
 
 
@@ -54,6 +57,7 @@ class sdstore::DynamicCell
     char row[1];
 
     class Interpreter;
+    class MergeInterpreter;
 
     DynamicCell() {}
 
@@ -61,11 +65,20 @@ class sdstore::DynamicCell
     DynamicCell(DynamicCell const & o);
     DynamicCell const & operator=(DynamicCell const & o);
 
+    static Cell make(CellInterpreter const * interp,
+                     warp::strref_t row, warp::strref_t column,
+                     int64_t timestamp, warp::strref_t value);
+
 public:
     /// Make a dynamic Cell
     static Cell make(warp::strref_t row, warp::strref_t column,
                      int64_t timestamp, warp::strref_t value);
 
+    /// Make a dynamic merge operand Cell.  It has the same layout as
+    /// a regular Cell.
+    static Cell makeMergeOperand(warp::strref_t row, warp::strref_t column,
+                                 int64_t timestamp, warp::strref_t value);
+
     size_t size() const
     {
         return end - reinterpret_cast<char const *>(this);
@@ -109,4 +122,44 @@ public:
 };
 
 
+//----------------------------------------------------------------------------
+// DynamicRangeErasure
+//----------------------------------------------------------------------------
+class sdstore::DynamicRangeErasure
+{
+    enum {
+        BASE_SIZE = 3*sizeof(char *) + sizeof(int64_t) +
+                    sizeof(warp::AtomicCounter) + sizeof(int)
+    };
+
+    char * col;
+    char * val;
+    char * end;
+    int64_t timestamp;
+    mutable warp::AtomicCounter refCount;
+    ErasureKind kind;
+    char row[1];
+
+    class Interpreter;
+
+    DynamicRangeErasure() {}
+
+    // Unimplemented
+    DynamicRangeErasure(DynamicRangeErasure const & o);
+    DynamicRangeErasure const & operator=(DynamicRangeErasure const & o);
+
+public:
+    /// Make a dynamic range erasure.  The family is only used for
+    /// ERASE_FAMILY erasures.
+    static Cell make(ErasureKind kind, warp::strref_t firstRow,
+                     warp::strref_t family, warp::strref_t endRow,
+                     int64_t maxTimestamp);
+
+    size_t size() const
+    {
+        return end - reinterpret_cast<char const *>(this);
+    }
+};
+
+
 #endif // SDSTORE_DYNAMIC_CELL_H
@@ -19,6 +19,7 @@
 //----------------------------------------------------------------------------
 
 #include <kdi/synchronized_table.h>
+#include <kdi/merge_operator.h>
 #include <ex/exception.h>
 #include <boost/thread/condition.hpp>
 #include <queue>
@@ -174,7 +175,12 @@ class SynchronizedTable::BufferedTable
         while(!buffer.empty())
         {
             Cell const & x = buffer.front();
-            if(x.isErasure())
+            if(x.isRangeErasure() || x.isMergeOperand())
+            {
+                // Range erasure or merge operand
+                t->insert(x);
+            }
+            else if(x.isErasure())
             {
                 // Erase operation
                 t->erase(
@@ -234,6 +240,30 @@ public:
         if(buffer.size() >= mutationBufferSize)
             flush();
     }
+
+    void eraseRowRange(strref_t firstRow, strref_t endRow,
+                       int64_t maxTimestamp)
+    {
+        buffer.push(makeRowRangeErasure(firstRow, endRow, maxTimestamp));
+        if(buffer.size() >= mutationBufferSize)
+            flush();
+    }
+
+    void eraseColumnFamily(strref_t row, strref_t family,
+                           int64_t maxTimestamp)
+    {
+        buffer.push(makeFamilyErasure(row, family, maxTimestamp));
+        if(buffer.size() >= mutationBufferSize)
+            flush();
+    }
+
+    void merge(strref_t row, strref_t column, int64_t timestamp,
+               strref_t op, strref_t operand)
+    {
+        buffer.push(makeMergeCell(row, column, timestamp, op, operand));
+        if(buffer.size() >= mutationBufferSize)
+            flush();
+    }
     
     CellStreamPtr scan(ScanPredicate const & pred) const
     {
@@ -258,6 +288,13 @@ public:
         return p;
     }
 
+    size_t get(strref_t row, strref_t column, size_t maxVersions,
+               std::vector<Cell> & out) const
+    {
+        // Point lookups are short, so there's nothing to buffer
+        return table->get(row, column, maxVersions, out);
+    }
+
     void sync()
     {
         // Flush current buffer before syncing
@@ -308,6 +345,28 @@ void SynchronizedTable::erase(strref_t row, strref_t column, int64_t timestamp)
     table->erase(row, column, timestamp);
 }
 
+void SynchronizedTable::eraseRowRange(strref_t firstRow, strref_t endRow,
+                                      int64_t maxTimestamp)
+{
+    lock_t l(mutex);
+    table->eraseRowRange(firstRow, endRow, maxTimestamp);
+}
+
+void SynchronizedTable::eraseColumnFamily(strref_t row, strref_t family,
+                                          int64_t maxTimestamp)
+{
+    lock_t l(mutex);
+    table->eraseColumnFamily(row, family, maxTimestamp);
+}
+
+void SynchronizedTable::merge(strref_t row, strref_t column,
+                              int64_t timestamp, strref_t op,
+                              strref_t operand)
+{
+    lock_t l(mutex);
+    table->merge(row, column, timestamp, op, operand);
+}
+
 CellStreamPtr SynchronizedTable::scan(ScanPredicate const & pred) const
 {
     // Grab table mutex so we can create a scan from the underlying
@@ -324,6 +383,16 @@ CellStreamPtr SynchronizedTable::scan(ScanPredicate const & pred) const
     return p;
 }
 
+size_t SynchronizedTable::get(strref_t row, strref_t column,
+                              size_t maxVersions,
+                              std::vector<Cell> & out) const
+{
+    // Point lookups complete immediately, so just hold the mutex for
+    // the duration
+    lock_t l(mutex);
+    return table->get(row, column, maxVersions, out);
+}
+
 void SynchronizedTable::sync()
 {
     // Grab mutex before syncing underlying table.
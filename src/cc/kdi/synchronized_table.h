@@ -81,10 +81,24 @@ public:
 
     virtual void erase(strref_t row, strref_t column, int64_t timestamp);
 
+    virtual void eraseRowRange(strref_t firstRow, strref_t endRow,
+                               int64_t maxTimestamp);
+    virtual void eraseColumnFamily(strref_t row, strref_t family,
+                                   int64_t maxTimestamp);
+
+    /// Forwarded under the table lock, so a read-modify-write merge
+    /// in the underlying table is atomic.
+    virtual void merge(strref_t row, strref_t column, int64_t timestamp,
+                       strref_t op, strref_t operand);
+
     virtual CellStreamPtr scan(ScanPredicate const & pred) const;
     virtual void sync();
     virtual RowIntervalStreamPtr scanIntervals() const;
 
+    using Table::get;
+    virtual size_t get(strref_t row, strref_t column, size_t maxVersions,
+                       std::vector<Cell> & out) const;
+
     /// Create a buffered interface to the SynchronizedTable table,
     /// using default buffer sizes.  Buffering is useful for reducing
     /// locking overhead.  While buffered tables are thread-safe for
@@ -20,10 +20,20 @@
 
 #include <kdi/table.h>
 #include <kdi/scan_predicate.h>
+#include <kdi/predicate_cache.h>
 #include <kdi/table_factory.h>
 #include <kdi/RowInterval.h>
+#include <kdi/range_erasure.h>
+#include <kdi/merge_operator.h>
+#include <kdi/scan_aggregate.h>
+#include <warp/interval.h>
+#include <ex/exception.h>
 
 using namespace kdi;
+using namespace warp;
+using namespace ex;
+using std::string;
+using std::vector;
 
 namespace
 {
@@ -42,17 +52,113 @@ namespace
             return true;
         }
     };
+
+    /// Scan for the cells hidden by a range erasure and erase them
+    /// one at a time.
+    void eraseCovered(Table & table, Cell const & erasure)
+    {
+        ScanPredicate pred;
+        pred.setRowPredicate(
+            IntervalSet<string>().add(getRangeErasureRows(erasure)));
+        pred.setTimePredicate(
+            IntervalSet<int64_t>().add(
+                Interval<int64_t>().unsetLowerBound().setUpperBound(
+                    erasure.getTimestamp(), BT_INCLUSIVE)));
+        if(erasure.getErasureKind() == ERASE_FAMILY)
+        {
+            // Columns in the family sort between "family:" and
+            // "family;"
+            string family = str(erasure.getColumn());
+            pred.setColumnPredicate(
+                IntervalSet<string>().add(
+                    Interval<string>()
+                    .setLowerBound(family + ':', BT_INCLUSIVE)
+                    .setUpperBound(family + ';', BT_EXCLUSIVE)));
+        }
+
+        CellStreamPtr s = table.scan(pred);
+        Cell x;
+        while(s->get(x))
+            table.erase(x.getRow(), x.getColumn(), x.getTimestamp());
+    }
 }
 
 //----------------------------------------------------------------------------
 // Table
 //----------------------------------------------------------------------------
+void Table::eraseRowRange(strref_t firstRow, strref_t endRow,
+                          int64_t maxTimestamp)
+{
+    eraseCovered(*this, makeRowRangeErasure(firstRow, endRow, maxTimestamp));
+}
+
+void Table::eraseRow(strref_t row, int64_t maxTimestamp)
+{
+    string endRow(str(row));
+    endRow += '\0';
+    eraseRowRange(row, endRow, maxTimestamp);
+}
+
+void Table::eraseColumnFamily(strref_t row, strref_t family,
+                              int64_t maxTimestamp)
+{
+    eraseCovered(*this, makeFamilyErasure(row, family, maxTimestamp));
+}
+
+void Table::merge(strref_t row, strref_t column, int64_t timestamp,
+                  strref_t op, strref_t operand)
+{
+    Cell x = makeMergeCell(row, column, timestamp, op, operand);
+
+    // Fold over the newest version older than the operand, like a
+    // scan would.  The result replaces any version at the same
+    // timestamp.
+    ScanPredicate pred;
+    pred.setRowPredicate(
+        IntervalSet<string>().add(Interval<string>().setPoint(str(row))));
+    pred.setColumnPredicate(
+        IntervalSet<string>().add(Interval<string>().setPoint(str(column))));
+    pred.setTimePredicate(
+        IntervalSet<int64_t>().add(
+            Interval<int64_t>().unsetLowerBound().setUpperBound(
+                timestamp, BT_EXCLUSIVE)));
+    pred.setMaxHistory(1);
+
+    // Make our own pending writes visible before reading
+    sync();
+    Cell base;
+    scan(pred)->get(base);
+    Cell folded = foldMergeOperands(vector<Cell>(1, x), base);
+
+    set(row, column, timestamp, folded.getValue());
+}
+
 void Table::insert(Cell const & x)
 {
-    if(x.isErasure())
-        erase(x.getRow(), x.getColumn(), x.getTimestamp());
-    else
-        set(x.getRow(), x.getColumn(), x.getTimestamp(), x.getValue());
+    if(x.isMergeOperand())
+    {
+        StringRange op, operand;
+        if(!decodeMergeOperand(x.getValue(), op, operand))
+            raise<ValueError>("malformed merge operand: %s", x);
+        merge(x.getRow(), x.getColumn(), x.getTimestamp(), op, operand);
+        return;
+    }
+
+    switch(x.getErasureKind())
+    {
+        case NOT_ERASURE:
+            set(x.getRow(), x.getColumn(), x.getTimestamp(), x.getValue());
+            break;
+        case ERASE_CELL:
+            erase(x.getRow(), x.getColumn(), x.getTimestamp());
+            break;
+        case ERASE_ROWS:
+            eraseRowRange(x.getRow(), x.getValue(), x.getTimestamp());
+            break;
+        case ERASE_FAMILY:
+            eraseColumnFamily(x.getRow(), x.getColumn(), x.getTimestamp());
+            break;
+    }
 }
 
 CellStreamPtr Table::scan() const
@@ -62,7 +168,60 @@ CellStreamPtr Table::scan() const
 
 CellStreamPtr Table::scan(strref_t predExpr) const
 {
-    return scan(ScanPredicate(predExpr));
+    return scan(PredicateCache::getGlobal().get(predExpr));
+}
+
+size_t Table::get(strref_t row, strref_t column, size_t maxVersions,
+                  vector<Cell> & out) const
+{
+    // Build the predicate directly rather than parsing an expression
+    ScanPredicate pred;
+    pred.setRowPredicate(
+        IntervalSet<string>().add(Interval<string>().setPoint(str(row))));
+    pred.setColumnPredicate(
+        IntervalSet<string>().add(Interval<string>().setPoint(str(column))));
+    pred.setMaxHistory(int(maxVersions));
+
+    size_t n = 0;
+    CellStreamPtr s = scan(pred);
+    Cell x;
+    while(s->get(x))
+    {
+        out.push_back(x);
+        ++n;
+    }
+    return n;
+}
+
+bool Table::get(strref_t row, strref_t column, Cell & x) const
+{
+    vector<Cell> cells;
+    if(!get(row, column, 1, cells))
+        return false;
+    x = cells.front();
+    return true;
+}
+
+void Table::multiGet(vector<RowColumn> const & keys, size_t maxVersions,
+                     vector<Cell> & out) const
+{
+    for(vector<RowColumn>::const_iterator i = keys.begin();
+        i != keys.end(); ++i)
+    {
+        get(i->first, i->second, maxVersions, out);
+    }
+}
+
+void Table::aggregate(ScanPredicate const & pred, ScanAggregate & agg) const
+{
+    // Start from a clean scan position, so the first row isn't
+    // taken for the last row of whatever agg saw before
+    ScanAggregate part(agg.getSpec());
+    CellStreamPtr s = scan(pred);
+    Cell x;
+    while(s->get(x))
+        part.add(x);
+    agg.merge(part);
 }
 
 TablePtr Table::open(std::string const & uri)
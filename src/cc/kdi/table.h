@@ -26,6 +26,8 @@
 #include <flux/stream.h>
 #include <boost/shared_ptr.hpp>
 #include <string>
+#include <vector>
+#include <utility>
 
 namespace kdi {
 
@@ -44,10 +46,16 @@ namespace kdi {
     // Forward declaration
     class RowInterval;
 
+    // Forward declaration
+    class ScanAggregate;
+
     // Stream typedefs
     typedef flux::Stream<RowInterval> RowIntervalStream;
     typedef boost::shared_ptr<RowIntervalStream> RowIntervalStreamPtr;
 
+    /// A (row, column) pair naming a cell for point lookups
+    typedef std::pair<std::string, std::string> RowColumn;
+
 } // namespace kdi
 
 //----------------------------------------------------------------------------
@@ -73,8 +81,49 @@ public:
     /// effect.
     virtual void erase(strref_t row, strref_t column, int64_t timestamp) = 0;
 
-    /// Insert a cell or cell erasure into the table.  The default
-    /// implementation of this function calls either set() or erase().
+    /// Erase every cell in the rows [firstRow, endRow) with a
+    /// timestamp no later than maxTimestamp.  An empty endRow means
+    /// the range has no upper bound.  Like erase(), this only affects
+    /// cells already in the table: cells set later are kept, even
+    /// with an older timestamp.  The default implementation scans
+    /// the range and erases each cell it finds.  Implementations
+    /// that can store range erasures should override it.
+    virtual void eraseRowRange(strref_t firstRow, strref_t endRow,
+                               int64_t maxTimestamp);
+
+    /// Erase every cell in the given row with a timestamp no later
+    /// than maxTimestamp.  This is a row range erasure covering a
+    /// single row.
+    void eraseRow(strref_t row, int64_t maxTimestamp);
+
+    /// Erase every cell in the given column family of a row with a
+    /// timestamp no later than maxTimestamp.  As with
+    /// eraseRowRange(), the default implementation scans for the
+    /// cells and erases them one at a time.
+    virtual void eraseColumnFamily(strref_t row, strref_t family,
+                                   int64_t maxTimestamp);
+
+    /// Combine an operand with the current value of a cell using a
+    /// merge operator (see kdi/merge_operator.h), e.g. "add" to
+    /// increment a counter.  The result is visible at the given
+    /// timestamp.  Raises ValueError if the operator is unknown or
+    /// the operand isn't valid for it.  The default implementation
+    /// syncs the table, reads the newest version of the cell older
+    /// than the timestamp, and sets the combined value.  It isn't atomic with respect to
+    /// other writers.  Implementations that can store merge operands
+    /// should override it, so the operand is written without a read
+    /// and folded during scans and compactions.  Like any other
+    /// write, an operand replaces whatever was written before with
+    /// the same row, column, and timestamp, so two operands for the
+    /// same cell and timestamp don't both count: the last one wins.
+    /// Increments that must all be applied need distinct timestamps.
+    virtual void merge(strref_t row, strref_t column, int64_t timestamp,
+                       strref_t op, strref_t operand);
+
+    /// Insert a cell, cell erasure, range erasure, or merge operand
+    /// into the table.  The default implementation of this function
+    /// calls set(), erase(), eraseRowRange(), eraseColumnFamily(), or
+    /// merge().
     virtual void insert(Cell const & x);
 
     /// Scan over a subset of the cells in the table, visited in cell
@@ -98,6 +147,39 @@ public:
     /// function to save typing.
     CellStreamPtr scan(strref_t predExpr) const;
 
+    /// Look up the cells with the given row and column and append
+    /// them to \c out, newest timestamp first.  At most \c
+    /// maxVersions cells are appended, or all of them if \c
+    /// maxVersions is zero.  Returns the number of cells appended.
+    /// The same consistency rules as scan() apply.  The default
+    /// implementation performs a point scan, but implementations
+    /// with a faster path for single cells should override it.
+    virtual size_t get(strref_t row, strref_t column, size_t maxVersions,
+                       std::vector<Cell> & out) const;
+
+    /// Get the newest version of the cell with the given row and
+    /// column.  Returns false if there is no such cell.
+    bool get(strref_t row, strref_t column, Cell & x) const;
+
+    /// Look up the cells for each of the given (row, column) keys, as
+    /// in get().  Cells are appended to \c out in key order.  The
+    /// default implementation calls get() for each key.
+    /// Implementations with per-call overhead (e.g. a network round
+    /// trip) should override it to batch the lookups.
+    virtual void multiGet(std::vector<RowColumn> const & keys,
+                          size_t maxVersions,
+                          std::vector<Cell> & out) const;
+
+    /// Fold the cells matching the predicate into \c agg, as
+    /// configured by its spec.  The cells are summarized on their
+    /// own and then merged, so a row is counted again even if it was
+    /// the last one \c agg saw.  The default implementation scans
+    /// the cells and adds them locally.  Implementations that live
+    /// on the far side of a network should override it to compute
+    /// the aggregate next to the data and only return the summary.
+    virtual void aggregate(ScanPredicate const & pred,
+                           ScanAggregate & agg) const;
+
     /// Block until all mutations on this table have been successfully
     /// committed.  In the event certain mutations have failed, this
     /// may throw an exception.
@@ -67,6 +67,16 @@ namespace unittest {
         return o;
     }
 
+    test_out_t & operator<<(test_out_t & o, std::vector<Cell> const & v)
+    {
+        for(std::vector<Cell>::const_iterator i = v.begin();
+            i != v.end(); ++i)
+        {
+            o << *i;
+        }
+        return o;
+    }
+
     test_out_t & operator<<(test_out_t & o, Table const & t)
     {
         o << *t.scan();
@@ -273,6 +283,44 @@ namespace unittest {
                         "(r4,c2,2,v422)"
                         ));
 
+        // Point lookups
+        {
+            std::vector<Cell> cells;
+            BOOST_CHECK_EQUAL(table->get("r1", "c3", 0, cells), 2u);
+            BOOST_CHECK((out << cells).is_equal(
+                            "(r1,c3,4,v134)"
+                            "(r1,c3,3,v133-2)"
+                            ));
+
+            cells.clear();
+            BOOST_CHECK_EQUAL(table->get("r3", "c2", 1, cells), 1u);
+            BOOST_CHECK((out << cells).is_equal("(r3,c2,3,v323)"));
+
+            // Erased and missing cells
+            cells.clear();
+            BOOST_CHECK_EQUAL(table->get("r3", "c0", 0, cells), 1u);
+            BOOST_CHECK_EQUAL(table->get("r1", "c4", 0, cells), 0u);
+            BOOST_CHECK_EQUAL(table->get("r9", "c0", 0, cells), 0u);
+            BOOST_CHECK((out << cells).is_equal("(r3,c0,1,v301-2)"));
+
+            Cell x;
+            BOOST_CHECK(table->get("r0", "c4", x));
+            BOOST_CHECK((out << x).is_equal("(r0,c4,3,v043-2)"));
+            BOOST_CHECK(!table->get("r0", "c5", x));
+
+            std::vector<RowColumn> keys;
+            keys.push_back(RowColumn("r4", "c2"));
+            keys.push_back(RowColumn("r0", "c0"));
+            keys.push_back(RowColumn("r2", "c1"));
+            cells.clear();
+            table->multiGet(keys, 0, cells);
+            BOOST_CHECK((out << cells).is_equal(
+                            "(r4,c2,4,v424-2)"
+                            "(r4,c2,2,v422)"
+                            "(r2,c1,2,v212)"
+                            ));
+        }
+
         // Scan the table with various predicates
         BOOST_CHECK((out << *(table->scan(""))).is_equal(
                         "(r0,c1,0,v010-2)"
@@ -0,0 +1,224 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-09
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <kdi/tablet/AdmissionController.h>
+#include <warp/EnvironmentVariable.h>
+#include <warp/timer.h>
+#include <warp/log.h>
+#include <boost/thread/xtime.hpp>
+
+using namespace kdi;
+using namespace kdi::tablet;
+using namespace warp;
+using namespace ex;
+using namespace std;
+
+namespace {
+
+    char const * const RESOURCE_NAMES[AdmissionController::N_RESOURCES] = {
+        "memoryBytes",
+        "pendingSerializations",
+        "maxTabletFragments"
+    };
+
+    boost::xtime makeDeadline(size_t ms)
+    {
+        boost::xtime xt;
+        boost::xtime_get(&xt, boost::TIME_UTC);
+        xt.sec += ms / 1000;
+        xt.nsec += (ms % 1000) * 1000000;
+        if(xt.nsec >= 1000000000)
+        {
+            xt.sec += 1;
+            xt.nsec -= 1000000000;
+        }
+        return xt;
+    }
+}
+
+//----------------------------------------------------------------------------
+// AdmissionController
+//----------------------------------------------------------------------------
+AdmissionController::AdmissionController(warp::StatTracker * tracker) :
+    tracker(tracker),
+    maxDelayMs(0),
+    maxWaitMs(0),
+    nWaiting(0)
+{
+    EX_CHECK_NULL(tracker);
+
+    for(int i = 0; i < N_RESOURCES; ++i)
+        limits[i].level = 0;
+
+    // The SharedLogger serializes 128M table groups and can queue two
+    // of them, so the defaults start pushing back once a second group
+    // is waiting and refuse writes before the commit thread has to
+    // block on the serialize queue.
+    typedef EnvironmentVariable env;
+    setLimits(MEMORY_BYTES,
+              env::getSize("KDI_THROTTLE_MEMORY_SOFT", size_t(384) << 20),
+              env::getSize("KDI_THROTTLE_MEMORY_HARD", size_t(512) << 20));
+    setLimits(PENDING_SERIALIZATIONS,
+              env::getSize("KDI_THROTTLE_SERIALIZE_SOFT", 2),
+              env::getSize("KDI_THROTTLE_SERIALIZE_HARD", 3));
+    setLimits(TABLET_FRAGMENTS,
+              env::getSize("KDI_THROTTLE_FRAGMENTS_SOFT", 32),
+              env::getSize("KDI_THROTTLE_FRAGMENTS_HARD", 64));
+    setDelays(env::getSize("KDI_THROTTLE_MAX_DELAY_MS", 500),
+              env::getSize("KDI_THROTTLE_MAX_WAIT_MS", 10000));
+}
+
+void AdmissionController::setLimits(Resource r, size_t soft, size_t hard)
+{
+    if(r < 0 || r >= N_RESOURCES)
+        raise<ValueError>("invalid resource: %d", r);
+    if(soft >= hard)
+        raise<ValueError>("soft limit for %s must be less than hard limit: "
+                          "soft=%d, hard=%d", RESOURCE_NAMES[r], soft, hard);
+
+    log("AdmissionController: %s limits: soft=%d, hard=%d",
+        RESOURCE_NAMES[r], soft, hard);
+
+    lock_t lock(mutex);
+    limits[r].soft = soft;
+    limits[r].hard = hard;
+    levelChanged(lock, r);
+}
+
+void AdmissionController::setDelays(size_t maxDelayMs, size_t maxWaitMs)
+{
+    lock_t lock(mutex);
+    this->maxDelayMs = maxDelayMs;
+    this->maxWaitMs = maxWaitMs;
+}
+
+void AdmissionController::setLevel(Resource r, size_t level)
+{
+    lock_t lock(mutex);
+    limits[r].level = level;
+    levelChanged(lock, r);
+}
+
+void AdmissionController::addLevel(Resource r, int64_t delta)
+{
+    lock_t lock(mutex);
+    if(delta < 0 && size_t(-delta) > limits[r].level)
+        limits[r].level = 0;
+    else
+        limits[r].level += delta;
+    levelChanged(lock, r);
+}
+
+size_t AdmissionController::getLevel(Resource r) const
+{
+    lock_t lock(mutex);
+    return limits[r].level;
+}
+
+double AdmissionController::getPressure(lock_t const & lock) const
+{
+    double pressure = 0;
+    for(int i = 0; i < N_RESOURCES; ++i)
+    {
+        Limit const & l = limits[i];
+        if(l.level <= l.soft)
+            continue;
+
+        double p = double(l.level - l.soft) / (l.hard - l.soft);
+        if(p > pressure)
+            pressure = p;
+    }
+    return pressure;
+}
+
+void AdmissionController::levelChanged(lock_t const & lock, Resource r)
+{
+    tracker->set(string("Throttle.") + RESOURCE_NAMES[r], limits[r].level);
+
+    if(nWaiting && limits[r].level < limits[r].hard)
+        belowHardCond.notify_all();
+}
+
+void AdmissionController::reportDelay(std::string const & client,
+                                      size_t delayMs, bool rejected)
+{
+    string prefix = "Throttle.client." + client;
+    tracker->add("Throttle.delayMs", delayMs);
+    tracker->add(prefix + ".delayMs", delayMs);
+    if(rejected)
+    {
+        tracker->add("Throttle.nRejected", 1);
+        tracker->add(prefix + ".nRejected", 1);
+    }
+    else
+    {
+        tracker->add("Throttle.nDelayed", 1);
+        tracker->add(prefix + ".nDelayed", 1);
+    }
+}
+
+size_t AdmissionController::admit(std::string const & client)
+{
+    lock_t lock(mutex);
+
+    double pressure = getPressure(lock);
+    if(pressure <= 0)
+        return 0;
+
+    WallTimer timer;
+    bool rejected = false;
+    if(pressure < 1)
+    {
+        // Between the soft and hard limits.  Slow the client down in
+        // proportion to how close we are to the hard limit.
+        size_t delayMs = size_t(pressure * maxDelayMs);
+        lock.unlock();
+        boost::thread::sleep(makeDeadline(delayMs));
+    }
+    else
+    {
+        // At the hard limit.  Wait for the serializer or compactor to
+        // catch up, but give up eventually so the client can back off
+        // instead of holding a dispatch thread forever.
+        boost::xtime deadline = makeDeadline(maxWaitMs);
+        ++nWaiting;
+        while(getPressure(lock) >= 1)
+        {
+            if(!belowHardCond.timed_wait(lock, deadline))
+                break;
+        }
+        --nWaiting;
+        rejected = (getPressure(lock) >= 1);
+        lock.unlock();
+    }
+
+    size_t delayMs = size_t(timer.getElapsedNs() / 1000000);
+    reportDelay(client, delayMs, rejected);
+
+    if(rejected)
+    {
+        log("AdmissionController: rejected write from %s after %d ms",
+            client, delayMs);
+        raise<AdmissionRejectedError>(
+            "server is over its write limits, try again later");
+    }
+
+    return delayMs;
+}
@@ -0,0 +1,141 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-09
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#ifndef KDI_TABLET_ADMISSIONCONTROLLER_H
+#define KDI_TABLET_ADMISSIONCONTROLLER_H
+
+#include <warp/StatTracker.h>
+#include <warp/string_range.h>
+#include <ex/exception.h>
+#include <boost/thread.hpp>
+#include <boost/noncopyable.hpp>
+#include <string>
+
+namespace kdi {
+namespace tablet {
+
+    class AdmissionController;
+
+    EX_DECLARE_EXCEPTION(AdmissionRejectedError, ex::RuntimeError);
+
+} // namespace tablet
+} // namespace kdi
+
+//----------------------------------------------------------------------------
+// AdmissionController
+//----------------------------------------------------------------------------
+/// Write throttle for the tablet server.  The SharedLogger and
+/// SharedCompactor report resource levels as they change, and
+/// mutation requests call admit() before applying anything.
+///
+/// Each resource has a soft and a hard limit.  Below the soft limit,
+/// requests are admitted immediately.  Between the soft and hard
+/// limits, requests are delayed in proportion to how far past the
+/// soft limit the worst resource is.  At the hard limit, requests
+/// wait for the level to drop and are rejected with an
+/// AdmissionRejectedError if it doesn't drop in time.  Clients are
+/// expected to back off and retry rejected requests.
+///
+/// Limits and delays are read from the environment:
+///   KDI_THROTTLE_MEMORY_SOFT, KDI_THROTTLE_MEMORY_HARD
+///   KDI_THROTTLE_SERIALIZE_SOFT, KDI_THROTTLE_SERIALIZE_HARD
+///   KDI_THROTTLE_FRAGMENTS_SOFT, KDI_THROTTLE_FRAGMENTS_HARD
+///   KDI_THROTTLE_MAX_DELAY_MS, KDI_THROTTLE_MAX_WAIT_MS
+class kdi::tablet::AdmissionController
+    : private boost::noncopyable
+{
+public:
+    enum Resource
+    {
+        /// Bytes of mutations held in memory tables, including
+        /// tables waiting to be serialized
+        MEMORY_BYTES = 0,
+
+        /// Memory table groups queued or running for serialization
+        PENDING_SERIALIZATIONS,
+
+        /// Longest fragment chain of any tablet in the FragDag
+        TABLET_FRAGMENTS,
+
+        N_RESOURCES
+    };
+
+private:
+    typedef boost::mutex::scoped_lock lock_t;
+
+    struct Limit
+    {
+        size_t level;
+        size_t soft;
+        size_t hard;
+    };
+
+    warp::StatTracker * tracker;
+    Limit limits[N_RESOURCES];
+    size_t maxDelayMs;
+    size_t maxWaitMs;
+
+    mutable boost::mutex mutex;
+    boost::condition belowHardCond;
+    size_t nWaiting;
+
+    /// Get the current pressure: 0 if all resources are below their
+    /// soft limits, 1 or more if any resource is at its hard limit,
+    /// and the fraction of the way from soft to hard for the worst
+    /// resource otherwise.
+    double getPressure(lock_t const & lock) const;
+
+    /// Update the level gauge for a resource and wake any requests
+    /// waiting on the hard limit.
+    void levelChanged(lock_t const & lock, Resource r);
+
+    /// Record time spent throttled by a client.
+    void reportDelay(std::string const & client, size_t delayMs,
+                     bool rejected);
+
+public:
+    explicit AdmissionController(warp::StatTracker * tracker);
+
+    /// Set the soft and hard limits for a resource.  The soft limit
+    /// must be less than the hard limit.
+    void setLimits(Resource r, size_t soft, size_t hard);
+
+    /// Set the maximum delay applied between the soft and hard
+    /// limits, and the time to wait at the hard limit before
+    /// rejecting a request.
+    void setDelays(size_t maxDelayMs, size_t maxWaitMs);
+
+    /// Set the current level of a resource.
+    void setLevel(Resource r, size_t level);
+
+    /// Adjust the current level of a resource.
+    void addLevel(Resource r, int64_t delta);
+
+    /// Get the current level of a resource.
+    size_t getLevel(Resource r) const;
+
+    /// Admit a mutation request from the named client, delaying it
+    /// if the server is under write pressure.  Returns the number of
+    /// milliseconds the request was delayed.  Throws
+    /// AdmissionRejectedError if the request was rejected.
+    size_t admit(std::string const & client);
+};
+
+#endif // KDI_TABLET_ADMISSIONCONTROLLER_H
@@ -0,0 +1,168 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <kdi/tablet/AdmissionController.h>
+#include <warp/StatTracker.h>
+#include <unittest/main.h>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/xtime.hpp>
+#include <boost/bind.hpp>
+#include <map>
+#include <string>
+
+using namespace kdi;
+using namespace kdi::tablet;
+using namespace warp;
+using namespace ex;
+using namespace std;
+
+namespace
+{
+    typedef AdmissionController AC;
+
+    /// Remember the latest value of each stat
+    class TestStatTracker : public StatTracker
+    {
+        boost::mutex mutex;
+        map<string, int64_t> stats;
+
+    public:
+        void set(strref_t name, int64_t value)
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            stats[str(name)] = value;
+        }
+
+        void add(strref_t name, int64_t delta)
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            stats[str(name)] += delta;
+        }
+
+        void addSample(strref_t name, int64_t value) {}
+
+        int64_t get(string const & name)
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            return stats[name];
+        }
+    };
+
+    void sleepMs(size_t ms)
+    {
+        boost::xtime xt;
+        boost::xtime_get(&xt, boost::TIME_UTC);
+        xt.nsec += ms * 1000000;
+        while(xt.nsec >= 1000000000)
+        {
+            xt.sec += 1;
+            xt.nsec -= 1000000000;
+        }
+        boost::thread::sleep(xt);
+    }
+
+    /// Drop a resource to a level after a delay
+    void setLevelLater(AC * ac, AC::Resource r, size_t level, size_t ms)
+    {
+        sleepMs(ms);
+        ac->setLevel(r, level);
+    }
+}
+
+BOOST_AUTO_UNIT_TEST(levels_test)
+{
+    TestStatTracker tracker;
+    AC ac(&tracker);
+
+    ac.setLevel(AC::MEMORY_BYTES, 100);
+    ac.addLevel(AC::MEMORY_BYTES, 50);
+    BOOST_CHECK_EQUAL(ac.getLevel(AC::MEMORY_BYTES), 150u);
+    BOOST_CHECK_EQUAL(tracker.get("Throttle.memoryBytes"), 150);
+
+    // Levels don't go below zero
+    ac.addLevel(AC::MEMORY_BYTES, -200);
+    BOOST_CHECK_EQUAL(ac.getLevel(AC::MEMORY_BYTES), 0u);
+
+    // The soft limit has to be below the hard one
+    BOOST_CHECK_THROW(ac.setLimits(AC::TABLET_FRAGMENTS, 10, 10),
+                      ValueError);
+    BOOST_CHECK_THROW(ac.setLimits(AC::N_RESOURCES, 1, 2), ValueError);
+}
+
+BOOST_AUTO_UNIT_TEST(admit_test)
+{
+    TestStatTracker tracker;
+    AC ac(&tracker);
+    ac.setLimits(AC::TABLET_FRAGMENTS, 10, 20);
+    ac.setDelays(400, 100);
+
+    // Up to the soft limit, requests go straight through
+    ac.setLevel(AC::TABLET_FRAGMENTS, 10);
+    BOOST_CHECK_EQUAL(ac.admit("client"), 0u);
+    BOOST_CHECK_EQUAL(tracker.get("Throttle.nDelayed"), 0);
+
+    // Halfway to the hard limit, they get half the maximum delay
+    ac.setLevel(AC::TABLET_FRAGMENTS, 15);
+    size_t delayMs = ac.admit("client");
+    BOOST_CHECK(delayMs >= 190);
+    BOOST_CHECK(delayMs < 400);
+    BOOST_CHECK_EQUAL(tracker.get("Throttle.nDelayed"), 1);
+    BOOST_CHECK_EQUAL(tracker.get("Throttle.client.client.nDelayed"), 1);
+
+    // The worst resource sets the delay
+    ac.setLimits(AC::MEMORY_BYTES, 1000, 2000);
+    ac.setLevel(AC::MEMORY_BYTES, 1900);
+    delayMs = ac.admit("client");
+    BOOST_CHECK(delayMs >= 350);
+    BOOST_CHECK(delayMs < 700);
+    ac.setLevel(AC::MEMORY_BYTES, 0);
+
+    // At the hard limit, requests are rejected once the wait runs out
+    ac.setLevel(AC::TABLET_FRAGMENTS, 20);
+    BOOST_CHECK_THROW(ac.admit("other"), AdmissionRejectedError);
+    BOOST_CHECK_EQUAL(tracker.get("Throttle.nRejected"), 1);
+    BOOST_CHECK_EQUAL(tracker.get("Throttle.client.other.nRejected"), 1);
+    BOOST_CHECK(tracker.get("Throttle.client.other.delayMs") >= 90);
+}
+
+BOOST_AUTO_UNIT_TEST(release_test)
+{
+    TestStatTracker tracker;
+    AC ac(&tracker);
+    ac.setLimits(AC::PENDING_SERIALIZATIONS, 2, 3);
+    ac.setDelays(400, 10000);
+    ac.setLevel(AC::PENDING_SERIALIZATIONS, 3);
+
+    // A request waiting at the hard limit is let through as soon as
+    // the level drops back below it
+    boost::thread t(
+        boost::bind(&setLevelLater, &ac, AC::PENDING_SERIALIZATIONS,
+                    size_t(1), size_t(100)));
+    size_t delayMs = ac.admit("client");
+    t.join();
+
+    BOOST_CHECK(delayMs >= 90);
+    BOOST_CHECK(delayMs < 5000);
+    BOOST_CHECK_EQUAL(tracker.get("Throttle.nRejected"), 0);
+    BOOST_CHECK_EQUAL(tracker.get("Throttle.nDelayed"), 1);
+
+    // Once below the soft limit, nothing is held up
+    BOOST_CHECK_EQUAL(ac.admit("client"), 0u);
+}
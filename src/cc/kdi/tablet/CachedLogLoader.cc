@@ -24,6 +24,7 @@
 #include <kdi/local/disk_table.h>
 #include <kdi/tablet/LogReader.h>
 #include <kdi/cell.h>
+#include <kdi/range_erasure.h>
 #include <warp/uri.h>
 #include <warp/log.h>
 #include <ex/exception.h>
@@ -67,15 +68,36 @@ void CachedLogLoader::LogInfo::serializeLog(std::string const & logUri,
 
     log("CachedLogLoader: loading table %s from log %s", tableName, logUri);
 
-    // Read the log cells into a vector
+    // Read the log cells into a vector.  Range erasures are kept
+    // apart since they don't take part in the cell ordering.  They
+    // hide the cells logged before them, which are replaced with
+    // cell erasures as in LogFragment.
     vector<Cell> cells;
+    vector<Cell> rangeErasures;
     try {
         LogReader reader(
             uriPushScheme(uriPopScheme(logUri), "cache"),
             tableName);
         Cell x;
         while(reader.get(x))
-            cells.push_back(x);
+        {
+            if(!x.isRangeErasure())
+            {
+                cells.push_back(x);
+                continue;
+            }
+
+            rangeErasures.push_back(x);
+            for(vector<Cell>::iterator i = cells.begin();
+                i != cells.end(); ++i)
+            {
+                if(!i->isErasure() && rangeErasureCovers(x, *i))
+                {
+                    *i = makeCellErasure(i->getRow(), i->getColumn(),
+                                         i->getTimestamp());
+                }
+            }
+        }
     }
     catch(std::exception const & ex) {
         log("ERROR: failed to load log %s: %s", logUri, ex.what());
@@ -100,6 +122,11 @@ void CachedLogLoader::LogInfo::serializeLog(std::string const & logUri,
         writer->start(tableName);
         for(; first != cells.end(); ++first)
             writer->put(*first);
+        for(vector<Cell>::const_iterator i = rangeErasures.begin();
+            i != rangeErasures.end(); ++i)
+        {
+            writer->put(*i);
+        }
         diskUri = writer->finish();
     }
 
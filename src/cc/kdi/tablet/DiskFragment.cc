@@ -19,6 +19,7 @@
 //----------------------------------------------------------------------------
 
 #include <kdi/tablet/DiskFragment.h>
+#include <kdi/scan_predicate.h>
 #include <warp/uri.h>
 #include <warp/StatTracker.h>
 
@@ -34,7 +35,9 @@ DiskFragment::DiskFragment(std::string const & uri,
     uri(uri),
     table(
         kdi::local::DiskTable::loadTable(
-            uriPushScheme(uriPopScheme(uri), "cache"))),
+            uriPushScheme(uriPopScheme(FamilySet::unlabelUri(uri)),
+                          "cache"))),
+    families(FamilySet::fromUri(uri)),
     tracker(tracker)
 {
     EX_CHECK_NULL(tracker);
@@ -57,6 +60,35 @@ CellStreamPtr DiskFragment::scan(ScanPredicate const & pred) const
     return table->scan(pred);
 }
 
+void DiskFragment::getRangeErasures(std::vector<Cell> & out) const
+{
+    table->getRangeErasures(out);
+}
+
+bool DiskFragment::overlapsScan(warp::Interval<std::string> const & rows,
+                                ScanPredicate const & pred) const
+{
+    // Check the span of rows in the table, which is loaded with the
+    // table, before any scan is opened
+    Interval<std::string> span;
+    std::vector<StringRange> fams;
+    if(table->getRowSpan(span) && span.overlaps(rows) &&
+       (!pred.getRowPredicate() || pred.getRowPredicate()->overlaps(span)) &&
+       (families.isUniversal() || !pred.getColumnFamilies(fams) ||
+        families.containsAny(fams)))
+    {
+        return true;
+    }
+
+    tracker->add("DiskFragment.nPruned", 1);
+    return false;
+}
+
+bool DiskFragment::mayContainFamily(strref_t family) const
+{
+    return families.contains(family);
+}
+
 bool DiskFragment::isImmutable() const
 {
     return true;
@@ -69,7 +101,7 @@ std::string DiskFragment::getFragmentUri() const
 
 std::string DiskFragment::getDiskUri() const
 {
-    return uriPopScheme(uri);
+    return uriPopScheme(FamilySet::unlabelUri(uri));
 }
 
 size_t DiskFragment::getDiskSize(warp::Interval<std::string> const & rows) const
@@ -23,11 +23,14 @@
 
 #include <kdi/tablet/Fragment.h>
 #include <kdi/local/disk_table.h>
+#include <kdi/locality_groups.h>
 
 namespace kdi {
 namespace tablet {
 
-    /// Tablet fragment for an immutable on-disk table.
+    /// Tablet fragment for an immutable on-disk table.  If the
+    /// fragment was written for a locality group, its URI is labeled
+    /// with the families it may hold (see FamilySet).
     class DiskFragment;
 
 } // namespace tablet
@@ -43,6 +46,7 @@ class kdi::tablet::DiskFragment
 {
     std::string uri;
     kdi::local::DiskTablePtr table;
+    FamilySet families;
     warp::StatTracker * tracker;
 
 public:
@@ -50,6 +54,10 @@ public:
     ~DiskFragment();
 
     virtual CellStreamPtr scan(ScanPredicate const & pred) const;
+    virtual void getRangeErasures(std::vector<Cell> & out) const;
+    virtual bool overlapsScan(warp::Interval<std::string> const & rows,
+                              ScanPredicate const & pred) const;
+    virtual bool mayContainFamily(strref_t family) const;
 
     virtual bool isImmutable() const;
     virtual std::string getFragmentUri() const;
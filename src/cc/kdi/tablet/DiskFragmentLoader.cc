@@ -20,6 +20,7 @@
 
 #include <kdi/tablet/DiskFragmentLoader.h>
 #include <kdi/tablet/DiskFragment.h>
+#include <kdi/locality_groups.h>
 #include <warp/log.h>
 #include <warp/uri.h>
 #include <ex/exception.h>
@@ -53,6 +54,12 @@ namespace
             return p;
         }
 
+        bool overlapsScan(warp::Interval<std::string> const & rows,
+                          ScanPredicate const & pred) const
+        {
+            return false;
+        }
+
         bool isImmutable() const
         {
             return true;
@@ -65,7 +72,7 @@ namespace
 
         std::string getDiskUri() const
         {
-            return uriPopScheme(uri);
+            return uriPopScheme(FamilySet::unlabelUri(uri));
         }
 
         size_t getDiskSize(warp::Interval<std::string> const & rows) const
@@ -23,10 +23,21 @@
 
 using namespace kdi;
 using namespace kdi::tablet;
+using kdi::local::CurDiskTableWriter;
 using namespace warp;
 
 DiskFragmentWriter::DiskFragmentWriter(ConfigManagerPtr const & configMgr) :
-    writer(64 << 10), configMgr(configMgr)
+    useCrc32c(CurDiskTableWriter::getDefaultUseCrc32c()),
+    writer(64 << 10, useCrc32c),
+    configMgr(configMgr)
+{
+}
+
+DiskFragmentWriter::DiskFragmentWriter(ConfigManagerPtr const & configMgr,
+                                       bool useCrc32c) :
+    useCrc32c(useCrc32c),
+    writer(64 << 10, useCrc32c),
+    configMgr(configMgr)
 {
 }
 
@@ -51,3 +62,8 @@ size_t DiskFragmentWriter::size() const
 {
     return writer.size();
 }
+
+FragmentWriter * DiskFragmentWriter::clone() const
+{
+    return new DiskFragmentWriter(configMgr, useCrc32c);
+}
@@ -31,18 +31,27 @@ namespace tablet {
     class DiskFragmentWriter
         : public FragmentWriter
     {
+        bool useCrc32c;
         kdi::local::CurDiskTableWriter writer;
         std::string fn;
 
         ConfigManagerPtr configMgr;
 
     public:
-        DiskFragmentWriter(ConfigManagerPtr const & configMgr);
+        /// Write fragments with the checksum chosen by
+        /// KDI_DISK_CHECKSUM.
+        explicit DiskFragmentWriter(ConfigManagerPtr const & configMgr);
+
+        /// Write fragments with CRC-32C block checksums if useCrc32c
+        /// is true, or Adler-32 otherwise.
+        DiskFragmentWriter(ConfigManagerPtr const & configMgr,
+                           bool useCrc32c);
 
         virtual void start(std::string const & table);
         virtual void put(Cell const & x);
         virtual std::string finish();
         virtual size_t size() const;
+        virtual FragmentWriter * clone() const;
     };
 
 } // namespace tablet
@@ -139,6 +139,20 @@ FragDag::getFragmentWeight(FragmentPtr const & fragment) const
     return weight * wastageFactor;
 }
 
+size_t
+FragDag::getMaxChainLength() const
+{
+    size_t maxChain = 0;
+    for(tfset_map::const_iterator i = activeFragments.begin();
+        i != activeFragments.end(); ++i)
+    {
+        size_t len = i->second.size();
+        if(len > maxChain)
+            maxChain = len;
+    }
+    return maxChain;
+}
+
 FragmentPtr
 FragDag::getMaxWeightFragment(size_t minWeight) const
 {
@@ -429,7 +443,7 @@ FragDag::getActiveTabletIntersection(fragment_vec const & fragments) const
 void
 FragDag::replaceInternal(Tablet * tablet,
                          fragment_vec const & adjFragments,
-                         FragmentPtr const & newFragment)
+                         fragment_vec const & newFragments)
 {
     //log("FragDag: updating %s", tablet->getPrettyName());
 
@@ -456,19 +470,23 @@ FragDag::replaceInternal(Tablet * tablet,
     //log("FragDag:  child: %s", child ? child->getFragmentUri() : "NULL");
 
     // Are we doing a replacement or deletion?
-    if(newFragment)
+    if(!newFragments.empty())
     {
-        // Replacement: update graph by splicing fragment into place
-        //log("FragDag: replacing %d fragment(s) with %s",
-        //    adjFragments.size(), newFragment->getFragmentUri());
+        // Replacement: update graph by splicing fragments into place
+        //log("FragDag: replacing %d fragment(s) with %d",
+        //    adjFragments.size(), newFragments.size());
 
-        // Add new fragment to active lists
-        activeFragments[tablet].insert(newFragment);
-        activeTablets[newFragment].insert(tablet);
+        // Add new fragments to active lists
+        for(fragment_vec::const_iterator f = newFragments.begin();
+            f != newFragments.end(); ++f)
+        {
+            activeFragments[tablet].insert(*f);
+            activeTablets[*f].insert(tablet);
+        }
 
         // Internal graph should be consistent now.  Update the
         // tablet.
-        (tablet)->replaceFragments(adjFragments, newFragment);
+        (tablet)->replaceFragments(adjFragments, newFragments);
     }
     else
     {
@@ -485,6 +503,15 @@ void
 FragDag::replaceFragments(warp::Interval<std::string> const & range,
                           fragment_vec const & adjFragments,
                           FragmentPtr const & newFragment)
+{
+    EX_CHECK_NULL(newFragment);
+    replaceFragments(range, adjFragments, fragment_vec(1, newFragment));
+}
+
+void
+FragDag::replaceFragments(warp::Interval<std::string> const & range,
+                          fragment_vec const & adjFragments,
+                          fragment_vec const & newFragments)
 {
     // graph::replace(range, adjSeq, outFrag):
     //    for tablet in (intersection of active tablets for each frag in adjSeq):
@@ -526,6 +553,8 @@ FragDag::replaceFragments(warp::Interval<std::string> const & range,
 
     if(adjFragments.empty())
         raise<ValueError>("empty replacement set");
+    if(newFragments.empty())
+        raise<ValueError>("no new fragments for replacement");
 
     tablet_set active = getActiveTabletIntersection(adjFragments);
     for(tablet_set::const_iterator t = active.begin();
@@ -534,7 +563,7 @@ FragDag::replaceFragments(warp::Interval<std::string> const & range,
         if(!range.contains((*t)->getRows()))
             continue;
 
-        replaceInternal(*t, adjFragments, newFragment);
+        replaceInternal(*t, adjFragments, newFragments);
     }
 }
 
@@ -554,7 +583,7 @@ FragDag::removeFragments(warp::Interval<std::string> const & range,
         if(!range.contains((*t)->getRows()))
             continue;
 
-        replaceInternal(*t, adjFragments, FragmentPtr());
+        replaceInternal(*t, adjFragments, fragment_vec());
     }
 }
 
@@ -110,6 +110,11 @@ public:
     size_t
     getActiveSize(FragmentPtr const & frag) const;
 
+    /// Get the length of the longest active fragment chain of any
+    /// tablet in the graph.
+    size_t
+    getMaxChainLength() const;
+
 private:
     /// Get all immediate parents and children not already included in
     /// the set
@@ -141,15 +146,15 @@ public:
     getActiveTabletIntersection(fragment_vec const & fragments) const;
 
 private:
-    /// Replace the fragments in adjFragments with newFragment for the
-    /// given tablet.  adjFragments must be a non-empty, adjacent
-    /// sequence in tablet's active list of fragments.  If newFragment
-    /// is not null, it is spliced into the place of adjFragments.  If
-    /// newFragment is null, adjFragments are spliced out.
+    /// Replace the fragments in adjFragments with newFragments for
+    /// the given tablet.  adjFragments must be a non-empty, adjacent
+    /// sequence in tablet's active list of fragments.  If
+    /// newFragments is not empty, it is spliced into the place of
+    /// adjFragments.  Otherwise, adjFragments are spliced out.
     void
     replaceInternal(Tablet * tablet,
                     fragment_vec const & adjFragments,
-                    FragmentPtr const & newFragment);
+                    fragment_vec const & newFragments);
 
 public:
     /// Replace the given fragments in active tablets contained in
@@ -161,6 +166,14 @@ public:
                      fragment_vec const & adjFragments,
                      FragmentPtr const & newFragment);
 
+    /// Replace the given fragments in active tablets contained in
+    /// range with a non-empty sequence of new fragments, as when the
+    /// output is split into locality groups.
+    void
+    replaceFragments(warp::Interval<std::string> const & range,
+                     fragment_vec const & adjFragments,
+                     fragment_vec const & newFragments);
+
     /// Remove the given fragments from active tablets contained in
     /// range.  adjFragments is expected to be an adjacent sequence of
     /// fragments in each matching tablet's active fragment list.
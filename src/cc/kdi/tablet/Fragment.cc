@@ -19,7 +19,9 @@
 //----------------------------------------------------------------------------
 
 #include <kdi/tablet/Fragment.h>
+#include <kdi/scan_predicate.h>
 
+using namespace kdi;
 using namespace kdi::tablet;
 using namespace warp;
 using namespace std;
@@ -44,3 +46,32 @@ size_t Fragment::getDiskSize() const {
     return getDiskSize(unbounded);
 }
 
+void Fragment::getCells(strref_t row, strref_t column,
+                        vector<Cell> & out) const
+{
+    ScanPredicate pred;
+    pred.setRowPredicate(
+        IntervalSet<string>().add(Interval<string>().setPoint(str(row))));
+    pred.setColumnPredicate(
+        IntervalSet<string>().add(Interval<string>().setPoint(str(column))));
+
+    CellStreamPtr s = scan(pred);
+    Cell x;
+    while(s->get(x))
+        out.push_back(x);
+}
+
+void Fragment::getRangeErasures(vector<Cell> & out) const
+{
+}
+
+bool Fragment::overlapsScan(Interval<string> const & rows,
+                            ScanPredicate const & pred) const
+{
+    return true;
+}
+
+bool Fragment::mayContainFamily(strref_t family) const
+{
+    return true;
+}
@@ -25,6 +25,7 @@
 #include <warp/interval.h>
 #include <flux/stream.h>
 #include <string>
+#include <vector>
 #include <utility>
 
 namespace kdi {
@@ -48,6 +49,33 @@ public:
 
     virtual CellStreamPtr scan(ScanPredicate const & pred) const = 0;
 
+    /// Append all cells in the fragment with the given row and
+    /// column to \c out in cell order, including erasures.  The
+    /// default implementation does a point scan.
+    virtual void getCells(strref_t row, strref_t column,
+                          std::vector<Cell> & out) const;
+
+    /// Append the row range and column family erasures in the
+    /// fragment to \c out.  They hide cells in all older fragments.
+    /// Cells in this fragment were written after them, or were
+    /// already replaced with cell erasures, so scans of the fragment
+    /// don't apply them.  The default implementation has no range
+    /// erasures.
+    virtual void getRangeErasures(std::vector<Cell> & out) const;
+
+    /// Return false if a scan of the fragment with the given
+    /// predicate, restricted to the given rows, can't return any
+    /// cells.  Tablets use this to skip fragments without opening a
+    /// scan.  The default implementation always returns true.
+    virtual bool overlapsScan(warp::Interval<std::string> const & rows,
+                              ScanPredicate const & pred) const;
+
+    /// Return false if the fragment can't hold cells in the given
+    /// column family, as for a fragment written for a different
+    /// locality group.  The default implementation always returns
+    /// true.
+    virtual bool mayContainFamily(strref_t family) const;
+
     // Fragment API
 
     /// Indicates if the Fragment is immutable.
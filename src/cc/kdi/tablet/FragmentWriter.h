@@ -44,7 +44,8 @@ public:
     virtual void start(std::string const & table) = 0;
 
     /// Put more data in the output.  Cells must be added in strictly
-    /// increasing cell order.
+    /// increasing cell order.  Range erasures are stored apart from
+    /// the cells and may be added in any order.
     virtual void put(Cell const & x) = 0;
 
     /// Finalize the output file and return the URI to newly created
@@ -56,8 +57,12 @@ public:
     /// called without adding any more data with put().
     virtual size_t size() const = 0;
 
-protected:
-    ~FragmentWriter() {}
+    /// Make another writer for the same kind of fragments, so more
+    /// than one output can be open at a time (e.g. one for each
+    /// locality group).  The caller owns the new writer.
+    virtual FragmentWriter * clone() const = 0;
+
+    virtual ~FragmentWriter() {}
 };
 
 #endif // KDI_TABLET_FRAGMENTWRITER_H
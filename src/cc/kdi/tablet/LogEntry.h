@@ -27,6 +27,7 @@ namespace kdi {
 namespace tablet {
 
     struct LogEntry;
+    struct LogEntryV2;
 
 } // namespace tablet
 } // namespace kdi
@@ -47,4 +48,17 @@ struct kdi::tablet::LogEntry
     warp::StringOffset tabletName;
 };
 
+//----------------------------------------------------------------------------
+// LogEntryV2
+//----------------------------------------------------------------------------
+/// LogEntry built on a CellBlockV1, for entries holding range erasures
+/// or merge operands.
+struct kdi::tablet::LogEntryV2
+    : public kdi::tablet::LogEntry
+{
+    enum {
+        VERSION = 1 + kdi::marshal::CellBlockV1::VERSION,
+    };
+};
+
 #endif // KDI_TABLET_LOGENTRY_H
@@ -21,11 +21,16 @@
 #include <kdi/tablet/LogFragment.h>
 #include <kdi/memory_table.h>
 #include <kdi/synchronized_table.h>
+#include <kdi/range_erasure.h>
+#include <kdi/scan_predicate.h>
 #include <warp/uri.h>
+#include <vector>
+#include <string>
 
 using namespace kdi;
 using namespace kdi::tablet;
 using namespace warp;
+using namespace std;
 
 namespace
 {
@@ -55,6 +60,46 @@ CellStreamPtr LogFragment::scan(ScanPredicate const & pred) const
     return logTable->scan(pred);
 }
 
+void LogFragment::getCells(strref_t row, strref_t column,
+                           std::vector<Cell> & out) const
+{
+    // The log table keeps erasures, so a direct lookup returns them
+    logTable->get(row, column, 0, out);
+}
+
+void LogFragment::addRangeErasure(Cell const & x)
+{
+    // The erasure hides the cells logged before it, but not the ones
+    // logged after it.  Its own fragment isn't filtered by it, so
+    // replace the covered cells with cell erasures.
+    logTable->sync();
+    vector<Cell> covered;
+    CellStreamPtr scan = logTable->scan(
+        ScanPredicate().setRowPredicate(
+            IntervalSet<string>().add(getRangeErasureRows(x))));
+    Cell c;
+    while(scan->get(c))
+    {
+        if(!c.isErasure() && rangeErasureCovers(x, c))
+            covered.push_back(c);
+    }
+    for(vector<Cell>::const_iterator i = covered.begin();
+        i != covered.end(); ++i)
+    {
+        logTable->erase(i->getRow(), i->getColumn(), i->getTimestamp());
+    }
+    logTable->sync();
+
+    boost::mutex::scoped_lock lock(erasureMutex);
+    rangeErasures.push_back(x);
+}
+
+void LogFragment::getRangeErasures(std::vector<Cell> & out) const
+{
+    boost::mutex::scoped_lock lock(erasureMutex);
+    out.insert(out.end(), rangeErasures.begin(), rangeErasures.end());
+}
+
 bool LogFragment::isImmutable() const
 {
     return false;
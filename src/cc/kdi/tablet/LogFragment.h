@@ -23,6 +23,7 @@
 
 #include <kdi/tablet/Fragment.h>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 
 namespace kdi {
 namespace tablet {
@@ -44,12 +45,25 @@ class kdi::tablet::LogFragment
     TablePtr logTable;
     std::string uri;
 
+    mutable boost::mutex erasureMutex;
+    std::vector<Cell> rangeErasures;
+
 public:
     explicit LogFragment(std::string const & uri);
     TablePtr const & getWritableTable() { return logTable; }
 
+    /// Add a row range or column family erasure to the fragment.
+    /// The writable table only holds cells and cell erasures, so the
+    /// cells already in it that the erasure covers are replaced with
+    /// cell erasures.  The range erasure itself applies to older
+    /// fragments.
+    void addRangeErasure(Cell const & x);
+
     // Fragment API
     virtual CellStreamPtr scan(ScanPredicate const & pred) const;
+    virtual void getCells(strref_t row, strref_t column,
+                          std::vector<Cell> & out) const;
+    virtual void getRangeErasures(std::vector<Cell> & out) const;
 
     virtual bool isImmutable() const;
     virtual std::string getFragmentUri() const;
@@ -20,6 +20,7 @@
 
 #include <kdi/tablet/LogReader.h>
 #include <kdi/tablet/LogEntry.h>
+#include <kdi/marshal/cell_data.h>
 
 using namespace kdi;
 using namespace kdi::tablet;
@@ -61,7 +62,9 @@ bool LogReader::get(Cell & x)
             return false;
 
         // Skip the entry if it is for a different tablet
-        LogEntry const * ent = logEntry.as<LogEntry>();
+        LogEntry const * ent = logEntry.tryAs<LogEntryV2>();
+        if(!ent)
+            ent = logEntry.as<LogEntry>();
         if(*ent->tabletName != tabletName)
             continue;
 
@@ -70,22 +73,9 @@ bool LogReader::get(Cell & x)
         endCell = ent->cells.end();
     }
 
-    // We have now have nextCell != endCell.  Return a cell.
-    if(nextCell->value)
-    {
-        // It's a regular cell
-        x = makeCell(*nextCell->key.row,
-                     *nextCell->key.column,
-                     nextCell->key.timestamp,
-                     *nextCell->value);
-    }
-    else
-    {
-        // It's an erasure
-        x = makeCellErasure(*nextCell->key.row,
-                            *nextCell->key.column,
-                            nextCell->key.timestamp);
-    }
+    // We have now have nextCell != endCell.  Return a cell, which
+    // may be an erasure or range erasure.
+    x = marshal::unmarshalCell(*nextCell);
 
     // Advance cell pointer and return
     ++nextCell;
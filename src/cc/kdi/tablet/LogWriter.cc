@@ -43,6 +43,7 @@ class LogWriter::Impl
     string uri;
 
     BuildStreamHandle logStream;
+    BuildStreamHandle logStreamV2;
     RecordBuilder recBuilder;
     CellBlockBuilder cellBuilder;
 
@@ -52,8 +53,12 @@ public:
         uri(uriPushScheme(fileUri, "sharedlog")),
         cellBuilder(&recBuilder)
     {
-        logStream = makeBuildStream<LogEntry>(128<<10);
-        logStream->pipeTo(FileOutput::make(fp));
+        BuildStream::alloc_t alloc(new RecordBufferAllocator(128<<10));
+        RecordStreamHandle output = FileOutput::make(fp);
+        logStream = makeBuildStream<LogEntry>(alloc);
+        logStream->pipeTo(output);
+        logStreamV2 = makeBuildStream<LogEntryV2>(alloc);
+        logStreamV2->pipeTo(output);
     }
 
     void sync()
@@ -71,6 +76,7 @@ public:
         /// from mid-write crashes.
 
         BOOST_STATIC_ASSERT(LogEntry::VERSION == 1);
+        BOOST_STATIC_ASSERT(LogEntryV2::VERSION == 2);
 
         // Make a RecordBuilder and build the LogEntry.  A LogEntry is a
         // fixed-size type derived from a CellBlock.  The CellBlockBuilder
@@ -82,8 +88,12 @@ public:
         for(vector<Cell>::const_iterator i = cells.begin(); i != cells.end(); ++i)
             cellBuilder.append(*i);
 
-        // Write the built entry
-        logStream->put(recBuilder);
+        // Write the built entry.  Entries with cells other than plain
+        // cells and erasures need a V2 header.
+        if(cellBuilder.getVersion() == CellBlockV1::VERSION)
+            logStreamV2->put(recBuilder);
+        else
+            logStream->put(recBuilder);
 
         // Reset the CellBlockBuilder from the RecordBuilder.  The
         // RecordBuilder has already been reset.
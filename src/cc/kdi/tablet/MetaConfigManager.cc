@@ -122,10 +122,22 @@ namespace
         else
             minRow = IntervalPoint<string>(string(), PT_INFINITE_LOWER_BOUND);
 
+        // Get the retention policy
+        RetentionPolicy retention;
+        if(Config const * n = state.findChild("retention"))
+            retention.load(*n);
+
+        // Get the locality groups
+        LocalityGroups groups;
+        if(Config const * n = state.findChild("groups"))
+            groups.load(*n);
+
         // Return the TabletConfig
         return TabletConfig(
             Interval<string>(minRow, tabletName.getLastRow()),
-            uris
+            uris,
+            retention,
+            groups
             );
     }
 
@@ -164,6 +176,12 @@ namespace
                 raise<ValueError>("config has invalid lower bound");
         }
 
+        // Add the retention policy
+        config.getRetentionPolicy().save(state, "retention");
+
+        // Add the locality groups
+        config.getLocalityGroups().save(state, "groups");
+
         // Serialize the config
         ostringstream oss;
         oss << state;
@@ -400,7 +418,9 @@ MetaConfigManager::loadTabletConfigs(std::string const & tableName)
             // fill the gap.
             cfg = TabletConfig(
                 Interval<string>(lowerBound, cfgRows.getUpperBound()),
-                cfg.getTableUris()
+                cfg.getTableUris(),
+                cfg.getRetentionPolicy(),
+                cfg.getLocalityGroups()
                 );
             metaTable->set(x.getRow(), x.getColumn(), x.getTimestamp(),
                            getConfigCellValue(cfg, rootDir));
@@ -442,6 +462,24 @@ void MetaConfigManager::setTabletConfig(std::string const & tableName,
     metaTable->sync();
 }
 
+void MetaConfigManager::setTabletConfigs(
+    std::string const & tableName, std::vector<TabletConfig> const & cfgs)
+{
+    // Write all the config cells before syncing, so they go to the
+    // META table together
+    TablePtr metaTable = getMetaTable();
+    for(std::vector<TabletConfig>::const_iterator i = cfgs.begin();
+        i != cfgs.end(); ++i)
+    {
+        log("Save META config: %s", makePrettyName(tableName, *i));
+
+        TabletName tabletName(tableName, i->getTabletRows().getUpperBound());
+        metaTable->set(tabletName.getEncoded(), "config", 0,
+                       getConfigCellValue(*i, rootDir));
+    }
+    metaTable->sync();
+}
+
 std::string MetaConfigManager::getDataFile(std::string const & tableName)
 {
     return getUniqueTableFile(rootDir, tableName);
@@ -26,6 +26,7 @@
 #include <boost/thread/mutex.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <vector>
 
 namespace kdi {
 namespace tablet {
@@ -60,6 +61,15 @@ public:
     void setTabletConfig(std::string const & tableName, TabletConfig const & cfg);
     std::string getDataFile(std::string const & tableName);
 
+    /// Write the configs for several tablets in the named table as
+    /// a single META update.
+    void setTabletConfigs(std::string const & tableName,
+                          std::vector<TabletConfig> const & cfgs);
+
+    /// Get the server root directory.  Table data files live under
+    /// it.
+    std::string const & getRootDir() const { return rootDir; }
+
     /// Get a ConfigManager adapter for fixed, file-based configs.
     /// This will typically be used to load the root META table.
     ConfigManagerPtr getFixedAdapter();
@@ -70,7 +80,6 @@ public:
 private:
     class FixedAdapter;
     std::string getNewFile(std::string const & tableDir) const;
-    std::string const & getRootDir() const { return rootDir; }
 };
 
 
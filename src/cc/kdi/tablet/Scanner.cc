@@ -20,6 +20,7 @@
 
 #include <kdi/tablet/Scanner.h>
 #include <kdi/tablet/Tablet.h>
+#include <kdi/tablet/Fragment.h>
 #include <warp/log.h>
 #include <ex/exception.h>
 
@@ -29,90 +30,212 @@ using namespace warp;
 using namespace ex;
 using namespace std;
 
+namespace {
+
+    /// Pass cells through from a base stream, skipping everything up
+    /// to and including a given cell.  Used to bring a newly opened
+    /// fragment scan up to the position of an existing scan.
+    class ResumeStream : public CellStream
+    {
+        CellStreamPtr base;
+        Cell after;
+        bool resumed;
+
+    public:
+        ResumeStream(CellStreamPtr const & base, Cell const & after) :
+            base(base), after(after), resumed(false)
+        {
+        }
+
+        bool get(Cell & x)
+        {
+            if(resumed)
+                return base->get(x);
+
+            while(base->get(x))
+            {
+                if(after < x)
+                {
+                    resumed = true;
+                    after.release();
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+
+    /// Unpin a Tablet's fragment generation on scope exit, unless
+    /// the generation has been taken over by the caller.
+    class GenerationPin
+    {
+        TabletCPtr tablet;
+        size_t generation;
+
+    public:
+        GenerationPin(TabletCPtr const & tablet, size_t generation) :
+            tablet(tablet), generation(generation) {}
+
+        ~GenerationPin()
+        {
+            if(generation)
+                tablet->unpinFragments(generation);
+        }
+
+        size_t release()
+        {
+            size_t g = generation;
+            generation = 0;
+            return g;
+        }
+    };
+
+}
+
 //----------------------------------------------------------------------------
 // Scanner
 //----------------------------------------------------------------------------
 Scanner::Scanner(TabletCPtr const & tablet, ScanPredicate const & pred) :
     tablet(tablet),
-    pred(pred)
+    pred(pred),
+    merge(CellMerge::make(true)),
+    generation(0),
+    nPruned(0)
 {
     //log("Scanner %p: created", this);
 
     EX_CHECK_NULL(tablet);
     if(pred.getMaxHistory())
         raise<ValueError>("unsupported history predicate: %s", pred);
+
+    // The merge inputs are opened on the first call to get().  The
+    // Tablet's fragment generation is never zero.
 }
 
 Scanner::~Scanner()
 {
     //log("Scanner %p: destroyed", this);
+
+    // Let the Tablet release files we were the last to read
+    if(generation)
+        tablet->unpinFragments(generation);
 }
 
 bool Scanner::get(Cell & x)
 {
-    // Synchronize with reopen() thread
-    lock_t sync(mutex);
+    // Pick up any fragment changes since the last call
+    if(generation != tablet->getFragmentGeneration() && !updateInputs())
+        return false;
 
-    // Check to see if we need to open the scanner
-    if(!cells)
+    // Continue with normal scan
+    if(!merge->get(x))
     {
-        //log("Scanner: reopening scan on table %s: %s", tablet->getPrettyName(), pred);
+        // No more cells: end of stream
+        return false;
+    }
 
-        // If we have a last cell, we need to clip our scan predicate
-        // to last row, then fast forward the scan to the last cell.
-        if(lastCell)
-        {
-            // If the last cell that we read is no longer in the tablet range,
-            // it means that the tablet split and we had already read past the split 
-            // point.  So no more cells to return from this tablet, the super
-            // scan will proceed to the new lower tablet.
-            if(!tablet->getRows().contains(lastCell.getRow(), warp::less()))
-                return false;
-
-            // Reopen the scan using a clipped predicate.
-            cells = tablet->getMergedScan(
-                pred.clipRows(
-                    makeLowerBound(lastCell.getRow().toString())));
-
-            // Fast forward the scan.  Keep reading cells until we
-            // find one after the last cell we returned.  Return that
-            // one.
-            while(cells->get(x))
-            {
-                if(lastCell < x)
-                {
-                    // Found a cell after the last cell.  Remember it
-                    // and return.
-                    lastCell = x;
-                    return true;
-                }
-            }
+    // Remember last cell so we can resume new fragments from here
+    lastCell = x;
+    return true;
+}
+
+bool Scanner::updateInputs()
+{
+    vector<FragmentPtr> fragments;
+    GenerationPin pin(tablet, tablet->pinFragments(fragments));
 
-            // There were no cells after our last cell.  This is the
-            // end of the stream.
+    // If we have a last cell, new fragment scans must start after it.
+    ScanPredicate resumePred;
+    if(lastCell)
+    {
+        // If the last cell that we read is no longer in the tablet
+        // range, it means that the tablet split and we had already
+        // read past the split point.  So no more cells to return from
+        // this tablet, the super scan will proceed to the new lower
+        // tablet.
+        if(!tablet->getRows().contains(lastCell.getRow(), warp::less()))
             return false;
+
+        resumePred = pred.clipRows(
+            makeLowerBound(lastCell.getRow().toString()));
+    }
+
+    // Build the new input list.  Fragments are added to the merge in
+    // reverse order so later fragments override earlier fragments.
+    // Reuse the open stream for any fragment we were already reading.
+    // Range erasures collect along the way, since they apply to
+    // everything older than their own fragment.  Fragments with no
+    // cells in the scan are left out, but their range erasures still
+    // count.
+    Interval<string> rows = tablet->getRows();
+    ScanPredicate const & spanPred = (lastCell ? resumePred : pred);
+    input_vec newInputs;
+    vector<Cell> erasures;
+    vector<Cell> fragErasures;
+    size_t newPruned = 0;
+    newInputs.reserve(fragments.size());
+    for(vector<FragmentPtr>::const_reverse_iterator i = fragments.rbegin();
+        i != fragments.rend(); ++i)
+    {
+        erasures.insert(erasures.end(), fragErasures.begin(),
+                        fragErasures.end());
+        fragErasures.clear();
+        (*i)->getRangeErasures(fragErasures);
+        if(!(*i)->overlapsScan(rows, spanPred))
+        {
+            ++newPruned;
+            continue;
+        }
+
+        input_vec::iterator j = inputs.begin();
+        while(j != inputs.end() && j->fragment != *i)
+            ++j;
+
+        // An open stream without a filter can't take on range
+        // erasures in place: the merge may already hold its next
+        // cell.  Reopen it like a new fragment instead.
+        if(j != inputs.end() && (j->filter || erasures.empty()))
+        {
+            newInputs.push_back(*j);
+            j->fragment.reset();
+            if(j->filter)
+                j->filter->setErasures(erasures);
+            continue;
         }
 
-        // Otherwise we haven't returned any cells yet.  Use normal
-        // predicate and open the scan.
-        cells = tablet->getMergedScan(pred);
+        CellStreamPtr s;
+        if(lastCell)
+            s.reset(new ResumeStream((*i)->scan(resumePred), lastCell));
+        else
+            s = (*i)->scan(pred);
+
+        newInputs.push_back(Input(*i, s));
+        if(!erasures.empty())
+        {
+            Input & in = newInputs.back();
+            in.filter.reset(new RangeErasureFilter(erasures));
+            in.filter->pipeFrom(in.stream);
+            in.stream = in.filter;
+        }
     }
 
-    // Continue with normal scan
-    if(!cells->get(x))
+    vector<CellStreamPtr> streams;
+    streams.reserve(newInputs.size());
+    for(input_vec::const_iterator i = newInputs.begin();
+        i != newInputs.end(); ++i)
     {
-        // No more cells: end of stream
-        return false;
+        streams.push_back(i->stream);
     }
 
-    // Remember last cell so we can reopen if necessary
-    lastCell = x;
+    // Swap the inputs in the merge.  Streams dropped from the merge
+    // (and the fragments they reference) are released here, and
+    // then the files of the old generation may go too.
+    merge->replaceInputs(streams.begin(), streams.end());
+    inputs.swap(newInputs);
+    newInputs.clear();
+    if(generation)
+        tablet->unpinFragments(generation);
+    generation = pin.release();
+    nPruned = newPruned;
     return true;
 }
-
-void Scanner::reopen()
-{
-    // Release scanner -- we'll reopen it on the next call to get()
-    lock_t sync(mutex);
-    cells.reset();
-}
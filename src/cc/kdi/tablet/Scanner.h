@@ -23,9 +23,12 @@
 
 #include <kdi/tablet/forward.h>
 #include <kdi/cell.h>
+#include <kdi/cell_merge.h>
 #include <kdi/scan_predicate.h>
+#include <kdi/range_erasure.h>
 #include <boost/shared_ptr.hpp>
-#include <boost/thread/mutex.hpp>
+#include <vector>
+#include <utility>
 
 namespace kdi {
 namespace tablet {
@@ -38,21 +41,44 @@ namespace tablet {
 //----------------------------------------------------------------------------
 // Scanner
 //----------------------------------------------------------------------------
+/// Merged scan over the fragments of a Tablet.  When the Tablet's
+/// fragment chain changes, the Scanner notices on its next call to
+/// get() and swaps only the changed inputs of its merge.  Inputs
+/// from fragments still in the chain keep their position.  Inputs
+/// from new fragments are opened just past the last cell returned.
+/// The Tablet keeps the files of the fragment chain a Scanner is
+/// reading until the Scanner moves to a newer chain or goes away.
+///
+/// Scanners are not registered with the Tablet and get() takes no
+/// locks in the common case.  Like other streams, a Scanner should
+/// only be used from one thread at a time.
+///
+/// Range erasures hide cells in all fragments older than their own,
+/// so each input is filtered by the range erasures of every newer
+/// fragment.
 class kdi::tablet::Scanner
     : public kdi::CellStream
 {
+    struct Input
+    {
+        FragmentPtr fragment;
+        CellStreamPtr stream;
+        RangeErasureFilterPtr filter;   // null if no range erasures
+
+        Input(FragmentPtr const & fragment, CellStreamPtr const & stream) :
+            fragment(fragment), stream(stream) {}
+    };
+
+    typedef std::vector<Input> input_vec;
+
     TabletCPtr tablet;
     ScanPredicate pred;
-    
-    CellStreamPtr cells;
-    Cell lastCell;
 
-    // We need locking to coordinate the get() thread and the reopen()
-    // thread.  It would be nice if the get() function didn't need to
-    // grab the lock every time.  Perhaps this synchronization can be
-    // moved out later.
-    typedef boost::mutex::scoped_lock lock_t;
-    boost::mutex mutex;
+    boost::shared_ptr<CellMerge> merge;
+    input_vec inputs;
+    size_t generation;
+    Cell lastCell;
+    size_t nPruned;
 
 public:
     Scanner(TabletCPtr const & tablet, ScanPredicate const & pred);
@@ -60,11 +86,15 @@ public:
 
     bool get(Cell & x);
 
-    /// Reopen the scan from our Tablet.  This can be called when the
-    /// Tablet's table set has changed.  The scan will resume after
-    /// the last cell seen in the current scan.  New data may be
-    /// included in the updated scan.
-    void reopen();
+    /// Get the number of fragments left out of the current merge
+    /// because they hold no cells in the scan's rows.
+    size_t getPrunedFragmentCount() const { return nPruned; }
+
+private:
+    /// Bring the merge inputs up to date with the Tablet's current
+    /// fragment chain.  Returns false if the scan has moved past the
+    /// end of the Tablet's row range (after a split).
+    bool updateInputs();
 };
 
 #endif // KDI_TABLET_SCANNER_H
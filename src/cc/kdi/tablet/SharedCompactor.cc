@@ -22,7 +22,11 @@
 #include <kdi/tablet/Tablet.h>
 #include <kdi/tablet/FileTracker.h>
 #include <kdi/tablet/Fragment.h>
+#include <kdi/tablet/AdmissionController.h>
 #include <kdi/cell_merge.h>
+#include <kdi/range_erasure.h>
+#include <kdi/retention_policy.h>
+#include <kdi/locality_groups.h>
 #include <kdi/scan_predicate.h>
 #include <flux/cutoff.h>
 #include <flux/threaded_reader.h>
@@ -31,9 +35,11 @@
 #include <warp/log.h>
 #include <warp/call_or_die.h>
 #include <warp/timer.h>
+#include <warp/timestamp.h>
 #include <warp/WorkerPool.h>
 #include <ex/exception.h>
 #include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
 #include <iostream>
 #include <vector>
 
@@ -81,9 +87,11 @@ namespace {
         Interval<string> const range;
         fragment_vec fragments;
         bool isRooted;
+        bool isComplete;
+        RetentionPolicy retention;
 
         CompactRange(Interval<string> const & range) :
-            range(range), isRooted(false)
+            range(range), isRooted(false), isComplete(false)
         {
         }
     };
@@ -133,7 +141,10 @@ class SharedCompactor::ReadAheadImpl
     size_t readUpTo;
 
 public:
-    ReadAheadImpl() :
+    /// Set up compaction read-ahead.  If a shared pool is given, the
+    /// read tasks run on it at background priority.  Otherwise a
+    /// private pool is created.
+    explicit ReadAheadImpl(warp::WorkStealingPool * sharedPool) :
         readAhead(4 << 20),
         readUpTo(512 << 10)
         
@@ -145,21 +156,34 @@ public:
             readUpTo = parseSize(s);
 
         size_t nThreads = 4;
-        if(char * s = getenv("KDI_TABLET_READ_THREADS"))
+        if(sharedPool)
+            nThreads = sharedPool->getWorkerCount();
+        else if(char * s = getenv("KDI_TABLET_READ_THREADS"))
             nThreads = parseSize(s);
 
         if(readAhead && readUpTo && nThreads)
         {
-            log("Compaction read-ahead: nThreads=%d, readAhead=%s, "
-                "readUpTo=%s", nThreads, sizeString(readAhead),
-                sizeString(readUpTo));
-
-            pool.reset(
-                new WorkerPool(
-                    nThreads,
-                    "Compaction read-ahead thread",
-                    true)
-                );
+            log("Compaction read-ahead: nThreads=%d%s, readAhead=%s, "
+                "readUpTo=%s", nThreads, (sharedPool ? " (shared)" : ""),
+                sizeString(readAhead), sizeString(readUpTo));
+
+            if(sharedPool)
+            {
+                pool.reset(
+                    new WorkerPool(
+                        *sharedPool,
+                        WorkStealingPool::BACKGROUND)
+                    );
+            }
+            else
+            {
+                pool.reset(
+                    new WorkerPool(
+                        nThreads,
+                        "Compaction read-ahead thread",
+                        true)
+                    );
+            }
         }
         else
         {
@@ -194,7 +218,13 @@ namespace {
         typedef boost::mutex::scoped_lock lock_t;
 
         FragmentLoader * loader;
-        FragmentWriter * writer;
+
+        // One writer for each locality group.  The first is the
+        // writer we were given and the rest are clones of it.
+        LocalityGroups const & groups;
+        std::vector<FragmentWriter *> writers;
+        boost::ptr_vector<FragmentWriter> clonedWriters;
+        std::vector<bool> writerOpen;
 
         FileTrackerPtr tracker;
         boost::mutex & dagMutex;
@@ -230,6 +260,7 @@ namespace {
 
         CompactionOutput(FragmentLoader * loader,
                          FragmentWriter * writer,
+                         LocalityGroups const & groups,
                          FileTrackerPtr const & tracker,
                          boost::mutex & dagMutex,
                          FragDag & fragDag,
@@ -238,7 +269,7 @@ namespace {
                          range_vec const & rangeMap
             ) :
             loader(loader),
-            writer(writer),
+            groups(groups),
             tracker(tracker),
             dagMutex(dagMutex),
             fragDag(fragDag),
@@ -251,6 +282,14 @@ namespace {
             outputSize(0)
         {
             outputRange.setInfinite();
+
+            writers.push_back(writer);
+            for(size_t g = 1; g < groups.getGroupCount(); ++g)
+            {
+                clonedWriters.push_back(writer->clone());
+                writers.push_back(&clonedWriters.back());
+            }
+            writerOpen.resize(writers.size(), false);
         }
 
         void put(Cell const & x)
@@ -260,26 +299,30 @@ namespace {
             if(readyToSplit && lt(outputRange.getUpperBound(), x.getRow()))
             {
                 log("Compact thread: splitting output (sz=%s) at %s",
-                    sizeString(writer->size()),
+                    sizeString(getOpenSize()),
                     reprString(outputRange.getUpperBound().getValue()));
 
                 finalizeOutput();
             }
 
-            // If we don't have an active output, open a new one
-            if(!outputOpen)
+            // If the cell's group doesn't have an active output, open
+            // a new one
+            size_t g = groups.getCellGroup(x);
+            if(!writerOpen[g])
             {
                 // Start an output file for the compacting table
-                writer->start(table);
+                writers[g]->start(table);
+                writerOpen[g] = true;
                 outputOpen = true;
             }
 
             // Add another cell to the output
-            writer->put(x);
+            writers[g]->put(x);
 
             // Check to see if the output is large enough to split if
-            // haven't already chosen one.
-            if(!readyToSplit && writer->size() > OUTPUT_SPLIT_SIZE)
+            // haven't already chosen one.  The groups split together,
+            // so the check is on their total size.
+            if(!readyToSplit && getOpenSize() > OUTPUT_SPLIT_SIZE)
             {
                 // Choose a split point on a tablet boundary and restrict
                 // outputRange.  The last row we added to the output forms
@@ -313,7 +356,7 @@ namespace {
                 outputRange.setUpperBound(outputUpperBound);
                 log("Compact thread: last output upper bound = %s)", outputUpperBound);
 
-                log("Compact thread: last output (sz=%s)", sizeString(writer->size()));
+                log("Compact thread: last output (sz=%s)", sizeString(getOpenSize()));
                 finalizeOutput();
             }
         }
@@ -322,27 +365,57 @@ namespace {
         size_t getOutputSize() const { return outputSize; }
 
     private:
+        size_t getOpenSize() const
+        {
+            size_t sz = 0;
+            for(size_t g = 0; g < writers.size(); ++g)
+            {
+                if(writerOpen[g])
+                    sz += writers[g]->size();
+            }
+            return sz;
+        }
+
         void finalizeOutput()
         {
-            // Finalize output and reset to indicate we do not have an
-            // active output
-            outputSize += writer->size();
-            string uri = writer->finish();
-            ++nFragments;
-            outputOpen = false;
+            // Finalize each group's output and reset to indicate we
+            // do not have an active output
+            fragment_vec frags;
+            for(size_t g = 0; g < writers.size(); ++g)
+            {
+                if(!writerOpen[g])
+                    continue;
+
+                outputSize += writers[g]->size();
+                string uri = writers[g]->finish();
+                writerOpen[g] = false;
+                ++nFragments;
+
+                // Label the fragment with the families it may hold
+                if(!groups.isEmpty())
+                    uri = groups.getFamilySet(g).labelUri(uri);
 
-            // Open the newly written fragment
-            FragmentPtr frag = loader->load(uri);
+                // Open the newly written fragment
+                frags.push_back(loader->load(uri));
 
 #ifdef COMPACTOR_DEBUG
-            newFragments.insert(frag);
+                newFragments.insert(frags.back());
 #endif
+            }
+            outputOpen = false;
 
-            // Track the new file for automatic deletion
-            FileTracker::AutoTracker autoTrack(*tracker, frag->getDiskUri());
+            // Track the new files for automatic deletion
+            boost::ptr_vector<FileTracker::AutoTracker> autoTracks;
+            for(fragment_vec::const_iterator i = frags.begin();
+                i != frags.end(); ++i)
+            {
+                autoTracks.push_back(
+                    new FileTracker::AutoTracker(
+                        *tracker, (*i)->getDiskUri()));
+            }
 
             // Replace the adjacent fragment sequence for all mapped
-            // ranges in the output with the new fragment.
+            // ranges in the output with the new fragments.
             {
                 lock_t dagLock(dagMutex);
 
@@ -366,7 +439,7 @@ namespace {
                     // was already) updated in a different output.
                     Interval<string> clippedRange(range);
                     clippedRange.clip(outputRange);
-                    fragDag.replaceFragments(clippedRange, adjSeq, frag);
+                    fragDag.replaceFragments(clippedRange, adjSeq, frags);
                 }
             }
 
@@ -392,10 +465,14 @@ namespace {
 //----------------------------------------------------------------------------
 SharedCompactor::SharedCompactor(FragmentLoader * loader,
                                  FragmentWriter * writer,
-                                 warp::StatTracker * statTracker) :
+                                 warp::StatTracker * statTracker,
+                                 warp::WorkStealingPool * sharedPool,
+                                 AdmissionController * admission) :
     loader(loader),
     writer(writer),
     statTracker(statTracker),
+    sharedPool(sharedPool),
+    admission(admission),
     disabled(0),
     cancel(false),
     fragDag(statTracker)
@@ -507,7 +584,8 @@ void SharedCompactor::compact(vector<CompactionList> const & compactions)
     // External correctness depends on the following properties, but
     // this function doesn't actually care:
     //   - fragments is topologically ordered oldest to newest
-    //   - fragments must be in same locality group (e.g. 'table')
+    //   - fragments must be in same table; the output is split
+    //     back out by the table's locality groups
 
 
     // Random stuff we need to operate.  It probably should be
@@ -515,6 +593,7 @@ void SharedCompactor::compact(vector<CompactionList> const & compactions)
     // we'll just pull it from the first Tablet we see.
     FileTrackerPtr tracker;
     string table;
+    LocalityGroups groups;
 
     // Pull our random parameters from one of the tablets.  It 
     // doesn't matter which as all of the tablets should have the 
@@ -524,6 +603,7 @@ void SharedCompactor::compact(vector<CompactionList> const & compactions)
         Tablet const * t = compactions.front().tablet;
         tracker = t->getFileTracker();
         table = t->getTableName();
+        groups = t->getLocalityGroups();
     }
 
     // For each active tablet in compaction set, remember:
@@ -548,6 +628,9 @@ void SharedCompactor::compact(vector<CompactionList> const & compactions)
             CompactRangePtr p(new CompactRange(t->getRows()));
             p->fragments = (*i).fragments;
             p->isRooted = !(fragDag.getParent(p->fragments.front(), t));
+            p->isComplete = p->isRooted &&
+                !t->getFragmentChild(p->fragments.back());
+            p->retention = t->getRetentionPolicy();
             rangeMap.push_back(p);
         }
     }
@@ -611,7 +694,7 @@ void SharedCompactor::compact(vector<CompactionList> const & compactions)
     // in the order necessary for the new range.
 
     if(!readAhead)
-        readAhead.reset(new ReadAheadImpl());
+        readAhead.reset(new ReadAheadImpl(sharedPool));
 
     // When reading from fragments, only scan adjRange
     //   for fragment,adjRange in invRangeMap:
@@ -653,6 +736,7 @@ void SharedCompactor::compact(vector<CompactionList> const & compactions)
     // Prepare output
     CompactionOutput output(loader,
                             writer,
+                            groups,
                             tracker,
                             dagMutex,
                             fragDag,
@@ -660,6 +744,9 @@ void SharedCompactor::compact(vector<CompactionList> const & compactions)
                             fragments,
                             rangeMap);
 
+    // Retention limits are applied as of the start of the compaction
+    int64_t startTime = Timestamp::now();
+
     // Merge one range at a time
     range_vec::const_iterator i;
     for(i = rangeMap.begin();
@@ -684,8 +771,14 @@ void SharedCompactor::compact(vector<CompactionList> const & compactions)
             (filterErasures ? "rooted " : ""),
             ScanPredicate().setRowPredicate(IntervalSet<string>().add(range)));
 
-        // Build a merge from all inputs involved
+        // Build a merge from all inputs involved.  Range erasures
+        // hide cells in older fragments, so each input is filtered by
+        // the erasures of the newer inputs.  Scans don't apply a
+        // fragment's erasures to its own cells, so the erasures kept
+        // in the output can't hide the newer cells merged with them.
+        // A rooted merge also folds merge operands.
         CellStreamPtr merge = CellMerge::make(filterErasures);
+        vector<Cell> rangeErasures;
         for(fragment_vec::const_reverse_iterator f = adjSeq.rbegin();
             f != adjSeq.rend(); ++f)
         {
@@ -696,7 +789,43 @@ void SharedCompactor::compact(vector<CompactionList> const & compactions)
             inputStream->setCutoff(range.getUpperBound());
 
             // Add the input to the merge
-            merge->pipeFrom(inputStream);
+            if(rangeErasures.empty())
+            {
+                merge->pipeFrom(inputStream);
+            }
+            else
+            {
+                CellStreamPtr filter = makeRangeErasureFilter(rangeErasures);
+                filter->pipeFrom(inputStream);
+                merge->pipeFrom(filter);
+            }
+
+            // Collect the fragment's range erasures within the range
+            vector<Cell> fragErasures;
+            (*f)->getRangeErasures(fragErasures);
+            for(vector<Cell>::const_iterator e = fragErasures.begin();
+                e != fragErasures.end(); ++e)
+            {
+                Cell clipped = clipRangeErasure(*e, range);
+                if(clipped)
+                    rangeErasures.push_back(clipped);
+            }
+        }
+
+        // Drop cells past the table's retention limits.  A newer
+        // fragment outside the compaction may erase some of the
+        // versions here and expose older ones, so the version limits
+        // only apply when the compaction covers the tablet's whole
+        // history.  Age limits apply everywhere.
+        RetentionPolicy retention = (*i)->retention;
+        if(!(*i)->isComplete)
+            retention = retention.withoutVersionLimits();
+        if(!retention.isUnlimited())
+        {
+            CellStreamPtr filter = makeRetentionFilter(
+                retention, startTime);
+            filter->pipeFrom(merge);
+            merge = filter;
         }
 
         // Merge until we're out of input (i.e. done with the range)
@@ -708,6 +837,19 @@ void SharedCompactor::compact(vector<CompactionList> const & compactions)
             ++outputCells;
         }
 
+        // Once the compaction reaches the oldest fragment, everything
+        // the range erasures could hide has been dropped.  Otherwise
+        // they still apply to older fragments and must be kept.
+        if(!filterErasures)
+        {
+            for(vector<Cell>::const_iterator e = rangeErasures.begin();
+                e != rangeErasures.end(); ++e)
+            {
+                output.put(*e);
+                ++outputCells;
+            }
+        }
+
         // Did we have any output?
         if(outputBegin == outputCells)
         {
@@ -741,6 +883,7 @@ void SharedCompactor::compact(vector<CompactionList> const & compactions)
         output.getOutputFragmentCount(),
         output.getOutputSize(),
         outputCells, ms);
+    statTracker->addSample("Compaction.compact", timer.getElapsedNs() / 1000);
 
 #ifdef COMPACTOR_DEBUG
     {
@@ -782,6 +925,11 @@ void SharedCompactor::compactLoop()
         log("Compact thread: choosing compaction set");
         lock_t dagLock(dagMutex);
         vector<CompactionList> compactions = fragDag.chooseCompactionSet();
+        if(admission)
+        {
+            admission->setLevel(AdmissionController::TABLET_FRAGMENTS,
+                                fragDag.getMaxChainLength());
+        }
         dagLock.unlock();
         lock.lock();
         if(cancel || disabled)
@@ -39,7 +39,7 @@ namespace tablet {
 } // namespace tablet
 } // namespace kdi
 
-namespace warp { class WorkerPool; }
+namespace warp { class WorkStealingPool; }
 
 //----------------------------------------------------------------------------
 // SharedCompactor
@@ -53,6 +53,8 @@ class kdi::tablet::SharedCompactor :
     FragmentLoader * loader;
     FragmentWriter * writer;
     warp::StatTracker * statTracker;
+    warp::WorkStealingPool * sharedPool;
+    AdmissionController * admission;
 
     boost::mutex mutex;
     boost::condition wakeCond;
@@ -68,10 +70,17 @@ public:
     FragDag fragDag;
 
 public:
+    /// Create a compactor.  If \c sharedPool is non-null,
+    /// compaction read-ahead runs on it at background priority
+    /// instead of on a private thread pool.  If \c admission is
+    /// non-null, the compactor reports the longest tablet fragment
+    /// chain to it each time it looks for work.
     SharedCompactor(
       FragmentLoader * loader, 
       FragmentWriter * writer,
-      warp::StatTracker * statTracker
+      warp::StatTracker * statTracker,
+      warp::WorkStealingPool * sharedPool=0,
+      AdmissionController * admission=0
     );
     ~SharedCompactor();
 
@@ -96,11 +105,16 @@ public:
         }
     };
 
+    /// Run the given compactions now, on the calling thread.  The
+    /// compactor thread normally chooses what to compact; this is for
+    /// tools and tests that need a particular compaction.  Hold a
+    /// Pause to keep the compactor thread out of the way.
+    void compact(std::vector<CompactionList> const & compactions);
+
 private:
     void disableCompactions();
     void enableCompactions();
 
-    void compact(std::vector<CompactionList> const & compactions);
     void compactLoop();
 };
 
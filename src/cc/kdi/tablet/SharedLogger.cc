@@ -26,16 +26,21 @@
 #include <kdi/tablet/ConfigManager.h>
 #include <kdi/tablet/FileTracker.h>
 #include <kdi/tablet/LogFragment.h>
+#include <kdi/tablet/AdmissionController.h>
 #include <kdi/synchronized_table.h>
+#include <kdi/locality_groups.h>
 #include <kdi/scan_predicate.h>
 #include <warp/fs.h>
 #include <warp/file.h>
 #include <warp/uri.h>
 #include <warp/call_or_die.h>
 #include <warp/log.h>
+#include <warp/OpTrace.h>
+#include <warp/timer.h>
 #include <ex/exception.h>
 #include <boost/bind.hpp>
 #include <boost/format.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
 #include <vector>
 #include <string>
 #include <sstream>
@@ -141,6 +146,11 @@ public:
         return groupSize >= SERIALIZE_THRESHOLD_SZ;
     }
 
+    size_t getSize() const
+    {
+        return groupSize;
+    }
+
     /// Add a sequence of cells to the mutable table associated with
     /// the given Tablet.  If the Tablet doesn't already have a
     /// mutable table in the group, a new one will be created.  The
@@ -183,17 +193,106 @@ public:
             tablet->addFragment(frag);
         }
 
-        // Add all the cells to the writable table
+        // Add all the cells to the writable table.  Range erasures
+        // are kept on the side by the fragment.
         TablePtr const & tbl = frag->getWritableTable();
         for(std::vector<Cell>::const_iterator i = cells.begin();
             i != cells.end(); ++i)
         {
             groupSize += cellSize(*i);
-            tbl->insert(*i);
+            if(i->isRangeErasure())
+                frag->addRangeErasure(*i);
+            else
+                tbl->insert(*i);
         }
 
         // Flush the mutations
         tbl->sync();
+
+        // Now that scans can see them, drop stale cached results
+        tablet->mutationsApplied(cells);
+    }
+
+    /// Write the contents of a log fragment to disk fragments, one
+    /// for each locality group with data.  The log's range erasures
+    /// only apply to older fragments: the cells they hid in the log
+    /// were already replaced with cell erasures.
+    static void writeFragments(LogFragment const & log,
+                               LocalityGroups const & groups,
+                               std::string const & tableName,
+                               FragmentLoader * loader,
+                               FragmentWriter * writer,
+                               std::vector<FragmentPtr> & out)
+    {
+        vector<Cell> rangeErasures;
+        log.getRangeErasures(rangeErasures);
+
+        if(groups.isEmpty())
+        {
+            CellStreamPtr cells = log.scan(ScanPredicate());
+
+            writer->start(tableName);
+            Cell x;
+            while(cells->get(x))
+                writer->put(x);
+
+            for(vector<Cell>::const_iterator i = rangeErasures.begin();
+                i != rangeErasures.end(); ++i)
+            {
+                writer->put(*i);
+            }
+            out.push_back(loader->load(writer->finish()));
+            return;
+        }
+
+        // Make a pass over the log for each group.  The log is in
+        // memory, so this is cheaper than keeping an output open for
+        // every group.
+        for(size_t g = 0; g < groups.getGroupCount(); ++g)
+        {
+            CellStreamPtr cells = log.scan(ScanPredicate());
+
+            bool started = false;
+            Cell x;
+            while(cells->get(x))
+            {
+                if(groups.getCellGroup(x) != g)
+                    continue;
+                if(!started)
+                {
+                    writer->start(tableName);
+                    started = true;
+                }
+                writer->put(x);
+            }
+
+            for(vector<Cell>::const_iterator i = rangeErasures.begin();
+                i != rangeErasures.end(); ++i)
+            {
+                if(groups.getCellGroup(*i) != g)
+                    continue;
+                if(!started)
+                {
+                    writer->start(tableName);
+                    started = true;
+                }
+                writer->put(*i);
+            }
+
+            // Always write something to replace the log
+            if(!started && g + 1 == groups.getGroupCount() && out.empty())
+            {
+                writer->start(tableName);
+                started = true;
+            }
+
+            if(started)
+            {
+                string uri = groups.getFamilySet(g).labelUri(
+                    writer->finish());
+                out.push_back(loader->load(uri));
+            }
+        }
     }
 
     void serialize(FragmentLoader * loader, FragmentWriter * writer, FileTrackerPtr const & tracker) const
@@ -209,17 +308,22 @@ public:
             // We should have at least one Tablet
             assert(!info.tablets.empty());
 
-            // Write a DiskTable from the fragment
-            CellStreamPtr cells = info.fragment->scan(ScanPredicate());
-
-            writer->start(tableName);
-            Cell x;
-            while(cells->get(x))
-                writer->put(x);
-            FragmentPtr frag = loader->load(writer->finish());
-
-            // Track the new disk file for automatic deletion
-            FileTracker::AutoTracker autoTrack(*tracker, frag->getDiskUri());
+            // Write DiskTables from the fragment
+            vector<FragmentPtr> frags;
+            writeFragments(
+                *info.fragment,
+                info.tablets.front()->getLocalityGroups(),
+                tableName, loader, writer, frags);
+
+            // Track the new disk files for automatic deletion
+            boost::ptr_vector<FileTracker::AutoTracker> autoTracks;
+            for(vector<FragmentPtr>::const_iterator i = frags.begin();
+                i != frags.end(); ++i)
+            {
+                autoTracks.push_back(
+                    new FileTracker::AutoTracker(
+                        *tracker, (*i)->getDiskUri()));
+            }
 
             // Notify Tablets of the fragment change
             vector<FragmentPtr> oldFragments;
@@ -227,7 +331,7 @@ public:
             for(vector<TabletPtr>::const_iterator fi = info.tablets.begin();
                 fi != info.tablets.end(); ++fi)
             {
-                (*fi)->replaceFragments(oldFragments, frag);
+                (*fi)->replaceFragments(oldFragments, frags);
             }
 
             // XXX maybe should release memTable.  if a later
@@ -271,6 +375,11 @@ public:
         return tableMap.empty();
     }
 
+    size_t getSize() const
+    {
+        return bufferSize;
+    }
+
     void append(TabletPtr const & tablet, Cell const & cell)
     {
         bufferSize += cellSize(cell);
@@ -308,11 +417,15 @@ public:
 SharedLogger::SharedLogger(ConfigManagerPtr const & configMgr,
                            FragmentLoader * loader,
                            FragmentWriter * writer,
-                           FileTrackerPtr const & tracker) :
+                           FileTrackerPtr const & tracker,
+                           warp::StatTracker * statTracker,
+                           AdmissionController * admission) :
     configMgr(configMgr),
     loader(loader),
     writer(writer),
     tracker(tracker),
+    statTracker(statTracker),
+    admission(admission),
     commitBuffer(new CommitBuffer),
     tableGroup(new TableGroup),
     commitQueue(4),
@@ -322,6 +435,7 @@ SharedLogger::SharedLogger(ConfigManagerPtr const & configMgr,
     EX_CHECK_NULL(loader);
     EX_CHECK_NULL(writer);
     EX_CHECK_NULL(tracker);
+    EX_CHECK_NULL(statTracker);
 
     threads.create_thread(
         callOrDie(
@@ -416,6 +530,12 @@ void SharedLogger::flush(lock_t & lock)
     if(!commitQueue.push(commitBuffer))
         raise<RuntimeError>("push to commit queue failed");
 
+    // The buffered cells will be in memory until their table group
+    // has been serialized.
+    if(admission)
+        admission->addLevel(AdmissionController::MEMORY_BYTES,
+                            commitBuffer->getSize());
+
     // Make a new commit buffer.
     commitBuffer.reset(new CommitBuffer);
 }
@@ -432,6 +552,7 @@ void SharedLogger::commitLoop()
         buffer.reset())
     {
         //log("Commit thread got work");
+        OpTrace trace(statTracker, "Logger.commit");
 
         // Create a new log file if we need it
         if(!logWriter)
@@ -449,9 +570,11 @@ void SharedLogger::commitLoop()
 
         // Commit to log
         buffer->writeLog(logWriter);
+        trace.stage("writeLog");
         
         // Commit to tables
         buffer->replayToTables(tableGroup);
+        trace.stage("replay");
 
         // Schedule the mutable tables for serialization if they're
         // too big.
@@ -459,12 +582,17 @@ void SharedLogger::commitLoop()
         {
             log("Pushing table group for serialization");
 
+            if(admission)
+                admission->addLevel(
+                    AdmissionController::PENDING_SERIALIZATIONS, 1);
+
             // Push the group to the Serialize thread.  If this
             // fails, it's because the queue is full and waits
             // have been cancelled due to an error.  However, the
             // program should terminate before we hit this.
             if(!serializeQueue.push(tableGroup))
                 raise<RuntimeError>("push to serialize queue failed");
+            trace.stage("pushSerialize");
 
             // Make a new group
             tableGroup.reset(new TableGroup);
@@ -475,6 +603,7 @@ void SharedLogger::commitLoop()
         }
 
         // Notify queue that we're done with this work
+        trace.finish();
         commitQueue.taskComplete();
     }
 }
@@ -497,6 +626,20 @@ void SharedLogger::serializeLoop()
         serializeQueue.pop(group);
         group.reset())
     {
+        WallTimer timer;
         group->serialize(loader, writer, tracker);
+        statTracker->addSample("Logger.serialize",
+                               timer.getElapsedNs() / 1000);
+
+        // The group's memory tables have been replaced by disk
+        // fragments.
+        if(admission)
+        {
+            admission->addLevel(
+                AdmissionController::PENDING_SERIALIZATIONS, -1);
+            admission->addLevel(
+                AdmissionController::MEMORY_BYTES,
+                -int64_t(group->getSize()));
+        }
     }
 }
@@ -23,6 +23,7 @@
 
 #include <kdi/tablet/forward.h>
 #include <kdi/cell.h>
+#include <warp/StatTracker.h>
 #include <warp/syncqueue.h>
 #include <warp/synchronized.h>
 #include <boost/shared_ptr.hpp>
@@ -61,6 +62,8 @@ class kdi::tablet::SharedLogger
     FragmentWriter * writer;
 
     FileTrackerPtr tracker;
+    warp::StatTracker * statTracker;
+    AdmissionController * admission;
 
     CommitBufferPtr commitBuffer;
     LogWriterPtr logWriter;
@@ -72,10 +75,16 @@ class kdi::tablet::SharedLogger
     mutex_t publicMutex;
 
 public:
+    /// Create a logger.  Log commit and serialization latencies are
+    /// recorded in \c statTracker.  If \c admission is non-null, the
+    /// logger reports buffered memory table bytes and pending
+    /// serializations to it.
     SharedLogger(ConfigManagerPtr const & configMgr,
                  FragmentLoader * loader,
                  FragmentWriter * writer,
-                 FileTrackerPtr const & tracker);
+                 FileTrackerPtr const & tracker,
+                 warp::StatTracker * statTracker,
+                 AdmissionController * admission=0);
     ~SharedLogger();
 
     /// Set a cell in the given tablet. (main thread)
@@ -86,7 +95,9 @@ public:
     void erase(TabletPtr const & tablet, strref_t row, strref_t column,
                int64_t timestamp);
 
-    /// Insert a cell (or cell erasure) in the given tablet.
+    /// Insert a cell, cell erasure, or range erasure in the given
+    /// tablet.  Range erasures should already be clipped to the
+    /// tablet's rows.
     void insert(TabletPtr const & tablet, Cell const & cell);
 
     /// Make sure all outstanding mutations are sync'ed to disk.
@@ -34,7 +34,8 @@ using namespace std;
 SuperScanner::SuperScanner(SuperTabletCPtr const & superTablet,
                            ScanPredicate const & pred) :
     superTablet(superTablet),
-    pred(pred)
+    pred(pred),
+    generation(superTablet->getSplitGeneration())
 {
     if(pred.getRowPredicate())
         remainingRows = *pred.getRowPredicate();
@@ -44,7 +45,14 @@ SuperScanner::SuperScanner(SuperTabletCPtr const & superTablet,
 
 bool SuperScanner::get(Cell & x)
 {
-    boost::mutex::scoped_lock lock(mutex);
+    // Release scanner if tablets have split since the last call --
+    // we'll reopen it below
+    size_t currentGeneration = superTablet->getSplitGeneration();
+    if(generation != currentGeneration)
+    {
+        generation = currentGeneration;
+        scanner.reset();
+    }
 
     // Reopen scanner if we need to
     if(!scanner)
@@ -94,13 +102,6 @@ bool SuperScanner::get(Cell & x)
     }
 }
 
-void SuperScanner::reopen()
-{
-    // Release scanner -- we'll reopen it on the next call to get()
-    boost::mutex::scoped_lock lock(mutex);
-    scanner.reset();
-}
-
 void SuperScanner::setMinRow(IntervalPoint<string> const & minRow)
 {
     // Clip what what we've already scanned from what's left
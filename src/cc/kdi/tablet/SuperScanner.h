@@ -25,7 +25,6 @@
 #include <kdi/cell.h>
 #include <kdi/scan_predicate.h>
 #include <warp/interval.h>
-#include <boost/thread/mutex.hpp>
 #include <string>
 
 namespace kdi {
@@ -50,15 +49,16 @@ class kdi::tablet::SuperScanner
 
     CellStreamPtr scanner;
     Cell lastCell;
-
-    boost::mutex mutex;
+    size_t generation;
 
 public:
     SuperScanner(SuperTabletCPtr const & superTablet,
                  ScanPredicate const & pred);
 
+    /// Get the next cell.  If the SuperTablet has split since the
+    /// last call, the scanner reopens past the last cell returned.
+    /// No locks are taken in the common case.
     bool get(Cell & x);
-    void reopen();
 
 private:
     /// Clip remainingRows
@@ -25,10 +25,17 @@
 #include <kdi/tablet/WorkQueue.h>
 #include <kdi/tablet/SuperScanner.h>
 #include <kdi/tablet/SharedCompactor.h>
+#include <kdi/tablet/FileTracker.h>
+#include <kdi/tablet/FragmentLoader.h>
+#include <kdi/tablet/Fragment.h>
+#include <kdi/local/disk_table.h>
 #include <kdi/cell_filter.h>
+#include <kdi/range_erasure.h>
 #include <kdi/scan_predicate.h>
 #include <warp/interval.h>
 #include <warp/log.h>
+#include <warp/uri.h>
+#include <warp/fs.h>
 #include <boost/format.hpp>
 #include <boost/bind.hpp>
 
@@ -87,23 +94,6 @@ namespace {
             raise<ValueError>("row not on this server: %s", row);
     }
 
-    struct ReopenSuperScannerOrRemove
-    {
-        /// Reopen the scanner if the handle is still valid.  If not,
-        /// return true, as it should be removed from the list.
-        bool operator()(SuperScannerWeakPtr const & weakScanner) const
-        {
-            SuperScannerPtr scanner = weakScanner.lock();
-            if(scanner)
-            {
-                scanner->reopen();
-                return false;   // don't remove scanner
-            }
-            else
-                return true;    // remove expired scanner
-        }
-    };
-
 }
 
 //----------------------------------------------------------------------------
@@ -166,7 +156,12 @@ SuperTablet::SuperTablet(std::string const & name,
                          SharedCompactorPtr const & compactor,
                          FileTrackerPtr const & tracker,
                          WorkQueuePtr const & workQueue) :
+    tableName(name),
+    configMgr(configMgr),
     workQueue(workQueue),
+    loader(loader),
+    tracker(tracker),
+    splitGeneration(1),
     mutationsBlocked(false),
     mutationsPending(0)
 {
@@ -217,36 +212,92 @@ void SuperTablet::erase(strref_t row, strref_t column, int64_t timestamp)
 
 void SuperTablet::insert(Cell const & x)
 {
+    // Row range erasures may span tablets
+    if(x.getErasureKind() == ERASE_ROWS)
+    {
+        Table::insert(x);
+        return;
+    }
+
     MutationInterlock interlock(*this);
     getTablet(x.getRow())->insert(x);
 }
 
-CellStreamPtr SuperTablet::scan(ScanPredicate const & pred) const
+void SuperTablet::eraseRowRange(strref_t firstRow, strref_t endRow,
+                                int64_t maxTimestamp)
+{
+    Interval<string> rows = getRangeErasureRows(
+        makeRowRangeErasure(firstRow, endRow, maxTimestamp));
+
+    // Tablets don't split while mutations are pending
+    MutationInterlock interlock(*this);
+
+    vector<TabletPtr> targets;
+    {
+        lock_t lock(mutex);
+        for(vector<TabletPtr>::const_iterator i = tablets.begin();
+            i != tablets.end(); ++i)
+        {
+            if((*i)->getRows().overlaps(rows))
+                targets.push_back(*i);
+        }
+    }
+    if(targets.empty())
+        raise<RowNotInTabletError>("rows not on this server: %s", rows);
+
+    for(vector<TabletPtr>::const_iterator i = targets.begin();
+        i != targets.end(); ++i)
+    {
+        (*i)->eraseRowRange(firstRow, endRow, maxTimestamp);
+    }
+}
+
+void SuperTablet::eraseColumnFamily(strref_t row, strref_t family,
+                                    int64_t maxTimestamp)
 {
-    SuperScannerPtr scanner;
-    CellStreamPtr output;
+    MutationInterlock interlock(*this);
+    getTablet(row)->eraseColumnFamily(row, family, maxTimestamp);
+}
 
+void SuperTablet::merge(strref_t row, strref_t column, int64_t timestamp,
+                        strref_t op, strref_t operand)
+{
+    MutationInterlock interlock(*this);
+    getTablet(row)->merge(row, column, timestamp, op, operand);
+}
+
+CellStreamPtr SuperTablet::scan(ScanPredicate const & pred) const
+{
     // Put history filter on outside
     if(pred.getMaxHistory())
     {
         ScanPredicate p(pred);
         p.setMaxHistory(0);
-        scanner.reset(new SuperScanner(shared_from_this(), p));
-        output = makeHistoryFilter(pred.getMaxHistory());
+        CellStreamPtr scanner(new SuperScanner(shared_from_this(), p));
+        CellStreamPtr output = makeHistoryFilter(pred.getMaxHistory());
         output->pipeFrom(scanner);
+        return output;
     }
     else
     {
-        scanner.reset(new SuperScanner(shared_from_this(), pred));
-        output = scanner;
+        CellStreamPtr scanner(new SuperScanner(shared_from_this(), pred));
+        return scanner;
     }
+}
 
+size_t SuperTablet::get(strref_t row, strref_t column, size_t maxVersions,
+                        std::vector<Cell> & out) const
+{
+    for(;;)
     {
-        lock_t lock(scannerMutex);
-        scanners.push_back(scanner);
+        TabletPtr tablet = getTablet(row);
+        try {
+            return tablet->get(row, column, maxVersions, out);
+        }
+        catch(RowNotInTabletError const &) {
+            // The tablet split after we looked it up.  Try again.
+        }
     }
-
-    return output;
 }
 
 void SuperTablet::sync()
@@ -260,6 +311,104 @@ void SuperTablet::sync()
     }
 }
 
+void SuperTablet::loadFragment(std::string const & uri,
+                               warp::Interval<std::string> const & rows)
+{
+    if(rows.isEmpty())
+        raise<ValueError>("empty row range for fragment: %s", uri);
+
+    // Make sure we have a real table.  The fragment loader would
+    // quietly substitute an empty fragment for a bad file.
+    if(uriTopScheme(uri) != "disk")
+        raise<ValueError>("bulk fragment must be a disk URI: %s", uri);
+
+    // Only take files from under the server root.  Resolving the
+    // path also strips any ".." segments.
+    string root = fs::resolve(configMgr->getRootDir(), "");
+    string fn = fs::resolve(root, uriPopScheme(uri));
+    if(fn.compare(0, root.size(), root) != 0)
+        raise<ValueError>("bulk fragment must be under the server "
+                          "root %s: %s", root, uri);
+
+    size_t version = kdi::local::DiskTable::readVersion(fn);
+    if(version < 1)
+        raise<ValueError>("bulk fragment must be DiskTableV1 or later: "
+                          "%s is version %d", uri, version);
+
+    // Get the rows actually in the file.  They must fall in the
+    // given range.
+    Interval<string> span;
+    if(!kdi::local::DiskTable::loadTable(fn)->getRowSpan(span))
+        raise<ValueError>("bulk fragment has no cells: %s", uri);
+    if(!rows.contains(span))
+        raise<ValueError>("bulk fragment rows %s are outside %s: %s",
+                          span, rows, uri);
+
+    // Hold the tablet list steady.  Splits wait on this lock.
+    lock_t lock(mutex);
+
+    // Find the tablets that overlap the file.  Between them they
+    // must cover every row in it, or cells would be dropped.
+    vector<TabletPtr> targets;
+    IntervalSet<string> covered;
+    for(vector<TabletPtr>::const_iterator i = tablets.begin();
+        i != tablets.end(); ++i)
+    {
+        if((*i)->getRows().overlaps(span))
+        {
+            targets.push_back(*i);
+            covered.add((*i)->getRows());
+        }
+    }
+    if(!covered.contains(span))
+        raise<RowNotInTabletError>("rows not all on this server: %s",
+                                   span);
+
+    // Move the file under the server root with the rest of the
+    // table's data files
+    string dataFn = configMgr->getDataFile(tableName);
+    fs::rename(fn, dataFn, true);
+
+    log("SuperTablet: loading %s as %s into %d tablet(s)", uri, dataFn,
+        targets.size());
+
+    FragmentPtr frag = loader->load(uriPushScheme(dataFn, "disk"));
+
+    // Track the new disk file for automatic deletion
+    FileTracker::AutoTracker autoTrack(*tracker, frag->getDiskUri());
+
+    // Attach the fragment everywhere, then save all the new configs
+    // in one update.  If that fails, take the fragment back out of
+    // all the tablets.
+    vector<TabletPtr>::const_iterator loaded = targets.begin();
+    try {
+        for(; loaded != targets.end(); ++loaded)
+            (*loaded)->loadFragment(frag);
+
+        vector<TabletConfig> cfgs;
+        for(vector<TabletPtr>::const_iterator i = targets.begin();
+            i != targets.end(); ++i)
+        {
+            cfgs.push_back((*i)->getConfig());
+        }
+        configMgr->setTabletConfigs(tableName, cfgs);
+    }
+    catch(...) {
+        for(vector<TabletPtr>::const_iterator i = targets.begin();
+            i != loaded; ++i)
+        {
+            (*i)->unloadFragment(frag);
+        }
+        throw;
+    }
+
+    for(vector<TabletPtr>::const_iterator i = targets.begin();
+        i != targets.end(); ++i)
+    {
+        (*i)->activateFragment(frag);
+    }
+}
+
 void SuperTablet::requestSplit(Tablet * tablet)
 {
     workQueue->post(
@@ -296,11 +445,8 @@ void SuperTablet::performSplit(Tablet * tablet)
         tablets.begin(), tablets.end(), lowTablet, TabletLt());
     tablets.insert(it, lowTablet);
 
-    // Done with tablets
-    lock.unlock();
-
-    // Reopen scanners
-    updateScanners();
+    // Scanners will reopen on their next read
+    ++splitGeneration;
 }
 
 CellStreamPtr SuperTablet::scanFirstTablet(
@@ -326,16 +472,3 @@ TabletPtr const & SuperTablet::getTablet(strref_t row) const
     lock_t lock(mutex);
     return getTabletInternal(tablets.begin(), tablets.end(), row);
 }
-
-void SuperTablet::updateScanners()
-{
-    lock_t lock(scannerMutex);
-
-    // Reopen all valid scanners, remove all null scanners.
-    scanners.erase(
-        std::remove_if(
-            scanners.begin(),
-            scanners.end(),
-            ReopenSuperScannerOrRemove()),
-        scanners.end());
-}
@@ -24,6 +24,7 @@
 #include <kdi/table.h>
 #include <kdi/tablet/forward.h>
 #include <kdi/tablet/MetaConfigManager.h>
+#include <warp/interval.h>
 #include <ex/exception.h>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition.hpp>
@@ -53,11 +54,18 @@ class kdi::tablet::SuperTablet
     typedef boost::mutex mutex_t;
     typedef mutex_t::scoped_lock lock_t;
 
+    std::string tableName;
+    MetaConfigManagerPtr configMgr;
     WorkQueuePtr workQueue;
+    FragmentLoader * loader;
+    FileTrackerPtr tracker;
 
     std::vector<TabletPtr> tablets;
-    mutable std::vector<SuperScannerWeakPtr> scanners;
-    mutable mutex_t scannerMutex;
+
+    // Incremented (while holding the mutex) every time a tablet
+    // splits.  SuperScanners poll it without locking to find out
+    // when they need to reopen.
+    volatile size_t splitGeneration;
 
     bool mutationsBlocked;
     size_t mutationsPending;
@@ -87,6 +95,31 @@ public:
     virtual CellStreamPtr scan(ScanPredicate const & pred) const;
     virtual void sync();
 
+    /// Erase a row range in every Tablet it overlaps.
+    virtual void eraseRowRange(strref_t firstRow, strref_t endRow,
+                               int64_t maxTimestamp);
+    virtual void eraseColumnFamily(strref_t row, strref_t family,
+                                   int64_t maxTimestamp);
+    virtual void merge(strref_t row, strref_t column, int64_t timestamp,
+                       strref_t op, strref_t operand);
+
+    using Table::get;
+    virtual size_t get(strref_t row, strref_t column, size_t maxVersions,
+                       std::vector<Cell> & out) const;
+
+    /// Attach an externally written DiskTable to every Tablet
+    /// overlapping the given row range.  The fragment URI must name a
+    /// DiskTableV1 file with a "disk" scheme under the server root,
+    /// and the file must only contain cells within the row range.
+    /// The Tablets on this server must cover every row in the file.
+    /// The file is moved into the table's data directory.  From then
+    /// on it is owned by the server and will be deleted when it is no
+    /// longer used.  The configs of all the Tablets are saved in one
+    /// META update before this returns.  If that fails, the fragment
+    /// is removed from all of them.
+    void loadFragment(std::string const & uri,
+                      warp::Interval<std::string> const & rows);
+
     /// Add the tablet to the split queue.
     void requestSplit(Tablet * tablet);
 
@@ -100,13 +133,14 @@ public:
     CellStreamPtr scanFirstTablet(ScanPredicate const & pred,
                                   warp::Interval<std::string> * tabletRows) const;
 
+    /// Get the current split generation.  This number changes every
+    /// time a tablet is split.  No lock is taken, so the value may
+    /// be slightly stale.
+    size_t getSplitGeneration() const { return splitGeneration; }
+
 private:
     /// Get the Tablet containing the given row
     TabletPtr const & getTablet(strref_t row) const;
-
-    /// Call reopen() on all Scanners.  Expired scanners will be
-    /// filtered out of list as well.
-    void updateScanners();
 };
 
 
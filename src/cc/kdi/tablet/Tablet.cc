@@ -29,17 +29,23 @@
 #include <kdi/tablet/SharedCompactor.h>
 #include <kdi/tablet/SharedLogger.h>
 #include <kdi/scan_predicate.h>
+#include <kdi/scan_cache.h>
 #include <kdi/cell_filter.h>
 #include <kdi/cell_merge.h>
+#include <kdi/range_erasure.h>
+#include <kdi/merge_operator.h>
+#include <flux/merge.h>
 #include <warp/config.h>
 #include <warp/functional.h>
 #include <warp/algorithm.h>
 #include <warp/fs.h>
 #include <warp/uri.h>
 #include <warp/log.h>
+#include <warp/timestamp.h>
 #include <ex/exception.h>
 #include <boost/format.hpp>
 #include <boost/bind.hpp>
+#include <functional>
 
 #include <kdi/local/disk_table_writer.h>
 using kdi::local::DiskTableWriter;
@@ -115,11 +121,14 @@ Tablet::Tablet(std::string const & tableName,
     superTablet(superTablet),
     tableName(tableName),
     prettyName(makePrettyName(tableName, cfg.getTabletRows().getUpperBound())),
+    retention(cfg.getRetentionPolicy()),
+    groups(cfg.getLocalityGroups()),
     minRow(cfg.getTabletRows().getLowerBound()),
     maxRow(cfg.getTabletRows().getUpperBound()),
     mutationsPending(false),
     configChanged(false),
-    splitPending(false)
+    splitPending(false),
+    fragmentGeneration(1)
 {
     log("Tablet %p %s: created", this, getPrettyName());
 
@@ -200,6 +209,9 @@ Tablet::~Tablet()
         compactor->fragDag.removeTablet(this);
     }
 
+    // Cached scans are keyed by address, which may be reused
+    ScanCache::getGlobal().invalidateAll(this);
+
     lock_t lock(mutex);
 
     // Untrack files that we're still referencing -- once a Tablet is
@@ -233,6 +245,41 @@ void Tablet::erase(strref_t row, strref_t column, int64_t timestamp)
     mutationsPending = true;
 }
 
+void Tablet::eraseRowRange(strref_t firstRow, strref_t endRow,
+                           int64_t maxTimestamp)
+{
+    Cell x = clipRangeErasure(
+        makeRowRangeErasure(firstRow, endRow, maxTimestamp), getRows());
+    if(!x)
+        raise<RowNotInTabletError>("%s", firstRow);
+    logger->insert(shared_from_this(), x);
+
+    lock_t lock(mutex);
+    mutationsPending = true;
+}
+
+void Tablet::eraseColumnFamily(strref_t row, strref_t family,
+                               int64_t maxTimestamp)
+{
+    validateRow(row);
+    logger->insert(shared_from_this(),
+                   makeFamilyErasure(row, family, maxTimestamp));
+
+    lock_t lock(mutex);
+    mutationsPending = true;
+}
+
+void Tablet::merge(strref_t row, strref_t column, int64_t timestamp,
+                   strref_t op, strref_t operand)
+{
+    validateRow(row);
+    logger->insert(shared_from_this(),
+                   makeMergeCell(row, column, timestamp, op, operand));
+
+    lock_t lock(mutex);
+    mutationsPending = true;
+}
+
 void Tablet::sync()
 {
     lock_t lock(mutex);
@@ -261,19 +308,158 @@ CellStreamPtr Tablet::scan(ScanPredicate const & pred) const
     int history = p.getMaxHistory();
     p.setMaxHistory(0);
 
-    // Create a new scanner and keep track of it
-    ScannerPtr scanner(new Scanner(shared_from_this(), p));
-    LockedPtr<scanner_vec_t>(syncScanners)->push_back(scanner);
+    // Fragments only drop values.  A row projection has to wait
+    // until erasures from newer fragments have been merged in.
+    p.setProjection(pred.getInputProjection());
+
+    // Merge operands have to be folded over the Cells beneath them
+    // before the time predicate can pick versions, or a base Cell
+    // outside the range would drop out of the fold
+    ScanPredicate::TimestampSetCPtr times = p.getTimePredicate();
+    p.clearTimePredicate();
+
+    // Create a new scanner.  It will track fragment changes on its
+    // own.  If scan caching is on, try to replay an earlier result
+    // for the same fragment chain first.
+    CellStreamPtr scanner;
+    ScanCache & cache = ScanCache::getGlobal();
+    if(cache.isEnabled())
+    {
+        size_t generation = fragmentGeneration;
+        scanner = cache.get(this, generation, p);
+        if(!scanner)
+        {
+            scanner = cache.fill(
+                this, generation, p,
+                ScannerPtr(new Scanner(shared_from_this(), p)));
+        }
+    }
+    else
+        scanner.reset(new Scanner(shared_from_this(), p));
+
+    // Hide cells past the retention limits that haven't been
+    // compacted away yet.  This runs on every scan, after the cache,
+    // so a cached result can't outlive the retention horizon.
+    if(!retention.isUnlimited())
+    {
+        CellStreamPtr filter = makeRetentionFilter(
+            retention, Timestamp::now());
+        filter->pipeFrom(scanner);
+        scanner = filter;
+    }
 
-    // Add the history filter if we need it and return
+    // Apply the time predicate to the folded Cells
+    if(times)
+    {
+        CellStreamPtr filter = makeTimestampFilter(times);
+        filter->pipeFrom(scanner);
+        scanner = filter;
+    }
+
+    // Add the history filter if we need it
     if(history)
     {
         CellStreamPtr filter = makeHistoryFilter(history);
         filter->pipeFrom(scanner);
-        return filter;
+        scanner = filter;
     }
-    else
-        return scanner;
+
+    // Finish the projection.  Keys-only fragment scans still hand
+    // merge operands their values, so a folded Cell can come back
+    // with one.  Blank it again here.
+    if(pred.getProjection() != p.getProjection() ||
+       pred.getProjection() == ScanPredicate::PROJECT_KEYS)
+    {
+        CellStreamPtr filter = makeProjectionFilter(pred.getProjection());
+        filter->pipeFrom(scanner);
+        scanner = filter;
+    }
+    return scanner;
+}
+
+size_t Tablet::get(strref_t row, strref_t column, size_t maxVersions,
+                   vector<Cell> & out) const
+{
+    validateRow(row);
+
+    // Copy the fragment chain so we don't hold the lock while probing
+    fragments_t frags;
+    {
+        lock_t lock(mutex);
+        frags = fragments;
+    }
+
+    // Merge versions from newest fragment to oldest.  The first
+    // fragment to have a given timestamp wins, and erasures hide the
+    // matching cells in older fragments.  Timestamps are chosen by
+    // the writer, so an older fragment may still hold a newer
+    // version and every fragment has to be probed.  Range erasures
+    // hide cells in older fragments.  Fragments from other locality
+    // groups can't hold the column.
+    typedef map<int64_t, Cell, greater<int64_t> > version_map;
+    version_map versions;
+    vector<Cell> cells;
+    vector<Cell> erasures;
+    char const * sep = std::find(column.begin(), column.end(), ':');
+    StringRange family;
+    if(sep != column.end())
+        family = StringRange(column.begin(), sep);
+    for(fragments_t::const_reverse_iterator i = frags.rbegin();
+        i != frags.rend(); ++i)
+    {
+        if((*i)->mayContainFamily(family))
+        {
+            cells.clear();
+            (*i)->getCells(row, column, cells);
+            for(vector<Cell>::const_iterator ci = cells.begin();
+                ci != cells.end(); ++ci)
+            {
+                bool covered = false;
+                for(vector<Cell>::const_iterator ei = erasures.begin();
+                    ei != erasures.end() && !covered; ++ei)
+                {
+                    covered = rangeErasureCovers(*ei, *ci);
+                }
+                if(!covered)
+                    versions.insert(make_pair(ci->getTimestamp(), *ci));
+            }
+        }
+        (*i)->getRangeErasures(erasures);
+    }
+
+    // Drop the erasures and fold merge operands into the versions
+    // beneath them
+    cells.clear();
+    for(version_map::const_iterator i = versions.begin();
+        i != versions.end(); ++i)
+    {
+        if(!i->second.isErasure())
+            cells.push_back(i->second);
+    }
+    foldMergeVersions(cells);
+
+    // Versions past the retention limits are hidden until a
+    // compaction drops them
+    RetentionPolicy::Limits limits;
+    if(!cells.empty() && !retention.isUnlimited())
+        limits = retention.getLimits(cells.front().getColumnFamily());
+    if(limits.maxVersions &&
+       (!maxVersions || limits.maxVersions < maxVersions))
+    {
+        maxVersions = limits.maxVersions;
+    }
+    int64_t minTimestamp = limits.getMinTimestamp(Timestamp::now());
+
+    size_t n = 0;
+    for(vector<Cell>::const_iterator i = cells.begin();
+        i != cells.end() && (!maxVersions || n < maxVersions); ++i)
+    {
+        if(i->getTimestamp() < minTimestamp)
+            break;
+        out.push_back(*i);
+        ++n;
+    }
+    return n;
 }
 
 CellStreamPtr Tablet::getMergedScan(ScanPredicate const & pred) const
@@ -287,36 +473,68 @@ CellStreamPtr Tablet::getMergedScan(ScanPredicate const & pred) const
     // Get exclusive access to fragment list
     lock_t lock(mutex);
 
-    // If there is only one table, no merge is necessary but we still
-    // have to filter erasures.  The one exception to this is if the
-    // single table is fully-compacted disk table.
-    if(fragments.size() == 1)
+    // Range erasures apply to older fragments, so each fragment scan
+    // gets filtered separately.  Fragments with no cells in the scan
+    // are skipped without opening a stream, but their range erasures
+    // still apply.
+    Interval<string> rows = getRows();
+    vector<Cell> erasures;
+    vector<CellStreamPtr> scans;
+    bool needFilter = false;
+    for(fragments_t::const_reverse_iterator i = fragments.rbegin();
+        i != fragments.rend(); ++i)
     {
-        if(fragments.front()->isImmutable())
+        if((*i)->overlapsScan(rows, pred))
         {
-            // This is a compacted disk table.  It should contain no
-            // erasures.
-            return fragments.front()->scan(pred);
-        }
-        else
-        {
-            // The table may contain erasures.
-            CellStreamPtr filter = makeErasureFilter();
-            filter->pipeFrom(fragments.front()->scan(pred));
-            return filter;
+            CellStreamPtr s = (*i)->scan(pred);
+            if(!erasures.empty())
+            {
+                CellStreamPtr filter = makeRangeErasureFilter(erasures);
+                filter->pipeFrom(s);
+                s = filter;
+            }
+            scans.push_back(s);
+
+            if(!erasures.empty() || !(*i)->isImmutable())
+                needFilter = true;
         }
+        (*i)->getRangeErasures(erasures);
+    }
+
+    // A fragment isn't filtered by its own range erasures, but the
+    // cells they hid in it were replaced with cell erasures
+    if(!erasures.empty())
+        needFilter = true;
+
+    // If there is only one table, no merge is necessary.  A lone
+    // fragment is only fully compacted if it is the whole chain and
+    // has no range erasures.  Otherwise we still have to filter
+    // erasures and fold merge operands.
+    if(scans.size() == 1 && fragments.size() == 1 && !needFilter)
+    {
+        return scans.front();
+    }
+    else if(scans.size() == 1)
+    {
+        // The table may contain erasures and merge operands
+        CellStreamPtr filter = makeErasureFilter();
+        filter->pipeFrom(scans.front());
+
+        CellStreamPtr fold = makeMergeFoldFilter();
+        fold->pipeFrom(filter);
+        return fold;
     }
 
     // XXX may need to block if the merge width is too great
 
     // Need to build a merge stream (note that a 0-way merge is
-    // possible and well-formed).  Tables added to the merge in
-    // reverse order so later streams override earlier streams.
+    // possible and well-formed).  Scans are in reverse fragment
+    // order so later streams override earlier streams.
     CellStreamPtr merge = CellMerge::make(true);
-    for(fragments_t::const_reverse_iterator i = fragments.rbegin();
-        i != fragments.rend(); ++i)
+    for(vector<CellStreamPtr>::const_iterator i = scans.begin();
+        i != scans.end(); ++i)
     {
-        merge->pipeFrom((*i)->scan(pred));
+        merge->pipeFrom(*i);
     }
     return merge;
 }
@@ -354,6 +572,7 @@ TabletPtr Tablet::splitTablet()
 
     // Shrink this tablet to the upper row bounds.
     minRow = high.getLowerBound();
+    ScanCache::getGlobal().invalidateAll(this);
 
     // Post config changes.  Queue the upper tablet first because it
     // is somewhat less expensive to recover from a missing low tablet
@@ -396,13 +615,16 @@ Tablet::Tablet(Tablet const & o, Interval<string> const & rows) :
     superTablet(o.superTablet),
     tableName(o.tableName),
     prettyName(makePrettyName(tableName, rows.getUpperBound())),
+    retention(o.retention),
+    groups(o.groups),
     minRow(rows.getLowerBound()),
     maxRow(rows.getUpperBound()),
     fragments(o.fragments),
     mutationsPending(false),
     configChanged(false),
     splitPending(false),
-    clonedLogs(o.clonedLogs)
+    clonedLogs(o.clonedLogs),
+    fragmentGeneration(1)
 {
     // Add references to cloned fragment files
     log("Tablet %s: cloning %d fragment(s)", getPrettyName(), this->fragments.size());
@@ -460,7 +682,9 @@ void Tablet::saveConfig(lock_t & lock)
         lock.unlock();
 
         // Save our config
-        configMgr->setTabletConfig(tableName, TabletConfig(rows, uris));
+        configMgr->setTabletConfig(tableName,
+                                   TabletConfig(rows, uris, retention,
+                                                groups));
 
         lock.lock();
 
@@ -468,13 +692,34 @@ void Tablet::saveConfig(lock_t & lock)
         // saving the old one
     } while(configChanged);
 
-    // Release dead files
-    for(vector<string>::const_iterator i = deadFiles.begin();
-        i != deadFiles.end(); ++i)
+    // Release dead files, unless a Scanner is still reading them
+    retiredFiles.insert(retiredFiles.end(), deadFiles.begin(),
+                        deadFiles.end());
+    deadFiles.clear();
+    releaseRetiredFiles(lock);
+}
+
+void Tablet::releaseRetiredFiles(lock_t const & lock) const
+{
+    if(!lock)
+        raise<ValueError>("need lock");
+
+    // Files that left the chain at or before the oldest generation
+    // still being scanned are no longer needed
+    size_t oldest = size_t(-1);
+    if(!scanGenerations.empty())
+        oldest = scanGenerations.begin()->first;
+
+    dead_files_t::iterator keep = retiredFiles.begin();
+    for(dead_files_t::const_iterator i = retiredFiles.begin();
+        i != retiredFiles.end(); ++i)
     {
-        tracker->release(*i);
+        if(i->second <= oldest)
+            tracker->release(i->first);
+        else
+            *keep++ = *i;
     }
-    deadFiles.clear();
+    retiredFiles.erase(keep, retiredFiles.end());
 }
 
 std::vector<std::string> Tablet::getFragmentUris(lock_t const & lock) const
@@ -534,10 +779,151 @@ void Tablet::addFragment(FragmentPtr const & fragment)
     // Add a reference to the new file
     tracker->addReference(fragment->getDiskUri());
 
+    // Let scanners pick up the new fragment
+    ++fragmentGeneration;
+    ScanCache::getGlobal().invalidateAll(this);
+
     // Save changes to config
     postConfigChange(lock);
 }
 
+void Tablet::loadFragment(FragmentPtr const & fragment)
+{
+    EX_CHECK_NULL(fragment);
+    if(!fragment->isImmutable())
+        raise<ValueError>("loaded fragment must be immutable: %s",
+                          fragment->getFragmentUri());
+
+    log("Tablet %s: load fragment %s", getPrettyName(),
+        fragment->getFragmentUri());
+
+    lock_t lock(mutex);
+
+    // Insert the fragment ahead of the mutable log fragments at the
+    // end of the chain
+    fragments_t::iterator pos = fragments.end();
+    while(pos != fragments.begin() && !(*(pos - 1))->isImmutable())
+        --pos;
+    fragments.insert(pos, fragment);
+
+    // Add a reference to the new file
+    tracker->addReference(fragment->getDiskUri());
+
+    // Let scanners pick up the new fragment
+    ++fragmentGeneration;
+    ScanCache::getGlobal().invalidateAll(this);
+}
+
+void Tablet::activateFragment(FragmentPtr const & fragment)
+{
+    // Make the fragment available for compaction
+    lock_t dagLock(compactor->dagMutex);
+    compactor->fragDag.addFragment(this, fragment);
+    dagLock.unlock();
+
+    compactor->wakeup();
+
+    // Check to see if we should split
+    if(superTablet)
+    {
+        lock_t lock(mutex);
+        if(!splitPending && getDiskSize(lock) >= SPLIT_THRESHOLD)
+        {
+            splitPending = true;
+
+            lock.unlock();
+            superTablet->requestSplit(this);
+        }
+    }
+}
+
+void Tablet::unloadFragment(FragmentPtr const & fragment)
+{
+    log("Tablet %s: unload fragment %s", getPrettyName(),
+        fragment->getFragmentUri());
+
+    lock_t lock(mutex);
+
+    fragments_t::iterator i = std::find(
+        fragments.begin(), fragments.end(), fragment);
+    if(i == fragments.end())
+        return;
+    fragments.erase(i);
+
+    ++fragmentGeneration;
+    ScanCache::getGlobal().invalidateAll(this);
+
+    // A config with the fragment may have been saved in the meantime,
+    // so hold the file until a config without it is saved
+    deadFiles.push_back(
+        make_pair(fragment->getDiskUri(), size_t(fragmentGeneration)));
+    postConfigChange(lock);
+}
+
+TabletConfig Tablet::getConfig() const
+{
+    lock_t lock(mutex);
+    return TabletConfig(Interval<string>(minRow, maxRow),
+                        getFragmentUris(lock), retention, groups);
+}
+
+void Tablet::mutationsApplied(std::vector<Cell> const & cells) const
+{
+    ScanCache & cache = ScanCache::getGlobal();
+    if(!cache.isEnabled())
+        return;
+
+    // Mutations tend to come in runs on the same row
+    StringRange lastRow;
+    for(vector<Cell>::const_iterator i = cells.begin();
+        i != cells.end(); ++i)
+    {
+        // Range erasures may cover any cached scan
+        if(i->isRangeErasure())
+        {
+            cache.invalidateAll(this);
+            return;
+        }
+
+        if(i != cells.begin() && i->getRow() == lastRow)
+            continue;
+        lastRow = i->getRow();
+        cache.invalidateRow(this, lastRow);
+    }
+}
+
+size_t Tablet::getFragments(std::vector<FragmentPtr> & out) const
+{
+    lock_t lock(mutex);
+    out = fragments;
+    return fragmentGeneration;
+}
+
+size_t Tablet::pinFragments(std::vector<FragmentPtr> & out) const
+{
+    lock_t lock(mutex);
+    out = fragments;
+    size_t generation = fragmentGeneration;
+    ++scanGenerations[generation];
+    return generation;
+}
+
+void Tablet::unpinFragments(size_t generation) const
+{
+    lock_t lock(mutex);
+    std::map<size_t, size_t>::iterator i = scanGenerations.find(generation);
+    if(i == scanGenerations.end())
+        raise<ValueError>("generation not pinned: %d", generation);
+    if(--i->second)
+        return;
+
+    // The oldest pinned generation may have changed
+    bool wasOldest = (i == scanGenerations.begin());
+    scanGenerations.erase(i);
+    if(wasOldest)
+        releaseRetiredFiles(lock);
+}
+
 FragmentPtr Tablet::getFragmentParent(FragmentPtr const & f) const
 {
     lock_t lock(mutex);
@@ -627,7 +1013,7 @@ Tablet::getMaxAdjacentChain(
 
 void Tablet::replaceFragmentsInternal(
     std::vector<FragmentPtr> const & oldFragments,
-    FragmentPtr const & newFragment)
+    std::vector<FragmentPtr> const & newFragments)
 {
     // Lock tableSet
     lock_t lock(mutex);
@@ -638,20 +1024,16 @@ void Tablet::replaceFragmentsInternal(
         oldFragments.begin(), oldFragments.end());
     if(i != fragments.end())
     {
-        fragments_t::iterator end = i + oldFragments.size();
+        // Remove the old sequence and splice in the new one
+        i = fragments.erase(i, i + oldFragments.size());
+        fragments.insert(i, newFragments.begin(), newFragments.end());
 
-        if(newFragment)
+        // Add references to the new files
+        for(fragments_t::const_iterator f = newFragments.begin();
+            f != newFragments.end(); ++f)
         {
-            // Replace first item in the sequence
-            *i = newFragment;
-            ++i;
-
-            // Add a reference to the new file
-            tracker->addReference(newFragment->getDiskUri());
+            tracker->addReference((*f)->getDiskUri());
         }
-
-        // Remove the rest of the fragments from the set
-        fragments.erase(i, end);
     }
     else
     {
@@ -666,19 +1048,20 @@ void Tablet::replaceFragmentsInternal(
         raise<RuntimeError>("replaceFragments with unknown fragment sequence");
     }
 
-    // Unlock and update scanners.  Scanners must update before we
-    // can mark files for release, as the scanners may hold
-    // references to some of these files.
-    lock.unlock();
-    updateScanners();
-    lock.lock();
+    // Let scanners know the fragment chain has changed.  Each one
+    // will swap out the old fragments on its next read.  The old
+    // files are kept until the Scanners still reading them have
+    // moved on.
+    ++fragmentGeneration;
+    ScanCache::getGlobal().invalidateAll(this);
 
     // Mark old fragment files for release
     for(vector<FragmentPtr>::const_iterator i = oldFragments.begin();
         i != oldFragments.end(); ++i)
     {
         log("Tablet %s: ... drop fragment %s", getPrettyName(), (*i)->getFragmentUri());
-        deadFiles.push_back((*i)->getDiskUri());
+        deadFiles.push_back(
+            make_pair((*i)->getDiskUri(), size_t(fragmentGeneration)));
     }
 
     // Queue a config rewrite to save changes
@@ -687,14 +1070,26 @@ void Tablet::replaceFragmentsInternal(
 
 void Tablet::replaceFragments(std::vector<FragmentPtr> const & oldFragments,
                               FragmentPtr const & newFragment)
+{
+    EX_CHECK_NULL(newFragment);
+    replaceFragments(oldFragments, fragments_t(1, newFragment));
+}
+
+void Tablet::replaceFragments(std::vector<FragmentPtr> const & oldFragments,
+                              std::vector<FragmentPtr> const & newFragments)
 {
     // Check args
     if(oldFragments.empty())
         raise<ValueError>("replaceFragments with empty fragment sequence");
-    EX_CHECK_NULL(newFragment);
-
-    log("Tablet %s: replace %d fragment(s) with %s", getPrettyName(),
-        oldFragments.size(), newFragment->getFragmentUri());
+    if(newFragments.empty())
+        raise<ValueError>("replaceFragments with no new fragments");
+    for(fragments_t::const_iterator i = newFragments.begin();
+        i != newFragments.end(); ++i)
+    {
+        EX_CHECK_NULL(*i);
+        log("Tablet %s: replace %d fragment(s) with %s", getPrettyName(),
+            oldFragments.size(), (*i)->getFragmentUri());
+    }
 
     bool isLogReplacement = (oldFragments.size() == 1 &&
                              !oldFragments[0]->isImmutable());
@@ -727,7 +1122,7 @@ void Tablet::replaceFragments(std::vector<FragmentPtr> const & oldFragments,
         }
     }
     
-    replaceFragmentsInternal(oldFragments, newFragment);
+    replaceFragmentsInternal(oldFragments, newFragments);
 
     if(isLogReplacement)
     {
@@ -751,7 +1146,7 @@ void Tablet::replaceFragments(std::vector<FragmentPtr> const & oldFragments,
             lock.unlock();
 
             log("Tablet %s: forwarding update to clone", getPrettyName());
-            clonedTablet->replaceFragments(oldFragments, newFragment);
+            clonedTablet->replaceFragments(oldFragments, newFragments);
 
             lock.lock();
         }
@@ -766,7 +1161,11 @@ void Tablet::replaceFragments(std::vector<FragmentPtr> const & oldFragments,
         // replacement wold deadlock, since the compactor will have
         // the dagMutex.  Evil code!  :)
         lock_t dagLock(compactor->dagMutex);
-        compactor->fragDag.addFragment(this, newFragment);
+        for(fragments_t::const_iterator i = newFragments.begin();
+            i != newFragments.end(); ++i)
+        {
+            compactor->fragDag.addFragment(this, *i);
+        }
         dagLock.unlock();
 
         compactor->wakeup();
@@ -792,27 +1191,7 @@ void Tablet::removeFragments(std::vector<FragmentPtr> const & oldFragments)
     log("Tablet %s: remove %d fragment(s)", getPrettyName(),
         oldFragments.size());
 
-    replaceFragmentsInternal(oldFragments, FragmentPtr());
-}
-
-namespace
-{
-    struct ReopenScannerOrRemove
-    {
-        /// Reopen the scanner if the handle is still valid.  If not,
-        /// return true, as it should be removed from the list.
-        bool operator()(ScannerWeakPtr const & weakScanner) const
-        {
-            ScannerPtr scanner = weakScanner.lock();
-            if(scanner)
-            {
-                scanner->reopen();
-                return false;   // don't remove scanner
-            }
-            else
-                return true;    // remove expired scanner
-        }
-    };
+    replaceFragmentsInternal(oldFragments, fragments_t());
 }
 
 size_t Tablet::getDiskSize(lock_t const & lock) const
@@ -872,16 +1251,3 @@ std::string Tablet::chooseSplitRow(lock_t & lock) const
     lock.lock();
     return x.first;
 }
-
-void Tablet::updateScanners()
-{
-    LockedPtr<scanner_vec_t> scanners(syncScanners);
-
-    // Reopen all valid scanners, remove all null scanners.
-    scanners->erase(
-        std::remove_if(
-            scanners->begin(),
-            scanners->end(),
-            ReopenScannerOrRemove()),
-        scanners->end());
-}
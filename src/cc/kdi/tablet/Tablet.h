@@ -23,8 +23,9 @@
 
 #include <kdi/tablet/forward.h>
 #include <kdi/table.h>
+#include <kdi/retention_policy.h>
+#include <kdi/locality_groups.h>
 #include <warp/interval.h>
-#include <warp/synchronized.h>
 #include <ex/exception.h>
 
 #include <boost/enable_shared_from_this.hpp>
@@ -60,7 +61,10 @@ class kdi::tablet::Tablet
     typedef mutex_t::scoped_lock lock_t;
 
     typedef std::vector<FragmentPtr> fragments_t;
-    typedef std::vector<ScannerWeakPtr> scanner_vec_t;
+
+    // Files dropped from the fragment chain, each with the first
+    // fragment generation that doesn't include it
+    typedef std::vector<std::pair<std::string, size_t> > dead_files_t;
 
 private:
     // These are initialized by the constructor and never change.
@@ -73,6 +77,8 @@ private:
     SuperTablet *          const superTablet;
     std::string            const tableName;
     std::string            const prettyName;
+    RetentionPolicy        const retention;
+    LocalityGroups         const groups;
 
     warp::IntervalPoint<std::string>       minRow;
     warp::IntervalPoint<std::string> const maxRow;
@@ -81,7 +87,7 @@ private:
     // to them should be synchronized by holding a lock on the Tablet
     // mutex.
     fragments_t                  fragments;
-    std::vector<std::string>     deadFiles;
+    dead_files_t                 deadFiles;
     bool                         mutationsPending;
     bool                         configChanged;
     bool                         splitPending;
@@ -89,8 +95,19 @@ private:
     std::map<FragmentPtr, TabletPtr> clonedLogs;
     std::set<FragmentPtr>            duplicatedLogs;
 
+    // Incremented (while holding the Tablet mutex) every time the
+    // fragment chain changes.  Scanners poll it without locking to
+    // find out when they need to update their inputs.
+    volatile size_t fragmentGeneration;
+
+    // Number of Scanners reading each fragment generation, and dead
+    // files whose config change has been saved but which older
+    // Scanners may still be reading.  Files are released once no
+    // Scanner reads a generation that includes them.
+    mutable std::map<size_t, size_t> scanGenerations;
+    mutable dead_files_t             retiredFiles;
+
     mutable mutex_t mutex;
-    mutable warp::Synchronized<scanner_vec_t> syncScanners;
 
 private:
     Tablet(std::string const & tableName,
@@ -122,6 +139,26 @@ public:
     void sync();
     CellStreamPtr scan(ScanPredicate const & pred) const;
 
+    /// Erase a row range.  The range is clipped to the Tablet's rows.
+    /// If it doesn't overlap the Tablet at all, a RowNotInTabletError
+    /// is raised.
+    void eraseRowRange(strref_t firstRow, strref_t endRow,
+                       int64_t maxTimestamp);
+    void eraseColumnFamily(strref_t row, strref_t family,
+                           int64_t maxTimestamp);
+
+    /// Log a merge operand.  Operands are folded on reads and in
+    /// rooted compactions.
+    void merge(strref_t row, strref_t column, int64_t timestamp,
+               strref_t op, strref_t operand);
+
+    /// Point lookup that bypasses the scanner machinery.  Fragments
+    /// are probed directly from newest to oldest and merged, with
+    /// newer fragments overriding older ones.
+    using Table::get;
+    size_t get(strref_t row, strref_t column, size_t maxVersions,
+               std::vector<Cell> & out) const;
+
     /// Get the name of table of which this Tablet is a part
     std::string const & getTableName() const { return tableName; }
 
@@ -134,6 +171,14 @@ public:
     /// XXX ...
     FileTrackerPtr const & getFileTracker() const { return tracker; }
 
+    /// Get the garbage collection limits for the table.  Compactions
+    /// drop cells past the limits, and scans hide them until then.
+    RetentionPolicy const & getRetentionPolicy() const { return retention; }
+
+    /// Get the column family locality groups for the table.  New
+    /// fragments are written with one fragment for each group.
+    LocalityGroups const & getLocalityGroups() const { return groups; }
+
     /// Get a merged scan of all the tables in this this Tablet, using
     /// the given predicate.  This method does not support history
     /// predicates.
@@ -142,6 +187,50 @@ public:
     /// Add a new fragment to the Tablet.
     void addFragment(FragmentPtr const & fragment);
 
+    /// Attach an externally written immutable fragment to the Tablet,
+    /// as from a bulk load.  The fragment is placed after all
+    /// existing disk fragments but before any logs that are still
+    /// being written, so mutations already in the log override
+    /// loaded cells.  The caller must save the new config (see
+    /// getConfig()) and then call either activateFragment() or
+    /// unloadFragment().  Until then the fragment is visible to
+    /// scans but won't be compacted.
+    void loadFragment(FragmentPtr const & fragment);
+
+    /// Make a fragment attached with loadFragment() available for
+    /// compaction, once its config has been saved.
+    void activateFragment(FragmentPtr const & fragment);
+
+    /// Remove a fragment attached with loadFragment(), as when its
+    /// config couldn't be saved.  A config without the fragment is
+    /// queued for saving.
+    void unloadFragment(FragmentPtr const & fragment);
+
+    /// Get the Tablet's current config.
+    TabletConfig getConfig() const;
+
+    /// Note that mutations have been applied to the Tablet's log
+    /// fragment and are visible to scans.  Called by the SharedLogger
+    /// to invalidate cached scan results.
+    void mutationsApplied(std::vector<Cell> const & cells) const;
+
+    /// Get a copy of the current fragment chain, oldest first.
+    /// Returns the fragment generation matching the copy.
+    size_t getFragments(std::vector<FragmentPtr> & out) const;
+
+    /// Like getFragments(), but also keep the files of the returned
+    /// fragments from being released until unpinFragments() is
+    /// called with the returned generation.
+    size_t pinFragments(std::vector<FragmentPtr> & out) const;
+
+    /// Release a generation pinned by pinFragments().
+    void unpinFragments(size_t generation) const;
+
+    /// Get the current fragment generation.  This number changes
+    /// every time fragments are replaced in the Tablet.  It is never
+    /// zero.  No lock is taken, so the value may be slightly stale.
+    size_t getFragmentGeneration() const { return fragmentGeneration; }
+
     FragmentPtr getFragmentParent(FragmentPtr const & f) const;
     FragmentPtr getFragmentChild(FragmentPtr const & f) const;
 
@@ -152,16 +241,22 @@ public:
 
 private:
     /// Remove old fragments from fragment list.  Replace with
-    /// newFragment if non-null.
+    /// newFragments, which may be empty.
     void replaceFragmentsInternal(
         std::vector<FragmentPtr> const & oldFragments,
-        FragmentPtr const & newFragment);
+        std::vector<FragmentPtr> const & newFragments);
 
 public:
     /// Replace a sequence of fragments with a new fragment.
     void replaceFragments(std::vector<FragmentPtr> const & oldFragments,
                           FragmentPtr const & newFragment);
 
+    /// Replace a sequence of fragments with a non-empty sequence of
+    /// new fragments, as when the replacement is split into locality
+    /// groups.
+    void replaceFragments(std::vector<FragmentPtr> const & oldFragments,
+                          std::vector<FragmentPtr> const & newFragments);
+
     /// Remove a sequence of fragments from the tablet
     void removeFragments(std::vector<FragmentPtr> const & oldFragments);
 
@@ -206,13 +301,12 @@ private:
 
     std::vector<std::string> getFragmentUris(lock_t const & lock) const;
 
+    /// Release the retired files no Scanner is still reading.
+    void releaseRetiredFiles(lock_t const & lock) const;
+
     size_t getDiskSize(lock_t const & lock) const;
     std::string chooseSplitRow(lock_t & lock) const;
 
-    /// Call reopen() on all Scanners.  Expired scanners will be
-    /// filtered out of list as well.
-    void updateScanners();
-
     /// Make sure row is in tablet range or raise a
     /// RowNotInTabletError
     inline void validateRow(strref_t row) const;
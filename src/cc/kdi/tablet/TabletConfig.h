@@ -21,6 +21,8 @@
 #ifndef KDI_TABLET_TABLETCONFIG_H
 #define KDI_TABLET_TABLETCONFIG_H
 
+#include <kdi/retention_policy.h>
+#include <kdi/locality_groups.h>
 #include <warp/interval.h>
 #include <string>
 #include <vector>
@@ -41,17 +43,25 @@ class kdi::tablet::TabletConfig
 private:
     warp::Interval<std::string> rows;
     std::vector<std::string> uris;
+    RetentionPolicy retention;
+    LocalityGroups groups;
 
 public:
     /// Create a TabletConfig object.  The rows parameter indicates
     /// the row span covered by the Tablet.  The uris parameter should
     /// contain the ordered list of table URIs that make up the
     /// Tablet.  Each table URI should be suitable for passing to
-    /// ConfigManager::openTable().
+    /// ConfigManager::openTable().  The retention parameter gives
+    /// the garbage collection limits for the Tablet's table, and the
+    /// groups parameter gives its column family locality groups.
     TabletConfig(warp::Interval<std::string> const & rows,
-                 std::vector<std::string> const & uris) :
+                 std::vector<std::string> const & uris,
+                 RetentionPolicy const & retention = RetentionPolicy(),
+                 LocalityGroups const & groups = LocalityGroups()) :
         rows(rows),
-        uris(uris)
+        uris(uris),
+        retention(retention),
+        groups(groups)
     {
     }
 
@@ -68,6 +78,18 @@ public:
     {
         return rows;
     }
+
+    /// Get the garbage collection limits for the Tablet's table.
+    RetentionPolicy const & getRetentionPolicy() const
+    {
+        return retention;
+    }
+
+    /// Get the locality groups for the Tablet's table.
+    LocalityGroups const & getLocalityGroups() const
+    {
+        return groups;
+    }
 };
 
 
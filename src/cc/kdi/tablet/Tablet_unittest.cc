@@ -0,0 +1,571 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <kdi/tablet/Tablet.h>
+#include <kdi/tablet/TabletConfig.h>
+#include <kdi/tablet/ConfigManager.h>
+#include <kdi/tablet/SharedLogger.h>
+#include <kdi/tablet/SharedCompactor.h>
+#include <kdi/tablet/WorkQueue.h>
+#include <kdi/tablet/FileTracker.h>
+#include <kdi/tablet/Fragment.h>
+#include <kdi/tablet/DiskFragmentLoader.h>
+#include <kdi/tablet/DiskFragmentWriter.h>
+#include <kdi/tablet/SwitchedFragmentLoader.h>
+#include <kdi/merge_operator.h>
+#include <kdi/scan_cache.h>
+#include <kdi/scan_predicate.h>
+#include <kdi/table_unittest.h>
+#include <warp/StatTracker.h>
+#include <warp/timestamp.h>
+#include <warp/fs.h>
+#include <unittest/main.h>
+#include <boost/format.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <string>
+#include <vector>
+#include <list>
+#include <unistd.h>
+
+using namespace kdi;
+using namespace kdi::tablet;
+using namespace kdi::unittest;
+using namespace warp;
+using namespace std;
+using boost::format;
+
+namespace
+{
+    /// ConfigManager that doesn't save anything and puts data files
+    /// in a memfs directory.
+    class TestConfigManager : public ConfigManager
+    {
+        string root;
+        size_t nextFile;
+
+    public:
+        explicit TestConfigManager(string const & root) :
+            root(root), nextFile(0) {}
+
+        std::list<TabletConfig> loadTabletConfigs(string const & tableName)
+        {
+            return std::list<TabletConfig>();
+        }
+
+        void setTabletConfig(string const & tableName,
+                             TabletConfig const & cfg)
+        {
+        }
+
+        string getDataFile(string const & tableName)
+        {
+            return fs::resolve(
+                root, (format("%s/%d") % tableName % nextFile++).str());
+        }
+    };
+
+    /// Flag that one thread sets and another waits for.
+    class Signal
+    {
+        boost::mutex mutex;
+        boost::condition cond;
+        bool set;
+
+    public:
+        Signal() : set(false) {}
+
+        void notify()
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            set = true;
+            cond.notify_all();
+        }
+
+        void wait()
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            while(!set)
+                cond.wait(lock);
+        }
+    };
+
+    /// The parts of a tablet server needed to run Tablets, with
+    /// compactions only on request.
+    class TabletFixture
+    {
+        NullStatTracker stats;
+        ConfigManagerPtr configMgr;
+        FileTrackerPtr tracker;
+
+        DiskFragmentLoader diskLoader;
+        SwitchedFragmentLoader loader;
+        DiskFragmentWriter fragWriter;
+        DiskFragmentWriter loggerWriter;
+        DiskFragmentWriter compactorWriter;
+
+        SharedLoggerPtr logger;
+        SharedCompactorPtr compactor;
+        WorkQueuePtr workQueue;
+        boost::scoped_ptr<SharedCompactor::Pause> pause;
+
+    public:
+        explicit TabletFixture(string const & root) :
+            configMgr(new TestConfigManager(root)),
+            tracker(new FileTracker),
+            diskLoader(&stats),
+            fragWriter(configMgr),
+            loggerWriter(configMgr),
+            compactorWriter(configMgr)
+        {
+            loader.setLoader("disk", &diskLoader);
+            logger.reset(
+                new SharedLogger(configMgr, &loader, &loggerWriter,
+                                 tracker, &stats));
+            compactor.reset(
+                new SharedCompactor(&loader, &compactorWriter, &stats));
+            pause.reset(new SharedCompactor::Pause(*compactor));
+            workQueue.reset(new WorkQueue(1));
+        }
+
+        ~TabletFixture()
+        {
+            pause.reset();
+            compactor->shutdown();
+            workQueue->shutdown();
+            logger->shutdown();
+        }
+
+        /// Write an immutable fragment holding the given cells, which
+        /// must be in order.
+        string writeFragment(vector<Cell> const & cells)
+        {
+            fragWriter.start("test");
+            for(vector<Cell>::const_iterator i = cells.begin();
+                i != cells.end(); ++i)
+            {
+                fragWriter.put(*i);
+            }
+            return fragWriter.finish();
+        }
+
+        /// Make a Tablet over all rows from the given fragments,
+        /// oldest first.
+        TabletPtr makeTablet(vector<string> const & uris,
+                             RetentionPolicy const & retention =
+                             RetentionPolicy())
+        {
+            TabletConfig cfg(Interval<string>().setInfinite(), uris,
+                             retention);
+            return Tablet::make("test", configMgr, &loader, logger,
+                                compactor, tracker, workQueue, cfg);
+        }
+
+        /// Wait for the config saves queued so far to finish.
+        void waitForConfigSaves()
+        {
+            Signal done;
+            workQueue->post(boost::bind(&Signal::notify, &done));
+            done.wait();
+        }
+
+        /// Compact fragments [first, last) of the tablet's chain.
+        void compact(TabletPtr const & tablet, size_t first, size_t last)
+        {
+            vector<FragmentPtr> frags;
+            tablet->getFragments(frags);
+
+            vector<CompactionList> c(1);
+            c[0].tablet = tablet.get();
+            c[0].fragments.assign(frags.begin() + first,
+                                  frags.begin() + last);
+            compactor->compact(c);
+        }
+    };
+
+    /// Collect Cells for a fragment
+    class CellList : public vector<Cell>
+    {
+    public:
+        CellList & set(char const * row, char const * col, int64_t ts,
+                       char const * val)
+        {
+            push_back(makeCell(row, col, ts, val));
+            return *this;
+        }
+
+        CellList & erase(char const * row, char const * col, int64_t ts)
+        {
+            push_back(makeCellErasure(row, col, ts));
+            return *this;
+        }
+
+        CellList & push(Cell const & x)
+        {
+            push_back(x);
+            return *this;
+        }
+
+        CellList & merge(char const * row, char const * col, int64_t ts,
+                         char const * op, char const * operand)
+        {
+            push_back(makeMergeCell(row, col, ts, op, operand));
+            return *this;
+        }
+    };
+}
+
+BOOST_AUTO_UNIT_TEST(merge_time_predicate_test)
+{
+    TabletFixture fix("memfs:/Tablet_unittest/merge_time");
+    test_out_t out;
+
+    // The base is older than the time range, but the operand folded
+    // over it is in the range
+    vector<string> uris;
+    uris.push_back(fix.writeFragment(CellList().set("a", "n", 1, "10")));
+    uris.push_back(fix.writeFragment(
+                       CellList().merge("a", "n", 3, "add", "5")));
+    TabletPtr t = fix.makeTablet(uris);
+
+    BOOST_CHECK((out << *t->scan(ScanPredicate())).is_equal(
+                    "(a,n,3,15)"));
+    BOOST_CHECK((out << *t->scan(ScanPredicate("time >= @2"))).is_equal(
+                    "(a,n,3,15)"));
+
+    // The fold takes the operand's timestamp, so a range that only
+    // holds the base sees nothing
+    BOOST_CHECK((out << *t->scan(ScanPredicate("time <= @2"))).is_empty());
+}
+
+BOOST_AUTO_UNIT_TEST(merge_same_timestamp_test)
+{
+    TabletFixture fix("memfs:/Tablet_unittest/merge_same_ts");
+    test_out_t out;
+
+    // An operand with the same timestamp as an older one replaces it,
+    // like any other write to the same key
+    vector<string> uris;
+    uris.push_back(fix.writeFragment(
+                       CellList()
+                       .set("a", "n", 1, "10")
+                       .merge("b", "n", 3, "add", "5")));
+    uris.push_back(fix.writeFragment(
+                       CellList()
+                       .merge("a", "n", 3, "add", "5")
+                       .merge("b", "n", 3, "add", "2")));
+    uris.push_back(fix.writeFragment(
+                       CellList().merge("a", "n", 3, "add", "2")));
+    TabletPtr t = fix.makeTablet(uris);
+
+    BOOST_CHECK((out << *t->scan(ScanPredicate())).is_equal(
+                    "(a,n,3,12)"
+                    "(b,n,3,2)"
+                    ));
+
+    // Compacting the operands without their base doesn't change it
+    fix.compact(t, 1, 3);
+    BOOST_CHECK((out << *t->scan(ScanPredicate())).is_equal(
+                    "(a,n,3,12)"
+                    "(b,n,3,2)"
+                    ));
+}
+
+BOOST_AUTO_UNIT_TEST(merge_keys_projection_test)
+{
+    TabletFixture fix("memfs:/Tablet_unittest/merge_keys");
+    test_out_t out;
+
+    vector<string> uris;
+    uris.push_back(fix.writeFragment(
+                       CellList()
+                       .set("a", "n", 1, "10")
+                       .set("b", "n", 1, "7")));
+    uris.push_back(fix.writeFragment(
+                       CellList().merge("a", "n", 3, "add", "5")));
+    TabletPtr t = fix.makeTablet(uris);
+
+    // Folded Cells come back without values in a keys-only scan
+    BOOST_CHECK((out << *t->scan(ScanPredicate("project = keys")))
+                .is_equal(
+                    "(a,n,3,)"
+                    "(b,n,1,)"
+                    ));
+    BOOST_CHECK((out << *t->scan(ScanPredicate())).is_equal(
+                    "(a,n,3,15)"
+                    "(b,n,1,7)"
+                    ));
+}
+
+namespace
+{
+    /// Make a tablet with a range erasure in the middle fragment and
+    /// a cell set after it with an older timestamp in the newest one.
+    TabletPtr makeErasureTablet(TabletFixture & fix)
+    {
+        vector<string> uris;
+        uris.push_back(fix.writeFragment(
+                           CellList()
+                           .set("a", "x", 10, "a0")
+                           .set("b", "x", 10, "b0")
+                           .set("c", "x", 10, "c0")));
+        uris.push_back(fix.writeFragment(
+                           CellList()
+                           .set("c", "x", 30, "c1")
+                           .erase("c", "x", 10)
+                           .push(makeRowRangeErasure("a", "c", 20))));
+        uris.push_back(fix.writeFragment(
+                           CellList().set("a", "x", 5, "a2")));
+        return fix.makeTablet(uris);
+    }
+
+    /// Check the cells visible in a tablet made by makeErasureTablet()
+    void checkErasureTablet(TabletPtr const & t)
+    {
+        test_out_t out;
+
+        // The erasure hides the older cells but not the cell set
+        // after it
+        BOOST_CHECK((out << *t->scan(ScanPredicate())).is_equal(
+                        "(a,x,5,a2)"
+                        "(c,x,30,c1)"
+                        ));
+
+        vector<Cell> cells;
+        BOOST_CHECK_EQUAL(t->get("a", "x", 0, cells), 1u);
+        BOOST_CHECK_EQUAL(t->get("b", "x", 0, cells), 0u);
+        BOOST_CHECK((out << cells).is_equal("(a,x,5,a2)"));
+    }
+}
+
+BOOST_AUTO_UNIT_TEST(range_erasure_test)
+{
+    TabletFixture fix("memfs:/Tablet_unittest/range_erasure");
+    checkErasureTablet(makeErasureTablet(fix));
+}
+
+BOOST_AUTO_UNIT_TEST(range_erasure_partial_compaction_test)
+{
+    // The erasure is kept in the output along with the newer cell
+    TabletFixture fix("memfs:/Tablet_unittest/range_erasure_partial");
+    TabletPtr t = makeErasureTablet(fix);
+    fix.compact(t, 1, 3);
+    checkErasureTablet(t);
+
+    // Then everything gets compacted and the erasure dropped
+    fix.compact(t, 0, 2);
+    checkErasureTablet(t);
+}
+
+BOOST_AUTO_UNIT_TEST(range_erasure_rooted_compaction_test)
+{
+    // The erasure is dropped with the cells it hides
+    TabletFixture fix("memfs:/Tablet_unittest/range_erasure_rooted");
+    TabletPtr t = makeErasureTablet(fix);
+    fix.compact(t, 0, 2);
+    checkErasureTablet(t);
+}
+
+BOOST_AUTO_UNIT_TEST(range_erasure_full_compaction_test)
+{
+    TabletFixture fix("memfs:/Tablet_unittest/range_erasure_full");
+    TabletPtr t = makeErasureTablet(fix);
+    fix.compact(t, 0, 3);
+    checkErasureTablet(t);
+}
+
+BOOST_AUTO_UNIT_TEST(range_erasure_log_test)
+{
+    TabletFixture fix("memfs:/Tablet_unittest/range_erasure_log");
+    TabletPtr t = fix.makeTablet(vector<string>());
+    test_out_t out;
+
+    // Erasures in the log only hide the cells logged before them
+    t->set("a", "x", 10, "a0");
+    t->set("b", "x", 10, "b0");
+    t->eraseRowRange("a", "c", 20);
+    t->set("a", "x", 5, "a2");
+    t->eraseColumnFamily("b", "y", 20);
+    t->set("b", "y", 5, "b1");
+    t->sync();
+
+    BOOST_CHECK((out << *t->scan(ScanPredicate())).is_equal(
+                    "(a,x,5,a2)"
+                    "(b,y,5,b1)"
+                    ));
+
+    vector<Cell> cells;
+    BOOST_CHECK_EQUAL(t->get("a", "x", 0, cells), 1u);
+    BOOST_CHECK_EQUAL(t->get("b", "x", 0, cells), 0u);
+    BOOST_CHECK((out << cells).is_equal("(a,x,5,a2)"));
+}
+
+BOOST_AUTO_UNIT_TEST(get_test)
+{
+    TabletFixture fix("memfs:/Tablet_unittest/get");
+    test_out_t out;
+
+    // The newest version of "a" is in the oldest fragment
+    vector<string> uris;
+    uris.push_back(fix.writeFragment(
+                       CellList()
+                       .set("a", "x", 30, "a30")
+                       .set("b", "x", 10, "b10")
+                       .set("c", "x", 10, "c10")
+                       .set("m", "x", 10, "10")));
+    uris.push_back(fix.writeFragment(
+                       CellList()
+                       .set("a", "x", 20, "a20")
+                       .erase("b", "x", 10)
+                       .set("c", "x", 20, "c20")
+                       .merge("m", "x", 20, "add", "5")));
+    uris.push_back(fix.writeFragment(
+                       CellList()
+                       .set("a", "x", 10, "a10")
+                       .set("c", "x", 10, "c10b")));
+    TabletPtr t = fix.makeTablet(uris);
+
+    // Hit: versions from every fragment come back newest first, and
+    // the newest fragment wins a timestamp tie
+    vector<Cell> cells;
+    BOOST_CHECK_EQUAL(t->get("a", "x", 0, cells), 3u);
+    BOOST_CHECK((out << cells).is_equal(
+                    "(a,x,30,a30)"
+                    "(a,x,20,a20)"
+                    "(a,x,10,a10)"
+                    ));
+    cells.clear();
+    BOOST_CHECK_EQUAL(t->get("c", "x", 0, cells), 2u);
+    BOOST_CHECK((out << cells).is_equal(
+                    "(c,x,20,c20)"
+                    "(c,x,10,c10b)"
+                    ));
+
+    // The version limit keeps the newest, even from an older fragment
+    cells.clear();
+    BOOST_CHECK_EQUAL(t->get("a", "x", 1, cells), 1u);
+    BOOST_CHECK((out << cells).is_equal("(a,x,30,a30)"));
+
+    // Misses on the row and on the column
+    cells.clear();
+    BOOST_CHECK_EQUAL(t->get("z", "x", 0, cells), 0u);
+    BOOST_CHECK_EQUAL(t->get("a", "y", 0, cells), 0u);
+    BOOST_CHECK(cells.empty());
+
+    // An erased cell is hidden
+    BOOST_CHECK_EQUAL(t->get("b", "x", 0, cells), 0u);
+    BOOST_CHECK(cells.empty());
+
+    // Merge operands are folded like a scan would
+    BOOST_CHECK_EQUAL(t->get("m", "x", 1, cells), 1u);
+    BOOST_CHECK((out << cells).is_equal("(m,x,20,15)"));
+
+    // Point lookups agree with the scanner
+    BOOST_CHECK((out << *t->scan(ScanPredicate("history = 1"))).is_equal(
+                    "(a,x,30,a30)"
+                    "(c,x,20,c20)"
+                    "(m,x,20,15)"
+                    ));
+}
+
+BOOST_AUTO_UNIT_TEST(scan_cache_retention_test)
+{
+    TabletFixture fix("memfs:/Tablet_unittest/cache_retention");
+    test_out_t out;
+
+    ScanCache & cache = ScanCache::getGlobal();
+    cache.setMaxSize(1 << 20);
+
+    // One cell about to pass a one second age limit, one well inside
+    int64_t now = Timestamp::now();
+    vector<string> uris;
+    uris.push_back(fix.writeFragment(
+                       CellList()
+                       .push(makeCell("a", "x", now - 800000, "old"))
+                       .push(makeCell("b", "x", now + 60000000, "new"))));
+    RetentionPolicy retention;
+    retention.setDefaultLimits(RetentionPolicy::Limits(0, 1));
+    TabletPtr t = fix.makeTablet(uris, retention);
+
+    BOOST_CHECK_EQUAL(countCells(t->scan(ScanPredicate())), 2u);
+
+    // The cached result is reused after the old cell expires, but it
+    // doesn't bring the cell back
+    usleep(400000);
+    ScanCache::Stats before;
+    cache.getStats(before);
+    BOOST_CHECK((out << *t->scan(ScanPredicate())).is_equal(
+                    (format("(b,x,%d,new)") % (now + 60000000)).str()));
+    ScanCache::Stats after;
+    cache.getStats(after);
+    BOOST_CHECK_EQUAL(after.nHits, before.nHits + 1);
+
+    cache.setMaxSize(0);
+}
+
+BOOST_AUTO_UNIT_TEST(scanner_keeps_old_files_test)
+{
+    TabletFixture fix("memfs:/Tablet_unittest/scanner_files");
+    test_out_t out;
+
+    vector<string> uris;
+    uris.push_back(fix.writeFragment(
+                       CellList()
+                       .set("a", "x", 10, "a0")
+                       .set("b", "x", 10, "b0")));
+    uris.push_back(fix.writeFragment(CellList().set("c", "x", 10, "c1")));
+    TabletPtr t = fix.makeTablet(uris);
+
+    // Have the tracker delete the oldest file once it is released
+    vector<FragmentPtr> frags;
+    t->getFragments(frags);
+    string oldFile = frags[0]->getDiskUri();
+    t->getFileTracker()->track(oldFile);
+
+    // Start a scan, then compact the file away under it
+    CellStreamPtr scan = t->scan(ScanPredicate());
+    Cell x;
+    BOOST_CHECK(scan->get(x));
+    fix.compact(t, 0, 2);
+    fix.waitForConfigSaves();
+
+    // The scanner hasn't switched yet, so the file stays
+    BOOST_CHECK(fs::exists(oldFile));
+
+    // Once it has, the file is released
+    BOOST_CHECK((out << *scan).is_equal(
+                    "(b,x,10,b0)"
+                    "(c,x,10,c1)"
+                    ));
+    BOOST_CHECK(!fs::exists(oldFile));
+}
+
+BOOST_AUTO_UNIT_TEST(add_fragment_generation_test)
+{
+    TabletFixture fix("memfs:/Tablet_unittest/add_fragment");
+    TabletPtr t = fix.makeTablet(vector<string>());
+
+    // The first write adds a log fragment, which scanners must see
+    size_t generation = t->getFragmentGeneration();
+    t->set("a", "x", 10, "a0");
+    t->sync();
+    BOOST_CHECK(t->getFragmentGeneration() != generation);
+}
@@ -28,25 +28,45 @@ using namespace kdi::tablet;
 using namespace warp;
 using namespace ex;
 
-WorkQueue::WorkQueue(size_t nThreads) :
-    done(false)
-{
-    if(!nThreads)
-        raise<ValueError>("WorkQueue needs at least 1 thread");
+namespace {
 
-    for(size_t i = 0; i < nThreads; ++i)
+    WorkStealingPool * newPrivatePool(size_t nThreads)
     {
-        threads.create_thread(
-            callOrDie(
-                boost::bind(&WorkQueue::workLoop, this),
-                "Work thread", true
-                )
-            );
+        if(!nThreads)
+            raise<ValueError>("WorkQueue needs at least 1 thread");
+
+        return new WorkStealingPool(nThreads, "Work thread", true);
     }
 
+}
+
+WorkQueue::WorkQueue(size_t nThreads) :
+    ownPool(newPrivatePool(nThreads)),
+    pool(*ownPool),
+    priority(WorkStealingPool::FOREGROUND),
+    maxActive(nThreads),
+    nActive(0),
+    done(false)
+{
     log("WorkQueue %p: created, %d thread(s)", this, nThreads);
 }
 
+WorkQueue::WorkQueue(WorkStealingPool & sharedPool,
+                     WorkStealingPool::Priority priority,
+                     size_t maxActive) :
+    pool(sharedPool),
+    priority(priority),
+    maxActive(maxActive),
+    nActive(0),
+    done(false)
+{
+    if(!maxActive)
+        raise<ValueError>("WorkQueue needs to run at least 1 job at a time");
+
+    log("WorkQueue %p: created on shared pool, %d active job(s)",
+        this, maxActive);
+}
+
 WorkQueue::~WorkQueue()
 {
     if(!done)
@@ -57,44 +77,74 @@ WorkQueue::~WorkQueue()
 
 void WorkQueue::post(job_t const & job)
 {
-    jobs.push(job);
+    lock_t lock(mutex);
+    if(done)
+        return;
+
+    jobs.push_back(job);
+    if(nActive < maxActive)
+    {
+        ++nActive;
+        pool.submit(this, priority);
+    }
 }
 
 void WorkQueue::shutdown()
 {
+    // Pending jobs are dropped.  Declare the holder before taking
+    // the lock so they get destroyed after it is released (see
+    // comment in run()).
+    std::deque<job_t> dropped;
+
+    lock_t lock(mutex);
     if(done)
         raise<RuntimeError>("WorkQueue already shut down");
 
     log("WorkQueue shutdown");
-    jobs.cancelWaits();
-    threads.join_all();
     done = true;
+    dropped.swap(jobs);
+    while(nActive)
+        idleCond.wait(lock);
 }
 
-void WorkQueue::workLoop()
+void WorkQueue::run()
 {
-    for(;;)
+    lock_t lock(mutex);
+    if(!jobs.empty() && !done)
     {
-        // This loop is structured so that a new job instance is used
-        // each time.  It turns out that reusing the same job each
-        // time can cause deadlock: WorkQueue pops jobs from a
-        // SyncQueue.  The pop method assigns the popped element to
-        // the passed in reference while holding a the queue lock.
-        // The assignment calls the destructor of previously assigned
-        // bound functor.  The bound functor holds a shared pointer to
-        // a Tablet.  The tablet has been released by everything else,
-        // and this triggers the tablet's destructor.  The destructor
-        // tries to get the dagMutex so it can remove the Tablet from
-        // the FragDag.  Unfortunately, it has to wait because the
-        // FragDag is currently replacing fragments in another Tablet.
-        // That tablet has replaced the fragments and needs to queue
-        // up a config change.  To do that, it tries to push a job
-        // into the WorkQueue, which is currently blocked in the pop
-        // method.  Ouch.
-
+        // The job is swapped out of the queue and destroyed outside
+        // of the queue lock.  It turns out that destroying a job
+        // while holding the lock can cause deadlock: the job is a
+        // bound functor holding a shared pointer to a Tablet.  The
+        // tablet has been released by everything else, and this
+        // triggers the tablet's destructor.  The destructor tries to
+        // get the dagMutex so it can remove the Tablet from the
+        // FragDag.  Unfortunately, it has to wait because the
+        // FragDag is currently replacing fragments in another
+        // Tablet.  That tablet has replaced the fragments and needs
+        // to queue up a config change.  To do that, it tries to post
+        // a job to the WorkQueue, which needs the lock we're holding.
+        // Ouch.
         job_t job;
-        if(!jobs.pop(job))
-            break;
+        job.swap(jobs.front());
+        jobs.pop_front();
+        lock.unlock();
+
         job();
+        job.clear();
+
+        lock.lock();
+    }
+
+    // Keep our slot if there's more work, otherwise give it up.  One
+    // job per pool task keeps a long backlog from hogging a worker.
+    if(!jobs.empty() && !done)
+    {
+        pool.submit(this, priority);
+    }
+    else
+    {
+        --nActive;
+        idleCond.notify_all();
     }
 }
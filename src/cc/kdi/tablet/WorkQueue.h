@@ -21,10 +21,13 @@
 #ifndef KDI_TABLET_WORKQUEUE_H
 #define KDI_TABLET_WORKQUEUE_H
 
-#include <warp/syncqueue.h>
+#include <warp/WorkStealingPool.h>
+#include <warp/Runnable.h>
 #include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/thread.hpp>
 #include <boost/function.hpp>
+#include <deque>
 
 namespace kdi {
 namespace tablet {
@@ -37,24 +40,47 @@ namespace tablet {
 //----------------------------------------------------------------------------
 // WorkQueue
 //----------------------------------------------------------------------------
+/// Runs posted jobs in FIFO order on a WorkStealingPool, with at
+/// most a fixed number of jobs running at once.  With a concurrency
+/// of 1, jobs are fully serialized.
 class kdi::tablet::WorkQueue
-    : private boost::noncopyable
+    : private boost::noncopyable,
+      private warp::Runnable
 {
     typedef boost::function<void ()> job_t;
+    typedef boost::mutex::scoped_lock lock_t;
 
-    warp::SyncQueue<job_t> jobs;
-    boost::thread_group threads;
+    boost::scoped_ptr<warp::WorkStealingPool> ownPool;
+    warp::WorkStealingPool & pool;
+    warp::WorkStealingPool::Priority const priority;
+    size_t const maxActive;
+
+    boost::mutex mutex;
+    boost::condition idleCond;
+    std::deque<job_t> jobs;
+    size_t nActive;
     bool done;
 
 public:
+    /// Create a WorkQueue with its own pool of \c nThreads threads.
+    /// Up to \c nThreads jobs may run at once.
     explicit WorkQueue(size_t nThreads);
+
+    /// Create a WorkQueue running jobs on a shared pool.  Up to \c
+    /// maxActive jobs may run at once.  The shared pool must outlive
+    /// this object.
+    WorkQueue(warp::WorkStealingPool & sharedPool,
+              warp::WorkStealingPool::Priority priority,
+              size_t maxActive);
+
     ~WorkQueue();
 
     void post(job_t const & job);
     void shutdown();
 
 private:
-    void workLoop();
+    /// Run the next job from the queue.  Called from the pool.
+    void run();
 };
 
 #endif // KDI_TABLET_WORKQUEUE_H
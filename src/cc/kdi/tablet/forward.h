@@ -43,6 +43,7 @@ namespace tablet {
     class FileTracker;
     class LogWriter;
     class TabletConfig;
+    class AdmissionController;
 
     class FragmentLoader;
     class FragmentWriter;
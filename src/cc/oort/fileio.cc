@@ -160,7 +160,12 @@ bool FileInput::get(Record & r)
             lzo_uint compressedSize = f.length - sizeof(uint32_t);
             lzo_uint uncompressedSize = deserialize<uint32_t>(dataPtr);
 
+            // Only keep the compression flag if the writer's record
+            // asked for it
             f.length = uncompressedSize;
+            if(f.flags & HeaderSpec::LZO_UNREQUESTED)
+                f.flags &= ~uint32_t(HeaderSpec::LZO_COMPRESSED |
+                                     HeaderSpec::LZO_UNREQUESTED);
             char * recordPtr = alloc->alloc(r, f);
 
             // Make sure LZO is ready
@@ -218,7 +223,7 @@ FileInput::handle_t FileInput::make(file_t const & fp, size_t allocSz)
 // FileOutput
 //----------------------------------------------------------------------------
 FileOutput::FileOutput(file_t const & file, HeaderSpec const * spec) :
-    file(file), spec(spec), hdrBuf(0)
+    file(file), spec(spec), hdrBuf(0), compressAll(false)
 {
     allocHeaderBuf(hdrBuf, spec);
 }
@@ -229,7 +234,7 @@ FileOutput::~FileOutput()
 }
 
 FileOutput::FileOutput(FileOutput const & o) :
-    file(file), spec(spec), hdrBuf(0)
+    file(o.file), spec(o.spec), hdrBuf(0), compressAll(o.compressAll)
 {
     allocHeaderBuf(hdrBuf, spec);
 }
@@ -238,6 +243,7 @@ FileOutput const & FileOutput::operator=(FileOutput const & o)
 {
     file = o.file;
     spec = o.spec;
+    compressAll = o.compressAll;
     allocHeaderBuf(hdrBuf, spec);
     return *this;
 }
@@ -269,7 +275,8 @@ void FileOutput::put(Record const & r)
     void const * outputData = r.getData();
 
     // Did the record header request compression?
-    if(f.flags & HeaderSpec::LZO_COMPRESSED) {
+    bool requested = f.flags & HeaderSpec::LZO_COMPRESSED;
+    if(requested || compressAll) {
         // Make sure LZO is ready to roll
         initLzo();
 
@@ -310,11 +317,15 @@ void FileOutput::put(Record const & r)
             // Write the originalSize in the payload
             serialize(&lzoBuffer[0], uint32_t(f.length));
 
-            // Rewrite the header
+            // Rewrite the header.  Mark records we compressed on our
+            // own so readers don't hand them back with the flag set.
             f.length = compressedSize + sizeof(uint32_t);
+            f.flags |= HeaderSpec::LZO_COMPRESSED;
+            if(!requested)
+                f.flags |= HeaderSpec::LZO_UNREQUESTED;
         } else {
             // Compression isn't worth it, clear compression flag
-            f.flags ^= HeaderSpec::LZO_COMPRESSED;
+            f.flags &= ~uint32_t(HeaderSpec::LZO_COMPRESSED);
         }
     }
 
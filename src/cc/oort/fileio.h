@@ -110,6 +110,7 @@ private:
 
     std::vector<uint8_t> lzoBuffer;
     boost::scoped_array<uint8_t> lzoWork;
+    bool compressAll;
 
 public:
     explicit FileOutput(file_t const & file = file_t(),
@@ -122,6 +123,11 @@ public:
     void setFile(file_t const & file);
     void setHeaderSpec(HeaderSpec const * spec);
 
+    /// Try LZO compression on every record, not just the ones with
+    /// the LZO_COMPRESSED flag.  Records are read back with the same
+    /// flags they were written with.
+    void setCompressAll(bool compress) { compressAll = compress; }
+
     void flush();
     void put(Record const & r);
 
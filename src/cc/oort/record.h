@@ -243,7 +243,12 @@ public:
     };
 
     enum Flags {
-        LZO_COMPRESSED = 1
+        LZO_COMPRESSED = 1,
+
+        // Only used in file headers: the record was compressed
+        // because the writer compresses everything, not because it
+        // had LZO_COMPRESSED set.  Readers clear both flags.
+        LZO_UNREQUESTED = 2
     };
 
 public:
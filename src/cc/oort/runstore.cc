@@ -0,0 +1,122 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <oort/runstore.h>
+#include <oort/fileio.h>
+#include <oort/headers.h>
+#include <warp/file.h>
+#include <warp/fs.h>
+#include <ex/exception.h>
+#include <boost/format.hpp>
+#include <unistd.h>
+
+using namespace oort;
+using namespace warp;
+using namespace ex;
+using boost::format;
+
+namespace
+{
+    /// Make run names unique among the stores in this process.
+    size_t nextStoreId()
+    {
+        static boost::mutex mutex;
+        static size_t storeId = 0;
+
+        boost::mutex::scoped_lock lock(mutex);
+        return storeId++;
+    }
+}
+
+
+//----------------------------------------------------------------------------
+// RecordRunStore
+//----------------------------------------------------------------------------
+RecordRunStore::RecordRunStore(std::string const & dir, size_t allocSize,
+                               bool compress) :
+    dir(dir),
+    prefix((format("sort-%d-%d-") % getpid() % nextStoreId()).str()),
+    allocSize(allocSize),
+    compress(compress),
+    nextRunId(0)
+{
+    fs::makedirs(dir);
+}
+
+RecordRunStore::~RecordRunStore()
+{
+    for(std::set<size_t>::const_iterator i = runs.begin();
+        i != runs.end(); ++i)
+    {
+        try {
+            fs::remove(getRunUri(*i));
+        }
+        catch(...) {
+            // No exceptions!
+        }
+    }
+}
+
+std::string RecordRunStore::getRunUri(size_t runId) const
+{
+    return fs::resolve(dir, (format("%s%06d.rec") % prefix % runId).str());
+}
+
+RecordRunStore::stream_handle_t RecordRunStore::createRun(size_t & runId)
+{
+    {
+        lock_t lock(mutex);
+        runId = nextRunId++;
+        runs.insert(runId);
+    }
+
+    FileOutput::handle_t out = FileOutput::make(
+        File::output(getRunUri(runId)));
+    out->setCompressAll(compress);
+    return out;
+}
+
+RecordRunStore::stream_handle_t RecordRunStore::openRun(size_t runId)
+{
+    {
+        lock_t lock(mutex);
+        if(runs.find(runId) == runs.end())
+            raise<ValueError>("unknown sort run: %d", runId);
+    }
+
+    return FileInput::make(File::input(getRunUri(runId)), allocSize);
+}
+
+void RecordRunStore::removeRun(size_t runId)
+{
+    {
+        lock_t lock(mutex);
+        if(!runs.erase(runId))
+            return;
+    }
+
+    fs::remove(getRunUri(runId));
+}
+
+size_t RecordRunStore::getRunCount() const
+{
+    lock_t lock(mutex);
+    return nextRunId;
+}
@@ -0,0 +1,80 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#ifndef OORT_RUNSTORE_H
+#define OORT_RUNSTORE_H
+
+#include <oort/record.h>
+#include <flux/asyncsort.h>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <string>
+#include <set>
+
+namespace oort
+{
+    class RecordRunStore;
+}
+
+
+//----------------------------------------------------------------------------
+// RecordRunStore
+//----------------------------------------------------------------------------
+/// Spill storage for AsyncSort of Records.  Each run is a record
+/// file in a scratch directory, written through FileOutput with LZO
+/// compression on every record.  Runs left in the store are removed
+/// when it is destroyed.
+class oort::RecordRunStore
+    : public flux::RunStore<Record>,
+      private boost::noncopyable
+{
+    typedef boost::mutex::scoped_lock lock_t;
+
+    std::string dir;
+    std::string prefix;
+    size_t allocSize;
+    bool compress;
+
+    mutable boost::mutex mutex;
+    std::set<size_t> runs;
+    size_t nextRunId;
+
+    std::string getRunUri(size_t runId) const;
+
+public:
+    /// Create a store writing runs to the given directory, which is
+    /// created if necessary.  Records read back from runs are
+    /// allocated in buffers of \c allocSize bytes.
+    explicit RecordRunStore(std::string const & dir,
+                            size_t allocSize = 1 << 20,
+                            bool compress = true);
+    ~RecordRunStore();
+
+    virtual stream_handle_t createRun(size_t & runId);
+    virtual stream_handle_t openRun(size_t runId);
+    virtual void removeRun(size_t runId);
+
+    /// Get the number of runs created so far, including intermediate
+    /// merge runs.
+    size_t getRunCount() const;
+};
+
+
+#endif // OORT_RUNSTORE_H
@@ -0,0 +1,231 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <oort/runstore.h>
+#include <oort/recordbuffer.h>
+#include <flux/asyncsort.h>
+#include <warp/options.h>
+#include <warp/timer.h>
+#include <warp/util.h>
+#include <ex/exception.h>
+#include <boost/format.hpp>
+#include <iostream>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+using namespace oort;
+using namespace warp;
+using namespace std;
+using namespace ex;
+using boost::format;
+
+namespace {
+
+    uint32_t const SORT_RECORD_TYPE = OORT_TYPE('S','r','t','B');
+
+    size_t const MB = 1 << 20;
+
+    /// Order records on the 64-bit key at the start of the data.
+    struct RecordKeyLt
+    {
+        bool operator()(Record const & a, Record const & b) const
+        {
+            return deserialize<uint64_t>(a.getData()) <
+                deserialize<uint64_t>(b.getData());
+        }
+    };
+
+    /// Deterministic key sequence, so runs are repeatable.
+    class KeyGenerator
+    {
+        uint64_t x;
+
+    public:
+        explicit KeyGenerator(uint64_t seed) : x(seed | 1) {}
+
+        uint64_t next()
+        {
+            // xorshift64
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            return x;
+        }
+    };
+
+    /// Count output records and check their order and headers.
+    class CheckOutput : public flux::Stream<Record>
+    {
+        uint64_t lastKey;
+
+    public:
+        size_t nRecords;
+        size_t nBytes;
+
+        CheckOutput() : lastKey(0), nRecords(0), nBytes(0) {}
+
+        void put(Record const & r)
+        {
+            if(r.getType() != SORT_RECORD_TYPE || r.getFlags() != 0)
+                raise<RuntimeError>("output header changed at record %d",
+                                    nRecords);
+
+            uint64_t key = deserialize<uint64_t>(r.getData());
+            if(key < lastKey)
+                raise<RuntimeError>("output out of order at record %d",
+                                    nRecords);
+            lastKey = key;
+            ++nRecords;
+            nBytes += r.getLength();
+        }
+    };
+
+    size_t getPeakRss()
+    {
+        rusage ru;
+        if(getrusage(RUSAGE_SELF, &ru))
+            return 0;
+        return size_t(ru.ru_maxrss) << 10;
+    }
+}
+
+int main(int ac, char ** av)
+{
+    OptionParser op("%prog [options]");
+    {
+        using namespace boost::program_options;
+        op.addOption("size,s", value<size_t>()->default_value(256),
+                     "Size of generated data set in MB");
+        op.addOption("record,r", value<size_t>()->default_value(100),
+                     "Record size in bytes");
+        op.addOption("memory,m", value<size_t>()->default_value(64),
+                     "Sort buffer memory in MB");
+        op.addOption("workers,w", value<size_t>()->default_value(2),
+                     "Number of sort worker threads");
+        op.addOption("dir,d", value<string>()->default_value("/tmp"),
+                     "Scratch directory for spilled runs");
+        op.addOption("fanin,f", value<size_t>()->default_value(64),
+                     "Maximum merge fan-in");
+        op.addOption("readahead,a", value<size_t>()->default_value(1024),
+                     "Merge read-ahead per run in KB");
+        op.addOption("seed", value<uint64_t>()->default_value(1),
+                     "Random seed for generated keys");
+        op.addOption("nospill,n", "Sort in memory without spilling");
+    }
+
+    OptionMap opt;
+    ArgumentList args;
+    op.parseOrBail(ac, av, opt, args);
+
+    size_t dataSize;
+    size_t recordSize;
+    size_t memory;
+    size_t nWorkers;
+    string dir;
+    size_t fanIn;
+    size_t readAhead;
+    uint64_t seed;
+    opt.get("size", dataSize);
+    opt.get("record", recordSize);
+    opt.get("memory", memory);
+    opt.get("workers", nWorkers);
+    opt.get("dir", dir);
+    opt.get("fanin", fanIn);
+    opt.get("readahead", readAhead);
+    opt.get("seed", seed);
+    bool spill = !hasopt(opt, "nospill");
+
+    if(recordSize < sizeof(uint64_t))
+        op.error("record size must hold an 8-byte key");
+    if(!nWorkers)
+        op.error("need at least one worker");
+
+    dataSize *= MB;
+    memory *= MB;
+
+    // Leave a buffer for input while the workers sort
+    flux::AsyncSortParams params;
+    params.nSortWorkers = nWorkers;
+    params.maxBuffers = nWorkers + 1;
+    params.dispatchThreshold = std::max(memory / params.maxBuffers, MB);
+    params.maxMergeFanIn = fanIn;
+    params.readAheadSize = readAhead << 10;
+
+    typedef flux::AsyncSort<Record, RecordKeyLt, record_size> sort_t;
+    boost::shared_ptr<CheckOutput> output(new CheckOutput);
+    boost::shared_ptr<RecordRunStore> store;
+
+    size_t nRecords = 0;
+    size_t nBytes = 0;
+    WallTimer timer;
+    {
+        sort_t::handle_t sorter = flux::makeAsyncSort<Record>(
+            params, RecordKeyLt(), record_size());
+        if(spill)
+        {
+            store.reset(new RecordRunStore(dir));
+            sorter->setRunStore(store);
+        }
+        sorter->pipeTo(output);
+
+        // Compressible payload, like typical text fields
+        string filler;
+        while(filler.size() < recordSize)
+            filler += "the quick brown fox jumps over the lazy dog ";
+
+        RecordBufferAllocator alloc(MB);
+        KeyGenerator keys(seed);
+        HeaderSpec::Fields f;
+        f.length = recordSize;
+        f.type = SORT_RECORD_TYPE;
+        f.version = 0;
+        f.flags = 0;
+        while(nBytes < dataSize)
+        {
+            Record r;
+            char * p = alloc.alloc(r, f);
+            serialize(p, keys.next());
+            memcpy(p + sizeof(uint64_t), filler.c_str(),
+                   recordSize - sizeof(uint64_t));
+            sorter->put(r);
+
+            ++nRecords;
+            nBytes += recordSize;
+        }
+        sorter->flush();
+    }
+    double elapsed = timer.getElapsed();
+
+    if(output->nRecords != nRecords || output->nBytes != nBytes)
+        raise<RuntimeError>("sorted %d records (%d bytes), expected %d "
+                            "(%d bytes)", output->nRecords,
+                            output->nBytes, nRecords, nBytes);
+
+    cout << format("records    %d\n") % nRecords
+         << format("data       %.1f MB\n") % (nBytes / double(MB))
+         << format("memory     %.1f MB\n") % (memory / double(MB))
+         << format("runs       %d\n") % (store ? store->getRunCount() : 0)
+         << format("elapsed    %.2f s\n") % elapsed
+         << format("throughput %.1f MB/s\n") % (nBytes / double(MB) / elapsed)
+         << format("peak rss   %.1f MB\n") % (getPeakRss() / double(MB));
+
+    return 0;
+}
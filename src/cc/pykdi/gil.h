@@ -0,0 +1,49 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+// 
+// This file is part of KDI.
+// 
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+// 
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+// 
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#ifndef PYKDI_GIL_H
+#define PYKDI_GIL_H
+
+#include <boost/python.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace pykdi {
+
+    class ReleaseGil;
+
+} // namespace pykdi
+
+//----------------------------------------------------------------------------
+// ReleaseGil
+//----------------------------------------------------------------------------
+/// Release the Python interpreter lock for the lifetime of the
+/// object, so other Python threads can run while we block in KDI.  No
+/// Python objects may be touched while the lock is released.
+class pykdi::ReleaseGil
+    : private boost::noncopyable
+{
+    PyThreadState * state;
+
+public:
+    ReleaseGil() : state(PyEval_SaveThread()) {}
+    ~ReleaseGil() { PyEval_RestoreThread(state); }
+};
+
+#endif // PYKDI_GIL_H
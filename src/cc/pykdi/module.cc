@@ -20,6 +20,7 @@
 
 #include <pykdi/pytable.h>
 #include <pykdi/pyscan.h>
+#include <pykdi/pybatch.h>
 #include <pykdi/conversion.h>
 #include <boost/python.hpp>
 
@@ -120,6 +121,8 @@ BOOST_PYTHON_MODULE(pykdi)
 
     PyTable::defineWrapper();
     PyScan::defineWrapper();
+    PyBatchScan::defineWrapper();
+    PyCellBatch::defineWrapper();
 
     enum_<warp::BoundType>("Bound")
         .value("INFINITE",  warp::BT_INFINITE)
@@ -0,0 +1,344 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <pykdi/pybatch.h>
+#include <pykdi/gil.h>
+#include <vector>
+#include <algorithm>
+#include <string.h>
+
+using namespace pykdi;
+using namespace kdi;
+using namespace warp;
+using namespace std;
+using namespace boost::python;
+using boost::python::objects::stop_iteration_error;
+
+namespace {
+
+    typedef PyCellBatch::offset_t offset_t;
+
+    size_t const DEFAULT_BATCH_CELLS = 1024;
+    size_t const DEFAULT_BATCH_BYTES = 4 << 20;
+
+    // Keep string data well inside the range of offset_t
+    size_t const MAX_BATCH_BYTES = 1 << 30;
+
+    void raiseValueError(char const * msg)
+    {
+        PyErr_SetString(PyExc_ValueError, msg);
+        throw_error_already_set();
+    }
+
+    /// Make an uninitialized Python string of the given length and
+    /// get a pointer to its data.  The data may be filled in without
+    /// the interpreter lock until the string is shared.
+    object allocString(size_t len, char * & data)
+    {
+        PyObject * p = PyString_FromStringAndSize(0, len);
+        if(!p)
+            throw_error_already_set();
+        data = PyString_AS_STRING(p);
+        return object(handle<>(p));
+    }
+
+    template <class T>
+    T loadAt(char const * p, size_t idx)
+    {
+        // Buffers may not be aligned
+        T x;
+        memcpy(&x, p + idx * sizeof(T), sizeof(T));
+        return x;
+    }
+
+    template <class T>
+    void storeAt(char * p, size_t idx, T x)
+    {
+        memcpy(p + idx * sizeof(T), &x, sizeof(T));
+    }
+
+    /// Copy one string field of the cells into the data buffer and
+    /// fill in the offsets.
+    void copyField(vector<Cell> const & cells,
+                   StringRange (Cell::*getField)() const,
+                   char * data, char * offsets)
+    {
+        offset_t off = 0;
+        for(size_t i = 0; i < cells.size(); ++i)
+        {
+            storeAt(offsets, i, off);
+            StringRange s = (cells[i].*getField)();
+            memcpy(data + off, s.begin(), s.size());
+            off += s.size();
+        }
+        storeAt(offsets, cells.size(), off);
+    }
+
+    struct Buffer
+    {
+        char const * data;
+        size_t size;
+
+        explicit Buffer(object const & obj)
+        {
+            void const * p;
+            Py_ssize_t len;
+            if(PyObject_AsReadBuffer(obj.ptr(), &p, &len))
+                throw_error_already_set();
+            data = static_cast<char const *>(p);
+            size = len;
+        }
+
+        StringRange getString(Buffer const & offsets, size_t idx) const
+        {
+            return StringRange(data + loadAt<offset_t>(offsets.data, idx),
+                               data + loadAt<offset_t>(offsets.data, idx+1));
+        }
+    };
+
+    /// Check an offset buffer against its data buffer and return the
+    /// number of strings it describes.
+    size_t checkOffsets(Buffer const & offsets, Buffer const & data)
+    {
+        if(!offsets.size || offsets.size % sizeof(offset_t))
+            raiseValueError("offset buffer must hold N+1 uint32 values");
+
+        size_t n = offsets.size / sizeof(offset_t) - 1;
+        offset_t last = loadAt<offset_t>(offsets.data, 0);
+        for(size_t i = 1; i <= n; ++i)
+        {
+            offset_t off = loadAt<offset_t>(offsets.data, i);
+            if(off < last)
+                raiseValueError("offsets must be non-decreasing");
+            last = off;
+        }
+        if(last > data.size)
+            raiseValueError("offset past end of data buffer");
+        return n;
+    }
+}
+
+//----------------------------------------------------------------------------
+// PyCellBatch
+//----------------------------------------------------------------------------
+PyCellBatch::PyCellBatch() :
+    nCells(0)
+{
+}
+
+PyCellBatch PyCellBatch::read(CellStream & scan, size_t maxCells,
+                              size_t maxBytes)
+{
+    // Read cells.  Cells share their backing data, so this doesn't
+    // copy strings.
+    vector<Cell> cells;
+    size_t rowBytes = 0;
+    size_t columnBytes = 0;
+    size_t valueBytes = 0;
+
+    // Keep the interpreter lock while reading.  It is the only thing
+    // keeping other Python threads out of the scan and its table.
+    cells.reserve(maxCells);
+    Cell x;
+    while(cells.size() < maxCells &&
+          rowBytes + columnBytes + valueBytes < maxBytes &&
+          scan.get(x))
+    {
+        rowBytes += x.getRow().size();
+        columnBytes += x.getColumn().size();
+        valueBytes += x.getValue().size();
+        cells.push_back(x);
+    }
+
+    // Allocate the output buffers
+    size_t n = cells.size();
+    size_t offsetBytes = (n + 1) * sizeof(offset_t);
+
+    PyCellBatch batch;
+    char * rowData;
+    char * rowOffsetData;
+    char * columnData;
+    char * columnOffsetData;
+    char * timestampData;
+    char * valueData;
+    char * valueOffsetData;
+
+    batch.nCells = n;
+    batch.rows = allocString(rowBytes, rowData);
+    batch.rowOffsets = allocString(offsetBytes, rowOffsetData);
+    batch.columns = allocString(columnBytes, columnData);
+    batch.columnOffsets = allocString(offsetBytes, columnOffsetData);
+    batch.timestamps = allocString(n * sizeof(int64_t), timestampData);
+    batch.values = allocString(valueBytes, valueData);
+    batch.valueOffsets = allocString(offsetBytes, valueOffsetData);
+
+    // Fill them in.  This only touches the cells we hold and the new
+    // strings, neither of which is visible to other threads yet.
+    {
+        ReleaseGil nogil;
+
+        copyField(cells, &Cell::getRow, rowData, rowOffsetData);
+        copyField(cells, &Cell::getColumn, columnData, columnOffsetData);
+        copyField(cells, &Cell::getValue, valueData, valueOffsetData);
+        for(size_t i = 0; i < n; ++i)
+            storeAt(timestampData, i, cells[i].getTimestamp());
+    }
+
+    return batch;
+}
+
+void PyCellBatch::insert(Table & table,
+                         object const & rows,
+                         object const & rowOffsets,
+                         object const & columns,
+                         object const & columnOffsets,
+                         object const & timestamps,
+                         object const & values,
+                         object const & valueOffsets)
+{
+    Buffer rowBuf(rows);
+    Buffer rowOffsetBuf(rowOffsets);
+    Buffer columnBuf(columns);
+    Buffer columnOffsetBuf(columnOffsets);
+    Buffer timestampBuf(timestamps);
+    Buffer valueBuf(values);
+    Buffer valueOffsetBuf(valueOffsets);
+
+    size_t n = checkOffsets(rowOffsetBuf, rowBuf);
+    if(checkOffsets(columnOffsetBuf, columnBuf) != n ||
+       checkOffsets(valueOffsetBuf, valueBuf) != n ||
+       timestampBuf.size != n * sizeof(int64_t))
+    {
+        raiseValueError("batch buffers have different cell counts");
+    }
+
+    // Hold the interpreter lock while inserting.  Tables aren't
+    // thread-safe, and a bytearray or array buffer could be resized
+    // by another thread if the lock were released.
+    for(size_t i = 0; i < n; ++i)
+    {
+        table.set(rowBuf.getString(rowOffsetBuf, i),
+                  columnBuf.getString(columnOffsetBuf, i),
+                  loadAt<int64_t>(timestampBuf.data, i),
+                  valueBuf.getString(valueOffsetBuf, i));
+    }
+}
+
+void PyCellBatch::insertInto(Table & table) const
+{
+    insert(table, rows, rowOffsets, columns, columnOffsets,
+           timestamps, values, valueOffsets);
+}
+
+object PyCellBatch::getItem(long idx) const
+{
+    if(idx < 0)
+        idx += nCells;
+    if(idx < 0 || size_t(idx) >= nCells)
+    {
+        PyErr_SetString(PyExc_IndexError, "cell index out of range");
+        throw_error_already_set();
+    }
+
+    Buffer rowBuf(rows);
+    Buffer columnBuf(columns);
+    Buffer valueBuf(values);
+
+    StringRange row = rowBuf.getString(Buffer(rowOffsets), idx);
+    StringRange column = columnBuf.getString(Buffer(columnOffsets), idx);
+    StringRange value = valueBuf.getString(Buffer(valueOffsets), idx);
+
+    return make_tuple(
+        boost::python::str(row.begin(), row.size()),
+        boost::python::str(column.begin(), column.size()),
+        loadAt<int64_t>(Buffer(timestamps).data, idx),
+        boost::python::str(value.begin(), value.size()));
+}
+
+void PyCellBatch::defineWrapper()
+{
+    class_<PyCellBatch>(
+        "CellBatch",
+        "A batch of cells in columnar form.  The 'rows', 'columns',\n"
+        "and 'values' attributes hold the concatenated strings for the\n"
+        "batch.  The matching 'rowOffsets', 'columnOffsets', and\n"
+        "'valueOffsets' hold N+1 native uint32 offsets into the data,\n"
+        "so string i is data[offsets[i]:offsets[i+1]].  The\n"
+        "'timestamps' attribute holds N native int64 values.  All\n"
+        "attributes are strings, usable as raw buffers, e.g.:\n"
+        "    numpy.frombuffer(batch.timestamps, numpy.int64)",
+        no_init)
+        .def("__len__", &PyCellBatch::size)
+        .def("__getitem__", &PyCellBatch::getItem,
+             "Get the (row,column,version,value) cell at an index.")
+        .add_property("rows", &PyCellBatch::getRows)
+        .add_property("rowOffsets", &PyCellBatch::getRowOffsets)
+        .add_property("columns", &PyCellBatch::getColumns)
+        .add_property("columnOffsets", &PyCellBatch::getColumnOffsets)
+        .add_property("timestamps", &PyCellBatch::getTimestamps)
+        .add_property("values", &PyCellBatch::getValues)
+        .add_property("valueOffsets", &PyCellBatch::getValueOffsets)
+        ;
+}
+
+
+//----------------------------------------------------------------------------
+// PyBatchScan
+//----------------------------------------------------------------------------
+PyBatchScan::PyBatchScan(CellStreamPtr const & scan) :
+    scan(scan),
+    maxCells(DEFAULT_BATCH_CELLS),
+    maxBytes(DEFAULT_BATCH_BYTES)
+{
+}
+
+PyCellBatch PyBatchScan::next()
+{
+    PyCellBatch batch = PyCellBatch::read(*scan, maxCells, maxBytes);
+    if(!batch.size())
+        stop_iteration_error();
+    return batch;
+}
+
+void PyBatchScan::setBatchSize(size_t maxCells, size_t maxBytes)
+{
+    if(!maxCells || !maxBytes)
+        raiseValueError("batch size must be positive");
+
+    this->maxCells = maxCells;
+    this->maxBytes = std::min(maxBytes, MAX_BATCH_BYTES);
+}
+
+void PyBatchScan::defineWrapper()
+{
+    class_<PyBatchScan>("BatchScan",
+                        "Iterator over a sequence of Table cells, returned\n"
+                        "in CellBatches.",
+                        no_init)
+        .def("next", &PyBatchScan::next,
+             "Get the next CellBatch in the scan.")
+        .def("__iter__", &PyBatchScan::iter, return_self<>(),
+             "Return self (an iterable object).")
+        .def("setBatchSize", &PyBatchScan::setBatchSize, return_self<>(),
+             "Set the maximum number of cells and the approximate\n"
+             "maximum number of string bytes in each batch.  The\n"
+             "default is 1024 cells or 4 MB.")
+        ;
+}
@@ -0,0 +1,123 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of KDI.
+//
+// KDI is free software; you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation; either version 2 of the License, or any later version.
+//
+// KDI is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#ifndef PYKDI_PYBATCH_H
+#define PYKDI_PYBATCH_H
+
+#include <kdi/table.h>
+#include <boost/python.hpp>
+#include <stdint.h>
+
+namespace pykdi {
+
+    class PyCellBatch;
+    class PyBatchScan;
+
+} // namespace pykdi
+
+
+//----------------------------------------------------------------------------
+// PyCellBatch
+//----------------------------------------------------------------------------
+/// A batch of cells in columnar form.  The rows, columns, and values
+/// are each stored as one data buffer holding the concatenated
+/// strings and an offset buffer of N+1 native uint32 offsets into the
+/// data, so string i is data[offsets[i]:offsets[i+1]].  Timestamps are
+/// a buffer of N native int64 values.  All buffers are Python strings,
+/// which support the buffer protocol (e.g. numpy.frombuffer).
+class pykdi::PyCellBatch
+{
+public:
+    typedef uint32_t offset_t;
+
+private:
+    size_t nCells;
+    boost::python::object rows;
+    boost::python::object rowOffsets;
+    boost::python::object columns;
+    boost::python::object columnOffsets;
+    boost::python::object timestamps;
+    boost::python::object values;
+    boost::python::object valueOffsets;
+
+public:
+    PyCellBatch();
+
+    /// Fill a batch with up to maxCells cells from the scan, stopping
+    /// early once maxBytes of string data have been read.  The scan
+    /// is read with the interpreter lock held, since Tables and
+    /// scans aren't thread-safe.  The lock is only released while
+    /// copying cell data into the new batch strings.  Returns an
+    /// empty batch at the end of the scan.
+    static PyCellBatch read(kdi::CellStream & scan, size_t maxCells,
+                            size_t maxBytes);
+
+    /// Set cells in the table from buffers in the batch layout.  The
+    /// interpreter lock is held while inserting, which serializes
+    /// access to the table and keeps mutable buffers (bytearray,
+    /// array) from being resized under us.
+    static void insert(kdi::Table & table,
+                       boost::python::object const & rows,
+                       boost::python::object const & rowOffsets,
+                       boost::python::object const & columns,
+                       boost::python::object const & columnOffsets,
+                       boost::python::object const & timestamps,
+                       boost::python::object const & values,
+                       boost::python::object const & valueOffsets);
+
+    /// Set all the cells of the batch in the table.
+    void insertInto(kdi::Table & table) const;
+
+    size_t size() const { return nCells; }
+    boost::python::object getItem(long idx) const;
+
+    boost::python::object getRows() const { return rows; }
+    boost::python::object getRowOffsets() const { return rowOffsets; }
+    boost::python::object getColumns() const { return columns; }
+    boost::python::object getColumnOffsets() const { return columnOffsets; }
+    boost::python::object getTimestamps() const { return timestamps; }
+    boost::python::object getValues() const { return values; }
+    boost::python::object getValueOffsets() const { return valueOffsets; }
+
+public:
+    static void defineWrapper();
+};
+
+
+//----------------------------------------------------------------------------
+// PyBatchScan
+//----------------------------------------------------------------------------
+class pykdi::PyBatchScan
+{
+    kdi::CellStreamPtr scan;
+    size_t maxCells;
+    size_t maxBytes;
+
+public:
+    explicit PyBatchScan(kdi::CellStreamPtr const & scan);
+    PyCellBatch next();
+    void iter() {}
+    void setBatchSize(size_t maxCells, size_t maxBytes);
+
+public:
+    static void defineWrapper();
+};
+
+#endif // PYKDI_PYBATCH_H
@@ -20,6 +20,7 @@
 
 #include <pykdi/pytable.h>
 #include <pykdi/pyscan.h>
+#include <pykdi/pybatch.h>
 #include <kdi/scan_predicate.h>
 #include <boost/python.hpp>
 
@@ -49,6 +50,26 @@ void PyTable::erase(string const & row, string const & col,
     table->erase(row, col, rev);
 }
 
+void PyTable::merge(string const & row, string const & col,
+                    int64_t rev, string const & op, string const & operand)
+{
+    table->merge(row, col, rev, op, operand);
+}
+
+void PyTable::insertBatch(PyCellBatch const & batch)
+{
+    batch.insertInto(*table);
+}
+
+void PyTable::insertBatch(object const & rows, object const & rowOffsets,
+                          object const & columns, object const & columnOffsets,
+                          object const & timestamps,
+                          object const & values, object const & valueOffsets)
+{
+    PyCellBatch::insert(*table, rows, rowOffsets, columns, columnOffsets,
+                        timestamps, values, valueOffsets);
+}
+
 void PyTable::sync()
 {
     table->sync();
@@ -69,12 +90,38 @@ PyScan PyTable::scan(std::string const & pred) const
     return PyScan(table->scan(pred));
 }
 
+PyBatchScan PyTable::batchScan() const
+{
+    return PyBatchScan(table->scan());
+}
+
+PyBatchScan PyTable::batchScan(ScanPredicate const & pred) const
+{
+    return PyBatchScan(table->scan(pred));
+}
+
+PyBatchScan PyTable::batchScan(std::string const & pred) const
+{
+    return PyBatchScan(table->scan(pred));
+}
+
 void PyTable::defineWrapper()
 {
     PyScan (PyTable::*scan1)() const                      = &PyTable::scan;
     PyScan (PyTable::*scan2)(ScanPredicate const &) const = &PyTable::scan;
     PyScan (PyTable::*scan3)(std::string const &) const   = &PyTable::scan;
 
+    PyBatchScan (PyTable::*batchScan1)() const = &PyTable::batchScan;
+    PyBatchScan (PyTable::*batchScan2)(ScanPredicate const &) const =
+        &PyTable::batchScan;
+    PyBatchScan (PyTable::*batchScan3)(std::string const &) const =
+        &PyTable::batchScan;
+
+    void (PyTable::*insertBatch1)(PyCellBatch const &) = &PyTable::insertBatch;
+    void (PyTable::*insertBatch2)(
+        object const &, object const &, object const &, object const &,
+        object const &, object const &, object const &) = &PyTable::insertBatch;
+
     class_<PyTable>("Table",
                     "Python interface for a KDI Table.",
                     init<string>())
@@ -82,6 +129,18 @@ void PyTable::defineWrapper()
              "Set a (row,column,version,value) cell in the Table.")
         .def("erase", &PyTable::erase,
              "Erase a cell with given (row,column,version) prefix.")
+        .def("merge", &PyTable::merge,
+             "Combine an operand with a cell using a merge operator:\n"
+             "merge(row, column, version, op, operand).  Operators are\n"
+             "'add', 'max', 'min' (int64 decimal strings), and\n"
+             "'append:N' (bounded list).")
+        .def("insertBatch", insertBatch1,
+             "Set all the cells in a CellBatch.")
+        .def("insertBatch", insertBatch2,
+             "Set cells from buffers in the CellBatch layout:\n"
+             "(rows, rowOffsets, columns, columnOffsets, timestamps,\n"
+             " values, valueOffsets).  Any objects supporting the\n"
+             "buffer protocol may be used.")
         .def("sync", &PyTable::sync,
              "Block until mutations have been committed.")
         .def("scan", scan1,
@@ -90,5 +149,13 @@ void PyTable::defineWrapper()
              "Scan cells in the Table using a ScanPredicate.")
         .def("scan", scan3,
              "Scan cells in the Table using a predicate expression.")
+        .def("batchScan", batchScan1,
+             "Scan all cells in the Table, in CellBatches.")
+        .def("batchScan", batchScan2,
+             "Scan cells in the Table using a ScanPredicate, in\n"
+             "CellBatches.")
+        .def("batchScan", batchScan3,
+             "Scan cells in the Table using a predicate expression, in\n"
+             "CellBatches.")
         ;
 }
@@ -22,14 +22,17 @@
 #define PYKDI_PYTABLE_H
 
 #include <kdi/table.h>
+#include <boost/python.hpp>
 #include <string>
 
 namespace pykdi {
 
     class PyTable;
 
-    // Forward declaration
+    // Forward declarations
     class PyScan;
+    class PyBatchScan;
+    class PyCellBatch;
 
 } // namespace pykdi
 
@@ -49,6 +52,18 @@ public:
              int64_t rev, std::string const & val);
     void erase(std::string const & row, std::string const & col,
                int64_t rev);
+    void merge(std::string const & row, std::string const & col,
+               int64_t rev, std::string const & op,
+               std::string const & operand);
+
+    void insertBatch(PyCellBatch const & batch);
+    void insertBatch(boost::python::object const & rows,
+                     boost::python::object const & rowOffsets,
+                     boost::python::object const & columns,
+                     boost::python::object const & columnOffsets,
+                     boost::python::object const & timestamps,
+                     boost::python::object const & values,
+                     boost::python::object const & valueOffsets);
 
     void sync();
 
@@ -56,6 +71,10 @@ public:
     PyScan scan(kdi::ScanPredicate const & pred) const;
     PyScan scan(std::string const & pred) const;
 
+    PyBatchScan batchScan() const;
+    PyBatchScan batchScan(kdi::ScanPredicate const & pred) const;
+    PyBatchScan batchScan(std::string const & pred) const;
+
 public:
     static void defineWrapper();
 };
@@ -20,6 +20,7 @@
 //----------------------------------------------------------------------------
 
 #include <warp/EnvironmentVariable.h>
+#include <warp/strutil.h>
 #include <ex/exception.h>
 #include <stdlib.h>
 
@@ -42,6 +43,15 @@ bool EnvironmentVariable::get(std::string const & name, std::string & value)
     }
 }
 
+size_t EnvironmentVariable::getSize(std::string const & name,
+                                    size_t defaultValue)
+{
+    std::string value;
+    if(get(name, value))
+        return parseSize(value);
+    return defaultValue;
+}
+
 void EnvironmentVariable::set(std::string const & name, std::string const & value)
 {
     if(0 != setenv(name.c_str(), value.c_str(), 1))
@@ -24,6 +24,7 @@
 
 #include <string>
 #include <iostream>
+#include <stddef.h>
 #include <boost/noncopyable.hpp>
 
 namespace warp {
@@ -87,6 +88,11 @@ public:
     /// and the function returns false.
     static bool get(std::string const & name, std::string & value);
 
+    /// Get the value of an environment variable parsed as a size
+    /// (e.g. "64k" or "512M").  If the environment variable doesn't
+    /// exist, return the given default value.
+    static size_t getSize(std::string const & name, size_t defaultValue);
+
     /// Set an environment variable.  Any previous value is overwritten.
     static void set(std::string const & name, std::string const & value);
 
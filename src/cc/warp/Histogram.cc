@@ -0,0 +1,136 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-11
+//
+// This file is part of the warp library.
+//
+// The warp library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or any later
+// version.
+//
+// The warp library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <warp/Histogram.h>
+#include <limits>
+#include <string.h>
+
+using namespace warp;
+
+namespace {
+
+    /// Index of the most significant set bit of a non-zero value.
+    inline int highBit(uint64_t x)
+    {
+        return 63 - __builtin_clzll(x);
+    }
+}
+
+//----------------------------------------------------------------------------
+// Histogram
+//----------------------------------------------------------------------------
+size_t Histogram::getBucket(int64_t value)
+{
+    if(value < N_SUB_BUCKETS)
+        return value > 0 ? size_t(value) : 0;
+
+    // Keep the top SUB_BITS bits below the leading one.  The leading
+    // bit position picks the group and the following bits pick the
+    // bucket within the group.
+    int shift = highBit(value) - SUB_BITS;
+    size_t group = shift + 1;
+    size_t sub = size_t(value >> shift) - N_SUB_BUCKETS;
+    return group * N_SUB_BUCKETS + sub;
+}
+
+int64_t Histogram::getBucketLowerBound(size_t bucket)
+{
+    size_t group = bucket / N_SUB_BUCKETS;
+    int64_t sub = bucket % N_SUB_BUCKETS;
+    if(!group)
+        return sub;
+    return (N_SUB_BUCKETS + sub) << (group - 1);
+}
+
+int64_t Histogram::getBucketUpperBound(size_t bucket)
+{
+    if(bucket + 1 >= N_BUCKETS)
+        return std::numeric_limits<int64_t>::max();
+    return getBucketLowerBound(bucket + 1) - 1;
+}
+
+void Histogram::add(int64_t value)
+{
+    if(value < 0)
+        value = 0;
+
+    ++counts[getBucket(value)];
+    ++count;
+    sum += value;
+    if(value < minValue)
+        minValue = value;
+    if(value > maxValue)
+        maxValue = value;
+}
+
+void Histogram::merge(Histogram const & o)
+{
+    if(!o.count)
+        return;
+
+    for(size_t i = 0; i < N_BUCKETS; ++i)
+        counts[i] += o.counts[i];
+    count += o.count;
+    sum += o.sum;
+    if(o.minValue < minValue)
+        minValue = o.minValue;
+    if(o.maxValue > maxValue)
+        maxValue = o.maxValue;
+}
+
+void Histogram::clear()
+{
+    memset(counts, 0, sizeof(counts));
+    count = 0;
+    sum = 0;
+    minValue = std::numeric_limits<int64_t>::max();
+    maxValue = 0;
+}
+
+int64_t Histogram::getPercentile(double pct) const
+{
+    if(!count)
+        return 0;
+
+    // Find the rank of the sample we want (1-based), then walk the
+    // buckets until we've seen that many samples
+    int64_t rank = int64_t(pct / 100.0 * count + 0.5);
+    if(rank < 1)
+        rank = 1;
+    if(rank > count)
+        rank = count;
+
+    int64_t seen = 0;
+    for(size_t i = 0; i < N_BUCKETS; ++i)
+    {
+        seen += counts[i];
+        if(seen >= rank)
+        {
+            int64_t v = getBucketUpperBound(i);
+            if(v > maxValue)
+                v = maxValue;
+            if(v < minValue)
+                v = minValue;
+            return v;
+        }
+    }
+    return maxValue;
+}
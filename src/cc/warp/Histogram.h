@@ -0,0 +1,109 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-11
+//
+// This file is part of the warp library.
+//
+// The warp library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or any later
+// version.
+//
+// The warp library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#ifndef WARP_HISTOGRAM_H
+#define WARP_HISTOGRAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace warp {
+
+    class Histogram;
+
+} // namespace warp
+
+//----------------------------------------------------------------------------
+// Histogram
+//----------------------------------------------------------------------------
+/// Histogram of non-negative integer samples (usually latencies in
+/// microseconds) with log-linear buckets.  Values below 16 get a
+/// bucket each.  Above that, each power of two is split into 16
+/// equal buckets, so any reported percentile is within about 6% of
+/// the true value.  The histogram has a fixed size and never
+/// allocates, so recording a sample is just a few arithmetic
+/// operations.
+///
+/// A Histogram is not thread-safe.  See HistogramSet for concurrent
+/// recording.
+class warp::Histogram
+{
+public:
+    enum {
+        SUB_BITS = 4,
+        N_SUB_BUCKETS = 1 << SUB_BITS,
+        N_BUCKETS = (64 - SUB_BITS) * N_SUB_BUCKETS
+    };
+
+private:
+    int64_t counts[N_BUCKETS];
+    int64_t count;
+    int64_t sum;
+    int64_t minValue;
+    int64_t maxValue;
+
+public:
+    Histogram() { clear(); }
+
+    /// Record a sample.  Negative values are recorded as zero.
+    void add(int64_t value);
+
+    /// Add all the samples from another histogram to this one.
+    void merge(Histogram const & o);
+
+    /// Remove all samples.
+    void clear();
+
+    /// Number of samples recorded.
+    int64_t getCount() const { return count; }
+
+    /// Sum of all samples recorded.
+    int64_t getSum() const { return sum; }
+
+    /// Smallest sample recorded, or 0 if the histogram is empty.
+    int64_t getMin() const { return count ? minValue : 0; }
+
+    /// Largest sample recorded, or 0 if the histogram is empty.
+    int64_t getMax() const { return maxValue; }
+
+    /// Mean of all samples recorded, or 0 if the histogram is empty.
+    double getMean() const { return count ? double(sum) / count : 0.0; }
+
+    /// Get an estimate of the value at the given percentile (0 to
+    /// 100).  The estimate is the upper bound of the bucket
+    /// containing the percentile, clipped to the range of recorded
+    /// values.  Returns 0 if the histogram is empty.
+    int64_t getPercentile(double pct) const;
+
+    /// Get the number of samples in a bucket.
+    int64_t getBucketCount(size_t bucket) const { return counts[bucket]; }
+
+    /// Get the bucket index for a value.
+    static size_t getBucket(int64_t value);
+
+    /// Get the smallest value that falls in a bucket.
+    static int64_t getBucketLowerBound(size_t bucket);
+
+    /// Get the largest value that falls in a bucket.
+    static int64_t getBucketUpperBound(size_t bucket);
+};
+
+#endif // WARP_HISTOGRAM_H
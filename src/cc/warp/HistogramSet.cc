@@ -0,0 +1,223 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-11
+//
+// This file is part of the warp library.
+//
+// The warp library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or any later
+// version.
+//
+// The warp library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <warp/HistogramSet.h>
+#include <warp/hsieh_hash.h>
+#include <warp/log.h>
+#include <algorithm>
+
+using namespace warp;
+using namespace std;
+
+//----------------------------------------------------------------------------
+// HistogramSet::Shard
+//----------------------------------------------------------------------------
+HistogramSet::Shard::Shard(RegistryPtr const & registry) :
+    nCached(0),
+    registry(registry)
+{
+    for(size_t i = 0; i < MAX_HISTOGRAMS; ++i)
+        slots[i] = 0;
+}
+
+HistogramSet::Shard::~Shard()
+{
+    for(size_t i = 0; i < MAX_HISTOGRAMS; ++i)
+        delete slots[i];
+}
+
+//----------------------------------------------------------------------------
+// HistogramSet::Registry
+//----------------------------------------------------------------------------
+HistogramSet::Registry::Registry() :
+    closed(false)
+{
+    for(size_t i = 0; i < MAX_HISTOGRAMS; ++i)
+        retired[i] = 0;
+}
+
+HistogramSet::Registry::~Registry()
+{
+    for(size_t i = 0; i < MAX_HISTOGRAMS; ++i)
+        delete retired[i];
+}
+
+//----------------------------------------------------------------------------
+// HistogramSet
+//----------------------------------------------------------------------------
+HistogramSet::HistogramSet() :
+    registry(new Registry),
+    threadShard(&HistogramSet::retireShard),
+    overflowed(false)
+{
+}
+
+HistogramSet::~HistogramSet()
+{
+    // Threads that are still running free their own shards when they
+    // exit.  The calling thread's shard goes with threadShard.
+    lock_t lock(registry->mutex);
+    registry->closed = true;
+}
+
+void HistogramSet::retireShard(Shard * shard)
+{
+    RegistryPtr registry = shard->registry;
+    {
+        lock_t lock(registry->mutex);
+        vector<Shard *> & shards = registry->shards;
+        shards.erase(std::find(shards.begin(), shards.end(), shard));
+
+        // Nobody can read the samples once the set is gone
+        if(!registry->closed)
+        {
+            for(size_t i = 0; i < MAX_HISTOGRAMS; ++i)
+            {
+                Histogram * h = shard->slots[i];
+                if(!h || !h->getCount())
+                    continue;
+
+                Histogram *& r = registry->retired[i];
+                if(!r)
+                    r = new Histogram;
+                r->merge(*h);
+            }
+        }
+    }
+    delete shard;
+}
+
+HistogramSet::Shard * HistogramSet::getShard()
+{
+    // A shard from another registry was left by an earlier set at
+    // the same address.  reset() retires it.
+    Shard * shard = threadShard.get();
+    if(!shard || shard->registry != registry)
+    {
+        shard = new Shard(registry);
+        {
+            lock_t lock(registry->mutex);
+            registry->shards.push_back(shard);
+        }
+        threadShard.reset(shard);
+    }
+    return shard;
+}
+
+size_t HistogramSet::lookupSlot(Shard * shard, strref_t name)
+{
+    // Probe the thread's cache without copying the name
+    uint32_t h = hsieh_hash(name.begin(), name.size());
+    size_t i = h % N_CACHE_ENTRIES;
+    for(; shard->cache[i].used; i = (i + 1) % N_CACHE_ENTRIES)
+    {
+        CacheEntry const & e = shard->cache[i];
+        if(e.hash == h && name == e.name)
+            return e.slot;
+    }
+
+    // First time this thread has seen the name
+    size_t slot = lookupGlobalSlot(name);
+
+    // Remember the slot, or that the name has no slot.  Keep one
+    // entry free so probes always stop.  A thread that sees too many
+    // names takes the lock for the rest.
+    if(shard->nCached < N_CACHE_ENTRIES - 1)
+    {
+        CacheEntry & e = shard->cache[i];
+        e.hash = h;
+        e.slot = slot;
+        e.name.assign(name.begin(), name.end());
+        e.used = true;
+        ++shard->nCached;
+    }
+    return slot;
+}
+
+size_t HistogramSet::lookupGlobalSlot(strref_t name)
+{
+    string key(name.begin(), name.end());
+
+    lock_t lock(registry->mutex);
+    index_map::const_iterator g = globalIndex.find(key);
+    if(g != globalIndex.end())
+        return g->second;
+
+    if(names.size() < MAX_HISTOGRAMS)
+    {
+        size_t slot = names.size();
+        names.push_back(key);
+        globalIndex[key] = slot;
+        return slot;
+    }
+
+    if(!overflowed)
+    {
+        log("HistogramSet: too many histograms, dropping %s", key);
+        overflowed = true;
+    }
+    return MAX_HISTOGRAMS;
+}
+
+void HistogramSet::record(strref_t name, int64_t value)
+{
+    Shard * shard = getShard();
+
+    size_t slot = lookupSlot(shard, name);
+    if(slot >= MAX_HISTOGRAMS)
+        return;
+
+    Histogram * h = shard->slots[slot];
+    if(!h)
+    {
+        h = new Histogram;
+        __sync_synchronize();
+        shard->slots[slot] = h;
+    }
+    h->add(value);
+}
+
+void HistogramSet::getHistograms(histogram_map & out) const
+{
+    out.clear();
+
+    lock_t lock(registry->mutex);
+    vector<Shard *> const & shards = registry->shards;
+    for(size_t i = 0; i < names.size(); ++i)
+    {
+        if(Histogram const * h = registry->retired[i])
+            out[names[i]].merge(*h);
+
+        for(vector<Shard *>::const_iterator s = shards.begin();
+            s != shards.end(); ++s)
+        {
+            Histogram const * h = (*s)->slots[i];
+            if(h && h->getCount())
+                out[names[i]].merge(*h);
+        }
+    }
+}
+
+size_t HistogramSet::getShardCount() const
+{
+    lock_t lock(registry->mutex);
+    return registry->shards.size();
+}
@@ -0,0 +1,157 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-11
+//
+// This file is part of the warp library.
+//
+// The warp library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or any later
+// version.
+//
+// The warp library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#ifndef WARP_HISTOGRAMSET_H
+#define WARP_HISTOGRAMSET_H
+
+#include <warp/Histogram.h>
+#include <warp/string_range.h>
+#include <boost/thread.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <tr1/unordered_map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+
+namespace warp {
+
+    class HistogramSet;
+
+} // namespace warp
+
+//----------------------------------------------------------------------------
+// HistogramSet
+//----------------------------------------------------------------------------
+/// A set of named histograms that many threads can record into at
+/// once.  Each thread records into its own private shard, so the
+/// recording path takes no locks and makes no copies once a thread
+/// has seen a histogram name.  Readers merge the shards of all
+/// threads.
+///
+/// Shards are updated without synchronization, so a merged snapshot
+/// taken while other threads are recording may be off by the
+/// samples in flight.  That's fine for reporting.
+///
+/// When a thread exits, its samples are merged into a shared retired
+/// shard and its own shard is freed.
+class warp::HistogramSet
+    : private boost::noncopyable
+{
+public:
+    typedef std::map<std::string, Histogram> histogram_map;
+
+    /// Maximum number of distinct histogram names.  Samples for
+    /// names past the limit are dropped.
+    enum { MAX_HISTOGRAMS = 128 };
+
+private:
+    typedef boost::mutex::scoped_lock lock_t;
+    typedef std::tr1::unordered_map<std::string, size_t> index_map;
+
+    /// Size of each thread's name cache.  Names past the histogram
+    /// limit get cached too, so leave room for some of them.
+    enum { N_CACHE_ENTRIES = 4 * MAX_HISTOGRAMS };
+
+    /// Entry in a thread's name cache, an open-addressed hash table
+    /// that can be probed with a string range
+    struct CacheEntry
+    {
+        uint32_t hash;
+        size_t slot;
+        std::string name;
+        bool used;
+
+        CacheEntry() : hash(0), slot(0), used(false) {}
+    };
+
+    struct Registry;
+    typedef boost::shared_ptr<Registry> RegistryPtr;
+
+    struct Shard
+    {
+        /// Name to slot cache, only used by the owning thread
+        CacheEntry cache[N_CACHE_ENTRIES];
+        size_t nCached;
+
+        /// Histogram for each slot.  Only the owning thread writes
+        /// these.  Pointers are published with a memory barrier so
+        /// readers see a fully constructed Histogram.
+        Histogram * volatile slots[MAX_HISTOGRAMS];
+
+        /// Where the shard goes when its thread exits
+        RegistryPtr registry;
+
+        explicit Shard(RegistryPtr const & registry);
+        ~Shard();
+    };
+
+    /// The shards and the merged samples of exited threads.  Shared
+    /// with the shards, since a thread may exit after the
+    /// HistogramSet is gone.
+    struct Registry
+    {
+        boost::mutex mutex;
+        std::vector<Shard *> shards;
+        Histogram * retired[MAX_HISTOGRAMS];
+        bool closed;
+
+        Registry();
+        ~Registry();
+    };
+
+    RegistryPtr registry;
+    index_map globalIndex;
+    std::vector<std::string> names;
+    boost::thread_specific_ptr<Shard> threadShard;
+    bool overflowed;
+
+    Shard * getShard();
+
+    /// Thread exit hook: merge the shard into the retired samples
+    /// and free it.
+    static void retireShard(Shard * shard);
+
+    /// Get the slot for a name, or MAX_HISTOGRAMS if there's no
+    /// room for it.
+    size_t lookupSlot(Shard * shard, strref_t name);
+
+    /// Get or assign the global slot for a name the calling thread
+    /// hasn't cached.
+    size_t lookupGlobalSlot(strref_t name);
+
+public:
+    HistogramSet();
+    ~HistogramSet();
+
+    /// Record a sample in the named histogram.
+    void record(strref_t name, int64_t value);
+
+    /// Get a merged snapshot of all histograms with at least one
+    /// sample.
+    void getHistograms(histogram_map & out) const;
+
+    /// Get the number of threads with a live shard.
+    size_t getShardCount() const;
+};
+
+#endif // WARP_HISTOGRAMSET_H
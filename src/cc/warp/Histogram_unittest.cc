@@ -0,0 +1,220 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-11
+//
+// This file is part of the warp library.
+//
+// The warp library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or any later
+// version.
+//
+// The warp library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <warp/Histogram.h>
+#include <warp/HistogramSet.h>
+#include <warp/OpTrace.h>
+#include <unittest/main.h>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+using namespace warp;
+using namespace std;
+
+namespace
+{
+    void recordLoop(HistogramSet & set, int64_t n)
+    {
+        for(int64_t i = 1; i <= n; ++i)
+        {
+            set.record("a", i);
+            if(i % 2 == 0)
+                set.record("b", i);
+        }
+    }
+
+    class SampleTracker : public NullStatTracker
+    {
+    public:
+        HistogramSet hists;
+        void addSample(strref_t name, int64_t value)
+        {
+            hists.record(name, value);
+        }
+    };
+}
+
+BOOST_AUTO_TEST_CASE(histogram_buckets_test)
+{
+    // Small values get exact buckets
+    for(int64_t v = 0; v < Histogram::N_SUB_BUCKETS; ++v)
+    {
+        BOOST_CHECK_EQUAL(Histogram::getBucket(v), size_t(v));
+        BOOST_CHECK_EQUAL(Histogram::getBucketLowerBound(v), v);
+        BOOST_CHECK_EQUAL(Histogram::getBucketUpperBound(v), v);
+    }
+
+    // Every value falls inside its bucket's bounds, and buckets are
+    // contiguous
+    for(int64_t v = 1; v < (int64_t(1) << 40); v = v * 3 / 2 + 1)
+    {
+        size_t b = Histogram::getBucket(v);
+        BOOST_CHECK(Histogram::getBucketLowerBound(b) <= v);
+        BOOST_CHECK(Histogram::getBucketUpperBound(b) >= v);
+        BOOST_CHECK_EQUAL(Histogram::getBucketLowerBound(b + 1),
+                          Histogram::getBucketUpperBound(b) + 1);
+
+        // Bucket width is within 1/16 of the value
+        int64_t width = Histogram::getBucketUpperBound(b) -
+            Histogram::getBucketLowerBound(b) + 1;
+        BOOST_CHECK(width * Histogram::N_SUB_BUCKETS <=
+                    std::max<int64_t>(v, Histogram::N_SUB_BUCKETS));
+    }
+
+    // Extremes
+    BOOST_CHECK_EQUAL(Histogram::getBucket(-5), 0u);
+    BOOST_CHECK_EQUAL(Histogram::getBucket(numeric_limits<int64_t>::max()),
+                      size_t(Histogram::N_BUCKETS - 1));
+}
+
+BOOST_AUTO_TEST_CASE(histogram_percentile_test)
+{
+    Histogram h;
+    BOOST_CHECK_EQUAL(h.getCount(), 0);
+    BOOST_CHECK_EQUAL(h.getPercentile(50), 0);
+
+    for(int64_t v = 1; v <= 10000; ++v)
+        h.add(v);
+
+    BOOST_CHECK_EQUAL(h.getCount(), 10000);
+    BOOST_CHECK_EQUAL(h.getSum(), 10000 * 10001 / 2);
+    BOOST_CHECK_EQUAL(h.getMin(), 1);
+    BOOST_CHECK_EQUAL(h.getMax(), 10000);
+
+    // Within bucket resolution of the true value
+    BOOST_CHECK_CLOSE(double(h.getPercentile(50)), 5000.0, 7.0);
+    BOOST_CHECK_CLOSE(double(h.getPercentile(90)), 9000.0, 7.0);
+    BOOST_CHECK_CLOSE(double(h.getPercentile(99)), 9900.0, 7.0);
+    BOOST_CHECK_EQUAL(h.getPercentile(100), 10000);
+    BOOST_CHECK_EQUAL(h.getPercentile(0), 1);
+
+    // Merge doubles the counts but keeps the shape
+    Histogram h2;
+    h2.merge(h);
+    h2.merge(h);
+    BOOST_CHECK_EQUAL(h2.getCount(), 20000);
+    BOOST_CHECK_EQUAL(h2.getPercentile(50), h.getPercentile(50));
+    BOOST_CHECK_EQUAL(h2.getMin(), 1);
+    BOOST_CHECK_EQUAL(h2.getMax(), 10000);
+
+    h2.clear();
+    BOOST_CHECK_EQUAL(h2.getCount(), 0);
+    BOOST_CHECK_EQUAL(h2.getMax(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(histogram_set_test)
+{
+    HistogramSet set;
+
+    size_t const nThreads = 4;
+    int64_t const n = 100000;
+
+    boost::thread_group threads;
+    for(size_t i = 0; i < nThreads; ++i)
+        threads.create_thread(boost::bind(recordLoop, boost::ref(set), n));
+    threads.join_all();
+
+    // Samples from exited threads are still there, but their shards
+    // have been freed
+    BOOST_CHECK_EQUAL(set.getShardCount(), 0u);
+    HistogramSet::histogram_map hists;
+    set.getHistograms(hists);
+    BOOST_REQUIRE_EQUAL(hists.size(), 2u);
+    BOOST_CHECK_EQUAL(hists["a"].getCount(), int64_t(nThreads * n));
+    BOOST_CHECK_EQUAL(hists["b"].getCount(), int64_t(nThreads * n / 2));
+    BOOST_CHECK_EQUAL(hists["a"].getMax(), n);
+    BOOST_CHECK_EQUAL(hists["b"].getMin(), 2);
+}
+BOOST_AUTO_TEST_CASE(histogram_set_retire_test)
+{
+    HistogramSet set;
+    set.record("a", 1);
+
+    // Live shards and retired samples merge together
+    boost::thread t(boost::bind(recordLoop, boost::ref(set), 10));
+    t.join();
+    set.record("a", 100);
+
+    HistogramSet::histogram_map hists;
+    set.getHistograms(hists);
+    BOOST_CHECK_EQUAL(set.getShardCount(), 1u);
+    BOOST_CHECK_EQUAL(hists["a"].getCount(), 12);
+    BOOST_CHECK_EQUAL(hists["a"].getMax(), 100);
+}
+
+
+BOOST_AUTO_TEST_CASE(op_trace_test)
+{
+    SampleTracker tracker;
+
+    OpTrace::setSlowThreshold(1);
+    {
+        OpTrace trace(&tracker, "op", "detail");
+        trace.stage("one");
+        trace.stage("two");
+        BOOST_CHECK(trace.finish() >= 0);
+    }
+    {
+        // Finished by destructor
+        OpTrace trace(&tracker, "op");
+    }
+    OpTrace::setSlowThreshold(0);
+
+    // Operations that end in an exception aren't recorded
+    try {
+        OpTrace trace(&tracker, "op");
+        throw std::runtime_error("rejected");
+    }
+    catch(std::runtime_error const &) {}
+
+    HistogramSet::histogram_map hists;
+    tracker.hists.getHistograms(hists);
+    BOOST_CHECK_EQUAL(hists["op"].getCount(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(histogram_set_names_test)
+{
+    HistogramSet set;
+
+    // Names are matched by content, not by address
+    string name = "x";
+    set.record(name, 1);
+    name = "y";
+    set.record(name, 2);
+    set.record("x", 3);
+    set.record(string("x"), 4);
+
+    // Past the limit, new names are dropped but old ones still work
+    for(size_t i = 0; i < 2 * HistogramSet::MAX_HISTOGRAMS; ++i)
+        set.record("n" + string(i / 26 + 1, char('a' + i % 26)), 1);
+    set.record("y", 5);
+
+    HistogramSet::histogram_map hists;
+    set.getHistograms(hists);
+    BOOST_CHECK_EQUAL(hists.size(), size_t(HistogramSet::MAX_HISTOGRAMS));
+    BOOST_CHECK_EQUAL(hists["x"].getCount(), 3);
+    BOOST_CHECK_EQUAL(hists["y"].getCount(), 2);
+    BOOST_CHECK_EQUAL(hists["y"].getMax(), 5);
+}
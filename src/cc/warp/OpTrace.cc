@@ -0,0 +1,101 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-11
+//
+// This file is part of the warp library.
+//
+// The warp library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or any later
+// version.
+//
+// The warp library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <warp/OpTrace.h>
+#include <warp/log.h>
+#include <sstream>
+#include <exception>
+
+using namespace warp;
+
+int64_t volatile OpTrace::slowThresholdUs = 0;
+
+//----------------------------------------------------------------------------
+// OpTrace
+//----------------------------------------------------------------------------
+OpTrace::OpTrace(StatTracker * tracker, char const * name,
+                 char const * detail) :
+    tracker(tracker),
+    name(name),
+    detail(detail),
+    lastNs(0),
+    nStages(0),
+    finished(false)
+{
+}
+
+OpTrace::~OpTrace()
+{
+    // An operation abandoned by an exception (e.g. a rejected or
+    // invalid request) didn't complete, so it isn't recorded
+    if(!finished && !std::uncaught_exception())
+        finish();
+}
+
+void OpTrace::stage(char const * stageName)
+{
+    // Only bother with the breakdown if someone might log it
+    if(!slowThresholdUs)
+        return;
+
+    int64_t now = timer.getElapsedNs();
+    if(nStages < MAX_STAGES)
+    {
+        stageNames[nStages] = stageName;
+        stageNs[nStages] = now - lastNs;
+        ++nStages;
+    }
+    else
+        stageNs[MAX_STAGES - 1] += now - lastNs;
+    lastNs = now;
+}
+
+int64_t OpTrace::finish()
+{
+    finished = true;
+
+    int64_t totalNs = timer.getElapsedNs();
+    int64_t totalUs = totalNs / 1000;
+    tracker->addSample(name, totalUs);
+
+    int64_t threshold = slowThresholdUs;
+    if(threshold && totalUs >= threshold)
+        logSlow(totalNs);
+
+    return totalUs;
+}
+
+void OpTrace::logSlow(int64_t totalNs) const
+{
+    std::ostringstream oss;
+    for(size_t i = 0; i < nStages; ++i)
+        oss << ' ' << stageNames[i] << '=' << stageNs[i] / 1000 << "us";
+    if(nStages && totalNs > lastNs)
+        oss << " other=" << (totalNs - lastNs) / 1000 << "us";
+
+    log("Slow op: %s%s%s: %dus%s", name, (detail ? " " : ""),
+        (detail ? detail : ""), totalNs / 1000, oss.str());
+}
+
+void OpTrace::setSlowThreshold(int64_t thresholdUs)
+{
+    slowThresholdUs = thresholdUs > 0 ? thresholdUs : 0;
+}
@@ -0,0 +1,95 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-11
+//
+// This file is part of the warp library.
+//
+// The warp library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or any later
+// version.
+//
+// The warp library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#ifndef WARP_OPTRACE_H
+#define WARP_OPTRACE_H
+
+#include <warp/StatTracker.h>
+#include <warp/timer.h>
+#include <boost/noncopyable.hpp>
+#include <stdint.h>
+
+namespace warp {
+
+    class OpTrace;
+
+} // namespace warp
+
+//----------------------------------------------------------------------------
+// OpTrace
+//----------------------------------------------------------------------------
+/// Times an operation and records its latency in microseconds in the
+/// named StatTracker histogram when it finishes.  The operation may
+/// be broken into stages by calling stage() at the end of each one.
+/// If slow operation tracing is enabled, operations that take longer
+/// than the threshold are logged with the time spent in each stage.
+///
+///    OpTrace trace(tracker, "Table.applyMutations");
+///    admit();
+///    trace.stage("admit");
+///    apply();
+///    trace.stage("apply");
+///    // latency recorded when trace goes out of scope
+class warp::OpTrace
+    : private boost::noncopyable
+{
+    enum { MAX_STAGES = 8 };
+
+    StatTracker * tracker;
+    char const * name;
+    char const * detail;
+    WallTimer timer;
+    int64_t lastNs;
+    char const * stageNames[MAX_STAGES];
+    int64_t stageNs[MAX_STAGES];
+    size_t nStages;
+    bool finished;
+
+    static int64_t volatile slowThresholdUs;
+
+    void logSlow(int64_t totalNs) const;
+
+public:
+    /// Start timing an operation.  The name and optional detail
+    /// string (e.g. a table name) are not copied and must outlive the
+    /// trace.
+    OpTrace(StatTracker * tracker, char const * name,
+            char const * detail=0);
+
+    /// Finish the operation if it hasn't been finished already,
+    /// unless the trace is being destroyed by an exception.  Failed
+    /// operations aren't counted with the completed ones.
+    ~OpTrace();
+
+    /// Mark the end of a stage of the operation.  Stages past the
+    /// first eight are lumped into the last one.
+    void stage(char const * stageName);
+
+    /// Finish the operation and record its latency.  Returns the
+    /// elapsed time in microseconds.
+    int64_t finish();
+
+    /// Log operations that take at least \c thresholdUs
+    /// microseconds.  Zero disables slow operation logging.
+    static void setSlowThreshold(int64_t thresholdUs);
+};
+
+#endif // WARP_OPTRACE_H
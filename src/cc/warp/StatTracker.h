@@ -35,6 +35,10 @@ namespace warp {
         /// Add delta to the named stat
         virtual void add(strref_t name, int64_t delta) = 0;
 
+        /// Record a sample (e.g. a latency in microseconds) in the
+        /// named histogram
+        virtual void addSample(strref_t name, int64_t value) = 0;
+
     protected:
         ~StatTracker() {}
     };
@@ -45,6 +49,7 @@ namespace warp {
     public:
         void set(strref_t name, int64_t value) {}
         void add(strref_t name, int64_t delta) {}
+        void addSample(strref_t name, int64_t value) {}
     };
 
 } // namespace warp
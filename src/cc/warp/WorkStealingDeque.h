@@ -0,0 +1,185 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-02
+//
+// This file is part of the warp library.
+//
+// The warp library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or any later
+// version.
+//
+// The warp library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#ifndef WARP_WORKSTEALINGDEQUE_H
+#define WARP_WORKSTEALINGDEQUE_H
+
+#include <boost/noncopyable.hpp>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace warp {
+
+    template <class T>
+    class WorkStealingDeque;
+
+} // namespace warp
+
+//----------------------------------------------------------------------------
+// WorkStealingDeque
+//----------------------------------------------------------------------------
+/// Lock-free deque in the style of Chase and Lev, "Dynamic Circular
+/// Work-Stealing Deque" (SPAA 2005).  A single owner thread may
+/// push() and pop() at the bottom of the deque.  Any thread may
+/// steal() from the top.  The element type should be something cheap
+/// and trivially copyable, like a pointer.
+///
+/// The circular buffer grows as needed.  Outgrown buffers are kept
+/// around until the deque is destroyed since a concurrent thief may
+/// still be reading from one.  The buffer only grows, so this costs
+/// at most as much memory as the largest buffer.
+template <class T>
+class warp::WorkStealingDeque
+    : private boost::noncopyable
+{
+    class Buffer
+        : private boost::noncopyable
+    {
+        size_t const logSize;
+        int64_t const mask;
+        T * const items;
+        Buffer * const prev;
+
+    public:
+        Buffer(size_t logSize, Buffer * prev) :
+            logSize(logSize),
+            mask((int64_t(1) << logSize) - 1),
+            items(new T[size_t(1) << logSize]),
+            prev(prev)
+        {
+        }
+
+        ~Buffer()
+        {
+            delete [] items;
+            delete prev;
+        }
+
+        int64_t capacity() const { return mask + 1; }
+
+        T get(int64_t i) const { return items[i & mask]; }
+        void put(int64_t i, T const & x) { items[i & mask] = x; }
+
+        /// Make a buffer twice the size of this one containing the
+        /// items in the range [top, bottom).  The new buffer takes
+        /// ownership of this one.
+        Buffer * grow(int64_t top, int64_t bottom)
+        {
+            Buffer * b = new Buffer(logSize + 1, this);
+            for(int64_t i = top; i < bottom; ++i)
+                b->put(i, get(i));
+            return b;
+        }
+    };
+
+    volatile int64_t top;
+    volatile int64_t bottom;
+    Buffer * volatile buffer;
+
+public:
+    explicit WorkStealingDeque(size_t logInitialSize=8) :
+        top(0),
+        bottom(0),
+        buffer(new Buffer(logInitialSize, 0))
+    {
+    }
+
+    ~WorkStealingDeque()
+    {
+        delete buffer;
+    }
+
+    /// Push an item on the bottom of the deque.  Only the owner
+    /// thread may call this.
+    void push(T const & x)
+    {
+        int64_t b = bottom;
+        int64_t t = top;
+        Buffer * a = buffer;
+        if(b - t >= a->capacity())
+        {
+            a = a->grow(t, b);
+            buffer = a;
+        }
+        a->put(b, x);
+        __sync_synchronize();
+        bottom = b + 1;
+    }
+
+    /// Pop an item from the bottom of the deque.  Only the owner
+    /// thread may call this.
+    /// @return true iff an item was popped
+    bool pop(T & x)
+    {
+        int64_t b = bottom - 1;
+        Buffer * a = buffer;
+        bottom = b;
+        __sync_synchronize();
+        int64_t t = top;
+
+        if(b < t)
+        {
+            // Deque was empty
+            bottom = t;
+            return false;
+        }
+
+        x = a->get(b);
+        if(b > t)
+            // More than one item left, no race with thieves
+            return true;
+
+        // Popping the last item -- race with thieves for it
+        bool won = __sync_bool_compare_and_swap(&top, t, t + 1);
+        bottom = t + 1;
+        return won;
+    }
+
+    /// Steal an item from the top of the deque.  Any thread may call
+    /// this.  Stealing may fail spuriously if it loses a race with
+    /// another thread.
+    /// @return true iff an item was stolen
+    bool steal(T & x)
+    {
+        int64_t t = top;
+        __sync_synchronize();
+        int64_t b = bottom;
+        if(t >= b)
+            return false;
+
+        __sync_synchronize();
+        T y = buffer->get(t);
+        if(!__sync_bool_compare_and_swap(&top, t, t + 1))
+            return false;
+
+        x = y;
+        return true;
+    }
+
+    /// Get an approximate count of the items in the deque.
+    size_t size() const
+    {
+        int64_t n = bottom - top;
+        return n > 0 ? size_t(n) : 0;
+    }
+};
+
+#endif // WARP_WORKSTEALINGDEQUE_H
@@ -0,0 +1,244 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-02
+//
+// This file is part of the warp library.
+//
+// The warp library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or any later
+// version.
+//
+// The warp library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <warp/WorkStealingPool.h>
+#include <warp/call_or_die.h>
+#include <ex/exception.h>
+#include <sstream>
+#include <boost/bind.hpp>
+
+using namespace warp;
+using namespace ex;
+
+//----------------------------------------------------------------------------
+// WorkStealingPool::Worker
+//----------------------------------------------------------------------------
+struct WorkStealingPool::Worker
+{
+    WorkStealingPool * const pool;
+    size_t const index;
+    deque_t deques[N_PRIORITIES];
+    uint32_t rng;
+
+    Worker(WorkStealingPool * pool, size_t index) :
+        pool(pool), index(index), rng(uint32_t(index) * 2654435761u + 1)
+    {
+    }
+
+    /// Pick a random victim for stealing (xorshift).
+    size_t nextVictim(size_t nWorkers)
+    {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        return rng % nWorkers;
+    }
+};
+
+// The worker running on the current thread, if any.
+__thread WorkStealingPool::Worker * WorkStealingPool::currentWorker = 0;
+
+//----------------------------------------------------------------------------
+// WorkStealingPool
+//----------------------------------------------------------------------------
+WorkStealingPool::WorkStealingPool(size_t nWorkers,
+                                   std::string const & poolName,
+                                   bool verbose) :
+    nQueued(0),
+    nIdle(0),
+    cancel(false)
+{
+    if(!nWorkers)
+        raise<ValueError>("WorkStealingPool needs at least 1 worker");
+
+    workers.reserve(nWorkers);
+    for(size_t i = 0; i < nWorkers; ++i)
+        workers.push_back(new Worker(this, i));
+
+    for(size_t i = 0; i < nWorkers; ++i)
+    {
+        std::ostringstream oss;
+        oss << poolName << "-" << i;
+        threads.create_thread(
+            warp::callOrDie(
+                boost::bind(
+                    &WorkStealingPool::workerLoop,
+                    this, workers[i]),
+                oss.str(), verbose));
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    shutdown();
+
+    for(worker_vec::const_iterator i = workers.begin();
+        i != workers.end(); ++i)
+    {
+        delete *i;
+    }
+}
+
+void WorkStealingPool::submit(Runnable * task, Priority priority)
+{
+    Worker * self = currentWorker;
+    if(self && self->pool == this)
+    {
+        // Submitting from one of our own workers: no locks needed.
+        // Workers may keep submitting while the pool drains on
+        // shutdown.
+        __sync_add_and_fetch(&nQueued, 1);
+        self->deques[priority].push(task);
+    }
+    else
+    {
+        // Hold idleMutex until the task is queued so shutdown() can't
+        // slip in and let the workers exit before they see it
+        lock_t idleLock(idleMutex);
+        if(cancel)
+            raise<RuntimeError>("WorkStealingPool has been shut down");
+
+        __sync_add_and_fetch(&nQueued, 1);
+        Injector & inj = injectors[priority];
+        {
+            lock_t lock(inj.mutex);
+            inj.tasks.push_back(task);
+        }
+
+        if(nIdle)
+            idleCond.notify_one();
+        return;
+    }
+
+    // Wake a sleeping worker if there is one.  Workers count
+    // themselves idle before checking nQueued one last time, and
+    // both counters are updated with full barriers, so either the
+    // worker sees our task or we see it waiting.
+    if(__sync_add_and_fetch(&nIdle, 0))
+    {
+        lock_t lock(idleMutex);
+        idleCond.notify_one();
+    }
+}
+
+void WorkStealingPool::shutdown()
+{
+    {
+        lock_t lock(idleMutex);
+        if(cancel)
+            return;
+        cancel = true;
+        idleCond.notify_all();
+    }
+
+    threads.join_all();
+}
+
+size_t WorkStealingPool::getQueuedCount() const
+{
+    long n = __sync_add_and_fetch(const_cast<long *>(&nQueued), 0);
+    return n > 0 ? size_t(n) : 0;
+}
+
+bool WorkStealingPool::stealTask(Worker * self, int priority,
+                                 Runnable * & task)
+{
+    size_t n = workers.size();
+    size_t start = self->nextVictim(n);
+    for(size_t i = 0; i < n; ++i)
+    {
+        Worker * victim = workers[(start + i) % n];
+        if(victim != self && victim->deques[priority].steal(task))
+            return true;
+    }
+    return false;
+}
+
+bool WorkStealingPool::findTask(Worker * self, Runnable * & task)
+{
+    for(int p = 0; p < N_PRIORITIES; ++p)
+    {
+        // Local work first (LIFO for cache locality)
+        if(self->deques[p].pop(task))
+            return true;
+
+        // Then work from outside the pool (FIFO)
+        Injector & inj = injectors[p];
+        {
+            lock_t lock(inj.mutex);
+            if(!inj.tasks.empty())
+            {
+                task = inj.tasks.front();
+                inj.tasks.pop_front();
+                return true;
+            }
+        }
+
+        // Then take someone else's work
+        if(stealTask(self, p, task))
+            return true;
+    }
+    return false;
+}
+
+void WorkStealingPool::workerLoop(Worker * self)
+{
+    currentWorker = self;
+
+    for(;;)
+    {
+        Runnable * task = 0;
+        if(findTask(self, task))
+        {
+            __sync_sub_and_fetch(&nQueued, 1);
+            task->run();
+            continue;
+        }
+
+        if(__sync_add_and_fetch(&nQueued, 0) > 0)
+        {
+            // There's work, but we lost a race for it or it hasn't
+            // quite landed in a queue yet.  Try again.
+            boost::thread::yield();
+            continue;
+        }
+
+        // Count ourselves idle before the final check, so a submit
+        // that we miss is sure to see us and wake us up
+        lock_t lock(idleMutex);
+        __sync_add_and_fetch(&nIdle, 1);
+        if(__sync_add_and_fetch(&nQueued, 0) > 0)
+        {
+            __sync_sub_and_fetch(&nIdle, 1);
+            continue;
+        }
+        if(cancel)
+        {
+            __sync_sub_and_fetch(&nIdle, 1);
+            break;
+        }
+
+        idleCond.wait(lock);
+        __sync_sub_and_fetch(&nIdle, 1);
+    }
+
+    currentWorker = 0;
+}
@@ -0,0 +1,129 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-02
+//
+// This file is part of the warp library.
+//
+// The warp library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or any later
+// version.
+//
+// The warp library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#ifndef WARP_WORKSTEALINGPOOL_H
+#define WARP_WORKSTEALINGPOOL_H
+
+#include <warp/Runnable.h>
+#include <warp/WorkStealingDeque.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <boost/thread.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace warp {
+
+    class WorkStealingPool;
+
+} // namespace warp
+
+//----------------------------------------------------------------------------
+// WorkStealingPool
+//----------------------------------------------------------------------------
+/// Thread pool with a work-stealing deque per worker.  Tasks
+/// submitted from a worker thread go on that worker's own deque
+/// without taking any locks.  Tasks submitted from outside the pool
+/// go on a shared injection queue.  Idle workers look in their own
+/// deque first, then the injection queue, then steal from the other
+/// workers.
+///
+/// Tasks have one of two priorities.  Workers always look for
+/// FOREGROUND work (e.g. log serialization, config saves) before
+/// BACKGROUND work (e.g. compaction read-ahead).  Priority is not
+/// preemptive: a running background task is not interrupted.
+///
+/// The pool makes no ordering guarantees between tasks.  Use
+/// something like kdi::tablet::WorkQueue on top of the pool if jobs
+/// must run in order.
+class warp::WorkStealingPool
+    : private boost::noncopyable
+{
+public:
+    enum Priority
+    {
+        FOREGROUND = 0,
+        BACKGROUND = 1
+    };
+
+private:
+    enum { N_PRIORITIES = 2 };
+
+    typedef boost::mutex::scoped_lock lock_t;
+    typedef WorkStealingDeque<Runnable *> deque_t;
+
+    struct Worker;
+    typedef std::vector<Worker *> worker_vec;
+
+    struct Injector
+    {
+        boost::mutex mutex;
+        std::deque<Runnable *> tasks;
+    };
+
+    worker_vec workers;
+    Injector injectors[N_PRIORITIES];
+    boost::thread_group threads;
+
+    // Count of tasks submitted but not yet taken by a worker.  Only
+    // modified with atomic operations.
+    volatile long nQueued;
+
+    // Number of workers waiting for work.  Only modified while
+    // holding idleMutex, but may be read atomically without it.
+    volatile long nIdle;
+
+    boost::mutex idleMutex;
+    boost::condition idleCond;
+    bool cancel;
+
+    static __thread Worker * currentWorker;
+
+    void workerLoop(Worker * self);
+    bool findTask(Worker * self, Runnable * & task);
+    bool stealTask(Worker * self, int priority, Runnable * & task);
+
+public:
+    /// Create a pool with \c nWorkers threads.  The pool name is used
+    /// to label the threads in log messages.
+    WorkStealingPool(size_t nWorkers, std::string const & poolName,
+                     bool verbose);
+
+    /// Shut down the pool.  Waits for all submitted tasks to finish.
+    ~WorkStealingPool();
+
+    /// Submit a task to the pool.  The Runnable must stay valid until
+    /// its run() method has been called.  The same Runnable may be
+    /// submitted more than once.
+    void submit(Runnable * task, Priority priority=FOREGROUND);
+
+    /// Stop accepting new tasks, wait for the queued tasks to finish,
+    /// and join the worker threads.  Further submissions will throw.
+    void shutdown();
+
+    /// Get the number of worker threads in the pool.
+    size_t getWorkerCount() const { return workers.size(); }
+
+    /// Get an approximate count of tasks waiting to run.
+    size_t getQueuedCount() const;
+};
+
+#endif // WARP_WORKSTEALINGPOOL_H
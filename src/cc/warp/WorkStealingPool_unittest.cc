@@ -0,0 +1,387 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-02
+//
+// This file is part of the warp library.
+//
+// The warp library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or any later
+// version.
+//
+// The warp library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <warp/WorkStealingPool.h>
+#include <warp/WorkerPool.h>
+#include <warp/WorkStealingDeque.h>
+#include <warp/syncqueue.h>
+#include <warp/timer.h>
+#include <ex/exception.h>
+#include <unittest/main.h>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <iostream>
+#include <vector>
+
+using namespace warp;
+using namespace boost;
+using namespace std;
+
+namespace
+{
+    void thief(WorkStealingDeque<size_t> & q, volatile bool & stop,
+               vector<size_t> & got)
+    {
+        size_t x;
+        for(;;)
+        {
+            if(q.steal(x))
+                got.push_back(x);
+            else if(stop && !q.size())
+                break;
+        }
+    }
+
+    /// Runnable that counts how many times it has run.  If depth is
+    /// non-zero, it forks two more tasks of depth-1 from inside the
+    /// pool each time it runs.
+    class CountTask : public Runnable
+    {
+        WorkStealingPool & pool;
+        volatile long & count;
+        size_t depth;
+
+    public:
+        CountTask(WorkStealingPool & pool, volatile long & count,
+                  size_t depth) :
+            pool(pool), count(count), depth(depth) {}
+
+        // Runnable's destructor isn't virtual, and tasks delete
+        // themselves through this type
+        virtual ~CountTask() {}
+
+        void run()
+        {
+            __sync_add_and_fetch(&count, 1);
+            if(depth)
+            {
+                pool.submit(new CountTask(pool, count, depth - 1));
+                pool.submit(new CountTask(pool, count, depth - 1));
+            }
+            delete this;
+        }
+    };
+
+    /// Runnable that blocks until opened.
+    class GateTask : public Runnable
+    {
+        boost::mutex mutex;
+        boost::condition cond;
+        bool running;
+        bool open;
+
+    public:
+        GateTask() : running(false), open(false) {}
+
+        void run()
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            running = true;
+            cond.notify_all();
+            while(!open)
+                cond.wait(lock);
+        }
+
+        void waitRunning()
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            while(!running)
+                cond.wait(lock);
+        }
+
+        void release()
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            open = true;
+            cond.notify_all();
+        }
+    };
+
+    /// Runnable that records its id in a shared list.
+    class OrderTask : public Runnable
+    {
+        vector<int> & order;
+        int id;
+
+    public:
+        OrderTask(vector<int> & order, int id) : order(order), id(id) {}
+        void run() { order.push_back(id); }
+    };
+
+    /// Trivial unit of work for the benchmarks.
+    class NopTask : public Runnable
+    {
+        volatile long & count;
+    public:
+        explicit NopTask(volatile long & count) : count(count) {}
+        void run() { __sync_add_and_fetch(&count, 1); }
+    };
+
+    void destroyWorkerPool(WorkerPool * p, volatile bool & destroyed)
+    {
+        delete p;
+        destroyed = true;
+    }
+
+    void syncQueueWorker(SyncQueue<Runnable *> & q)
+    {
+        Runnable * r;
+        while(q.pop(r))
+            r->run();
+    }
+
+    /// Root task for the pool benchmark: submits nTasks tasks from
+    /// inside the pool, the way a ThreadedReader resubmits itself.
+    class SpawnTask : public Runnable
+    {
+        WorkStealingPool & pool;
+        NopTask & nop;
+        size_t nTasks;
+
+    public:
+        SpawnTask(WorkStealingPool & pool, NopTask & nop, size_t nTasks) :
+            pool(pool), nop(nop), nTasks(nTasks) {}
+        virtual ~SpawnTask() {}
+
+        void run()
+        {
+            for(size_t i = 0; i < nTasks; ++i)
+                pool.submit(&nop);
+        }
+    };
+}
+
+BOOST_AUTO_TEST_CASE(deque_owner_test)
+{
+    // Start small to force growth
+    WorkStealingDeque<size_t> q(1);
+
+    for(size_t i = 0; i < 1000; ++i)
+        q.push(i);
+    BOOST_CHECK_EQUAL(q.size(), 1000u);
+
+    // Owner pops LIFO
+    size_t x;
+    for(size_t i = 1000; i > 500; --i)
+    {
+        BOOST_CHECK(q.pop(x));
+        BOOST_CHECK_EQUAL(x, i - 1);
+    }
+
+    // Thieves steal FIFO
+    for(size_t i = 0; i < 500; ++i)
+    {
+        BOOST_CHECK(q.steal(x));
+        BOOST_CHECK_EQUAL(x, i);
+    }
+
+    BOOST_CHECK(!q.pop(x));
+    BOOST_CHECK(!q.steal(x));
+    BOOST_CHECK_EQUAL(q.size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(deque_steal_test)
+{
+    WorkStealingDeque<size_t> q(2);
+
+    size_t const N = 200000;
+    volatile bool stop = false;
+    vector<size_t> got1, got2, got3;
+
+    thread t1(bind(thief, ref(q), ref(stop), ref(got1)));
+    thread t2(bind(thief, ref(q), ref(stop), ref(got2)));
+
+    // Owner pushes everything and pops some of it back
+    for(size_t i = 0; i < N; ++i)
+    {
+        q.push(i);
+        size_t x;
+        if(i % 3 == 0 && q.pop(x))
+            got3.push_back(x);
+    }
+    stop = true;
+
+    t1.join();
+    t2.join();
+
+    // Every item should have been taken exactly once
+    vector<size_t> seen(N, 0);
+    for(size_t i = 0; i < got1.size(); ++i) ++seen[got1[i]];
+    for(size_t i = 0; i < got2.size(); ++i) ++seen[got2[i]];
+    for(size_t i = 0; i < got3.size(); ++i) ++seen[got3[i]];
+
+    size_t nBad = 0;
+    for(size_t i = 0; i < N; ++i)
+        if(seen[i] != 1)
+            ++nBad;
+    BOOST_CHECK_EQUAL(nBad, 0u);
+    BOOST_CHECK_EQUAL(got1.size() + got2.size() + got3.size(), N);
+}
+
+BOOST_AUTO_TEST_CASE(pool_fork_test)
+{
+    volatile long count = 0;
+    {
+        WorkStealingPool pool(4, "TestPool", false);
+
+        // Binary tree of 2^13 - 1 tasks, mostly submitted from
+        // inside the pool
+        pool.submit(new CountTask(pool, count, 12));
+
+        // Pool destructor waits for everything to finish
+    }
+    BOOST_CHECK_EQUAL(count, (1 << 13) - 1);
+}
+
+BOOST_AUTO_TEST_CASE(pool_priority_test)
+{
+    WorkStealingPool pool(1, "TestPool", false);
+
+    // Block the only worker
+    GateTask gate;
+    pool.submit(&gate);
+    gate.waitRunning();
+
+    vector<int> order;
+    OrderTask bg1(order, 1);
+    OrderTask bg2(order, 2);
+    OrderTask fg3(order, 3);
+    OrderTask fg4(order, 4);
+
+    pool.submit(&bg1, WorkStealingPool::BACKGROUND);
+    pool.submit(&fg3, WorkStealingPool::FOREGROUND);
+    pool.submit(&bg2, WorkStealingPool::BACKGROUND);
+    pool.submit(&fg4, WorkStealingPool::FOREGROUND);
+
+    gate.release();
+    pool.shutdown();
+
+    // Foreground work first, FIFO within a priority
+    BOOST_REQUIRE_EQUAL(order.size(), 4u);
+    BOOST_CHECK_EQUAL(order[0], 3);
+    BOOST_CHECK_EQUAL(order[1], 4);
+    BOOST_CHECK_EQUAL(order[2], 1);
+    BOOST_CHECK_EQUAL(order[3], 2);
+
+    // No submissions after shutdown
+    BOOST_CHECK_THROW(pool.submit(&bg1), ex::RuntimeError);
+}
+
+BOOST_AUTO_TEST_CASE(worker_pool_destroy_test)
+{
+    WorkStealingPool shared(1, "TestPool", false);
+    WorkerPool * pool = new WorkerPool(shared, WorkStealingPool::BACKGROUND);
+
+    // Block the only worker with one of the WorkerPool's tasks, and
+    // queue another behind it
+    GateTask gate;
+    pool->submit(&gate);
+    gate.waitRunning();
+
+    vector<int> order;
+    OrderTask queued(order, 1);
+    pool->submit(&queued);
+
+    // The destructor should wait for the running task
+    volatile bool destroyed = false;
+    thread t(bind(destroyWorkerPool, pool, ref(destroyed)));
+    this_thread::sleep(posix_time::milliseconds(100));
+    BOOST_CHECK(!destroyed);
+
+    gate.release();
+    t.join();
+    BOOST_CHECK(destroyed);
+
+    // The task that hadn't started was cancelled
+    shared.shutdown();
+    BOOST_CHECK(order.empty());
+}
+
+BOOST_AUTO_TEST_CASE(pool_benchmark)
+{
+    size_t const nThreads = 4;
+    size_t const nTasks = 500000;
+
+    // SyncQueue with a thread group, the way WorkerPool used to be
+    {
+        volatile long count = 0;
+        NopTask nop(count);
+
+        WallTimer t;
+        SyncQueue<Runnable *> q;
+        thread_group workers;
+        for(size_t i = 0; i < nThreads; ++i)
+            workers.create_thread(bind(syncQueueWorker, ref(q)));
+        for(size_t i = 0; i < nTasks; ++i)
+            q.push(&nop);
+        q.waitForEmpty();
+        q.cancelWaits();
+        workers.join_all();
+        double dt = t.getElapsed();
+
+        cout << "SyncQueue: " << count << " tasks in " << dt << "s ("
+             << (count / dt) << " tasks/s)" << endl;
+    }
+
+    // WorkStealingPool, external submissions
+    {
+        volatile long count = 0;
+        NopTask nop(count);
+
+        WallTimer t;
+        {
+            WorkStealingPool pool(nThreads, "BenchPool", false);
+            for(size_t i = 0; i < nTasks; ++i)
+                pool.submit(&nop);
+        }
+        double dt = t.getElapsed();
+
+        BOOST_CHECK_EQUAL(size_t(count), nTasks);
+        cout << "WorkStealingPool (external): " << count << " tasks in "
+             << dt << "s (" << (count / dt) << " tasks/s)" << endl;
+    }
+
+    // WorkStealingPool, submissions from inside the pool
+    {
+        volatile long count = 0;
+        NopTask nop(count);
+
+        WallTimer t;
+        {
+            WorkStealingPool pool(nThreads, "BenchPool", false);
+            vector<SpawnTask *> spawners;
+            for(size_t i = 0; i < nThreads; ++i)
+            {
+                spawners.push_back(
+                    new SpawnTask(pool, nop, nTasks / nThreads));
+                pool.submit(spawners.back());
+            }
+            pool.shutdown();
+            for(size_t i = 0; i < spawners.size(); ++i)
+                delete spawners[i];
+        }
+        double dt = t.getElapsed();
+
+        BOOST_CHECK_EQUAL(size_t(count), nTasks);
+        cout << "WorkStealingPool (internal): " << count << " tasks in "
+             << dt << "s (" << (count / dt) << " tasks/s)" << endl;
+    }
+}
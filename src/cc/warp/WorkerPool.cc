@@ -20,37 +20,92 @@
 //----------------------------------------------------------------------------
 
 #include <warp/WorkerPool.h>
-#include <warp/call_or_die.h>
-#include <sstream>
-#include <boost/bind.hpp>
 
 using namespace warp;
 
-void WorkerPool::workerLoop()
+//----------------------------------------------------------------------------
+// WorkerPool::Task
+//----------------------------------------------------------------------------
+/// Wraps a submitted Runnable so the WorkerPool can track it.
+class WorkerPool::Task : public Runnable
 {
-    Runnable * task = 0;
-    while(tasks.pop(task))
-        task->run();
-}
+    WorkerPool * owner;
+    Runnable * task;
+
+public:
+    Task(WorkerPool * owner, Runnable * task) :
+        owner(owner), task(task) {}
+
+    void run()
+    {
+        if(owner->startTask())
+            task->run();
+
+        // The owner may be gone as soon as this returns
+        owner->finishTask();
+        delete this;
+    }
+};
 
+//----------------------------------------------------------------------------
+// WorkerPool
+//----------------------------------------------------------------------------
 WorkerPool::WorkerPool(size_t nWorkers, std::string const & poolName,
-                       bool verbose)
+                       bool verbose) :
+    ownPool(new WorkStealingPool(nWorkers, poolName, verbose)),
+    pool(*ownPool),
+    priority(WorkStealingPool::FOREGROUND),
+    nOutstanding(0),
+    cancel(false)
+{
+}
+
+WorkerPool::WorkerPool(WorkStealingPool & sharedPool,
+                       WorkStealingPool::Priority priority) :
+    pool(sharedPool),
+    priority(priority),
+    nOutstanding(0),
+    cancel(false)
+{
+}
+
+WorkerPool::~WorkerPool()
+{
+    lock_t lock(mutex);
+    cancel = true;
+    while(nOutstanding)
+        allDone.wait(lock);
+}
+
+void WorkerPool::submit(Runnable * r)
 {
-    for(size_t i = 0; i < nWorkers; ++i)
     {
-        std::ostringstream oss;
-        oss << poolName << "-" << i;
-        workers.create_thread(
-            warp::callOrDie(
-                boost::bind(
-                    &WorkerPool::workerLoop,
-                    this),
-                oss.str(), verbose));
+        lock_t lock(mutex);
+        if(cancel)
+            return;
+        ++nOutstanding;
+    }
+
+    Task * task = new Task(this, r);
+    try {
+        pool.submit(task, priority);
+    }
+    catch(...) {
+        delete task;
+        finishTask();
+        throw;
     }
 }
 
-WorkerPool::~WorkerPool()
+bool WorkerPool::startTask()
+{
+    lock_t lock(mutex);
+    return !cancel;
+}
+
+void WorkerPool::finishTask()
 {
-    tasks.cancelWaits();
-    workers.join_all();
+    lock_t lock(mutex);
+    if(!--nOutstanding)
+        allDone.notify_all();
 }
@@ -23,8 +23,9 @@
 #define WARP_WORKERPOOL_H
 
 #include <warp/Runnable.h>
-#include <warp/syncqueue.h>
+#include <warp/WorkStealingPool.h>
 #include <string>
+#include <boost/scoped_ptr.hpp>
 #include <boost/thread.hpp>
 #include <boost/noncopyable.hpp>
 
@@ -37,22 +38,47 @@ namespace warp {
 //----------------------------------------------------------------------------
 // WorkerPool
 //----------------------------------------------------------------------------
+/// Submits tasks to a WorkStealingPool at a fixed priority.  The
+/// WorkerPool either owns a private pool or shares one with other
+/// users in the process.  Either way, destroying the WorkerPool
+/// cancels its tasks that haven't started yet and waits for the ones
+/// that are running, so no task outlives it.
 class warp::WorkerPool
     : private boost::noncopyable
 {
-    warp::SyncQueue<Runnable *> tasks;
-    boost::thread_group workers;
+    class Task;
+    friend class Task;
 
-    void workerLoop();
+    typedef boost::mutex::scoped_lock lock_t;
+
+    boost::scoped_ptr<WorkStealingPool> ownPool;
+    WorkStealingPool & pool;
+    WorkStealingPool::Priority const priority;
+
+    boost::mutex mutex;
+    boost::condition allDone;
+    size_t nOutstanding;
+    bool cancel;
+
+    bool startTask();
+    void finishTask();
 
 public:
+    /// Create a WorkerPool with its own \c nWorkers threads.
     WorkerPool(size_t nWorkers, std::string const & poolName, bool verbose);
+
+    /// Create a WorkerPool submitting to a shared pool at the given
+    /// priority.  The shared pool must outlive this object.
+    WorkerPool(WorkStealingPool & sharedPool,
+               WorkStealingPool::Priority priority);
+
+    /// Cancel tasks that haven't started and wait for running tasks
+    /// to finish.
     ~WorkerPool();
 
-    void submit(Runnable * r)
-    {
-        tasks.push(r);
-    }
+    /// Submit a task.  Submissions made while the WorkerPool is being
+    /// destroyed are dropped.
+    void submit(Runnable * r);
 };
 
 
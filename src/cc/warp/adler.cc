@@ -1,18 +1,213 @@
 /*
  * Public domain implementation of Adler-32 checksum from http://en.wikipedia.org/wiki/Adler-32
+ *
+ * The vectorized versions split the buffer into 16 or 32 byte
+ * chunks.  For a chunk d[0..n) starting with sums (a, b):
+ *
+ *   a' = a + sum(d[i])
+ *   b' = b + n*a + sum((n-i) * d[i])
+ *
+ * The byte sums and weighted sums are done in vector lanes, and the
+ * n*a terms are accumulated separately and scaled once per run of
+ * chunks.  Runs are short enough that no 32-bit lane overflows
+ * before the sums are reduced modulo 65521.
  */
 
 #include <warp/adler.h>
+#include <warp/cpu.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(WARP_HAVE_AVX2_TARGET)
+#include <immintrin.h>
+#endif
 
 #define MOD_ADLER 65521
- 
-uint32_t warp::adler(const uint8_t *data, size_t len) /* data: Pointer to the data to be summed; len is in bytes */
+
+/* Largest n such that 255n(n+1)/2 + (n+1)(MOD_ADLER-1) fits in 32 bits */
+#define NMAX 5552
+
+namespace {
+
+    /* Finish a checksum over a short tail, taking sums already reduced
+     * modulo MOD_ADLER */
+    inline uint32_t adlerTail(uint32_t a, uint32_t b,
+                              const uint8_t *data, size_t len)
+    {
+        while (len--)
+        {
+            a += *data++;
+            b += a;
+        }
+        a %= MOD_ADLER;
+        b %= MOD_ADLER;
+        return (b << 16) | a;
+    }
+
+#if defined(__SSE2__)
+
+    uint32_t adlerSse2(const uint8_t *data, size_t len)
+    {
+        uint32_t a = 1, b = 0;
+
+        size_t nChunks = len / 16;
+        len -= nChunks * 16;
+
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i wLo = _mm_set_epi16(9, 10, 11, 12, 13, 14, 15, 16);
+        const __m128i wHi = _mm_set_epi16(1, 2, 3, 4, 5, 6, 7, 8);
+
+        while (nChunks)
+        {
+            size_t n = nChunks < NMAX / 16 ? nChunks : NMAX / 16;
+            nChunks -= n;
+
+            __m128i vPrev = _mm_setzero_si128();  /* running sum of a */
+            __m128i vA = _mm_setzero_si128();
+            __m128i vB = _mm_setzero_si128();
+            uint64_t aRun = uint64_t(a) * n;
+
+            do
+            {
+                __m128i d = _mm_loadu_si128((const __m128i *)data);
+                data += 16;
+
+                vPrev = _mm_add_epi32(vPrev, vA);
+                vA = _mm_add_epi32(vA, _mm_sad_epu8(d, zero));
+                vB = _mm_add_epi32(vB, _mm_madd_epi16(
+                                       _mm_unpacklo_epi8(d, zero), wLo));
+                vB = _mm_add_epi32(vB, _mm_madd_epi16(
+                                       _mm_unpackhi_epi8(d, zero), wHi));
+            } while (--n);
+
+            uint32_t pa[4], pp[4], pb[4];
+            _mm_storeu_si128((__m128i *)pa, vA);
+            _mm_storeu_si128((__m128i *)pp, vPrev);
+            _mm_storeu_si128((__m128i *)pb, vB);
+
+            uint64_t sa = uint64_t(pa[0]) + pa[2];
+            uint64_t sp = uint64_t(pp[0]) + pp[2] + aRun;
+            uint64_t sb = uint64_t(pb[0]) + pb[1] + pb[2] + pb[3];
+
+            b = uint32_t((b + 16 * sp + sb) % MOD_ADLER);
+            a = uint32_t((a + sa) % MOD_ADLER);
+        }
+
+        return adlerTail(a, b, data, len);
+    }
+
+#endif // __SSE2__
+
+#if defined(WARP_HAVE_AVX2_TARGET)
+
+    __attribute__((target("avx2")))
+    uint32_t adlerAvx2(const uint8_t *data, size_t len)
+    {
+        uint32_t a = 1, b = 0;
+
+        size_t nChunks = len / 32;
+        len -= nChunks * 32;
+
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i ones = _mm256_set1_epi16(1);
+        const __m256i w = _mm256_set_epi8(
+            1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
+            17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32);
+
+        while (nChunks)
+        {
+            size_t n = nChunks < NMAX / 32 ? nChunks : NMAX / 32;
+            nChunks -= n;
+
+            __m256i vPrev = _mm256_setzero_si256();
+            __m256i vA = _mm256_setzero_si256();
+            __m256i vB = _mm256_setzero_si256();
+            uint64_t aRun = uint64_t(a) * n;
+
+            do
+            {
+                __m256i d = _mm256_loadu_si256((const __m256i *)data);
+                data += 32;
+
+                vPrev = _mm256_add_epi32(vPrev, vA);
+                vA = _mm256_add_epi32(vA, _mm256_sad_epu8(d, zero));
+                vB = _mm256_add_epi32(vB, _mm256_madd_epi16(
+                                          _mm256_maddubs_epi16(d, w), ones));
+            } while (--n);
+
+            uint32_t pa[8], pp[8], pb[8];
+            _mm256_storeu_si256((__m256i *)pa, vA);
+            _mm256_storeu_si256((__m256i *)pp, vPrev);
+            _mm256_storeu_si256((__m256i *)pb, vB);
+
+            uint64_t sa = 0, sp = aRun, sb = 0;
+            for (int i = 0; i < 8; ++i)
+            {
+                sa += pa[i];
+                sp += pp[i];
+                sb += pb[i];
+            }
+
+            b = uint32_t((b + 32 * sp + sb) % MOD_ADLER);
+            a = uint32_t((a + sa) % MOD_ADLER);
+        }
+
+        return adlerTail(a, b, data, len);
+    }
+
+#endif // WARP_HAVE_AVX2_TARGET
+
+    warp::ChecksumImpl const * findImpls()
+    {
+        static warp::ChecksumImpl impls[4];
+        size_t n = 0;
+
+        warp::ChecksumImpl scalar = { "scalar", &warp::adlerScalar };
+        impls[n++] = scalar;
+
+#if defined(__SSE2__)
+        warp::ChecksumImpl sse2 = { "sse2", &adlerSse2 };
+        impls[n++] = sse2;
+#endif
+
+#if defined(WARP_HAVE_AVX2_TARGET)
+        if (warp::cpuHasAvx2())
+        {
+            warp::ChecksumImpl avx2 = { "avx2", &adlerAvx2 };
+            impls[n++] = avx2;
+        }
+#endif
+
+        warp::ChecksumImpl end = { 0, 0 };
+        impls[n] = end;
+        return impls;
+    }
+
+    uint32_t adlerResolve(const uint8_t *data, size_t len);
+
+    /* Dispatch pointer, set to the best implementation on first use.
+     * Racing threads all store the same value. */
+    warp::checksum_fn_t volatile adlerImpl = &adlerResolve;
+
+    uint32_t adlerResolve(const uint8_t *data, size_t len)
+    {
+        warp::ChecksumImpl const * impls = warp::getAdlerImpls();
+        while (impls[1].fn)
+            ++impls;
+        adlerImpl = impls->fn;
+        return impls->fn(data, len);
+    }
+}
+
+uint32_t warp::adlerScalar(const uint8_t *data, size_t len) /* data: Pointer to the data to be summed; len is in bytes */
 {
     uint32_t a = 1, b = 0;
        
     while (len > 0) 
     {
-        size_t tlen = len > 5552 ? 5552 : len;
+        size_t tlen = len > NMAX ? NMAX : len;
         len -= tlen;
         do 
         {
@@ -26,3 +221,14 @@ uint32_t warp::adler(const uint8_t *data, size_t len) /* data: Pointer to the da
     
     return (b << 16) | a;
 }
+
+uint32_t warp::adler(const uint8_t *data, size_t len)
+{
+    return adlerImpl(data, len);
+}
+
+warp::ChecksumImpl const * warp::getAdlerImpls()
+{
+    static ChecksumImpl const * impls = findImpls();
+    return impls;
+}
@@ -2,9 +2,36 @@
  * Public domain implementation of Adler-32 checksum from http://en.wikipedia.org/wiki/Adler-32
  */
 
+#ifndef WARP_ADLER_H
+#define WARP_ADLER_H
+
 #include <stdint.h>
 #include <stddef.h>
 
 namespace warp {
+
+    /// Compute the Adler-32 checksum of a buffer using the fastest
+    /// implementation supported by the CPU.  The implementation is
+    /// chosen on the first call.
     uint32_t adler(const uint8_t *data, size_t len);
+
+    /// Portable Adler-32 implementation.  Always gives the same
+    /// answer as adler().
+    uint32_t adlerScalar(const uint8_t *data, size_t len);
+
+    typedef uint32_t (*checksum_fn_t)(const uint8_t *data, size_t len);
+
+    /// A named checksum implementation
+    struct ChecksumImpl
+    {
+        char const * name;
+        checksum_fn_t fn;
+    };
+
+    /// Get the Adler-32 implementations usable on this CPU, ending
+    /// with a null entry.  The last non-null entry is the one used by
+    /// adler().  For tests and benchmarks.
+    ChecksumImpl const * getAdlerImpls();
 }
+
+#endif // WARP_ADLER_H
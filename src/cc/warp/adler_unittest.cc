@@ -0,0 +1,107 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of the warp library.
+//
+// The warp library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or any later
+// version.
+//
+// The warp library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <warp/adler.h>
+#include <warp/crc32c.h>
+#include <unittest/main.h>
+#include <vector>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace warp;
+using namespace std;
+
+namespace
+{
+    uint8_t const * bytes(char const * s)
+    {
+        return reinterpret_cast<uint8_t const *>(s);
+    }
+
+    /// Check every implementation against the scalar one over
+    /// buffers of many lengths and alignments.
+    void crossCheck(ChecksumImpl const * impls, checksum_fn_t scalar)
+    {
+        vector<uint8_t> buf(70000);
+        for(size_t i = 0; i < buf.size(); ++i)
+            buf[i] = uint8_t(rand());
+
+        // All 0xff is the worst case for lane overflow
+        vector<uint8_t> ones(70000, 0xff);
+
+        for(ChecksumImpl const * impl = impls; impl->fn; ++impl)
+        {
+            BOOST_TEST_MESSAGE(impl->name);
+
+            for(size_t len = 0; len < 300; ++len)
+            {
+                for(size_t off = 0; off < 8; ++off)
+                {
+                    BOOST_CHECK_EQUAL(impl->fn(&buf[off], len),
+                                      scalar(&buf[off], len));
+                }
+            }
+
+            size_t const bigLens[] = { 5551, 5552, 5553, 11104, 65536,
+                                       69999 };
+            for(size_t i = 0; i < sizeof(bigLens)/sizeof(*bigLens); ++i)
+            {
+                size_t len = bigLens[i];
+                BOOST_CHECK_EQUAL(impl->fn(&buf[1], len - 1),
+                                  scalar(&buf[1], len - 1));
+                BOOST_CHECK_EQUAL(impl->fn(&ones[0], len),
+                                  scalar(&ones[0], len));
+            }
+        }
+    }
+}
+
+BOOST_AUTO_UNIT_TEST(adler_known_values)
+{
+    BOOST_CHECK_EQUAL(adler(bytes(""), 0), 1u);
+    BOOST_CHECK_EQUAL(adler(bytes("Wikipedia"), 9), 0x11e60398u);
+    BOOST_CHECK_EQUAL(adlerScalar(bytes("Wikipedia"), 9), 0x11e60398u);
+}
+
+BOOST_AUTO_UNIT_TEST(adler_cross_check)
+{
+    // There's always at least the scalar implementation
+    BOOST_REQUIRE(getAdlerImpls()[0].fn);
+    crossCheck(getAdlerImpls(), &adlerScalar);
+}
+
+BOOST_AUTO_UNIT_TEST(crc32c_known_values)
+{
+    BOOST_CHECK_EQUAL(crc32c(bytes(""), 0), 0u);
+    BOOST_CHECK_EQUAL(crc32c(bytes("123456789"), 9), 0xe3069283u);
+    BOOST_CHECK_EQUAL(crc32cScalar(bytes("123456789"), 9), 0xe3069283u);
+
+    // RFC 3720 test vector: 32 bytes of zeros
+    uint8_t zeros[32];
+    memset(zeros, 0, sizeof(zeros));
+    BOOST_CHECK_EQUAL(crc32c(zeros, sizeof(zeros)), 0x8a9136aau);
+}
+
+BOOST_AUTO_UNIT_TEST(crc32c_cross_check)
+{
+    BOOST_REQUIRE(getCrc32cImpls()[0].fn);
+    crossCheck(getCrc32cImpls(), &crc32cScalar);
+}
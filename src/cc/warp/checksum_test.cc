@@ -0,0 +1,107 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of the warp library.
+//
+// The warp library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or any later
+// version.
+//
+// The warp library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+// Throughput benchmark for the block checksum implementations
+
+#include <warp/adler.h>
+#include <warp/crc32c.h>
+#include <warp/options.h>
+#include <warp/strutil.h>
+#include <warp/timer.h>
+#include <boost/format.hpp>
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+
+using namespace warp;
+using namespace std;
+using boost::format;
+
+namespace
+{
+    void timeImpls(char const * family, ChecksumImpl const * impls,
+                   vector<uint8_t> const & buf, size_t blockSize,
+                   size_t totalBytes)
+    {
+        size_t nBlocks = buf.size() / blockSize;
+        size_t nPasses = totalBytes / (nBlocks * blockSize) + 1;
+        uint32_t expected = impls[0].fn(&buf[0], blockSize);
+
+        for(ChecksumImpl const * impl = impls; impl->fn; ++impl)
+        {
+            uint32_t sum = 0;
+            CpuTimer timer;
+            for(size_t pass = 0; pass < nPasses; ++pass)
+            {
+                for(size_t i = 0; i < nBlocks; ++i)
+                    sum += impl->fn(&buf[i * blockSize], blockSize);
+            }
+            double t = timer.getElapsed();
+            double bytes = double(nPasses) * nBlocks * blockSize;
+
+            bool ok = impl->fn(&buf[0], blockSize) == expected;
+            cout << format("%-8s %-8s %8sB blocks: %9.1f MB/s%s  (%08x)")
+                % family % impl->name % sizeString(blockSize)
+                % (bytes / t / (1 << 20))
+                % (ok ? "" : "  MISMATCH")
+                % sum
+                 << endl;
+        }
+    }
+}
+
+int main(int ac, char ** av)
+{
+    OptionParser op("%prog [options]");
+    {
+        using namespace boost::program_options;
+        op.addOption("blockSize,b", value<string>()->default_value("64k"),
+                     "Checksum block size");
+        op.addOption("bufferSize,s", value<string>()->default_value("16M"),
+                     "Size of buffer to checksum");
+        op.addOption("total,n", value<string>()->default_value("2G"),
+                     "Total bytes to checksum per implementation");
+    }
+
+    OptionMap opt;
+    ArgumentList args;
+    op.parseOrBail(ac, av, opt, args);
+
+    string arg;
+    opt.get("blockSize", arg);
+    size_t blockSize = parseSize(arg);
+    opt.get("bufferSize", arg);
+    size_t bufferSize = parseSize(arg);
+    opt.get("total", arg);
+    size_t totalBytes = parseSize(arg);
+
+    if(!blockSize || blockSize > bufferSize)
+        op.error("block size must be positive and no larger than buffer");
+
+    vector<uint8_t> buf(bufferSize);
+    for(size_t i = 0; i < buf.size(); ++i)
+        buf[i] = uint8_t(rand());
+
+    timeImpls("adler32", getAdlerImpls(), buf, blockSize, totalBytes);
+    timeImpls("crc32c", getCrc32cImpls(), buf, blockSize, totalBytes);
+
+    return 0;
+}
@@ -0,0 +1,70 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of the warp library.
+//
+// The warp library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or any later
+// version.
+//
+// The warp library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <warp/cpu.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+
+bool warp::cpuHasSse42()
+{
+    unsigned a, b, c, d;
+    if(!__get_cpuid(1, &a, &b, &c, &d))
+        return false;
+    return (c & bit_SSE4_2) != 0;
+}
+
+bool warp::cpuHasAvx2()
+{
+    unsigned a, b, c, d;
+    if(!__get_cpuid(1, &a, &b, &c, &d))
+        return false;
+
+    // The OS has to save the YMM registers on context switches
+    if(!(c & bit_OSXSAVE) || !(c & bit_AVX))
+        return false;
+    unsigned xcr0, xcr0hi;
+    __asm__ ("xgetbv" : "=a" (xcr0), "=d" (xcr0hi) : "c" (0));
+    if((xcr0 & 6) != 6)
+        return false;
+
+    if(__get_cpuid_max(0, 0) < 7)
+        return false;
+    __cpuid_count(7, 0, a, b, c, d);
+    return (b & (1u << 5)) != 0;
+}
+
+#else
+
+bool warp::cpuHasSse42()
+{
+    return false;
+}
+
+bool warp::cpuHasAvx2()
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,43 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of the warp library.
+//
+// The warp library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or any later
+// version.
+//
+// The warp library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#ifndef WARP_CPU_H
+#define WARP_CPU_H
+
+// Define WARP_HAVE_AVX2_TARGET if the compiler can build AVX2
+// functions in a file that isn't compiled with -mavx2.  Callers must
+// still check cpuHasAvx2() before running them.
+#if defined(__x86_64__) && defined(__GNUC__) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define WARP_HAVE_AVX2_TARGET 1
+#endif
+
+namespace warp {
+
+    /// Return true if the CPU supports the SSE4.2 instructions.
+    bool cpuHasSse42();
+
+    /// Return true if the CPU and OS support the AVX2 instructions.
+    bool cpuHasAvx2();
+
+} // namespace warp
+
+#endif // WARP_CPU_H
@@ -0,0 +1,180 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of the warp library.
+//
+// The warp library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or any later
+// version.
+//
+// The warp library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#include <warp/crc32c.h>
+#include <warp/cpu.h>
+#include <string.h>
+
+namespace {
+
+    /// Reflected Castagnoli polynomial
+    uint32_t const POLY = 0x82f63b78;
+
+    /// Tables for slicing-by-8: table[k][i] is the CRC of byte i
+    /// followed by k zero bytes
+    struct Crc32cTables
+    {
+        uint32_t table[8][256];
+
+        Crc32cTables()
+        {
+            for(uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t crc = i;
+                for(int j = 0; j < 8; ++j)
+                    crc = (crc >> 1) ^ (POLY & (0u - (crc & 1)));
+                table[0][i] = crc;
+            }
+            for(uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t crc = table[0][i];
+                for(int k = 1; k < 8; ++k)
+                {
+                    crc = (crc >> 8) ^ table[0][crc & 0xff];
+                    table[k][i] = crc;
+                }
+            }
+        }
+    };
+
+    Crc32cTables const & getTables()
+    {
+        static Crc32cTables tables;
+        return tables;
+    }
+
+#if defined(__x86_64__)
+
+    /// CRC-32C using the SSE4.2 crc32 instruction.  Written with
+    /// inline assembly so the file doesn't need -msse4.2.
+    uint32_t crc32cSse42(const uint8_t *data, size_t len)
+    {
+        uint64_t crc = 0xffffffffu;
+
+        // Align to 8 bytes
+        while(len && (reinterpret_cast<uintptr_t>(data) & 7))
+        {
+            uint32_t c = uint32_t(crc);
+            __asm__ ("crc32b %1, %0" : "+r" (c) : "rm" (*data));
+            crc = c;
+            ++data;
+            --len;
+        }
+
+        while(len >= 8)
+        {
+            uint64_t word;
+            memcpy(&word, data, 8);
+            __asm__ ("crc32q %1, %0" : "+r" (crc) : "rm" (word));
+            data += 8;
+            len -= 8;
+        }
+
+        uint32_t c = uint32_t(crc);
+        while(len--)
+        {
+            __asm__ ("crc32b %1, %0" : "+r" (c) : "rm" (*data));
+            ++data;
+        }
+
+        return ~c;
+    }
+
+#endif // __x86_64__
+
+    warp::ChecksumImpl const * findImpls()
+    {
+        static warp::ChecksumImpl impls[3];
+        size_t n = 0;
+
+        warp::ChecksumImpl scalar = { "scalar", &warp::crc32cScalar };
+        impls[n++] = scalar;
+
+#if defined(__x86_64__)
+        if(warp::cpuHasSse42())
+        {
+            warp::ChecksumImpl sse42 = { "sse4.2", &crc32cSse42 };
+            impls[n++] = sse42;
+        }
+#endif
+
+        warp::ChecksumImpl end = { 0, 0 };
+        impls[n] = end;
+        return impls;
+    }
+
+    uint32_t crc32cResolve(const uint8_t *data, size_t len);
+
+    // Dispatch pointer, set to the best implementation on first use.
+    // Racing threads all store the same value.
+    warp::checksum_fn_t volatile crc32cImpl = &crc32cResolve;
+
+    uint32_t crc32cResolve(const uint8_t *data, size_t len)
+    {
+        warp::ChecksumImpl const * impls = warp::getCrc32cImpls();
+        while(impls[1].fn)
+            ++impls;
+        crc32cImpl = impls->fn;
+        return impls->fn(data, len);
+    }
+}
+
+uint32_t warp::crc32cScalar(const uint8_t *data, size_t len)
+{
+    Crc32cTables const & t = getTables();
+    uint32_t crc = 0xffffffffu;
+
+    // Slicing-by-8 over the bulk of the buffer.  Assumes a
+    // little-endian host, like the rest of the on-disk formats.
+    while(len >= 8)
+    {
+        uint32_t lo, hi;
+        memcpy(&lo, data, 4);
+        memcpy(&hi, data + 4, 4);
+        lo ^= crc;
+        crc = t.table[7][lo & 0xff] ^
+            t.table[6][(lo >> 8) & 0xff] ^
+            t.table[5][(lo >> 16) & 0xff] ^
+            t.table[4][lo >> 24] ^
+            t.table[3][hi & 0xff] ^
+            t.table[2][(hi >> 8) & 0xff] ^
+            t.table[1][(hi >> 16) & 0xff] ^
+            t.table[0][hi >> 24];
+        data += 8;
+        len -= 8;
+    }
+
+    while(len--)
+        crc = (crc >> 8) ^ t.table[0][(crc ^ *data++) & 0xff];
+
+    return ~crc;
+}
+
+uint32_t warp::crc32c(const uint8_t *data, size_t len)
+{
+    return crc32cImpl(data, len);
+}
+
+warp::ChecksumImpl const * warp::getCrc32cImpls()
+{
+    static ChecksumImpl const * impls = findImpls();
+    return impls;
+}
@@ -0,0 +1,47 @@
+//---------------------------------------------------------- -*- Mode: C++ -*-
+// Copyright (C) 2009 Josh Taylor (Kosmix Corporation)
+// Created 2009-03-13
+//
+// This file is part of the warp library.
+//
+// The warp library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by the
+// Free Software Foundation; either version 2 of the License, or any later
+// version.
+//
+// The warp library is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+// Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+//----------------------------------------------------------------------------
+
+#ifndef WARP_CRC32C_H
+#define WARP_CRC32C_H
+
+#include <warp/adler.h>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace warp {
+
+    /// Compute the CRC-32C (Castagnoli) checksum of a buffer.  Uses
+    /// the SSE4.2 crc32 instruction when the CPU has it.  CRC-32C
+    /// catches more errors than Adler-32, especially on small blocks.
+    uint32_t crc32c(const uint8_t *data, size_t len);
+
+    /// Portable table-driven CRC-32C.  Always gives the same answer
+    /// as crc32c().
+    uint32_t crc32cScalar(const uint8_t *data, size_t len);
+
+    /// Get the CRC-32C implementations usable on this CPU, ending
+    /// with a null entry.  The last non-null entry is the one used by
+    /// crc32c().  For tests and benchmarks.
+    ChecksumImpl const * getCrc32cImpls();
+
+} // namespace warp
+
+#endif // WARP_CRC32C_H
@@ -27,6 +27,8 @@
 #include <warp/functional.h>
 #include <boost/noncopyable.hpp>
 #include <map>
+#include <vector>
+#include <utility>
 
 namespace warp {
 
@@ -55,11 +57,12 @@ class warp::LruCache
     {
         value_t value;
         size_t refCount;
+        size_t accessCount;
         typename map_t::iterator indexIt;
         bool removed;
 
         Item() :
-            value(), refCount(0), removed(false) {}
+            value(), refCount(0), accessCount(0), removed(false) {}
 
         /// Given the address of a value_t contained in an Item,
         /// return the address of the containing Item.  Note, the
@@ -175,8 +178,9 @@ public:
                 flushToSize(maxSize);
         }
 
-        // Increment reference count
+        // Increment reference and access counts
         ++i->second->refCount;
+        ++i->second->accessCount;
         i->second->removed = false;
 
         // Move new item to most recently used spot in cache
@@ -186,6 +190,51 @@ public:
         return &i->second->value;
     }
 
+    /// Add an item to the cache without pinning it or counting an
+    /// access.  The item goes in as the least recently used, so it
+    /// never pushes out an item that has been used, or one inserted
+    /// before it.  Returns true if the item is in the cache
+    /// afterwards.  If the key is already in the cache, do nothing
+    /// and return false.  If the cache is full, the new item is the
+    /// first to go and false is returned.
+    bool insert(key_t const & key, value_t const & value)
+    {
+        typename map_t::iterator i = index.find(key);
+        if(i != index.end())
+            return false;
+
+        i = index.insert(std::make_pair(key, pool.create())).first;
+        i->second->value = value;
+        curSize += sizeOfValue(i->second->value);
+        i->second->indexIt = i;
+        lru.moveToFront(i->second);
+
+        if(curSize > maxSize)
+            flushToSize(maxSize);
+        return contains(key);
+    }
+
+    /// Get the keys in the cache and the number of times each has
+    /// been fetched with get() since it was loaded.  Keys are
+    /// appended to \c out from most to least recently used.
+    void getAccessCounts(
+        std::vector<std::pair<key_t, size_t> > & out) const
+    {
+        typename lru_t::const_iterator i = lru.end();
+        while(i != lru.begin())
+        {
+            --i;
+            out.push_back(std::make_pair(i->indexIt->first,
+                                         i->accessCount));
+        }
+    }
+
+    /// Return the maximum size of the cache.
+    size_t getMaxSize() const
+    {
+        return maxSize;
+    }
+
     /// Remove a key from the cache.  If the item for the key has
     /// already been flushed from the cache, do nothing.  If the key
     /// refers to an item still in the cache, remove it as soon all
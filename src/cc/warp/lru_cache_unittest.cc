@@ -323,3 +323,48 @@ BOOST_AUTO_UNIT_TEST(lru_custom)
     BOOST_CHECK_EQUAL(cache.size(), 30u);
     BOOST_CHECK_EQUAL(cache.count(), 1u);
 }
+
+BOOST_AUTO_UNIT_TEST(lru_insert)
+{
+    typedef std::vector<std::pair<std::string, size_t> > count_vec;
+
+    LruCache<std::string, int> cache(3);
+
+    // Inserted items are unpinned and have no accesses
+    BOOST_CHECK(cache.insert("a", 1));
+    BOOST_CHECK(cache.insert("b", 2));
+    BOOST_CHECK(!cache.insert("a", 10));
+    BOOST_CHECK_EQUAL(cache.count(), 2u);
+
+    int * a = cache.get("a");
+    BOOST_CHECK_EQUAL(*a, 1);
+    cache.release(a);
+    cache.release(cache.get("a"));
+
+    // Most recently used first
+    count_vec counts;
+    cache.getAccessCounts(counts);
+    BOOST_REQUIRE_EQUAL(counts.size(), 2u);
+    BOOST_CHECK_EQUAL(counts[0].first, "a");
+    BOOST_CHECK_EQUAL(counts[0].second, 2u);
+    BOOST_CHECK_EQUAL(counts[1].first, "b");
+    BOOST_CHECK_EQUAL(counts[1].second, 0u);
+
+    // Inserted items are least recently used, so inserting past the
+    // limit drops the newest insert rather than anything before it
+    BOOST_CHECK(cache.insert("c", 3));
+    BOOST_CHECK(!cache.insert("d", 4));
+    BOOST_CHECK_EQUAL(cache.count(), 3u);
+    BOOST_CHECK(!cache.contains("d"));
+    BOOST_CHECK(cache.contains("a"));
+    BOOST_CHECK(cache.contains("b"));
+    BOOST_CHECK(cache.contains("c"));
+
+    // Items that get used move ahead of inserted ones
+    cache.release(cache.get("c"));
+    cache.release(cache.get("e"));
+    BOOST_CHECK_EQUAL(cache.count(), 3u);
+    BOOST_CHECK(!cache.contains("b"));
+    BOOST_CHECK(cache.contains("c"));
+    BOOST_CHECK(cache.contains("e"));
+}
@@ -125,13 +125,21 @@ public:
         if(i != pool.end())
             return *i;
  
-        // Make a new StringData block
+        // Make a new StringData block, add it to the pool, and
+        // return the new block
+        size_t pos = appendString(s);
+        pool.insert(pos);
+        return pos;
+    }
+
+    /// Add a new StringData for the given string to the string block
+    /// and return its offset.  The pool isn't searched or updated, so
+    /// this skips hashing the string.
+    size_t appendString(strref_t s)
+    {
         block->appendPadding(4);
         size_t pos = block->size();
         *block << StringData::wrap(s);
-    
-        // Add it to the pool, and return the new block
-        pool.insert(pos);
         return pos;
     }
 
@@ -29,29 +29,37 @@ def parseConfig(s):
     server = cfg.get('server')
     minRow = cfg.get('minRow', None)
     frags = []
+    retention = []
     for key in cfg:
         if key in ('server', 'minRow'):
             continue
+        # Table settings have to match to join tablets
+        if key.startswith('retention.') or key.startswith('groups.'):
+            retention.append((key, cfg.get(key)))
+            continue
         if not key.startswith('tables.'):
             raise RuntimeError('unknown key: %s' % key)
         frags.append((key, cfg.get(key)))
     frags.sort()
     frags = [ val for key,val in frags ]
-    return server, minRow, frags
+    retention.sort()
+    return server, minRow, frags, tuple(retention)
 
-def serializeConfig(server, minRow, frags):
+def serializeConfig(server, minRow, frags, retention):
     cfg = Properties()
     cfg.set('server', server)
     if minRow is not None:
         cfg.set('minRow', minRow)
     for i,f in enumerate(frags):
         cfg.set('tables.i%d' % i, f)
+    for key,val in retention:
+        cfg.set(key, val)
     o = StringIO()
     cfg.dump(o, noSpace=True)
     return o.getvalue()
 
-def joinTablets(meta, keys, server, minRow, frags):
-    cfg = serializeConfig(server, minRow, frags)
+def joinTablets(meta, keys, server, minRow, frags, retention):
+    cfg = serializeConfig(server, minRow, frags, retention)
     r,c,t = keys[-1]
     for k in keys[:-1]:
         meta.erase(*k)
@@ -89,13 +97,13 @@ def main():
             print 'scan:', (r,c,t,v)
 
         table = zeroDecode(r)[0]
-        server,minRow,frags = parseConfig(v)
+        server,minRow,frags,retention = parseConfig(v)
 
-        match = table,server,frags
+        match = table,server,frags,retention
         if match != lastMatch:
             if len(sameKeys) > 1:
                 joinTablets(meta, sameKeys, lastMatch[1], joinMin,
-                            lastMatch[2])
+                            lastMatch[2], lastMatch[3])
             joinMin = minRow
             sameKeys = []
 
@@ -103,7 +111,8 @@ def main():
         lastMatch = match
 
     if len(sameKeys) > 1:
-        joinTablets(meta, sameKeys, lastMatch[1], joinMin, lastMatch[2])
+        joinTablets(meta, sameKeys, lastMatch[1], joinMin, lastMatch[2],
+                    lastMatch[3])
 
     meta.sync()
 